@@ -34,9 +34,8 @@ class BroadcastGlobalVariablesCallbackImpl(object):
         with tf.device(self.device):
             if hvd._executing_eagerly() and hasattr(self.model, 'variables'):
                 # TensorFlow 2.0 or TensorFlow eager
-                hvd.broadcast_variables(self.model.variables,
-                                        root_rank=self.root_rank)
-                hvd.broadcast_variables(self.model.optimizer.variables(),
+                hvd.broadcast_variables(self.model.variables +
+                                        self.model.optimizer.variables(),
                                         root_rank=self.root_rank)
             else:
                 bcast_op = hvd.broadcast_global_variables(self.root_rank)
@@ -57,29 +56,38 @@ class MetricAverageCallbackImpl(object):
         with self.backend.name_scope('MetricAverageCallback'):
             var = self.backend.variable(value, name=metric)
             self.backend.get_session().run(var.initializer)
-            allreduce_op = hvd.allreduce(var, device_dense=self.device)
-            return var, allreduce_op
+            return var
+
+    def _make_allreduce_op(self, metrics):
+        with self.backend.name_scope('MetricAverageCallback'):
+            return hvd.grouped_allreduce([self.variables[metric] for metric in metrics],
+                                         device_dense=self.device)
 
     def _average_metrics_in_place(self, logs):
         logs = logs or {}
-        reduced_logs = {}
-        # Reduce every metric among workers. Sort metrics by name
-        # to ensure consistent order.
-        for metric, value in sorted(logs.items()):
-            if hvd._executing_eagerly():
-                reduced_logs[metric] = \
-                    hvd.allreduce(self.backend.constant(value, name=metric)).numpy()
-            else:
+        # Reduce all metrics among workers with one grouped allreduce. Sort
+        # metrics by name to ensure consistent order.
+        metrics = sorted(logs.keys())
+        if not metrics:
+            return
+        if hvd._executing_eagerly():
+            reduced = hvd.grouped_allreduce([self.backend.constant(logs[metric], name=metric)
+                                             for metric in metrics])
+            reduced_values = [value.numpy() for value in reduced]
+        else:
+            for metric in metrics:
                 if metric not in self.variables:
-                    self.variables[metric], self.allreduce_ops[metric] = \
-                        self._make_variable(metric, value)
+                    self.variables[metric] = self._make_variable(metric, logs[metric])
                 else:
-                    self.backend.set_value(self.variables[metric], value)
-                reduced_logs[metric] = \
-                    self.backend.get_session().run(self.allreduce_ops[metric])
+                    self.backend.set_value(self.variables[metric], logs[metric])
+            # One op per set of metrics, validation metrics come and go.
+            key = tuple(metrics)
+            if key not in self.allreduce_ops:
+                self.allreduce_ops[key] = self._make_allreduce_op(metrics)
+            reduced_values = self.backend.get_session().run(self.allreduce_ops[key])
         # Override the reduced values back into logs dictionary
         # for other callbacks to use.
-        for metric, value in reduced_logs.items():
+        for metric, value in zip(metrics, reduced_values):
             logs[metric] = value
 
     def on_epoch_end(self, epoch, logs=None):
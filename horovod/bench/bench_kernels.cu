@@ -0,0 +1,56 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "bench_kernels.h"
+
+#define GEMM_TILE 16
+
+namespace horovod {
+namespace bench {
+
+__global__ void gemm_k(const float* a, const float* b, float* c, int n) {
+  __shared__ float a_tile[GEMM_TILE][GEMM_TILE];
+  __shared__ float b_tile[GEMM_TILE][GEMM_TILE];
+
+  int row = blockIdx.y * GEMM_TILE + threadIdx.y;
+  int col = blockIdx.x * GEMM_TILE + threadIdx.x;
+  float sum = 0.0f;
+  for (int tile = 0; tile < n; tile += GEMM_TILE) {
+    int a_col = tile + threadIdx.x;
+    int b_row = tile + threadIdx.y;
+    a_tile[threadIdx.y][threadIdx.x] =
+        (row < n && a_col < n) ? a[row * n + a_col] : 0.0f;
+    b_tile[threadIdx.y][threadIdx.x] =
+        (b_row < n && col < n) ? b[b_row * n + col] : 0.0f;
+    __syncthreads();
+    for (int k = 0; k < GEMM_TILE; ++k) {
+      sum += a_tile[threadIdx.y][k] * b_tile[k][threadIdx.x];
+    }
+    __syncthreads();
+  }
+  if (row < n && col < n) {
+    c[row * n + col] = sum;
+  }
+}
+
+void BenchGemm(const float* a, const float* b, float* c, int n,
+               cudaStream_t stream) {
+  dim3 threads(GEMM_TILE, GEMM_TILE);
+  dim3 blocks((n + GEMM_TILE - 1) / GEMM_TILE, (n + GEMM_TILE - 1) / GEMM_TILE);
+  gemm_k<<<blocks, threads, 0, stream>>>(a, b, c, n);
+}
+
+} // namespace bench
+} // namespace horovod
@@ -0,0 +1,32 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_BENCH_KERNELS_H
+#define HOROVOD_BENCH_KERNELS_H
+
+#include <cuda_runtime.h>
+
+namespace horovod {
+namespace bench {
+
+// Computes c = a * b for square row-major matrices of dimension n, the
+// stand-in for the kernels of a backward pass.
+void BenchGemm(const float* a, const float* b, float* c, int n,
+               cudaStream_t stream);
+
+} // namespace bench
+} // namespace horovod
+
+#endif // HOROVOD_BENCH_KERNELS_H
@@ -0,0 +1,140 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "bench_util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#if HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+namespace horovod {
+namespace bench {
+
+BenchBuffer::BenchBuffer(int device, int64_t size) : device_(device) {
+#if HAVE_CUDA
+  if (device_ != CPU_DEVICE_ID) {
+    cudaSetDevice(device_);
+    if (cudaMalloc(&data_, size) != cudaSuccess) {
+      throw std::bad_alloc();
+    }
+    cudaMemset(data_, 0, size);
+    return;
+  }
+#endif
+  data_ = std::calloc(std::max<int64_t>(size, 1), 1);
+  if (data_ == nullptr) {
+    throw std::bad_alloc();
+  }
+}
+
+BenchBuffer::~BenchBuffer() {
+#if HAVE_CUDA
+  if (device_ != CPU_DEVICE_ID) {
+    cudaFree(data_);
+    return;
+  }
+#endif
+  std::free(data_);
+}
+
+bool ParseBytes(const std::string& value, int64_t& bytes) {
+  char* end;
+  long long number = std::strtoll(value.c_str(), &end, 10);
+  if (end == value.c_str() || number <= 0) {
+    return false;
+  }
+  std::string suffix(end);
+  if (suffix == "K" || suffix == "k") {
+    number <<= 10;
+  } else if (suffix == "M" || suffix == "m") {
+    number <<= 20;
+  } else if (suffix == "G" || suffix == "g") {
+    number <<= 30;
+  } else if (!suffix.empty()) {
+    return false;
+  }
+  bytes = number;
+  return true;
+}
+
+std::vector<std::string> Split(const std::string& value, char sep) {
+  std::vector<std::string> result;
+  std::stringstream stream(value);
+  std::string entry;
+  while (std::getline(stream, entry, sep)) {
+    result.push_back(entry);
+  }
+  return result;
+}
+
+double Percentile(std::vector<double> values, double percentile) {
+  std::sort(values.begin(), values.end());
+  auto index = (size_t)(percentile / 100.0 * (values.size() - 1) + 0.5);
+  return values[std::min(index, values.size() - 1)];
+}
+
+std::string FormatBytes(int64_t bytes) {
+  std::stringstream stream;
+  stream << std::fixed << std::setprecision(1);
+  if (bytes >= (1 << 20)) {
+    stream << (double)bytes / (1 << 20) << "MB";
+  } else if (bytes >= (1 << 10)) {
+    stream << (double)bytes / (1 << 10) << "KB";
+  } else {
+    stream << bytes << "B";
+  }
+  return stream.str();
+}
+
+bool ExportCoreOption(const std::string& key, const std::string& value) {
+  const std::vector<std::pair<std::string, std::string>> env_options = {
+      {"--fusion-size", "FUSION_SIZE"},
+      {"--block-num", "FUSION_BLOCK_NUM"},
+      {"--thread-num", "FUSION_THREAD_NUM"},
+      {"--num-streams", HOROVOD_NUM_NCCL_STREAMS},
+      {"--stream-assignment", HOROVOD_STREAM_ASSIGNMENT},
+      {"--hierarchical-allreduce", HOROVOD_HIERARCHICAL_ALLREDUCE}};
+  for (auto& env_option : env_options) {
+    if (key == env_option.first) {
+      setenv(env_option.second.c_str(), value.c_str(), 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WriteJson(const std::string& path, const std::string& json) {
+  if (path == "-") {
+    std::cout << json << std::endl;
+    return true;
+  }
+  std::ofstream file(path);
+  file << json << std::endl;
+  if (!file) {
+    std::cerr << "Failed to write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace bench
+} // namespace horovod
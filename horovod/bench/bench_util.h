@@ -0,0 +1,110 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_BENCH_UTIL_H
+#define HOROVOD_BENCH_UTIL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../common/common.h"
+
+namespace horovod {
+namespace bench {
+
+using namespace horovod::common;
+
+// Device memory when device is a GPU, host memory otherwise, zeroed.
+class BenchBuffer : public PersistentBuffer {
+public:
+  BenchBuffer(int device, int64_t size);
+  BenchBuffer(const BenchBuffer&) = delete;
+  ~BenchBuffer() override;
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return data_;
+  }
+  void* data() const { return data_; }
+
+private:
+  int device_;
+  void* data_ = nullptr;
+};
+
+class BenchTensor : public Tensor {
+public:
+  BenchTensor(int device, DataType dtype, const TensorShape& shape)
+      : dtype_(dtype), shape_(shape),
+        buffer_(device, shape.num_elements() * DataType_Size(dtype)) {}
+  const DataType dtype() const override { return dtype_; }
+  const TensorShape shape() const override { return shape_; }
+  const void* data() const override { return buffer_.data(); }
+  int64_t size() const override {
+    return shape_.num_elements() * DataType_Size(dtype_);
+  }
+
+private:
+  DataType dtype_;
+  TensorShape shape_;
+  BenchBuffer buffer_;
+};
+
+class BenchOpContext : public OpContext {
+public:
+  explicit BenchOpContext(int device) : device_(device) {}
+  Status AllocatePersistent(int64_t size,
+                            std::shared_ptr<PersistentBuffer>* tensor) override {
+    *tensor = std::make_shared<BenchBuffer>(device_, size);
+    return Status::OK();
+  }
+  Status AllocateOutput(TensorShape shape,
+                        std::shared_ptr<Tensor>* tensor) override {
+    *tensor = std::make_shared<BenchTensor>(device_, HOROVOD_FLOAT32, shape);
+    return Status::OK();
+  }
+  Status AllocateZeros(int64_t num_elements, DataType dtype,
+                       std::shared_ptr<Tensor>* tensor) override {
+    TensorShape shape;
+    shape.AddDim(num_elements);
+    *tensor = std::make_shared<BenchTensor>(device_, dtype, shape);
+    return Status::OK();
+  }
+  Framework framework() const override { return Framework::PYTORCH; }
+
+private:
+  int device_;
+};
+
+// Parses a byte count with an optional K, M or G suffix.
+bool ParseBytes(const std::string& value, int64_t& bytes);
+
+std::vector<std::string> Split(const std::string& value, char sep);
+
+// Exports an option that configures the core to its environment variable,
+// returns false if key is not one of them.
+bool ExportCoreOption(const std::string& key, const std::string& value);
+
+double Percentile(std::vector<double> values, double percentile);
+
+std::string FormatBytes(int64_t bytes);
+
+// Writes the results of a benchmark as a line of JSON to path, or to the
+// standard output if path is "-".
+bool WriteJson(const std::string& path, const std::string& json);
+
+} // namespace bench
+} // namespace horovod
+
+#endif // HOROVOD_BENCH_UTIL_H
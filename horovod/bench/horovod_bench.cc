@@ -0,0 +1,348 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Drives allreduces through the Horovod core without a framework, so that
+// configurations of fusion groups, streams and blocks/threads can be compared
+// on the same tensors. Run it with one process per device, e.g.
+//
+//   mpirun -np 4 horovod_bench --sizes=4M,1M,64K --num-tensors=160
+//       --fusion-size=40,40,40,40 --block-num=8,8,4,4 --thread-num=512,512,256,256
+//
+// The options that configure the core are exported as the corresponding
+// environment variables before Horovod is initialized, any other HOROVOD_*
+// variable of the environment applies as well.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#include "../common/operations.h"
+#include "bench_util.h"
+
+namespace horovod {
+namespace bench {
+
+using namespace horovod::common;
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchOptions {
+  std::vector<int64_t> sizes{4 << 20};
+  int64_t min_size = 0;
+  int64_t max_size = 0;
+  int num_tensors = 64;
+  int steps = 20;
+  int warmup_steps = 5;
+  unsigned seed = 1234;
+  DataType dtype = HOROVOD_FLOAT32;
+  bool gpu = false;
+  std::string json_path;
+};
+
+static void PrintUsage() {
+  std::cerr
+      << "Usage: horovod_bench [options]\n"
+      << "  --sizes=S[,S...]        tensor sizes in bytes (K/M/G suffixes), "
+         "cycled over the tensors (default 4M)\n"
+      << "  --size-range=MIN:MAX    draw tensor sizes log-uniformly from "
+         "[MIN, MAX] instead\n"
+      << "  --seed=N                seed of --size-range (default 1234)\n"
+      << "  --num-tensors=N         tensors per step (default 64)\n"
+      << "  --steps=N               measured steps (default 20)\n"
+      << "  --warmup-steps=N        steps before measuring (default 5)\n"
+      << "  --dtype=float32|float16 element type (default float32)\n"
+      << "  --device=cpu|gpu        where the tensors live (default cpu)\n"
+      << "  --fusion-size=SPEC      FUSION_SIZE\n"
+      << "  --block-num=SPEC        FUSION_BLOCK_NUM\n"
+      << "  --thread-num=SPEC       FUSION_THREAD_NUM\n"
+      << "  --num-streams=N         HOROVOD_NUM_NCCL_STREAMS\n"
+      << "  --stream-assignment=SPEC HOROVOD_STREAM_ASSIGNMENT\n"
+      << "  --hierarchical-allreduce=0|1 HOROVOD_HIERARCHICAL_ALLREDUCE\n"
+      << "  --json=PATH             also write the results as JSON to PATH, "
+         "- for stdout\n";
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    auto eq = arg.find('=');
+    if (arg == "--help" || eq == std::string::npos) {
+      return false;
+    }
+    std::string key = arg.substr(0, eq);
+    std::string value = arg.substr(eq + 1);
+
+    if (ExportCoreOption(key, value)) {
+      continue;
+    }
+
+    if (key == "--sizes") {
+      options.sizes.clear();
+      for (auto& entry : Split(value, ',')) {
+        int64_t bytes;
+        if (!ParseBytes(entry, bytes)) {
+          return false;
+        }
+        options.sizes.push_back(bytes);
+      }
+    } else if (key == "--size-range") {
+      auto range = Split(value, ':');
+      if (range.size() != 2 || !ParseBytes(range[0], options.min_size) ||
+          !ParseBytes(range[1], options.max_size) ||
+          options.min_size > options.max_size) {
+        return false;
+      }
+    } else if (key == "--seed") {
+      options.seed = (unsigned)std::strtoul(value.c_str(), nullptr, 10);
+    } else if (key == "--num-tensors") {
+      options.num_tensors = std::atoi(value.c_str());
+    } else if (key == "--steps") {
+      options.steps = std::atoi(value.c_str());
+    } else if (key == "--warmup-steps") {
+      options.warmup_steps = std::atoi(value.c_str());
+    } else if (key == "--dtype" && value == "float32") {
+      options.dtype = HOROVOD_FLOAT32;
+    } else if (key == "--dtype" && value == "float16") {
+      options.dtype = HOROVOD_FLOAT16;
+    } else if (key == "--device" && (value == "cpu" || value == "gpu")) {
+      options.gpu = value == "gpu";
+    } else if (key == "--json") {
+      options.json_path = value;
+    } else {
+      return false;
+    }
+  }
+  return options.num_tensors > 0 && options.steps > 0 &&
+         options.warmup_steps >= 0 && !options.sizes.empty();
+}
+
+// Tensor sizes in bytes, the same on every rank.
+static std::vector<int64_t> TensorSizes(const BenchOptions& options) {
+  std::vector<int64_t> sizes;
+  std::mt19937 generator(options.seed);
+  std::uniform_real_distribution<double> log_size(
+      std::log((double)std::max<int64_t>(options.min_size, 1)),
+      std::log((double)std::max<int64_t>(options.max_size, 1)));
+  auto element_size = (int64_t)DataType_Size(options.dtype);
+  for (int i = 0; i < options.num_tensors; ++i) {
+    int64_t bytes = options.max_size > 0
+                        ? (int64_t)std::exp(log_size(generator))
+                        : options.sizes[i % options.sizes.size()];
+    sizes.push_back(std::max<int64_t>(bytes / element_size, 1) * element_size);
+  }
+  return sizes;
+}
+
+// The first and one past the last tensor of each group, from FUSION_SIZE if
+// it only holds tensor counts, a single group otherwise.
+static std::vector<std::pair<int, int>> TensorGroups(int num_tensors) {
+  std::vector<std::pair<int, int>> groups;
+  const char* fusion_size = std::getenv("FUSION_SIZE");
+  if (fusion_size != nullptr) {
+    int begin = 0;
+    for (auto& entry : Split(fusion_size, ',')) {
+      char* end;
+      long count = std::strtol(entry.c_str(), &end, 10);
+      if (end == entry.c_str() || *end != '\0' || count <= 0) {
+        groups.clear();
+        break;
+      }
+      int group_end = std::min(begin + (int)count, num_tensors);
+      if (begin < group_end) {
+        groups.emplace_back(begin, group_end);
+      }
+      begin = group_end;
+    }
+    if (!groups.empty() && begin < num_tensors) {
+      groups.emplace_back(begin, num_tensors);
+    }
+  }
+  if (groups.empty()) {
+    groups.emplace_back(0, num_tensors);
+  }
+  return groups;
+}
+
+int Run(int argc, char** argv) {
+  BenchOptions options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage();
+    return 1;
+  }
+#if !HAVE_CUDA
+  if (options.gpu) {
+    std::cerr << "horovod_bench was built without CUDA support." << std::endl;
+    return 1;
+  }
+#endif
+
+  horovod_init(nullptr, 0);
+  int rank = horovod_rank();
+  int size = horovod_size();
+  if (rank < 0) {
+    std::cerr << "Horovod failed to initialize." << std::endl;
+    return 1;
+  }
+  int device = CPU_DEVICE_ID;
+#if HAVE_CUDA
+  if (options.gpu) {
+    device = horovod_local_rank();
+    cudaSetDevice(device);
+  }
+#endif
+
+  auto sizes = TensorSizes(options);
+  auto groups = TensorGroups(options.num_tensors);
+  auto context = std::make_shared<BenchOpContext>(device);
+  std::vector<std::shared_ptr<Tensor>> tensors;
+  std::vector<std::shared_ptr<Tensor>> outputs;
+  int64_t step_bytes = 0;
+  for (auto bytes : sizes) {
+    TensorShape shape;
+    shape.AddDim(bytes / (int64_t)DataType_Size(options.dtype));
+    tensors.push_back(std::make_shared<BenchTensor>(device, options.dtype, shape));
+    outputs.push_back(std::make_shared<BenchTensor>(device, options.dtype, shape));
+    step_bytes += bytes;
+  }
+
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  int pending = 0;
+  Status failure = Status::OK();
+  std::vector<Clock::time_point> done_at(tensors.size());
+
+  std::vector<double> step_seconds;
+  std::vector<std::vector<double>> group_seconds(groups.size());
+  for (int step = 0; step < options.warmup_steps + options.steps; ++step) {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      pending = (int)tensors.size();
+    }
+    auto start = Clock::now();
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      auto status = EnqueueTensorAllreduce(
+          context, tensors[i], outputs[i], nullptr,
+          "bench.allreduce." + std::to_string(i), device,
+          [&, i](const Status& status) {
+            std::lock_guard<std::mutex> guard(mutex);
+            done_at[i] = Clock::now();
+            if (!status.ok()) {
+              failure = status;
+            }
+            if (--pending == 0) {
+              done_cv.notify_all();
+            }
+          });
+      if (!status.ok()) {
+        std::cerr << "Enqueue failed: " << status.reason() << std::endl;
+        horovod_shutdown();
+        return 1;
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&] { return pending == 0; });
+    if (!failure.ok()) {
+      std::cerr << "Allreduce failed: " << failure.reason() << std::endl;
+      lock.unlock();
+      horovod_shutdown();
+      return 1;
+    }
+    if (step < options.warmup_steps) {
+      continue;
+    }
+
+    auto end = *std::max_element(done_at.begin(), done_at.end());
+    step_seconds.push_back(std::chrono::duration<double>(end - start).count());
+    for (size_t g = 0; g < groups.size(); ++g) {
+      auto group_end = *std::max_element(done_at.begin() + groups[g].first,
+                                         done_at.begin() + groups[g].second);
+      group_seconds[g].push_back(
+          std::chrono::duration<double>(group_end - start).count());
+    }
+  }
+
+  if (rank == 0) {
+    double median = Percentile(step_seconds, 50);
+    double algbw = (double)step_bytes / median / 1e9;
+    double busbw = algbw * 2.0 * (size - 1) / size;
+    std::cout << std::fixed << std::setprecision(3) << "ranks " << size
+              << ", " << tensors.size() << " tensors, "
+              << FormatBytes(step_bytes) << " per step, " << options.steps
+              << " steps" << std::endl;
+    std::cout << "step time ms: median " << median * 1e3 << ", p90 "
+              << Percentile(step_seconds, 90) * 1e3 << ", max "
+              << Percentile(step_seconds, 100) * 1e3 << std::endl;
+    std::cout << "algbw " << algbw << " GB/s, busbw " << busbw << " GB/s"
+              << std::endl;
+    for (size_t g = 0; g < groups.size(); ++g) {
+      int64_t group_bytes = 0;
+      for (int i = groups[g].first; i < groups[g].second; ++i) {
+        group_bytes += sizes[i];
+      }
+      std::cout << "group " << g << " (" << groups[g].second - groups[g].first
+                << " tensors, " << FormatBytes(group_bytes)
+                << ") done after ms: median "
+                << Percentile(group_seconds[g], 50) * 1e3 << ", p90 "
+                << Percentile(group_seconds[g], 90) * 1e3 << std::endl;
+    }
+
+    if (!options.json_path.empty()) {
+      std::stringstream json;
+      json << std::fixed << std::setprecision(6) << "{\"ranks\": " << size
+           << ", \"tensors\": " << tensors.size()
+           << ", \"step_bytes\": " << step_bytes
+           << ", \"step_ms\": {\"p50\": " << median * 1e3
+           << ", \"p90\": " << Percentile(step_seconds, 90) * 1e3
+           << ", \"p99\": " << Percentile(step_seconds, 99) * 1e3
+           << ", \"max\": " << Percentile(step_seconds, 100) * 1e3
+           << "}, \"algbw_gbps\": " << algbw << ", \"busbw_gbps\": " << busbw
+           << ", \"groups\": [";
+      for (size_t g = 0; g < groups.size(); ++g) {
+        json << (g > 0 ? ", " : "")
+             << "{\"tensors\": " << groups[g].second - groups[g].first
+             << ", \"p50_ms\": " << Percentile(group_seconds[g], 50) * 1e3
+             << ", \"p99_ms\": " << Percentile(group_seconds[g], 99) * 1e3
+             << "}";
+      }
+      json << "]}";
+      if (!WriteJson(options.json_path, json.str())) {
+        horovod_shutdown();
+        return 1;
+      }
+    }
+  }
+
+  horovod_shutdown();
+  return 0;
+}
+
+} // namespace bench
+} // namespace horovod
+
+int main(int argc, char** argv) { return horovod::bench::Run(argc, argv); }
@@ -0,0 +1,352 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Measures the work of the coordinator during negotiation at simulated
+// scale, in a single process. The controller plays rank zero of a job of
+// --ranks ranks, and the other ranks send the same tensors through memory:
+// their request lists are parsed from bytes like the ones received by the
+// MPI and Gloo controllers, and the response list is serialized like the one
+// they broadcast. Collectives across ranks are no-ops, so the results are the
+// CPU time of the coordinator without the network.
+//
+//   horovod_negotiation_bench --ranks=64,512,4096 --tensors=64,256,1024
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../common/controller.h"
+#include "../common/global_state.h"
+
+namespace horovod {
+namespace bench {
+
+using namespace horovod::common;
+
+typedef std::chrono::steady_clock Clock;
+
+// Ranks per node of the simulated job.
+#define SIMULATED_LOCAL_SIZE 8
+
+class ShapeOnlyTensor : public Tensor {
+public:
+  ShapeOnlyTensor(DataType dtype, const TensorShape& shape)
+      : dtype_(dtype), shape_(shape) {}
+  const DataType dtype() const override { return dtype_; }
+  const TensorShape shape() const override { return shape_; }
+  const void* data() const override { return nullptr; }
+  int64_t size() const override {
+    return shape_.num_elements() * DataType_Size(dtype_);
+  }
+
+private:
+  DataType dtype_;
+  TensorShape shape_;
+};
+
+class SimulatedController : public Controller {
+public:
+  SimulatedController(HorovodGlobalState& state, int size)
+      : Controller(state.response_cache, state.tensor_queue, state.timeline,
+                   state.parameter_manager, state.metrics),
+        simulated_size_(size) {}
+
+  // The request list every other rank sends in the next cycle.
+  void SetRemoteRequests(const RequestList& requests) {
+    RequestList::SerializeToString(requests, remote_requests_);
+  }
+
+  int GetTypeSize(DataType dtype) override { return (int)DataType_Size(dtype); }
+  void CrossRankBitwiseAnd(std::vector<long long>& bitvector,
+                           int count) override {}
+  void CrossRankBitwiseOr(std::vector<long long>& bitvector,
+                          int count) override {}
+  void CrossRankSum(std::vector<double>& values) override {}
+  void Bcast(void* buffer, size_t size, int root_rank,
+             Communicator communicator) override {}
+  void AlltoallGetRecvSplits(const std::vector<int32_t>& splits,
+                             std::vector<int32_t>& recvsplits) override {
+    recvsplits = splits;
+  }
+  void Barrier(Communicator communicator) override {}
+  void ProcessSetBcast(void* buffer, size_t size,
+                       int32_t process_set_id) override {}
+
+  // The phases of the coordinator, measured on their own.
+  bool AddRequest(const Request& request) {
+    return IncrementTensorCount(request);
+  }
+  Response Construct(std::string& name) { return ConstructResponse(name); }
+  ResponseList Fuse(std::deque<Response>& responses) {
+    return FuseResponses(responses);
+  }
+  void SyncCache(CacheCoordinator& cache_coordinator) {
+    CoordinateCacheAndState(cache_coordinator);
+  }
+
+protected:
+  void DoInitialization() override {
+    rank_ = 0;
+    size_ = simulated_size_;
+    local_rank_ = 0;
+    local_size_ = std::min(SIMULATED_LOCAL_SIZE, size_);
+    cross_rank_ = 0;
+    cross_size_ = (size_ + local_size_ - 1) / local_size_;
+    is_coordinator_ = true;
+    is_homogeneous_ = size_ % local_size_ == 0;
+    local_comm_ranks_.clear();
+    for (int i = 0; i < local_size_; ++i) {
+      local_comm_ranks_.push_back(i);
+    }
+    local_sizes_for_cross_rank_.assign(cross_size_, local_size_);
+  }
+
+  void DoInitializeProcessSets() override { process_sets_.Clear(); }
+
+  void RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
+                        std::vector<RequestListView>& ready_list) override {
+    ready_list.resize(size_);
+    for (int i = 1; i < size_; ++i) {
+      ready_list[i] = RequestListView((const uint8_t*)remote_requests_.data());
+    }
+  }
+
+  void SendReadyTensors(RequestList& message_list) override {}
+
+  void SendFinalTensors(ResponseList& response_list) override {
+    std::string encoded_response;
+    ResponseList::SerializeToString(response_list, encoded_response);
+  }
+
+  void RecvFinalTensors(ResponseList& response_list) override {}
+
+private:
+  int simulated_size_;
+  std::string remote_requests_;
+};
+
+struct BenchOptions {
+  std::vector<int> ranks{64, 512, 4096};
+  std::vector<int> tensors{64, 256, 1024};
+  int64_t tensor_bytes = 1 << 20;
+  int cycles = 10;
+};
+
+static bool ParseIntList(const std::string& value, std::vector<int>& result) {
+  result.clear();
+  std::stringstream stream(value);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) {
+    int number = std::atoi(entry.c_str());
+    if (number <= 0) {
+      return false;
+    }
+    result.push_back(number);
+  }
+  return !result.empty();
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    auto eq = arg.find('=');
+    if (eq == std::string::npos) {
+      return false;
+    }
+    std::string key = arg.substr(0, eq);
+    std::string value = arg.substr(eq + 1);
+    if (key == "--ranks") {
+      if (!ParseIntList(value, options.ranks)) {
+        return false;
+      }
+    } else if (key == "--tensors") {
+      if (!ParseIntList(value, options.tensors)) {
+        return false;
+      }
+    } else if (key == "--tensor-bytes") {
+      options.tensor_bytes = std::atoll(value.c_str());
+    } else if (key == "--cycles") {
+      options.cycles = std::atoi(value.c_str());
+    } else {
+      return false;
+    }
+  }
+  return options.tensor_bytes >= 4 && options.cycles > 0;
+}
+
+static double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+static double MillisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+struct SimulatedJob {
+  SimulatedJob(int ranks, int num_tensors, int64_t tensor_bytes) {
+    controller = std::make_shared<SimulatedController>(state, ranks);
+    state.controller = controller;
+    controller->Initialize();
+
+    TensorShape shape;
+    shape.AddDim(tensor_bytes / (int64_t)DataType_Size(HOROVOD_FLOAT32));
+    tensor = std::make_shared<ShapeOnlyTensor>(HOROVOD_FLOAT32, shape);
+    for (int i = 0; i < num_tensors; ++i) {
+      Request request;
+      request.set_request_rank(0);
+      request.set_request_type(Request::ALLREDUCE);
+      request.set_tensor_type(HOROVOD_FLOAT32);
+      request.set_tensor_name("bench.allreduce." + std::to_string(i));
+      request.set_device(CPU_DEVICE_ID);
+      request.set_tensor_shape(shape.to_vector());
+      requests.push_back(request);
+    }
+
+    RequestList remote_requests;
+    for (auto request : requests) {
+      request.set_request_rank(1);
+      remote_requests.add_request(request);
+    }
+    controller->SetRemoteRequests(remote_requests);
+  }
+
+  // Enqueues the tensors of one step on the coordinator.
+  void Enqueue() {
+    for (auto request : requests) {
+      TensorTableEntry e;
+      e.tensor_name = request.tensor_name();
+      e.tensor = tensor;
+      e.output = tensor;
+      e.callback = [](const Status& status) {};
+      state.tensor_queue.AddToTensorQueue(e, request);
+    }
+  }
+
+  // Runs a cycle of the background loop up to the execution of the
+  // responses, returns its time in milliseconds.
+  double Cycle() {
+    auto start = Clock::now();
+    auto response_list = controller->ComputeResponseList(shut_down, state);
+    double elapsed = MillisSince(start);
+    for (auto& response : response_list.responses()) {
+      std::vector<TensorTableEntry> entries;
+      state.tensor_queue.GetTensorEntriesFromResponse(response, entries);
+    }
+    return elapsed;
+  }
+
+  HorovodGlobalState state;
+  std::shared_ptr<SimulatedController> controller;
+  std::shared_ptr<Tensor> tensor;
+  std::vector<Request> requests;
+  std::atomic_bool shut_down{false};
+};
+
+static void Run(const BenchOptions& options, int ranks, int num_tensors) {
+  std::vector<double> uncached, cached, construct, fuse, sync;
+  for (int cycle = 0; cycle < options.cycles; ++cycle) {
+    // Every cycle negotiates all tensors of a step, without the cache.
+    // The global state is too large for the stack.
+    {
+      std::unique_ptr<SimulatedJob> uncached_job(
+          new SimulatedJob(ranks, num_tensors, options.tensor_bytes));
+      uncached_job->state.response_cache.set_capacity(0);
+      uncached_job->Enqueue();
+      uncached.push_back(uncached_job->Cycle());
+    }
+
+    // Steady state: every tensor is a cache hit on every rank.
+    std::unique_ptr<SimulatedJob> cached_job(
+        new SimulatedJob(ranks, num_tensors, options.tensor_bytes));
+    auto& job = *cached_job;
+    job.state.response_cache.set_capacity((uint32_t)num_tensors);
+    job.Enqueue();
+    job.Cycle();
+    job.Enqueue();
+    cached.push_back(job.Cycle());
+
+    // The coordinator's phases on their own.
+    for (auto& request : job.requests) {
+      for (int rank = 0; rank < ranks; ++rank) {
+        request.set_request_rank(rank);
+        job.controller->AddRequest(request);
+      }
+    }
+    std::deque<Response> responses;
+    auto start = Clock::now();
+    for (auto& request : job.requests) {
+      std::string name = request.tensor_name();
+      responses.push_back(job.controller->Construct(name));
+    }
+    construct.push_back(MillisSince(start));
+
+    job.Enqueue();
+    start = Clock::now();
+    auto response_list = job.controller->Fuse(responses);
+    fuse.push_back(MillisSince(start));
+    for (auto& response : response_list.responses()) {
+      std::vector<TensorTableEntry> entries;
+      job.state.tensor_queue.GetTensorEntriesFromResponse(response, entries);
+    }
+
+    CacheCoordinator cache_coordinator(
+        job.state.response_cache.num_active_bits());
+    for (uint32_t bit : job.state.response_cache.list_all_bits()) {
+      cache_coordinator.record_hit(bit);
+    }
+    start = Clock::now();
+    job.controller->SyncCache(cache_coordinator);
+    sync.push_back(MillisSince(start));
+  }
+
+  std::cout << std::setw(8) << ranks << std::setw(9) << num_tensors
+            << std::fixed << std::setprecision(3) << std::setw(14)
+            << Median(uncached) << std::setw(12) << Median(cached)
+            << std::setw(12) << Median(construct) << std::setw(10)
+            << Median(fuse) << std::setw(12) << Median(sync) << std::endl;
+}
+
+} // namespace bench
+} // namespace horovod
+
+int main(int argc, char** argv) {
+  horovod::bench::BenchOptions options;
+  if (!horovod::bench::ParseOptions(argc, argv, options)) {
+    std::cerr << "Usage: horovod_negotiation_bench [--ranks=N[,N...]] "
+                 "[--tensors=N[,N...]] [--tensor-bytes=N] [--cycles=N]"
+              << std::endl;
+    return 1;
+  }
+  std::cout << "Median coordinator time in ms over " << options.cycles
+            << " cycles" << std::endl;
+  std::cout << std::setw(8) << "ranks" << std::setw(9) << "tensors"
+            << std::setw(14) << "uncached" << std::setw(12) << "cached"
+            << std::setw(12) << "construct" << std::setw(10) << "fuse"
+            << std::setw(12) << "cache sync" << std::endl;
+  for (auto ranks : options.ranks) {
+    for (auto num_tensors : options.tensors) {
+      horovod::bench::Run(options, ranks, num_tensors);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,408 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Measures how well the allreduces of the gradients overlap with a backward
+// pass. A sequence of GEMM kernels on a compute stream stands in for
+// backward, and the gradient of each layer is enqueued to Horovod as soon as
+// its kernels are launched, with a ready event recorded after them, like the
+// framework ops do. Run it with one process per GPU, e.g.
+//
+//   mpirun -np 4 horovod_overlap_bench --layers=24 --gemm-dim=1024
+//       --sizes=4M --fusion-size=8,8,8 --block-num=8,4,4
+//
+// Every step runs the backward pass alone, the allreduces alone and then both
+// together, and reports the slowdown of the compute caused by the kernels of
+// the allreduces competing for the SMs, and the communication left exposed
+// after the end of the backward pass.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+#include "../common/operations.h"
+#include "bench_kernels.h"
+#include "bench_util.h"
+
+namespace horovod {
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+class BenchReadyEvent : public ReadyEvent {
+public:
+  explicit BenchReadyEvent(cudaEvent_t event) : event_(event) {}
+  bool Ready() const override {
+    return cudaEventQuery(event_) != cudaErrorNotReady;
+  }
+  gpuEvent_t event() const override { return event_; }
+
+private:
+  cudaEvent_t event_;
+};
+
+struct OverlapOptions {
+  int layers = 24;
+  int gemm_dim = 1024;
+  int gemms_per_layer = 4;
+  std::vector<int64_t> sizes{4 << 20};
+  int steps = 20;
+  int warmup_steps = 5;
+  std::string json_path;
+};
+
+static void PrintUsage() {
+  std::cerr
+      << "Usage: horovod_overlap_bench [options]\n"
+      << "  --layers=N              layers of the backward pass, one gradient "
+         "each (default 24)\n"
+      << "  --gemm-dim=N            dimension of the square GEMMs (default "
+         "1024)\n"
+      << "  --gemms-per-layer=N     GEMMs before each gradient is ready "
+         "(default 4)\n"
+      << "  --sizes=S[,S...]        gradient sizes in bytes (K/M/G suffixes), "
+         "cycled over the layers (default 4M)\n"
+      << "  --steps=N               measured steps (default 20)\n"
+      << "  --warmup-steps=N        steps before measuring (default 5)\n"
+      << "  --fusion-size=SPEC      FUSION_SIZE\n"
+      << "  --block-num=SPEC        FUSION_BLOCK_NUM\n"
+      << "  --thread-num=SPEC       FUSION_THREAD_NUM\n"
+      << "  --num-streams=N         HOROVOD_NUM_NCCL_STREAMS\n"
+      << "  --stream-assignment=SPEC HOROVOD_STREAM_ASSIGNMENT\n"
+      << "  --hierarchical-allreduce=0|1 HOROVOD_HIERARCHICAL_ALLREDUCE\n"
+      << "  --json=PATH             also write the results as JSON to PATH, "
+         "- for stdout\n";
+}
+
+static bool ParseOptions(int argc, char** argv, OverlapOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    auto eq = arg.find('=');
+    if (arg == "--help" || eq == std::string::npos) {
+      return false;
+    }
+    std::string key = arg.substr(0, eq);
+    std::string value = arg.substr(eq + 1);
+    if (ExportCoreOption(key, value)) {
+      continue;
+    }
+
+    if (key == "--layers") {
+      options.layers = std::atoi(value.c_str());
+    } else if (key == "--gemm-dim") {
+      options.gemm_dim = std::atoi(value.c_str());
+    } else if (key == "--gemms-per-layer") {
+      options.gemms_per_layer = std::atoi(value.c_str());
+    } else if (key == "--sizes") {
+      options.sizes.clear();
+      for (auto& entry : Split(value, ',')) {
+        int64_t bytes;
+        if (!ParseBytes(entry, bytes)) {
+          return false;
+        }
+        options.sizes.push_back(bytes);
+      }
+    } else if (key == "--steps") {
+      options.steps = std::atoi(value.c_str());
+    } else if (key == "--warmup-steps") {
+      options.warmup_steps = std::atoi(value.c_str());
+    } else if (key == "--json") {
+      options.json_path = value;
+    } else {
+      return false;
+    }
+  }
+  return options.layers > 0 && options.gemm_dim > 0 &&
+         options.gemms_per_layer > 0 && !options.sizes.empty() &&
+         options.steps > 0 && options.warmup_steps >= 0;
+}
+
+static double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+class OverlapBench {
+public:
+  OverlapBench(const OverlapOptions& options, int device);
+  ~OverlapBench();
+
+  // Runs the backward pass, and the allreduce of each gradient once it is
+  // ready if overlap is set. Returns the time of the compute stream.
+  double Backward(bool overlap);
+  // Allreduces the gradients, all ready from the start.
+  void Allreduce();
+  // Waits for the allreduces of the step.
+  Status Wait();
+  // Lines the ranks up before a measurement with a one element allreduce.
+  Status Barrier();
+
+private:
+  void Enqueue(std::shared_ptr<Tensor> tensor, std::shared_ptr<Tensor> output,
+               std::shared_ptr<ReadyEvent> ready_event,
+               const std::string& name);
+
+  const OverlapOptions& options_;
+  int device_;
+  cudaStream_t stream_;
+  cudaEvent_t start_;
+  cudaEvent_t end_;
+  std::vector<cudaEvent_t> ready_events_;
+  std::shared_ptr<BenchOpContext> context_;
+  std::shared_ptr<BenchBuffer> a_;
+  std::shared_ptr<BenchBuffer> b_;
+  std::shared_ptr<BenchBuffer> c_;
+  std::vector<std::shared_ptr<Tensor>> gradients_;
+  std::vector<std::shared_ptr<Tensor>> outputs_;
+  std::shared_ptr<Tensor> barrier_;
+
+  std::mutex mutex_;
+  std::condition_variable done_cv_;
+  int pending_ = 0;
+  Status failure_ = Status::OK();
+};
+
+OverlapBench::OverlapBench(const OverlapOptions& options, int device)
+    : options_(options), device_(device),
+      context_(std::make_shared<BenchOpContext>(device)) {
+  cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking);
+  cudaEventCreate(&start_);
+  cudaEventCreate(&end_);
+  ready_events_.resize(options_.layers);
+  for (auto& event : ready_events_) {
+    cudaEventCreateWithFlags(&event, cudaEventDisableTiming);
+  }
+
+  int64_t matrix_bytes =
+      (int64_t)options_.gemm_dim * options_.gemm_dim * sizeof(float);
+  a_ = std::make_shared<BenchBuffer>(device_, matrix_bytes);
+  b_ = std::make_shared<BenchBuffer>(device_, matrix_bytes);
+  c_ = std::make_shared<BenchBuffer>(device_, matrix_bytes);
+  for (int layer = 0; layer < options_.layers; ++layer) {
+    TensorShape shape;
+    shape.AddDim(options_.sizes[layer % options_.sizes.size()] /
+                 (int64_t)sizeof(float));
+    gradients_.push_back(
+        std::make_shared<BenchTensor>(device_, HOROVOD_FLOAT32, shape));
+    outputs_.push_back(
+        std::make_shared<BenchTensor>(device_, HOROVOD_FLOAT32, shape));
+  }
+  TensorShape barrier_shape;
+  barrier_shape.AddDim(1);
+  barrier_ =
+      std::make_shared<BenchTensor>(device_, HOROVOD_FLOAT32, barrier_shape);
+}
+
+OverlapBench::~OverlapBench() {
+  for (auto& event : ready_events_) {
+    cudaEventDestroy(event);
+  }
+  cudaEventDestroy(start_);
+  cudaEventDestroy(end_);
+  cudaStreamDestroy(stream_);
+}
+
+void OverlapBench::Enqueue(std::shared_ptr<Tensor> tensor,
+                           std::shared_ptr<Tensor> output,
+                           std::shared_ptr<ReadyEvent> ready_event,
+                           const std::string& name) {
+  auto status = EnqueueTensorAllreduce(
+      context_, tensor, output, ready_event, name, device_,
+      [this](const Status& status) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!status.ok()) {
+          failure_ = status;
+        }
+        if (--pending_ == 0) {
+          done_cv_.notify_all();
+        }
+      });
+  if (!status.ok()) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    failure_ = status;
+    --pending_;
+  }
+}
+
+double OverlapBench::Backward(bool overlap) {
+  if (overlap) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_ = options_.layers;
+  }
+  auto a = (const float*)a_->data();
+  auto b = (const float*)b_->data();
+  auto c = (float*)c_->data();
+  cudaEventRecord(start_, stream_);
+  // The last layer first, like a backward pass.
+  for (int layer = options_.layers - 1; layer >= 0; --layer) {
+    for (int i = 0; i < options_.gemms_per_layer; ++i) {
+      BenchGemm(a, b, c, options_.gemm_dim, stream_);
+    }
+    if (overlap) {
+      cudaEventRecord(ready_events_[layer], stream_);
+      Enqueue(gradients_[layer], outputs_[layer],
+              std::make_shared<BenchReadyEvent>(ready_events_[layer]),
+              "bench.gradient." + std::to_string(layer));
+    }
+  }
+  cudaEventRecord(end_, stream_);
+  cudaEventSynchronize(end_);
+  float milliseconds = 0;
+  cudaEventElapsedTime(&milliseconds, start_, end_);
+  return milliseconds / 1e3;
+}
+
+void OverlapBench::Allreduce() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_ = options_.layers;
+  }
+  for (int layer = options_.layers - 1; layer >= 0; --layer) {
+    Enqueue(gradients_[layer], outputs_[layer], nullptr,
+            "bench.gradient." + std::to_string(layer));
+  }
+}
+
+Status OverlapBench::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&] { return pending_ == 0; });
+  return failure_;
+}
+
+Status OverlapBench::Barrier() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_ = 1;
+  }
+  Enqueue(barrier_, barrier_, nullptr, "bench.barrier");
+  return Wait();
+}
+
+int Run(int argc, char** argv) {
+  OverlapOptions options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage();
+    return 1;
+  }
+
+  horovod_init(nullptr, 0);
+  int rank = horovod_rank();
+  if (rank < 0) {
+    std::cerr << "Horovod failed to initialize." << std::endl;
+    return 1;
+  }
+  int device = horovod_local_rank();
+  cudaSetDevice(device);
+
+  std::vector<double> compute_alone, comm_alone, step_time, compute_overlapped;
+  {
+    OverlapBench bench(options, device);
+    for (int step = 0; step < options.warmup_steps + options.steps; ++step) {
+      double compute = bench.Backward(false);
+
+      auto status = bench.Barrier();
+      auto start = Clock::now();
+      double comm = 0, overlapped = 0, step_seconds = 0;
+      if (status.ok()) {
+        bench.Allreduce();
+        status = bench.Wait();
+        comm = SecondsSince(start);
+      }
+
+      if (status.ok()) {
+        status = bench.Barrier();
+      }
+      if (status.ok()) {
+        start = Clock::now();
+        overlapped = bench.Backward(true);
+        status = bench.Wait();
+        step_seconds = SecondsSince(start);
+      }
+      if (!status.ok()) {
+        std::cerr << "Allreduce failed: " << status.reason() << std::endl;
+        horovod_shutdown();
+        return 1;
+      }
+
+      if (step >= options.warmup_steps) {
+        compute_alone.push_back(compute);
+        comm_alone.push_back(comm);
+        compute_overlapped.push_back(overlapped);
+        step_time.push_back(step_seconds);
+      }
+    }
+  }
+
+  if (rank == 0) {
+    // Medians of the per step ratios, so that a noisy step does not pair with
+    // the median of another.
+    std::vector<double> slowdown, exposed;
+    for (int i = 0; i < options.steps; ++i) {
+      slowdown.push_back(compute_overlapped[i] / compute_alone[i] - 1.0);
+      exposed.push_back(std::max(step_time[i] - compute_overlapped[i], 0.0));
+    }
+    double exposed_ms = Percentile(exposed, 50) * 1e3;
+    double comm_ms = Percentile(comm_alone, 50) * 1e3;
+    std::cout << std::fixed << std::setprecision(3) << "ranks "
+              << horovod_size() << ", " << options.layers << " layers of "
+              << options.gemms_per_layer << " GEMMs of dimension "
+              << options.gemm_dim << ", " << options.steps << " steps"
+              << std::endl;
+    std::cout << "backward alone ms: " << Percentile(compute_alone, 50) * 1e3
+              << ", allreduces alone ms: " << comm_ms << std::endl;
+    std::cout << "step time ms: median " << Percentile(step_time, 50) * 1e3
+              << ", p90 " << Percentile(step_time, 90) * 1e3 << std::endl;
+    std::cout << "backward overlapped ms: "
+              << Percentile(compute_overlapped, 50) * 1e3
+              << ", compute slowdown " << Percentile(slowdown, 50) * 100 << "%"
+              << std::endl;
+    std::cout << "exposed comm ms: median " << exposed_ms << ", p90 "
+              << Percentile(exposed, 90) * 1e3 << ", hidden "
+              << std::max(1.0 - exposed_ms / comm_ms, 0.0) * 100 << "%"
+              << std::endl;
+
+    if (!options.json_path.empty()) {
+      std::stringstream json;
+      json << std::fixed << std::setprecision(6)
+           << "{\"ranks\": " << horovod_size()
+           << ", \"backward_ms\": " << Percentile(compute_alone, 50) * 1e3
+           << ", \"comm_ms\": " << comm_ms
+           << ", \"step_ms\": {\"p50\": " << Percentile(step_time, 50) * 1e3
+           << ", \"p99\": " << Percentile(step_time, 99) * 1e3
+           << "}, \"compute_slowdown\": " << Percentile(slowdown, 50)
+           << ", \"exposed_comm_ms\": {\"p50\": " << exposed_ms
+           << ", \"p99\": " << Percentile(exposed, 99) * 1e3 << "}}";
+      if (!WriteJson(options.json_path, json.str())) {
+        horovod_shutdown();
+        return 1;
+      }
+    }
+  }
+
+  horovod_shutdown();
+  return 0;
+}
+
+} // namespace bench
+} // namespace horovod
+
+int main(int argc, char** argv) { return horovod::bench::Run(argc, argv); }
@@ -0,0 +1,194 @@
+# Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Runs a fixed matrix of horovod_bench and horovod_overlap_bench configurations,
+writes their results as JSON and compares them against a baseline, e.g.
+
+    python horovod/bench/perf_regression.py --bench-dir=build/horovod/bench \\
+        --np=4 --device=gpu --output=results.json --baseline=baseline.json
+
+The exit code is 1 if a configuration failed, or if a metric regressed against
+the baseline by more than the tolerances. Results written on a reference build
+can be used as the baseline of later runs.
+"""
+
+import argparse
+import itertools
+import json
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+
+# Tensor counts and sizes of the allreduces of a step.
+SIZE_MIXES = [
+    ('uniform-4M', 32, ['--sizes=4M']),
+    ('mixed', 96, ['--sizes=4M,1M,64K']),
+    ('log-uniform', 128, ['--size-range=4K:16M']),
+]
+
+STREAM_COUNTS = [1, 2]
+HIERARCHICAL = [0, 1]
+
+
+def libra_plan(num_tensors):
+    """Four fusion groups, the first two with more blocks and threads."""
+    return ['--fusion-size=' + ','.join([str(num_tensors // 4)] * 4),
+            '--block-num=8,8,4,4', '--thread-num=512,512,256,256']
+
+
+def matrix(device):
+    """Returns the name, benchmark and arguments of every configuration to run."""
+    configs = []
+    for (mix, num_tensors, sizes), libra, streams, hierarchical in itertools.product(
+            SIZE_MIXES, [False, True], STREAM_COUNTS, HIERARCHICAL):
+        name = '{}/libra-{}/streams-{}/hierarchical-{}'.format(
+            mix, 'on' if libra else 'off', streams, 'on' if hierarchical else 'off')
+        args = sizes + ['--num-tensors={}'.format(num_tensors), '--device=' + device,
+                        '--num-streams={}'.format(streams),
+                        '--hierarchical-allreduce={}'.format(hierarchical)]
+        if libra:
+            args += libra_plan(num_tensors)
+        configs.append((name, 'horovod_bench', args))
+
+    if device == 'gpu':
+        for libra, streams in itertools.product([False, True], STREAM_COUNTS):
+            name = 'overlap/libra-{}/streams-{}'.format('on' if libra else 'off', streams)
+            args = ['--layers=24', '--gemm-dim=1024', '--sizes=4M',
+                    '--num-streams={}'.format(streams)]
+            if libra:
+                args += ['--fusion-size=8,8,8', '--block-num=8,4,4', '--thread-num=512,256,256']
+            configs.append((name, 'horovod_overlap_bench', args))
+    return configs
+
+
+def flatten(results):
+    """Returns the metrics to compare of the JSON results of a benchmark."""
+    metrics = {}
+    if 'busbw_gbps' in results:
+        metrics['busbw_gbps'] = results['busbw_gbps']
+    for key in ('p50', 'p99'):
+        metrics['step_ms.' + key] = results['step_ms'][key]
+        if 'exposed_comm_ms' in results:
+            metrics['exposed_comm_ms.' + key] = results['exposed_comm_ms'][key]
+    for i, group in enumerate(results.get('groups', [])):
+        metrics['group.{}.p50_ms'.format(i)] = group['p50_ms']
+        metrics['group.{}.p99_ms'.format(i)] = group['p99_ms']
+    return metrics
+
+
+def run(config, args):
+    name, bench, bench_args = config
+    binary = os.path.join(args.bench_dir, bench)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        json_path = os.path.join(tmpdir, 'results.json')
+        command = shlex.split(args.launcher.format(np=args.np)) + [binary] + bench_args + \
+            ['--steps={}'.format(args.steps), '--json=' + json_path]
+        print('[{}] {}'.format(name, ' '.join(command)), flush=True)
+        completed = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                   universal_newlines=True)
+        if completed.returncode != 0 or not os.path.exists(json_path):
+            print(completed.stdout)
+            return dict(args=bench_args, error='exit code {}'.format(completed.returncode))
+        with open(json_path) as f:
+            results = json.load(f)
+    return dict(args=bench_args, results=results, metrics=flatten(results))
+
+
+def compare(results, baseline, bandwidth_tolerance, latency_tolerance, min_delta_ms):
+    """Prints the metrics of the results against the baseline, returns the number of
+    regressions. Bandwidths regress when they drop by more than bandwidth_tolerance,
+    times when they grow by more than latency_tolerance and min_delta_ms."""
+    regressions = 0
+    for name, entry in sorted(results.items()):
+        if 'metrics' not in entry:
+            continue
+        if name not in baseline or 'metrics' not in baseline[name]:
+            print('{}: not in the baseline'.format(name))
+            continue
+        base_metrics = baseline[name]['metrics']
+        for metric, value in sorted(entry['metrics'].items()):
+            if metric not in base_metrics:
+                continue
+            base = base_metrics[metric]
+            if metric.endswith('_gbps'):
+                regressed = value < base * (1.0 - bandwidth_tolerance)
+            else:
+                regressed = value > base * (1.0 + latency_tolerance) + min_delta_ms
+            change = (value / base - 1.0) * 100 if base > 0 else 0.0
+            print('{} {}: {:.3f} vs {:.3f} ({:+.1f}%){}'.format(
+                name, metric, value, base, change, ' REGRESSION' if regressed else ''))
+            regressions += int(regressed)
+    for name in sorted(set(baseline) - set(results)):
+        print('{}: in the baseline but not run'.format(name))
+    return regressions
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Horovod core performance regression matrix',
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument('--bench-dir', required=True,
+                        help='directory of the horovod_bench and horovod_overlap_bench executables')
+    parser.add_argument('--np', type=int, default=2, help='number of processes')
+    parser.add_argument('--launcher', default='mpirun -np {np}',
+                        help='command that starts the processes, {np} is replaced by --np')
+    parser.add_argument('--device', choices=['cpu', 'gpu'], default='gpu')
+    parser.add_argument('--steps', type=int, default=20, help='measured steps per configuration')
+    parser.add_argument('--filter', default='',
+                        help='only run the configurations whose name contains this string')
+    parser.add_argument('--output', required=True, help='file the results are written to')
+    parser.add_argument('--baseline', help='results to compare against')
+    parser.add_argument('--bandwidth-tolerance', type=float, default=0.05,
+                        help='relative drop of bus bandwidth that is a regression')
+    parser.add_argument('--latency-tolerance', type=float, default=0.10,
+                        help='relative growth of step, group and exposed times that is a regression')
+    parser.add_argument('--min-delta-ms', type=float, default=0.05,
+                        help='growth of times in milliseconds that is never a regression')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    results = {}
+    for config in matrix(args.device):
+        if args.filter in config[0]:
+            results[config[0]] = run(config, args)
+
+    with open(args.output, 'w') as f:
+        json.dump(dict(device=args.device, np=args.np, steps=args.steps, configs=results), f,
+                  indent=2, sort_keys=True)
+
+    failures = [name for name, entry in results.items() if 'error' in entry]
+    for name in failures:
+        print('{}: failed with {}'.format(name, results[name]['error']))
+
+    regressions = 0
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if (baseline['device'], baseline['np']) != (args.device, args.np):
+            print('The baseline ran on {} processes of device {}'.format(
+                baseline['np'], baseline['device']))
+        baseline = {name: entry for name, entry in baseline['configs'].items()
+                    if args.filter in name}
+        regressions = compare(results, baseline, args.bandwidth_tolerance,
+                              args.latency_tolerance, args.min_delta_ms)
+        print('{} regressions'.format(regressions))
+    return 1 if failures or regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -15,6 +15,7 @@
 
 import atexit
 import ctypes
+import json
 
 from horovod.common import util as util
 
@@ -97,6 +98,119 @@ class HorovodBasics(object):
         if not result:
             raise ValueError('Horovod has not been initialized; use hvd.init().')
 
+    def flush_fusion_groups(self):
+        """Sends partially filled fusion groups once all allreduces submitted
+        so far have been negotiated.
+
+        Call it after the last gradient of a step has been submitted, so that
+        the tensors left over in the last fusion group do not wait for the
+        next step. Has no effect when fusion groups are not used.
+
+        Raises a `ValueError` if Horovod is not initialized.
+        """
+        result = self.MPI_LIB_CTYPES.horovod_flush_fusion_groups()
+        if not result:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+
+    def release_fusion_buffers(self):
+        """Frees the memory of the fusion buffers once the operations in
+        flight are done.
+
+        Call it before a phase that does not communicate, like evaluation, to
+        make room for its activations. Buffers still used by operations on a
+        GPU are freed once these complete, and the next fused operation
+        allocates the buffers it needs again.
+
+        Raises a `ValueError` if Horovod is not initialized.
+        """
+        result = self.MPI_LIB_CTYPES.horovod_release_fusion_buffers()
+        if not result:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+
+    def fusion_buffer_bytes(self):
+        """Returns the bytes of the fusion buffers allocated on all devices.
+
+        Raises a `ValueError` if Horovod is not initialized.
+        """
+        self.MPI_LIB_CTYPES.horovod_fusion_buffer_bytes.restype = ctypes.c_int64
+        result = self.MPI_LIB_CTYPES.horovod_fusion_buffer_bytes()
+        if result < 0:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+        return result
+
+    def step_completed(self):
+        """Records that a training step was completed on this rank.
+
+        With `HOROVOD_AUTOTUNE_SCORE=step_time`, the autotuner scores the
+        parameters by the steps completed per second instead of the bytes
+        allreduced per second. `hvd.DistributedOptimizer` for PyTorch calls it
+        at the end of every `step()`. Has no effect otherwise.
+
+        Raises a `ValueError` if Horovod is not initialized.
+        """
+        result = self.MPI_LIB_CTYPES.horovod_step_completed()
+        if not result:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+
+    def get_overlap_stats(self):
+        """Returns when the tensors of the last steps became ready and were
+        communicated on this rank.
+
+        Stats are kept for the last `HOROVOD_OVERLAP_STATS_STEPS` complete steps
+        and the current one, and are empty if it is not set. Times are in
+        microseconds since the epoch.
+
+        Returns:
+          A list of steps, oldest first. Each step is a list of dicts with the
+          keys `tensor_name`, `ready`, `negotiated`, `comm_start` and
+          `comm_end`, in the order the tensors were submitted. Times that have
+          not been reached yet are 0.
+
+        Raises a `ValueError` if Horovod is not initialized.
+        """
+        self.MPI_LIB_CTYPES.horovod_overlap_stats.restype = ctypes.c_char_p
+        result = self.MPI_LIB_CTYPES.horovod_overlap_stats()
+        if result is None:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+        return json.loads(result.decode('utf-8'))
+
+    def get_metrics(self):
+        """Returns the hot path metrics of this rank: cycle and negotiation
+        times, response cache hits and misses, size of the performed responses,
+        fusion group fill latency and GPU operations in flight.
+
+        Returns:
+          A string in the Prometheus text exposition format, which can be
+          served as is by an HTTP endpoint of the training script.
+        """
+        self.MPI_LIB_CTYPES.horovod_metrics.restype = ctypes.c_char_p
+        result = self.MPI_LIB_CTYPES.horovod_metrics()
+        if result is None:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+        return result.decode('utf-8')
+
+    def get_straggler_scores(self):
+        """Returns the straggler score of every rank: a rolling average, in
+        seconds, of how long after the first ready rank the requests of the
+        rank for a tensor reach the coordinator. A rank with a score far above
+        the others is slowing down the job.
+
+        Scores are only known on the coordinator (rank 0), and only for tensors
+        negotiated through it, not for response cache hits.
+
+        Returns:
+          A list with the score of every rank on rank 0, an empty list on the
+          other ranks.
+
+        Raises a `ValueError` if Horovod is not initialized.
+        """
+        size = self.size()
+        scores = (ctypes.c_double * size)()
+        result = self.MPI_LIB_CTYPES.horovod_straggler_scores(scores, size)
+        if result < 0:
+            raise ValueError('Horovod has not been initialized; use hvd.init().')
+        return list(scores[:result])
+
     def size(self):
         """A function that returns the number of Horovod processes.
 
@@ -122,6 +236,39 @@ class HorovodBasics(object):
                 'Horovod has not been initialized; use hvd.init().')
         return local_size
 
+    def process_set_size(self, process_set):
+        """A function that returns the number of Horovod processes in a process set
+        of HOROVOD_PROCESS_SETS.
+
+        Arguments:
+            process_set: ID of the process set, numbered from 1 in the order of
+                         HOROVOD_PROCESS_SETS. 0 stands for all processes.
+
+        Returns:
+          An integer scalar with the size of the process set, 0 if there is no such set.
+        """
+        set_size = self.MPI_LIB_CTYPES.horovod_process_set_size(ctypes.c_int(process_set))
+        if set_size == -1:
+            raise ValueError(
+                'Horovod has not been initialized; use hvd.init().')
+        return set_size
+
+    def process_set_rank(self, process_set):
+        """A function that returns the rank of the calling process within a process set
+        of HOROVOD_PROCESS_SETS.
+
+        Arguments:
+            process_set: ID of the process set, 0 stands for all processes.
+
+        Returns:
+          An integer scalar with the position of the calling process in the set, -1 if
+          it is not a member.
+        """
+        if not self.is_initialized():
+            raise ValueError(
+                'Horovod has not been initialized; use hvd.init().')
+        return self.MPI_LIB_CTYPES.horovod_process_set_rank(ctypes.c_int(process_set))
+
     def rank(self):
         """A function that returns the Horovod rank of the calling process.
 
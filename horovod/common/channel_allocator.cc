@@ -0,0 +1,497 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "channel_allocator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <signal.h>
+#include <sstream>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+// NCCL does not run more channels than this.
+#define LIBRA_MAX_BLOCK_NUM 32
+#define LIBRA_SMALL_THREAD_NUM 256
+#define LIBRA_LARGE_THREAD_NUM 512
+// Blocks moving at least this many bytes use LIBRA_LARGE_THREAD_NUM threads.
+#define LIBRA_LARGE_BLOCK_BYTES (1024 * 1024)
+
+bool ParseNCCLTunings(const std::string& spec,
+                      std::vector<NCCLTuning>& tunings) {
+  tunings.clear();
+  std::stringstream stream(spec);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) {
+    auto slash = entry.find('/');
+    NCCLTuning tuning;
+    tuning.algorithm = entry.substr(0, slash);
+    if (slash != std::string::npos) {
+      tuning.protocol = entry.substr(slash + 1);
+    }
+    if ((tuning.algorithm.empty() && tuning.protocol.empty()) ||
+        tuning.protocol.find('/') != std::string::npos) {
+      tunings.clear();
+      return false;
+    }
+    tunings.push_back(tuning);
+  }
+  return true;
+}
+
+// The registry holds a "local_rank pid percent" line per process. The lines
+// of processes that are gone are dropped by the next reservation.
+int ReserveSMPercentage(const std::string& path, int local_rank, int percent) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+    LOG(WARNING) << "Unable to open the SM budget registry " << path << ": "
+                 << std::strerror(errno) << ".";
+    if (fd >= 0) {
+      close(fd);
+    }
+    return percent;
+  }
+
+  std::string contents;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    contents.append(buffer, n);
+  }
+  std::istringstream lines(contents);
+  std::ostringstream kept;
+  int reserved = 0;
+  int entry_rank;
+  long entry_pid;
+  int entry_percent;
+  pid_t pid = getpid();
+  while (lines >> entry_rank >> entry_pid >> entry_percent) {
+    bool alive = kill((pid_t)entry_pid, 0) == 0 || errno == EPERM;
+    if (!alive || entry_pid == pid) {
+      continue;
+    }
+    if (entry_rank == local_rank) {
+      reserved += entry_percent;
+    }
+    kept << entry_rank << " " << entry_pid << " " << entry_percent << "\n";
+  }
+  int granted = std::max(1, std::min(percent, 100 - reserved));
+  kept << local_rank << " " << pid << " " << granted << "\n";
+
+  auto output = kept.str();
+  if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0 ||
+      write(fd, output.data(), output.size()) != (ssize_t)output.size()) {
+    LOG(WARNING) << "Unable to update the SM budget registry " << path << ": "
+                 << std::strerror(errno) << ".";
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+  return granted;
+}
+
+Status ChannelAllocator::LoadTable(const std::string& path) {
+  std::ifstream file(path);
+  if (!file.good()) {
+    return Status::InvalidArgument("Unable to open Libra channel table " +
+                                   path + ".");
+  }
+
+  std::vector<Entry> table;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    auto first = line.find_first_not_of(" \t");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    std::istringstream line_stream(line);
+    Entry entry;
+    bool valid = (bool)(line_stream >> entry.max_bytes >>
+                        entry.concurrent_groups >> entry.block_num >>
+                        entry.thread_num);
+    entry.nccl_tuning = 0;
+    if (valid && !(line_stream >> entry.nccl_tuning)) {
+      valid = line_stream.eof();
+    }
+    if (!valid || entry.max_bytes < 0 || entry.concurrent_groups < 0 ||
+        entry.block_num < 0 || entry.thread_num < 0 ||
+        entry.nccl_tuning < 0 || entry.nccl_tuning > nccl_tuning_count_) {
+      return Status::InvalidArgument("Invalid entry in Libra channel table " +
+                                     path + " at line " +
+                                     std::to_string(line_number) + ".");
+    }
+    table.push_back(entry);
+  }
+  SetTable(std::move(table));
+  LOG(DEBUG) << "Loaded " << table_.size() << " entries from Libra channel table "
+             << path;
+  return Status::OK();
+}
+
+void ChannelAllocator::Allocate(int64_t bytes, int& block_num,
+                                int& thread_num) const {
+  int nccl_tuning;
+  Allocate(bytes, block_num, thread_num, nccl_tuning);
+}
+
+void ChannelAllocator::Allocate(int64_t bytes, int& block_num, int& thread_num,
+                                int& nccl_tuning) const {
+  block_num = 0;
+  thread_num = 0;
+  nccl_tuning = 0;
+  if (!enabled_) {
+    return;
+  }
+
+  // Prefer entries calibrated for the current number of concurrent groups
+  // over entries that match any number of groups.
+  const Entry* match = nullptr;
+  const Entry* largest = nullptr;
+  for (int pass = 0; pass < 2 && match == nullptr; ++pass) {
+    int64_t groups = pass == 0 ? concurrent_groups_ : 0;
+    for (auto& entry : table_) {
+      if (entry.concurrent_groups != groups) {
+        continue;
+      }
+      if (entry.max_bytes >= bytes) {
+        match = &entry;
+        break;
+      }
+      largest = &entry;
+    }
+    if (match == nullptr && largest != nullptr) {
+      match = largest;
+    }
+  }
+  if (match != nullptr) {
+    block_num = ScaleToSMBudget((int)match->block_num);
+    thread_num = (int)match->thread_num;
+    nccl_tuning = (int)match->nccl_tuning;
+    return;
+  }
+
+  if (sm_count_ <= 0) {
+    return;
+  }
+  int sm_budget = (int)(sm_count_ * sm_budget_ * sm_share_) / concurrent_groups_;
+  sm_budget = std::max(1, std::min(sm_budget, LIBRA_MAX_BLOCK_NUM));
+  int64_t wanted = (bytes + bytes_per_block_ - 1) / bytes_per_block_;
+  block_num = (int)std::max((int64_t)1, std::min(wanted, (int64_t)sm_budget));
+  thread_num = bytes / block_num >= LIBRA_LARGE_BLOCK_BYTES
+                   ? LIBRA_LARGE_THREAD_NUM
+                   : LIBRA_SMALL_THREAD_NUM;
+}
+
+void ChannelAllocator::SetConcurrentGroups(int value) {
+  concurrent_groups_ = std::max(1, value);
+}
+
+void ChannelAllocator::SetSMShare(double value) {
+  if (value <= 0 || value > 1) {
+    LOG(WARNING) << "HOROVOD_LIBRA_SM_SHARE must be in (0, 1], got " << value
+                 << ". Using " << sm_share_ << ".";
+    return;
+  }
+  sm_share_ = value;
+}
+
+void ChannelAllocator::SetSMBudget(double value) {
+  if (value <= 0 || value > 1) {
+    LOG(WARNING) << "The SM budget must be in (0, 1], got " << value
+                 << ". Using " << sm_budget_ << ".";
+    return;
+  }
+  sm_budget_ = value;
+}
+
+int ChannelAllocator::ScaleToSMBudget(int block_num) const {
+  if (block_num <= 0 || sm_budget_ == 1) {
+    return block_num;
+  }
+  return std::max(1, (int)std::lround(block_num * sm_budget_));
+}
+
+void ChannelAllocator::SetBytesPerBlock(int64_t value) {
+  if (value <= 0) {
+    LOG(WARNING) << "HOROVOD_LIBRA_BYTES_PER_BLOCK must be positive, got "
+                 << value << ". Using " << bytes_per_block_ << ".";
+    return;
+  }
+  bytes_per_block_ = value;
+}
+
+void ChannelAllocator::SetTable(std::vector<Entry> table) {
+  table_ = std::move(table);
+  std::stable_sort(table_.begin(), table_.end(),
+                   [](const Entry& a, const Entry& b) {
+                     return a.max_bytes < b.max_bytes;
+                   });
+}
+
+void ChannelFeedback::SetSamples(int value) {
+  if (value <= 0) {
+    LOG(WARNING) << "HOROVOD_LIBRA_FEEDBACK_SAMPLES must be positive, got "
+                 << value << ". Using " << samples_ << ".";
+    return;
+  }
+  samples_ = value;
+}
+
+void ChannelFeedback::SetTolerance(double value) {
+  if (value < 0) {
+    LOG(WARNING) << "HOROVOD_LIBRA_FEEDBACK_TOLERANCE must not be negative, "
+                 << "got " << value << ". Using " << tolerance_ << ".";
+    return;
+  }
+  tolerance_ = value;
+}
+
+void ChannelFeedback::Adjust(const std::string& group, int& block_num) {
+  if (!enabled_ || block_num <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& state = groups_[group];
+  if (state.base_blocks != block_num) {
+    // New group, or the open loop allocation changed, e.g. by the autotuner.
+    state = GroupState();
+    state.base_blocks = block_num;
+    state.blocks = block_num;
+    state.max_blocks = LIBRA_MAX_BLOCK_NUM;
+  }
+  block_num = state.blocks;
+}
+
+void ChannelFeedback::Record(const std::string& group, int requested_blocks,
+                             int launched_blocks, double seconds,
+                             double overlap) {
+  if (!enabled_) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = groups_.find(group);
+  // Kernels launched before the allocation of the group changed are stale.
+  if (it == groups_.end() || it->second.blocks != requested_blocks) {
+    return;
+  }
+  auto& state = it->second;
+  if (launched_blocks > 0 && launched_blocks < requested_blocks) {
+    // NCCL launched fewer channels than asked, more would not help.
+    state.max_blocks = std::max(1, launched_blocks);
+  }
+  state.seconds_sum += seconds;
+  state.overlap_sum += overlap;
+  if (++state.samples < samples_) {
+    return;
+  }
+  double mean = state.seconds_sum / state.samples;
+  double mean_overlap = state.overlap_sum / state.samples;
+  state.samples = 0;
+  state.seconds_sum = 0;
+  state.overlap_sum = 0;
+  Step(group, state, mean, mean_overlap);
+}
+
+void ChannelFeedback::Step(const std::string& group, GroupState& state,
+                           double seconds, double overlap) {
+  if (state.settled) {
+    if (std::abs(seconds - state.settled_seconds) <=
+        2 * tolerance_ * state.settled_seconds) {
+      return;
+    }
+    LOG(DEBUG) << "Libra feedback: kernels of group " << group
+               << " drifted from " << state.settled_seconds * 1e3 << " to "
+               << seconds * 1e3 << " ms, exploring again.";
+    state.settled = false;
+    state.durations.clear();
+  }
+
+  state.durations[state.blocks] = seconds;
+  double best = seconds;
+  for (auto& duration : state.durations) {
+    best = std::min(best, duration.second);
+  }
+  double threshold = best * (1 + tolerance_);
+  int smallest = 0;
+  for (auto& duration : state.durations) {
+    if (duration.second <= threshold) {
+      smallest = duration.first;
+      break;
+    }
+  }
+
+  // Fewer blocks, as long as the kernels stay as fast.
+  int half = std::max(1, smallest / 2);
+  if (half < smallest && state.durations.count(half) == 0) {
+    state.blocks = half;
+    return;
+  }
+  // More blocks, as long as every smaller allocation is too slow.
+  int largest = state.durations.rbegin()->first;
+  int twice = std::min(largest * 2, state.max_blocks);
+  if (smallest == largest && twice > largest &&
+      state.durations.count(twice) == 0) {
+    state.blocks = twice;
+    return;
+  }
+
+  state.blocks = smallest;
+  state.settled_seconds = state.durations[smallest];
+  state.settled = true;
+  LOG(DEBUG) << "Libra feedback: group " << group << " settles on "
+             << state.blocks << " blocks instead of " << state.base_blocks
+             << ", kernels of " << state.settled_seconds * 1e3 << " ms, "
+             << (int)(overlap * 100) << "% overlapped with other kernels.";
+}
+
+void LibraPlan::Clear() {
+  allocations_.assign(1, Allocation());
+  groups_.clear();
+  planned_.clear();
+  changed_ = false;
+}
+
+int32_t LibraPlan::Intern(const Allocation& allocation) {
+  for (size_t i = 0; i < allocations_.size(); ++i) {
+    if (allocations_[i] == allocation) {
+      return (int32_t)i;
+    }
+  }
+  allocations_.push_back(allocation);
+  ++version_;
+  changed_ = true;
+  return (int32_t)allocations_.size() - 1;
+}
+
+const LibraPlan::Allocation& LibraPlan::allocation(int32_t index) const {
+  if (index < 0 || index >= (int32_t)allocations_.size()) {
+    return allocations_[0];
+  }
+  return allocations_[index];
+}
+
+void LibraPlan::SetGroup(int group, const Group& value) {
+  if (group >= (int)groups_.size()) {
+    groups_.resize(group + 1);
+    planned_.resize(group + 1, false);
+  }
+  auto& planned = groups_[group];
+  if (planned_[group] && planned.max_count == value.max_count &&
+      planned.max_bytes == value.max_bytes &&
+      planned.allocation == value.allocation) {
+    return;
+  }
+  planned = value;
+  planned_[group] = true;
+  ++version_;
+  changed_ = true;
+}
+
+const LibraPlan::Group* LibraPlan::group(int group) const {
+  if (group < 0 || group >= (int)groups_.size() || !planned_[group]) {
+    return nullptr;
+  }
+  return &groups_[group];
+}
+
+template <typename T>
+static void AppendValue(std::string& output, T value) {
+  output.append((const char*)&value, sizeof(value));
+}
+
+template <typename T>
+static bool ReadValue(const std::string& input, size_t& offset, T& value) {
+  if (offset + sizeof(value) > input.size()) {
+    return false;
+  }
+  std::memcpy(&value, input.data() + offset, sizeof(value));
+  offset += sizeof(value);
+  return true;
+}
+
+// The plan is only exchanged between ranks of the same build, so the values
+// are written in host byte order.
+void LibraPlan::SerializeToString(std::string& output) {
+  output.clear();
+  AppendValue(output, version_);
+  AppendValue(output, (uint32_t)allocations_.size());
+  for (auto& allocation : allocations_) {
+    AppendValue(output, allocation.block_num);
+    AppendValue(output, allocation.thread_num);
+    AppendValue(output, allocation.split_block_num);
+    AppendValue(output, allocation.split_thread_num);
+    AppendValue(output, allocation.nccl_tuning);
+  }
+  AppendValue(output, (uint32_t)groups_.size());
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    AppendValue(output, (int32_t)(planned_[i] ? groups_[i].allocation : -1));
+    AppendValue(output, groups_[i].max_count);
+    AppendValue(output, groups_[i].max_bytes);
+  }
+  changed_ = false;
+}
+
+bool LibraPlan::ParseFromString(const std::string& input) {
+  size_t offset = 0;
+  uint32_t version, num_allocations, num_groups;
+  if (!ReadValue(input, offset, version) ||
+      !ReadValue(input, offset, num_allocations) || num_allocations == 0) {
+    return false;
+  }
+  std::vector<Allocation> allocations(num_allocations);
+  for (auto& allocation : allocations) {
+    if (!ReadValue(input, offset, allocation.block_num) ||
+        !ReadValue(input, offset, allocation.thread_num) ||
+        !ReadValue(input, offset, allocation.split_block_num) ||
+        !ReadValue(input, offset, allocation.split_thread_num) ||
+        !ReadValue(input, offset, allocation.nccl_tuning)) {
+      return false;
+    }
+  }
+  if (!ReadValue(input, offset, num_groups)) {
+    return false;
+  }
+  std::vector<Group> groups(num_groups);
+  std::vector<bool> planned(num_groups);
+  for (uint32_t i = 0; i < num_groups; ++i) {
+    int32_t allocation;
+    if (!ReadValue(input, offset, allocation) ||
+        !ReadValue(input, offset, groups[i].max_count) ||
+        !ReadValue(input, offset, groups[i].max_bytes)) {
+      return false;
+    }
+    planned[i] = allocation >= 0;
+    groups[i].allocation = std::max(allocation, 0);
+  }
+  version_ = version;
+  allocations_ = std::move(allocations);
+  groups_ = std::move(groups);
+  planned_ = std::move(planned);
+  changed_ = false;
+  return true;
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,249 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_CHANNEL_ALLOCATOR_H
+#define HOROVOD_CHANNEL_ALLOCATOR_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+
+namespace horovod {
+namespace common {
+
+// NCCL algorithm and protocol of a set of communicators, e.g. Tree and LL.
+// An empty part leaves the choice to NCCL.
+struct NCCLTuning {
+  std::string algorithm;
+  std::string protocol;
+};
+
+// Parses the HOROVOD_LIBRA_NCCL_TUNINGS list of ALGORITHM[/PROTOCOL] entries
+// separated by commas.
+bool ParseNCCLTunings(const std::string& spec, std::vector<NCCLTuning>& tunings);
+
+// Reserves percent of the SMs of the device of local_rank in the registry
+// file at path, which the jobs sharing the devices of a node point at.
+// Returns the percentage granted, at most what the live processes of the
+// other jobs left of the device, but at least 1.
+int ReserveSMPercentage(const std::string& path, int local_rank, int percent);
+
+// Picks the number of NCCL blocks (channels) and threads per block used by
+// the allreduce of a fusion group, for groups that have no FUSION_BLOCK_NUM /
+// FUSION_THREAD_NUM specification.
+//
+// The allocation is looked up in a calibration table keyed by message size
+// and the number of groups running at the same time. Without a table entry,
+// it is derived from the SM count of the device: the groups running at the
+// same time share HOROVOD_LIBRA_SM_SHARE of the SMs, and each group gets one
+// block per HOROVOD_LIBRA_BYTES_PER_BLOCK bytes of its message, within its
+// share of the SMs.
+//
+// Table entries can also run the group on the communicators of one of the
+// HOROVOD_LIBRA_NCCL_TUNINGS, since the algorithm and protocol change how
+// many blocks a message needs. The open loop keeps the NCCL choice.
+//
+// A job that shares its devices with other jobs, e.g. through MPS, only
+// gets a budget of their SMs. The calibrated and specified block counts
+// are scaled to it, and the open loop shares the budget instead of all SMs.
+class ChannelAllocator {
+public:
+  struct Entry {
+    // Largest message size in bytes this entry applies to.
+    int64_t max_bytes;
+    // Number of groups running at the same time, 0 matches any.
+    int64_t concurrent_groups;
+    int64_t block_num;
+    int64_t thread_num;
+    // 1-based index of the NCCL tuning, 0 for the default communicators.
+    int64_t nccl_tuning;
+  };
+
+  ChannelAllocator() = default;
+  ChannelAllocator(const ChannelAllocator&) = delete;
+
+  // Load a calibration table. Every non-empty line that does not start with
+  // '#' holds "max_bytes concurrent_groups block_num thread_num", optionally
+  // followed by the NCCL tuning.
+  Status LoadTable(const std::string& path);
+
+  // Returns block_num = thread_num = 0 (the NCCL default) if the allocator is
+  // disabled or the SM count is unknown.
+  void Allocate(int64_t bytes, int& block_num, int& thread_num) const;
+  void Allocate(int64_t bytes, int& block_num, int& thread_num,
+                int& nccl_tuning) const;
+
+  bool IsEnabled() const { return enabled_; }
+  int SMCount() const { return sm_count_; }
+  int ConcurrentGroups() const { return concurrent_groups_; }
+  const std::vector<Entry>& Table() const { return table_; }
+
+  void SetEnabled(bool value) { enabled_ = value; }
+  void SetSMCount(int value) { sm_count_ = value; }
+  void SetConcurrentGroups(int value);
+  void SetSMShare(double value);
+  void SetBytesPerBlock(int64_t value);
+  void SetTable(std::vector<Entry> table);
+  // Fraction of the SMs of the device the job may use, in (0, 1].
+  void SetSMBudget(double value);
+  double SMBudget() const { return sm_budget_; }
+  // Scales the blocks of a group specified for all SMs to the SM budget.
+  int ScaleToSMBudget(int block_num) const;
+  // Number of HOROVOD_LIBRA_NCCL_TUNINGS the table can refer to.
+  void SetNCCLTuningCount(int value) { nccl_tuning_count_ = value; }
+
+private:
+  bool enabled_ = true;
+  int nccl_tuning_count_ = 0;
+  int sm_count_ = 0;
+  int concurrent_groups_ = 1;
+  double sm_share_ = 0.25;
+  double sm_budget_ = 1;
+  int64_t bytes_per_block_ = 512 * 1024;
+
+  // Sorted by max_bytes.
+  std::vector<Entry> table_;
+};
+
+// Closes the loop of the allocation of the fusion groups on the duration of
+// their NCCL kernels, measured on the coordinator while they compete with the
+// compute kernels (see CuptiKernelMonitor). For every group, it looks for the
+// fewest blocks whose kernels stay within HOROVOD_LIBRA_FEEDBACK_TOLERANCE of
+// the fastest measured: it halves the blocks of the open loop allocation as
+// long as that holds, doubles them if the first halving did not, and settles
+// on the smallest allocation within the tolerance. The blocks saved leave
+// their SMs to the compute kernels. A settled group is explored again when
+// the duration of its kernels drifts, because the contention changed.
+//
+// Groups are identified by the name of their first tensor, which is stable
+// across steps for a fixed model.
+class ChannelFeedback {
+public:
+  ChannelFeedback() = default;
+  ChannelFeedback(const ChannelFeedback&) = delete;
+
+  bool IsEnabled() const { return enabled_; }
+  void SetEnabled(bool value) { enabled_ = value; }
+  // Kernels averaged for every allocation tried.
+  void SetSamples(int value);
+  void SetTolerance(double value);
+
+  // Called by the coordinator for every group, replaces the open loop
+  // block_num by the one being tried or settled on.
+  void Adjust(const std::string& group, int& block_num);
+
+  // Called by the kernel monitor with every NCCL kernel of a group.
+  // overlap is the fraction of its duration that ran next to other kernels.
+  void Record(const std::string& group, int requested_blocks,
+              int launched_blocks, double seconds, double overlap);
+
+private:
+  struct GroupState {
+    // Open loop allocation the exploration started from.
+    int base_blocks = 0;
+    int blocks = 0;
+    int max_blocks = 0;
+    bool settled = false;
+    double settled_seconds = 0;
+    // Mean kernel duration by blocks tried.
+    std::map<int, double> durations;
+    int samples = 0;
+    double seconds_sum = 0;
+    double overlap_sum = 0;
+  };
+
+  void Step(const std::string& group, GroupState& state, double seconds,
+            double overlap);
+
+  bool enabled_ = false;
+  int samples_ = 10;
+  double tolerance_ = 0.05;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, GroupState> groups_;
+};
+
+// Launch configuration of the Libra allreduces, the same on every rank. The
+// coordinator decides the allocations in the cycles that go through
+// communication, and sends the plan along with the response list whenever it
+// changed, so that all ranks switch to a new plan in the same cycle.
+// Responses only carry the index of their allocation in the plan. In cycles
+// of cached responses every rank fuses the groups on its own, with the sizes
+// and allocations the plan holds for them.
+class LibraPlan {
+public:
+  struct Allocation {
+    int32_t block_num = 0;
+    int32_t thread_num = 0;
+    int32_t split_block_num = 0;
+    int32_t split_thread_num = 0;
+    int32_t nccl_tuning = 0;
+
+    bool operator==(const Allocation& other) const {
+      return block_num == other.block_num && thread_num == other.thread_num &&
+             split_block_num == other.split_block_num &&
+             split_thread_num == other.split_thread_num &&
+             nccl_tuning == other.nccl_tuning;
+    }
+  };
+
+  struct Group {
+    int32_t max_count = 0;
+    int64_t max_bytes = 0;
+    int32_t allocation = 0;
+  };
+
+  LibraPlan() { Clear(); }
+
+  // Drops every group and allocation but the NCCL default, at index 0.
+  void Clear();
+
+  // Index of the allocation in the plan, added if new.
+  int32_t Intern(const Allocation& allocation);
+
+  // The NCCL default for unknown indices.
+  const Allocation& allocation(int32_t index) const;
+
+  void SetGroup(int group, const Group& value);
+
+  // nullptr if the group was not planned yet.
+  const Group* group(int group) const;
+
+  uint32_t version() const { return version_; }
+
+  // Whether the plan changed since it was last serialized.
+  bool changed() const { return changed_; }
+
+  void SerializeToString(std::string& output);
+
+  bool ParseFromString(const std::string& input);
+
+private:
+  std::vector<Allocation> allocations_;
+  std::vector<Group> groups_;
+  std::vector<bool> planned_;
+  uint32_t version_ = 0;
+  bool changed_ = false;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_CHANNEL_ALLOCATOR_H
@@ -18,10 +18,18 @@
 #include "logging.h"
 
 #include <sstream>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <fstream>
 #include <limits.h>
 
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace horovod {
 namespace common {
 
@@ -115,8 +123,62 @@ int64_t TensorShape::num_elements() const {
 
 const std::vector<int64_t>& TensorShape::to_vector() const { return shape_; }
 
+TensorSlice::TensorSlice(std::shared_ptr<Tensor> tensor, int64_t offset,
+                         int64_t num_elements)
+    : tensor_(std::move(tensor)), offset_(offset),
+      num_elements_(num_elements) {}
+
+const DataType TensorSlice::dtype() const { return tensor_->dtype(); }
+
+const TensorShape TensorSlice::shape() const {
+  TensorShape shape;
+  shape.AddDim(num_elements_);
+  return shape;
+}
+
+const void* TensorSlice::data() const {
+  return static_cast<const uint8_t*>(tensor_->data()) +
+         offset_ * DataType_Size(tensor_->dtype());
+}
+
+int64_t TensorSlice::size() const {
+  return num_elements_ * DataType_Size(tensor_->dtype());
+}
+
+std::shared_ptr<OptimizerStep> OptimizerStep::Slice(int64_t offset,
+                                                   int64_t num_elements) const {
+  auto slice = std::make_shared<OptimizerStep>(*this);
+  slice->parameter =
+      std::make_shared<TensorSlice>(parameter, offset, num_elements);
+  if (state0 != nullptr) {
+    slice->state0 = std::make_shared<TensorSlice>(state0, offset, num_elements);
+  }
+  if (state1 != nullptr) {
+    slice->state1 = std::make_shared<TensorSlice>(state1, offset, num_elements);
+  }
+  return slice;
+}
+
+void InvokeCallbacks(const std::vector<TensorTableEntry>& entries,
+                     const Status& status) {
+  CompletionBatcher* batcher = nullptr;
+  std::vector<int> keys;
+  for (auto& e : entries) {
+    if (e.batcher != nullptr && (batcher == nullptr || e.batcher == batcher)) {
+      batcher = e.batcher;
+      keys.push_back(e.batch_key);
+    } else if (e.callback != nullptr) {
+      // Callback can be null if the rank sent Join request.
+      e.callback(status);
+    }
+  }
+  if (batcher != nullptr) {
+    batcher->Complete(keys, status);
+  }
+}
+
 #ifdef __linux__
-void set_affinity(int affinity) {
+void set_affinity(int affinity, const std::string& thread_name) {
   cpu_set_t cpuset;
   pthread_t current_thread = pthread_self();
 
@@ -134,20 +196,21 @@ void set_affinity(int affinity) {
 
   for (int core_idx = 0; core_idx < __CPU_SETSIZE; core_idx++) {
     if (__CPU_ISSET_S(core_idx, sizeof(cpu_set_t), &cpuset)) {
-      LOG(INFO) << "Background thread affinity " << core_idx;
+      LOG(INFO) << thread_name << " thread affinity " << core_idx;
     }
   }
 }
 #else
-void set_affinity(int affinity) {
+void set_affinity(int affinity, const std::string& thread_name) {
   // TODO(travis): explore equivalent for macOS
   throw std::runtime_error("Environment variable HOROVOD_THREAD_AFFINITY is not supported on macOS.");
 }
 #endif
 
-void parse_and_set_affinity(const char* affinity, int local_size, int local_rank) {
+int parse_affinity(const char* affinity, int local_size, int local_rank,
+                   const char* env_name) {
   if (affinity == nullptr) {
-    return;
+    return -1;
   }
 
   size_t affinity_len = strlen(affinity);
@@ -161,19 +224,20 @@ void parse_and_set_affinity(const char* affinity, int local_size, int local_rank
   std::vector<int> core_ids(local_size);
   int count = 0;
 
-  while (*tmp != 0 && count < local_size) {
+  // strsep sets tmp to null after the last id.
+  while (tmp != nullptr && *tmp != 0 && count < local_size) {
     auto core_id_str = strsep(&tmp, ",");
     errno = 0;
     auto core_id = std::strtol(core_id_str, &endptr, 10);
     if (errno == ERANGE && (core_id == LONG_MAX || core_id == LONG_MIN)
         || (errno != 0 && core_id == 0)){
-        LOG(ERROR) << "Core ID value is invalid in " << HOROVOD_THREAD_AFFINITY
+        LOG(ERROR) << "Core ID value is invalid in " << env_name
                    << "=" << affinity;
         break;
     }
 
     if (endptr == core_id_str) {
-        LOG(ERROR) << "No digits were found in " << HOROVOD_THREAD_AFFINITY
+        LOG(ERROR) << "No digits were found in " << env_name
                    << "=" << affinity;
         break;
     }
@@ -181,7 +245,7 @@ void parse_and_set_affinity(const char* affinity, int local_size, int local_rank
     if (core_id < 0) {
       LOG(ERROR) << "Core ID cannot be less than zero but got "
                  << core_id << " in "
-                 << HOROVOD_THREAD_AFFINITY << "=" << affinity;
+                 << env_name << "=" << affinity;
       break;
     } else {
       core_ids[count] = core_id;
@@ -189,15 +253,132 @@ void parse_and_set_affinity(const char* affinity, int local_size, int local_rank
     }
   }
     
+  int core_id = -1;
   if (count < local_size) {
     LOG(ERROR) << "Expected " << local_size << " core ids but got " << count << ". "
-               << HOROVOD_THREAD_AFFINITY << "=" << affinity;
+               << env_name << "=" << affinity;
   } else {
-    set_affinity(core_ids[local_rank]);
+    core_id = core_ids[local_rank];
   }
 
   free(affinity_copy);
+  return core_id;
+}
+
+void parse_and_set_affinity(const char* affinity, int local_size, int local_rank) {
+  int core_id = parse_affinity(affinity, local_size, local_rank);
+  if (core_id >= 0) {
+    set_affinity(core_id);
+  }
+}
+
+namespace {
+
+// Returns the NUMA node in the numa_node file of a sysfs device, or -1.
+int read_numa_node(const std::string& device_path) {
+  std::ifstream file(device_path + "/numa_node");
+  int node = -1;
+  if (!(file >> node)) {
+    return -1;
+  }
+  return node;
+}
+
+} // namespace
+
+int pci_numa_node(const std::string& bus_id) {
+  if (bus_id.empty()) {
+    return -1;
+  }
+  // The driver reports the bus ids in upper case, sysfs names them in lower.
+  std::string name = bus_id;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  return read_numa_node("/sys/bus/pci/devices/" + name);
+}
+
+#ifdef __linux__
+int local_numa_node(int local_rank, int gpu_node) {
+  std::vector<std::string> nics;
+  DIR* dir = opendir("/sys/class/infiniband");
+  if (dir != nullptr) {
+    for (struct dirent* entry = readdir(dir); entry != nullptr;
+         entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        nics.emplace_back(entry->d_name);
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(nics.begin(), nics.end());
+
+  std::vector<int> nic_nodes;
+  for (auto& nic : nics) {
+    int node = read_numa_node("/sys/class/infiniband/" + nic + "/device");
+    if (node >= 0) {
+      nic_nodes.push_back(node);
+    }
+  }
+  if (nic_nodes.empty() || (gpu_node >= 0 &&
+                            std::find(nic_nodes.begin(), nic_nodes.end(),
+                                      gpu_node) != nic_nodes.end())) {
+    return gpu_node;
+  }
+  return nic_nodes[local_rank % nic_nodes.size()];
 }
 
+void set_numa_affinity(int node, const std::string& thread_name) {
+  std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) +
+                     "/cpulist");
+  std::string cpulist;
+  if (!(file >> cpulist)) {
+    LOG(ERROR) << "Cannot read the cores of NUMA node " << node;
+    return;
+  }
+
+  // The list holds ranges like 0-15,32-47.
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  std::stringstream ranges(cpulist);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    auto dash = range.find('-');
+    int first = std::atoi(range.c_str());
+    int last = dash == std::string::npos ? first
+                                         : std::atoi(range.c_str() + dash + 1);
+    for (int core = first; core <= last && core < CPU_SETSIZE; ++core) {
+      CPU_SET(core, &cpuset);
+    }
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
+    LOG(ERROR) << "setaffinity failed";
+    return;
+  }
+
+#ifdef SYS_set_mempolicy
+  // MPOL_PREFERRED falls back to the other nodes when the node is full. The
+  // system call is made directly to not depend on libnuma.
+  const int mpol_preferred = 1;
+  unsigned long nodemask[16] = {};
+  if (node < (int)(sizeof(nodemask) * 8)) {
+    nodemask[node / (sizeof(unsigned long) * 8)] |=
+        1UL << (node % (sizeof(unsigned long) * 8));
+    if (syscall(SYS_set_mempolicy, mpol_preferred, nodemask,
+                sizeof(nodemask) * 8) != 0) {
+      LOG(WARNING) << "set_mempolicy failed, " << thread_name
+                   << " thread memory is not placed on NUMA node " << node;
+    }
+  }
+#endif
+  LOG(INFO) << thread_name << " thread NUMA node " << node << ", cores "
+            << cpulist;
+}
+#else
+int local_numa_node(int local_rank, int gpu_node) { return gpu_node; }
+
+void set_numa_affinity(int node, const std::string& thread_name) {
+  throw std::runtime_error("Environment variable HOROVOD_NUMA_AFFINITY is not supported on macOS.");
+}
+#endif
+
 } // namespace common
 } // namespace horovod
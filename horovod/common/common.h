@@ -18,11 +18,22 @@
 #ifndef HOROVOD_COMMON_H
 #define HOROVOD_COMMON_H
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
+#if HAVE_GPU
+#if HAVE_CUDA
+#include <cuda_runtime.h>
+using gpuEvent_t = cudaEvent_t;
+#elif HAVE_ROCM
+#include <hip/hip_runtime_api.h>
+using gpuEvent_t = hipEvent_t;
+#endif
+#endif
+
 #include "message.h"
 
 namespace horovod {
@@ -34,19 +45,24 @@ namespace common {
 #define WAIT_FOR_OTHER_TENSOR_DATA "WAIT_FOR_OTHER_TENSOR_DATA"
 #define ALLOCATE_OUTPUT "ALLOCATE_OUTPUT"
 #define MPI_CROSS_ALLGATHER "MPI_CROSS_ALLGATHER"
+#define MPI_CROSS_ALLREDUCE "MPI_CROSS_ALLREDUCE"
 #define MPI_ALLGATHER "MPI_ALLGATHER"
 #define INIT_NCCL "INIT_NCCL"
 #define QUEUE "QUEUE"
 #define MEMCPY_IN_FUSION_BUFFER "MEMCPY_IN_FUSION_BUFFER"
 #define MEMCPY_IN_HOST_BUFFER "MEMCPY_IN_HOST_BUFFER"
 #define MEMCPY_IN_SHARED_BUFFER "MEMCPY_IN_SHARED_BUFFER"
+#define SHARED_REDUCESCATTER "SHARED_REDUCESCATTER"
+#define MEMCPY_OUT_SHARED_BUFFER "MEMCPY_OUT_SHARED_BUFFER"
 #define MPI_ALLREDUCE "MPI_ALLREDUCE"
 #define MPI_ADASUM_ALLREDUCE "MPI_ADASUM_ALLREDUCE"
+#define NCCL_ADASUM_ALLREDUCE "NCCL_ADASUM_ALLREDUCE"
 #define MEMCPY_OUT_HOST_BUFFER "MEMCPY_OUT_HOST_BUFFER"
 #define NCCL_ALLREDUCE "NCCL_ALLREDUCE"
 #define MEMCPY_OUT_FUSION_BUFFER "MEMCPY_OUT_FUSION_BUFFER"
 #define MPI_BCAST "MPI_BCAST"
 #define MPI_ALLTOALL "MPI_ALLTOALL"
+#define MPI_REDUCESCATTER "MPI_REDUCESCATTER"
 #define NCCL_REDUCESCATTER "NCCL_REDUCESCATTER"
 #define NCCL_ALLGATHER "NCCL_ALLGATHER"
 #define NCCL_REDUCE "NCCL_REDUCE"
@@ -60,37 +76,120 @@ namespace common {
 #define GLOO_ALLREDUCE "GLOO_ALLREDUCE"
 #define GLOO_ALLGATHER "GLOO_ALLGATHER"
 #define GLOO_BCAST "GLOO_BCAST"
+#define GLOO_REDUCESCATTER "GLOO_REDUCESCATTER"
 
 // Horovod knobs.
 #define HOROVOD_MPI_THREADS_DISABLE "HOROVOD_MPI_THREADS_DISABLE"
+#define HOROVOD_MPI_CUDA_AWARE "HOROVOD_MPI_CUDA_AWARE"
+#define HOROVOD_MPI_CONTROL_COMM "HOROVOD_MPI_CONTROL_COMM"
 #define HOROVOD_TIMELINE "HOROVOD_TIMELINE"
 #define HOROVOD_TIMELINE_MARK_CYCLES "HOROVOD_TIMELINE_MARK_CYCLES"
+#define HOROVOD_TIMELINE_ALL_RANKS "HOROVOD_TIMELINE_ALL_RANKS"
+#define HOROVOD_TIMELINE_NVTX "HOROVOD_TIMELINE_NVTX"
+#define HOROVOD_TIMELINE_FORMAT "HOROVOD_TIMELINE_FORMAT"
+#define HOROVOD_TIMELINE_SAMPLE_EVERY_STEPS "HOROVOD_TIMELINE_SAMPLE_EVERY_STEPS"
+#define HOROVOD_TIMELINE_SAMPLE_STEPS "HOROVOD_TIMELINE_SAMPLE_STEPS"
+#define HOROVOD_TIMELINE_TRIGGER_FILE "HOROVOD_TIMELINE_TRIGGER_FILE"
+#define HOROVOD_TIMELINE_TRIGGER_SECONDS "HOROVOD_TIMELINE_TRIGGER_SECONDS"
+#define HOROVOD_TENSOR_TRACE "HOROVOD_TENSOR_TRACE"
 #define HOROVOD_AUTOTUNE "HOROVOD_AUTOTUNE"
 #define HOROVOD_AUTOTUNE_LOG "HOROVOD_AUTOTUNE_LOG"
 #define HOROVOD_AUTOTUNE_WARMUP_SAMPLES "HOROVOD_AUTOTUNE_WARMUP_SAMPLES"
 #define HOROVOD_AUTOTUNE_STEPS_PER_SAMPLE "HOROVOD_AUTOTUNE_STEPS_PER_SAMPLE"
 #define HOROVOD_AUTOTUNE_BAYES_OPT_MAX_SAMPLES "HOROVOD_AUTOTUNE_BAYES_OPT_MAX_SAMPLES"
 #define HOROVOD_AUTOTUNE_GAUSSIAN_PROCESS_NOISE "HOROVOD_AUTOTUNE_GAUSSIAN_PROCESS_NOISE"
+#define HOROVOD_AUTOTUNE_WARM_START_FILE "HOROVOD_AUTOTUNE_WARM_START_FILE"
+#define HOROVOD_AUTOTUNE_SCORE "HOROVOD_AUTOTUNE_SCORE"
+#define HOROVOD_AUTOTUNE_DRIFT_THRESHOLD "HOROVOD_AUTOTUNE_DRIFT_THRESHOLD"
+#define HOROVOD_AUTOTUNE_DRIFT_SAMPLES "HOROVOD_AUTOTUNE_DRIFT_SAMPLES"
+#define HOROVOD_AUTOTUNE_DRIFT_RETUNE_SAMPLES "HOROVOD_AUTOTUNE_DRIFT_RETUNE_SAMPLES"
+#define HOROVOD_AUTOTUNE_MEMORY_BUDGET "HOROVOD_AUTOTUNE_MEMORY_BUDGET"
 #define HOROVOD_FUSION_THRESHOLD "HOROVOD_FUSION_THRESHOLD"
 #define HOROVOD_CYCLE_TIME "HOROVOD_CYCLE_TIME"
+#define HOROVOD_ADAPTIVE_CYCLE_TIME "HOROVOD_ADAPTIVE_CYCLE_TIME"
+#define HOROVOD_ADAPTIVE_CYCLE_TIME_MAX "HOROVOD_ADAPTIVE_CYCLE_TIME_MAX"
+#define HOROVOD_BUSY_POLL "HOROVOD_BUSY_POLL"
+#define HOROVOD_WIRE_SESSION_CAPACITY "HOROVOD_WIRE_SESSION_CAPACITY"
+#define HOROVOD_INLINE_ALLREDUCE_BYTES "HOROVOD_INLINE_ALLREDUCE_BYTES"
+#define HOROVOD_PROCESS_SETS "HOROVOD_PROCESS_SETS"
 #define HOROVOD_STALL_CHECK_DISABLE "HOROVOD_STALL_CHECK_DISABLE"
 #define HOROVOD_STALL_CHECK_TIME_SECONDS "HOROVOD_STALL_CHECK_TIME_SECONDS"
 #define HOROVOD_STALL_SHUTDOWN_TIME_SECONDS "HOROVOD_STALL_SHUTDOWN_TIME_SECONDS"
 #define HOROVOD_HIERARCHICAL_ALLREDUCE "HOROVOD_HIERARCHICAL_ALLREDUCE"
 #define HOROVOD_HIERARCHICAL_ALLGATHER "HOROVOD_HIERARCHICAL_ALLGATHER"
+#define HOROVOD_TORUS_ALLREDUCE "HOROVOD_TORUS_ALLREDUCE"
+#define HOROVOD_HIERARCHICAL_ALLTOALL "HOROVOD_HIERARCHICAL_ALLTOALL"
+#define HOROVOD_ALLTOALL_DEVICE_SPLITS "HOROVOD_ALLTOALL_DEVICE_SPLITS"
+#define HOROVOD_ALLGATHER_ARENA_BYTES "HOROVOD_ALLGATHER_ARENA_BYTES"
+#define HOROVOD_NCCL_GROUP_LAUNCH "HOROVOD_NCCL_GROUP_LAUNCH"
+#define HOROVOD_CUDA_GRAPHS "HOROVOD_CUDA_GRAPHS"
+#define HOROVOD_HIERARCHICAL_NEGOTIATION "HOROVOD_HIERARCHICAL_NEGOTIATION"
+#define HOROVOD_ELASTIC "HOROVOD_ELASTIC"
 #define HOROVOD_CACHE_CAPACITY "HOROVOD_CACHE_CAPACITY"
+#define HOROVOD_CACHE_CAPACITY_MAX "HOROVOD_CACHE_CAPACITY_MAX"
+#define HOROVOD_CACHE_FILE "HOROVOD_CACHE_FILE"
+#define HOROVOD_CACHE_DYNAMIC_SHAPES "HOROVOD_CACHE_DYNAMIC_SHAPES"
 #define HOROVOD_NUM_NCCL_STREAMS "HOROVOD_NUM_NCCL_STREAMS"
+#define HOROVOD_NCCL_EAGER_INIT "HOROVOD_NCCL_EAGER_INIT"
+#define HOROVOD_NCCL_STREAM_TRAFFIC_CLASS "HOROVOD_NCCL_STREAM_TRAFFIC_CLASS"
+#define HOROVOD_NCCL_REGISTER_BUFFERS "HOROVOD_NCCL_REGISTER_BUFFERS"
+#define HOROVOD_RCCL_MAX_CHANNELS "HOROVOD_RCCL_MAX_CHANNELS"
+#define HOROVOD_ALLREDUCE_DISPATCH "HOROVOD_ALLREDUCE_DISPATCH"
+#define HOROVOD_BATCH_D2D_MEMCOPIES "HOROVOD_BATCH_D2D_MEMCOPIES"
 #define HOROVOD_STREAM_ASSIGNMENT "HOROVOD_STREAM_ASSIGNMENT"
+// Deprecated, mapped onto HOROVOD_LIBRA_SPLIT_BLOCK_NUM and
+// HOROVOD_LIBRA_SPLIT_THREAD_NUM.
 #define HOROVOD_PARALLEL_THREADNUM "HOROVOD_PARALLEL_THREADNUM"
 #define HOROVOD_PARALLEL_OR_NOT "HOROVOD_PARALLEL_OR_NOT"
+#define HOROVOD_FUSION_MODE "HOROVOD_FUSION_MODE"
+#define HOROVOD_FUSION_PLANNER_WARMUP_STEPS "HOROVOD_FUSION_PLANNER_WARMUP_STEPS"
+#define HOROVOD_FUSION_PLANNER_GROUPS "HOROVOD_FUSION_PLANNER_GROUPS"
+#define HOROVOD_FUSION_GROUP_FLUSH_TIMEOUT "HOROVOD_FUSION_GROUP_FLUSH_TIMEOUT"
+#define HOROVOD_FUSION_PRIORITY "HOROVOD_FUSION_PRIORITY"
+#define HOROVOD_FUSION_PARTITION_BYTES "HOROVOD_FUSION_PARTITION_BYTES"
+#define HOROVOD_FUSION_BUFFER_SLAB_MB "HOROVOD_FUSION_BUFFER_SLAB_MB"
+#define HOROVOD_CUDA_MEMORY_POOL "HOROVOD_CUDA_MEMORY_POOL"
+#define HOROVOD_CUDA_MEMORY_POOL_RELEASE_MB "HOROVOD_CUDA_MEMORY_POOL_RELEASE_MB"
+#define HOROVOD_FUSION_DOUBLE_BUFFERING "HOROVOD_FUSION_DOUBLE_BUFFERING"
+#define HOROVOD_FUSION_COMPRESSION "HOROVOD_FUSION_COMPRESSION"
+#define HOROVOD_PINNED_HOST_STAGING "HOROVOD_PINNED_HOST_STAGING"
+#define HOROVOD_HOST_STAGING_CHUNK_MB "HOROVOD_HOST_STAGING_CHUNK_MB"
+#define HOROVOD_MPI_ALLREDUCE_CHUNK_MB "HOROVOD_MPI_ALLREDUCE_CHUNK_MB"
+#define HOROVOD_CPU_REDUCTION_THREADS "HOROVOD_CPU_REDUCTION_THREADS"
+#define HOROVOD_OVERLAP_STATS_STEPS "HOROVOD_OVERLAP_STATS_STEPS"
+#define HOROVOD_GPU_STREAM_PRIORITY "HOROVOD_GPU_STREAM_PRIORITY"
+#define HOROVOD_GPU_STREAM_HIGH_PRIORITY_LAYERS "HOROVOD_GPU_STREAM_HIGH_PRIORITY_LAYERS"
+#define HOROVOD_GPU_EVENT_SPIN_US "HOROVOD_GPU_EVENT_SPIN_US"
+#define HOROVOD_GPU_ERROR_CHECK_MS "HOROVOD_GPU_ERROR_CHECK_MS"
+#define HOROVOD_LIBRA_CHANNEL_ALLOCATOR "HOROVOD_LIBRA_CHANNEL_ALLOCATOR"
+#define HOROVOD_LIBRA_CHANNEL_TABLE "HOROVOD_LIBRA_CHANNEL_TABLE"
+#define HOROVOD_LIBRA_NCCL_TUNINGS "HOROVOD_LIBRA_NCCL_TUNINGS"
+#define HOROVOD_LIBRA_SM_SHARE "HOROVOD_LIBRA_SM_SHARE"
+#define HOROVOD_LIBRA_SM_BUDGET "HOROVOD_LIBRA_SM_BUDGET"
+#define HOROVOD_LIBRA_SM_BUDGET_FILE "HOROVOD_LIBRA_SM_BUDGET_FILE"
+#define HOROVOD_LIBRA_BYTES_PER_BLOCK "HOROVOD_LIBRA_BYTES_PER_BLOCK"
+#define HOROVOD_LIBRA_CONCURRENT_GROUPS "HOROVOD_LIBRA_CONCURRENT_GROUPS"
+#define HOROVOD_LIBRA_ALL_COLLECTIVES "HOROVOD_LIBRA_ALL_COLLECTIVES"
+#define HOROVOD_LIBRA_SPLIT_BLOCK_NUM "HOROVOD_LIBRA_SPLIT_BLOCK_NUM"
+#define HOROVOD_LIBRA_SPLIT_THREAD_NUM "HOROVOD_LIBRA_SPLIT_THREAD_NUM"
+#define HOROVOD_LIBRA_KERNEL_FEEDBACK "HOROVOD_LIBRA_KERNEL_FEEDBACK"
+#define HOROVOD_LIBRA_FEEDBACK_SAMPLES "HOROVOD_LIBRA_FEEDBACK_SAMPLES"
+#define HOROVOD_LIBRA_FEEDBACK_TOLERANCE "HOROVOD_LIBRA_FEEDBACK_TOLERANCE"
 #define HOROVOD_CPU_OPERATIONS "HOROVOD_CPU_OPERATIONS"
 #define HOROVOD_CONTROLLER "HOROVOD_CONTROLLER"
 #define HOROVOD_GLOO_IFACE "HOROVOD_GLOO_IFACE"
+#define HOROVOD_GLOO_BCUBE_THRESHOLD "HOROVOD_GLOO_BCUBE_THRESHOLD"
+#define HOROVOD_CCL_IN_FLIGHT_OPS "HOROVOD_CCL_IN_FLIGHT_OPS"
 #define HOROVOD_MPI "MPI"
 #define HOROVOD_CCL "CCL"
 #define HOROVOD_GLOO "GLOO"
 #define HOROVOD_ADASUM_MPI_CHUNK_SIZE "HOROVOD_ADASUM_MPI_CHUNK_SIZE"
+#define HOROVOD_ADASUM_GPU_DEVICE_REDUCTION "HOROVOD_ADASUM_GPU_DEVICE_REDUCTION"
 #define HOROVOD_THREAD_AFFINITY "HOROVOD_THREAD_AFFINITY"
+#define HOROVOD_NUMA_AFFINITY "HOROVOD_NUMA_AFFINITY"
+#define HOROVOD_HOST_HUGE_PAGES "HOROVOD_HOST_HUGE_PAGES"
+#define HOROVOD_HOST_PREFAULT "HOROVOD_HOST_PREFAULT"
+#define HOROVOD_ASYNC_EXECUTION "HOROVOD_ASYNC_EXECUTION"
 
 // String constant for gloo interface.
 #define GLOO_DEFAULT_IFACE ""
@@ -107,7 +206,7 @@ namespace common {
 #define JOIN_TENSOR_NAME "join.noname"
 
 // List of supported frameworks.
-enum Framework { TENSORFLOW, PYTORCH, MXNET };
+enum Framework { TENSORFLOW, PYTORCH, MXNET, XLA };
 
 enum StatusType { OK, UNKNOWN_ERROR, PRECONDITION_ERROR, ABORTED, INVALID_ARGUMENT, IN_PROGRESS };
 
@@ -194,6 +293,11 @@ private:
 class ReadyEvent {
 public:
   virtual bool Ready() const = 0;
+#if HAVE_GPU
+  // GPU event recorded when the data is ready, if any. Operations that wait
+  // for it on their GPU stream do not poll Ready().
+  virtual gpuEvent_t event() const { return nullptr; }
+#endif
   virtual ~ReadyEvent() = default;
 };
 
@@ -214,6 +318,24 @@ public:
   virtual ~Tensor() = default;
 };
 
+// A contiguous range of elements of another tensor, seen as a 1-D tensor.
+// Used to reduce large tensors in several parts.
+class TensorSlice : public Tensor {
+public:
+  TensorSlice(std::shared_ptr<Tensor> tensor, int64_t offset,
+              int64_t num_elements);
+  const DataType dtype() const override;
+  const TensorShape shape() const override;
+  const void* data() const override;
+  int64_t size() const override;
+
+private:
+  std::shared_ptr<Tensor> tensor_;
+  // In elements.
+  int64_t offset_;
+  int64_t num_elements_;
+};
+
 class OpContext {
 public:
   // These allocators are fully synchronous, unlike TensorFlow counterparts.
@@ -233,6 +355,49 @@ public:
 // computation after the reduction is completed.
 using StatusCallback = std::function<void(const Status&)>;
 
+// Completes several operations of a framework at once, for instance under one
+// lock, where a callback per operation would be slower. Operations that set
+// a batcher are completed together with the other operations of their fusion
+// group, and their callbacks are not called.
+class CompletionBatcher {
+public:
+  virtual void Complete(const std::vector<int>& keys, const Status& status) = 0;
+  virtual ~CompletionBatcher() = default;
+};
+
+// An update of a parameter from its reduced gradient, run on the GPU stream
+// of the allreduce right after it. The state tensors and the parameter have
+// the type and shape of the gradient.
+struct OptimizerStep {
+  enum Kind { SGD = 0, ADAM = 1 };
+  Kind kind = SGD;
+  std::shared_ptr<Tensor> parameter;
+  // The momentum buffer of SGD, unset without momentum, or the first and
+  // second moments of Adam.
+  std::shared_ptr<Tensor> state0;
+  std::shared_ptr<Tensor> state1;
+
+  double lr = 0.0;
+  double weight_decay = 0.0;
+  // SGD.
+  double momentum = 0.0;
+  double dampening = 0.0;
+  bool nesterov = false;
+  // Whether the momentum buffer is initialized with the gradient.
+  bool first_step = false;
+  // Adam, step counting from one.
+  double beta1 = 0.0;
+  double beta2 = 0.0;
+  double eps = 0.0;
+  int64_t step = 1;
+  // AdamW.
+  bool decoupled_weight_decay = false;
+
+  // The step of the elements [offset, offset + num_elements) of the tensors.
+  std::shared_ptr<OptimizerStep> Slice(int64_t offset,
+                                       int64_t num_elements) const;
+};
+
 // Table storing Tensors to be reduced, keyed by unique name.
 // This table contains everything necessary to do the reduction.
 struct TensorTableEntry {
@@ -248,23 +413,65 @@ struct TensorTableEntry {
   int root_rank = 0;
   // Event indicating that data is ready.
   std::shared_ptr<ReadyEvent> ready_event;
+  // Set by the computation timeline thread once ready_event is ready, if the
+  // entry is tracked by the computation timeline.
+  std::shared_ptr<std::atomic_bool> comp_ready;
   // GPU to do reduction on, or CPU_DEVICE_ID in case of CPU.
   int device = CPU_DEVICE_ID;
   // A callback to call with the status.
   StatusCallback callback;
+  // If set, completes the entry with batch_key instead of the callback.
+  CompletionBatcher* batcher = nullptr;
+  int batch_key = 0;
 
   // Alltoall splits (if tensor is for an Alltoall operation)
   // Note: splits are stored in TensorTableEntry to avoid N^2
   // storage complexity of collecting all worker split arrays
   // on coordinator rank.
   std::vector<int32_t> splits;
+  // Splits left on the device of the tensor, exchanged by the alltoall
+  // itself. The splits above are filled in when it runs.
+  std::shared_ptr<Tensor> device_splits;
+
+  // If set, a float64 scalar on the device of an allreduce the squared L2
+  // norm of its output is added to.
+  std::shared_ptr<Tensor> norm_sqrd;
+
+  // If set, a float32 scalar on the device of an allreduce that is set to
+  // one if its output has an inf or a NaN, and left as is otherwise.
+  std::shared_ptr<Tensor> found_inf;
+
+  // If set, applied to the output of an allreduce before the entry is done.
+  std::shared_ptr<OptimizerStep> optimizer_step;
 };
 using TensorTable = std::unordered_map<std::string, TensorTableEntry>;
 
+// Calls the callbacks of entries that completed together. The entries of the
+// first batcher are handed to it in one call.
+void InvokeCallbacks(const std::vector<TensorTableEntry>& entries,
+                     const Status& status);
+
 // Set affinity function
-void set_affinity(int affinity);
+void set_affinity(int affinity, const std::string& thread_name = "Background");
+// Returns the core of local_rank in HOROVOD_THREAD_AFFINITY, or -1. Also
+// parses the lists of NUMA nodes of the variable env_name.
+int parse_affinity(const char* affinity, int local_size, int local_rank,
+                   const char* env_name = HOROVOD_THREAD_AFFINITY);
 void parse_and_set_affinity(const char* affinity, int local_size, int local_rank);
 
+// Returns the NUMA node of the PCI device with the bus id, e.g.
+// "0000:3b:00.0", or -1 if it is unknown.
+int pci_numa_node(const std::string& bus_id);
+// Returns the NUMA node whose threads and host buffers are closest to the
+// GPU on gpu_node and the NIC of local_rank: the node of the GPU if one of the
+// InfiniBand devices is attached to it, the node of the InfiniBand device of
+// local_rank otherwise. Returns gpu_node without InfiniBand devices, and -1 if
+// neither is known.
+int local_numa_node(int local_rank, int gpu_node);
+// Pins the calling thread to the cores of the NUMA node, and places the memory
+// it touches first on the node when possible.
+void set_numa_affinity(int node, const std::string& thread_name = "Background");
+
 } // namespace common
 } // namespace horovod
 
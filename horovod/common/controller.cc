@@ -17,161 +17,546 @@
 
 #include "controller.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <map>
 #include <queue>
 #include <set>
+#include <thread>
 #include <unordered_set>
 
 #include "global_state.h"
 #include "logging.h"
 #include "operations.h"
+#include "utils/env_parser.h"
 
 namespace horovod {
 namespace common {
 
 
-void Controller::SynchronizeParameters() {
-  ParameterManager::Params param;
+void Controller::ApplyParameters(const ResponseList& response_list) {
+  if (!is_coordinator_) {
+    ParameterManager::Params params;
+    if (response_list.parameters().size() != sizeof(params)) {
+      throw std::logic_error(
+          "Received " + std::to_string(response_list.parameters().size()) +
+          " bytes of autotuned parameters, expected " +
+          std::to_string(sizeof(params)) + ".");
+    }
+    std::memcpy(&params, response_list.parameters().data(), sizeof(params));
+    parameter_manager_.SetParams(params);
+  }
+  parameter_manager_.Reset();
+  // Groups built under the previous Libra parameters are not replayed.
+  fusion_group_cache_.clear();
+}
+
+void Controller::SynchronizeFusionPlan() {
+  std::vector<int> plan;
   if (is_coordinator_) {
-    param = parameter_manager_.GetParams();
+    plan = fusion_planner_.ComputePlan();
   }
 
-  void* buffer = (void*)(&param);
-  size_t param_size = sizeof(param);
-  Bcast(buffer, param_size, 0, Communicator::GLOBAL);
+  int num_groups = (int)plan.size();
+  Bcast(&num_groups, sizeof(num_groups), 0, Communicator::GLOBAL);
+  plan.resize(num_groups);
+  if (num_groups > 0) {
+    Bcast(plan.data(), num_groups * sizeof(int), 0, Communicator::GLOBAL);
+  }
+  fusion_planner_.Freeze();
 
-  if (!is_coordinator_) {
-    parameter_manager_.SetParams(param);
+  // The plan may have fewer groups than requested if a step has fewer
+  // tensors than groups. Groups without a block/thread specification use
+  // the default NCCL allocation.
+  allreduce_group_id = 0;
+  fusion_group_cache_.clear();
+  group_size = plan;
+  group_bytes.assign(group_size.size(), 0);
+  block_size.resize(group_size.size(), 0);
+  thread_size.resize(group_size.size(), 0);
+
+  if (is_coordinator_) {
+    std::stringstream plan_str;
+    for (size_t i = 0; i < group_size.size(); ++i) {
+      plan_str << (i > 0 ? "," : "") << group_size[i];
+    }
+    LOG(INFO) << "lyz-alloc : fusion groups planned after "
+              << fusion_planner_.CompletedSteps()
+              << " steps, FUSION_SIZE=" << plan_str.str();
   }
-  parameter_manager_.Reset();
 }
 
+// Parse a FUSION_SIZE entry. A plain number is a tensor count, a number
+// with a K/M/G suffix is a byte budget, and "<count>:<bytes>" caps a count
+// based group at a byte budget. Zero means no limit.
+static bool ParseFusionGroupEntry(const std::string& entry, int& count,
+                                  int64_t& bytes) {
+  count = 0;
+  bytes = 0;
+  auto parse_bytes = [](const std::string& str, int64_t& value) {
+    char* end;
+    value = std::strtoll(str.c_str(), &end, 10);
+    if (end == str.c_str() || value < 0) {
+      return false;
+    }
+    std::string suffix(end);
+    if (suffix == "K" || suffix == "KB") {
+      value *= 1024;
+    } else if (suffix == "M" || suffix == "MB") {
+      value *= 1024 * 1024;
+    } else if (suffix == "G" || suffix == "GB") {
+      value *= 1024 * 1024 * 1024;
+    } else if (!suffix.empty() && suffix != "B") {
+      return false;
+    }
+    return true;
+  };
+
+  auto separator = entry.find(':');
+  if (separator != std::string::npos) {
+    int64_t value;
+    std::string count_str = entry.substr(0, separator);
+    if (!parse_bytes(count_str, value) ||
+        count_str.find_first_not_of("0123456789 ") != std::string::npos) {
+      return false;
+    }
+    count = (int)value;
+    return parse_bytes(entry.substr(separator + 1), bytes);
+  }
+
+  int64_t value;
+  if (!parse_bytes(entry, value)) {
+    return false;
+  }
+  if (entry.find_first_of("KMGB") != std::string::npos) {
+    bytes = value;
+  } else {
+    count = (int)value;
+  }
+  return true;
+}
+
+// Parse a comma separated list of FUSION_SIZE entries, returns the first
+// invalid entry in bad_entry.
+static bool ParseFusionGroupList(const char* value, std::vector<int>& counts,
+                                 std::vector<int64_t>& bytes,
+                                 std::string& bad_entry) {
+  counts.clear();
+  bytes.clear();
+  std::stringstream stream(value);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) {
+    int count;
+    int64_t entry_bytes;
+    if (!ParseFusionGroupEntry(entry, count, entry_bytes)) {
+      bad_entry = entry;
+      return false;
+    }
+    counts.push_back(count);
+    bytes.push_back(entry_bytes);
+  }
+  return true;
+}
 
 //lyz - alloc
 void Controller::load_fusion_specification() {
   //init
   allreduce_group_id = 0;
   group_size.clear();
+  group_bytes.clear();
+  cpu_group_id_ = 0;
+  cpu_group_size_.clear();
+  cpu_group_bytes_.clear();
+
+  fusion_mode_ = ParseFusionModeFromEnv();
+  if (fusion_mode_ == FusionMode::THRESHOLD) {
+    LOG(DEBUG) << "lyz-alloc : using threshold fusion.";
+    return;
+  }
+  load_cpu_fusion_specification();
 
   //load fusion size
   const char* fusion_sizes = getenv("FUSION_SIZE");
   if (!fusion_sizes) {
-      printf("lyz-alloc : fusion group size not specified.!!!!!\n");
-      LOG(ERROR) << "lyz-alloc : fusion group size not specified.!!!!!\n";
-      exit(-1);
-  }
-  char tmp[128];
-  char* tmp_ptr = tmp;
-  for (int i = 0; i < strlen(fusion_sizes); i++) {
-    if (fusion_sizes[i] !=',') {
-      *(tmp_ptr++) = fusion_sizes[i];
-    }
-    else { 
-      *tmp_ptr = '\0';
-      tmp_ptr = tmp;
-      int fusion_size;
-      sscanf(tmp, "%d", &fusion_size);
-      group_size.push_back(fusion_size);
-    }
-  }
-  if (tmp_ptr!=tmp) {
-    *tmp_ptr = '\0';
-    int fusion_size;
-    sscanf(tmp, "%d", &fusion_size);
-    group_size.push_back(fusion_size);
-  }
-  LOG(INFO) << "lyz-alloc : fusion group size specification loaded.";
+    if (fusion_mode_ == FusionMode::AUTO) {
+      LOG(DEBUG) << "lyz-alloc : fusion group size not specified, using "
+                    "threshold fusion.";
+      fusion_mode_ = FusionMode::THRESHOLD;
+      return;
+    }
+    // No static group list, build the groups from the observed tensors.
+    fusion_planner_.SetEnabled(true);
+    fusion_planner_.SetWarmupSteps(
+        GetIntEnvOrDefault(HOROVOD_FUSION_PLANNER_WARMUP_STEPS, 5));
+    LOG(DEBUG) << "Fusion group size not specified, groups will be planned "
+                  "from the first training steps.";
+    return;
+  }
+  std::string entry;
+  if (!ParseFusionGroupList(fusion_sizes, group_size, group_bytes, entry)) {
+    FallBackToThresholdFusion(
+        "invalid FUSION_SIZE entry '" + entry +
+        "', expected <count>, <bytes>[K|M|G] or <count>:<bytes>[K|M|G]");
+    return;
+  }
+  LOG(DEBUG) << "Fusion group size specification loaded.";
+}
+
+void Controller::load_cpu_fusion_specification() {
+#if HAVE_GPU
+  const char* cpu_fusion_sizes = getenv("CPU_FUSION_SIZE");
+  if (!cpu_fusion_sizes) {
+    return;
+  }
+  std::string entry;
+  if (!ParseFusionGroupList(cpu_fusion_sizes, cpu_group_size_, cpu_group_bytes_,
+                            entry)) {
+    LOG(WARNING) << "lyz-alloc : invalid CPU_FUSION_SIZE entry '" << entry
+                 << "', CPU tensors use threshold fusion.";
+    cpu_group_size_.clear();
+    cpu_group_bytes_.clear();
+    return;
+  }
+  LOG(DEBUG) << "CPU fusion group size specification loaded.";
+#endif
+}
+
+// Parse a comma separated list of non-negative integers.
+static bool ParseIntList(const char* value, std::vector<int>& result) {
+  result.clear();
+  std::stringstream stream(value);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) {
+    char* end;
+    long number = std::strtol(entry.c_str(), &end, 10);
+    if (end == entry.c_str() || *end != '\0' || number < 0) {
+      return false;
+    }
+    result.push_back((int)number);
+  }
+  return true;
 }
 
 void Controller::load_thread_specification() {
   //init
   block_size.clear();
   thread_size.clear();
-  char tmp[128];
-  char* tmp_ptr = tmp;
+  if (fusion_mode_ == FusionMode::THRESHOLD) {
+    return;
+  }
 
-  //load block num
   const char* block_nums = getenv("FUSION_BLOCK_NUM");
-  if (!block_nums) {
-      LOG(ERROR) << "lyz-alloc : fusion block num not specified.!!!!!\n";
-      exit(-1);
-  }
-  for (int i = 0; i < strlen(block_nums); i++) {
-    if (block_nums[i] !=',') {
-      *(tmp_ptr++) = block_nums[i];
-    }
-    else { 
-      *tmp_ptr = '\0';
-      tmp_ptr = tmp;
-      int block_num;
-      sscanf(tmp, "%d", &block_num);
-      block_size.push_back(block_num);
+  const char* thread_nums = getenv("FUSION_THREAD_NUM");
+  if (!block_nums && !thread_nums) {
+    // Every group gets its blocks and threads from the channel allocator.
+    if (fusion_planner_.IsEnabled()) {
+      fusion_planner_.SetNumGroups(
+          GetIntEnvOrDefault(HOROVOD_FUSION_PLANNER_GROUPS, 1));
     }
+    block_size.assign(group_size.size(), 0);
+    thread_size.assign(group_size.size(), 0);
+    LOG(DEBUG) << "Block and thread specification not specified, using the "
+                  "channel allocator.";
+    return;
   }
-  if (tmp_ptr!=tmp) {
-    *tmp_ptr = '\0';
-    tmp_ptr = tmp;
-    int block_num;
-    sscanf(tmp, "%d", &block_num);
-    block_size.push_back(block_num);
+
+  //load block and thread num
+  if (!block_nums || !thread_nums) {
+    FallBackToThresholdFusion(
+        "FUSION_BLOCK_NUM and FUSION_THREAD_NUM must be specified together");
+    return;
+  }
+  if (!ParseIntList(block_nums, block_size)) {
+    FallBackToThresholdFusion("invalid FUSION_BLOCK_NUM");
+    return;
+  }
+  if (!ParseIntList(thread_nums, thread_size)) {
+    FallBackToThresholdFusion("invalid FUSION_THREAD_NUM");
+    return;
   }
 
-  //load thread num
-  const char* thread_nums = getenv("FUSION_THREAD_NUM");
-  if (!thread_nums) {
-      LOG(ERROR) << "lyz-alloc : fusion thread num not specified.!!!!!\n";
-      exit(-1);
+  if (block_size.size() != thread_size.size() ||
+      (!fusion_planner_.IsEnabled() && block_size.size() != group_size.size())) {
+    FallBackToThresholdFusion(
+        "fusion group/block/thread specification not equal in size");
+    return;
   }
-  for (int i = 0; i < strlen(thread_nums); i++) {
-    if (thread_nums[i] !=',') {
-      *(tmp_ptr++) = thread_nums[i];
-    }
-    else { 
-      *tmp_ptr = '\0';
-      tmp_ptr = tmp;
-      int thread_num;
-      sscanf(tmp, "%d", &thread_num);
-      thread_size.push_back(thread_num);
+  if (fusion_planner_.IsEnabled()) {
+    // One planned group per block/thread entry.
+    fusion_planner_.SetNumGroups((int)block_size.size());
+  }
+
+  LOG(DEBUG) << "Block and thread specification loaded.";
+}
+
+// Threads per block of the NCCL allreduce kernels.
+#define LIBRA_MAX_THREAD_NUM 512
+
+void Controller::load_split_specification() {
+  split_block_size.clear();
+  split_thread_size.clear();
+  if (fusion_mode_ == FusionMode::THRESHOLD) {
+    return;
+  }
+
+  const char* block_nums = getenv(HOROVOD_LIBRA_SPLIT_BLOCK_NUM);
+  const char* thread_nums = getenv(HOROVOD_LIBRA_SPLIT_THREAD_NUM);
+  const char* legacy_groups = getenv(HOROVOD_PARALLEL_OR_NOT);
+  if (block_nums == nullptr && legacy_groups != nullptr) {
+    // The parallel allreduce moved the first groups of a step to a stream of
+    // their own with a total of HOROVOD_PARALLEL_THREADNUM threads, now these
+    // groups are split with that budget for their second part.
+    int groups = std::atoi(legacy_groups);
+    int threads = GetIntEnvOrDefault(HOROVOD_PARALLEL_THREADNUM, 0);
+    int blocks = std::max(1, threads / LIBRA_MAX_THREAD_NUM);
+    threads = std::min(threads, LIBRA_MAX_THREAD_NUM);
+    split_block_size.assign(block_size.size(), 0);
+    split_thread_size.assign(block_size.size(), 0);
+    for (int i = 0; i < std::min(groups, (int)block_size.size()); ++i) {
+      split_block_size[i] = blocks;
+      split_thread_size[i] = threads;
     }
+    LOG(WARNING) << "lyz-alloc : HOROVOD_PARALLEL_OR_NOT and "
+                    "HOROVOD_PARALLEL_THREADNUM are deprecated, splitting the "
+                    "first " << groups << " fusion groups with " << blocks
+                 << " blocks instead. Use HOROVOD_LIBRA_SPLIT_BLOCK_NUM and "
+                    "HOROVOD_LIBRA_SPLIT_THREAD_NUM.";
+    return;
   }
-  if (tmp_ptr!=tmp) {
-    *tmp_ptr = '\0';
-    tmp_ptr = tmp;
-    int thread_num;
-    sscanf(tmp, "%d", &thread_num);
-    thread_size.push_back(thread_num);
+  if (block_nums == nullptr) {
+    return;
   }
 
-  if (block_size.size() != thread_size.size() || block_size.size() != group_size.size()) {
-    LOG(ERROR) << "lyz-alloc : fusion group/block/thread specification not equal in size !!!!!\n";
-    exit(-1);
+  if (!ParseIntList(block_nums, split_block_size) ||
+      (thread_nums != nullptr &&
+       !ParseIntList(thread_nums, split_thread_size)) ||
+      split_block_size.size() != block_size.size() ||
+      (thread_nums != nullptr &&
+       split_thread_size.size() != split_block_size.size())) {
+    LOG(WARNING) << "lyz-alloc : HOROVOD_LIBRA_SPLIT_BLOCK_NUM and "
+                    "HOROVOD_LIBRA_SPLIT_THREAD_NUM need one entry per fusion "
+                    "group, fusion groups are not split.";
+    split_block_size.clear();
+    split_thread_size.clear();
+    return;
   }
+  if (split_thread_size.empty()) {
+    split_thread_size.assign(split_block_size.size(), 0);
+  }
+  LOG(DEBUG) << "Split group specification loaded.";
+}
 
-  LOG(INFO) << "lyz-alloc : block and thread specification loaded.";
+void Controller::FallBackToThresholdFusion(const std::string& reason) {
+  if (fusion_mode_ == FusionMode::GROUPS) {
+    throw std::invalid_argument("lyz-alloc : " + reason +
+                                ", required by HOROVOD_FUSION_MODE=groups.");
+  }
+  LOG(WARNING) << "lyz-alloc : " << reason
+               << ", falling back to threshold fusion.";
+  fusion_mode_ = FusionMode::THRESHOLD;
+  fusion_planner_.SetEnabled(false);
+  group_size.clear();
+  group_bytes.clear();
+  block_size.clear();
+  thread_size.clear();
+  cpu_group_size_.clear();
+  cpu_group_bytes_.clear();
 }
 
 
 Controller::Controller(ResponseCache& response_cache, TensorQueue& tensor_queue,
-                       Timeline& timeline, ParameterManager& parameter_manager)
+                       Timeline& timeline, ParameterManager& parameter_manager,
+                       HorovodMetrics& metrics)
     : stall_inspector_(response_cache), tensor_queue_(tensor_queue),
       timeline_(timeline), response_cache_(response_cache),
-      parameter_manager_(parameter_manager) {}
+      parameter_manager_(parameter_manager), metrics_(metrics) {}
 
 void Controller::Initialize() {
   response_cache_.clear();
+  libra_plan_.Clear();
   // lyz - alloc
   load_fusion_specification();
   load_thread_specification();
+  load_split_specification();
+
+  fusion_group_flush_timeout_ms_ =
+      GetIntEnvOrDefault(HOROVOD_FUSION_GROUP_FLUSH_TIMEOUT, 100);
+  fusion_priority_enabled_ =
+      GetBoolEnvOrDefault(HOROVOD_FUSION_PRIORITY, false);
+  inline_allreduce_bytes_ =
+      std::max(0, GetIntEnvOrDefault(HOROVOD_INLINE_ALLREDUCE_BYTES, 0));
 
   // Initialize concrete implementations.
   DoInitialization();
+
+  auto process_sets = std::getenv(HOROVOD_PROCESS_SETS);
+  if (process_sets != nullptr && *process_sets != '\0') {
+    if (!process_sets_.Parse(process_sets, size_)) {
+      throw std::invalid_argument(
+          "HOROVOD_PROCESS_SETS must list the distinct ranks of each set "
+          "separated by commas and the sets separated by semicolons, e.g. "
+          "\"0,1;2,3\", with ranks below " + std::to_string(size_) +
+          ", got " + std::string(process_sets) + ".");
+    }
+  } else {
+    process_sets_.Clear();
+  }
+  DoInitializeProcessSets();
+
+  wire_session_.SetCapacity(
+      GetIntEnvOrDefault(HOROVOD_WIRE_SESSION_CAPACITY, 0));
+  wire_session_.Reset(size_);
+
+  SynchronizeChannelAllocator();
+  if (GetBoolEnvOrDefault(HOROVOD_TIMELINE_ALL_RANKS, false)) {
+    SynchronizeClocks();
+  }
+}
+
+// Number of pings used to estimate each clock offset, the fastest one wins.
+#define CLOCK_SYNC_ROUNDS 10
+
+static int64_t SystemClockMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void Controller::SynchronizeClocks() {
+  // A ping from the coordinator arrives at this rank after
+  // offset + latency, a ping from this rank arrives at the coordinator after
+  // latency - offset. Assuming symmetric latencies, their difference is
+  // twice the offset.
+  int64_t from_coordinator = std::numeric_limits<int64_t>::max();
+  for (int round = 0; round < CLOCK_SYNC_ROUNDS; ++round) {
+    Barrier(Communicator::GLOBAL);
+    int64_t sent = SystemClockMicros();
+    Bcast(&sent, sizeof(sent), 0, Communicator::GLOBAL);
+    from_coordinator =
+        std::min(from_coordinator, SystemClockMicros() - sent);
+  }
+
+  std::vector<int64_t> to_coordinator(size_,
+                                      std::numeric_limits<int64_t>::max());
+  for (int rank = 1; rank < size_; ++rank) {
+    for (int round = 0; round < CLOCK_SYNC_ROUNDS; ++round) {
+      Barrier(Communicator::GLOBAL);
+      int64_t sent = SystemClockMicros();
+      Bcast(&sent, sizeof(sent), rank, Communicator::GLOBAL);
+      if (is_coordinator_) {
+        to_coordinator[rank] =
+            std::min(to_coordinator[rank], SystemClockMicros() - sent);
+      }
+    }
+  }
+  Bcast(to_coordinator.data(), size_ * sizeof(int64_t), 0,
+        Communicator::GLOBAL);
+
+  clock_offset_micros_ =
+      is_coordinator_ ? 0 : (from_coordinator - to_coordinator[rank_]) / 2;
+  LOG(DEBUG, rank_) << "Estimated clock offset to the coordinator: "
+                    << clock_offset_micros_ << " us.";
+}
+
+void Controller::SynchronizeChannelAllocator() {
+  channel_allocator_.SetEnabled(
+      GetBoolEnvOrDefault(HOROVOD_LIBRA_CHANNEL_ALLOCATOR, true));
+  channel_allocator_.SetSMShare(
+      GetDoubleEnvOrDefault(HOROVOD_LIBRA_SM_SHARE, 0.25));
+  channel_allocator_.SetBytesPerBlock(
+      GetIntEnvOrDefault(HOROVOD_LIBRA_BYTES_PER_BLOCK, 512 * 1024));
+  channel_allocator_.SetConcurrentGroups(GetIntEnvOrDefault(
+      HOROVOD_LIBRA_CONCURRENT_GROUPS,
+      GetIntEnvOrDefault(HOROVOD_NUM_NCCL_STREAMS, 1)));
+  libra_all_collectives_ =
+      GetBoolEnvOrDefault(HOROVOD_LIBRA_ALL_COLLECTIVES, false);
+  // Only the coordinator allocates the blocks of the groups.
+  channel_feedback_.SetEnabled(
+      is_coordinator_ &&
+      GetBoolEnvOrDefault(HOROVOD_LIBRA_KERNEL_FEEDBACK, false));
+  channel_feedback_.SetSamples(
+      GetIntEnvOrDefault(HOROVOD_LIBRA_FEEDBACK_SAMPLES, 10));
+  channel_feedback_.SetTolerance(
+      GetDoubleEnvOrDefault(HOROVOD_LIBRA_FEEDBACK_TOLERANCE, 0.05));
+
+  std::vector<NCCLTuning> nccl_tunings;
+  auto nccl_tunings_spec = std::getenv(HOROVOD_LIBRA_NCCL_TUNINGS);
+  if (nccl_tunings_spec != nullptr) {
+    ParseNCCLTunings(nccl_tunings_spec, nccl_tunings);
+  }
+  channel_allocator_.SetNCCLTuningCount((int)nccl_tunings.size());
+
+  // The coordinator's SM count and calibration table are used everywhere,
+  // so that all ranks compute the same allocation for a group.
+  std::vector<ChannelAllocator::Entry> table;
+  if (is_coordinator_) {
+    auto table_path = std::getenv(HOROVOD_LIBRA_CHANNEL_TABLE);
+    if (table_path != nullptr) {
+      auto status = channel_allocator_.LoadTable(table_path);
+      if (!status.ok()) {
+        LOG(ERROR) << status.reason();
+      }
+    }
+    table = channel_allocator_.Table();
+  }
+
+  int sm_count = channel_allocator_.SMCount();
+  Bcast(&sm_count, sizeof(sm_count), 0, Communicator::GLOBAL);
+  channel_allocator_.SetSMCount(sm_count);
+
+  // The SM budget of jobs sharing their devices, in percent. MPS limits its
+  // clients with CUDA_MPS_ACTIVE_THREAD_PERCENTAGE.
+  int sm_percent = 100;
+  auto mps_percentage = std::getenv("CUDA_MPS_ACTIVE_THREAD_PERCENTAGE");
+  if (mps_percentage != nullptr) {
+    sm_percent = (int)std::strtol(mps_percentage, nullptr, 10);
+  }
+  sm_percent = std::min(
+      sm_percent,
+      (int)std::lround(GetDoubleEnvOrDefault(HOROVOD_LIBRA_SM_BUDGET, 1) * 100));
+  sm_percent = std::max(1, std::min(sm_percent, 100));
+  auto sm_budget_file = std::getenv(HOROVOD_LIBRA_SM_BUDGET_FILE);
+  if (sm_budget_file != nullptr) {
+    sm_percent = ReserveSMPercentage(sm_budget_file, local_rank_, sm_percent);
+  }
+  // All ranks use the smallest budget, so that they compute the same
+  // allocation for a group. The lowest sm_percent bits are set, and the
+  // bitwise and of these keeps as many bits as the smallest budget.
+  std::vector<long long> budget_bits(2, 0);
+  for (int bit = 0; bit < sm_percent; ++bit) {
+    budget_bits[bit / 64] |= 1ll << (bit % 64);
+  }
+  CrossRankBitwiseAnd(budget_bits, (int)budget_bits.size());
+  sm_percent = 0;
+  for (auto bits : budget_bits) {
+    sm_percent += __builtin_popcountll((unsigned long long)bits);
+  }
+  channel_allocator_.SetSMBudget(std::max(1, sm_percent) / 100.0);
+  if (is_coordinator_ && sm_percent < 100) {
+    LOG(INFO) << "lyz-alloc : fusion groups are sized for " << sm_percent
+              << "% of the SMs.";
+  }
+
+  int num_entries = (int)table.size();
+  Bcast(&num_entries, sizeof(num_entries), 0, Communicator::GLOBAL);
+  table.resize(num_entries);
+  if (num_entries > 0) {
+    Bcast(table.data(), num_entries * sizeof(ChannelAllocator::Entry), 0,
+          Communicator::GLOBAL);
+  }
+  if (!is_coordinator_) {
+    channel_allocator_.SetTable(std::move(table));
+  }
 }
 
 ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
                                              HorovodGlobalState& state) {
   // Update cache capacity if autotuning is active.
-  state.fusion_group_num = this->block_size.size();
+  state.fusion_group_num = std::max((int)this->block_size.size(), 1);
   if (parameter_manager_.IsAutoTuning()) {
     response_cache_.set_capacity((int)parameter_manager_.CacheEnabled() *
                                  cache_capacity_);
@@ -183,9 +568,15 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
 
   CacheCoordinator cache_coordinator(response_cache_.num_active_bits());
 
+  // lyz - alloc
+  // Read before popping the queue, so that every tensor enqueued before the
+  // flush request is negotiated before the flush happens.
+  bool flush_requested = is_coordinator_ && fusion_group_flush_requested_;
+
   // message queue used only in this cycle
   std::deque<Request> message_queue_tmp;
   tensor_queue_.PopMessagesFromQueue(message_queue_tmp);
+  tensor_queue_.trace().Flush();
   for (auto& message : message_queue_tmp) {
     if (message.request_type() == Request::JOIN) {
       state.joined = true;
@@ -195,17 +586,18 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
 
     // Keep track of cache hits
     if (response_cache_.capacity() > 0) {
-      auto cache_ = response_cache_.cached(message);
+      uint32_t cache_bit;
+      auto cache_ = response_cache_.cached(message, cache_bit);
       if (cache_ == ResponseCache::CacheState::HIT) {
-        uint32_t cache_bit = response_cache_.peek_cache_bit(message);
+        metrics_.response_cache_hits.Increment();
         cache_coordinator.record_hit(cache_bit);
 
         // Record initial time cached tensor is encountered in queue.
         stall_inspector_.RecordCachedTensorStart(message.tensor_name());
 
       } else {
+        metrics_.response_cache_misses.Increment();
         if (cache_ == ResponseCache::CacheState::INVALID) {
-          uint32_t cache_bit = response_cache_.peek_cache_bit(message);
           cache_coordinator.record_invalid_bit(cache_bit);
         }
         cache_coordinator.set_uncached_in_queue(true);
@@ -239,12 +631,37 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
 
   cache_coordinator.set_should_shut_down(should_shut_down);
 
+  // lyz - alloc
+  // Partially filled fusion groups are only completed or flushed by the
+  // coordinator, which requires going through communication.
+  if (FusionGroupsEnabled() &&
+      (!allreduce_wait_queue.empty() || !cpu_wait_queue_.empty() ||
+       flush_requested)) {
+    cache_coordinator.set_uncached_in_queue(true);
+  }
+
+  // The parameters are sent along with the response list, so it must go
+  // through communication too.
+  bool sync_parameters = parameter_sync_requested_;
+  parameter_sync_requested_ = false;
+  if (sync_parameters) {
+    cache_coordinator.set_uncached_in_queue(true);
+  }
+
+  // Same for a Libra plan changed in a cycle of cached responses.
+  if (is_coordinator_ && libra_plan_.changed()) {
+    cache_coordinator.set_uncached_in_queue(true);
+  }
+
   if (response_cache_.capacity() > 0) {
     // Obtain common cache hits and cache invalidations across workers. Also,
     // determine if any worker has uncached messages in queue or requests
     // a shutdown. This function removes any invalid cache entries, if they
     // exist.
     CoordinateCacheAndState(cache_coordinator);
+    if (response_cache_.dynamic_shapes()) {
+      SyncCachedTensorSizes(cache_coordinator, state.joined);
+    }
     // Remove uncommon cached tensors from queue and replace to state
     // queue for next cycle. Skip adding common cached tensors to
     // queue as they are handled separately.
@@ -252,8 +669,9 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
     size_t num_messages = message_queue_tmp.size();
     for (size_t i = 0; i < num_messages; ++i) {
       auto& message = message_queue_tmp.front();
-      if (response_cache_.cached(message) == ResponseCache::CacheState::HIT) {
-        uint32_t cache_bit = response_cache_.peek_cache_bit(message);
+      uint32_t cache_bit;
+      if (response_cache_.cached(message, cache_bit) ==
+          ResponseCache::CacheState::HIT) {
         if (cache_coordinator.cache_hits().find(cache_bit) ==
             cache_coordinator.cache_hits().end()) {
           // Try to process again in next cycle.
@@ -270,6 +688,8 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
       message_queue_tmp.pop_front();
     }
     tensor_queue_.PushMessagesToQueue(messages_to_replace);
+
+    PerformInlineAllreduces(cache_coordinator, state.joined);
   }
 
   if (!message_queue_tmp.empty()) {
@@ -294,6 +714,7 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
     // otherwise we need to add cached messages to response list.
   }
 
+  libra_planning_ = need_communication && is_coordinator_;
   if (!need_communication) {
     // If all messages in queue have responses in cache, use fast path with
     // no additional coordination.
@@ -339,28 +760,33 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
         }
       }
 
-      // Receive ready tensors from other ranks
-      std::vector<RequestList> ready_list;
+      // Receive ready tensors from other ranks, read in place from the
+      // received bytes.
+      std::vector<RequestListView> ready_list;
       RecvReadyTensors(ready_to_reduce, ready_list);
 
-      // Process messages.
+      // Process messages, each of them is copied once into the message table.
       for (int i = 1; i < size_; ++i) {
         LOG(TRACE) << "Adding messages from rank " << i;
-        auto received_message_list = ready_list[i];
-        for (auto& received_message : received_message_list.requests()) {
-          auto& received_name = received_message.tensor_name();
-
-          if (received_message.request_type() == Request::JOIN) {
+        auto& received_message_list = ready_list[i];
+        for (int j = 0; j < received_message_list.size(); ++j) {
+          if (received_message_list.request_type(j) == Request::JOIN) {
             state.joined_size++;
             continue;
           }
 
-          bool reduce = IncrementTensorCount(received_message, state.joined_size);
+          Request received_message;
+          received_message_list.ParseRequest(j, received_message);
+          if (wire_session_.IsEnabled()) {
+            wire_session_.DecodeRequest(i, received_message);
+          }
           stall_inspector_.RecordUncachedTensorStart(
               received_message.tensor_name(), received_message.request_rank(),
               size_);
-          if (reduce) {
-            ready_to_reduce.push_back(received_name);
+          auto received_name = IncrementReceivedTensorCount(
+              std::move(received_message), state.joined_size);
+          if (received_name != nullptr) {
+            ready_to_reduce.push_back(*received_name);
           }
         }
         if (received_message_list.shutdown()) {
@@ -369,11 +795,17 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
         }
       }
 
+      if (state.timeline.Initialized() &&
+          stall_inspector_.ShouldReportStragglerScores()) {
+        state.timeline.StragglerScores(stall_inspector_.GetStragglerScores());
+      }
+
       // Check if tensors from previous ticks are ready to reduce after Joins.
       if (state.joined_size > 0) {
         for (auto& table_iter : message_table_) {
           int count = (int)table_iter.second.size();
-          if (count == (size_ - state.joined_size) &&
+          if (table_iter.second[0].process_set_id() == 0 &&
+              count == (size_ - state.joined_size) &&
               std::find(ready_to_reduce.begin(), ready_to_reduce.end(),
                         table_iter.first) == ready_to_reduce.end()) {
             state.timeline.NegotiateEnd(table_iter.first);
@@ -418,8 +850,35 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
       response_list = FuseResponses(responses);
       response_list.set_shutdown(should_shut_down);
 
+      // lyz - alloc
+      if (FusionGroupsEnabled()) {
+        if (ShouldFlushFusionGroups(flush_requested)) {
+          FlushFusionGroups(response_list);
+        } else if (ShouldFlushCpuFusionGroups()) {
+          FlushCpuFusionGroups(response_list);
+        }
+        response_list.set_fusion_group_id(allreduce_group_id);
+        response_list.set_cpu_fusion_group_id(cpu_group_id_);
+      }
+      ApplyLibraPlan(response_list);
+
+      // The responses of this cycle were fused with the old parameters, the
+      // new ones are used from the execution of this cycle on all ranks, see
+      // ApplyParameters.
+      if (sync_parameters) {
+        parameter_manager_.CompleteUpdate();
+        auto params = parameter_manager_.GetParams();
+        response_list.set_parameters(
+            std::string((const char*)&params, sizeof(params)));
+      }
+
       // Broadcast final results to other ranks.
-      SendFinalTensors(response_list);
+      if (wire_session_.IsEnabled()) {
+        auto encoded_list = wire_session_.EncodeResponses(response_list);
+        SendFinalTensors(encoded_list);
+      } else {
+        SendFinalTensors(response_list);
+      }
 
     } else {
       RequestList message_list;
@@ -430,10 +889,27 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
       }
 
       // Send ready tensors to rank zero
+      if (wire_session_.IsEnabled()) {
+        wire_session_.EncodeRequests(message_list);
+      }
       SendReadyTensors(message_list);
 
       // Receive final tensors to be processed from rank zero
       RecvFinalTensors(response_list);
+      if (wire_session_.IsEnabled()) {
+        wire_session_.DecodeResponses(response_list);
+      }
+      ApplyLibraPlan(response_list);
+
+      // lyz - alloc
+      // The coordinator formed the fusion groups of this cycle, drop the
+      // tensors left over from cycles fused locally and follow its group.
+      if (FusionGroupsEnabled()) {
+        allreduce_wait_queue.clear();
+        allreduce_group_id = response_list.fusion_group_id();
+        cpu_wait_queue_.clear();
+        cpu_group_id_ = response_list.cpu_fusion_group_id();
+      }
     }
   }
 
@@ -453,7 +929,9 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
     for (auto& response : response_list.responses()) {
       if ((response.response_type() == Response::ResponseType::ALLREDUCE ||
            response.response_type() == Response::ResponseType::ADASUM ||
-           response.response_type() == Response::ResponseType::ALLTOALL) &&
+           response.response_type() == Response::ResponseType::ALLTOALL ||
+           response.response_type() == Response::ResponseType::REDUCESCATTER) &&
+          response.process_set_id() == 0 &&
           (int)response.devices().size() == size_) {
         response_cache_.put(response, tensor_queue_, state.joined);
       }
@@ -463,6 +941,28 @@ ResponseList Controller::ComputeResponseList(std::atomic_bool& shut_down,
   // Reassign cache bits based on current cache order.
   response_cache_.update_cache_bits();
 
+  // lyz - alloc
+  // All ranks see the same response list, so they agree on when the fusion
+  // planner has observed enough steps.
+  if (fusion_planner_.IsPlanning()) {
+    for (auto& response : response_list.responses()) {
+      if ((response.response_type() != Response::ResponseType::ALLREDUCE &&
+           response.response_type() != Response::ResponseType::ADASUM) ||
+          IsCpuFusionResponse(response)) {
+        continue;
+      }
+      int type_size = GetTypeSize(response.tensor_type());
+      auto& names = response.tensor_names();
+      auto& sizes = response.tensor_sizes();
+      for (size_t i = 0; i < names.size() && i < sizes.size(); ++i) {
+        fusion_planner_.RecordTensor(names[i], sizes[i] * type_size);
+      }
+    }
+    if (fusion_planner_.ReadyToFreeze()) {
+      SynchronizeFusionPlan();
+    }
+  }
+
   return response_list;
 }
 
@@ -529,10 +1029,34 @@ Response Controller::ConstructResponse(std::string& name, int joined_size) {
     }
   }
 
-  // If we are doing an allreduce or broadcast, check that all tensor shapes are
-  // identical.
+  // Check that all ranks requested the collective in the same process set,
+  // which only supports allreduces for now.
+  auto process_set_id = requests[0].process_set_id();
+  for (unsigned int i = 1; i < requests.size(); ++i) {
+    if (error) {
+      break;
+    }
+
+    if (requests[i].process_set_id() != process_set_id) {
+      error = true;
+      error_message_stream << "Mismatched process sets: One rank requested "
+                           << "process set " << process_set_id
+                           << ", but another rank requested process set "
+                           << requests[i].process_set_id() << ".";
+      break;
+    }
+  }
+  if (!error && process_set_id != 0 && message_type != Request::ALLREDUCE) {
+    error = true;
+    error_message_stream << "Process sets only support allreduce, got "
+                         << Request::RequestType_Name(message_type) << ".";
+  }
+
+  // If we are doing an allreduce, reducescatter or broadcast, check that all
+  // tensor shapes are identical.
   if (message_type == Request::ALLREDUCE ||
       message_type == Request::ADASUM ||
+      message_type == Request::REDUCESCATTER ||
       message_type == Request::BROADCAST) {
     TensorShape tensor_shape;
     for (auto dim : requests[0].tensor_shape()) {
@@ -590,6 +1114,12 @@ Response Controller::ConstructResponse(std::string& name, int joined_size) {
     }
   }
 
+  // Ranks may disagree on the priority, schedule by the most urgent one.
+  int32_t priority = requests[0].priority();
+  for (unsigned int i = 1; i < requests.size(); ++i) {
+    priority = std::min(priority, requests[i].priority());
+  }
+
   std::vector<int64_t> tensor_sizes;
   if (message_type == Request::ALLGATHER ||
       message_type == Request::ALLTOALL) {
@@ -674,6 +1204,26 @@ Response Controller::ConstructResponse(std::string& name, int joined_size) {
     tensor_sizes.push_back(tensor_shape.num_elements());
   }
 
+  if (message_type == Request::REDUCESCATTER) {
+    if (joined_size > 0) {
+      error = true;
+      error_message_stream << "Reducescatter is not supported with Join at this time.";
+    }
+
+    // The tensor is scattered along its first dimension.
+    TensorShape tensor_shape;
+    for (auto dim : requests[0].tensor_shape()) {
+      tensor_shape.AddDim(dim);
+    }
+    if (!error && tensor_shape.dims() == 0) {
+      error = true;
+      error_message_stream << "Rank zero tried to "
+                           << Request::RequestType_Name(message_type)
+                           << " a rank-zero tensor.";
+    }
+    tensor_sizes.push_back(tensor_shape.num_elements());
+  }
+
   if (message_type == Request::BROADCAST) {
     if (joined_size > 0) {
       error = true;
@@ -720,7 +1270,11 @@ Response Controller::ConstructResponse(std::string& name, int joined_size) {
   }
   std::vector<int32_t> devices(requests.size());
   for (auto& request : requests) {
-    devices[request.request_rank()] = request.device();
+    int position = process_set_id != 0
+                       ? process_sets_.RankInSet(process_set_id,
+                                                 request.request_rank())
+                       : request.request_rank();
+    devices[position] = request.device();
   }
 
   Response response;
@@ -746,6 +1300,12 @@ Response Controller::ConstructResponse(std::string& name, int joined_size) {
     response.set_response_type(Response::BROADCAST);
   } else if (message_type == Request::ALLTOALL) {
     response.set_response_type(Response::ALLTOALL);
+  } else if (message_type == Request::REDUCESCATTER) {
+    response.set_response_type(Response::REDUCESCATTER);
+    for (auto dim : tensor_sizes) {
+      response.add_tensor_size(dim);
+    }
+    response.set_tensor_type(data_type);
   } else if (message_type == Request::ADASUM) {
     response.set_response_type(Response::ADASUM);
     for (auto dim : tensor_sizes) {
@@ -756,6 +1316,8 @@ Response Controller::ConstructResponse(std::string& name, int joined_size) {
     response.set_postscale_factor(postscale_factor);
   }
   response.set_devices(devices);
+  response.set_priority(priority);
+  response.set_process_set_id(process_set_id);
 
   // Clear all queued up requests for this name. They are now taken care of
   // by the constructed response.
@@ -792,11 +1354,187 @@ void Controller::CoordinateCacheAndState(CacheCoordinator& cache_coordinator) {
   }
 }
 
+void Controller::SyncCachedTensorSizes(CacheCoordinator& cache_coordinator,
+                                       bool joined) {
+  // Each rank contributes the number of elements n of its tensor and ~n, so
+  // that the bitwise and of the first is the bitwise not of the second only
+  // if all of them agree. Joined ranks contribute all ones to both.
+  std::vector<uint32_t> bits;
+  std::vector<long long> sizes;
+  for (auto bit : cache_coordinator.cache_hits()) {
+    auto& response = response_cache_.peek_response(bit);
+    if (!response_cache_.shape_agnostic(response)) {
+      continue;
+    }
+    long long n = -1;
+    long long not_n = -1;
+    if (!joined) {
+      auto& entry = tensor_queue_.GetTensorEntry(response.tensor_names()[0]);
+      n = entry.tensor->shape().num_elements();
+      not_n = ~n;
+    }
+    bits.push_back(bit);
+    sizes.push_back(n);
+    sizes.push_back(not_n);
+  }
+  if (bits.empty()) {
+    return;
+  }
+
+  CrossRankBitwiseAnd(sizes, (int)sizes.size());
+
+  for (size_t i = 0; i < bits.size(); ++i) {
+    long long n = sizes[2 * i];
+    long long not_n = sizes[2 * i + 1];
+    if (n == -1 && not_n == -1) {
+      continue;
+    }
+    if (n == ~not_n) {
+      response_cache_.set_tensor_size(bits[i], n);
+    } else {
+      // The coordinator reports the mismatch, if the tensors can't be reduced.
+      auto& response = response_cache_.peek_response(bits[i]);
+      LOG(DEBUG, rank_) << "Sizes of cached tensor "
+                        << response.tensor_names()[0]
+                        << " differ between ranks, renegotiating it.";
+      response_cache_.erase_response(bits[i]);
+      cache_coordinator.renegotiate_hit(bits[i]);
+    }
+  }
+}
+
+// The values of the inline allreduces are summed as doubles, which holds
+// these types exactly.
+static bool InlineAllreduceType(DataType dtype) {
+  return dtype == HOROVOD_FLOAT32 || dtype == HOROVOD_FLOAT64 ||
+         dtype == HOROVOD_INT32;
+}
+
+template <typename T>
+static void LoadInlineValues(const void* data, int64_t n, double scale,
+                             double* values) {
+  auto typed = (const T*)data;
+  for (int64_t i = 0; i < n; ++i) {
+    values[i] = (double)typed[i] * scale;
+  }
+}
+
+template <typename T>
+static void StoreInlineValues(const double* values, int64_t n, double scale,
+                              void* data) {
+  auto typed = (T*)data;
+  for (int64_t i = 0; i < n; ++i) {
+    typed[i] = (T)(values[i] * scale);
+  }
+}
+
+void Controller::PerformInlineAllreduces(CacheCoordinator& cache_coordinator,
+                                         bool joined) {
+  if (inline_allreduce_bytes_ <= 0) {
+    return;
+  }
+
+  // All ranks have the same hits and cached responses, so they pick the
+  // same tensors.
+  std::vector<uint32_t> bits;
+  int64_t payload_bytes = 0;
+  int64_t num_values = 0;
+  for (auto bit : cache_coordinator.cache_hits()) {
+    auto& response = response_cache_.peek_response(bit);
+    if (response.response_type() != Response::ALLREDUCE ||
+        response.tensor_names().size() != 1 ||
+        !InlineAllreduceType(response.tensor_type()) ||
+        std::any_of(response.devices().begin(), response.devices().end(),
+                    [](int32_t device) { return device != CPU_DEVICE_ID; })) {
+      continue;
+    }
+    int64_t n = response.tensor_sizes()[0];
+    int64_t bytes = n * DataType_Size(response.tensor_type());
+    if (payload_bytes + bytes > inline_allreduce_bytes_) {
+      continue;
+    }
+    payload_bytes += bytes;
+    num_values += n;
+    bits.push_back(bit);
+  }
+  if (bits.empty()) {
+    return;
+  }
+
+  // A joined rank contributes zeros.
+  std::vector<double> values(num_values, 0.0);
+  std::vector<Response> responses;
+  std::vector<TensorTableEntry> entries;
+  int64_t offset = 0;
+  for (auto bit : bits) {
+    // Updates the cache order like the other hits.
+    responses.push_back(response_cache_.get_response(bit));
+    cache_coordinator.erase_hit(bit);
+    auto& response = responses.back();
+    int64_t n = response.tensor_sizes()[0];
+    if (!joined) {
+      tensor_queue_.GetTensorEntriesFromResponse(response, entries);
+      auto& e = entries.back();
+      if (e.ready_event != nullptr) {
+        while (!(e.comp_ready != nullptr && e.comp_ready->load()) &&
+               !e.ready_event->Ready()) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(100));
+        }
+      }
+      timeline_.Start(e.tensor_name, response.response_type());
+      double scale = response.prescale_factor();
+      switch (response.tensor_type()) {
+      case HOROVOD_FLOAT32:
+        LoadInlineValues<float>(e.tensor->data(), n, scale, &values[offset]);
+        break;
+      case HOROVOD_FLOAT64:
+        LoadInlineValues<double>(e.tensor->data(), n, scale, &values[offset]);
+        break;
+      default:
+        LoadInlineValues<int32_t>(e.tensor->data(), n, scale,
+                                  &values[offset]);
+        break;
+      }
+    }
+    offset += n;
+  }
+
+  CrossRankSum(values);
+  if (joined) {
+    return;
+  }
+
+  offset = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    auto& e = entries[i];
+    auto& response = responses[i];
+    int64_t n = response.tensor_sizes()[0];
+    double scale = response.postscale_factor();
+    void* output = (void*)e.output->data();
+    switch (response.tensor_type()) {
+    case HOROVOD_FLOAT32:
+      StoreInlineValues<float>(&values[offset], n, scale, output);
+      break;
+    case HOROVOD_FLOAT64:
+      StoreInlineValues<double>(&values[offset], n, scale, output);
+      break;
+    default:
+      StoreInlineValues<int32_t>(&values[offset], n, scale, output);
+      break;
+    }
+    timeline_.End(e.tensor_name, e.output);
+    offset += n;
+  }
+  InvokeCallbacks(entries, Status::OK());
+}
+
 ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
   ResponseList response_list;
+  // Groups are formed in arrival order, priorities only decide the order in
+  // which the finished groups are sent, in AddPrioritizedResponse.
   while (!responses.empty()) {
 
-    auto response = responses.front();
+    auto response = std::move(responses.front());
     assert(response.tensor_names().size() == 1);
     responses.pop_front();
     int64_t tensor_size = 0;
@@ -805,104 +1543,67 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
     response.block_num = 0;
     response.thread_num = 0;
 
-    if (response.response_type() == Response::ResponseType::ALLREDUCE && group_size[0] != 0) {
-      // Attempt to add more responses to this fused response.
-      tensor_size = response.tensor_sizes()[0] * GetTypeSize(response.tensor_type());
+    bool grouped = (response.response_type() == Response::ResponseType::ALLREDUCE ||
+                    response.response_type() == Response::ResponseType::ADASUM) &&
+                   response.process_set_id() == 0 && FusionGroupsEnabled();
+    bool cpu = grouped && IsCpuFusionResponse(response);
+    if (cpu && !cpu_group_size_.empty()) {
+      // CPU tensors fill the groups of their own pipeline.
+      cpu_wait_start_ = std::chrono::steady_clock::now();
+      cpu_wait_queue_.push_back(std::move(response));
+      Response group;
+      while (PopCpuFusionGroup(group)) {
+        AddPrioritizedResponse(response_list, std::move(group));
+        group = Response();
+      }
+      tensor_fusion_generated = false;
+
+    // Adasum responses are grouped like allreduces, so that their NCCL phases
+    // get the streams and channels of their fusion group.
+    } else if (grouped && !cpu) {
       std::deque<Response> skipped_responses;
-      int64_t skipped_size = 0;
       // lyz - alloc
-      std::deque<Response> allreduce_current_queue;
-      allreduce_current_queue.push_back(std::move(response));
+      // Put all responses that can fuse with this one behind the responses
+      // still waiting from previous cycles. References into a deque stay
+      // valid on push_back.
+      allreduce_wait_start = std::chrono::steady_clock::now();
+      if (allreduce_wait_queue.empty()) {
+        allreduce_fill_start = allreduce_wait_start;
+      }
+      allreduce_wait_queue.push_back(std::move(response));
+      const Response& first_response = allreduce_wait_queue.back();
       while (!responses.empty()) {
         auto& new_response = responses.front();
         assert(new_response.tensor_names().size() == 1);
 
-        int64_t new_tensor_size = new_response.tensor_sizes().empty()
-                                      ? 0
-                                      : new_response.tensor_sizes()[0] *
-                                        GetTypeSize(new_response.tensor_type());
-        if (response.response_type() == new_response.response_type() &&
-            response.devices() == new_response.devices() &&
-            response.tensor_type() == new_response.tensor_type() &&
-            true &&
-            response.prescale_factor() == new_response.prescale_factor() &&
-            response.postscale_factor() == new_response.postscale_factor()) {
-          // lyz - alloc remove[tensor_size + new_tensor_size <= TensorFusionThresholdBytes()]
-          // first put all responses into a tmp queue
-          allreduce_current_queue.push_back(std::move(new_response));
+        if (first_response.response_type() == new_response.response_type() &&
+            first_response.process_set_id() == new_response.process_set_id() &&
+            first_response.devices() == new_response.devices() &&
+            first_response.tensor_type() == new_response.tensor_type() &&
+            first_response.prescale_factor() == new_response.prescale_factor() &&
+            first_response.postscale_factor() == new_response.postscale_factor()) {
+          allreduce_wait_queue.push_back(std::move(new_response));
           responses.pop_front();
         } else {
-          // In general, don't try to fuse additional tensors since they are
-          // usually computed in order of requests and skipping tensors may
-          // mean that the batch will have to wait longer while skipped
-          // tensors could be reduced at that time. However, mixed-precision
-          // training may yield requests of various dtype in a mixed-up
-          // sequence causing breakups in fusion. To counter this some look
-          // ahead is allowed.
-
-          skipped_size += new_tensor_size;
-          // lyz - alloc remove[tensor_size + skipped_size <= TensorFusionThresholdBytes()]
-          if (true) {
-            // Skip response and look ahead for more to fuse.
-            skipped_responses.push_back(std::move(new_response));
-            responses.pop_front();
-          } else {
-            break;
-          }
+          // Fusion groups are formed across cycles, so every response that
+          // does not fuse with this one is looked at later in this cycle.
+          skipped_responses.push_back(std::move(new_response));
+          responses.pop_front();
         }
       }
 
-      // check if enough allreduce responses has arrived for the given fusion group size
-      int total_num = allreduce_current_queue.size() +  allreduce_wait_queue.size();
-      int expected_group_num = group_size[allreduce_group_id];
-      int excessive_num = total_num - expected_group_num;
-      if (excessive_num >= 0) {
-        int block_num = block_size[allreduce_group_id];
-        int thread_num = thread_size[allreduce_group_id];
-        allreduce_group_id = ((allreduce_group_id + 1) % group_size.size());
-        int num_from_wait_queue = allreduce_wait_queue.size() >= expected_group_num? expected_group_num : allreduce_wait_queue.size();
-        int num_from_current_cycle = expected_group_num - num_from_wait_queue;
-        
-        if (num_from_wait_queue > 0) {
-          response = allreduce_wait_queue.front();
-          assert(response.tensor_names().size() == 1);
-          allreduce_wait_queue.pop_front();
-          num_from_wait_queue -= 1;
-          response.block_num = 0;
-          response.thread_num = 0;
-        }
-        else {
-          response = allreduce_current_queue.front();
-          assert(response.tensor_names().size() == 1);
-          allreduce_current_queue.pop_front();
-          num_from_current_cycle -= 1;
-          response.block_num = 0;
-          response.thread_num = 0;
-        }
-
-        // These tensors will fuse together well.
-        for (int i = 0; i < num_from_wait_queue; i++) {
-          auto& new_response = allreduce_wait_queue.front();
-          response.add_tensor_name(std::move(new_response.tensor_names()[0]));
-          response.add_tensor_size(new_response.tensor_sizes()[0]);                             
-          allreduce_wait_queue.pop_front();
+      // Send every group that is complete, the rest keeps waiting.
+      Response group;
+      while (PopFusionGroup(group)) {
+        tensor_size = 0;
+        for (auto size : group.tensor_sizes()) {
+          tensor_size += size * GetTypeSize(group.tensor_type());
         }
-        for (int i = 0; i < num_from_current_cycle; i++) {
-          auto& new_response = allreduce_current_queue.front();
-          response.add_tensor_name(std::move(new_response.tensor_names()[0]));
-          response.add_tensor_size(new_response.tensor_sizes()[0]);                             
-          allreduce_current_queue.pop_front();
-        }
-        response.block_num = block_num;
-        response.thread_num = thread_num;
-      }
-      else tensor_fusion_generated = false;
-     
-      // move remaining responses to the waiting queue
-      for (int i = 0; i < allreduce_current_queue.size(); i++) {
-        allreduce_wait_queue.push_back(std::move(allreduce_current_queue.front()));
-        allreduce_current_queue.pop_front();
+        LOG(TRACE) << "Created fusion group of size " << tensor_size;
+        AddPrioritizedResponse(response_list, std::move(group));
+        group = Response();
       }
+      tensor_fusion_generated = false;
 
       // Replace any skipped responses.
       while (!skipped_responses.empty()) {
@@ -924,15 +1625,17 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
                                       : new_response.tensor_sizes()[0] *
                                         GetTypeSize(new_response.tensor_type());
         if (response.response_type() == new_response.response_type() &&
+            response.process_set_id() == new_response.process_set_id() &&
             response.devices() == new_response.devices() &&
             response.tensor_type() == new_response.tensor_type() &&
-            -1 <= TensorFusionThresholdBytes() &&
+            tensor_size + new_tensor_size <= TensorFusionThresholdBytes() &&
             response.prescale_factor() == new_response.prescale_factor() &&
             response.postscale_factor() == new_response.postscale_factor()) {
           // These tensors will fuse together well.
           tensor_size += new_tensor_size;
-          response.add_tensor_name(std::move(new_response.tensor_names()[0]));
-          response.add_tensor_size(new_response.tensor_sizes()[0]);
+          response.set_priority(
+              std::min(response.priority(), new_response.priority()));
+          response.add_fused_response(std::move(new_response));
           responses.pop_front();
         } else {
           // In general, don't try to fuse additional tensors since they are
@@ -958,6 +1661,12 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
         responses.push_front(std::move(skipped_responses.back()));
         skipped_responses.pop_back();
       }
+      if (libra_all_collectives_) {
+        channel_allocator_.Allocate(tensor_size, response.block_num,
+                                    response.thread_num);
+      }
+      AddPrioritizedResponse(response_list, std::move(response));
+      tensor_fusion_generated = false;
 
     } else if (response.response_type() == Response::ResponseType::ALLGATHER) {
       // Attempt to add more responses to this fused response.
@@ -988,7 +1697,7 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
 
           // These tensors will fuse together well.
           total_byte_size_of_output += new_total_byte_size_of_output;
-          response.add_allgather_response(new_response);
+          response.add_allgather_response(std::move(new_response));
           responses.pop_front();
 
         } else {
@@ -1017,6 +1726,106 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
         responses.push_front(std::move(skipped_responses.back()));
         skipped_responses.pop_back();
       }
+      if (libra_all_collectives_) {
+        channel_allocator_.Allocate(total_byte_size_of_output,
+                                    response.block_num, response.thread_num);
+      }
+    } else if (response.response_type() == Response::ResponseType::ALLTOALL) {
+      // Alltoalls issued back to back, like the expert dispatches of a
+      // mixture-of-experts layer, are fused up to the threshold of their
+      // input size, so that their splits are exchanged and their tensors
+      // sent together.
+      tensor_size =
+          tensor_queue_.GetTensorEntry(response.tensor_names()[0]).tensor->size();
+      while (!responses.empty()) {
+        auto& new_response = responses.front();
+        assert(new_response.tensor_names().size() == 1);
+        if (new_response.response_type() != response.response_type() ||
+            new_response.devices() != response.devices()) {
+          break;
+        }
+        int64_t new_tensor_size =
+            tensor_queue_.GetTensorEntry(new_response.tensor_names()[0])
+                .tensor->size();
+        if (tensor_size + new_tensor_size > TensorFusionThresholdBytes()) {
+          break;
+        }
+        tensor_size += new_tensor_size;
+        response.add_fused_response(std::move(new_response));
+        responses.pop_front();
+      }
+    } else if (response.response_type() == Response::ResponseType::BROADCAST) {
+      // Broadcasts of the same root and type, like the parameters broadcast
+      // at startup, are packed into the fusion buffer up to the threshold.
+      const auto& entry =
+          tensor_queue_.GetTensorEntry(response.tensor_names()[0]);
+      tensor_size = entry.tensor->size();
+#if HOROVOD_GPU_BROADCAST == 'N'
+      bool fuse = true;
+#else
+      // GPU tensors are broadcast in place by MPI, only host tensors are
+      // packed.
+      bool fuse = entry.device == CPU_DEVICE_ID;
+#endif
+      while (fuse && !responses.empty()) {
+        auto& new_response = responses.front();
+        assert(new_response.tensor_names().size() == 1);
+        if (new_response.response_type() != response.response_type() ||
+            new_response.devices() != response.devices()) {
+          break;
+        }
+        const auto& new_entry =
+            tensor_queue_.GetTensorEntry(new_response.tensor_names()[0]);
+        if (new_entry.root_rank != entry.root_rank ||
+            new_entry.tensor->dtype() != entry.tensor->dtype() ||
+            tensor_size + new_entry.tensor->size() >
+                TensorFusionThresholdBytes()) {
+          break;
+        }
+        tensor_size += new_entry.tensor->size();
+        response.add_fused_response(std::move(new_response));
+        responses.pop_front();
+      }
+      if (libra_all_collectives_) {
+        channel_allocator_.Allocate(tensor_size, response.block_num,
+                                    response.thread_num);
+      }
+    } else if (response.response_type() ==
+               Response::ResponseType::REDUCESCATTER) {
+      // Reducescatters of the same type, like the gradient shards of a
+      // sharded optimizer, are packed into the fusion buffer up to the
+      // threshold.
+      int64_t type_size = GetTypeSize(response.tensor_type());
+      tensor_size = response.tensor_sizes()[0] * type_size;
+#if HOROVOD_GPU_ALLREDUCE == 'N'
+      bool fuse = true;
+#else
+      // GPU tensors are reduced where they are by MPI, only host tensors are
+      // packed.
+      bool fuse = tensor_queue_.GetTensorEntry(response.tensor_names()[0])
+                      .device == CPU_DEVICE_ID;
+#endif
+      while (fuse && !responses.empty()) {
+        auto& new_response = responses.front();
+        assert(new_response.tensor_names().size() == 1);
+        int64_t new_tensor_size = new_response.tensor_sizes().empty()
+                                      ? 0
+                                      : new_response.tensor_sizes()[0] *
+                                            type_size;
+        if (new_response.response_type() != response.response_type() ||
+            new_response.devices() != response.devices() ||
+            new_response.tensor_type() != response.tensor_type() ||
+            tensor_size + new_tensor_size > TensorFusionThresholdBytes()) {
+          break;
+        }
+        tensor_size += new_tensor_size;
+        response.add_fused_response(std::move(new_response));
+        responses.pop_front();
+      }
+      if (libra_all_collectives_) {
+        channel_allocator_.Allocate(tensor_size, response.block_num,
+                                    response.thread_num);
+      }
     }
 
     if (tensor_fusion_generated) {
@@ -1024,9 +1833,399 @@ ResponseList Controller::FuseResponses(std::deque<Response>& responses) {
     }
     LOG(TRACE) << "Created response of size " << tensor_size;
   }
+  SendPrioritizedResponses(response_list);
   return response_list;
 }
 
+void Controller::AddPrioritizedResponse(ResponseList& response_list,
+                                        Response&& response) {
+  if (!fusion_priority_enabled_) {
+    response_list.add_response(std::move(response));
+    return;
+  }
+  int32_t priority = response.priority();
+  prioritized_responses_.push_back(
+      {priority, prioritized_sequence_++, std::move(response)});
+  std::push_heap(prioritized_responses_.begin(), prioritized_responses_.end());
+}
+
+void Controller::SendPrioritizedResponses(ResponseList& response_list) {
+  while (!prioritized_responses_.empty()) {
+    std::pop_heap(prioritized_responses_.begin(), prioritized_responses_.end());
+    auto& next = prioritized_responses_.back();
+    LOG(TRACE) << "Sending response of priority " << next.priority;
+    response_list.add_response(std::move(next.response));
+    prioritized_responses_.pop_back();
+  }
+  prioritized_sequence_ = 0;
+}
+
+bool Controller::FusionGroupsEnabled() const {
+  return fusion_mode_ != FusionMode::THRESHOLD && !group_size.empty() &&
+         (group_size[0] != 0 || group_bytes[0] != 0);
+}
+
+bool Controller::ShouldFlushFusionGroups(bool flush_requested) {
+  if (flush_requested) {
+    // Wait until no allreduce is still being negotiated.
+    bool negotiating = false;
+    for (auto& entry : message_table_) {
+      if (entry.second[0].request_type() == Request::ALLREDUCE ||
+          entry.second[0].request_type() == Request::ADASUM) {
+        negotiating = true;
+        break;
+      }
+    }
+    if (!negotiating) {
+      fusion_group_flush_requested_ = false;
+      return true;
+    }
+  }
+
+  if (!allreduce_wait_queue.empty() && fusion_group_flush_timeout_ms_ > 0) {
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - allreduce_wait_start);
+    if (waited.count() >= fusion_group_flush_timeout_ms_) {
+      LOG(DEBUG) << "lyz-alloc : flushing " << allreduce_wait_queue.size()
+                 << " tensors of fusion group " << allreduce_group_id
+                 << " after " << waited.count() << " ms.";
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Controller::ShouldFlushCpuFusionGroups() const {
+  if (cpu_wait_queue_.empty() || fusion_group_flush_timeout_ms_ <= 0) {
+    return false;
+  }
+  auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - cpu_wait_start_);
+  return waited.count() >= fusion_group_flush_timeout_ms_;
+}
+
+void Controller::FlushFusionGroups(ResponseList& response_list) {
+  Response group;
+  while (PopFusionGroup(group, true)) {
+    AddPrioritizedResponse(response_list, std::move(group));
+    group = Response();
+  }
+  FlushCpuFusionGroups(response_list);
+  // A flush ends the step, the next step starts with the first group.
+  allreduce_group_id = 0;
+}
+
+void Controller::FlushCpuFusionGroups(ResponseList& response_list) {
+  Response group;
+  while (PopCpuFusionGroup(group, true)) {
+    AddPrioritizedResponse(response_list, std::move(group));
+    group = Response();
+  }
+  SendPrioritizedResponses(response_list);
+  // Also when only the CPU groups timed out, the next step starts with the
+  // first CPU group.
+  cpu_group_id_ = 0;
+}
+
+// Fuses the first count responses of queue into one.
+static Response TakeFusionGroup(std::deque<Response>& queue, int count) {
+  Response group = std::move(queue.front());
+  assert(group.tensor_names().size() == 1);
+  queue.pop_front();
+  group.reserve_tensors(count);
+  for (int i = 1; i < count; ++i) {
+    auto& new_response = queue.front();
+    group.set_priority(std::min(group.priority(), new_response.priority()));
+    group.add_fused_response(std::move(new_response));
+    queue.pop_front();
+  }
+  return group;
+}
+
+bool Controller::PopFusionGroup(Response& group, bool flush) {
+  if (allreduce_wait_queue.empty()) {
+    return false;
+  }
+
+  // Never build a group larger than the fusion buffer.
+  int64_t fusion_threshold = TensorFusionThresholdBytes();
+  if (fusion_group_cache_.size() != group_size.size() ||
+      fusion_group_cache_threshold_ != fusion_threshold) {
+    fusion_group_cache_.assign(group_size.size(), Response());
+    fusion_group_cache_threshold_ = fusion_threshold;
+  }
+  // The autotuner scales the groups of the specification.
+  double group_scale = parameter_manager_.LibraGroupScale();
+  int max_count = group_size[allreduce_group_id];
+  int64_t max_bytes = group_bytes[allreduce_group_id];
+  if (group_scale != 1) {
+    max_count = max_count > 0 ? std::max(1, (int)std::lround(max_count * group_scale)) : 0;
+    max_bytes = max_bytes > 0 ? std::max((int64_t)1, (int64_t)(max_bytes * group_scale)) : 0;
+  }
+  if (fusion_threshold > 0 && (max_bytes == 0 || fusion_threshold < max_bytes)) {
+    max_bytes = fusion_threshold;
+  }
+  int local_count = max_count;
+  int64_t local_bytes = max_bytes;
+  // In cycles of cached responses every rank fuses on its own, with the sizes
+  // the coordinator planned for the group.
+  auto planned = libra_planning_ ? nullptr : libra_plan_.group(allreduce_group_id);
+  if (planned != nullptr) {
+    max_count = planned->max_count;
+    max_bytes = planned->max_bytes;
+  }
+  if (ReplayFusionGroup(group, max_count, max_bytes)) {
+    PlanFusionGroup(group, local_count, local_bytes);
+    allreduce_group_id = (allreduce_group_id + 1) % (int)group_size.size();
+    allreduce_wait_start = std::chrono::steady_clock::now();
+    metrics_.fusion_group_fill_seconds.Observe(
+        std::chrono::duration<double>(allreduce_wait_start -
+                                      allreduce_fill_start)
+            .count());
+    allreduce_fill_start = allreduce_wait_start;
+    return true;
+  }
+
+  bool complete;
+  int count = CountFusionGroup(allreduce_wait_queue, max_count, max_bytes,
+                               complete);
+  if (!complete && !flush) {
+    return false;
+  }
+
+  group = TakeFusionGroup(allreduce_wait_queue, count);
+  group.block_num = channel_allocator_.ScaleToSMBudget(block_size[allreduce_group_id]);
+  group.thread_num = thread_size[allreduce_group_id];
+  if (group.block_num == 0 && group.thread_num == 0) {
+    int64_t group_bytes = 0;
+    for (auto size : group.tensor_sizes()) {
+      group_bytes += size * GetTypeSize(group.tensor_type());
+    }
+    channel_allocator_.Allocate(group_bytes, group.block_num, group.thread_num,
+                                group.nccl_tuning);
+  }
+  double block_scale = parameter_manager_.LibraBlockScale();
+  if (group.block_num > 0 && block_scale != 1) {
+    group.block_num = std::max(1, (int)std::lround(group.block_num * block_scale));
+  }
+  if (group.block_num > 0 && parameter_manager_.LibraThreadNum() > 0) {
+    group.thread_num = parameter_manager_.LibraThreadNum();
+  }
+  if (allreduce_group_id < (int)split_block_size.size() &&
+      group.response_type() == Response::ALLREDUCE) {
+    group.split_block_num =
+        channel_allocator_.ScaleToSMBudget(split_block_size[allreduce_group_id]);
+    group.split_thread_num = split_thread_size[allreduce_group_id] > 0
+                                 ? split_thread_size[allreduce_group_id]
+                                 : group.thread_num;
+  }
+  // The parts of split groups run on the default and split communicators.
+  if (group.split_block_num > 0) {
+    group.nccl_tuning = 0;
+  }
+  if (complete) {
+    fusion_group_cache_[allreduce_group_id] = group;
+  }
+  PlanFusionGroup(group, local_count, local_bytes);
+  allreduce_group_id = (allreduce_group_id + 1) % (int)group_size.size();
+  allreduce_wait_start = std::chrono::steady_clock::now();
+  metrics_.fusion_group_fill_seconds.Observe(
+      std::chrono::duration<double>(allreduce_wait_start - allreduce_fill_start)
+          .count());
+  // Tensors left in the queue already count towards the next group.
+  allreduce_fill_start = allreduce_wait_start;
+  return true;
+}
+
+// A group is complete once it holds its tensor count, or once the next
+// waiting tensor would not fit into its byte budget or cannot be fused with
+// it, like an Adasum behind allreduces queued in earlier cycles.
+int Controller::CountFusionGroup(const std::deque<Response>& queue,
+                                 int max_count, int64_t max_bytes,
+                                 bool& complete) {
+  int count = 0;
+  int64_t bytes = 0;
+  complete = false;
+  auto& first = queue.front();
+  for (auto& waiting : queue) {
+    int64_t waiting_bytes =
+        waiting.tensor_sizes()[0] * GetTypeSize(waiting.tensor_type());
+    if (count > 0 &&
+        (waiting.response_type() != first.response_type() ||
+         waiting.tensor_type() != first.tensor_type() ||
+         waiting.devices() != first.devices() ||
+         waiting.prescale_factor() != first.prescale_factor() ||
+         waiting.postscale_factor() != first.postscale_factor())) {
+      complete = true;
+      break;
+    }
+    if (max_bytes > 0 && count > 0 && bytes + waiting_bytes > max_bytes) {
+      complete = true;
+      break;
+    }
+    bytes += waiting_bytes;
+    ++count;
+    if ((max_count > 0 && count == max_count) ||
+        (max_bytes > 0 && bytes >= max_bytes)) {
+      complete = true;
+      break;
+    }
+  }
+  return count;
+}
+
+bool Controller::IsCpuFusionResponse(const Response& response) const {
+#if HAVE_GPU
+  return std::all_of(response.devices().begin(), response.devices().end(),
+                     [](int32_t device) { return device == CPU_DEVICE_ID; });
+#else
+  return false;
+#endif
+}
+
+// The CPU groups only have sizes, their tensors are reduced on the host.
+bool Controller::PopCpuFusionGroup(Response& group, bool flush) {
+  if (cpu_wait_queue_.empty()) {
+    return false;
+  }
+  int max_count = cpu_group_size_[cpu_group_id_];
+  int64_t max_bytes = cpu_group_bytes_[cpu_group_id_];
+  int64_t fusion_threshold = TensorFusionThresholdBytes();
+  if (fusion_threshold > 0 && (max_bytes == 0 || fusion_threshold < max_bytes)) {
+    max_bytes = fusion_threshold;
+  }
+  bool complete;
+  int count = CountFusionGroup(cpu_wait_queue_, max_count, max_bytes, complete);
+  if (!complete && !flush) {
+    return false;
+  }
+  group = TakeFusionGroup(cpu_wait_queue_, count);
+  cpu_group_id_ = (cpu_group_id_ + 1) % (int)cpu_group_size_.size();
+  cpu_wait_start_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+// The feedback only runs on the coordinator. It plans the groups it fuses in
+// cycles that go through communication. In cycles of cached responses every
+// rank uses the allocation planned for the group, or the open loop one if it
+// was not planned yet, and the coordinator records where it would deviate
+// from the plan, which is then sent along with the next response list.
+void Controller::PlanFusionGroup(Response& group, int max_count,
+                                 int64_t max_bytes) {
+  LibraPlan::Allocation allocation;
+  allocation.block_num = group.block_num;
+  allocation.thread_num = group.thread_num;
+  allocation.split_block_num = group.split_block_num;
+  allocation.split_thread_num = group.split_thread_num;
+  allocation.nccl_tuning = group.nccl_tuning;
+  if (!libra_planning_) {
+    auto planned = libra_plan_.group(allreduce_group_id);
+    if (planned != nullptr) {
+      auto& applied = libra_plan_.allocation(planned->allocation);
+      group.block_num = applied.block_num;
+      group.thread_num = applied.thread_num;
+      group.split_block_num = applied.split_block_num;
+      group.split_thread_num = applied.split_thread_num;
+      group.nccl_tuning = applied.nccl_tuning;
+    }
+  }
+  if (!is_coordinator_) {
+    return;
+  }
+  channel_feedback_.Adjust(group.tensor_names()[0], allocation.block_num);
+  LibraPlan::Group planned;
+  planned.max_count = max_count;
+  planned.max_bytes = max_bytes;
+  planned.allocation = libra_plan_.Intern(allocation);
+  libra_plan_.SetGroup(allreduce_group_id, planned);
+  if (libra_planning_) {
+    group.block_num = allocation.block_num;
+  }
+}
+
+void Controller::ApplyLibraPlan(ResponseList& response_list) {
+  if (is_coordinator_) {
+    for (auto& response : response_list.mutable_responses()) {
+      LibraPlan::Allocation allocation;
+      allocation.block_num = response.block_num;
+      allocation.thread_num = response.thread_num;
+      allocation.split_block_num = response.split_block_num;
+      allocation.split_thread_num = response.split_thread_num;
+      allocation.nccl_tuning = response.nccl_tuning;
+      response.libra_allocation = libra_plan_.Intern(allocation);
+    }
+    if (libra_plan_.changed()) {
+      std::string plan;
+      libra_plan_.SerializeToString(plan);
+      response_list.set_libra_plan(plan);
+    }
+    return;
+  }
+  if (!response_list.libra_plan().empty() &&
+      !libra_plan_.ParseFromString(response_list.libra_plan())) {
+    throw std::logic_error("lyz-alloc : received a malformed Libra plan.");
+  }
+  for (auto& response : response_list.mutable_responses()) {
+    auto& allocation = libra_plan_.allocation(response.libra_allocation);
+    response.block_num = allocation.block_num;
+    response.thread_num = allocation.thread_num;
+    response.split_block_num = allocation.split_block_num;
+    response.split_thread_num = allocation.split_thread_num;
+    response.nccl_tuning = allocation.nccl_tuning;
+  }
+}
+
+// For a fixed model the same tensors wait for the same group every step, so
+// the group built last time is sent again without being assembled, as long
+// as it would be complete under the same rules.
+bool Controller::ReplayFusionGroup(Response& group, int max_count,
+                                   int64_t max_bytes) {
+  auto& cached = fusion_group_cache_[allreduce_group_id];
+  auto& names = cached.tensor_names();
+  auto& sizes = cached.tensor_sizes();
+  size_t count = names.size();
+  if (count == 0 || allreduce_wait_queue.size() < count) {
+    return false;
+  }
+  auto& first = allreduce_wait_queue.front();
+  if (first.response_type() != cached.response_type() ||
+      first.tensor_type() != cached.tensor_type() ||
+      first.devices() != cached.devices() ||
+      first.prescale_factor() != cached.prescale_factor() ||
+      first.postscale_factor() != cached.postscale_factor()) {
+    return false;
+  }
+  int type_size = GetTypeSize(cached.tensor_type());
+  int64_t bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    auto& waiting = allreduce_wait_queue[i];
+    if (waiting.tensor_sizes()[0] != sizes[i] ||
+        waiting.tensor_names()[0] != names[i]) {
+      return false;
+    }
+    bytes += sizes[i] * type_size;
+  }
+  bool complete = (max_count > 0 && (int)count == max_count) ||
+                  (max_bytes > 0 && bytes >= max_bytes);
+  if (!complete && allreduce_wait_queue.size() > count) {
+    // The group may also have been ended by the tensor behind it.
+    auto& next = allreduce_wait_queue[count];
+    complete = next.response_type() != cached.response_type() ||
+               (max_bytes > 0 &&
+                bytes + next.tensor_sizes()[0] *
+                            GetTypeSize(next.tensor_type()) > max_bytes);
+  }
+  if (!complete) {
+    return false;
+  }
+
+  group = cached;
+  for (size_t i = 0; i < count; ++i) {
+    allreduce_wait_queue.pop_front();
+  }
+  return true;
+}
+
 int64_t Controller::TotalByteSizeOfAllgatherOutput(
     const std::vector<int64_t>& tensor_sizes, const TensorTableEntry& entry) {
   int64_t total_dimension_size = 0;
@@ -1054,28 +2253,38 @@ int Controller::GetLocalSizeAtCrossRank(int i) {
 }
 
 bool Controller::IncrementTensorCount(const Request& msg, int joined_size) {
-  auto& name = msg.tensor_name();
-  auto table_iter = message_table_.find(name);
+  Request copy = msg;
+  return IncrementReceivedTensorCount(std::move(copy), joined_size) != nullptr;
+}
+
+const std::string*
+Controller::IncrementReceivedTensorCount(Request&& msg, int joined_size) {
+  auto table_iter = message_table_.find(msg.tensor_name());
   if (table_iter == message_table_.end()) {
-    std::vector<Request> messages = {msg};
+    std::vector<Request> messages;
     messages.reserve(static_cast<unsigned long>(size_));
-    message_table_.emplace(name, std::move(messages));
-    table_iter = message_table_.find(name);
-    timeline_.NegotiateStart(name, msg.request_type());
-  } else {
-    std::vector<Request>& messages = table_iter->second;
-    messages.push_back(msg);
+    table_iter =
+        message_table_.emplace(msg.tensor_name(), std::move(messages)).first;
+    timeline_.NegotiateStart(table_iter->first, msg.request_type());
   }
+  auto& name = table_iter->first;
+  std::vector<Request>& messages = table_iter->second;
+  messages.push_back(std::move(msg));
+  auto& request = messages.back();
 
-  timeline_.NegotiateRankReady(name, msg.request_rank());
+  timeline_.NegotiateRankReady(name, request.request_rank());
 
-  std::vector<Request>& messages = table_iter->second;
   int count = (int)messages.size();
-  bool ready_to_reduce = count == (size_ - joined_size);
+  // Only the members of a process set request its tensors, joined ranks
+  // don't count for them.
+  bool ready_to_reduce =
+      request.process_set_id() != 0
+          ? count == process_sets_.Size(request.process_set_id())
+          : count == (size_ - joined_size);
   if (ready_to_reduce) {
     timeline_.NegotiateEnd(name);
   }
-  return ready_to_reduce;
+  return ready_to_reduce ? &name : nullptr;
 }
 
 void Controller::SetTimelineEnabled(bool value) {
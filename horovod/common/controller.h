@@ -17,16 +17,24 @@
 #ifndef HOROVOD_CONTROL_MANAGER_H
 #define HOROVOD_CONTROL_MANAGER_H
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <queue>
 #include <vector>
 
+#include "channel_allocator.h"
+#include "fusion_planner.h"
 #include "global_state.h"
+#include "metrics.h"
 #include "parameter_manager.h"
+#include "process_set.h"
 #include "response_cache.h"
 #include "stall_inspector.h"
 #include "tensor_queue.h"
 #include "timeline.h"
+#include "utils/env_parser.h"
+#include "wire_session.h"
 
 namespace horovod {
 namespace common {
@@ -36,7 +44,8 @@ using MessageTable = std::unordered_map<std::string, std::vector<Request>>;
 class Controller : public std::enable_shared_from_this<Controller> {
 public:
   Controller(ResponseCache& response_cache, TensorQueue& tensor_queue,
-             Timeline& timeline, ParameterManager& parameter_manager);
+             Timeline& timeline, ParameterManager& parameter_manager,
+             HorovodMetrics& metrics);
 
   Controller(const Controller&) = delete;
 
@@ -50,16 +59,69 @@ public:
   virtual void CrossRankBitwiseOr(std::vector<long long>& bitvector,
                                   int count) = 0;
 
+  // Adds up the values of all ranks, in place.
+  virtual void CrossRankSum(std::vector<double>& values) = 0;
+
   virtual void Bcast(void* buffer, size_t size, int root_rank, Communicator
   communicator) = 0;
 
+  // Sends the same number of splits to every rank, splits.size() / size in
+  // rank order, and receives as many from every rank.
   virtual void AlltoallGetRecvSplits(const std::vector<int32_t>& splits,
                                      std::vector<int32_t>& recvsplits) = 0;
 
   virtual void Barrier(Communicator communicator) = 0;
 
+  // Broadcasts from the first rank of the process set to its other ranks,
+  // called by the members of the set only.
+  virtual void ProcessSetBcast(void* buffer, size_t size,
+                               int32_t process_set_id) = 0;
+
   // Concrete controller functions
-  void SynchronizeParameters();
+
+  // Send the coordinator's autotuned parameters to all ranks along with the
+  // next response list, instead of in a collective of their own. Called by
+  // all ranks in the same cycle while tuning, and by the coordinator alone
+  // when it detected a drift.
+  void SynchronizeParameters() { parameter_sync_requested_ = true; }
+
+  bool ParameterSyncRequested() const { return parameter_sync_requested_; }
+
+  // Switch to the parameters sent along with a response list, once the
+  // responses that use the previous ones finished.
+  void ApplyParameters(const ResponseList& response_list);
+
+  // Broadcast the fusion groups computed by the coordinator's fusion planner
+  // and switch to them on all ranks.
+  void SynchronizeFusionPlan();
+
+  // Configure the channel allocator from the environment and broadcast the
+  // coordinator's SM count and calibration table.
+  void SynchronizeChannelAllocator();
+
+  // Estimate the offset of the system clock of this rank to the clock of the
+  // coordinator with a ping exchange, so that per-rank timelines can be
+  // merged.
+  void SynchronizeClocks();
+
+  // System clock of this rank minus the system clock of the coordinator, 0
+  // if the clocks were not synchronized.
+  int64_t ClockOffsetMicros() const { return clock_offset_micros_; }
+
+  // Ask the coordinator to send partially filled fusion groups once the
+  // allreduces enqueued so far have been negotiated, e.g. at the end of the
+  // backward pass.
+  void RequestFusionGroupFlush() { fusion_group_flush_requested_ = true; }
+
+  // SM count of the devices used for allreduce, used by the channel allocator.
+  void SetDeviceSMCount(int value) { channel_allocator_.SetSMCount(value); }
+
+  // Fed with the NCCL kernels measured on the coordinator.
+  ChannelFeedback& channel_feedback() { return channel_feedback_; }
+
+  // lyz - alloc
+  // Whether allreduce responses are fused into the FUSION_SIZE groups.
+  bool FusionGroupsEnabled() const;
 
   // This function performs all the preparation work for workers to agree
   // on what tensors to be all-reduced or all-gathered. The output is a
@@ -132,19 +194,26 @@ public:
   bool MarkCyclesInTimelinePending();
   void SynchronizeTimelineEnabled();
   StallInspector& GetStallInspector() { return stall_inspector_; };
+  const ProcessSetTable& GetProcessSets() const { return process_sets_; };
 
 
   //lyz - alloc
   void load_fusion_specification();
   void load_thread_specification();
+  void load_cpu_fusion_specification();
+  void load_split_specification();
 
 protected:
   // Functions must be overridden by concrete controller
   virtual void DoInitialization() = 0;
 
+  // Create the communicators of the process sets parsed from
+  // HOROVOD_PROCESS_SETS, called on all ranks after DoInitialization.
+  virtual void DoInitializeProcessSets() = 0;
+
   // For rank 0 to receive other ranks' ready tensors.
   virtual void RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
-                                std::vector<RequestList>& ready_list) = 0;
+                                std::vector<RequestListView>& ready_list) = 0;
 
   // For other ranks to send their ready tensors to rank 0
   virtual void SendReadyTensors(RequestList& message_list) = 0;
@@ -167,8 +236,68 @@ protected:
   // exist on any worker.
   void CoordinateCacheAndState(CacheCoordinator& cache_coordinator);
 
+  // Agrees on the sizes of the shape agnostic cache hits with a single
+  // CrossRankBitwiseAnd, and updates their cached responses. Hits whose size
+  // differs between ranks are erased and negotiated instead.
+  void SyncCachedTensorSizes(CacheCoordinator& cache_coordinator, bool joined);
+
   ResponseList FuseResponses(std::deque<Response>& responses);
 
+  // Performs the small CPU allreduces among the common cache hits with a
+  // single CrossRankSum of their values, right after the cache coordination,
+  // and removes them from the hits. Bypasses fusion and the operations.
+  void PerformInlineAllreduces(CacheCoordinator& cache_coordinator,
+                               bool joined);
+
+  // Pop the next fusion group from allreduce_wait_queue if enough tensors
+  // are waiting to complete it, or if any tensor is waiting when flushing.
+  bool PopFusionGroup(Response& group, bool flush = false);
+  bool ReplayFusionGroup(Response& group, int max_count, int64_t max_bytes);
+
+  // In builds with GPU support the fusion groups of the Libra specification
+  // only hold GPU tensors. CPU allreduces are fused by the threshold, or in
+  // the groups of CPU_FUSION_SIZE, which have a queue and group ids of their
+  // own, so that they never shift the groups of the GPU tensors.
+  bool IsCpuFusionResponse(const Response& response) const;
+  bool PopCpuFusionGroup(Response& group, bool flush = false);
+
+  // Number of tensors at the front of queue that form the next group under
+  // the limits, and whether that group is complete.
+  int CountFusionGroup(const std::deque<Response>& queue, int max_count,
+                       int64_t max_bytes, bool& complete);
+
+  // Give a popped group the allocation of the Libra plan, max_count and
+  // max_bytes are the sizes the group would have under the local parameters.
+  void PlanFusionGroup(Response& group, int max_count, int64_t max_bytes);
+
+  // Set the Libra allocation of the responses the coordinator sends, or
+  // resolve the launch configuration of the received ones from the plan.
+  // Only for cycles that go through communication.
+  void ApplyLibraPlan(ResponseList& response_list);
+
+  // Drop the fusion group specification, or throw if groups were required.
+  void FallBackToThresholdFusion(const std::string& reason);
+
+  // Whether the coordinator should send the partially filled fusion groups,
+  // either on request or because no tensor arrived for a while.
+  bool ShouldFlushFusionGroups(bool flush_requested);
+
+  // Whether no CPU tensor arrived for a while, the CPU groups are flushed on
+  // their own then.
+  bool ShouldFlushCpuFusionGroups() const;
+
+  // Send all waiting tensors and start over with the first group.
+  void FlushFusionGroups(ResponseList& response_list);
+
+  void FlushCpuFusionGroups(ResponseList& response_list);
+
+  // Queue a fused allreduce response. With HOROVOD_FUSION_PRIORITY set, the
+  // queued responses are sent lowest priority first by
+  // SendPrioritizedResponses, otherwise they are sent right away.
+  void AddPrioritizedResponse(ResponseList& response_list, Response&& response);
+
+  void SendPrioritizedResponses(ResponseList& response_list);
+
   // Return the total byte size of the final allgathered output tensor
   int64_t
   TotalByteSizeOfAllgatherOutput(const std::vector<int64_t>& tensor_sizes,
@@ -179,6 +308,11 @@ protected:
   // ready to reduce the tensor).
   bool IncrementTensorCount(const Request& msg, int joined_size = 0);
 
+  // Same, moving a request received from another rank into the table.
+  // Returns the name kept in the table if the tensor is ready, null otherwise.
+  const std::string* IncrementReceivedTensorCount(Request&& msg,
+                                                  int joined_size);
+
   int rank_ = 0;
   int local_rank_ = 0;
   int cross_rank_ = 0;
@@ -199,8 +333,18 @@ protected:
 
   uint32_t cache_capacity_ = 1024;
 
+  // Bytes of the tensors PerformInlineAllreduces reduces per cycle, 0
+  // disables it.
+  int64_t inline_allreduce_bytes_ = 0;
+
   StallInspector stall_inspector_;
 
+  // Rank subsets of HOROVOD_PROCESS_SETS.
+  ProcessSetTable process_sets_;
+
+  // Sends tensor names and shapes to and from the coordinator only once.
+  WireSession wire_session_;
+
   // Only exists on the coordinator node (rank zero). Maintains a vector of
   // requests to allreduce every tensor (keyed by tensor name).
   MessageTable message_table_;
@@ -220,12 +364,50 @@ protected:
 
   ParameterManager& parameter_manager_;
 
+  HorovodMetrics& metrics_;
+
   // lyz - alloc 
+  FusionMode fusion_mode_ = FusionMode::AUTO;
   std::deque<Response> allreduce_wait_queue; //used to form the designated fusion group
+  std::chrono::steady_clock::time_point allreduce_wait_start; //last time a tensor joined the queue or a group left it
+  std::chrono::steady_clock::time_point allreduce_fill_start; //time the first tensor of the next group joined the queue
+  std::atomic_bool fusion_group_flush_requested_{false};
+  bool parameter_sync_requested_ = false;
+  int fusion_group_flush_timeout_ms_ = 100;
+  bool fusion_priority_enabled_ = false;
+  struct PrioritizedResponse {
+    int32_t priority;
+    int64_t sequence; // keeps the arrival order among equal priorities
+    Response response;
+    bool operator<(const PrioritizedResponse& other) const {
+      // The heap yields the largest element first.
+      return priority != other.priority ? priority > other.priority
+                                        : sequence > other.sequence;
+    }
+  };
+  std::vector<PrioritizedResponse> prioritized_responses_; // binary heap
+  int64_t prioritized_sequence_ = 0;
   int allreduce_group_id; //indicates the group next to be fusioned;
-  std::vector<int> group_size; //user specified group size;
+  std::vector<int> group_size; //user specified group size, 0 if only limited by bytes;
+  std::vector<int64_t> group_bytes; //byte budget for each group, 0 if only limited by count;
   std::vector<int> block_size; // block num allocated for each fusion group
   std::vector<int> thread_size; // thread for each block
+  std::vector<int> split_block_size; // blocks of the second part of each group, 0 if not split
+  std::vector<int> split_thread_size; // threads of the second part, 0 for the threads of the group
+  FusionPlanner fusion_planner_; // builds group_size when FUSION_SIZE is unset
+  ChannelAllocator channel_allocator_; // sizes groups without a block/thread specification
+  ChannelFeedback channel_feedback_;
+  LibraPlan libra_plan_; // allocations all ranks launch the groups with
+  bool libra_planning_ = false; // whether the coordinator fuses in a cycle that goes through communication
+  bool libra_all_collectives_ = false; // also size allgathers, broadcasts and allreduces outside fusion groups
+  std::vector<Response> fusion_group_cache_; // last complete group of each group id, replayed if the same tensors wait again
+  int64_t fusion_group_cache_threshold_ = 0; // fusion threshold the cached groups were built with
+  std::deque<Response> cpu_wait_queue_; // CPU tensors waiting for their fusion group
+  std::chrono::steady_clock::time_point cpu_wait_start_; // last time a CPU tensor joined the queue or a group left it
+  int cpu_group_id_ = 0; // CPU group next to be fused
+  std::vector<int> cpu_group_size_; // CPU_FUSION_SIZE tensor counts, empty for threshold fusion
+  std::vector<int64_t> cpu_group_bytes_; // CPU_FUSION_SIZE byte budgets
+  int64_t clock_offset_micros_ = 0;
   
 };
 
@@ -15,14 +15,204 @@
 
 #include "fusion_buffer_manager.h"
 
+#include <map>
+#include <mutex>
+
 namespace horovod {
 namespace common {
 
-Status FusionBufferManager::InitializeBuffer(int64_t threshold, int device, std::shared_ptr<OpContext> context,
+// Carved buffers start at multiples of this many bytes.
+#define FUSION_BUFFER_SLAB_ALIGNMENT 256
+
+// First-fit allocator over the bytes of one persistent buffer. Carved buffers
+// are freed from the threads that release them, so the free list is locked.
+class FusionBufferSlab : public std::enable_shared_from_this<FusionBufferSlab> {
+public:
+  FusionBufferSlab(std::shared_ptr<PersistentBuffer> buffer, int64_t size)
+      : buffer_(std::move(buffer)), size_(size) {
+    free_[0] = size;
+  }
+
+  FusionBufferSlab(const FusionBufferSlab&) = delete;
+
+  int64_t size() const { return size_; }
+
+  // Returns a buffer of at least bytes bytes out of the slab, or null if no
+  // free range is large enough.
+  std::shared_ptr<PersistentBuffer> Carve(int64_t bytes);
+
+private:
+  class Carved : public PersistentBuffer {
+  public:
+    Carved(std::shared_ptr<FusionBufferSlab> slab, int64_t offset, int64_t size)
+        : slab_(std::move(slab)), offset_(offset), size_(size) {}
+
+    const void* AccessData(std::shared_ptr<OpContext> context) const override {
+      return (const uint8_t*)slab_->buffer_->AccessData(context) + offset_;
+    }
+
+    ~Carved() override { slab_->Free(offset_, size_); }
+
+  private:
+    std::shared_ptr<FusionBufferSlab> slab_;
+    int64_t offset_;
+    int64_t size_;
+  };
+
+  void Free(int64_t offset, int64_t size);
+
+  std::shared_ptr<PersistentBuffer> buffer_;
+  int64_t size_;
+
+  std::mutex mutex_;
+  // Offset and size of the free ranges, which are never adjacent.
+  std::map<int64_t, int64_t> free_;
+};
+
+std::shared_ptr<PersistentBuffer> FusionBufferSlab::Carve(int64_t bytes) {
+  bytes = (bytes + FUSION_BUFFER_SLAB_ALIGNMENT - 1) /
+          FUSION_BUFFER_SLAB_ALIGNMENT * FUSION_BUFFER_SLAB_ALIGNMENT;
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = free_.begin(); it != free_.end(); ++it) {
+    if (it->second >= bytes) {
+      int64_t offset = it->first;
+      int64_t remaining = it->second - bytes;
+      free_.erase(it);
+      if (remaining > 0) {
+        free_[offset + bytes] = remaining;
+      }
+      return std::make_shared<Carved>(shared_from_this(), offset, bytes);
+    }
+  }
+  return nullptr;
+}
+
+void FusionBufferSlab::Free(int64_t offset, int64_t size) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto next = free_.lower_bound(offset);
+  if (next != free_.end() && offset + size == next->first) {
+    size += next->second;
+    next = free_.erase(next);
+  }
+  if (next != free_.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+  free_[offset] = size;
+}
+
+// Takes the allocation out of the manager before freeing it.
+class FusionBufferManager::TrackedBuffer : public PersistentBuffer {
+public:
+  TrackedBuffer(FusionBufferManager* manager,
+                std::shared_ptr<PersistentBuffer> buffer, const void* data)
+      : manager_(manager), buffer_(std::move(buffer)), data_(data) {}
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return buffer_->AccessData(context);
+  }
+
+  ~TrackedBuffer() override { manager_->Release(data_); }
+
+private:
+  FusionBufferManager* manager_;
+  std::shared_ptr<PersistentBuffer> buffer_;
+  const void* data_;
+};
+
+Status FusionBufferManager::Allocate(int64_t size, int device,
+                                     std::shared_ptr<OpContext> context,
+                                     std::shared_ptr<PersistentBuffer>& buffer) {
+  std::shared_ptr<PersistentBuffer> allocated;
+  Status status;
+  if (device_allocator_ && device != CPU_DEVICE_ID) {
+    status = device_allocator_(device, size, allocated);
+  } else if (host_allocator_ && device == CPU_DEVICE_ID) {
+    status = host_allocator_(size, allocated);
+  } else {
+    status = context->AllocatePersistent(size, &allocated);
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  auto data = allocated->AccessData(context);
+  {
+    std::lock_guard<std::mutex> guard(allocations_mutex_);
+    allocations_[data] = size;
+  }
+  allocated_bytes_.fetch_add(size, std::memory_order_relaxed);
+  buffer = std::make_shared<TrackedBuffer>(this, std::move(allocated), data);
+  return Status::OK();
+}
+
+void FusionBufferManager::Release(const void* data) {
+  std::function<void(const void*)> callback;
+  {
+    std::lock_guard<std::mutex> guard(allocations_mutex_);
+    auto it = allocations_.find(data);
+    if (it != allocations_.end()) {
+      allocated_bytes_.fetch_sub(it->second, std::memory_order_relaxed);
+      allocations_.erase(it);
+    }
+    callback = release_callback_;
+  }
+  if (callback) {
+    callback(data);
+  }
+}
+
+bool FusionBufferManager::FindAllocation(const void* data, const void*& base,
+                                         int64_t& size) const {
+  std::lock_guard<std::mutex> guard(allocations_mutex_);
+  auto it = allocations_.upper_bound(data);
+  if (it == allocations_.begin()) {
+    return false;
+  }
+  --it;
+  if ((const uint8_t*)data >= (const uint8_t*)it->first + it->second) {
+    return false;
+  }
+  base = it->first;
+  size = it->second;
+  return true;
+}
+
+void FusionBufferManager::SetReleaseCallback(
+    std::function<void(const void*)> callback) {
+  std::lock_guard<std::mutex> guard(allocations_mutex_);
+  release_callback_ = std::move(callback);
+}
+
+Status FusionBufferManager::InitializeBuffer(int64_t threshold, int64_t group_bytes,
+                                             int device, std::shared_ptr<OpContext> context,
                                              int stream_id,
                                              std::function<void()> on_start_init,
                                              std::function<void()> on_end_init) {
-  auto& elem = tensor_fusion_buffers_[std::make_tuple(device, context->framework(), stream_id)];
+  auto key = std::make_tuple(device, context->framework(), stream_id);
+  auto& carved = carved_buffers_[key];
+  carved.reset();
+  if (slab_bytes_ > 0 && group_bytes > 0 && group_bytes <= slab_bytes_) {
+    auto& slab = slabs_[std::make_tuple(device, context->framework())];
+    if (slab == nullptr || slab->size() != slab_bytes_) {
+      on_start_init();
+      std::shared_ptr<PersistentBuffer> buffer;
+      Status status = Allocate(slab_bytes_, device, context, buffer);
+      on_end_init();
+      if (!status.ok()) {
+        return status;
+      }
+      slab = std::make_shared<FusionBufferSlab>(std::move(buffer), slab_bytes_);
+    }
+    carved = slab->Carve(group_bytes);
+    if (carved != nullptr) {
+      return Status::OK();
+    }
+  }
+
+  auto& elem = tensor_fusion_buffers_[key];
   auto& buffer = elem.first;
   int64_t& size = elem.second;
   if (size != threshold) {
@@ -36,7 +226,7 @@ Status FusionBufferManager::InitializeBuffer(int64_t threshold, int device, std:
 
     // Lazily allocate persistent buffer for Tensor Fusion and keep it
     // forever per device.
-    Status status = context->AllocatePersistent(threshold, &buffer);
+    Status status = Allocate(threshold, device, context, buffer);
     on_end_init();
 
     return status;
@@ -45,8 +235,19 @@ Status FusionBufferManager::InitializeBuffer(int64_t threshold, int device, std:
   return Status::OK();
 }
 
+void FusionBufferManager::ReleaseBuffers() {
+  carved_buffers_.clear();
+  slabs_.clear();
+  tensor_fusion_buffers_.clear();
+}
+
 std::shared_ptr<PersistentBuffer> FusionBufferManager::GetBuffer(int device, Framework framework, int stream_id) {
-  return tensor_fusion_buffers_[std::make_tuple(device, framework, stream_id)].first;
+  auto key = std::make_tuple(device, framework, stream_id);
+  auto carved = carved_buffers_.find(key);
+  if (carved != carved_buffers_.end() && carved->second != nullptr) {
+    return carved->second;
+  }
+  return tensor_fusion_buffers_[key].first;
 }
 
 } // namespace common
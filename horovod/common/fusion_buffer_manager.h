@@ -16,7 +16,12 @@
 #ifndef HOROVOD_FUSION_BUFFER_MANAGER_H
 #define HOROVOD_FUSION_BUFFER_MANAGER_H
 
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "common.h"
@@ -25,19 +30,34 @@
 namespace horovod {
 namespace common {
 
+class FusionBufferSlab;
+
 // Encapsulates the process of creating and destroying fusion buffers as the requested
 // threshold is changed.
+//
+// With a slab size set, the buffers of fused allreduces are instead carved out
+// of one slab per device and framework, at the exact size of the group. The
+// carved buffer returns to the slab once the manager and every operation that
+// holds it, such as a GPU finalizer waiting for the group, have released it.
+// Responses that do not fit into the free space of the slab fall back to the
+// buffer of their stream.
 class FusionBufferManager {
 public:
+  // Size of the slab in bytes, 0 disables carving.
+  void SetSlabBytes(int64_t value) { slab_bytes_ = value; }
+  int64_t SlabBytes() const { return slab_bytes_; }
+
   // Initializes a buffer of the given threshold size if not already cached.
   //
   // Args:
   //  threshold: Size of the buffer in bytes.
+  //  group_bytes: Bytes needed by the response, or 0 if unknown. Only known
+  //               sizes are carved out of the slab.
   //  device: Device ID to associate the buffer.
   //  context: Framework used to create the buffer and associate it.
   //  on_start_init: Callback on starting buffer initialization.
   //  on_end_init: Callback on completing buffer initialization.
-  Status InitializeBuffer(int64_t threshold,
+  Status InitializeBuffer(int64_t threshold, int64_t group_bytes,
                           int device, std::shared_ptr<OpContext> context,
                           int stream_id,
                           std::function<void()> on_start_init,
@@ -46,13 +66,77 @@ public:
   // Returns the buffer associated with the given device and framework, or null.
   std::shared_ptr<PersistentBuffer> GetBuffer(int device, Framework framework, int stream_id);
 
+  // Finds the allocation of a buffer or slab that holds data, so that it can
+  // be registered with a communicator as a whole.
+  bool FindAllocation(const void* data, const void*& base, int64_t& size) const;
+
+  // Called with the start of an allocation right before it is freed.
+  void SetReleaseCallback(std::function<void(const void*)> callback);
+
+  // Drops the buffers and slabs of all devices, which are allocated again
+  // when needed. Their memory is freed once the operations still using them
+  // release them too. Must be called by the thread that initializes buffers,
+  // with no response being performed.
+  void ReleaseBuffers();
+
+  // Bytes of the buffers and slabs allocated, including the ones dropped but
+  // still in use.
+  int64_t AllocatedBytes() const {
+    return allocated_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // Allocates the buffers of GPU devices instead of the framework, e.g. from
+  // a stream-ordered memory pool. Null restores framework allocations.
+  typedef std::function<Status(int device, int64_t size,
+                               std::shared_ptr<PersistentBuffer>& buffer)>
+      DeviceAllocator;
+  void SetDeviceAllocator(DeviceAllocator allocator) {
+    device_allocator_ = std::move(allocator);
+  }
+
+  // Allocates the buffers of the CPU instead of the framework, e.g. on huge
+  // pages. Null restores framework allocations.
+  typedef std::function<Status(int64_t size,
+                               std::shared_ptr<PersistentBuffer>& buffer)>
+      HostAllocator;
+  void SetHostAllocator(HostAllocator allocator) {
+    host_allocator_ = std::move(allocator);
+  }
+
 private:
+  class TrackedBuffer;
+
+  Status Allocate(int64_t size, int device, std::shared_ptr<OpContext> context,
+                  std::shared_ptr<PersistentBuffer>& buffer);
+
+  void Release(const void* data);
+
+  // Declared first so that they outlive the buffers below.
+  mutable std::mutex allocations_mutex_;
+  std::map<const void*, int64_t> allocations_;
+  std::atomic<int64_t> allocated_bytes_{0};
+  std::function<void(const void*)> release_callback_;
+
   // Memory buffers for Tensor Fusion.  They are keyed off device ID and
   // framework, and all are allocated tensor_fusion_threshold bytes if
   // initialized.
   std::unordered_map<
       std::tuple<int, Framework, int>,
       std::pair<std::shared_ptr<PersistentBuffer>, int64_t>> tensor_fusion_buffers_;
+
+  int64_t slab_bytes_ = 0;
+
+  DeviceAllocator device_allocator_;
+  HostAllocator host_allocator_;
+
+  // Slabs keyed off device ID and framework.
+  std::unordered_map<std::tuple<int, Framework>,
+                     std::shared_ptr<FusionBufferSlab>> slabs_;
+
+  // Buffer carved for the last response of each stream, returned by
+  // GetBuffer instead of the buffer of the stream.
+  std::unordered_map<std::tuple<int, Framework, int>,
+                     std::shared_ptr<PersistentBuffer>> carved_buffers_;
 };
 
 } // namespace common
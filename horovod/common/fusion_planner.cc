@@ -0,0 +1,115 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "fusion_planner.h"
+
+#include <algorithm>
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+void FusionPlanner::RecordTensor(const std::string& tensor_name,
+                                 int64_t tensor_bytes) {
+  if (!IsPlanning()) {
+    return;
+  }
+
+  // Seeing the same tensor twice means a new step has started.
+  if (current_seen_.find(tensor_name) != current_seen_.end()) {
+    CompleteStep();
+  }
+  current_seen_.insert(tensor_name);
+  current_bytes_.push_back(tensor_bytes);
+}
+
+bool FusionPlanner::ReadyToFreeze() const {
+  return IsPlanning() && completed_steps_ >= warmup_steps_ &&
+         !last_step_bytes_.empty();
+}
+
+std::vector<int> FusionPlanner::ComputePlan() const {
+  std::vector<int> plan;
+  int num_tensors = (int)last_step_bytes_.size();
+  int num_groups = std::min(num_groups_, num_tensors);
+  if (num_groups <= 0) {
+    return plan;
+  }
+
+  int64_t total_bytes = 0;
+  for (auto bytes : last_step_bytes_) {
+    total_bytes += bytes;
+  }
+
+  // Walk the tensors in arrival order and close a group once it reaches its
+  // share of the total bytes. A tensor is added to the current group if at
+  // least half of it fits under the group boundary.
+  int64_t accumulated_bytes = 0;
+  int start = 0;
+  for (int group = 0; group < num_groups - 1; ++group) {
+    int64_t boundary = total_bytes * (group + 1) / num_groups;
+    // Leave at least one tensor for each of the remaining groups.
+    int max_end = num_tensors - (num_groups - group - 1);
+    accumulated_bytes += last_step_bytes_[start];
+    int end = start + 1;
+    while (end < max_end &&
+           accumulated_bytes + last_step_bytes_[end] / 2 < boundary) {
+      accumulated_bytes += last_step_bytes_[end];
+      ++end;
+    }
+    plan.push_back(end - start);
+    start = end;
+  }
+  plan.push_back(num_tensors - start);
+  return plan;
+}
+
+void FusionPlanner::Freeze() {
+  frozen_ = true;
+  current_bytes_.clear();
+  current_seen_.clear();
+  last_step_bytes_.clear();
+}
+
+void FusionPlanner::SetWarmupSteps(int value) {
+  if (value < 1) {
+    LOG(WARNING) << "Fusion planner needs at least one warmup step, got "
+                 << value << ". Using 1.";
+    value = 1;
+  }
+  warmup_steps_ = value;
+}
+
+void FusionPlanner::SetNumGroups(int value) {
+  if (value < 1) {
+    LOG(WARNING) << "Fusion planner needs at least one group, got " << value
+                 << ". Using 1.";
+    value = 1;
+  }
+  num_groups_ = value;
+}
+
+void FusionPlanner::CompleteStep() {
+  last_step_bytes_ = std::move(current_bytes_);
+  current_bytes_.clear();
+  current_seen_.clear();
+  ++completed_steps_;
+  LOG(DEBUG) << "Fusion planner observed step " << completed_steps_ << " with "
+             << last_step_bytes_.size() << " allreduced tensors.";
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,90 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_FUSION_PLANNER_H
+#define HOROVOD_FUSION_PLANNER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// Builds the Libra fusion groups from the allreduce traffic observed during
+// the first training steps, instead of relying on a hand-tuned FUSION_SIZE
+// list.
+//
+// Every rank feeds the planner with the same (already negotiated) response
+// list, so the planner sees the same tensors in the same order everywhere.
+// A step boundary is detected when a tensor that was already reduced in the
+// current step shows up again. Once enough steps have been observed, the
+// tensors of the last complete step are split, in arrival order, into
+// contiguous groups of roughly equal byte size. The coordinator then
+// broadcasts the plan so that all ranks freeze exactly the same groups.
+class FusionPlanner {
+public:
+  FusionPlanner() = default;
+  FusionPlanner(const FusionPlanner&) = delete;
+
+  // Record an allreduced tensor in the order it was scheduled.
+  void RecordTensor(const std::string& tensor_name, int64_t tensor_bytes);
+
+  // Returns true once enough complete steps have been observed.
+  bool ReadyToFreeze() const;
+
+  // Split the tensors of the last complete step into groups. Returns the
+  // number of tensors in each group.
+  std::vector<int> ComputePlan() const;
+
+  // Stop observing, the plan has been agreed upon.
+  void Freeze();
+
+  bool IsEnabled() const { return enabled_; }
+  bool IsPlanning() const { return enabled_ && !frozen_; }
+  int NumGroups() const { return num_groups_; }
+  int CompletedSteps() const { return completed_steps_; }
+
+  void SetEnabled(bool value) { enabled_ = value; }
+  void SetWarmupSteps(int value);
+  void SetNumGroups(int value);
+
+private:
+  void CompleteStep();
+
+  bool enabled_ = false;
+  bool frozen_ = false;
+
+  // Number of complete steps to observe before freezing the plan.
+  int warmup_steps_ = 5;
+
+  // Number of fusion groups to build.
+  int num_groups_ = 1;
+
+  int completed_steps_ = 0;
+
+  // Tensor byte sizes of the step currently being observed.
+  std::vector<int64_t> current_bytes_;
+  std::unordered_set<std::string> current_seen_;
+
+  // Tensor byte sizes of the last complete step, in arrival order.
+  std::vector<int64_t> last_step_bytes_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_FUSION_PLANNER_H
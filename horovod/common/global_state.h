@@ -21,10 +21,15 @@
 #include <thread>
 
 #include "fusion_buffer_manager.h"
+#include "host_memory.h"
+#include "metrics.h"
+#include "overlap_stats.h"
 #include "parameter_manager.h"
 #include "response_cache.h"
+#include "response_executor.h"
 #include "tensor_queue.h"
 #include "timeline.h"
+#include "timeline_sampler.h"
 #include "utils/env_parser.h"
 
 // #if HAVE_CUDA
@@ -57,10 +62,15 @@ struct HorovodGlobalState {
 
   // lyz computation timeline
   std::thread comp_timeline_thread;
+  // Entries enqueued since the computation timeline thread last took them,
+  // guarded by comp_timeline_lock.
   std::vector<TensorTableEntry> comp_entries;
   std::atomic_bool comp_timeline_shutdown{false};
   std::mutex comp_timeline_lock;
   std::atomic_bool is_coordinator{false};
+  // True if the computation timeline thread runs on this rank, which is the
+  // coordinator unless timeline_all_ranks is set.
+  std::atomic_bool comp_timeline_running{false};
 
   // fzh allreduce timeline
   std::thread thread_fzh;
@@ -69,15 +79,31 @@ struct HorovodGlobalState {
   // std::vector<TensorTableEntry>& fzh_entries;
   // std::atomic_bool thread_fzh_shutdown{false};
 
+  // Performs the responses negotiated by the background thread when
+  // HOROVOD_ASYNC_EXECUTION is set.
+  ResponseExecutor response_executor;
+
   // Whether the background thread should shutdown.
   std::atomic_bool shut_down{false};
 
   // Timeline writer.
   Timeline timeline;
 
+  // Picks the cycles written to the timeline in sampling mode.
+  TimelineSampler timeline_sampler;
+
+  // Readiness and communication times of the tensors of the last steps.
+  OverlapStats overlap_stats;
+
+  // Counters and histograms of the hot path, see horovod_metrics().
+  HorovodMetrics metrics;
+
   // Flag indicating whether timeline enabled.
   bool timeline_enabled = false;
 
+  // Flag indicating whether every rank writes its own timeline.
+  bool timeline_all_ranks = false;
+
   // Flag indicating whether to mark cycles in the timeline.
   std::atomic_bool mark_cycles_in_timeline{false};
 
@@ -87,9 +113,33 @@ struct HorovodGlobalState {
   // size.
   FusionBufferManager fusion_buffer;
 
+  // Pages of the CPU fusion buffers and MPI shared windows, and whether they
+  // are faulted in when allocated.
+  HostPageSize host_page_size = HostPageSize::DEFAULT;
+  bool host_prefault = false;
+
+  // Set to drop the fusion buffers at the end of the next cycle.
+  std::atomic_bool release_fusion_buffers{false};
+
+  // Pack and unpack the small tensors of GPU fusion buffers with a batched
+  // copy kernel.
+  bool batch_d2d_memcopies = true;
+
   // Time point when last cycle started.
   std::chrono::steady_clock::time_point last_cycle_start;
 
+  // Start a cycle as soon as a tensor is submitted, and sleep longer between
+  // cycles while no tensor is waiting, up to adaptive_cycle_time_max_ms.
+  bool adaptive_cycle_time = false;
+  double adaptive_cycle_time_max_ms = 100;
+
+  // Current sleep between cycles in adaptive mode.
+  double adaptive_cycle_time_ms = 0;
+
+  // Run cycles back to back and poll for ready tensors without sleeping, on
+  // a core of the background thread's own.
+  bool busy_poll = false;
+
   // Whether collective context has been completed on the background thread.
   std::atomic_bool initialization_done{false};
 
@@ -109,6 +159,15 @@ struct HorovodGlobalState {
   // Number of responses that can be cached
   uint32_t cache_capacity = 1024;
 
+  // File the response cache of this rank is saved to and loaded from, empty
+  // if it's not kept across runs.
+  std::string response_cache_file;
+
+  // Generations of the response cache at the previous cycle and when it was
+  // last saved.
+  uint64_t response_cache_generation = 0;
+  uint64_t saved_response_cache_generation = 0;
+
   // Number of GPU streams to use
   int num_nccl_streams = 1;
 
@@ -117,17 +176,73 @@ struct HorovodGlobalState {
 
   std::vector<int> stream_assignment;
 
-  int parallel_threadnum = 0;
-
-  bool is_para = false;
-
-  int fake_num = 0;
-
   int fusion_group_num = 0;
 
+  // Allreduce tensors larger than this many bytes are reduced in parts of at
+  // most this size, 0 disables partitioning.
+  int64_t partition_bytes = 0;
+
   // Index of current GPU stream to use
   int current_nccl_stream = 0;
 
+  // Next GPU stream of each process set by ID. The responses of a set take
+  // turns on these instead of current_nccl_stream, which only the responses
+  // of all ranks advance, so that all ranks agree on it.
+  std::vector<int> process_set_nccl_streams;
+
+  // Pack fused GPU allreduces on a separate stream into two alternating
+  // fusion buffers per stream slot, so that packing a group overlaps the
+  // collective of the previous one.
+  bool fusion_double_buffering = false;
+
+  // Cast float32 tensors to half precision while packing the fusion buffer of
+  // GPU allreduces, and back while unpacking it.
+  FusionCompression fusion_compression = FusionCompression::NONE;
+
+  // Last fusion buffer of each stream slot with double buffering.
+  std::vector<int> fusion_buffer_phases;
+
+  // Fusion buffer of the response being performed: the stream slot, or with
+  // double buffering twice the slot plus its phase.
+  int fusion_buffer_index = 0;
+
+  // Stage GPU data reduced through host memory in pooled pinned buffers, in
+  // chunks of host_staging_chunk_bytes so that the copies overlap the
+  // reduction. 0 copies the whole buffer at once.
+  bool pinned_host_staging = true;
+  int64_t host_staging_chunk_bytes = 4 * 1024 * 1024;
+
+  // Reduce fused CPU allreduces over MPI in chunks of this many bytes, so
+  // that packing and unpacking the fusion buffer overlap the reduction. 0
+  // reduces the whole buffer at once.
+  int64_t mpi_allreduce_chunk_bytes = 0;
+
+  // Run hierarchical allreduces of GPU tensors with NCCL across nodes too,
+  // on a communicator of the ranks with the same local rank.
+  bool torus_allreduce = false;
+
+  // Run alltoalls of GPU tensors within the node first, then with one
+  // message per node across nodes. Only set if the ranks are placed node by
+  // node.
+  bool hierarchical_alltoall = false;
+
+  // Run hierarchical allgathers of GPU tensors with NCCL, across nodes first
+  // and then within the node. Only set if the ranks are placed node by node.
+  bool nccl_hierarchical_allgather = false;
+
+  // Exchange the splits of alltoalls of GPU tensors with NCCL on the device,
+  // so that frameworks can pass splits computed on the GPU without waiting
+  // for them.
+  bool alltoall_device_splits = false;
+
+  // Launch the NCCL allreduces performed together in a cycle under one NCCL
+  // group.
+  bool nccl_group_launch = false;
+
+  // Capture the launch sequence of NCCL allreduces that repeat with the same
+  // tensors into CUDA graphs, and replay the graphs.
+  bool gpu_graphs = false;
+
   // A LibType indicating what framework we are using to perform CPU operations.
   LibType cpu_operation;
 
@@ -145,6 +260,10 @@ struct HorovodGlobalState {
   // benefit from a smaller chunk size.
   int64_t adasum_mpi_chunk_size = 1<<30;
 
+  // Whether the cross-node Adasum of GPU tensors runs on the GPU with NCCL
+  // instead of on host copies with MPI.
+  bool adasum_gpu_device_reduction = true;
+
   ~HorovodGlobalState() {
     // Make sure that the destructor of the background thread is safe to
     // call. If a thread is still joinable (not detached or complete) its
@@ -154,12 +273,11 @@ struct HorovodGlobalState {
       background_thread.join();
     }
     //lyz comp
+    if (comp_timeline_thread.joinable()) {
+      comp_timeline_shutdown = true;
+      comp_timeline_thread.join();
+    }
     if (is_coordinator) {
-      
-      if (comp_timeline_thread.joinable()) {
-        comp_timeline_shutdown =true;
-        comp_timeline_thread.join();
-      }
       if(thread_fzh.joinable()){
         // thread_fzh_shutdown = true;
         thread_fzh.join();
@@ -15,8 +15,12 @@
 
 #include "gloo_context.h"
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 
@@ -50,7 +54,9 @@ namespace common {
 #define HOROVOD_GLOO_TIMEOUT_SECONDS "HOROVOD_GLOO_TIMEOUT_SECONDS"
 #define HOROVOD_GLOO_RENDEZVOUS_ADDR "HOROVOD_GLOO_RENDEZVOUS_ADDR"
 #define HOROVOD_GLOO_RENDEZVOUS_PORT "HOROVOD_GLOO_RENDEZVOUS_PORT"
+#define HOROVOD_GLOO_PAIRS_PER_PEER "HOROVOD_GLOO_PAIRS_PER_PEER"
 #define HOROVOD_GLOO_GLOBAL_PREFIX "global"
+#define HOROVOD_GLOO_GLOBAL_LANE_PREFIX "global_lane_"
 #define HOROVOD_GLOO_LOCAL_PREFIX "local_"
 #define HOROVOD_GLOO_CROSS_PREFIX "cross_"
 #define HOROVOD_GLOO_GET_RANK_AND_SIZE "rank_and_size"
@@ -61,7 +67,6 @@ namespace common {
 #define HOROVOD_LOCAL_SIZE "HOROVOD_LOCAL_SIZE"
 #define HOROVOD_CROSS_RANK "HOROVOD_CROSS_RANK"
 #define HOROVOD_CROSS_SIZE "HOROVOD_CROSS_SIZE"
-#define HOROVOD_ELASTIC "HOROVOD_ELASTIC"
 
 int ParseNextInt(std::stringstream& ss) {
   assert(ss.good());
@@ -77,6 +82,33 @@ std::chrono::milliseconds GetTimeoutFromEnv() {
   return std::chrono::duration_cast<std::chrono::milliseconds>(s);
 }
 
+// Creates one device per lane. gloo_iface is a comma separated list of
+// interfaces the lanes are spread over, there are as many lanes as interfaces
+// unless HOROVOD_GLOO_PAIRS_PER_PEER is set.
+std::vector<std::shared_ptr<gloo::transport::Device>>
+CreateLaneDevices(const std::string& gloo_iface) {
+  std::vector<std::string> ifaces;
+  std::stringstream ss(gloo_iface);
+  std::string iface;
+  while (getline(ss, iface, ',')) {
+    ifaces.push_back(iface);
+  }
+  if (ifaces.empty()) {
+    ifaces.push_back(gloo_iface);
+  }
+
+  int num_lanes =
+      std::max(GetIntEnvOrDefault(HOROVOD_GLOO_PAIRS_PER_PEER, (int)ifaces.size()), 1);
+  std::vector<std::shared_ptr<gloo::transport::Device>> devs;
+  for (int i = 0; i < num_lanes; ++i) {
+    attr device_attr;
+    device_attr.iface = ifaces[i % ifaces.size()];
+    device_attr.ai_family = AF_UNSPEC;
+    devs.push_back(CreateDevice(device_attr));
+  }
+  return devs;
+}
+
 std::shared_ptr<gloo::Context> Rendezvous(const std::string& prefix,
                                           const char* server_addr_env, int server_port,
                                           int rank, int size,
@@ -85,7 +117,17 @@ std::shared_ptr<gloo::Context> Rendezvous(const std::string& prefix,
   std::unique_ptr<GlooStore> store;
   if (server_addr_env != nullptr) {
     std::string server_addr = server_addr_env;
-    store.reset(new HTTPStore(server_addr, server_port, prefix, rank));
+    auto http_store = new HTTPStore(server_addr, server_port, prefix, rank);
+    // Every rank waits for the address of every other rank, fetch all of
+    // them with the first request that finds them.
+    std::vector<std::string> peer_keys;
+    for (int i = 0; i < size; ++i) {
+      if (i != rank) {
+        peer_keys.push_back(std::to_string(i));
+      }
+    }
+    http_store->SetPrefetchKeys(peer_keys);
+    store.reset(http_store);
   } else {
     store.reset(new MemoryStore());
   }
@@ -106,12 +148,8 @@ void GlooContext::InitializeFromMPI(MPIContext& mpi_ctx,
     return;
   }
 
-  // TODO(sihan): Add support for multiple interfaces:
-  //  https://github.com/facebookincubator/gloo/issues/190
-  attr device_attr;
-  device_attr.iface = gloo_iface;
-  device_attr.ai_family = AF_UNSPEC;
-  auto dev = CreateDevice(device_attr);
+  auto devs = CreateLaneDevices(gloo_iface);
+  auto& dev = devs[0];
   auto timeout = GetTimeoutFromEnv();
 
   auto context =
@@ -131,6 +169,17 @@ void GlooContext::InitializeFromMPI(MPIContext& mpi_ctx,
   local_context->setTimeout(timeout);
   local_context->connectFullMesh(dev);
   local_ctx = local_context;
+
+  for (size_t i = 1; i < devs.size(); ++i) {
+    auto lane_context = std::make_shared<gloo::mpi::Context>(
+        mpi_ctx.GetMPICommunicator(GLOBAL));
+    lane_context->setTimeout(timeout);
+    lane_context->connectFullMesh(devs[i]);
+    lane_ctxs.push_back(lane_context);
+  }
+  if (!lane_ctxs.empty()) {
+    lane_pool_.create((int)lane_ctxs.size());
+  }
 }
 #endif
 
@@ -139,14 +188,9 @@ void GlooContext::Initialize(const std::string& gloo_iface) {
     return;
   }
 
-  // Create a device for communication
-  // TODO(sihan): Add support for multiple interfaces:
-  //  https://github.com/facebookincubator/gloo/issues/190
-  attr device_attr;
-  device_attr.iface = gloo_iface;
-
-  device_attr.ai_family = AF_UNSPEC;
-  auto dev = CreateDevice(device_attr);
+  // Create a device for communication, and one for every other lane.
+  auto devs = CreateLaneDevices(gloo_iface);
+  auto& dev = devs[0];
   auto timeout = GetTimeoutFromEnv();
 
   auto host_env = std::getenv(HOROVOD_HOSTNAME);
@@ -229,6 +273,16 @@ void GlooContext::Initialize(const std::string& gloo_iface) {
                          rendezvous_addr_env, rendezvous_port,
                          cross_rank, cross_size, dev, timeout);
   LOG(DEBUG) << "Cross-node Gloo context initialized.";
+
+  for (size_t i = 1; i < devs.size(); ++i) {
+    lane_ctxs.push_back(Rendezvous(HOROVOD_GLOO_GLOBAL_LANE_PREFIX + std::to_string(i),
+                                   rendezvous_addr_env, rendezvous_port,
+                                   rank, size, devs[i], timeout));
+  }
+  if (!lane_ctxs.empty()) {
+    lane_pool_.create((int)lane_ctxs.size());
+    LOG(DEBUG) << lane_ctxs.size() << " additional Gloo lanes initialized.";
+  }
 }
 
 void GlooContext::Finalize() {
@@ -236,12 +290,63 @@ void GlooContext::Finalize() {
     return;
   }
 
+  lane_pool_.reset();
   ctx.reset();
   cross_ctx.reset();
   local_ctx.reset();
+  lane_ctxs.clear();
   reset_ = true;
 }
 
+void GlooContext::RunOnLanes(int num_lanes,
+                             const std::function<void(int)>& f) {
+  if (num_lanes <= 1) {
+    f(0);
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  int pending = num_lanes - 1;
+  std::exception_ptr error;
+
+  std::vector<std::function<void(void)>> batch;
+  for (int lane = 1; lane < num_lanes; ++lane) {
+    batch.emplace_back([&, lane] {
+      std::exception_ptr lane_error;
+      try {
+        f(lane);
+      } catch (...) {
+        lane_error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> guard(mutex);
+      if (lane_error && !error) {
+        error = lane_error;
+      }
+      if (--pending == 0) {
+        cond.notify_one();
+      }
+    });
+  }
+  lane_pool_.execute(std::move(batch));
+
+  std::exception_ptr first_error;
+  try {
+    f(0);
+  } catch (...) {
+    first_error = std::current_exception();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&pending] { return pending == 0; });
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
 std::shared_ptr<gloo::Context>
 GlooContext::GetGlooContext(Communicator communicator) {
   switch (communicator) {
@@ -16,10 +16,14 @@
 #ifndef HOROVOD_GLOO_CONTEXT_H
 #define HOROVOD_GLOO_CONTEXT_H
 
+#include <functional>
+#include <vector>
+
 #include "gloo/context.h"
 
 #include "../common.h"
 #include "../logging.h"
+#include "../thread_pool.h"
 
 #if HAVE_MPI
 #include "../mpi/mpi_context.h"
@@ -47,14 +51,29 @@ struct GlooContext {
 
   bool IsEnabled() { return enabled_; }
 
+  // Global contexts with their own device, pairs and IO thread, the first one
+  // being ctx. Large buffers are striped over them.
+  int NumLanes() const { return 1 + (int)lane_ctxs.size(); }
+  std::shared_ptr<gloo::Context> LaneContext(int lane) {
+    return lane == 0 ? ctx : lane_ctxs[lane - 1];
+  }
+
+  // Runs f(lane) for lanes [0, num_lanes) concurrently, lane 0 on the calling
+  // thread, and rethrows the first exception once all of them are done.
+  void RunOnLanes(int num_lanes, const std::function<void(int)>& f);
+
   std::shared_ptr<gloo::Context> ctx = nullptr; // Global context
   std::shared_ptr<gloo::Context> cross_ctx = nullptr;
   std::shared_ptr<gloo::Context> local_ctx = nullptr;
+  std::vector<std::shared_ptr<gloo::Context>> lane_ctxs;
 
 private:
   // Flag indicating whether gloo is enabled.
   bool enabled_ = false;
   bool reset_ = false;
+
+  // Runs the lanes other than the first one.
+  ThreadPool lane_pool_;
 };
 
 } // namespace common
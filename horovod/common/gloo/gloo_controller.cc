@@ -119,14 +119,22 @@ void GlooController::CrossRankBitwiseOr(std::vector<long long>& bitvector,
   gloo::allreduce(opts);
 }
 
+void GlooController::CrossRankSum(std::vector<double>& values) {
+  gloo::AllreduceOptions opts(gloo_context_.ctx);
+  opts.setOutput(values.data(), values.size());
+  void (*func)(void*, const void*, const void*, size_t) = &::gloo::sum<double>;
+  opts.setReduceFunction(gloo::AllreduceOptions::Func(func));
+  gloo::allreduce(opts);
+}
+
 void GlooController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
-                                      std::vector<RequestList>& ready_list) {
+                                      std::vector<RequestListView>& ready_list) {
   // Rank zero has put all its own tensors in the tensor count table.
   // Now, it should count all the tensors that are coming from other
   // ranks at this tick.
 
   // 1. Get message lengths from every rank.
-  std::unique_ptr<int[]> recvcounts(new int[size_]);
+  recvcounts_.resize(size_);
 
   // do allgather
   {
@@ -134,53 +142,42 @@ void GlooController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
     int send_data = 0;
     gloo::AllgatherOptions opts(gloo_context_.ctx);
     opts.setInput(&send_data, 1);
-    opts.setOutput(recvcounts.get(), size_);
+    opts.setOutput(recvcounts_.data(), size_);
     gloo::allgather(opts);
   }
 
   // 2. Compute displacements.
-  std::unique_ptr<int[]> displcmnts(new int[size_]);
-  size_t total_size = 0;
-  for (int i = 0; i < size_; ++i) {
-    if (i == 0) {
-      displcmnts[i] = 0;
-    } else {
-      displcmnts[i] = recvcounts[i - 1] + displcmnts[i - 1];
-    }
-    total_size += recvcounts[i];
-  }
+  size_t total_size = ComputeDisplacements();
 
   // 3. Collect messages from every rank.
-  std::unique_ptr<uint8_t[]> buffer(new uint8_t[total_size]);
+  if (recv_buffer_.size() < total_size) {
+    recv_buffer_.resize(total_size);
+  }
 
   // do allgatherv
   {
-    auto input = new uint8_t[0];
+    uint8_t input;
     gloo::AllgathervOptions opts(gloo_context_.ctx);
-    opts.setInput(input, 0);
-    std::vector<size_t> count_vec(recvcounts.get(), recvcounts.get() + size_);
-    opts.setOutput(buffer.get(), count_vec);
+    opts.setInput(&input, 0);
+    opts.setOutput(recv_buffer_.data(), count_vec_);
     gloo::allgatherv(opts);
   }
 
   // 4. Process messages.
   // create a dummy list for rank 0
+  ready_list.reserve(size_);
   ready_list.emplace_back();
   for (int i = 1; i < size_; ++i) {
-    auto rank_buffer_ptr = buffer.get() + displcmnts[i];
-    RequestList received_message_list;
-    RequestList::ParseFromBytes(received_message_list, rank_buffer_ptr);
-    ready_list.push_back(std::move(received_message_list));
+    ready_list.emplace_back(recv_buffer_.data() + displcmnts_[i]);
   }
 }
 
 void GlooController::SendFinalTensors(ResponseList& response_list) {
   // Notify all nodes which tensors we'd like to reduce at this step.
-  std::string encoded_response;
-  ResponseList::SerializeToString(response_list, encoded_response);
+  ResponseList::SerializeToString(response_list, encoded_message_);
 
   // Boardcast the response length
-  int encoded_response_length = (int)encoded_response.length() + 1;
+  int encoded_response_length = (int)encoded_message_.length() + 1;
   {
     gloo::BroadcastOptions opts(gloo_context_.ctx);
     opts.setOutput(&encoded_response_length, 1);
@@ -191,7 +188,7 @@ void GlooController::SendFinalTensors(ResponseList& response_list) {
   // Boardcast the response
   {
     gloo::BroadcastOptions opts(gloo_context_.ctx);
-    opts.setOutput((uint8_t*)(encoded_response.c_str()),
+    opts.setOutput((uint8_t*)(encoded_message_.c_str()),
                    encoded_response_length);
     opts.setRoot(RANK_ZERO);
     gloo::broadcast(opts);
@@ -199,40 +196,31 @@ void GlooController::SendFinalTensors(ResponseList& response_list) {
 }
 
 void GlooController::SendReadyTensors(RequestList& message_list) {
-  std::string encoded_message;
-  RequestList::SerializeToString(message_list, encoded_message);
+  RequestList::SerializeToString(message_list, encoded_message_);
 
   // Gloo doesn't have the gatherv options, using allgatherv instead.
 
   // send message length to root
-  std::unique_ptr<int[]> recvcounts(new int[size_]);
-  int encoded_message_length = (int)encoded_message.length() + 1;
+  recvcounts_.resize(size_);
+  int encoded_message_length = (int)encoded_message_.length() + 1;
   {
     gloo::AllgatherOptions opts(gloo_context_.ctx);
     opts.setInput(&encoded_message_length, 1);
-    opts.setOutput(recvcounts.get(), size_);
+    opts.setOutput(recvcounts_.data(), size_);
     gloo::allgather(opts);
   }
 
-  std::unique_ptr<int[]> displcmnts(new int[size_]);
-  size_t total_size = 0;
-  for (int i = 0; i < size_; ++i) {
-    if (i == 0) {
-      displcmnts[i] = 0;
-    } else {
-      displcmnts[i] = recvcounts[i - 1] + displcmnts[i - 1];
-    }
-    total_size += recvcounts[i];
-  }
+  size_t total_size = ComputeDisplacements();
 
   // 3. Collect messages from every rank.
-  std::unique_ptr<uint8_t[]> buffer(new uint8_t[total_size]);
+  if (recv_buffer_.size() < total_size) {
+    recv_buffer_.resize(total_size);
+  }
   // send message body to root
   {
     gloo::AllgathervOptions opts(gloo_context_.ctx);
-    opts.setInput((uint8_t*)encoded_message.c_str(), encoded_message_length);
-    std::vector<size_t> count_vec(recvcounts.get(), recvcounts.get() + size_);
-    opts.setOutput((uint8_t*)buffer.get(), count_vec);
+    opts.setInput((uint8_t*)encoded_message_.c_str(), encoded_message_length);
+    opts.setOutput(recv_buffer_.data(), count_vec_);
     gloo::allgatherv(opts);
   }
 }
@@ -247,16 +235,29 @@ void GlooController::RecvFinalTensors(ResponseList& response_list) {
     gloo::broadcast(opts);
   }
   // root broadcast final message to others
-  std::unique_ptr<uint8_t[]> buffer(new uint8_t[msg_length]);
-  memset(buffer.get(), 0, msg_length);
+  if ((int)recv_buffer_.size() < msg_length) {
+    recv_buffer_.resize(msg_length);
+  }
   {
     gloo::BroadcastOptions opts(gloo_context_.ctx);
-    opts.setOutput((uint8_t*)buffer.get(), msg_length);
+    opts.setOutput(recv_buffer_.data(), msg_length);
     opts.setRoot(RANK_ZERO);
     gloo::broadcast(opts);
   }
 
-  ResponseList::ParseFromBytes(response_list, buffer.get());
+  ResponseList::ParseFromBytes(response_list, recv_buffer_.data());
+}
+
+size_t GlooController::ComputeDisplacements() {
+  displcmnts_.resize(size_);
+  count_vec_.resize(size_);
+  size_t total_size = 0;
+  for (int i = 0; i < size_; ++i) {
+    displcmnts_[i] = (int)total_size;
+    count_vec_[i] = recvcounts_[i];
+    total_size += recvcounts_[i];
+  }
+  return total_size;
 }
 
 void GlooController::Bcast(void* buffer, size_t size, int root_rank,
@@ -269,10 +270,10 @@ void GlooController::Bcast(void* buffer, size_t size, int root_rank,
 
 void GlooController::AlltoallGetRecvSplits(const std::vector<int32_t>& splits,
                                            std::vector<int32_t>& recvsplits) {
-  recvsplits.resize(size_);
+  recvsplits.resize(splits.size());
   gloo::AlltoallOptions opts(gloo_context_.GetGlooContext(Communicator::GLOBAL));
-  opts.setInput((int32_t*)splits.data(), size_);
-  opts.setOutput(recvsplits.data(), size_);
+  opts.setInput((int32_t*)splits.data(), splits.size());
+  opts.setOutput(recvsplits.data(), recvsplits.size());
   gloo::alltoall(opts);
 }
 
@@ -281,5 +282,18 @@ void GlooController::Barrier(Communicator communicator) {
   gloo::barrier(opts);
 }
 
+void GlooController::ProcessSetBcast(void* buffer, size_t size,
+                                     int32_t process_set_id) {
+  throw std::logic_error("Process sets are not supported with Gloo.");
+}
+
+void GlooController::DoInitializeProcessSets() {
+  if (process_sets_.NumSets() > 0) {
+    LOG(WARNING) << "Process sets are not supported with Gloo, ignoring "
+                 << HOROVOD_PROCESS_SETS << ".";
+    process_sets_.Clear();
+  }
+}
+
 } // namespace common
 } // namespace horovod
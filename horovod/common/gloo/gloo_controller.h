@@ -27,8 +27,9 @@ class GlooController : public Controller {
 public:
   GlooController(ResponseCache& response_cache, TensorQueue& tensor_queue,
                  Timeline& timeline, ParameterManager& parameter_manager,
-                 GlooContext& gloo_context)
-      : Controller(response_cache, tensor_queue, timeline, parameter_manager),
+                 HorovodMetrics& metrics, GlooContext& gloo_context)
+      : Controller(response_cache, tensor_queue, timeline, parameter_manager,
+                   metrics),
         gloo_context_(gloo_context) {};
 
   int GetTypeSize(DataType dtype) override;
@@ -39,8 +40,10 @@ public:
   void CrossRankBitwiseOr(std::vector<long long>& bitvector,
                           int count) override;
 
+  void CrossRankSum(std::vector<double>& values) override;
+
   void RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
-                        std::vector<RequestList>& ready_list) override;
+                        std::vector<RequestListView>& ready_list) override;
 
   void SendFinalTensors(ResponseList& response_list) override;
 
@@ -55,10 +58,25 @@ public:
 
   void Barrier(Communicator communicator) override;
 
+  void ProcessSetBcast(void* buffer, size_t size,
+                       int32_t process_set_id) override;
+
 protected:
   void DoInitialization() override;
 
+  void DoInitializeProcessSets() override;
+
+  // Fills displcmnts_ and count_vec_ from recvcounts_, returns the total size.
+  size_t ComputeDisplacements();
+
   GlooContext& gloo_context_;
+
+  // Negotiation buffers, reused across cycles.
+  std::vector<int> recvcounts_;
+  std::vector<int> displcmnts_;
+  std::vector<size_t> count_vec_;
+  std::vector<uint8_t> recv_buffer_;
+  std::string encoded_message_;
 };
 
 template <typename T>
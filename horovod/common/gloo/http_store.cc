@@ -15,6 +15,7 @@
 
 #include "http_store.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <istream>
@@ -36,6 +37,10 @@ void HTTPStore::set(const std::string& key, const std::vector<char>& data) {
 }
 
 std::vector<char> HTTPStore::get(const std::string& key) {
+  auto it = values_.find(key);
+  if (it != values_.end()) {
+    return it->second;
+  }
   std::vector<char> result;
   HTTP_GET(key, result);
   return result;
@@ -45,22 +50,45 @@ void HTTPStore::wait(const std::vector<std::string>& keys,
                      const std::chrono::milliseconds& timeout) {
   const auto start = std::chrono::steady_clock::now();
 
-  while (!CheckKeys(keys)) {
-    const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+  // The server holds the requests until the keys are set, instead of the
+  // store polling it.
+  int wait_millis = LONG_POLL_MAX_MILLSEC;
+  while (!CheckKeys(keys, wait_millis)) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now() - start);
     if (timeout != gloo::kNoTimeout && elapsed > timeout) {
       GLOO_THROW_IO_EXCEPTION(GLOO_ERROR_MSG("Wait timeout for key(s): ",
                                              ::gloo::MakeString(keys)));
     }
-    /* sleep override */
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (timeout != gloo::kNoTimeout) {
+      wait_millis = (int)std::max(
+          (int64_t)1, std::min((int64_t)LONG_POLL_MAX_MILLSEC,
+                               (int64_t)(timeout - elapsed).count()));
+    }
   }
 }
 
-bool HTTPStore::CheckKeys(const std::vector<std::string>& keys) {
-  std::vector<char> result;
+bool HTTPStore::CheckKeys(const std::vector<std::string>& keys,
+                          int wait_millis) {
+  std::vector<std::string> missing_keys;
   for (const auto& key : keys) {
-    if (!HTTP_GET(key, result)) {
+    if (values_.find(key) == values_.end()) {
+      missing_keys.push_back(key);
+    }
+  }
+  if (missing_keys.empty()) {
+    return true;
+  }
+  size_t num_missing_keys = missing_keys.size();
+  for (const auto& key : prefetch_keys_) {
+    if (values_.find(key) == values_.end() &&
+        std::find(keys.begin(), keys.end(), key) == keys.end()) {
+      missing_keys.push_back(key);
+    }
+  }
+  HTTP_MULTI_GET(missing_keys, num_missing_keys, wait_millis);
+  for (size_t i = 0; i < num_missing_keys; ++i) {
+    if (values_.find(missing_keys[i]) == values_.end()) {
       return false;
     }
   }
@@ -71,10 +99,11 @@ bool HTTPStore::CheckKeys(const std::vector<std::string>& keys) {
 http::Response
 HTTPStore::PerformHTTP(http::Request& request,
                        const std::string& method = HTTP_GET_METHOD,
-                       const std::string& body = "") {
+                       const std::string& body = "",
+                       const std::vector<std::string>& headers = {}) {
   for (int retry_cnt = 0; retry_cnt < MAX_RETRY_TIMES; ++retry_cnt) {
     try {
-      http::Response response = request.send(method, body);
+      http::Response response = request.send(method, body, headers);
       if (response.status != HTTP_OK && response.status != HTTP_NOT_FOUND) {
         LOG(WARNING) << "HTTP response not OK, got " << response.status;
       } else {
@@ -123,6 +152,65 @@ void HTTPStore::HTTP_PUT(const std::string& key,
   PerformHTTP(request, HTTP_PUT_METHOD, body);
 }
 
+static void AppendLengthPrefixed(std::string& body, const char* data,
+                                 uint32_t length) {
+  // Lengths are little endian, like struct.Struct('<I') on the server.
+  for (int i = 0; i < 4; ++i) {
+    body.push_back((char)((length >> (8 * i)) & 0xff));
+  }
+  body.append(data, length);
+}
+
+static bool ReadLengthPrefixed(const std::vector<uint8_t>& body,
+                               size_t& offset, size_t& start,
+                               uint32_t& length) {
+  if (offset + 4 > body.size()) {
+    return false;
+  }
+  length = 0;
+  for (int i = 0; i < 4; ++i) {
+    length |= (uint32_t)body[offset + i] << (8 * i);
+  }
+  start = offset + 4;
+  if (start + length > body.size()) {
+    return false;
+  }
+  offset = start + length;
+  return true;
+}
+
+void HTTPStore::HTTP_MULTI_GET(const std::vector<std::string>& keys,
+                               size_t num_wait_keys, int wait_millis) {
+  LOG(TRACE) << "Send POST request for " << keys.size() << " keys to "
+             << url_prefix_;
+  http::Request request(url_prefix_);
+
+  std::string body;
+  for (const auto& key : keys) {
+    AppendLengthPrefixed(body, key.data(), (uint32_t)key.size());
+  }
+
+  std::vector<std::string> headers;
+  if (num_wait_keys > 0 && wait_millis > 0) {
+    headers.push_back("X-Wait-Keys: " + std::to_string(num_wait_keys));
+    headers.push_back("X-Wait-Timeout: " + std::to_string(wait_millis));
+  }
+  http::Response response =
+      PerformHTTP(request, HTTP_POST_METHOD, body, headers);
+  size_t offset = 0;
+  size_t key_start, value_start;
+  uint32_t key_length, value_length;
+  while (ReadLengthPrefixed(response.body, offset, key_start, key_length) &&
+         ReadLengthPrefixed(response.body, offset, value_start,
+                            value_length)) {
+    std::string key(response.body.begin() + key_start,
+                    response.body.begin() + key_start + key_length);
+    values_[key] = std::vector<char>(
+        response.body.begin() + value_start,
+        response.body.begin() + value_start + value_length);
+  }
+}
+
 void HTTPStore::HTTP_DELETE(const std::string& key) {
   std::string url = url_prefix_ + key;
   LOG(TRACE) << "Send GET request to " << url;
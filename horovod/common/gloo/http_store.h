@@ -16,6 +16,8 @@
 #ifndef HOROVOD_GLOO_HTTP_STORE_H
 #define HOROVOD_GLOO_HTTP_STORE_H
 
+#include <unordered_map>
+
 #include "HTTPRequest.hpp"
 
 #include "gloo_store.h"
@@ -28,8 +30,12 @@ namespace common {
 #define HTTP_GET_METHOD "GET"
 #define HTTP_PUT_METHOD "PUT"
 #define HTTP_DELETE_METHOD "DELETE"
+#define HTTP_POST_METHOD "POST"
 #define HTTP_OK 200
 #define HTTP_NOT_FOUND 404
+// The server holds a multi-get for at most this long, until the keys waited
+// for are all set.
+#define LONG_POLL_MAX_MILLSEC 1000
 
 class HTTPStore : public GlooStore {
 public:
@@ -51,7 +57,16 @@ public:
   void wait(const std::vector<std::string>& keys,
             const std::chrono::milliseconds& timeout) override;
 
-  bool CheckKeys(const std::vector<std::string>& keys);
+  // Fetches the missing keys, and the missing prefetch keys, with one
+  // multi-get request. Returns true if all keys are present. The server
+  // waits up to wait_millis for the missing keys before responding.
+  bool CheckKeys(const std::vector<std::string>& keys, int wait_millis = 0);
+
+  // Keys fetched along with the ones waited for, so that waiting for them
+  // later does not need another request.
+  void SetPrefetchKeys(const std::vector<std::string>& keys) {
+    prefetch_keys_ = keys;
+  }
 
   void Finalize() override;
 
@@ -59,7 +74,8 @@ protected:
   // Send HTTP request to server, retry if the status code is not 200 (OK) or
   // 404 (Key not found).
   http::Response PerformHTTP(http::Request& request, const std::string& method,
-                             const std::string& body);
+                             const std::string& body,
+                             const std::vector<std::string>& headers);
 
   // HTTP GET: result is an out parameter for retrieved value for the key.
   // Return a bool representing whether the key is found in the store.
@@ -74,8 +90,19 @@ protected:
   // this rank has finished.
   void HTTP_DELETE(const std::string& key);
 
+  // HTTP POST: multi-get of the keys, adds the keys found to values_. The
+  // server responds once the first num_wait_keys keys are all set, or after
+  // wait_millis.
+  void HTTP_MULTI_GET(const std::vector<std::string>& keys,
+                      size_t num_wait_keys = 0, int wait_millis = 0);
+
   std::string url_prefix_;
   int rank_;
+
+  // Values are only set once during a rendezvous, the ones fetched by wait()
+  // are kept for get().
+  std::unordered_map<std::string, std::vector<char>> values_;
+  std::vector<std::string> prefetch_keys_;
 };
 
 } // namespace common
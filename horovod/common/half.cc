@@ -15,11 +15,25 @@
 
 #include "half.h"
 
-#if __AVX__ && __F16C__
+#include "parallel_for.h"
+
+#if (__AVX__ && __F16C__) || HOROVOD_X86_DISPATCH
 #include <cpuid.h>
 #include <immintrin.h>
 #endif
 
+#if __ARM_NEON && __aarch64__
+#include <arm_neon.h>
+#endif
+
+#if HOROVOD_PPC_DISPATCH
+#include <altivec.h>
+// altivec.h defines these as keywords, which collide with C++.
+#undef vector
+#undef bool
+#undef pixel
+#endif
+
 namespace horovod {
 namespace common {
 
@@ -39,18 +53,287 @@ bool is_avx_and_f16c() {
 }
 #endif
 
+#if HOROVOD_X86_DISPATCH
+bool is_avx2() {
+  static bool result = __builtin_cpu_supports("avx2");
+  return result;
+}
+
+bool is_avx512f() {
+  static bool result = __builtin_cpu_supports("avx512f");
+  return result;
+}
+
+namespace {
+
+// The mask-less forms of the AVX-512 conversions and shifts take an undefined
+// pass-through operand that GCC warns about, the zero-masking forms with all
+// lanes set compile to the same instructions.
+constexpr __mmask16 ALL_LANES_16 = 0xFFFF;
+constexpr __mmask8 ALL_LANES_8 = 0xFF;
+
+// Both kernels widen bfloat16 to float32 by shifting, add, and round back to
+// nearest even. NaNs are kept quiet like in Float2BFloat16Bits. They return
+// the number of elements summed, the rest is left to the scalar loop.
+__attribute__((target("avx2"))) int64_t
+BFloat16SumAVX2(const unsigned short* a, const unsigned short* b,
+                unsigned short* out, int64_t num_elements) {
+  const __m256i bias = _mm256_set1_epi32(0x7fff);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i quiet = _mm256_set1_epi32(0x40);
+  int64_t i = 0;
+  for (; i + 8 <= num_elements; i += 8) {
+    __m256 a_m256 = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + i))), 16));
+    __m256 b_m256 = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(b + i))), 16));
+    __m256 sum_m256 = _mm256_add_ps(a_m256, b_m256);
+
+    __m256i bits = _mm256_castps_si256(sum_m256);
+    __m256i upper = _mm256_srli_epi32(bits, 16);
+    __m256i rounded = _mm256_srli_epi32(
+        _mm256_add_epi32(bits, _mm256_add_epi32(bias, _mm256_and_si256(upper, one))), 16);
+    __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(sum_m256, sum_m256, _CMP_UNORD_Q));
+    rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(upper, quiet), nan);
+
+    // The values fit in 16 bits, so the saturating pack only narrows them.
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(rounded),
+                                      _mm256_extracti128_si256(rounded, 1));
+    _mm_storeu_si128((__m128i*)(out + i), packed);
+  }
+  return i;
+}
+
+__attribute__((target("avx512f"))) int64_t
+BFloat16SumAVX512(const unsigned short* a, const unsigned short* b,
+                  unsigned short* out, int64_t num_elements) {
+  const __m512i bias = _mm512_set1_epi32(0x7fff);
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i quiet = _mm512_set1_epi32(0x40);
+  int64_t i = 0;
+  for (; i + 16 <= num_elements; i += 16) {
+    __m512 a_m512 = _mm512_castsi512_ps(_mm512_maskz_slli_epi32(
+        ALL_LANES_16,
+        _mm512_maskz_cvtepu16_epi32(
+            ALL_LANES_16, _mm256_loadu_si256((const __m256i*)(a + i))),
+        16));
+    __m512 b_m512 = _mm512_castsi512_ps(_mm512_maskz_slli_epi32(
+        ALL_LANES_16,
+        _mm512_maskz_cvtepu16_epi32(
+            ALL_LANES_16, _mm256_loadu_si256((const __m256i*)(b + i))),
+        16));
+    __m512 sum_m512 = _mm512_add_ps(a_m512, b_m512);
+
+    __m512i bits = _mm512_castps_si512(sum_m512);
+    __m512i upper = _mm512_maskz_srli_epi32(ALL_LANES_16, bits, 16);
+    __m512i rounded = _mm512_maskz_srli_epi32(
+        ALL_LANES_16,
+        _mm512_add_epi32(bits, _mm512_add_epi32(bias, _mm512_and_si512(upper, one))),
+        16);
+    __mmask16 nan = _mm512_cmp_ps_mask(sum_m512, sum_m512, _CMP_UNORD_Q);
+    rounded = _mm512_mask_mov_epi32(rounded, nan, _mm512_or_si512(upper, quiet));
+
+    _mm256_storeu_si256((__m256i*)(out + i),
+                        _mm512_maskz_cvtepi32_epi16(ALL_LANES_16, rounded));
+  }
+  return i;
+}
+
 #if HAVE_MPI
-// float16 custom data type summation operation.
-void float16_sum(void* invec, void* inoutvec, int* len,
-                 MPI_Datatype* datatype) {
-  // cast invec and inoutvec to your float16 type
-  auto* in = (unsigned short*)invec;
-  auto* inout = (unsigned short*)inoutvec;
+// Adds in to inout, 16 float16 values at a time. Returns the number of
+// elements summed.
+__attribute__((target("avx512f"))) int64_t
+Float16SumAVX512(const unsigned short* in, unsigned short* inout,
+                 int64_t num_elements) {
+  int64_t i = 0;
+  for (; i + 16 <= num_elements; i += 16) {
+    __m512 in_m512 =
+        _mm512_maskz_cvtph_ps(ALL_LANES_16,
+                              _mm256_loadu_si256((const __m256i*)(in + i)));
+    __m512 inout_m512 =
+        _mm512_maskz_cvtph_ps(ALL_LANES_16,
+                              _mm256_loadu_si256((const __m256i*)(inout + i)));
+    __m256i new_inout_m256i =
+        _mm512_maskz_cvtps_ph(ALL_LANES_16, _mm512_add_ps(in_m512, inout_m512),
+                              0);
+    _mm256_storeu_si256((__m256i*)(inout + i), new_inout_m256i);
+  }
+  return i;
+}
+#endif
+
+} // namespace
+#endif
+
+#if __ARM_NEON && __aarch64__
+namespace {
+
+// Advanced SIMD and its float16 conversions are part of every AArch64 CPU,
+// so these kernels need no runtime check. They work like the x86 ones.
+inline uint32x4_t BFloat16RoundNEON(float32x4_t sum) {
+  uint32x4_t bits = vreinterpretq_u32_f32(sum);
+  uint32x4_t upper = vshrq_n_u32(bits, 16);
+  uint32x4_t rounded = vshrq_n_u32(
+      vaddq_u32(bits, vaddq_u32(vdupq_n_u32(0x7fff),
+                                vandq_u32(upper, vdupq_n_u32(1)))),
+      16);
+  uint32x4_t not_nan = vceqq_f32(sum, sum);
+  return vbslq_u32(not_nan, rounded,
+                   vorrq_u32(upper, vdupq_n_u32(0x40)));
+}
+
+int64_t BFloat16SumNEON(const unsigned short* a, const unsigned short* b,
+                        unsigned short* out, int64_t num_elements) {
+  int64_t i = 0;
+  for (; i + 8 <= num_elements; i += 8) {
+    uint16x8_t a_u16 = vld1q_u16(a + i);
+    uint16x8_t b_u16 = vld1q_u16(b + i);
+    float32x4_t sum_low = vaddq_f32(
+        vreinterpretq_f32_u32(vshll_n_u16(vget_low_u16(a_u16), 16)),
+        vreinterpretq_f32_u32(vshll_n_u16(vget_low_u16(b_u16), 16)));
+    float32x4_t sum_high = vaddq_f32(
+        vreinterpretq_f32_u32(vshll_high_n_u16(a_u16, 16)),
+        vreinterpretq_f32_u32(vshll_high_n_u16(b_u16, 16)));
+    vst1q_u16(out + i, vcombine_u16(vmovn_u32(BFloat16RoundNEON(sum_low)),
+                                    vmovn_u32(BFloat16RoundNEON(sum_high))));
+  }
+  return i;
+}
+
+#if HAVE_MPI
+int64_t Float16SumNEON(const unsigned short* in, unsigned short* inout,
+                       int64_t num_elements) {
+  int64_t i = 0;
+  for (; i + 8 <= num_elements; i += 8) {
+    float16x8_t in_f16 = vreinterpretq_f16_u16(vld1q_u16(in + i));
+    float16x8_t inout_f16 = vreinterpretq_f16_u16(vld1q_u16(inout + i));
+    float32x4_t sum_low = vaddq_f32(vcvt_f32_f16(vget_low_f16(in_f16)),
+                                    vcvt_f32_f16(vget_low_f16(inout_f16)));
+    float32x4_t sum_high =
+        vaddq_f32(vcvt_high_f32_f16(in_f16), vcvt_high_f32_f16(inout_f16));
+    float16x8_t sum = vcvt_high_f16_f32(vcvt_f16_f32(sum_low), sum_high);
+    vst1q_u16(inout + i, vreinterpretq_u16_f16(sum));
+  }
+  return i;
+}
+#endif
+
+} // namespace
+#endif
+
+#if HOROVOD_PPC_DISPATCH
+bool is_power9() {
+  static bool result = __builtin_cpu_supports("arch_3_00");
+  return result;
+}
+
+namespace {
+
+typedef __vector unsigned short VectorU16;
+typedef __vector unsigned int VectorU32;
+typedef __vector signed short VectorS16;
+typedef __vector float VectorF32;
+
+// Widens bfloat16 by sign extending and shifting out the extension, which
+// does not depend on the element order of the endianness.
+inline VectorF32 BFloat16ToFloatVSX(VectorS16 bits, bool high) {
+  __vector signed int wide = high ? vec_unpackh(bits) : vec_unpackl(bits);
+  return (VectorF32)vec_sl((VectorU32)wide, vec_splats(16u));
+}
+
+inline VectorU32 BFloat16RoundVSX(VectorF32 sum) {
+  VectorU32 bits = (VectorU32)sum;
+  VectorU32 upper = vec_sr(bits, vec_splats(16u));
+  VectorU32 rounded = vec_sr(
+      vec_add(bits, vec_add(vec_splats(0x7fffu),
+                            vec_and(upper, vec_splats(1u)))),
+      vec_splats(16u));
+  return vec_sel(vec_or(upper, vec_splats(0x40u)), rounded,
+                 (VectorU32)vec_cmpeq(sum, sum));
+}
+
+int64_t BFloat16SumVSX(const unsigned short* a, const unsigned short* b,
+                       unsigned short* out, int64_t num_elements) {
+  int64_t i = 0;
+  for (; i + 8 <= num_elements; i += 8) {
+    VectorS16 a_s16 = (VectorS16)vec_xl(0, a + i);
+    VectorS16 b_s16 = (VectorS16)vec_xl(0, b + i);
+    VectorF32 sum_high = vec_add(BFloat16ToFloatVSX(a_s16, true),
+                                 BFloat16ToFloatVSX(b_s16, true));
+    VectorF32 sum_low = vec_add(BFloat16ToFloatVSX(a_s16, false),
+                                BFloat16ToFloatVSX(b_s16, false));
+    VectorU16 packed =
+        vec_pack(BFloat16RoundVSX(sum_high), BFloat16RoundVSX(sum_low));
+    vec_xst(packed, 0, out + i);
+  }
+  return i;
+}
+
+#if HAVE_MPI
+__attribute__((target("cpu=power9"))) int64_t
+Float16SumVSX(const unsigned short* in, unsigned short* inout,
+              int64_t num_elements) {
+  int64_t i = 0;
+  for (; i + 8 <= num_elements; i += 8) {
+    VectorU16 in_u16 = vec_xl(0, in + i);
+    VectorU16 inout_u16 = vec_xl(0, inout + i);
+    VectorF32 sum_high = vec_add(vec_extract_fp32_from_shorth(in_u16),
+                                 vec_extract_fp32_from_shorth(inout_u16));
+    VectorF32 sum_low = vec_add(vec_extract_fp32_from_shortl(in_u16),
+                                vec_extract_fp32_from_shortl(inout_u16));
+    vec_xst(vec_pack_to_short_fp32(sum_high, sum_low), 0, inout + i);
+  }
+  return i;
+}
+#endif
 
-  int i = 0;
+} // namespace
+#endif
+
+namespace {
+
+void BFloat16SumRange(const unsigned short* a, const unsigned short* b,
+                      unsigned short* out, int64_t num_elements) {
+  int64_t i = 0;
+#if HOROVOD_X86_DISPATCH
+  if (is_avx512f()) {
+    i = BFloat16SumAVX512(a, b, out, num_elements);
+  } else if (is_avx2()) {
+    i = BFloat16SumAVX2(a, b, out, num_elements);
+  }
+#elif __ARM_NEON && __aarch64__
+  i = BFloat16SumNEON(a, b, out, num_elements);
+#elif HOROVOD_PPC_DISPATCH
+  i = BFloat16SumVSX(a, b, out, num_elements);
+#endif
+  for (; i < num_elements; ++i) {
+    float a_float;
+    float b_float;
+    BFloat16Bits2Float(a + i, &a_float);
+    BFloat16Bits2Float(b + i, &b_float);
+    float out_float = a_float + b_float;
+    Float2BFloat16Bits(&out_float, out + i);
+  }
+}
+
+#if HAVE_MPI
+void Float16SumRange(const unsigned short* in, unsigned short* inout,
+                     int64_t num_elements) {
+  int64_t i = 0;
+#if HOROVOD_X86_DISPATCH
+  if (is_avx512f()) {
+    i = Float16SumAVX512(in, inout, num_elements);
+  }
+#elif __ARM_NEON && __aarch64__
+  i = Float16SumNEON(in, inout, num_elements);
+#elif HOROVOD_PPC_DISPATCH
+  if (is_power9()) {
+    i = Float16SumVSX(in, inout, num_elements);
+  }
+#endif
 #if __AVX__ && __F16C__
   if (is_avx_and_f16c()) {
-    for (; i < (*len / 8) * 8; i += 8) {
+    for (; i < (num_elements / 8) * 8; i += 8) {
       // convert in & inout to m256
       __m256 in_m256 = _mm256_cvtph_ps(_mm_loadu_si128((__m128i*)(in + i)));
       __m256 inout_m256 =
@@ -65,7 +348,7 @@ void float16_sum(void* invec, void* inoutvec, int* len,
     }
   }
 #endif
-  for (; i < *len; ++i) {
+  for (; i < num_elements; ++i) {
     float in_float;
     float inout_float;
     HalfBits2Float(in + i, &in_float);
@@ -76,5 +359,38 @@ void float16_sum(void* invec, void* inoutvec, int* len,
 }
 #endif
 
+} // namespace
+
+void BFloat16Sum(const unsigned short* a, const unsigned short* b,
+                 unsigned short* out, int64_t num_elements) {
+  ParallelFor(num_elements, CPU_REDUCTION_MIN_BYTES_PER_THREAD / 2,
+              [&](int range, int64_t begin, int64_t end) {
+                BFloat16SumRange(a + begin, b + begin, out + begin,
+                                 end - begin);
+              });
+}
+
+#if HAVE_MPI
+// float16 custom data type summation operation.
+void float16_sum(void* invec, void* inoutvec, int* len,
+                 MPI_Datatype* datatype) {
+  // cast invec and inoutvec to your float16 type
+  auto* in = (unsigned short*)invec;
+  auto* inout = (unsigned short*)inoutvec;
+  ParallelFor(*len, CPU_REDUCTION_MIN_BYTES_PER_THREAD / 2,
+              [&](int range, int64_t begin, int64_t end) {
+                Float16SumRange(in + begin, inout + begin, end - begin);
+              });
+}
+
+// bfloat16 custom data type summation operation.
+void bfloat16_sum(void* invec, void* inoutvec, int* len,
+                  MPI_Datatype* datatype) {
+  auto* in = (unsigned short*)invec;
+  auto* inout = (unsigned short*)inoutvec;
+  BFloat16Sum(in, inout, inout, *len);
+}
+#endif
+
 } // namespace common
 } // namespace horovod
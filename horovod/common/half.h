@@ -26,6 +26,7 @@
 #ifndef HOROVOD_HALF_H
 #define HOROVOD_HALF_H
 
+#include <cstring>
 #include <stdint.h>
 
 #if HAVE_MPI
@@ -40,6 +41,28 @@ namespace common {
 bool is_avx_and_f16c();
 #endif
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HOROVOD_X86_DISPATCH 1
+// Query CPUID to determine AVX2 and AVX-512 runtime support. Kernels using
+// them are compiled for their target whatever the build flags are.
+bool is_avx2();
+bool is_avx512f();
+#endif
+
+#if defined(__GNUC__) && defined(__powerpc64__) && defined(__VSX__)
+#define HOROVOD_PPC_DISPATCH 1
+// Query the platform to determine POWER9 runtime support. The float16
+// kernel using its conversions is compiled for it whatever the build flags
+// are, the bfloat16 one only needs VSX.
+bool is_power9();
+#endif
+
+// Storage of a bfloat16 value, so that templates over element types can tell
+// bfloat16 from 16-bit integers.
+struct BFloat16 {
+  unsigned short bits;
+};
+
 inline void HalfBits2Float(const unsigned short* src, float* res) {
   unsigned h = *src;
   int sign = ((h >> 15) & 1);
@@ -73,7 +96,7 @@ inline void HalfBits2Float(const unsigned short* src, float* res) {
     }
   }
 
-  *res = *reinterpret_cast<float const*>(&f);
+  std::memcpy(res, &f, sizeof(*res));
 }
 
 inline void Float2HalfBits(const float* src, unsigned short* dest) {
@@ -138,8 +161,32 @@ inline void Float2HalfBits(const float* src, unsigned short* dest) {
   *dest = u;
 }
 
+inline void BFloat16Bits2Float(const unsigned short* src, float* res) {
+  // bfloat16 is the upper half of a float32
+  unsigned f = unsigned(*src) << 16;
+  std::memcpy(res, &f, sizeof(*res));
+}
+
+inline void Float2BFloat16Bits(const float* src, unsigned short* dest) {
+  // software implementation rounds toward nearest even
+  unsigned s;
+  std::memcpy(&s, src, sizeof(s));
+  if ((s & 0x7fffffff) > 0x7f800000) {
+    // not a number, kept quiet instead of being rounded to infinity
+    *dest = uint16_t((s >> 16) | 0x40);
+    return;
+  }
+  *dest = uint16_t((s + 0x7fff + ((s >> 16) & 1)) >> 16);
+}
+
+// Sums num_elements bfloat16 values of a and b into out, which may be a or b.
+void BFloat16Sum(const unsigned short* a, const unsigned short* b,
+                 unsigned short* out, int64_t num_elements);
+
 #if HAVE_MPI
 void float16_sum(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
+
+void bfloat16_sum(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype);
 #endif
 
 } // namespace common
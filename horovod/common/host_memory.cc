@@ -0,0 +1,145 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "host_memory.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <strings.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "logging.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace horovod {
+namespace common {
+
+HostPageSize ParseHostPageSizeFromEnv() {
+  HostPageSize page_size = HostPageSize::DEFAULT;
+  const char* user_page_size = std::getenv(HOROVOD_HOST_HUGE_PAGES);
+  if (user_page_size != nullptr) {
+    if (strcasecmp(user_page_size, "0") == 0 ||
+        strcasecmp(user_page_size, "none") == 0) {
+      page_size = HostPageSize::DEFAULT;
+    } else if (strcasecmp(user_page_size, "1") == 0 ||
+               strcasecmp(user_page_size, "thp") == 0) {
+      page_size = HostPageSize::TRANSPARENT;
+    } else if (strcasecmp(user_page_size, "2M") == 0) {
+      page_size = HostPageSize::HUGE_2MB;
+    } else if (strcasecmp(user_page_size, "1G") == 0) {
+      page_size = HostPageSize::HUGE_1GB;
+    } else {
+      throw std::runtime_error("Unsupported host huge pages, only none, thp, "
+                               "2M and 1G are supported");
+    }
+  }
+  return page_size;
+}
+
+#ifdef __linux__
+namespace {
+
+// Writes a byte of every page so that the kernel backs them now rather than
+// on the first touch in a collective.
+void Prefault(void* data, int64_t size) {
+  auto page = (int64_t)sysconf(_SC_PAGESIZE);
+  auto bytes = (volatile uint8_t*)data;
+  for (int64_t offset = 0; offset < size; offset += page) {
+    bytes[offset] = 0;
+  }
+}
+
+} // namespace
+
+std::shared_ptr<void> AllocateHostMemory(int64_t size, HostPageSize page_size,
+                                         bool prefault) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  int64_t page_bytes = 0;
+  if (page_size == HostPageSize::HUGE_2MB) {
+    flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+    page_bytes = 1 << 21;
+  } else if (page_size == HostPageSize::HUGE_1GB) {
+    flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+    page_bytes = 1 << 30;
+  }
+
+  void* data = MAP_FAILED;
+  int64_t mapped = size;
+  if (page_bytes > 0) {
+    mapped = (size + page_bytes - 1) / page_bytes * page_bytes;
+    // Reserved huge pages are faulted in all at once by MAP_POPULATE.
+    data = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                flags | (prefault ? MAP_POPULATE : 0), -1, 0);
+    if (data == MAP_FAILED) {
+      LOG(WARNING) << "Cannot allocate " << mapped << " bytes of huge pages of "
+                   << page_bytes << " bytes, falling back to transparent huge "
+                   << "pages. Reserve more in /proc/sys/vm/nr_hugepages.";
+      page_size = HostPageSize::TRANSPARENT;
+      mapped = size;
+    }
+  }
+  if (data == MAP_FAILED) {
+    data = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+      return nullptr;
+    }
+    PrepareHostMemory(data, mapped, page_size, prefault);
+  }
+  return std::shared_ptr<void>(data, [mapped](void* ptr) { munmap(ptr, mapped); });
+}
+
+void PrepareHostMemory(void* data, int64_t size, HostPageSize page_size,
+                       bool prefault) {
+  if (page_size != HostPageSize::DEFAULT) {
+    // madvise needs a page aligned start, the pages before data are shared
+    // with memory that was allocated the same way.
+    auto page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    auto begin = (uintptr_t)data / page * page;
+    madvise((void*)begin, (uintptr_t)data + size - begin, MADV_HUGEPAGE);
+  }
+  if (prefault) {
+    Prefault(data, size);
+  }
+}
+#else
+std::shared_ptr<void> AllocateHostMemory(int64_t size, HostPageSize page_size,
+                                         bool prefault) {
+  void* data = malloc(size);
+  if (data == nullptr) {
+    return nullptr;
+  }
+  PrepareHostMemory(data, size, page_size, prefault);
+  return std::shared_ptr<void>(data, free);
+}
+
+void PrepareHostMemory(void* data, int64_t size, HostPageSize page_size,
+                       bool prefault) {
+  if (prefault) {
+    memset(data, 0, size);
+  }
+}
+#endif
+
+} // namespace common
+} // namespace horovod
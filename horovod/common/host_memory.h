@@ -0,0 +1,62 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_HOST_MEMORY_H
+#define HOROVOD_HOST_MEMORY_H
+
+#include <memory>
+#include <stdint.h>
+
+#include "common.h"
+
+namespace horovod {
+namespace common {
+
+// Pages backing the host buffers Horovod allocates itself: the default ones,
+// transparent huge pages, or huge pages of 2MB or 1GB reserved by the system
+// in hugetlbfs.
+enum class HostPageSize { DEFAULT = 0, TRANSPARENT = 1, HUGE_2MB = 2, HUGE_1GB = 3 };
+
+HostPageSize ParseHostPageSizeFromEnv();
+
+// Allocates size bytes of host memory on pages of page_size, all faulted in
+// if prefault is set. Falls back to transparent huge pages when no reserved
+// huge page is left. Returns null if the memory cannot be allocated.
+std::shared_ptr<void> AllocateHostMemory(int64_t size, HostPageSize page_size,
+                                         bool prefault);
+
+// Advises memory allocated elsewhere, like MPI shared windows, to be backed
+// by transparent huge pages unless page_size is DEFAULT, and faults it in if
+// prefault is set.
+void PrepareHostMemory(void* data, int64_t size, HostPageSize page_size,
+                       bool prefault);
+
+// A fusion buffer in memory of AllocateHostMemory.
+class HostBuffer : public PersistentBuffer {
+public:
+  explicit HostBuffer(std::shared_ptr<void> data) : data_(std::move(data)) {}
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return data_.get();
+  }
+
+private:
+  std::shared_ptr<void> data_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_HOST_MEMORY_H
@@ -2,18 +2,229 @@
 
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
 
 namespace horovod {
 namespace common {
 
+namespace {
+
+// Maximum number of lines queued with HOROVOD_LOG_ASYNC, the lines logged
+// while the queue is full are written synchronously.
+#define LOG_QUEUE_CAPACITY 8192
+
+// Number of rate limit slots, call sites sharing a slot share its budget.
+#define LOG_RATE_LIMIT_SLOTS 1024
+
+struct LogLine {
+  bool use_cout;
+  std::string text;
+  LogLine* next;
+};
+
+// Rank of this process from the launcher, or its pid if it is unknown.
+std::string LogFileRank() {
+  for (auto var : {"HOROVOD_RANK", "OMPI_COMM_WORLD_RANK", "PMI_RANK"}) {
+    const char* rank = getenv(var);
+    if (rank != nullptr) {
+      return rank;
+    }
+  }
+  return std::to_string(getpid());
+}
+
+// Writes log lines to stdout and stderr, or to HOROVOD_LOG_FILE. With
+// HOROVOD_LOG_ASYNC, the logging threads push lines onto a lock-free list,
+// most recent first, and a background thread takes the whole list at once
+// and writes it out in order.
+class LogSink {
+public:
+  static LogSink& Get() {
+    // Never destroyed, so that static destructors can still log.
+    static LogSink* sink = new LogSink();
+    return *sink;
+  }
+
+  void Write(bool use_cout, std::string text) {
+    if (async_ && !stopped_) {
+      if (queued_.fetch_add(1, std::memory_order_relaxed) <
+          LOG_QUEUE_CAPACITY) {
+        auto line = new LogLine{use_cout, std::move(text), nullptr};
+        line->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(line->next, line,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        return;
+      }
+      // The queue is full, the line is not queued after all.
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    if (async_) {
+      // Keep the lines in order.
+      Drain();
+    }
+    WriteLine(use_cout, text);
+  }
+
+  void Flush() {
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    Drain();
+    if (file_.is_open()) {
+      file_.flush();
+    }
+  }
+
+private:
+  LogSink() {
+    const char* file_name = getenv("HOROVOD_LOG_FILE");
+    if (file_name != nullptr && *file_name != '\0') {
+      std::string path(file_name);
+      auto pos = path.find("%r");
+      if (pos != std::string::npos) {
+        path.replace(pos, 2, LogFileRank());
+      }
+      file_.open(path, std::ios::out | std::ios::app);
+      if (!file_.is_open()) {
+        std::cerr << "Failed to open HOROVOD_LOG_FILE " << path
+                  << ", logging to stderr." << std::endl;
+      }
+    }
+
+    const char* async = getenv("HOROVOD_LOG_ASYNC");
+    if (async != nullptr && std::strtol(async, nullptr, 10) > 0) {
+      async_ = true;
+      flusher_ = std::thread(&LogSink::FlusherLoop, this);
+      flusher_.detach();
+      std::atexit([]() { LogSink::Get().Stop(); });
+    }
+  }
+
+  void Stop() {
+    stopped_ = true;
+    Flush();
+  }
+
+  void FlusherLoop() {
+    while (!stopped_) {
+      {
+        std::lock_guard<std::mutex> guard(write_mutex_);
+        if (Drain() && file_.is_open()) {
+          file_.flush();
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  // Writes out the queued lines, returns whether there were any. Must be
+  // called with write_mutex_ held.
+  bool Drain() {
+    LogLine* line = head_.exchange(nullptr, std::memory_order_acquire);
+    if (line == nullptr) {
+      return false;
+    }
+    // Restore the order the lines were logged in.
+    LogLine* ordered = nullptr;
+    while (line != nullptr) {
+      auto next = line->next;
+      line->next = ordered;
+      ordered = line;
+      line = next;
+    }
+    while (ordered != nullptr) {
+      WriteLine(ordered->use_cout, ordered->text);
+      auto next = ordered->next;
+      delete ordered;
+      ordered = next;
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  void WriteLine(bool use_cout, const std::string& text) {
+    if (file_.is_open()) {
+      file_ << text;
+    } else {
+      std::ostream& os = use_cout ? std::cout : std::cerr;
+      os << text << std::flush;
+    }
+  }
+
+  std::ofstream file_;
+  bool async_ = false;
+  std::atomic<LogLine*> head_{nullptr};
+  std::atomic<int> queued_{0};
+  std::thread flusher_;
+  std::atomic_bool stopped_{false};
+  // Serializes writes to the streams.
+  std::mutex write_mutex_;
+};
+
+int LogRateLimitFromEnv() {
+  const char* env_var_val = getenv("HOROVOD_LOG_RATE_LIMIT");
+  return env_var_val != nullptr ? std::atoi(env_var_val) : 0;
+}
+
+struct LogRateLimitSlot {
+  std::atomic<int64_t> second{0};
+  std::atomic<int> count{0};
+};
+
+LogRateLimitSlot rate_limit_slots[LOG_RATE_LIMIT_SLOTS];
+
+// Lines dropped by the rate limit since the last reported count.
+std::atomic<int64_t> rate_limited_lines{0};
+
+} // namespace
+
 LogMessage::LogMessage(const char* fname, int line, LogLevel severity)
     : fname_(fname), line_(line), severity_(severity) {}
 
+bool LogMessage::WithinRateLimit() const {
+  static int rate_limit = LogRateLimitFromEnv();
+  if (rate_limit <= 0) {
+    return true;
+  }
+
+  auto site = std::hash<const void*>()(fname_) * 31 + line_;
+  auto& slot = rate_limit_slots[site % LOG_RATE_LIMIT_SLOTS];
+  int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+  int64_t slot_second = slot.second.load(std::memory_order_relaxed);
+  if (slot_second != second &&
+      slot.second.compare_exchange_strong(slot_second, second)) {
+    slot.count = 0;
+  }
+  if (slot.count.fetch_add(1, std::memory_order_relaxed) < rate_limit) {
+    return true;
+  }
+  rate_limited_lines.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
 void LogMessage::GenerateLogMessage(bool log_time) {
   bool use_cout = static_cast<int>(severity_) <= static_cast<int>(LogLevel::INFO);
-  std::ostream& os = use_cout ? std::cout : std::cerr;
+  std::ostringstream os;
+  int64_t dropped = rate_limited_lines.load(std::memory_order_relaxed) > 0
+                        ? rate_limited_lines.exchange(0)
+                        : 0;
+  if (dropped > 0) {
+    os << "[" << LOG_LEVELS[static_cast<int>(LogLevel::WARNING)] << " "
+       << __FILE__ << ":" << __LINE__ << "] Dropped " << dropped
+       << " log lines over HOROVOD_LOG_RATE_LIMIT." << std::endl;
+  }
   if (log_time) {
     auto now = std::chrono::system_clock::now();
     auto as_time_t = std::chrono::system_clock::to_time_t(now);
@@ -33,12 +244,12 @@ void LogMessage::GenerateLogMessage(bool log_time) {
     os << "[" << LOG_LEVELS[static_cast<int>(severity_)] << " " 
               << fname_ << ":" << line_ << "] " << str() << std::endl;
   }
+  LogSink::Get().Write(use_cout, os.str());
 }
 
 LogMessage::~LogMessage() {
-  static LogLevel min_log_level = MinLogLevelFromEnv();
   static bool log_time = LogTimeFromEnv();
-  if (severity_ >= min_log_level) {
+  if (severity_ >= MinLogLevel() && WithinRateLimit()) {
     GenerateLogMessage(log_time);
   }
 }
@@ -49,9 +260,12 @@ LogMessageFatal::LogMessageFatal(const char* file, int line)
 LogMessageFatal::~LogMessageFatal() {
   static bool log_time = LogTimeFromEnv();
   GenerateLogMessage(log_time);
+  FlushLog();
   abort();
 }
 
+void FlushLog() { LogSink::Get().Flush(); }
+
 LogLevel ParseLogLevelStr(const char* env_var_val) {
   std::string min_log_level(env_var_val);
   std::transform(min_log_level.begin(), min_log_level.end(), min_log_level.begin(), ::tolower);
@@ -81,6 +295,11 @@ LogLevel MinLogLevelFromEnv() {
   return ParseLogLevelStr(env_var_val);
 }
 
+LogLevel MinLogLevel() {
+  static LogLevel min_log_level = MinLogLevelFromEnv();
+  return min_log_level;
+}
+
 bool LogTimeFromEnv() {
   const char* env_var_val = getenv("HOROVOD_LOG_HIDE_TIME");
   if (env_var_val != nullptr &&
@@ -20,6 +20,9 @@ class LogMessage : public std::basic_ostringstream<char> {
 
  protected:
   void GenerateLogMessage(bool log_time);
+  // Returns false if the line exceeds HOROVOD_LOG_RATE_LIMIT lines per
+  // second of its call site.
+  bool WithinRateLimit() const;
 
  private:
   const char* fname_;
@@ -48,9 +51,19 @@ class LogMessageFatal : public LogMessage {
 #define _HVD_LOG_FATAL \
   LogMessageFatal(__FILE__, __LINE__)
 
-#define _LOG(severity) _HVD_LOG_##severity
+// Turns the stream of a message into void, so that LOG() can skip building
+// messages below the minimum log level.
+class LogMessageVoidify {
+ public:
+  void operator&(const std::basic_ostream<char>&) {}
+};
+
+#define _LOG(severity)                                                        \
+  !(LogLevel::severity >= MinLogLevel())                                      \
+      ? (void)0                                                               \
+      : LogMessageVoidify() & _HVD_LOG_##severity
 
-#define _LOG_RANK(severity, rank) _HVD_LOG_##severity << "[" << rank << "]: "
+#define _LOG_RANK(severity, rank) _LOG(severity) << "[" << rank << "]: "
 
 #define GET_LOG(_1, _2, NAME, ...) NAME
 #define LOG(...) GET_LOG(__VA_ARGS__, _LOG_RANK, _LOG)(__VA_ARGS__)
@@ -58,6 +71,12 @@ class LogMessageFatal : public LogMessage {
 LogLevel MinLogLevelFromEnv();
 bool LogTimeFromEnv();
 
+// MinLogLevelFromEnv(), read once.
+LogLevel MinLogLevel();
+
+// Writes out the log lines queued with HOROVOD_LOG_ASYNC.
+void FlushLog();
+
 }
 }
 
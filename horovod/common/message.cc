@@ -57,6 +57,9 @@ const std::string& DataType_Name(DataType value) {
     case HOROVOD_BOOL:
       static const std::string bool_("bool");
       return bool_;
+    case HOROVOD_BFLOAT16:
+      static const std::string bfloat16("bfloat16");
+      return bfloat16;
     default:
       static const std::string unknown("<unknown>");
       return unknown;
@@ -85,6 +88,8 @@ std::size_t DataType_Size(DataType value) {
       return sizeof(double);
     case HOROVOD_BOOL:
       return sizeof(bool);
+    case HOROVOD_BFLOAT16:
+      return 2;
     default:
       throw std::logic_error("Type " + DataType_Name(value) +
                              " is not supported.");
@@ -111,6 +116,9 @@ const std::string& Request::RequestType_Name(RequestType value) {
     case RequestType::ALLTOALL:
       static const std::string alltoall("ALLTOALL");
       return alltoall;
+    case RequestType::REDUCESCATTER:
+      static const std::string reducescatter("REDUCESCATTER");
+      return reducescatter;
     default:
       static const std::string unknown("<unknown>");
       return unknown;
@@ -137,6 +145,10 @@ void Request::set_tensor_name(const std::string& value) {
   tensor_name_ = value;
 }
 
+void Request::set_tensor_name(std::string&& value) {
+  tensor_name_ = std::move(value);
+}
+
 int32_t Request::root_rank() const { return root_rank_; }
 
 void Request::set_root_rank(int32_t value) { root_rank_ = value; }
@@ -153,6 +165,18 @@ void Request::set_prescale_factor(const double prescale_factor) { prescale_facto
 
 void Request::set_postscale_factor(const double postscale_factor) { postscale_factor_ = postscale_factor; };
 
+int32_t Request::priority() const { return priority_; }
+
+void Request::set_priority(int32_t value) { priority_ = value; }
+
+int32_t Request::tensor_id() const { return tensor_id_; }
+
+void Request::set_tensor_id(int32_t value) { tensor_id_ = value; }
+
+int32_t Request::process_set_id() const { return process_set_id_; }
+
+void Request::set_process_set_id(int32_t value) { process_set_id_ = value; }
+
 const std::vector<int64_t>& Request::tensor_shape() const {
   return tensor_shape_;
 }
@@ -161,6 +185,10 @@ void Request::set_tensor_shape(const std::vector<int64_t>& value) {
   tensor_shape_ = value;
 }
 
+void Request::set_tensor_shape(std::vector<int64_t>&& value) {
+  tensor_shape_ = std::move(value);
+}
+
 void Request::add_tensor_shape(int64_t value) {
   tensor_shape_.push_back(value);
 }
@@ -172,33 +200,55 @@ void Request_ParseFromWire(Request& request,
   request.set_request_rank(obj->request_rank());
   request.set_request_type((Request::RequestType) obj->request_type());
   request.set_tensor_type((DataType) obj->tensor_type());
-  request.set_tensor_name(obj->tensor_name()->str());
+  // The name and shape are left out of requests that refer to a session ID.
+  if (obj->tensor_name() != nullptr) {
+    request.set_tensor_name(obj->tensor_name()->str());
+  }
   request.set_root_rank(obj->root_rank());
   request.set_device(obj->device());
-  request.set_tensor_shape(std::vector<int64_t>(obj->tensor_shape()->begin(),
-                                                obj->tensor_shape()->end()));
+  if (obj->tensor_shape() != nullptr) {
+    request.set_tensor_shape(std::vector<int64_t>(
+        obj->tensor_shape()->begin(), obj->tensor_shape()->end()));
+  }
   request.set_prescale_factor(obj->prescale_factor());
   request.set_postscale_factor(obj->postscale_factor());
+  request.set_priority(obj->priority());
+  request.set_tensor_id(obj->tensor_id());
+  request.set_process_set_id(obj->process_set_id());
 }
 
 void Request_SerializeToWire(const Request& request,
                              flatbuffers::FlatBufferBuilder& builder,
                              flatbuffers::Offset<wire::Request>& obj) {
+  // A request referring to a session ID leaves out the name and the shape.
+  bool refers_to_id = request.tensor_id() >= 0 && request.tensor_name().empty();
+
   // FlatBuffers must be built bottom-up.
-  auto tensor_name_wire = builder.CreateString(request.tensor_name());
-  auto tensor_shape_wire = builder.CreateVector(request.tensor_shape());
+  flatbuffers::Offset<flatbuffers::String> tensor_name_wire;
+  flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_shape_wire;
+  if (!refers_to_id) {
+    tensor_name_wire = builder.CreateString(request.tensor_name());
+    tensor_shape_wire = builder.CreateVector(request.tensor_shape());
+  }
 
   wire::RequestBuilder request_builder(builder);
   request_builder.add_request_rank(request.request_rank());
   request_builder.add_request_type(
       (wire::RequestType) request.request_type());
   request_builder.add_tensor_type((wire::DataType) request.tensor_type());
-  request_builder.add_tensor_name(tensor_name_wire);
+  if (!refers_to_id) {
+    request_builder.add_tensor_name(tensor_name_wire);
+  }
   request_builder.add_root_rank(request.root_rank());
   request_builder.add_device(request.device());
-  request_builder.add_tensor_shape(tensor_shape_wire);
+  if (!refers_to_id) {
+    request_builder.add_tensor_shape(tensor_shape_wire);
+  }
   request_builder.add_prescale_factor(request.prescale_factor());
   request_builder.add_postscale_factor(request.postscale_factor());
+  request_builder.add_priority(request.priority());
+  request_builder.add_tensor_id(request.tensor_id());
+  request_builder.add_process_set_id(request.process_set_id());
   obj = request_builder.Finish();
 }
 
@@ -218,7 +268,7 @@ void Request::SerializeToString(const Request& request,
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 const std::vector<Request>& RequestList::requests() const {
@@ -233,23 +283,19 @@ bool RequestList::shutdown() const { return shutdown_; }
 
 void RequestList::set_shutdown(bool value) { shutdown_ = value; }
 
+std::vector<Request>& RequestList::mutable_requests() { return requests_; }
+
 void RequestList::add_request(const Request& value) {
   requests_.push_back(value);
 }
 
 void RequestList::emplace_request(Request&& value) {
-  requests_.emplace_back(value);
+  requests_.emplace_back(std::move(value));
 }
 
 void RequestList::ParseFromBytes(RequestList& request_list,
                                  const uint8_t* input) {
-  auto obj = flatbuffers::GetRoot<wire::RequestList>(input);
-  for (const auto& req_obj : *obj->requests()) {
-    Request request;
-    Request_ParseFromWire(request, req_obj);
-    request_list.emplace_request(std::move(request));
-  }
-  request_list.set_shutdown(obj->shutdown());
+  RequestListView(input).ParseRequestList(request_list);
 }
 
 void RequestList::SerializeToString(const RequestList& request_list,
@@ -273,7 +319,43 @@ void RequestList::SerializeToString(const RequestList& request_list,
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
+}
+
+RequestListView::RequestListView(const uint8_t* input)
+    : list_(flatbuffers::GetRoot<wire::RequestList>(input)) {}
+
+int RequestListView::size() const {
+  if (list_ == nullptr) {
+    return 0;
+  }
+  return (int)static_cast<const wire::RequestList*>(list_)->requests()->size();
+}
+
+bool RequestListView::shutdown() const {
+  return list_ != nullptr &&
+         static_cast<const wire::RequestList*>(list_)->shutdown();
+}
+
+Request::RequestType RequestListView::request_type(int index) const {
+  auto obj = static_cast<const wire::RequestList*>(list_)->requests()->Get(index);
+  return (Request::RequestType)obj->request_type();
+}
+
+void RequestListView::ParseRequest(int index, Request& request) const {
+  Request_ParseFromWire(
+      request, static_cast<const wire::RequestList*>(list_)->requests()->Get(index));
+}
+
+void RequestListView::ParseRequestList(RequestList& request_list) const {
+  int count = size();
+  request_list.mutable_requests().reserve(request_list.requests().size() + count);
+  for (int i = 0; i < count; ++i) {
+    Request request;
+    ParseRequest(i, request);
+    request_list.emplace_request(std::move(request));
+  }
+  request_list.set_shutdown(shutdown());
 }
 
 const std::string& Response::ResponseType_Name(ResponseType value) {
@@ -296,6 +378,9 @@ const std::string& Response::ResponseType_Name(ResponseType value) {
     case ResponseType::ALLTOALL:
       static const std::string alltoall("ALLTOALL");
       return alltoall;
+    case ResponseType::REDUCESCATTER:
+      static const std::string reducescatter("REDUCESCATTER");
+      return reducescatter;
     case ResponseType::ERROR:
       static const std::string error("ERROR");
       return error;
@@ -339,6 +424,10 @@ void Response::set_tensor_names(const std::vector<std::string>& value) {
   tensor_names_ = value;
 }
 
+void Response::set_tensor_names(std::vector<std::string>&& value) {
+  tensor_names_ = std::move(value);
+}
+
 void Response::add_tensor_name(const std::string& value) {
   tensor_names_.push_back(value);
 }
@@ -347,6 +436,18 @@ void Response::add_tensor_name(std::string&& value) {
   tensor_names_.push_back(std::move(value));
 }
 
+void Response::reserve_tensors(size_t count) {
+  tensor_names_.reserve(count);
+  tensor_sizes_.reserve(count);
+}
+
+void Response::add_fused_response(Response&& response) {
+  assert(response.tensor_names_.size() == 1);
+  tensor_names_.push_back(std::move(response.tensor_names_[0]));
+  tensor_sizes_.insert(tensor_sizes_.end(), response.tensor_sizes_.begin(),
+                       response.tensor_sizes_.end());
+}
+
 const std::string& Response::error_message() const { return error_message_; }
 
 void Response::set_error_message(const std::string& value) {
@@ -359,6 +460,10 @@ void Response::set_devices(const std::vector<int32_t>& value) {
   devices_ = value;
 }
 
+void Response::set_devices(std::vector<int32_t>&& value) {
+  devices_ = std::move(value);
+}
+
 void Response::add_device(int32_t value) { devices_.push_back(value); }
 
 const std::vector<int64_t>& Response::tensor_sizes() const {
@@ -369,6 +474,10 @@ void Response::set_tensor_sizes(const std::vector<int64_t>& value) {
   tensor_sizes_ = value;
 }
 
+void Response::set_tensor_sizes(std::vector<int64_t>&& value) {
+  tensor_sizes_ = std::move(value);
+}
+
 void Response::add_tensor_size(int64_t value) {
   tensor_sizes_.push_back(value);
 }
@@ -383,6 +492,12 @@ void Response::add_allgather_response(const Response& response) {
   }
 }
 
+void Response::add_allgather_response(Response&& response) {
+  assert(response_type() == Response::ResponseType::ALLGATHER);
+  assert(response.devices() == devices());
+  add_fused_response(std::move(response));
+}
+
 double Response::prescale_factor() const { return prescale_factor_; };
 
 double Response::postscale_factor() const { return postscale_factor_; };
@@ -391,9 +506,30 @@ void Response::set_prescale_factor(const double prescale_factor) { prescale_fact
 
 void Response::set_postscale_factor(const double postscale_factor) { postscale_factor_ = postscale_factor; };
 
+int32_t Response::priority() const { return priority_; }
+
+void Response::set_priority(int32_t value) { priority_ = value; }
+
+const std::vector<int32_t>& Response::tensor_ids() const { return tensor_ids_; }
+
+void Response::set_tensor_ids(const std::vector<int32_t>& value) {
+  tensor_ids_ = value;
+}
+
+void Response::set_tensor_ids(std::vector<int32_t>&& value) {
+  tensor_ids_ = std::move(value);
+}
+
+void Response::add_tensor_id(int32_t value) { tensor_ids_.push_back(value); }
+
+int32_t Response::process_set_id() const { return process_set_id_; }
+
+void Response::set_process_set_id(int32_t value) { process_set_id_ = value; }
+
 void Response_ParseFromWire(Response& response,
                             const wire::Response* obj) {
   response.set_response_type((Response::ResponseType) obj->response_type());
+  response.reserve_tensors(obj->tensor_names()->size());
   for (const auto& tensor_name_obj : *obj->tensor_names()) {
     response.add_tensor_name(tensor_name_obj->str());
   }
@@ -405,9 +541,14 @@ void Response_ParseFromWire(Response& response,
                                                  obj->tensor_sizes()->end()));
   response.set_prescale_factor(obj->prescale_factor());
   response.set_postscale_factor(obj->postscale_factor());
+  response.set_priority(obj->priority());
+  if (obj->tensor_ids() != nullptr) {
+    response.set_tensor_ids(std::vector<int32_t>(obj->tensor_ids()->begin(),
+                                                 obj->tensor_ids()->end()));
+  }
+  response.set_process_set_id(obj->process_set_id());
   // lyz - alloc
-  response.block_num = obj->block_num();
-  response.thread_num = obj->thread_num();
+  response.libra_allocation = obj->libra_allocation();
 }
 
 void Response::ParseFromBytes(Response& response, const uint8_t* input) {
@@ -424,6 +565,10 @@ void Response_SerializeToWire(const Response& response,
   auto error_message_wire = builder.CreateString(response.error_message());
   auto devices_wire = builder.CreateVector(response.devices());
   auto tensor_sizes_wire = builder.CreateVector(response.tensor_sizes());
+  flatbuffers::Offset<flatbuffers::Vector<int32_t>> tensor_ids_wire;
+  if (!response.tensor_ids().empty()) {
+    tensor_ids_wire = builder.CreateVector(response.tensor_ids());
+  }
 
   wire::ResponseBuilder response_builder(builder);
   response_builder.add_response_type(
@@ -436,9 +581,13 @@ void Response_SerializeToWire(const Response& response,
   response_builder.add_tensor_sizes(tensor_sizes_wire);
   response_builder.add_prescale_factor(response.prescale_factor());
   response_builder.add_postscale_factor(response.postscale_factor());
+  response_builder.add_priority(response.priority());
+  if (!response.tensor_ids().empty()) {
+    response_builder.add_tensor_ids(tensor_ids_wire);
+  }
+  response_builder.add_process_set_id(response.process_set_id());
   // lyz - alloc
-  response_builder.add_block_num(response.block_num);
-  response_builder.add_thread_num(response.thread_num);
+  response_builder.add_libra_allocation(response.libra_allocation);
   obj = response_builder.Finish();
 }
 
@@ -451,13 +600,15 @@ void Response::SerializeToString(const Response& response,
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 const std::vector<Response>& ResponseList::responses() const {
   return responses_;
 }
 
+std::vector<Response>& ResponseList::mutable_responses() { return responses_; }
+
 void ResponseList::set_responses(const std::vector<Response>& value) {
   responses_ = value;
 }
@@ -466,6 +617,32 @@ bool ResponseList::shutdown() const { return shutdown_; }
 
 void ResponseList::set_shutdown(bool value) { shutdown_ = value; }
 
+int32_t ResponseList::fusion_group_id() const { return fusion_group_id_; }
+
+void ResponseList::set_fusion_group_id(int32_t value) {
+  fusion_group_id_ = value;
+}
+
+int32_t ResponseList::cpu_fusion_group_id() const {
+  return cpu_fusion_group_id_;
+}
+
+void ResponseList::set_cpu_fusion_group_id(int32_t value) {
+  cpu_fusion_group_id_ = value;
+}
+
+const std::string& ResponseList::parameters() const { return parameters_; }
+
+void ResponseList::set_parameters(const std::string& value) {
+  parameters_ = value;
+}
+
+const std::string& ResponseList::libra_plan() const { return libra_plan_; }
+
+void ResponseList::set_libra_plan(const std::string& value) {
+  libra_plan_ = value;
+}
+
 void ResponseList::add_response(const Response& value) {
   responses_.push_back(value);
 }
@@ -475,18 +652,31 @@ void ResponseList::add_response(Response&& value) {
 }
 
 void ResponseList::emplace_response(Response&& value) {
-  responses_.emplace_back(value);
+  responses_.emplace_back(std::move(value));
 }
 
 void ResponseList::ParseFromBytes(ResponseList& response_list,
                                   const uint8_t* input) {
   auto obj = flatbuffers::GetRoot<wire::ResponseList>(input);
+  response_list.mutable_responses().reserve(obj->responses()->size());
   for (const auto& resp_obj : *obj->responses()) {
     Response response;
     Response_ParseFromWire(response, resp_obj);
     response_list.emplace_response(std::move(response));
   }
   response_list.set_shutdown(obj->shutdown());
+  response_list.set_fusion_group_id(obj->fusion_group_id());
+  response_list.set_cpu_fusion_group_id(obj->cpu_fusion_group_id());
+  if (obj->parameters() != nullptr) {
+    response_list.set_parameters(
+        std::string((const char*)obj->parameters()->data(),
+                    obj->parameters()->size()));
+  }
+  if (obj->libra_plan() != nullptr) {
+    response_list.set_libra_plan(
+        std::string((const char*)obj->libra_plan()->data(),
+                    obj->libra_plan()->size()));
+  }
 }
 
 void ResponseList::SerializeToString(const ResponseList& response_list,
@@ -501,16 +691,32 @@ void ResponseList::SerializeToString(const ResponseList& response_list,
     responses.push_back(resp_obj);
   }
   auto responses_wire = builder.CreateVector(responses);
+  auto& parameters = response_list.parameters();
+  auto parameters_wire = builder.CreateVector(
+      (const uint8_t*)parameters.data(), parameters.size());
+  flatbuffers::Offset<flatbuffers::Vector<uint8_t>> libra_plan_wire;
+  auto& libra_plan = response_list.libra_plan();
+  if (!libra_plan.empty()) {
+    libra_plan_wire = builder.CreateVector((const uint8_t*)libra_plan.data(),
+                                           libra_plan.size());
+  }
 
   wire::ResponseListBuilder response_list_builder(builder);
   response_list_builder.add_responses(responses_wire);
   response_list_builder.add_shutdown(response_list.shutdown());
+  response_list_builder.add_fusion_group_id(response_list.fusion_group_id());
+  response_list_builder.add_cpu_fusion_group_id(
+      response_list.cpu_fusion_group_id());
+  response_list_builder.add_parameters(parameters_wire);
+  if (!libra_plan.empty()) {
+    response_list_builder.add_libra_plan(libra_plan_wire);
+  }
   auto obj = response_list_builder.Finish();
   builder.Finish(obj);
 
   uint8_t* buf = builder.GetBufferPointer();
   auto size = builder.GetSize();
-  output = std::string((char*) buf, size);
+  output.assign((char*) buf, size);
 }
 
 } // namespace common
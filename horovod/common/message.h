@@ -36,6 +36,7 @@ enum DataType {
   HOROVOD_FLOAT32 = 7,
   HOROVOD_FLOAT64 = 8,
   HOROVOD_BOOL = 9,
+  HOROVOD_BFLOAT16 = 10,
 };
 
 const std::string& DataType_Name(DataType value);
@@ -48,7 +49,8 @@ std::size_t DataType_Size(DataType value);
 class Request {
 public:
   enum RequestType {
-    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, JOIN = 3, ADASUM = 4, ALLTOALL = 5
+    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, JOIN = 3, ADASUM = 4, ALLTOALL = 5,
+    REDUCESCATTER = 6
   };
 
 
@@ -73,6 +75,8 @@ public:
 
   void set_tensor_name(const std::string& value);
 
+  void set_tensor_name(std::string&& value);
+
   int32_t root_rank() const;
 
   void set_root_rank(int32_t value);
@@ -85,6 +89,8 @@ public:
 
   void set_tensor_shape(const std::vector<int64_t>& value);
 
+  void set_tensor_shape(std::vector<int64_t>&& value);
+
   void add_tensor_shape(int64_t value);
 
   double prescale_factor() const;
@@ -95,6 +101,21 @@ public:
 
   void set_postscale_factor(const double postscale_factor);
 
+  // Scheduling priority, lower values are reduced first.
+  int32_t priority() const;
+
+  void set_priority(int32_t value);
+
+  // Session ID of the tensor name and shape, -1 if not used, see WireSession.
+  int32_t tensor_id() const;
+
+  void set_tensor_id(int32_t value);
+
+  // Process set of the collective, 0 for all ranks, see ProcessSetTable.
+  int32_t process_set_id() const;
+
+  void set_process_set_id(int32_t value);
+
   static void ParseFromBytes(Request& request, const uint8_t* input);
 
   static void SerializeToString(const Request& request, std::string& output);
@@ -114,12 +135,17 @@ private:
   std::vector<int64_t> tensor_shape_;
   double prescale_factor_ = 1.0;
   double postscale_factor_ = 1.0;
+  int32_t priority_ = 0;
+  int32_t tensor_id_ = -1;
+  int32_t process_set_id_ = 0;
 };
 
 class RequestList {
 public:
   const std::vector<Request>& requests() const;
 
+  std::vector<Request>& mutable_requests();
+
   void set_requests(const std::vector<Request>& value);
 
   void add_request(const Request& value);
@@ -141,6 +167,33 @@ private:
   bool shutdown_ = false;
 };
 
+// Reads a serialized RequestList in place. Requests are only copied out of
+// the bytes by ParseRequest, so that the coordinator materializes each of them
+// once, right into its message table, and skips the ones it does not keep.
+// The bytes must outlive the view. A default constructed view is empty.
+class RequestListView {
+public:
+  RequestListView() = default;
+
+  explicit RequestListView(const uint8_t* input);
+
+  int size() const;
+
+  bool shutdown() const;
+
+  Request::RequestType request_type(int index) const;
+
+  // Copies the request at index into request.
+  void ParseRequest(int index, Request& request) const;
+
+  // Copies all requests, like RequestList::ParseFromBytes.
+  void ParseRequestList(RequestList& request_list) const;
+
+private:
+  // A wire::RequestList, kept opaque to not include the generated header.
+  const void* list_ = nullptr;
+};
+
 // A Response is a message sent from the coordinator (rank zero) to a rank
 // greater than zero, informing the rank of an operation should be performed
 // now. If the operation requested would result in an error (for example, due
@@ -149,7 +202,8 @@ private:
 class Response {
 public:
   enum ResponseType {
-    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, JOIN = 3, ADASUM = 4, ALLTOALL= 5, ERROR = 6
+    ALLREDUCE = 0, ALLGATHER = 1, BROADCAST = 2, JOIN = 3, ADASUM = 4, ALLTOALL= 5,
+    REDUCESCATTER = 6, ERROR = 7
   };
 
   static const std::string& ResponseType_Name(ResponseType value);
@@ -169,10 +223,19 @@ public:
 
   void set_tensor_names(const std::vector<std::string>& value);
 
+  void set_tensor_names(std::vector<std::string>&& value);
+
   void add_tensor_name(const std::string& value);
 
   void add_tensor_name(std::string&& value);
 
+  // Reserve room for the names and sizes of count fused tensors.
+  void reserve_tensors(size_t count);
+
+  // Appends the name and sizes of a single tensor response, moving the name
+  // out of it.
+  void add_fused_response(Response&& response);
+
   // Empty unless response_type is ERROR.
   const std::string& error_message() const;
 
@@ -182,6 +245,8 @@ public:
 
   void set_devices(const std::vector<int32_t>& value);
 
+  void set_devices(std::vector<int32_t>&& value);
+
   void add_device(int32_t value);
 
   // Empty unless response_type is ALLGATHER.
@@ -191,11 +256,15 @@ public:
 
   void set_tensor_sizes(const std::vector<int64_t>& value);
 
+  void set_tensor_sizes(std::vector<int64_t>&& value);
+
   void add_tensor_size(int64_t value);
 
   // To fuse multiple allgather responses
   void add_allgather_response(const Response& response);
 
+  void add_allgather_response(Response&& response);
+
   double prescale_factor() const;
 
   double postscale_factor() const;
@@ -204,14 +273,44 @@ public:
 
   void set_postscale_factor(const double postscale_factor);
 
+  // Lowest priority of the requests fused into this response.
+  int32_t priority() const;
+
+  void set_priority(int32_t value);
+
+  // Session IDs of the tensor names, empty if not used, see WireSession.
+  const std::vector<int32_t>& tensor_ids() const;
+
+  void set_tensor_ids(const std::vector<int32_t>& value);
+
+  void set_tensor_ids(std::vector<int32_t>&& value);
+
+  void add_tensor_id(int32_t value);
+
+  // Process set of the collective, 0 for all ranks. The devices are indexed
+  // by the position of the ranks in the set.
+  int32_t process_set_id() const;
+
+  void set_process_set_id(int32_t value);
+
   static void ParseFromBytes(Response& response, const uint8_t* input);
 
   static void SerializeToString(const Response& response,
                                 std::string& output);
   
   // lyz - alloc
+  // Index of the launch configuration in the Libra plan, the only part of it
+  // sent on the wire. The fields below are resolved from the plan.
+  int32_t libra_allocation = 0;
   int32_t block_num; //number of blocks(channels) to allocate to the corresponding allreduce kernel
   int32_t thread_num; //number of threads for each block
+  // Blocks and threads of the second part of a split group, which is
+  // reduced concurrently on its own stream. 0 if the group is not split.
+  int32_t split_block_num = 0;
+  int32_t split_thread_num = 0;
+  // Communicators of the allreduce, the 1-based index of one of the
+  // HOROVOD_LIBRA_NCCL_TUNINGS, 0 for the default ones.
+  int32_t nccl_tuning = 0;
 
 private:
   ResponseType response_type_ = ResponseType::ALLREDUCE;
@@ -222,12 +321,17 @@ private:
   std::vector<int64_t> tensor_sizes_;
   double prescale_factor_ = 1.0;
   double postscale_factor_ = 1.0;
+  int32_t priority_ = 0;
+  std::vector<int32_t> tensor_ids_;
+  int32_t process_set_id_ = 0;
 };
 
 class ResponseList {
 public:
   const std::vector<Response>& responses() const;
 
+  std::vector<Response>& mutable_responses();
+
   void set_responses(const std::vector<Response>& value);
 
   void add_response(const Response& value);
@@ -240,6 +344,29 @@ public:
 
   void set_shutdown(bool value);
 
+  // lyz - alloc
+  int32_t fusion_group_id() const;
+
+  void set_fusion_group_id(int32_t value);
+
+  // Fusion group of CPU tensors the coordinator fills next, see
+  // Controller::PopCpuFusionGroup.
+  int32_t cpu_fusion_group_id() const;
+
+  void set_cpu_fusion_group_id(int32_t value);
+
+  // Bytes of the autotuned parameters sent along by the coordinator, empty
+  // if they did not change.
+  const std::string& parameters() const;
+
+  void set_parameters(const std::string& value);
+
+  // Bytes of the Libra plan sent along by the coordinator, empty if it did
+  // not change.
+  const std::string& libra_plan() const;
+
+  void set_libra_plan(const std::string& value);
+
   static void ParseFromBytes(ResponseList& response_list,
                              const uint8_t* input);
 
@@ -249,6 +376,10 @@ public:
 private:
   std::vector<Response> responses_;
   bool shutdown_ = false;
+  int32_t fusion_group_id_ = 0;
+  int32_t cpu_fusion_group_id_ = 0;
+  std::string parameters_;
+  std::string libra_plan_;
 };
 
 } // namespace common
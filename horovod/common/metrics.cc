@@ -0,0 +1,158 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace horovod {
+namespace common {
+
+Histogram::Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)) {
+  std::sort(bounds_.begin(), bounds_.end());
+  buckets_.reset(new std::atomic<int64_t>[bounds_.size() + 1]);
+  for (size_t i = 0; i <= bounds_.size(); ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::Observe(double value) {
+  auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) -
+                bounds_.begin();
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  double sum = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(sum, sum + value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+std::vector<int64_t> Histogram::BucketCounts() const {
+  std::vector<int64_t> counts(bounds_.size() + 1);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+Counter& MetricsRegistry::AddCounter(const std::string& name,
+                                     const std::string& help) {
+  Entry entry;
+  entry.name = name;
+  entry.help = help;
+  entry.counter.reset(new Counter());
+  entries_.push_back(std::move(entry));
+  return *entries_.back().counter;
+}
+
+Gauge& MetricsRegistry::AddGauge(const std::string& name,
+                                 const std::string& help) {
+  Entry entry;
+  entry.name = name;
+  entry.help = help;
+  entry.gauge.reset(new Gauge());
+  entries_.push_back(std::move(entry));
+  return *entries_.back().gauge;
+}
+
+Histogram& MetricsRegistry::AddHistogram(const std::string& name,
+                                         const std::string& help,
+                                         std::vector<double> bounds) {
+  Entry entry;
+  entry.name = name;
+  entry.help = help;
+  entry.histogram.reset(new Histogram(std::move(bounds)));
+  entries_.push_back(std::move(entry));
+  return *entries_.back().histogram;
+}
+
+std::string MetricsRegistry::ToPrometheusText() const {
+  std::ostringstream text;
+  // Enough digits to print byte bounds exactly.
+  text.precision(12);
+  for (auto& entry : entries_) {
+    text << "# HELP " << entry.name << " " << entry.help << "\n";
+    if (entry.counter != nullptr) {
+      text << "# TYPE " << entry.name << " counter\n"
+           << entry.name << " " << entry.counter->Value() << "\n";
+    } else if (entry.gauge != nullptr) {
+      text << "# TYPE " << entry.name << " gauge\n"
+           << entry.name << " " << entry.gauge->Value() << "\n";
+    } else {
+      auto& histogram = *entry.histogram;
+      text << "# TYPE " << entry.name << " histogram\n";
+      // Buckets are exported cumulative, as Prometheus expects.
+      auto counts = histogram.BucketCounts();
+      int64_t cumulative = 0;
+      for (size_t i = 0; i < histogram.bounds().size(); ++i) {
+        cumulative += counts[i];
+        text << entry.name << "_bucket{le=\"" << histogram.bounds()[i]
+             << "\"} " << cumulative << "\n";
+      }
+      cumulative += counts.back();
+      text << entry.name << "_bucket{le=\"+Inf\"} " << cumulative << "\n"
+           << entry.name << "_sum " << histogram.Sum() << "\n"
+           << entry.name << "_count " << histogram.Count() << "\n";
+    }
+  }
+  return text.str();
+}
+
+HorovodMetrics::HorovodMetrics()
+    : cycle_time_seconds(registry.AddHistogram(
+          "horovod_cycle_time_seconds",
+          "Duration of a background thread cycle.",
+          {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1})),
+      negotiation_time_seconds(registry.AddHistogram(
+          "horovod_negotiation_time_seconds",
+          "Time spent negotiating the responses of a cycle.",
+          {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.05, 0.1,
+           1})),
+      response_cache_hits(registry.AddCounter(
+          "horovod_response_cache_hits_total",
+          "Requests found in the response cache.")),
+      response_cache_misses(registry.AddCounter(
+          "horovod_response_cache_misses_total",
+          "Requests not found in the response cache.")),
+      fused_response_bytes(registry.AddHistogram(
+          "horovod_fused_response_bytes",
+          "Total size of the tensors of a performed response.",
+          {1 << 10, 1 << 14, 1 << 16, 1 << 18, 1 << 20, 1 << 22, 1 << 24,
+           1 << 26, 1 << 28})),
+      fusion_group_fill_seconds(registry.AddHistogram(
+          "horovod_fusion_group_fill_seconds",
+          "Time from the first tensor joining a fusion group to the group "
+          "being sent.",
+          {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1})),
+      gpu_ops_in_flight(registry.AddGauge(
+          "horovod_gpu_ops_in_flight",
+          "GPU operations enqueued on a stream and not finalized yet.")),
+      fusion_buffer_bytes(registry.AddGauge(
+          "horovod_fusion_buffer_bytes",
+          "Bytes of the fusion buffers allocated.")),
+      nccl_kernel_seconds(registry.AddHistogram(
+          "horovod_nccl_kernel_seconds",
+          "Duration of the NCCL kernel of a fusion group.",
+          {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+           0.1})),
+      nccl_kernel_overlap(registry.AddHistogram(
+          "horovod_nccl_kernel_overlap",
+          "Fraction of the duration of the NCCL kernel of a fusion group that "
+          "ran next to other kernels.",
+          {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1})) {}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,137 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_METRICS_H
+#define HOROVOD_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// A monotonically increasing count.
+class Counter {
+public:
+  Counter() = default;
+  Counter(const Counter&) = delete;
+
+  void Increment(int64_t value = 1) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+  int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> value_{0};
+};
+
+// A value that can go up and down.
+class Gauge {
+public:
+  Gauge() = default;
+  Gauge(const Gauge&) = delete;
+
+  void Add(int64_t value) { value_.fetch_add(value, std::memory_order_relaxed); }
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> value_{0};
+};
+
+// Counts observations into buckets with fixed upper bounds, plus one bucket
+// for everything above the last bound.
+class Histogram {
+public:
+  explicit Histogram(std::vector<double> bounds);
+  Histogram(const Histogram&) = delete;
+
+  void Observe(double value);
+
+  const std::vector<double>& bounds() const { return bounds_; }
+  // Returns the number of observations in each bucket, not cumulative, the
+  // last one is the overflow bucket.
+  std::vector<int64_t> BucketCounts() const;
+  int64_t Count() const { return count_.load(std::memory_order_relaxed); }
+  double Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+  std::vector<double> bounds_;
+  std::unique_ptr<std::atomic<int64_t>[]> buckets_;
+  std::atomic<int64_t> count_{0};
+  std::atomic<double> sum_{0};
+};
+
+// Owns named metrics and exports them in the Prometheus text exposition
+// format. Metrics are added once at start-up and updated without locks.
+class MetricsRegistry {
+public:
+  MetricsRegistry() = default;
+  MetricsRegistry(const MetricsRegistry&) = delete;
+
+  Counter& AddCounter(const std::string& name, const std::string& help);
+  Gauge& AddGauge(const std::string& name, const std::string& help);
+  Histogram& AddHistogram(const std::string& name, const std::string& help,
+                          std::vector<double> bounds);
+
+  std::string ToPrometheusText() const;
+
+private:
+  struct Entry {
+    std::string name;
+    std::string help;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  std::vector<Entry> entries_;
+};
+
+// The metrics updated by the background thread on every cycle.
+struct HorovodMetrics {
+  HorovodMetrics();
+  HorovodMetrics(const HorovodMetrics&) = delete;
+
+  MetricsRegistry registry;
+
+  // Duration of a whole background thread cycle, including the sleep.
+  Histogram& cycle_time_seconds;
+  // Duration of ComputeResponseList.
+  Histogram& negotiation_time_seconds;
+  // Requests found and not found in the response cache.
+  Counter& response_cache_hits;
+  Counter& response_cache_misses;
+  // Total size of the tensors of each performed response.
+  Histogram& fused_response_bytes;
+  // Time from the first tensor joining a fusion group to the group being sent.
+  Histogram& fusion_group_fill_seconds;
+  // GPU operations enqueued on a stream and not finalized yet.
+  Gauge& gpu_ops_in_flight;
+  // Bytes of the fusion buffers allocated, updated when the metrics are read.
+  Gauge& fusion_buffer_bytes;
+  // Duration of the NCCL kernels of the fusion groups, and the fraction of it
+  // that ran next to other kernels, with HOROVOD_LIBRA_KERNEL_FEEDBACK.
+  Histogram& nccl_kernel_seconds;
+  Histogram& nccl_kernel_overlap;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_METRICS_H
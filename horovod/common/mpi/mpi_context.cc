@@ -20,9 +20,14 @@
 #include <memory>
 #include <vector>
 
+#if defined(OPEN_MPI)
+#include <mpi-ext.h>
+#endif
+
 #include "../common.h"
 #include "../half.h"
 #include "../logging.h"
+#include "../utils/env_parser.h"
 
 namespace horovod {
 namespace common {
@@ -53,6 +58,8 @@ MPI_Datatype MPIContext::GetMPIDataType(const DataType dtype) {
     return MPI_DOUBLE;
   case HOROVOD_BOOL:
     return MPI_C_BOOL;
+  case HOROVOD_BFLOAT16:
+    return mpi_bfloat16_t;
   default:
     throw std::logic_error("Type " + DataType_Name(dtype) +
                            " is not supported in MPI mode.");
@@ -60,7 +67,14 @@ MPI_Datatype MPIContext::GetMPIDataType(const DataType dtype) {
 }
 
 MPI_Op MPIContext::GetMPISumOp(DataType dtype) {
-  return dtype == HOROVOD_FLOAT16 ? mpi_float16_sum : MPI_SUM;
+  switch (dtype) {
+  case HOROVOD_FLOAT16:
+    return mpi_float16_sum;
+  case HOROVOD_BFLOAT16:
+    return mpi_bfloat16_sum;
+  default:
+    return MPI_SUM;
+  }
 }
 
 MPI_Comm MPIContext::GetMPICommunicator(Communicator comm) {
@@ -77,6 +91,15 @@ MPI_Comm MPIContext::GetMPICommunicator(Communicator comm) {
   }
 }
 
+void MPIContext::FreeProcessSetCommunicators() {
+  for (auto& comm : process_set_comms) {
+    if (comm != MPI_COMM_NULL) {
+      MPI_Comm_free(&comm);
+    }
+  }
+  process_set_comms.clear();
+}
+
 int MPIContext::GetMPITypeSize(DataType dtype) {
   int out;
   MPI_Type_size(GetMPIDataType(dtype), &out);
@@ -107,9 +130,9 @@ void MPIContext::Initialize(const std::vector<int>& ranks,
     required = MPI_THREAD_SINGLE;
   }
   int is_mpi_initialized = 0;
+  int provided;
   MPI_Initialized(&is_mpi_initialized);
   if (is_mpi_initialized) {
-    int provided;
     MPI_Query_thread(&provided);
     if (provided < MPI_THREAD_MULTIPLE) {
       LOG(WARNING)
@@ -121,7 +144,9 @@ void MPIContext::Initialize(const std::vector<int>& ranks,
     // MPI environment has not been created, using manager to initialize.
     ctx_manager.EnvInitialize(required);
     should_finalize = true;
+    MPI_Query_thread(&provided);
   }
+  thread_multiple = provided == MPI_THREAD_MULTIPLE;
 
   if (!ranks.empty()) {
     MPI_Group world_group;
@@ -143,6 +168,11 @@ void MPIContext::Initialize(const std::vector<int>& ranks,
     MPI_Comm_dup(MPI_COMM_WORLD, &mpi_comm);
   }
 
+  control_comm = MPI_COMM_NULL;
+  if (GetBoolEnvOrDefault(HOROVOD_MPI_CONTROL_COMM, true)) {
+    MPI_Comm_dup(mpi_comm, &control_comm);
+  }
+
   // Create local comm, Determine local rank by querying the local communicator.
   MPI_Comm_split_type(mpi_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
                       &local_comm);
@@ -161,12 +191,35 @@ void MPIContext::Initialize(const std::vector<int>& ranks,
 
   // Create custom MPI float16 summation op.
   MPI_Op_create(&float16_sum, 1, &mpi_float16_sum);
+
+  // Create custom MPI bfloat16 data type and summation op.
+  MPI_Type_contiguous(2, MPI_BYTE, &mpi_bfloat16_t);
+  MPI_Type_commit(&mpi_bfloat16_t);
+  MPI_Op_create(&bfloat16_sum, 1, &mpi_bfloat16_sum);
+
+  cuda_aware = false;
+#if HAVE_CUDA && defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+  cuda_aware = MPIX_Query_cuda_support() == 1;
+#endif
+  cuda_aware = GetBoolEnvOrDefault(HOROVOD_MPI_CUDA_AWARE, cuda_aware);
+  LOG(DEBUG) << "MPI " << (cuda_aware ? "is" : "is not")
+             << " CUDA-aware.";
 }
 
 void MPIContext::Finalize(MPIContextManager& ctx_manager) {
   if (!enabled_) {
     return;
   }
+  if (allreduce_window != MPI_WIN_NULL) {
+    MPI_Win_free(&allreduce_window);
+  }
+
+  FreeProcessSetCommunicators();
+
+  if (control_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&control_comm);
+  }
+
   if (mpi_comm != MPI_COMM_NULL && mpi_comm != MPI_COMM_WORLD) {
     MPI_Comm_free(&mpi_comm);
   }
@@ -187,6 +240,14 @@ void MPIContext::Finalize(MPIContextManager& ctx_manager) {
     MPI_Op_free(&mpi_float16_sum);
   }
 
+  if (mpi_bfloat16_t != MPI_DATATYPE_NULL) {
+    MPI_Type_free(&mpi_bfloat16_t);
+  }
+
+  if (mpi_bfloat16_sum != MPI_OP_NULL) {
+    MPI_Op_free(&mpi_bfloat16_sum);
+  }
+
   if (should_finalize) {
     ctx_manager.EnvFinalize();
   }
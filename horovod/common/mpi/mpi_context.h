@@ -64,8 +64,34 @@ struct MPIContext {
 
   MPI_Comm GetMPICommunicator(Communicator comm);
 
+  // The communicator of the process set, mpi_comm for 0, MPI_COMM_NULL on
+  // ranks outside the set.
+  MPI_Comm GetProcessSetCommunicator(int32_t process_set_id) const {
+    return process_set_id == 0 ? mpi_comm
+                               : process_set_comms[process_set_id - 1];
+  }
+
+  void FreeProcessSetCommunicators();
+
+  // The communicator of the negotiation, mpi_comm without control_comm.
+  MPI_Comm GetMPIControlCommunicator() const {
+    return control_comm != MPI_COMM_NULL ? control_comm : mpi_comm;
+  }
+
+  // Whether data operations on mpi_comm can run on the execution thread
+  // while the background thread negotiates on control_comm.
+  bool SeparatesControl() const {
+    return control_comm != MPI_COMM_NULL && thread_multiple;
+  }
+
   int GetMPITypeSize(DataType dtype);
 
+  // Whether buffers of this type can be reduced in device memory. The
+  // reduction ops of the custom types run on the host.
+  bool ReducesOnDevice(DataType dtype) const {
+    return cuda_aware && dtype != HOROVOD_FLOAT16 && dtype != HOROVOD_BFLOAT16;
+  }
+
   // Flag indicating whether mpi is enabled.
   bool enabled_ = false;
 
@@ -73,6 +99,10 @@ struct MPIContext {
   MPI_Datatype mpi_float16_t;
   MPI_Op mpi_float16_sum;
 
+  // MPI custom data type for bfloat16.
+  MPI_Datatype mpi_bfloat16_t;
+  MPI_Op mpi_bfloat16_sum;
+
   // Private MPI communicator for Horovod to ensure no collisions with other
   // threads using MPI.
   MPI_Comm mpi_comm;
@@ -83,11 +113,31 @@ struct MPIContext {
   // Cross-node communicator for hierarchical allreduce.
   MPI_Comm cross_comm;
 
+  // Communicators of the process sets by ID minus one, MPI_COMM_NULL on the
+  // ranks outside a set.
+  std::vector<MPI_Comm> process_set_comms;
+
+  // Duplicate of mpi_comm for the messages of the controller, with
+  // HOROVOD_MPI_CONTROL_COMM, so that they are never matched behind the
+  // messages of data operations.
+  MPI_Comm control_comm = MPI_COMM_NULL;
+
+  // Whether MPI was initialized with MPI_THREAD_MULTIPLE.
+  bool thread_multiple = false;
+
   // MPI Window used for shared memory allgather
   MPI_Win window;
 
+  // MPI Window used for shared memory allreduce
+  MPI_Win allreduce_window = MPI_WIN_NULL;
+
   // Whether mpi context should be finalize.
   bool should_finalize = false;
+
+  // Whether MPI takes device pointers, e.g. to move them with GPUDirect
+  // RDMA. Queried with MPIX_Query_cuda_support where MPI provides it,
+  // HOROVOD_MPI_CUDA_AWARE overrides it.
+  bool cuda_aware = false;
 };
 
 } // namespace common
@@ -16,6 +16,8 @@
 
 #include "mpi_controller.h"
 
+#include <cstring>
+
 #include "../common.h"
 #include "../logging.h"
 
@@ -30,11 +32,11 @@ void MPIController::DoInitialization() {
   mpi_threads_supported_ = (provided == MPI_THREAD_MULTIPLE);
 
   // Get MPI rank to determine if we are rank zero.
-  MPI_Comm_rank(mpi_ctx_.mpi_comm, &rank_);
+  MPI_Comm_rank(mpi_ctx_.GetMPIControlCommunicator(), &rank_);
   is_coordinator_ = rank_ == 0;
 
   // Get MPI size to determine how many tensors to wait for before reducing.
-  MPI_Comm_size(mpi_ctx_.mpi_comm, &size_);
+  MPI_Comm_size(mpi_ctx_.GetMPIControlCommunicator(), &size_);
 
   if (is_coordinator_) {
     LOG(DEBUG) << "Started Horovod with " << size_ << " processes";
@@ -52,7 +54,7 @@ void MPIController::DoInitialization() {
   // local_size
   auto local_sizes = std::vector<int>(size_);
   MPI_Allgather(&local_size_, 1, MPI_INT, local_sizes.data(), 1, MPI_INT,
-                mpi_ctx_.mpi_comm);
+                mpi_ctx_.GetMPIControlCommunicator());
 
   is_homogeneous_ = true;
   for (int i = 0; i < size_; ++i) {
@@ -78,6 +80,12 @@ void MPIController::DoInitialization() {
     displacement += local_sizes[displacement];
   }
 
+  hierarchical_negotiation_ =
+      GetBoolEnvOrDefault(HOROVOD_HIERARCHICAL_NEGOTIATION, false);
+  if (is_coordinator_ && hierarchical_negotiation_) {
+    LOG(DEBUG) << "Negotiating through " << cross_size_ << " node leaders.";
+  }
+
   LOG(DEBUG) << "MPI controller initialized.";
 }
 
@@ -87,121 +95,286 @@ int MPIController::GetTypeSize(DataType dtype) {
 
 void MPIController::CrossRankBitwiseAnd(std::vector<long long>& bitvector,
                                         int count) {
-  int ret_code = MPI_Allreduce(MPI_IN_PLACE, bitvector.data(), count,
-                               MPI_LONG_LONG_INT, MPI_BAND, mpi_ctx_.mpi_comm);
+  BitwiseAllreduce(bitvector, count, MPI_BAND);
+}
+
+void MPIController::CrossRankBitwiseOr(std::vector<long long>& bitvector,
+                                       int count) {
+  BitwiseAllreduce(bitvector, count, MPI_BOR);
+}
+
+void MPIController::CrossRankSum(std::vector<double>& values) {
+  int ret_code = MPI_Allreduce(MPI_IN_PLACE, values.data(), (int)values.size(),
+                               MPI_DOUBLE, MPI_SUM,
+                               mpi_ctx_.GetMPIControlCommunicator());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_AllReduce failed, see MPI output for details.");
   }
 }
 
-void MPIController::CrossRankBitwiseOr(std::vector<long long>& bitvector,
-                                       int count) {
-  int ret_code = MPI_Allreduce(MPI_IN_PLACE, bitvector.data(), count,
-                               MPI_LONG_LONG_INT, MPI_BOR, mpi_ctx_.mpi_comm);
+void MPIController::BitwiseAllreduce(std::vector<long long>& bitvector,
+                                     int count, MPI_Op op) {
+  if (!hierarchical_negotiation_) {
+    int ret_code = MPI_Allreduce(MPI_IN_PLACE, bitvector.data(), count,
+                                 MPI_LONG_LONG_INT, op, mpi_ctx_.GetMPIControlCommunicator());
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_AllReduce failed, see MPI output for details.");
+    }
+    return;
+  }
+
+  // 1. Reduce the bits of the node on its local rank zero.
+  int ret_code;
+  if (local_rank_ == 0) {
+    ret_code = MPI_Reduce(MPI_IN_PLACE, bitvector.data(), count,
+                          MPI_LONG_LONG_INT, op, RANK_ZERO,
+                          mpi_ctx_.local_comm);
+  } else {
+    ret_code = MPI_Reduce(bitvector.data(), nullptr, count, MPI_LONG_LONG_INT,
+                          op, RANK_ZERO, mpi_ctx_.local_comm);
+  }
+  if (ret_code != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Reduce failed, see MPI output for details.");
+  }
+
+  // 2. Reduce the bits of the nodes among their leaders.
+  if (local_rank_ == 0) {
+    ret_code = MPI_Allreduce(MPI_IN_PLACE, bitvector.data(), count,
+                             MPI_LONG_LONG_INT, op, mpi_ctx_.cross_comm);
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_AllReduce failed, see MPI output for details.");
+    }
+  }
+
+  // 3. Hand the result back to the node.
+  ret_code = MPI_Bcast(bitvector.data(), count, MPI_LONG_LONG_INT, RANK_ZERO,
+                       mpi_ctx_.local_comm);
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
-        "MPI_AllReduce failed, see MPI output for details.");
+        "MPI_Broadcast failed, see MPI output for details.");
   }
 }
 
 void MPIController::RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
-                                     std::vector<RequestList>& ready_list) {
+                                     std::vector<RequestListView>& ready_list) {
+  if (hierarchical_negotiation_) {
+    // 1. Collect the messages of this node, rank zero sends none.
+    auto node_messages = GatherOnNode(std::string());
+
+    // 2. Collect the messages of the other nodes from their leaders.
+    int node_length = (int)node_messages.length();
+    std::vector<int> recvcounts(cross_size_);
+    MPI_Gather(&node_length, 1, MPI_INT, recvcounts.data(), 1, MPI_INT,
+               RANK_ZERO, mpi_ctx_.cross_comm);
+    std::vector<int> displcmnts(cross_size_);
+    size_t total_size = 0;
+    for (int i = 0; i < cross_size_; ++i) {
+      displcmnts[i] = (int)total_size;
+      total_size += recvcounts[i];
+    }
+    if (recv_buffer_.size() < total_size) {
+      recv_buffer_.resize(total_size);
+    }
+    MPI_Gatherv((void*)node_messages.data(), node_length, MPI_BYTE,
+                recv_buffer_.data(), recvcounts.data(), displcmnts.data(),
+                MPI_BYTE, RANK_ZERO, mpi_ctx_.cross_comm);
+
+    // 3. Index the messages by the rank that sent them, the views read them
+    // from the buffer.
+    ready_list.resize(size_);
+    size_t offset = 0;
+    while (offset < total_size) {
+      int32_t header[2];
+      memcpy(header, &recv_buffer_[offset], sizeof(header));
+      offset += sizeof(header);
+      if (header[0] != RANK_ZERO) {
+        ready_list[header[0]] = RequestListView(&recv_buffer_[offset]);
+      }
+      offset += header[1];
+    }
+    return;
+  }
+
   // Rank zero has put all its own tensors in the tensor count table.
   // Now, it should count all the tensors that are coming from other
   // ranks at this tick.
 
   // 1. Get message lengths from every rank.
-  auto recvcounts = new int[size_];
-  recvcounts[0] = 0;
-  MPI_Gather(MPI_IN_PLACE, 1, MPI_INT, recvcounts, 1, MPI_INT, RANK_ZERO,
-             mpi_ctx_.mpi_comm);
+  recvcounts_.resize(size_);
+  recvcounts_[0] = 0;
+  MPI_Gather(MPI_IN_PLACE, 1, MPI_INT, recvcounts_.data(), 1, MPI_INT,
+             RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
 
   // 2. Compute displacements.
-  auto displcmnts = new int[size_];
+  displcmnts_.resize(size_);
   size_t total_size = 0;
   for (int i = 0; i < size_; ++i) {
-    if (i == 0) {
-      displcmnts[i] = 0;
-    } else {
-      displcmnts[i] = recvcounts[i - 1] + displcmnts[i - 1];
-    }
-    total_size += recvcounts[i];
+    displcmnts_[i] = (int)total_size;
+    total_size += recvcounts_[i];
   }
 
   // 3. Collect messages from every rank.
-  auto buffer = new uint8_t[total_size];
-  MPI_Gatherv(nullptr, 0, MPI_BYTE, buffer, recvcounts, displcmnts, MPI_BYTE,
-              RANK_ZERO, mpi_ctx_.mpi_comm);
+  if (recv_buffer_.size() < total_size) {
+    recv_buffer_.resize(total_size);
+  }
+  MPI_Gatherv(nullptr, 0, MPI_BYTE, recv_buffer_.data(), recvcounts_.data(),
+              displcmnts_.data(), MPI_BYTE, RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
 
   // 4. Process messages.
   // create a dummy list for rank 0
+  ready_list.reserve(size_);
   ready_list.emplace_back();
   for (int i = 1; i < size_; ++i) {
-    auto rank_buffer_ptr = buffer + displcmnts[i];
-    RequestList received_message_list;
-    RequestList::ParseFromBytes(received_message_list, rank_buffer_ptr);
-    ready_list.push_back(std::move(received_message_list));
+    ready_list.emplace_back(recv_buffer_.data() + displcmnts_[i]);
   }
-
-  // 5. Free buffers.
-  delete[] recvcounts;
-  delete[] displcmnts;
-  delete[] buffer;
 }
 
 void MPIController::SendFinalTensors(ResponseList& response_list) {
   // Notify all nodes which tensors we'd like to reduce at this step.
-  std::string encoded_response;
-  ResponseList::SerializeToString(response_list, encoded_response);
-  int encoded_response_length = (int)encoded_response.length() + 1;
-  MPI_Bcast(&encoded_response_length, 1, MPI_INT, RANK_ZERO, mpi_ctx_.mpi_comm);
+  ResponseList::SerializeToString(response_list, encoded_message_);
+  if (hierarchical_negotiation_) {
+    BcastDownTree(encoded_message_);
+    return;
+  }
+  int encoded_response_length = (int)encoded_message_.length() + 1;
+  MPI_Bcast(&encoded_response_length, 1, MPI_INT, RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
 
-  MPI_Bcast((void*)encoded_response.c_str(), encoded_response_length, MPI_BYTE,
-            RANK_ZERO, mpi_ctx_.mpi_comm);
+  MPI_Bcast((void*)encoded_message_.c_str(), encoded_response_length, MPI_BYTE,
+            RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
 }
 
 void MPIController::SendReadyTensors(RequestList& message_list) {
-  std::string encoded_message;
-  RequestList::SerializeToString(message_list, encoded_message);
-  int encoded_message_length = (int)encoded_message.length() + 1;
+  RequestList::SerializeToString(message_list, encoded_message_);
+  if (hierarchical_negotiation_) {
+    auto node_messages = GatherOnNode(encoded_message_);
+    if (local_rank_ != 0) {
+      return;
+    }
+    // Node leaders forward the messages of their node to rank zero.
+    int node_length = (int)node_messages.length();
+    int ret_code = MPI_Gather(&node_length, 1, MPI_INT, nullptr, 1, MPI_INT,
+                              RANK_ZERO, mpi_ctx_.cross_comm);
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_Gather failed, see MPI output for details.");
+    }
+    ret_code = MPI_Gatherv((void*)node_messages.data(), node_length, MPI_BYTE,
+                           nullptr, nullptr, nullptr, MPI_BYTE, RANK_ZERO,
+                           mpi_ctx_.cross_comm);
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_Gather failed, see MPI output for details.");
+    }
+    return;
+  }
+  int encoded_message_length = (int)encoded_message_.length() + 1;
   int ret_code = MPI_Gather(&encoded_message_length, 1, MPI_INT, nullptr, 1,
-                            MPI_INT, RANK_ZERO, mpi_ctx_.mpi_comm);
+                            MPI_INT, RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
   }
 
-  ret_code = MPI_Gatherv((void*)encoded_message.c_str(), encoded_message_length,
+  ret_code = MPI_Gatherv((void*)encoded_message_.c_str(), encoded_message_length,
                          MPI_BYTE, nullptr, nullptr, nullptr, MPI_BYTE,
-                         RANK_ZERO, mpi_ctx_.mpi_comm);
+                         RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
   }
 }
 
 void MPIController::RecvFinalTensors(ResponseList& response_list) {
+  if (hierarchical_negotiation_) {
+    BcastDownTree(encoded_message_);
+    ResponseList::ParseFromBytes(response_list,
+                                 (const uint8_t*)encoded_message_.data());
+    return;
+  }
+
   int msg_length;
   int ret_code =
-      MPI_Bcast(&msg_length, 1, MPI_INT, RANK_ZERO, mpi_ctx_.mpi_comm);
+      MPI_Bcast(&msg_length, 1, MPI_INT, RANK_ZERO, mpi_ctx_.GetMPIControlCommunicator());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_Broadcast failed, see MPI output for details.");
   }
 
-  auto buffer = new uint8_t[msg_length];
-  ret_code =
-      MPI_Bcast(buffer, msg_length, MPI_BYTE, RANK_ZERO, mpi_ctx_.mpi_comm);
+  if ((int)recv_buffer_.size() < msg_length) {
+    recv_buffer_.resize(msg_length);
+  }
+  ret_code = MPI_Bcast(recv_buffer_.data(), msg_length, MPI_BYTE, RANK_ZERO,
+                       mpi_ctx_.GetMPIControlCommunicator());
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
         "MPI_Broadcast failed, see MPI output for details.");
   }
-  ResponseList::ParseFromBytes(response_list, buffer);
-  delete[] buffer;
+  ResponseList::ParseFromBytes(response_list, recv_buffer_.data());
+}
+
+std::string MPIController::GatherOnNode(const std::string& message) {
+  int length = (int)message.length();
+  std::vector<int> recvcounts(local_size_);
+  int ret_code = MPI_Gather(&length, 1, MPI_INT, recvcounts.data(), 1, MPI_INT,
+                            RANK_ZERO, mpi_ctx_.local_comm);
+  if (ret_code != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
+  }
+
+  std::vector<int> displcmnts(local_size_);
+  size_t total_size = 0;
+  for (int i = 0; i < local_size_; ++i) {
+    displcmnts[i] = (int)total_size;
+    total_size += recvcounts[i];
+  }
+  std::string buffer(local_rank_ == 0 ? total_size : 0, '\0');
+  ret_code = MPI_Gatherv((void*)message.data(), length, MPI_BYTE, &buffer[0],
+                         recvcounts.data(), displcmnts.data(), MPI_BYTE,
+                         RANK_ZERO, mpi_ctx_.local_comm);
+  if (ret_code != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Gather failed, see MPI output for details.");
+  }
+  if (local_rank_ != 0) {
+    return std::string();
+  }
+
+  // Prefix every message with the global rank of its sender and its length.
+  std::string node_messages;
+  node_messages.reserve(total_size + local_size_ * 2 * sizeof(int32_t));
+  for (int i = 0; i < local_size_; ++i) {
+    int32_t header[2] = {local_comm_ranks_[i], recvcounts[i]};
+    node_messages.append((const char*)header, sizeof(header));
+    node_messages.append(buffer, displcmnts[i], recvcounts[i]);
+  }
+  return node_messages;
+}
+
+void MPIController::BcastDownTree(std::string& message) {
+  std::vector<MPI_Comm> comms;
+  if (local_rank_ == 0) {
+    comms.push_back(mpi_ctx_.cross_comm);
+  }
+  comms.push_back(mpi_ctx_.local_comm);
+  for (auto comm : comms) {
+    int length = (int)message.length();
+    int ret_code = MPI_Bcast(&length, 1, MPI_INT, RANK_ZERO, comm);
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_Broadcast failed, see MPI output for details.");
+    }
+    message.resize(length);
+    ret_code = MPI_Bcast(&message[0], length, MPI_BYTE, RANK_ZERO, comm);
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_Broadcast failed, see MPI output for details.");
+    }
+  }
 }
 
 void MPIController::Bcast(void* buffer, size_t size, int root_rank,
                           Communicator communicator) {
-  MPI_Comm comm = mpi_ctx_.GetMPICommunicator(communicator);
+  MPI_Comm comm = ControlCommunicator(communicator);
   int ret_code = MPI_Bcast(buffer, size, MPI_BYTE, root_rank, comm);
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
@@ -211,10 +384,11 @@ void MPIController::Bcast(void* buffer, size_t size, int root_rank,
 
 void MPIController::AlltoallGetRecvSplits(const std::vector<int32_t>& splits,
                                           std::vector<int32_t>& recvsplits) {
-  recvsplits.resize(size_);
-  MPI_Comm comm = mpi_ctx_.GetMPICommunicator(Communicator::GLOBAL);
-  int ret_code = MPI_Alltoall(splits.data(), 1, MPI_INT,
-                              recvsplits.data(), 1, MPI_INT,
+  recvsplits.resize(splits.size());
+  int count = (int)(splits.size() / size_);
+  MPI_Comm comm = ControlCommunicator(Communicator::GLOBAL);
+  int ret_code = MPI_Alltoall(splits.data(), count, MPI_INT,
+                              recvsplits.data(), count, MPI_INT,
                               comm);
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error(
@@ -223,12 +397,54 @@ void MPIController::AlltoallGetRecvSplits(const std::vector<int32_t>& splits,
 };
 
 void MPIController::Barrier(Communicator communicator) {
-  MPI_Comm comm = mpi_ctx_.GetMPICommunicator(communicator);
+  MPI_Comm comm = ControlCommunicator(communicator);
   int ret_code = MPI_Barrier(comm);
   if (ret_code != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Barrier failed, see MPI output for details.");
   }
 }
 
+void MPIController::ProcessSetBcast(void* buffer, size_t size,
+                                    int32_t process_set_id) {
+  int ret_code =
+      MPI_Bcast(buffer, size, MPI_BYTE, RANK_ZERO,
+                mpi_ctx_.GetProcessSetCommunicator(process_set_id));
+  if (ret_code != MPI_SUCCESS) {
+    throw std::runtime_error(
+        "MPI_Broadcast failed, see MPI output for details.");
+  }
+}
+
+void MPIController::DoInitializeProcessSets() {
+  // MPI_Comm_create is collective over mpi_comm, all ranks create every set
+  // in the same order and get MPI_COMM_NULL for the sets they are not in.
+  mpi_ctx_.FreeProcessSetCommunicators();
+  MPI_Group world_group;
+  MPI_Comm_group(mpi_ctx_.mpi_comm, &world_group);
+  for (int id = 1; id <= process_sets_.NumSets(); ++id) {
+    auto& ranks = process_sets_.Ranks(id);
+    MPI_Group group;
+    MPI_Group_incl(world_group, (int)ranks.size(), ranks.data(), &group);
+    MPI_Comm comm;
+    int ret_code = MPI_Comm_create(mpi_ctx_.mpi_comm, group, &comm);
+    MPI_Group_free(&group);
+    if (ret_code != MPI_SUCCESS) {
+      throw std::runtime_error(
+          "MPI_Comm_create failed, see MPI output for details.");
+    }
+    mpi_ctx_.process_set_comms.push_back(comm);
+  }
+  MPI_Group_free(&world_group);
+  if (process_sets_.NumSets() > 0) {
+    LOG(DEBUG) << "Created " << process_sets_.NumSets() << " process sets.";
+  }
+}
+
+MPI_Comm MPIController::ControlCommunicator(Communicator communicator) {
+  return communicator == Communicator::GLOBAL
+             ? mpi_ctx_.GetMPIControlCommunicator()
+             : mpi_ctx_.GetMPICommunicator(communicator);
+}
+
 } // namespace common
 } // namespace horovod
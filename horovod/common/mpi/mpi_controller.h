@@ -27,8 +27,9 @@ class MPIController : public Controller {
 public:
   MPIController(ResponseCache& response_cache, TensorQueue& tensor_queue,
                 Timeline& timeline, ParameterManager& parameter_manager,
-                MPIContext& mpi_ctx)
-      : Controller(response_cache, tensor_queue, timeline, parameter_manager),
+                HorovodMetrics& metrics, MPIContext& mpi_ctx)
+      : Controller(response_cache, tensor_queue, timeline, parameter_manager,
+                   metrics),
         mpi_ctx_(mpi_ctx) {
     LOG(DEBUG) << "MPI Controller Initialized.";
   }
@@ -43,8 +44,10 @@ public:
   void CrossRankBitwiseOr(std::vector<long long>& bitvector,
                           int count) override;
 
+  void CrossRankSum(std::vector<double>& values) override;
+
   void RecvReadyTensors(std::vector<std::string>& ready_to_reduce,
-                        std::vector<RequestList>& ready_list) override;
+                        std::vector<RequestListView>& ready_list) override;
 
   void SendFinalTensors(ResponseList& response_list) override;
 
@@ -59,15 +62,48 @@ public:
 
   void Barrier(Communicator communicator) override;
 
+  void ProcessSetBcast(void* buffer, size_t size,
+                       int32_t process_set_id) override;
+
   bool IsMpiThreadsSupported() const { return mpi_threads_supported_; }
 
 protected:
   void DoInitialization() override;
 
+  void DoInitializeProcessSets() override;
+
+  // Gathers the messages of the node on its local rank zero, which returns
+  // them packed with the rank of each sender.
+  std::string GatherOnNode(const std::string& message);
+
+  // Broadcasts the message of rank zero to the local rank zero of every node,
+  // then to the other ranks of the node.
+  void BcastDownTree(std::string& message);
+
+  // Reduces the bit vector of every rank with op. With hierarchical
+  // negotiation, only the local rank zero of each node takes part in the
+  // reduction across nodes.
+  void BitwiseAllreduce(std::vector<long long>& bitvector, int count,
+                        MPI_Op op);
+
+  // The control communicator in place of the global one, so that the
+  // messages of the controller stay apart from the data operations.
+  MPI_Comm ControlCommunicator(Communicator communicator);
+
   MPIContext& mpi_ctx_;
 
   // flag indicating whether MPI multi-threading is supported
   bool mpi_threads_supported_ = false;
+
+  // Exchange requests, responses and the cache bit vectors with rank zero
+  // through the local rank zero of each node instead of directly.
+  bool hierarchical_negotiation_ = false;
+
+  // Negotiation buffers, reused across cycles.
+  std::vector<int> recvcounts_;
+  std::vector<int> displcmnts_;
+  std::vector<uint8_t> recv_buffer_;
+  std::string encoded_message_;
 };
 
 } // namespace common
@@ -0,0 +1,147 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "nvtx_ranges.h"
+
+#include <sstream>
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+#if HAVE_NVTX
+// Colors of the launch ranges, indexed by stream.
+static const uint32_t STREAM_COLORS[] = {0xFF76B900, 0xFF1F77B4, 0xFFFF7F0E,
+                                         0xFFD62728, 0xFF9467BD, 0xFF8C564B,
+                                         0xFFE377C2, 0xFF17BECF};
+#endif
+
+void NvtxRanges::Initialize() {
+  if (enabled_) {
+    return;
+  }
+#if HAVE_NVTX
+  // The domain outlives a shutdown, launch ranges may still be popped.
+  if (domain_ == nullptr) {
+    domain_ = nvtxDomainCreateA("Horovod");
+  }
+  enabled_ = true;
+#else
+  LOG(WARNING) << "HOROVOD_TIMELINE_NVTX is set, but Horovod was built "
+                  "without NVTX, will not emit NVTX ranges.";
+#endif
+}
+
+void NvtxRanges::Shutdown() {
+  if (!enabled_) {
+    return;
+  }
+  enabled_ = false;
+#if HAVE_NVTX
+  for (auto& ranges : tensor_ranges_) {
+    for (auto id : ranges.second) {
+      nvtxDomainRangeEnd(domain_, id);
+    }
+  }
+  tensor_ranges_.clear();
+#endif
+}
+
+void NvtxRanges::TensorRangeStart(const std::string& tensor_name,
+                                  const std::string& activity) {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_NVTX
+  auto message = activity + " " + tensor_name;
+  nvtxEventAttributes_t attributes{};
+  attributes.version = NVTX_VERSION;
+  attributes.size = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+  attributes.messageType = NVTX_MESSAGE_TYPE_ASCII;
+  attributes.message.ascii = message.c_str();
+  tensor_ranges_[tensor_name].push_back(
+      nvtxDomainRangeStartEx(domain_, &attributes));
+#endif
+}
+
+void NvtxRanges::TensorRangeEnd(const std::string& tensor_name) {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_NVTX
+  auto it = tensor_ranges_.find(tensor_name);
+  if (it == tensor_ranges_.end()) {
+    return;
+  }
+  nvtxDomainRangeEnd(domain_, it->second.back());
+  it->second.pop_back();
+  if (it->second.empty()) {
+    tensor_ranges_.erase(it);
+  }
+#endif
+}
+
+void NvtxRanges::Mark(const std::string& name) {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_NVTX
+  nvtxEventAttributes_t attributes{};
+  attributes.version = NVTX_VERSION;
+  attributes.size = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+  attributes.messageType = NVTX_MESSAGE_TYPE_ASCII;
+  attributes.message.ascii = name.c_str();
+  nvtxDomainMarkEx(domain_, &attributes);
+#endif
+}
+
+void NvtxRanges::LaunchRangePush(const std::string& activity, int group,
+                                 int block_num, int thread_num, int stream,
+                                 int64_t bytes) {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_NVTX
+  std::stringstream message;
+  message << activity << " group=" << group << " block_num=" << block_num
+          << " thread_num=" << thread_num << " stream=" << stream;
+  auto message_string = message.str();
+  nvtxEventAttributes_t attributes{};
+  attributes.version = NVTX_VERSION;
+  attributes.size = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+  attributes.category = (uint32_t)group;
+  attributes.colorType = NVTX_COLOR_ARGB;
+  attributes.color = STREAM_COLORS[(unsigned)stream % (sizeof(STREAM_COLORS) /
+                                                       sizeof(uint32_t))];
+  attributes.payloadType = NVTX_PAYLOAD_TYPE_INT64;
+  attributes.payload.llValue = bytes;
+  attributes.messageType = NVTX_MESSAGE_TYPE_ASCII;
+  attributes.message.ascii = message_string.c_str();
+  nvtxDomainRangePushEx(domain_, &attributes);
+#endif
+}
+
+void NvtxRanges::LaunchRangePop() {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_NVTX
+  nvtxDomainRangePop(domain_);
+#endif
+}
+
+} // namespace common
+} // namespace horovod
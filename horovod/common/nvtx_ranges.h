@@ -0,0 +1,73 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_NVTX_RANGES_H
+#define HOROVOD_NVTX_RANGES_H
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if HAVE_NVTX
+#include <nvtx3/nvToolsExt.h>
+#endif
+
+namespace horovod {
+namespace common {
+
+// Emits the events of the timeline as NVTX ranges, so that Nsight Systems
+// lines the Horovod phases up with the kernels and their SM occupancy. Set
+// HOROVOD_TIMELINE_NVTX=1 to enable it on every rank; it does nothing unless
+// Horovod was built with CUDA and the NVTX headers.
+//
+// The ranges of a tensor can start and end on different threads, and nest
+// like the events of the timeline. The launches of a fusion group are host
+// ranges on the calling thread, so that Nsight shows their kernels under
+// them.
+class NvtxRanges {
+public:
+  NvtxRanges() = default;
+  NvtxRanges(const NvtxRanges&) = delete;
+  ~NvtxRanges() { Shutdown(); }
+
+  void Initialize();
+  void Shutdown();
+  bool IsEnabled() const { return enabled_; }
+
+  // The timeline calls them under its mutex.
+  void TensorRangeStart(const std::string& tensor_name,
+                        const std::string& activity);
+  void TensorRangeEnd(const std::string& tensor_name);
+  void Mark(const std::string& name);
+
+  // message is tagged with the Libra allocation of the group, and the range
+  // is colored by stream.
+  void LaunchRangePush(const std::string& activity, int group, int block_num,
+                       int thread_num, int stream, int64_t bytes);
+  void LaunchRangePop();
+
+private:
+  std::atomic_bool enabled_{false};
+#if HAVE_NVTX
+  nvtxDomainHandle_t domain_ = nullptr;
+  std::unordered_map<std::string, std::vector<nvtxRangeId_t>> tensor_ranges_;
+#endif
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_NVTX_RANGES_H
@@ -19,10 +19,13 @@
 
 #include "operations.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstring>
+#include <iterator>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <sstream>
@@ -38,6 +41,7 @@
 #include "logging.h"
 #include "message.h"
 #include "ops/operation_manager.h"
+#include "parallel_for.h"
 #include "parameter_manager.h"
 #include "timeline.h"
 #include "utils/env_parser.h"
@@ -113,7 +117,6 @@ namespace {
 
 // All the Horovod state that must be stored globally per-process.
 HorovodGlobalState horovod_global;
-std::unordered_map<std::string,bool> ready_map;
 
 #if HAVE_MPI
 MPIContext mpi_context;
@@ -150,9 +153,29 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
   std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops;
   std::vector<std::shared_ptr<AllreduceOp>> adasum_ops;
   std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops;
+  std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops;
+
+#if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
+  allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+      new NCCLTorusAllreduce(&nccl_context, &gpu_context, &state)));
+#endif
+
+#if HAVE_NCCL && HOROVOD_GPU_ALLGATHER == 'N'
+  allgather_ops.push_back(std::shared_ptr<AllgatherOp>(
+      new NCCLHierarchicalAllgather(&nccl_context, &gpu_context, &state)));
+#endif
 
 #if HAVE_MPI && HAVE_GPU
   if (mpi_context.IsEnabled()) {
+#if HAVE_CUDA && (HOROVOD_GPU_ALLREDUCE == 'M' || HOROVOD_GPU_ALLGATHER == 'M' || \
+                  HOROVOD_GPU_ALLTOALL == 'M')
+    if (!mpi_context.cuda_aware) {
+      LOG(WARNING, state.controller->GetRank())
+          << "Horovod runs GPU operations with MPI, which does not report "
+             "CUDA support. Set "
+          << HOROVOD_MPI_CUDA_AWARE << "=1 if it supports device memory.";
+    }
+#endif
 #if HOROVOD_GPU_ALLREDUCE == 'M'
     allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
         new MPI_GPUAllreduce(&mpi_context, &gpu_context, &state)));
@@ -186,6 +209,8 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
 #if HAVE_NCCL && HOROVOD_GPU_ALLREDUCE == 'N'
   allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
       new NCCLAllreduce(&nccl_context, &gpu_context, &state)));
+  reducescatter_ops.push_back(std::shared_ptr<ReducescatterOp>(
+      new NCCLReducescatter(&nccl_context, &gpu_context, &state)));
 #endif
 
 #if HAVE_NCCL && HOROVOD_GPU_BROADCAST == 'N'
@@ -199,6 +224,8 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
 #endif
 
 #if HAVE_NCCL && HOROVOD_GPU_ALLTOALL == 'N'
+  alltoall_ops.push_back(std::shared_ptr<AlltoallOp>(
+      new NCCLHierarchicalAlltoall(&nccl_context, &gpu_context, &state)));
   alltoall_ops.push_back(std::shared_ptr<AlltoallOp>(
       new NCCLAlltoall(&nccl_context, &gpu_context, &state)));
 #endif
@@ -213,6 +240,8 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
         std::shared_ptr<BroadcastOp>(new GlooBroadcast(&gloo_context, &state)));
     alltoall_ops.push_back(
         std::shared_ptr<AlltoallOp>(new GlooAlltoall(&gloo_context, &state)));
+    reducescatter_ops.push_back(std::shared_ptr<ReducescatterOp>(
+        new GlooReducescatter(&gloo_context, &state)));
   }
 #endif
 
@@ -231,6 +260,8 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
   if (mpi_context.IsEnabled()){
     adasum_ops.push_back(
         std::shared_ptr<AllreduceOp>(new AdasumMPIAllreduceOp(&mpi_context, &state)));
+    allreduce_ops.push_back(std::shared_ptr<AllreduceOp>(
+        new MPIHierarchicalAllreduce(&mpi_context, &state)));
     allreduce_ops.push_back(
         std::shared_ptr<AllreduceOp>(new MPIAllreduce(&mpi_context,&state)));
     allgather_ops.push_back(
@@ -239,6 +270,8 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
         std::shared_ptr<BroadcastOp>(new MPIBroadcast(&mpi_context, &state)));
     alltoall_ops.push_back(
         std::shared_ptr<AlltoallOp>(new MPIAlltoall(&mpi_context, &state)));
+    reducescatter_ops.push_back(std::shared_ptr<ReducescatterOp>(
+        new MPIReducescatter(&mpi_context, &state)));
   }
 #endif
 
@@ -247,23 +280,87 @@ OperationManager* CreateOperationManager(HorovodGlobalState& state) {
 
   return new OperationManager(&state.parameter_manager, allreduce_ops,
                               allgather_ops, broadcast_ops, alltoall_ops,
-                              join_op, adasum_ops, error_op);
+                              reducescatter_ops, join_op, adasum_ops, error_op);
+}
+
+// Returns the timeline file of the rank. Ranks other than the coordinator
+// write to "<file_name>.<rank>".
+std::string TimelineFileForRank(const std::string& file_name, int rank) {
+  if (file_name.empty() || rank == 0) {
+    return file_name;
+  }
+  return file_name + "." + std::to_string(rank);
+}
+
+// Records the entry in the overlap stats, if they are enabled, and makes its
+// callback record the end of its collective.
+void TrackOverlapStats(TensorTableEntry& e) {
+  auto& overlap_stats = horovod_global.overlap_stats;
+  if (!overlap_stats.IsEnabled()) {
+    return;
+  }
+  overlap_stats.RecordReady(e.tensor_name);
+  auto name = e.tensor_name;
+  auto callback = e.callback;
+  // The end of the collective is recorded by the callback.
+  e.batcher = nullptr;
+  e.callback = [name, callback](const Status& status) {
+    horovod_global.overlap_stats.RecordCommEnd(name);
+    callback(status);
+  };
 }
 
 // Process a Response by doing a reduction, a gather, a broadcast, or
-// raising an error.
-void PerformOperation(Response response, HorovodGlobalState& state) {
+// raising an error. Uses the stream slot of current_nccl_stream.
+void PerformOperationOnStream(Response response, HorovodGlobalState& state,
+                              bool joined) {
   std::vector<TensorTableEntry> entries;
   auto& timeline = horovod_global.timeline;
   if (response.response_type() != Response::JOIN) {
-    horovod_global.tensor_queue.GetTensorEntriesFromResponse(response, entries,
-                                                             state.joined);
+    auto status = horovod_global.tensor_queue.GetTensorEntriesFromResponse(
+        response, entries, joined);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to allocate the tensors of a joined rank: "
+                 << status.reason();
+      InvokeCallbacks(entries, status);
+      return;
+    }
+#if HAVE_NCCL
+    // The allreduces batched so far are launched before other operations.
+    if (nccl_context.launch_batch.Active() &&
+        !op_manager->JoinsLaunchBatch(entries, response)) {
+      nccl_context.launch_batch.Flush();
+    }
+#endif
 
     timeline.ActivityStart("fzh-debug1", "Perform");
                                                      
     
+    int64_t response_bytes = 0;
     for (auto& e : entries) {
       timeline.Start(e.tensor_name, response.response_type());
+      horovod_global.overlap_stats.RecordNegotiated(e.tensor_name);
+      if (e.tensor != nullptr) {
+        response_bytes += e.tensor->size();
+      }
+    }
+    if (!entries.empty()) {
+      horovod_global.metrics.fused_response_bytes.Observe(response_bytes);
+    }
+
+    horovod_global.fusion_buffer_index = horovod_global.current_nccl_stream;
+    if (horovod_global.fusion_double_buffering && !entries.empty() &&
+        entries[0].device != CPU_DEVICE_ID) {
+      auto& phases = horovod_global.fusion_buffer_phases;
+      if ((int)phases.size() <= horovod_global.current_nccl_stream) {
+        phases.resize(horovod_global.current_nccl_stream + 1, 0);
+      }
+      auto& phase = phases[horovod_global.current_nccl_stream];
+      if (entries.size() > 1) {
+        phase ^= 1;
+      }
+      horovod_global.fusion_buffer_index =
+          horovod_global.current_nccl_stream * 2 + phase;
     }
 
     if (entries.size() > 1) {
@@ -271,42 +368,59 @@ void PerformOperation(Response response, HorovodGlobalState& state) {
       // Note: it is OK for different entries to come from different frameworks
       // since buffer allocated here is guaranteed to survive at least till the
       // end of this operation.
+      // Only the footprint of allreduces is known here, the fusion buffers of
+      // the other collectives hold their outputs. Hierarchical allreduces pad
+      // the group to a multiple of local_size * FUSION_BUFFER_ATOMIC_UNIT
+      // elements.
+      int64_t group_bytes = 0;
+      if (response.response_type() == Response::ALLREDUCE) {
+        int64_t div = horovod_global.controller->GetLocalSize() *
+                      FUSION_BUFFER_ATOMIC_UNIT *
+                      DataType_Size(first_entry.tensor->dtype());
+        group_bytes = (response_bytes + div - 1) / div * div;
+      }
       Status status = horovod_global.fusion_buffer.InitializeBuffer(
-          horovod_global.controller->TensorFusionThresholdBytes(),
+          horovod_global.controller->TensorFusionThresholdBytes(), group_bytes,
           first_entry.device, first_entry.context,
-          horovod_global.current_nccl_stream,
+          horovod_global.fusion_buffer_index,
           [&]() { timeline.ActivityStartAll(entries, INIT_FUSION_BUFFER); },
           [&]() { timeline.ActivityEndAll(entries); });
       if (!status.ok()) {
         for (auto& e : entries) {
           timeline.End(e.tensor_name, nullptr);
-          // Callback can be null if the rank sent Join request.
-          if (e.callback != nullptr) {
-            e.callback(status);
-          }
         }
+        InvokeCallbacks(entries, status);
         return;
       }
     }
 
-    // On GPU data readiness is signalled by ready_event.
+    // On GPU data readiness is signalled by ready_event. Operations that wait
+    // for it on their GPU stream let the background thread move on, the
+    // others are waited for here: by blocking on the GPU event if the
+    // framework gives one, or else by polling Ready().
+#if HAVE_GPU
+    bool device_waits =
+        op_manager->WaitsForReadyEventsOnDevice(entries, response);
+#endif
     std::vector<TensorTableEntry> waiting_tensors;
     for (auto& e : entries) {
       if (e.ready_event != nullptr) {
+#if HAVE_GPU
+        if (e.ready_event->event() != nullptr) {
+          if (!device_waits) {
+            gpu_context.EventSynchronize(e.ready_event->event());
+          }
+          continue;
+        }
+#endif
         // timeline.ActivityStart(e.tensor_name, WAIT_FOR_DATA);
         waiting_tensors.push_back(e);
       }
     }
     while (!waiting_tensors.empty()) {
       for (auto it = waiting_tensors.begin(); it != waiting_tensors.end();) {
-        std::string name = it->tensor_name+"_comptimeline";
-        if(ready_map.find(name) != ready_map.end()){
-            if(ready_map[name]==true){
-              ready_map[name]=false;
-              it = waiting_tensors.erase(it);
-            }
-        }
-        else if (it->ready_event->Ready()) {
+        if ((it->comp_ready != nullptr && it->comp_ready->load()) ||
+            it->ready_event->Ready()) {
         //  timeline.ActivityEnd(it->tensor_name);
         //  timeline.ActivityStart(it->tensor_name, WAIT_FOR_OTHER_TENSOR_DATA);
            it = waiting_tensors.erase(it);
@@ -315,7 +429,11 @@ void PerformOperation(Response response, HorovodGlobalState& state) {
           ++it;
         }
       }
-      std::this_thread::sleep_for(std::chrono::nanoseconds(100));
+      if (state.busy_poll) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(100));
+      }
     }
     // for (auto& e : entries) {
     //   if (e.ready_event != nullptr) {
@@ -324,6 +442,10 @@ void PerformOperation(Response response, HorovodGlobalState& state) {
     // }
   }
 
+  for (auto& e : entries) {
+    horovod_global.overlap_stats.RecordCommStart(e.tensor_name);
+  }
+
   Status status;
   try {
     status = op_manager->ExecuteOperation(entries, response);
@@ -334,15 +456,29 @@ void PerformOperation(Response response, HorovodGlobalState& state) {
   if (!status.in_progress()) {
     for (auto& e : entries) {
       timeline.End(e.tensor_name, status.ok() ? e.output : nullptr);
-      // Callback can be null if the rank sent Join request.
-      if (e.callback != nullptr) {
-        e.callback(status);
-      }
     }
+    InvokeCallbacks(entries, status);
   }
   timeline.ActivityEnd("fzh-debug1");
 }
 
+// Process a Response on the stream slots of its process set.
+void PerformOperation(Response response, HorovodGlobalState& state,
+                      bool joined) {
+  int32_t process_set_id = response.process_set_id();
+  if (process_set_id == 0) {
+    PerformOperationOnStream(std::move(response), state, joined);
+    return;
+  }
+  auto& streams = horovod_global.process_set_nccl_streams;
+  if ((int)streams.size() <= process_set_id) {
+    streams.resize(process_set_id + 1, 0);
+  }
+  std::swap(horovod_global.current_nccl_stream, streams[process_set_id]);
+  PerformOperationOnStream(std::move(response), state, joined);
+  std::swap(horovod_global.current_nccl_stream, streams[process_set_id]);
+}
+
 // The background thread loop coordinates all the controller processes and the
 // tensor reductions. The design of the communicator mechanism is limited by a
 // few considerations:
@@ -365,6 +501,128 @@ void PerformOperation(Response response, HorovodGlobalState& state) {
 //      make progress if we have a thread pool limit.
 bool RunLoopOnce(HorovodGlobalState& state);
 
+// Returns true if the responses can be performed on the execution thread
+// while the next cycle is negotiated. Responses that go through the
+// controller, like NCCL communicator creation, MPI and Gloo collectives, must
+// be performed between two negotiations on every rank, so those lists are
+// performed on the background thread once the execution thread is idle.
+bool CanPerformAsync(const ResponseList& response_list,
+                     HorovodGlobalState& state) {
+  // Joined ranks build zero tensors from the join tensor, and autotuning
+  // changes operation parameters between cycles.
+  if (response_list.shutdown() || state.joined ||
+      state.parameter_manager.IsAutoTuning()) {
+    return false;
+  }
+  for (auto& response : response_list.responses()) {
+    if (response.response_type() == Response::JOIN ||
+        response.response_type() == Response::ERROR ||
+        response.tensor_names().empty()) {
+      return false;
+    }
+    // Operations are selected from the first entry, like in PerformOperation.
+    std::vector<TensorTableEntry> entries{
+        state.tensor_queue.GetTensorEntry(response.tensor_names()[0])};
+    if (!op_manager->ExecutesWithoutController(entries, response)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if the cluster is homogeneous and the ranks of each node are
+// contiguous, with local rank i of the node with cross rank c being rank
+// c * local_size + i.
+bool RanksPlacedByNode(Controller& controller) {
+  if (!controller.IsHomogeneous()) {
+    return false;
+  }
+  int local_size = controller.GetLocalSize();
+  auto& local_comm_ranks = controller.GetLocalCommRanks();
+  for (int i = 0; i < (int)local_comm_ranks.size(); ++i) {
+    if (local_comm_ranks[i] != controller.GetCrossRank() * local_size + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Loads the response cache saved by an earlier run of the same size, so that
+// the first steps after a restart find their tensors in the cache. Every rank
+// reads its own file, and the caches are only kept if all ranks loaded the
+// same responses, which then have the same bits.
+void LoadResponseCache(HorovodGlobalState& state) {
+  auto& controller = state.controller;
+  auto& cache = state.response_cache;
+  bool loaded = cache.load(state.response_cache_file, controller->GetSize());
+  uint64_t fingerprint = cache.fingerprint();
+  uint64_t root_fingerprint = fingerprint;
+  controller->Bcast(&root_fingerprint, sizeof(root_fingerprint), 0,
+                    Communicator::GLOBAL);
+  std::vector<long long> agreed{loaded && fingerprint == root_fingerprint};
+  controller->CrossRankBitwiseAnd(agreed, 1);
+  if (agreed[0]) {
+    LOG(INFO, controller->GetRank())
+        << "Loaded " << cache.num_active_bits() << " cached responses from "
+        << state.response_cache_file;
+  } else {
+    if (loaded) {
+      LOG(WARNING, controller->GetRank())
+          << "Ignoring " << state.response_cache_file
+          << ", the response caches of the ranks do not agree.";
+    }
+    cache.clear();
+  }
+  state.response_cache_generation = cache.generation();
+  state.saved_response_cache_generation = cache.generation();
+}
+
+#if HAVE_NCCL
+// Creates the NCCL communicators of the usual device layout, one GPU per
+// process with device == local rank, before the first collective needs them.
+// Communicators for other layouts are still created on first use.
+void WarmUpNCCLComms(HorovodGlobalState& state) {
+  auto& controller = state.controller;
+  int local_size = controller->GetLocalSize();
+
+  // All ranks have to agree, since the warmup is collective.
+  bool usual_layout = RanksPlacedByNode(*controller);
+  if (usual_layout) {
+    try {
+      gpu_context.SetDevice(controller->GetLocalRank());
+    } catch (const std::exception&) {
+      usual_layout = false;
+    }
+  }
+  std::vector<long long> bitvector{usual_layout ? 1 : 0};
+  controller->CrossRankBitwiseAnd(bitvector, 1);
+  if (bitvector[0] == 0) {
+    LOG(INFO, controller->GetRank())
+        << "Skipping NCCL warmup, devices are not assigned by local rank.";
+    return;
+  }
+
+  std::vector<int32_t> global_device_map;
+  for (int rank = 0; rank < controller->GetSize(); ++rank) {
+    global_device_map.push_back(rank % local_size);
+  }
+  NCCLOpContext(&nccl_context, &state, Communicator::GLOBAL)
+      .InitNCCLComms(global_device_map);
+
+#if HAVE_MPI
+  if (state.parameter_manager.HierarchicalAllreduce()) {
+    std::vector<int32_t> local_device_map;
+    for (int i = 0; i < local_size; ++i) {
+      local_device_map.push_back(i);
+    }
+    NCCLOpContext(&nccl_context, &state, Communicator::LOCAL)
+        .InitNCCLComms(local_device_map);
+  }
+#endif
+  LOG(DEBUG, controller->GetRank()) << "NCCL communicators warmed up.";
+}
+#endif
+
 
 // lyz computation timeline
 void compTimelineThread(HorovodGlobalState& state);
@@ -373,7 +631,7 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
 #if HAVE_CCL
   // Initialize ccl context
   if (state.cpu_operation == LibType::CCL) {
-    ccl_context.Init();
+    ccl_context.Init(GetIntEnvOrDefault(HOROVOD_CCL_IN_FLIGHT_OPS, 2));
   }
 #endif
 
@@ -401,6 +659,12 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
       gloo_context.Initialize(ParseGlooIface());
     }
 #endif
+#if HAVE_GPU
+  // Used to size the NCCL blocks of fusion groups without a specification.
+  state.controller->SetDeviceSMCount(
+      gpu_context.GetMultiProcessorCount(gpu_context.GetDevice()));
+#endif
+
   // Initialize controller
   state.controller->Initialize();
 
@@ -410,8 +674,55 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   int local_size = state.controller->GetLocalSize();
   int local_rank = state.controller->GetLocalRank();
 
+#if HAVE_NCCL
+  // The coordinator allocates the blocks of the groups, they are measured on
+  // its device only.
+  auto& channel_feedback = state.controller->channel_feedback();
+  if (channel_feedback.IsEnabled() &&
+      !nccl_context.kernel_monitor.Start(&channel_feedback, &state.metrics)) {
+    channel_feedback.SetEnabled(false);
+  }
+#endif
+
   // Set background thread affinity
-  parse_and_set_affinity(std::getenv(HOROVOD_THREAD_AFFINITY), local_size, local_rank);
+  int thread_affinity = parse_affinity(std::getenv(HOROVOD_THREAD_AFFINITY),
+                                       local_size, local_rank);
+  if (thread_affinity >= 0) {
+    set_affinity(thread_affinity);
+  }
+
+  // Poll without sleeping between cycles, if it's set.
+  state.busy_poll = GetBoolEnvOrDefault(HOROVOD_BUSY_POLL, false);
+  if (state.busy_poll && thread_affinity < 0) {
+    LOG(WARNING, state.controller->GetRank())
+        << HOROVOD_BUSY_POLL << " keeps a core busy, set "
+        << HOROVOD_THREAD_AFFINITY << " to a core isolated for it.";
+  }
+
+  // Otherwise place the threads and the host buffers they allocate on a NUMA
+  // node, the one next to the GPU and the NIC of the rank with "auto".
+  int numa_node = -1;
+  auto numa_affinity = std::getenv(HOROVOD_NUMA_AFFINITY);
+  if (thread_affinity < 0 && numa_affinity != nullptr) {
+    if (std::string(numa_affinity) == "auto") {
+      int gpu_node = -1;
+#if HAVE_GPU
+      gpu_node = gpu_context.GetLocalNumaNode(local_rank);
+#endif
+      numa_node = local_numa_node(local_rank, gpu_node);
+      if (numa_node < 0) {
+        LOG(WARNING, state.controller->GetRank())
+            << "No NUMA node found for the GPU or the NIC, "
+            << HOROVOD_NUMA_AFFINITY << "=auto has no effect.";
+      }
+    } else {
+      numa_node = parse_affinity(numa_affinity, local_size, local_rank,
+                                 HOROVOD_NUMA_AFFINITY);
+    }
+    if (numa_node >= 0) {
+      set_numa_affinity(numa_node);
+    }
+  }
 
 #if HAVE_GPU
   // Set number of GPU streams to use
@@ -436,58 +747,154 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
       i++;
     }
     state.stream_assignment.push_back(temp);
-    for(auto i:state.stream_assignment) std::cout<<i<<"!!!!\n";
-  }
-  auto parallel_threadnum = std::getenv(HOROVOD_PARALLEL_THREADNUM);
-  if(parallel_threadnum != nullptr){
-    int i=0,temp=0;
-    while(i<strlen(parallel_threadnum)){
-        temp = temp*10 + parallel_threadnum[i]-'0';
-        i++;
+    for (auto assignment : state.stream_assignment) {
+      LOG(DEBUG) << "Stream assignment: " << assignment;
     }
-    state.parallel_threadnum = temp;
-    std::cout<<"parallel threadnum "<< temp<<"\n";
   }
-  else{
-    std::cout<<"fzhGG\n";
+#if HAVE_NCCL
+  nccl_context.nccl_comms.resize(state.num_nccl_streams);
+  nccl_context.nccl_cross_comms.resize(state.num_nccl_streams);
+  // The coordinator decides which groups are split, every rank needs the
+  // communicators of the second parts.
+  if (std::getenv(HOROVOD_LIBRA_SPLIT_BLOCK_NUM) != nullptr ||
+      std::getenv(HOROVOD_PARALLEL_OR_NOT) != nullptr) {
+    nccl_context.nccl_split_comms.resize(state.num_nccl_streams);
+  }
+  auto nccl_tunings = std::getenv(HOROVOD_LIBRA_NCCL_TUNINGS);
+  if (nccl_tunings != nullptr) {
+    if (ParseNCCLTunings(nccl_tunings, nccl_context.nccl_tunings)) {
+      nccl_context.nccl_tuned_comms.resize(nccl_context.nccl_tunings.size());
+      for (auto& tuned_comms : nccl_context.nccl_tuned_comms) {
+        tuned_comms.resize(state.num_nccl_streams);
+      }
+    } else {
+      LOG(WARNING) << "Ignoring invalid " << HOROVOD_LIBRA_NCCL_TUNINGS << " "
+                   << nccl_tunings;
+    }
   }
-
-  auto is_para = std::getenv(HOROVOD_PARALLEL_OR_NOT);
-  if(is_para != nullptr){
-    state.is_para = true;
-    int i=0,temp=0;
-    while(i<strlen(is_para)){
-        temp = temp*10 + is_para[i]-'0';
-        i++;
+  // Fabrics map traffic classes to service levels, so that the groups of
+  // different streams can be routed over different rails.
+  auto traffic_classes = std::getenv(HOROVOD_NCCL_STREAM_TRAFFIC_CLASS);
+  if (traffic_classes != nullptr) {
+    std::stringstream stream(traffic_classes);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+      nccl_context.stream_traffic_classes.push_back(std::atoi(entry.c_str()));
     }
-    state.fake_num = temp;
-    std::cout<<"fake_num"<< temp<<"\n";
   }
-
-
-
-#if HAVE_NCCL
-  nccl_context.nccl_comms.resize(state.num_nccl_streams);
+#if HAVE_ROCM
+  // The groups running at the same time share HOROVOD_LIBRA_SM_SHARE of the
+  // CUs, as the channel allocator shares the SMs on CUDA.
+  if (GetBoolEnvOrDefault(HOROVOD_LIBRA_CHANNEL_ALLOCATOR, true)) {
+    int concurrent_groups = std::max(
+        1, GetIntEnvOrDefault(HOROVOD_LIBRA_CONCURRENT_GROUPS,
+                              state.num_nccl_streams));
+    nccl_context.rccl_max_channels = std::max(
+        1, (int)(gpu_context.GetMultiProcessorCount(gpu_context.GetDevice()) *
+                 GetDoubleEnvOrDefault(HOROVOD_LIBRA_SM_SHARE, 0.25)) /
+               concurrent_groups);
+  }
+  nccl_context.rccl_max_channels = GetIntEnvOrDefault(
+      HOROVOD_RCCL_MAX_CHANNELS, nccl_context.rccl_max_channels);
+  LOG(DEBUG) << "RCCL channels per communicator: "
+             << nccl_context.rccl_max_channels;
 #endif
-  gpu_context.streams.resize(state.num_nccl_streams+50);
-
-  // Create finalizer thread pool (one thread per stream)
-  gpu_context.finalizer_thread_pool.create(state.num_nccl_streams+50);
+  nccl_context.buffer_registry.SetEnabled(
+      GetBoolEnvOrDefault(HOROVOD_NCCL_REGISTER_BUFFERS, false));
+  if (nccl_context.buffer_registry.IsEnabled()) {
+    state.fusion_buffer.SetReleaseCallback([](const void* base) {
+      nccl_context.buffer_registry.Release(base);
+    });
+  }
+#endif
+  gpu_context.stream_pool.Initialize(state.num_nccl_streams+50);
+  gpu_context.stream_pool.SetPriorityPolicy(ParseStreamPriorityPolicyFromEnv());
+  gpu_context.stream_pool.SetHighPriorityLayers(
+      GetIntEnvOrDefault(HOROVOD_GPU_STREAM_HIGH_PRIORITY_LAYERS, 1));
+  gpu_context.event_wait_policy.spin_us =
+      std::max(0, GetIntEnvOrDefault(HOROVOD_GPU_EVENT_SPIN_US, 50));
+  gpu_context.event_wait_policy.error_check_ms =
+      std::max(0.0, GetDoubleEnvOrDefault(HOROVOD_GPU_ERROR_CHECK_MS, 5));
+#if HAVE_CUDA
+  // Fusion and scratch buffers from a stream-ordered pool per device, which
+  // keeps freed memory cached up to the release threshold, so that resizing
+  // the fusion buffers while autotuning does not go through the framework.
+  gpu_context.memory_pool = GetBoolEnvOrDefault(HOROVOD_CUDA_MEMORY_POOL, false);
+  int memory_pool_release_mb =
+      GetIntEnvOrDefault(HOROVOD_CUDA_MEMORY_POOL_RELEASE_MB, -1);
+  gpu_context.memory_pool_release_bytes =
+      memory_pool_release_mb < 0 ? UINT64_MAX
+                                 : (uint64_t)memory_pool_release_mb * 1024 * 1024;
+  if (gpu_context.memory_pool) {
+    state.fusion_buffer.SetDeviceAllocator(
+        [](int device, int64_t size, std::shared_ptr<PersistentBuffer>& buffer) {
+          try {
+            buffer = gpu_context.AllocatePooled(device, size);
+          } catch (const std::exception& ex) {
+            return Status::UnknownError(ex.what());
+          }
+          return Status::OK();
+        });
+  } else {
+    state.fusion_buffer.SetDeviceAllocator(nullptr);
+  }
+#endif
+  gpu_context.last_slot_streams.resize(state.num_nccl_streams+50);
+
+  // Create finalizer thread pool, one thread per stream slot. The operations of
+  // a slot complete in order, so its thread polls their events in turn. The
+  // finalizer threads share the core or the NUMA node of the background
+  // thread, if it's set. A busy polling background thread keeps its core.
+  bool share_core = thread_affinity >= 0 && !state.busy_poll;
+  gpu_context.finalizer_thread_pool.create(
+      state.num_nccl_streams, [thread_affinity, share_core, numa_node](int) {
+        if (share_core) {
+          set_affinity(thread_affinity, "Finalizer");
+        } else if (numa_node >= 0) {
+          set_numa_affinity(numa_node, "Finalizer");
+        }
+      });
 #endif
 
-  // Open the timeline file on coordinator.
+  // Open the timeline file on coordinator, or on every rank if it's set.
   auto timeline_env = std::getenv(HOROVOD_TIMELINE);
   auto horovod_timeline = timeline_env != nullptr ? std::string(timeline_env) : std::string("");
   bool should_enable_timeline = false;
-  if (is_coordinator) {
-    state.timeline.Initialize(horovod_timeline,
-                              static_cast<unsigned int>(size));
+  state.timeline_all_ranks =
+      GetBoolEnvOrDefault(HOROVOD_TIMELINE_ALL_RANKS, false);
+  state.timeline.SetFormat(ParseTimelineFormatFromEnv());
+  if (is_coordinator || state.timeline_all_ranks) {
+    state.timeline.Initialize(
+        TimelineFileForRank(horovod_timeline, state.controller->GetRank()),
+        static_cast<unsigned int>(size),
+        state.controller->ClockOffsetMicros());
+  }
+  if (GetBoolEnvOrDefault(HOROVOD_TIMELINE_NVTX, false)) {
+    state.timeline.InitializeNvtx(static_cast<unsigned int>(size));
   }
   if (horovod_timeline != "") {
       should_enable_timeline = true;
   }
   state.controller->SetTimelineEnabled(should_enable_timeline);
 
+  // Only write sampled steps or triggered windows to the timeline, if set.
+  state.timeline_sampler.SetStepSampling(
+      GetIntEnvOrDefault(HOROVOD_TIMELINE_SAMPLE_EVERY_STEPS, 0),
+      GetIntEnvOrDefault(HOROVOD_TIMELINE_SAMPLE_STEPS, 1));
+  auto trigger_file = std::getenv(HOROVOD_TIMELINE_TRIGGER_FILE);
+  state.timeline_sampler.SetTrigger(
+      trigger_file != nullptr ? std::string(trigger_file) : std::string(""),
+      GetDoubleEnvOrDefault(HOROVOD_TIMELINE_TRIGGER_SECONDS, 10.0));
+  state.timeline.SetRecording(!state.timeline_sampler.IsEnabled());
+
+  // Record the arrival of the tensors of every step, if set.
+  auto tensor_trace = std::getenv(HOROVOD_TENSOR_TRACE);
+  if (tensor_trace != nullptr) {
+    state.tensor_queue.trace().Initialize(tensor_trace,
+                                          state.controller->GetRank(),
+                                          state.controller->ClockOffsetMicros());
+  }
+
   ParseStallInspectorFromEnv(state.controller->GetStallInspector());
   bool mark_cycles = false;
   SetBoolFromEnv(HOROVOD_TIMELINE_MARK_CYCLES, mark_cycles,
@@ -503,6 +910,18 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
     state.parameter_manager.SetTensorFusionThresholdBytes(threshold, true);
   }
 
+  // Keep the overlap stats of the last steps, if it's set.
+  state.overlap_stats.SetMaxSteps(
+      GetIntEnvOrDefault(HOROVOD_OVERLAP_STATS_STEPS, 0));
+
+  // Split large allreduce tensors into parts, if it's set.
+  auto horovod_partition_bytes = std::getenv(HOROVOD_FUSION_PARTITION_BYTES);
+  if (horovod_partition_bytes != nullptr) {
+    state.partition_bytes =
+        std::max((int64_t)0, (int64_t)std::strtoll(horovod_partition_bytes,
+                                                   nullptr, 10));
+  }
+
   // Override the cycle time.
   state.parameter_manager.SetCycleTimeMs(5);
   auto horovod_cycle_time = std::getenv(HOROVOD_CYCLE_TIME);
@@ -510,6 +929,52 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
     state.parameter_manager.SetCycleTimeMs(
         std::strtof(horovod_cycle_time, nullptr), true);
   }
+  if (state.busy_poll) {
+    // The autotuner does not add a sleep either.
+    state.parameter_manager.SetCycleTimeMs(0, true);
+  }
+
+  state.batch_d2d_memcopies = GetBoolEnvOrDefault(HOROVOD_BATCH_D2D_MEMCOPIES,
+                                                  true);
+  state.fusion_double_buffering =
+      GetBoolEnvOrDefault(HOROVOD_FUSION_DOUBLE_BUFFERING, false);
+  state.fusion_compression = ParseFusionCompressionFromEnv();
+  state.fusion_buffer.SetSlabBytes(
+      (int64_t)GetIntEnvOrDefault(HOROVOD_FUSION_BUFFER_SLAB_MB, 0) * 1024 * 1024);
+  // CPU fusion buffers on huge pages, faulted in when they are allocated
+  // rather than on the first touch of an allreduce.
+  state.host_page_size = ParseHostPageSizeFromEnv();
+  state.host_prefault = GetBoolEnvOrDefault(HOROVOD_HOST_PREFAULT, false);
+  if (state.host_page_size != HostPageSize::DEFAULT || state.host_prefault) {
+    state.fusion_buffer.SetHostAllocator(
+        [&state](int64_t size, std::shared_ptr<PersistentBuffer>& buffer) {
+          auto data = AllocateHostMemory(size, state.host_page_size,
+                                         state.host_prefault);
+          if (data == nullptr) {
+            return Status::UnknownError("Cannot allocate " +
+                                        std::to_string(size) +
+                                        " bytes of host memory for the fusion buffer.");
+          }
+          buffer = std::make_shared<HostBuffer>(std::move(data));
+          return Status::OK();
+        });
+  }
+  state.pinned_host_staging =
+      GetBoolEnvOrDefault(HOROVOD_PINNED_HOST_STAGING, true);
+  state.host_staging_chunk_bytes =
+      std::max(0, GetIntEnvOrDefault(HOROVOD_HOST_STAGING_CHUNK_MB, 4)) *
+      (int64_t)1024 * 1024;
+  state.mpi_allreduce_chunk_bytes =
+      std::max(0, GetIntEnvOrDefault(HOROVOD_MPI_ALLREDUCE_CHUNK_MB, 0)) *
+      (int64_t)1024 * 1024;
+  SetCPUReductionThreads(GetIntEnvOrDefault(HOROVOD_CPU_REDUCTION_THREADS, 1));
+
+  // Wake up on submitted tensors and back off while idle, if it's set.
+  state.adaptive_cycle_time = !state.busy_poll &&
+                              GetBoolEnvOrDefault(HOROVOD_ADAPTIVE_CYCLE_TIME,
+                                                  false);
+  state.adaptive_cycle_time_max_ms = GetDoubleEnvOrDefault(
+      HOROVOD_ADAPTIVE_CYCLE_TIME_MAX, state.adaptive_cycle_time_max_ms);
 
   // Override response cache capacity, if it's set.
   state.parameter_manager.SetCacheEnabled(true);
@@ -521,6 +986,24 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   }
   state.response_cache.set_capacity(
       (int)state.parameter_manager.CacheEnabled() * state.cache_capacity);
+  // Grow the response cache instead of evicting entries, up to this size.
+  state.response_cache.set_max_capacity(
+      GetIntEnvOrDefault(HOROVOD_CACHE_CAPACITY_MAX, 65536));
+  // Cache allreduces by name and type only, for tensors whose shape changes
+  // from step to step.
+  state.response_cache.set_dynamic_shapes(
+      GetBoolEnvOrDefault(HOROVOD_CACHE_DYNAMIC_SHAPES, false));
+
+  // Set the size up to which Gloo allreduces use bcube instead of ring. It's
+  // tuned only if Gloo runs the CPU operations.
+  auto horovod_gloo_bcube_threshold = std::getenv(HOROVOD_GLOO_BCUBE_THRESHOLD);
+  state.parameter_manager.SetGlooBcubeThresholdBytes(0);
+  if (horovod_gloo_bcube_threshold != nullptr) {
+    state.parameter_manager.SetGlooBcubeThresholdBytes(
+        std::strtoll(horovod_gloo_bcube_threshold, nullptr, 10), true);
+  } else if (state.cpu_operation != LibType::GLOO) {
+    state.parameter_manager.SetGlooBcubeThresholdBytes(0, true);
+  }
 
   // Set flag for hierarchical allgather. Ignore if Horovod is running on a
   // single node.
@@ -532,6 +1015,54 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
                  (size != local_size);
     state.parameter_manager.SetHierarchicalAllgather(value, true);
   }
+  // Set flag for the NCCL-only hierarchical allreduce. Ignore if Horovod is
+  // running on a single node.
+  state.torus_allreduce = GetBoolEnvOrDefault(HOROVOD_TORUS_ALLREDUCE, false) &&
+                          (size != local_size);
+
+  // Set flag for exchanging alltoall splits on the device. It needs the
+  // alltoall to run with NCCL send and receive.
+#if HAVE_NCCL && HOROVOD_GPU_ALLTOALL == 'N' && defined(NCCL_P2P_SUPPORTED)
+  state.alltoall_device_splits =
+      GetBoolEnvOrDefault(HOROVOD_ALLTOALL_DEVICE_SPLITS, false);
+#endif
+
+  state.nccl_group_launch =
+      GetBoolEnvOrDefault(HOROVOD_NCCL_GROUP_LAUNCH, false);
+
+  // Set flag for replaying steady-state NCCL allreduces from CUDA graphs. It
+  // needs a NCCL that can be captured into graphs.
+#if HAVE_NCCL && defined(NCCL_GRAPH_SUPPORTED)
+  state.gpu_graphs = GetBoolEnvOrDefault(HOROVOD_CUDA_GRAPHS, false);
+#endif
+
+  // Set flag for hierarchical alltoall. Ignore if Horovod is running on a
+  // single node, or if the ranks are not placed node by node; all ranks
+  // have to agree on the latter.
+  if (GetBoolEnvOrDefault(HOROVOD_HIERARCHICAL_ALLTOALL, false) &&
+      size != local_size) {
+    std::vector<long long> bitvector{
+        RanksPlacedByNode(*state.controller) ? 1 : 0};
+    state.controller->CrossRankBitwiseAnd(bitvector, 1);
+    state.hierarchical_alltoall = bitvector[0] != 0;
+    if (!state.hierarchical_alltoall) {
+      LOG(WARNING, state.controller->GetRank())
+          << HOROVOD_HIERARCHICAL_ALLTOALL
+          << " is ignored, ranks are not placed node by node.";
+    }
+  }
+
+  // The NCCL hierarchical allgather needs the ranks to be placed node by
+  // node, otherwise hierarchical allgathers of GPU tensors run with MPI.
+#if HAVE_NCCL && HOROVOD_GPU_ALLGATHER == 'N'
+  if (state.parameter_manager.HierarchicalAllgather()) {
+    std::vector<long long> bitvector{
+        RanksPlacedByNode(*state.controller) ? 1 : 0};
+    state.controller->CrossRankBitwiseAnd(bitvector, 1);
+    state.nccl_hierarchical_allgather = bitvector[0] != 0;
+  }
+#endif
+
   // Set flag for hierarchical allreduce. Ignore if Horovod is running on a
   // single node.
   auto horovod_hierarchical_allreduce =
@@ -543,8 +1074,8 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
     state.parameter_manager.SetHierarchicalAllreduce(value, true);
   }
 
-#if HOROVOD_GPU_ALLREDUCE != 'N' && HOROVOD_GPU_ALLREDUCE != 'D'
-  // Hierarchical allreduce is not supported without NCCL or DDL
+#if HOROVOD_GPU_ALLREDUCE != 'N' && HOROVOD_GPU_ALLREDUCE != 'D' && !HAVE_MPI
+  // Hierarchical allreduce is not supported without NCCL, DDL or MPI
   state.parameter_manager.SetHierarchicalAllreduce(false, true);
 #endif
 
@@ -561,6 +1092,19 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
            "allgather and hierarchical allreduce.";
   }
 
+  // The Libra parameters are only tuned for GPU fusion groups.
+  bool libra_tunable = state.controller->FusionGroupsEnabled();
+#if !HAVE_GPU
+  libra_tunable = false;
+#endif
+  state.parameter_manager.SetLibraGroupScale(1, !libra_tunable);
+  // The kernel feedback corrects the blocks of every group on its own.
+  state.parameter_manager.SetLibraBlockScale(
+      1, !libra_tunable ||
+             GetBoolEnvOrDefault(HOROVOD_LIBRA_KERNEL_FEEDBACK, false));
+  state.parameter_manager.SetLibraThreadNum(0, !libra_tunable);
+  state.parameter_manager.SetLibraStreams(0, !libra_tunable);
+
   // Enable auto-tuning.
   auto horovod_autotune = std::getenv(HOROVOD_AUTOTUNE);
   if (horovod_autotune != nullptr &&
@@ -570,6 +1114,27 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
                                        horovod_autotune_log != nullptr
                                            ? std::string(horovod_autotune_log)
                                            : "");
+    auto horovod_autotune_warm_start_file =
+        std::getenv(HOROVOD_AUTOTUNE_WARM_START_FILE);
+    if (horovod_autotune_warm_start_file != nullptr) {
+      state.parameter_manager.SetWarmStartFile(
+          horovod_autotune_warm_start_file,
+          "size=" + std::to_string(state.controller->GetSize()) +
+              ",local_size=" + std::to_string(state.controller->GetLocalSize()) +
+              ",cross_size=" + std::to_string(state.controller->GetCrossSize()));
+    }
+    state.parameter_manager.SetStepTimeScore(ParseAutotuneScoreFromEnv() ==
+                                             AutotuneScore::STEP_TIME);
+    // Every NCCL stream has its own fusion buffer, or two with double
+    // buffering, and the slab is allocated next to them.
+    auto horovod_autotune_memory_budget =
+        std::getenv(HOROVOD_AUTOTUNE_MEMORY_BUDGET);
+    if (horovod_autotune_memory_budget != nullptr) {
+      state.parameter_manager.SetMemoryBudget(
+          std::strtoll(horovod_autotune_memory_budget, nullptr, 10),
+          state.num_nccl_streams * (state.fusion_double_buffering ? 2 : 1),
+          state.fusion_buffer.SlabBytes());
+    }
     state.parameter_manager.SetAutoTuning(true);
   }
 
@@ -578,27 +1143,84 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   if (horovod_adasum_mpi_chunk_size != nullptr) {
     state.adasum_mpi_chunk_size = std::strtol(horovod_adasum_mpi_chunk_size, nullptr, 10);
   }
+  state.adasum_gpu_device_reduction =
+      GetBoolEnvOrDefault(HOROVOD_ADASUM_GPU_DEVICE_REDUCTION, true);
 
   op_manager.reset(CreateOperationManager(state));
+  auto allreduce_dispatch = std::getenv(HOROVOD_ALLREDUCE_DISPATCH);
+  if (allreduce_dispatch != nullptr) {
+    AllreduceDispatchTable table;
+    if (table.Parse(allreduce_dispatch)) {
+      op_manager->SetAllreduceDispatch(std::move(table));
+    } else {
+      LOG(WARNING, state.controller->GetRank())
+          << "Ignoring invalid " << HOROVOD_ALLREDUCE_DISPATCH << " "
+          << allreduce_dispatch;
+    }
+  }
+
+  // Keep the response cache across runs, if it's set.
+  auto horovod_cache_file = std::getenv(HOROVOD_CACHE_FILE);
+  state.response_cache_file =
+      horovod_cache_file != nullptr
+          ? std::string(horovod_cache_file) + "." +
+                std::to_string(state.controller->GetRank())
+          : "";
+  if (!state.response_cache_file.empty()) {
+    LoadResponseCache(state);
+  }
 
   // Signal that initialization is completed.
   state.initialization_done = true;
   LOG(INFO, horovod_global.controller->GetRank()) << "Horovod Initialized";
 
+#if HAVE_NCCL
+  // The warmup runs after horovod_init returned, overlapping the model setup.
+  if (GetBoolEnvOrDefault(HOROVOD_NCCL_EAGER_INIT, false)) {
+    try {
+      WarmUpNCCLComms(state);
+    } catch (const std::exception& ex) {
+      LOG(WARNING) << "NCCL warmup failed: " << ex.what();
+    }
+  }
+#endif
+
   // lyz computation timeline
   
   if (is_coordinator) {
     state.is_coordinator = true;
+  }
+  if (is_coordinator || state.timeline_all_ranks) {
+    state.comp_timeline_running = true;
     state.comp_timeline_thread = std::thread(compTimelineThread, std::ref(state)); 
   }
   
 
+  // Perform responses on an execution thread, if it's set.
+  if (GetBoolEnvOrDefault(HOROVOD_ASYNC_EXECUTION, false)) {
+    state.response_executor.Start([&state](const Response& response) {
+      try {
+        PerformOperation(response, state, false);
+      } catch (const std::exception& ex) {
+        LOG(ERROR) << "Horovod execution thread uncaught exception: "
+                   << ex.what();
+        state.shut_down = true;
+      }
+    }, [numa_node] {
+      // A NUMA node fits both threads, a single core would not.
+      if (numa_node >= 0) {
+        set_numa_affinity(numa_node, "Execution");
+      }
+    });
+  }
+
   // Iterate until shutdown.
   try {
     while (RunLoopOnce(state));
   } catch (const std::exception& ex) {
     LOG(ERROR) << "Horovod background loop uncaught exception: " << ex.what();
   }
+  state.response_executor.Stop();
 
   // Signal that initialization is completed.
   state.comp_timeline_shutdown = true;
@@ -606,6 +1228,7 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
 
     // Finalize all contexts
 #if HAVE_NCCL
+  state.fusion_buffer.SetReleaseCallback(nullptr);
   nccl_context.ShutDown();
 #endif
 
@@ -625,9 +1248,13 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
   for (auto& cb : callbacks) {
     cb(SHUT_DOWN_ERROR);
   }
+  horovod_global.tensor_queue.trace().Shutdown();
 
 #if HAVE_GPU
-  gpu_context.Finalize();
+  // Elastic jobs initialize Horovod again after every reset. The stream pool
+  // and the fusion buffers outlive the background thread anyway, and the
+  // pinned staging buffers are kept for the next initialization too.
+  gpu_context.Finalize(GetBoolEnvOrDefault(HOROVOD_ELASTIC, false));
 #endif
 
 #if HAVE_MPI
@@ -644,35 +1271,34 @@ void BackgroundThreadLoop(HorovodGlobalState& state) {
 
 // lyz computation timeline
 void compTimelineThread(HorovodGlobalState& state) {
-  
+  // Entries taken from state.comp_entries, only touched by this thread.
+  std::vector<TensorTableEntry> tracked_entries;
   try {
     while (!state.comp_timeline_shutdown) {
+      {
+        std::lock_guard<std::mutex> guard(state.comp_timeline_lock);
+        tracked_entries.insert(
+            tracked_entries.end(),
+            std::make_move_iterator(state.comp_entries.begin()),
+            std::make_move_iterator(state.comp_entries.end()));
+        state.comp_entries.clear();
+      }
+      if (tracked_entries.empty()) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(1000));
+        continue;
+      }
       // check readiness of tensor computation results
-      //state.comp_timeline_lock.lock();
-      //auto empty = state.comp_entries.empty();  
-      //state.comp_timeline_lock.unlock();    
-      while (!state.comp_entries.empty()) {
-      state.comp_timeline_lock.lock();
-      for (auto it = state.comp_entries.begin(); it != state.comp_entries.end();) {
+      for (auto it = tracked_entries.begin(); it != tracked_entries.end();) {
         if (it->ready_event->Ready()) {
-          std::string name = it->tensor_name + "_comptimeline";
           state.timeline.ActivityEnd(it->tensor_name + "_comptimeline");
-          if(ready_map.find(name) == ready_map.end()){
-            ready_map.emplace(name,true);
-          }
-          else{
-            ready_map[name] = true;
-          }
-          it = state.comp_entries.erase(it);
+          it->comp_ready->store(true);
+          it = tracked_entries.erase(it);
         } else {
           ++it;
         }
       }
-      state.comp_timeline_lock.unlock();
       std::this_thread::sleep_for(std::chrono::nanoseconds(100));
     }
-    std::this_thread::sleep_for(std::chrono::nanoseconds(1000));
-    }
   } catch (const std::exception& ex) {
     LOG(ERROR) << "Computation timeline threadd uncaught exception: " << ex.what();
   }
@@ -682,12 +1308,28 @@ void compTimelineThread(HorovodGlobalState& state) {
 bool RunLoopOnce(HorovodGlobalState& state) {
   // This delay determines thread frequency and communication message latency
   auto start_time = std::chrono::steady_clock::now();
-  auto sleep_duration = state.last_cycle_start +
-                        std::chrono::microseconds(long(
-                            state.parameter_manager.CycleTimeMs() * 1000.)) -
-                        start_time;
-  if (sleep_duration > std::chrono::steady_clock::duration::zero()) {
-    std::this_thread::sleep_for(sleep_duration);
+  if (state.adaptive_cycle_time) {
+    // Tensors that are still being negotiated or performed may need a cycle
+    // that no new tensor triggers, so only back off if there are none.
+    double cycle_time_ms = state.parameter_manager.CycleTimeMs();
+    if (state.tensor_queue.IsIdle()) {
+      state.adaptive_cycle_time_ms =
+          std::min(std::max(state.adaptive_cycle_time_ms * 2, cycle_time_ms),
+                   std::max(state.adaptive_cycle_time_max_ms, cycle_time_ms));
+    } else {
+      state.adaptive_cycle_time_ms = cycle_time_ms;
+    }
+    state.tensor_queue.WaitForTensors(
+        state.last_cycle_start +
+        std::chrono::microseconds(long(state.adaptive_cycle_time_ms * 1000.)));
+  } else {
+    auto sleep_duration = state.last_cycle_start +
+                          std::chrono::microseconds(long(
+                              state.parameter_manager.CycleTimeMs() * 1000.)) -
+                          start_time;
+    if (sleep_duration > std::chrono::steady_clock::duration::zero()) {
+      std::this_thread::sleep_for(sleep_duration);
+    }
   }
   state.last_cycle_start = std::chrono::steady_clock::now();
 
@@ -696,41 +1338,130 @@ bool RunLoopOnce(HorovodGlobalState& state) {
     state.timeline.MarkCycleStart();
   }
 
+  // The coordinator changes the autotuned parameters while negotiating a
+  // parameter sync, finish the responses that use the old ones.
+  if (state.controller->ParameterSyncRequested() &&
+      state.response_executor.IsRunning()) {
+    state.response_executor.Drain();
+  }
   auto response_list =
       state.controller->ComputeResponseList(horovod_global.shut_down, state);
+  if (!response_list.parameters().empty()) {
+    // Workers only learn about a parameter sync the coordinator requested on
+    // its own when the parameters arrive.
+    if (state.response_executor.IsRunning()) {
+      state.response_executor.Drain();
+    }
+    state.controller->ApplyParameters(response_list);
+  }
+  // All ranks receive the responses of every process set, the ranks outside
+  // a set have no tensors for them.
+  if (state.controller->GetProcessSets().NumSets() > 0) {
+    auto& responses = response_list.mutable_responses();
+    auto& process_sets = state.controller->GetProcessSets();
+    int rank = state.controller->GetRank();
+    responses.erase(
+        std::remove_if(responses.begin(), responses.end(),
+                       [&](const Response& response) {
+                         return response.process_set_id() != 0 &&
+                                process_sets.RankInSet(
+                                    response.process_set_id(), rank) < 0;
+                       }),
+        responses.end());
+  }
+  state.metrics.negotiation_time_seconds.Observe(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    state.last_cycle_start)
+          .count());
 
   state.mark_cycles_in_timeline = state.controller->MarkCyclesInTimelinePending();
   state.controller->SynchronizeTimelineEnabled();
+  if (state.timeline_sampler.IsEnabled()) {
+    state.timeline.SetRecording(state.timeline_sampler.Update(response_list));
+  }
 
   // Get tensor name and size data for autotuning.
   int64_t total_tensor_size = 0;
   std::vector<std::string> tensor_names;
-  if (state.parameter_manager.IsAutoTuning()) {
+  std::vector<int64_t> tensor_sizes;
+  if (state.parameter_manager.IsSampling()) {
     total_tensor_size = horovod_global.tensor_queue.GetTensorDataForAutotuner(
-        response_list, tensor_names);
+        response_list, tensor_names, tensor_sizes);
   }
 
   // Perform the collective operation. All nodes should end up performing
   // the same operation.
   int rank = state.controller->GetRank();
-  for (auto& response : response_list.responses()) {
-    LOG(TRACE, rank) << "Performing " << response.tensor_names_string();
-    LOG(TRACE, rank) << "Processing " << response.tensor_names().size()
-                     << " tensors";
-    PerformOperation(response,horovod_global);
-    LOG(TRACE, rank) << "Finished performing "
-                     << response.tensor_names_string();
+  if (state.response_executor.IsRunning() &&
+      CanPerformAsync(response_list, state)) {
+    state.response_executor.Enqueue(response_list);
+  } else {
+    // Keep the order of the responses negotiated earlier.
+    if (state.response_executor.IsRunning()) {
+      state.response_executor.Drain();
+    }
+#if HAVE_NCCL
+    if (state.nccl_group_launch) {
+      nccl_context.launch_batch.Start();
+    }
+#endif
+    for (auto& response : response_list.responses()) {
+      LOG(TRACE, rank) << "Performing " << response.tensor_names_string();
+      LOG(TRACE, rank) << "Processing " << response.tensor_names().size()
+                       << " tensors";
+      PerformOperation(response, horovod_global, state.joined);
+      LOG(TRACE, rank) << "Finished performing "
+                       << response.tensor_names_string();
+    }
+#if HAVE_NCCL
+    nccl_context.launch_batch.Stop();
+#endif
   }
 
-  if (state.parameter_manager.IsAutoTuning()) {
+  if (state.parameter_manager.IsSampling()) {
     bool should_sync =
-        state.parameter_manager.Update(tensor_names, total_tensor_size);
+        state.parameter_manager.Update(tensor_names, tensor_sizes,
+                                       total_tensor_size);
 
     if (should_sync) {
       state.controller->SynchronizeParameters();
     }
   }
 
+  // Save the response cache once it did not change for a cycle, which is after
+  // the new tensors of a step were added to it.
+  if (!state.response_cache_file.empty()) {
+    auto generation = state.response_cache.generation();
+    if (generation == state.response_cache_generation &&
+        generation != state.saved_response_cache_generation &&
+        state.response_cache.num_active_bits() > 0) {
+      state.response_cache.save(state.response_cache_file,
+                                state.controller->GetSize());
+      state.saved_response_cache_generation = generation;
+    }
+    state.response_cache_generation = generation;
+  }
+
+  if (state.release_fusion_buffers.exchange(false)) {
+    // The responses in flight pack into the buffers.
+    if (state.response_executor.IsRunning()) {
+      state.response_executor.Drain();
+    }
+    state.fusion_buffer.ReleaseBuffers();
+#if HAVE_GPU
+    if (gpu_context.memory_pool) {
+      gpu_context.TrimMemoryPools();
+    }
+#endif
+    LOG(DEBUG, rank) << "Released the fusion buffers, "
+                     << state.fusion_buffer.AllocatedBytes()
+                     << " bytes still in use.";
+  }
+
+  state.metrics.cycle_time_seconds.Observe(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    start_time)
+          .count());
   return !response_list.shutdown();
 }
 
@@ -752,7 +1483,8 @@ void InitializeHorovodOnce(const int* ranks, int nranks) {
       horovod_global.controller.reset(new MPIController(
           horovod_global.response_cache,
           horovod_global.tensor_queue, horovod_global.timeline,
-          horovod_global.parameter_manager, mpi_context));
+          horovod_global.parameter_manager, horovod_global.metrics,
+          mpi_context));
       horovod_global.controller->SetRanks(ranks, nranks);
     }
 #endif
@@ -768,7 +1500,8 @@ void InitializeHorovodOnce(const int* ranks, int nranks) {
       horovod_global.controller.reset(new GlooController(
           horovod_global.response_cache,
           horovod_global.tensor_queue, horovod_global.timeline,
-          horovod_global.parameter_manager, gloo_context));
+          horovod_global.parameter_manager, horovod_global.metrics,
+          gloo_context));
     }
 #endif
     // Reset initialization flag
@@ -793,6 +1526,10 @@ Status CheckInitialized() {
   return Status::OK();
 }
 
+bool AlltoallDeviceSplits() {
+  return horovod_global.alltoall_device_splits;
+}
+
 extern "C" {
 
 void horovod_init(const int* ranks, int nranks) {
@@ -812,6 +1549,10 @@ void horovod_shutdown() {
     horovod_global.shut_down = true;
     horovod_global.background_thread.join();
 
+    // The bits of the cached responses must agree on all ranks, and the ranks
+    // joining after an elastic reset start without any.
+    horovod_global.response_cache.clear();
+
     // Reset the initialization flag to allow restarting with horovod_init(...)
     horovod_global.initialize_flag.clear();
     horovod_global.shut_down = false;
@@ -832,9 +1573,13 @@ bool horovod_start_timeline(const char* file_name, bool mark_cycles) {
     LOG(INFO) << " Timeline is already enabled. Please stop timeline before restarting it.";
     return true;
   }
-  if (is_coordinator) {
-    horovod_global.timeline.Initialize(std::string(file_name), horovod_global.controller->GetSize());
-    horovod_global.timeline.SetPendingTimelineFile(std::string(file_name));
+  if (is_coordinator || horovod_global.timeline_all_ranks) {
+    auto rank_file_name = TimelineFileForRank(
+        std::string(file_name), horovod_global.controller->GetRank());
+    horovod_global.timeline.Initialize(
+        rank_file_name, horovod_global.controller->GetSize(),
+        horovod_global.controller->ClockOffsetMicros());
+    horovod_global.timeline.SetPendingTimelineFile(rank_file_name);
   }
   horovod_global.controller->SetTimelineEnabledPending(true);
   horovod_global.controller->SetMarkCyclesInTimelinePending(mark_cycles);
@@ -855,7 +1600,7 @@ bool horovod_stop_timeline() {
     return true;
   }
   bool is_coordinator = horovod_global.controller->IsCoordinator();
-  if (is_coordinator) {
+  if (is_coordinator || horovod_global.timeline_all_ranks) {
       horovod_global.timeline.SetPendingTimelineFile(std::string(""));
   }
   horovod_global.controller->SetTimelineEnabledPending(false);
@@ -867,6 +1612,94 @@ bool horovod_stop_timeline() {
   return true;
 }
 
+bool horovod_step_completed() {
+  if (!horovod_global.initialization_done) {
+    return false;
+  }
+  horovod_global.parameter_manager.StepCompleted();
+  return true;
+}
+
+bool horovod_flush_fusion_groups() {
+  if (!horovod_global.initialization_done) {
+    return false;
+  }
+  horovod_global.controller->RequestFusionGroupFlush();
+  return true;
+}
+
+bool horovod_release_fusion_buffers() {
+  if (!horovod_global.initialization_done) {
+    return false;
+  }
+  horovod_global.release_fusion_buffers = true;
+  return true;
+}
+
+int64_t horovod_fusion_buffer_bytes() {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  return horovod_global.fusion_buffer.AllocatedBytes();
+}
+
+const char* horovod_overlap_stats() {
+  if (!horovod_global.initialization_done) {
+    return nullptr;
+  }
+  static thread_local std::string overlap_stats_json;
+  overlap_stats_json = horovod_global.overlap_stats.StepsAsJson();
+  return overlap_stats_json.c_str();
+}
+
+const char* horovod_metrics() {
+  if (!horovod_global.initialization_done) {
+    return nullptr;
+  }
+  static thread_local std::string metrics_text;
+  horovod_global.metrics.fusion_buffer_bytes.Set(
+      horovod_global.fusion_buffer.AllocatedBytes());
+  metrics_text = horovod_global.metrics.registry.ToPrometheusText();
+  return metrics_text.c_str();
+}
+
+int horovod_straggler_scores(double* scores, int size) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  auto straggler_scores =
+      horovod_global.controller->GetStallInspector().GetStragglerScores();
+  int count = std::min(size, static_cast<int>(straggler_scores.size()));
+  std::copy(straggler_scores.begin(), straggler_scores.begin() + count,
+            scores);
+  return count;
+}
+
+int horovod_process_set_size(int process_set_id) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  auto& process_sets = horovod_global.controller->GetProcessSets();
+  if (process_set_id == 0) {
+    return horovod_global.controller->GetSize();
+  }
+  return process_sets.IsValid(process_set_id)
+             ? process_sets.Size(process_set_id)
+             : 0;
+}
+
+int horovod_process_set_rank(int process_set_id) {
+  if (!horovod_global.initialization_done) {
+    return -1;
+  }
+  auto& process_sets = horovod_global.controller->GetProcessSets();
+  if (!process_sets.IsValid(process_set_id)) {
+    return -1;
+  }
+  return process_sets.RankInSet(process_set_id,
+                                horovod_global.controller->GetRank());
+}
+
 int horovod_rank() {
   if (!horovod_global.initialization_done) {
     return -1;
@@ -999,26 +1832,21 @@ int horovod_reduce_op_adasum() {
 
 }
 
-// Contexts and controller must be initialized and the background thread
-// must be running before this function is called.
-Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
-                              std::shared_ptr<Tensor> tensor,
-                              std::shared_ptr<Tensor> output,
-                              std::shared_ptr<ReadyEvent> ready_event,
-                              const std::string name, const int device,
-                              StatusCallback callback,
-                              ReduceOp reduce_op,
-                              double prescale_factor,
-                              double postscale_factor) {
-  Status status;
+namespace {
 
+// Fills in the request and the tensor table entry of an allreduce.
+Status PrepareAllreduceRequest(const std::string& name, DataType dtype,
+                               const TensorShape& shape, const int device,
+                               ReduceOp reduce_op, double prescale_factor,
+                               double postscale_factor, int32_t priority,
+                               Request& message) {
   if (reduce_op == ReduceOp::AVERAGE) {
 #if !HAVE_ROCM
     // Averaging happens via postscale_factor
     postscale_factor /= horovod_global.controller->GetSize();
 #else
     LOG(ERROR, horovod_global.controller->GetRank()) << "Enqueuing AVERAGE allreduce is not allowed.";
-    return status.Aborted("AVERAGE not allowed.");
+    return Status::Aborted("AVERAGE not allowed.");
 #endif
   } else if (reduce_op == ReduceOp::ADASUM) {
 #if HAVE_NCCL && !HAVE_ROCM
@@ -1028,23 +1856,31 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
     }
 #endif
   }
-  Request message;
   message.set_request_rank(horovod_global.controller->GetRank());
   message.set_tensor_name(name);
-  message.set_tensor_type(tensor->dtype());
+  message.set_tensor_type(dtype);
   message.set_device(device);
   message.set_prescale_factor(prescale_factor);
   message.set_postscale_factor(postscale_factor);
+  message.set_priority(priority);
   if (reduce_op == ReduceOp::ADASUM) {
     message.set_request_type(Request::ADASUM);
   } else {
     message.set_request_type(Request::ALLREDUCE);
   }
-  for (int i = 0; i < tensor->shape().dims(); ++i) {
-    message.add_tensor_shape((int64_t)tensor->shape().dim_size(i));
+  for (int i = 0; i < shape.dims(); ++i) {
+    message.add_tensor_shape((int64_t)shape.dim_size(i));
   }
+  return Status::OK();
+}
 
-  TensorTableEntry e;
+void PrepareAllreduceEntry(std::shared_ptr<OpContext> context,
+                           std::shared_ptr<Tensor> tensor,
+                           std::shared_ptr<Tensor> output,
+                           std::shared_ptr<ReadyEvent> ready_event,
+                           const std::string& name, const int device,
+                           StatusCallback callback, CompletionBatcher* batcher,
+                           int batch_key, TensorTableEntry& e) {
   e.tensor_name = name;
   e.context = context;
   e.tensor = tensor;
@@ -1052,18 +1888,229 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
   e.ready_event = ready_event;
   e.device = device;
   e.callback = callback;
+  e.batcher = batcher;
+  e.batch_key = batch_key;
+  TrackOverlapStats(e);
 
   // lyz computation timeline - add the entry to the timeline queue
-  //if ()
-  if (horovod_global.is_coordinator) {
+  // Timeline::Initialized() is true as soon as the writer started, also
+  // without a file, so whether the timeline is enabled is checked instead.
+  if (horovod_global.comp_timeline_running &&
+      horovod_global.controller->TimeLineEnabled()) {
     if (ready_event != nullptr) {
-        horovod_global.comp_timeline_lock.lock();
-        horovod_global.comp_entries.push_back(e);
+        e.comp_ready = std::make_shared<std::atomic_bool>(false);
         horovod_global.timeline.ActivityStart(name + "_comptimeline", WAIT_FOR_DATA);
-        horovod_global.comp_timeline_lock.unlock();
-        //horovod_global.timeline.ActivityStart(name + "_comptimeline", WAIT_FOR_DATA);
+        std::lock_guard<std::mutex> guard(horovod_global.comp_timeline_lock);
+        horovod_global.comp_entries.push_back(e);
     }
   }
+}
+
+Status PrepareTensorAllreduce(std::shared_ptr<OpContext> context,
+                              std::shared_ptr<Tensor> tensor,
+                              std::shared_ptr<Tensor> output,
+                              std::shared_ptr<ReadyEvent> ready_event,
+                              const std::string& name, const int device,
+                              StatusCallback callback, ReduceOp reduce_op,
+                              double prescale_factor, double postscale_factor,
+                              int32_t priority, CompletionBatcher* batcher,
+                              int batch_key, Request& message,
+                              TensorTableEntry& e) {
+  Status status = PrepareAllreduceRequest(
+      name, tensor->dtype(), tensor->shape(), device, reduce_op,
+      prescale_factor, postscale_factor, priority, message);
+  if (!status.ok()) {
+    return status;
+  }
+  PrepareAllreduceEntry(context, tensor, output, ready_event, name, device,
+                        callback, batcher, batch_key, e);
+  return Status::OK();
+}
+
+// The squared norm of an allreduce and whether its output is finite are
+// computed by the CUDA kernels that copy it out of the fusion buffer.
+Status CheckOutputStatistics(const Tensor& tensor, int device,
+                             ReduceOp reduce_op,
+                             const std::shared_ptr<Tensor>& norm_sqrd,
+                             const std::shared_ptr<Tensor>& found_inf) {
+  if (norm_sqrd == nullptr && found_inf == nullptr) {
+    return Status::OK();
+  }
+#if HAVE_CUDA
+  auto dtype = tensor.dtype();
+  if (device == CPU_DEVICE_ID || reduce_op == ReduceOp::ADASUM ||
+      (dtype != HOROVOD_FLOAT16 && dtype != HOROVOD_BFLOAT16 &&
+       dtype != HOROVOD_FLOAT32 && dtype != HOROVOD_FLOAT64)) {
+    return Status::InvalidArgument(
+        "Norms and overflows are only computed for floating point allreduces "
+        "on GPUs, without Adasum.");
+  }
+  if (norm_sqrd != nullptr && (norm_sqrd->dtype() != HOROVOD_FLOAT64 ||
+                               norm_sqrd->shape().num_elements() != 1)) {
+    return Status::InvalidArgument(
+        "The norm of an allreduce must be added to a float64 scalar.");
+  }
+  if (found_inf != nullptr && (found_inf->dtype() != HOROVOD_FLOAT32 ||
+                               found_inf->shape().num_elements() != 1)) {
+    return Status::InvalidArgument(
+        "The overflow flag of an allreduce must be a float32 scalar.");
+  }
+  return Status::OK();
+#else
+  return Status::InvalidArgument(
+      "Norms and overflows of allreduces are only computed on CUDA devices.");
+#endif
+}
+
+// The optimizer step of an allreduce runs on its GPU stream, on tensors of
+// the type and shape of its output.
+Status CheckOptimizerStep(const Tensor& tensor, int device, ReduceOp reduce_op,
+                          const std::shared_ptr<OptimizerStep>& optimizer_step) {
+  if (optimizer_step == nullptr) {
+    return Status::OK();
+  }
+#if HAVE_CUDA
+  auto dtype = tensor.dtype();
+  if (device == CPU_DEVICE_ID || reduce_op == ReduceOp::ADASUM ||
+      (dtype != HOROVOD_FLOAT16 && dtype != HOROVOD_BFLOAT16 &&
+       dtype != HOROVOD_FLOAT32 && dtype != HOROVOD_FLOAT64)) {
+    return Status::InvalidArgument(
+        "Optimizer steps are only run after floating point allreduces on "
+        "GPUs, without Adasum.");
+  }
+  bool adam = optimizer_step->kind == OptimizerStep::ADAM;
+  std::vector<std::shared_ptr<Tensor>> tensors{optimizer_step->parameter};
+  if (adam || optimizer_step->state0 != nullptr) {
+    tensors.push_back(optimizer_step->state0);
+  }
+  if (adam) {
+    tensors.push_back(optimizer_step->state1);
+  }
+  for (auto& t : tensors) {
+    if (t == nullptr || t->dtype() != dtype ||
+        t->shape().num_elements() != tensor.shape().num_elements()) {
+      return Status::InvalidArgument(
+          "The parameter and the states of an optimizer step must have the "
+          "type and size of the gradient.");
+    }
+  }
+  if (adam && optimizer_step->step < 1) {
+    return Status::InvalidArgument("Adam steps count from one.");
+  }
+  return Status::OK();
+#else
+  return Status::InvalidArgument(
+      "Optimizer steps of allreduces are only run on CUDA devices.");
+#endif
+}
+
+// An allreduce registered with RegisterTensorAllreduce. The request is built
+// once and copied on every enqueue.
+struct RegisteredAllreduce {
+  Request message;
+  TensorShape shape;
+  ReduceOp reduce_op;
+  double prescale_factor;
+  double postscale_factor;
+  // The averaging factors of the request depend on the size of the job.
+  int size;
+};
+
+// Indexed by handle, unregistered handles are null and are not reused.
+std::mutex registered_allreduces_mutex;
+std::vector<std::shared_ptr<const RegisteredAllreduce>> registered_allreduces;
+
+} // namespace
+
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
+                              std::shared_ptr<Tensor> tensor,
+                              std::shared_ptr<Tensor> output,
+                              std::shared_ptr<ReadyEvent> ready_event,
+                              const std::string name, const int device,
+                              StatusCallback callback,
+                              ReduceOp reduce_op,
+                              double prescale_factor,
+                              double postscale_factor,
+                              int32_t priority,
+                              CompletionBatcher* batcher, int batch_key,
+                              std::shared_ptr<Tensor> norm_sqrd,
+                              std::shared_ptr<Tensor> found_inf,
+                              std::shared_ptr<OptimizerStep> optimizer_step) {
+  Status status = CheckOutputStatistics(*tensor, device, reduce_op, norm_sqrd,
+                                        found_inf);
+  if (status.ok()) {
+    status = CheckOptimizerStep(*tensor, device, reduce_op, optimizer_step);
+  }
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Reduce oversized tensors in parts, so that the parts can be placed into
+  // different fusion groups. The callback runs once all parts are done.
+  int64_t partition_bytes = horovod_global.partition_bytes;
+  if (partition_bytes > 0 && reduce_op != ReduceOp::ADASUM &&
+      tensor->size() > partition_bytes) {
+    int64_t num_elements = tensor->shape().num_elements();
+    int64_t part_elements = std::max(
+        (int64_t)1, partition_bytes / (int64_t)DataType_Size(tensor->dtype()));
+    int64_t num_parts = (num_elements + part_elements - 1) / part_elements;
+
+    struct PartitionState {
+      std::mutex mutex;
+      int64_t remaining;
+      Status status = Status::OK();
+      bool abandoned = false;
+    };
+    auto partition = std::make_shared<PartitionState>();
+    partition->remaining = num_parts;
+    auto part_callback = [partition, callback](const Status& part_status) {
+      std::unique_lock<std::mutex> lock(partition->mutex);
+      if (!part_status.ok() && partition->status.ok()) {
+        partition->status = part_status;
+      }
+      if (--partition->remaining > 0 || partition->abandoned) {
+        return;
+      }
+      lock.unlock();
+      callback(partition->status);
+    };
+
+    for (int64_t part = 0; part < num_parts; ++part) {
+      int64_t offset = part * part_elements;
+      int64_t count = std::min(part_elements, num_elements - offset);
+      status = EnqueueTensorAllreduce(
+          context, std::make_shared<TensorSlice>(tensor, offset, count),
+          std::make_shared<TensorSlice>(output, offset, count), ready_event,
+          name + ".part" + std::to_string(part), device, part_callback,
+          reduce_op, prescale_factor, postscale_factor, priority, nullptr, 0,
+          norm_sqrd, found_inf,
+          optimizer_step != nullptr ? optimizer_step->Slice(offset, count)
+                                    : nullptr);
+      if (!status.ok()) {
+        // The caller reports the error, the parts already enqueued must not
+        // call back.
+        std::lock_guard<std::mutex> guard(partition->mutex);
+        partition->abandoned = true;
+        return status;
+      }
+    }
+    return status;
+  }
+
+  Request message;
+  TensorTableEntry e;
+  status = PrepareTensorAllreduce(context, tensor, output, ready_event, name,
+                                  device, callback, reduce_op, prescale_factor,
+                                  postscale_factor, priority, batcher,
+                                  batch_key, message, e);
+  if (!status.ok()) {
+    return status;
+  }
+  e.norm_sqrd = norm_sqrd;
+  e.found_inf = found_inf;
+  e.optimizer_step = optimizer_step;
 
   if (horovod_global.shut_down) {
     return SHUT_DOWN_ERROR;
@@ -1076,6 +2123,215 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
   return status;
 }
 
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueTensorAllreduces(std::vector<std::shared_ptr<OpContext>>& contexts,
+                               std::vector<std::shared_ptr<Tensor>>& tensors,
+                               std::vector<std::shared_ptr<Tensor>>& outputs,
+                               std::shared_ptr<ReadyEvent> ready_event,
+                               std::vector<std::string>& names,
+                               const int device,
+                               std::vector<StatusCallback>& callbacks,
+                               ReduceOp reduce_op, double prescale_factor,
+                               double postscale_factor, int32_t priority) {
+  if (tensors.empty()) {
+    return Status::OK();
+  }
+  std::vector<Request> messages(tensors.size());
+  std::vector<TensorTableEntry> entries(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    Status status = PrepareTensorAllreduce(
+        contexts[i], tensors[i], outputs[i], ready_event, names[i], device,
+        callbacks[i], reduce_op, prescale_factor, postscale_factor, priority,
+        nullptr, 0, messages[i], entries[i]);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  Status status =
+      horovod_global.tensor_queue.AddToTensorQueueMulti(entries, messages);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank())
+        << "Enqueued " << names.size() << " tensors starting with "
+        << names.front();
+  }
+  return status;
+}
+
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueProcessSetAllreduce(int32_t process_set_id,
+                                  std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<Tensor> output,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  const std::string name, const int device,
+                                  StatusCallback callback, ReduceOp reduce_op,
+                                  double prescale_factor,
+                                  double postscale_factor, int32_t priority) {
+  if (process_set_id == 0) {
+    return EnqueueTensorAllreduce(context, tensor, output, ready_event, name,
+                                  device, callback, reduce_op,
+                                  prescale_factor, postscale_factor, priority);
+  }
+  auto& controller = *horovod_global.controller;
+  auto& process_sets = controller.GetProcessSets();
+  if (!process_sets.IsValid(process_set_id)) {
+    return Status::InvalidArgument(
+        "Unknown process set " + std::to_string(process_set_id) + ", " +
+        HOROVOD_PROCESS_SETS + " defines " +
+        std::to_string(process_sets.NumSets()) + ".");
+  }
+  if (process_sets.RankInSet(process_set_id, controller.GetRank()) < 0) {
+    return Status::InvalidArgument(
+        "Rank " + std::to_string(controller.GetRank()) +
+        " is not a member of process set " + std::to_string(process_set_id) +
+        ".");
+  }
+  if (reduce_op == ReduceOp::ADASUM) {
+    return Status::InvalidArgument(
+        "Adasum is not supported in process sets.");
+  }
+  if (reduce_op == ReduceOp::AVERAGE) {
+    // Averaging over the set happens via postscale_factor.
+    reduce_op = ReduceOp::SUM;
+    postscale_factor /= process_sets.Size(process_set_id);
+  }
+
+  // The name is qualified with the set, so that the same names can be used
+  // in every set and among all ranks.
+  std::string set_name =
+      "process_set." + std::to_string(process_set_id) + "." + name;
+  Request message;
+  TensorTableEntry e;
+  Status status = PrepareTensorAllreduce(
+      context, tensor, output, ready_event, set_name, device, callback,
+      reduce_op, prescale_factor, postscale_factor, priority, nullptr, 0,
+      message, e);
+  if (!status.ok()) {
+    return status;
+  }
+  message.set_process_set_id(process_set_id);
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+  if (status.ok()) {
+    LOG(TRACE, controller.GetRank()) << "Enqueued " << set_name;
+  }
+  return status;
+}
+
+Status RegisterTensorAllreduce(const std::string& name, DataType dtype,
+                               const TensorShape& shape, const int device,
+                               ReduceOp reduce_op, double prescale_factor,
+                               double postscale_factor, int32_t priority,
+                               int32_t* handle) {
+  auto registered = std::make_shared<RegisteredAllreduce>();
+  Status status = PrepareAllreduceRequest(
+      name, dtype, shape, device, reduce_op, prescale_factor,
+      postscale_factor, priority, registered->message);
+  if (!status.ok()) {
+    return status;
+  }
+  registered->shape = shape;
+  registered->reduce_op = reduce_op;
+  registered->prescale_factor = prescale_factor;
+  registered->postscale_factor = postscale_factor;
+  registered->size = horovod_global.controller->GetSize();
+
+  std::lock_guard<std::mutex> guard(registered_allreduces_mutex);
+  *handle = (int32_t)registered_allreduces.size();
+  registered_allreduces.push_back(std::move(registered));
+  return Status::OK();
+}
+
+void UnregisterTensorAllreduce(int32_t handle) {
+  std::lock_guard<std::mutex> guard(registered_allreduces_mutex);
+  if (handle >= 0 && handle < (int32_t)registered_allreduces.size()) {
+    registered_allreduces[handle] = nullptr;
+  }
+}
+
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueRegisteredAllreduce(int32_t handle,
+                                  std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<Tensor> output,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  StatusCallback callback,
+                                  CompletionBatcher* batcher, int batch_key,
+                                  std::shared_ptr<Tensor> norm_sqrd,
+                                  std::shared_ptr<Tensor> found_inf,
+                                  std::shared_ptr<OptimizerStep> optimizer_step) {
+  std::shared_ptr<const RegisteredAllreduce> registered;
+  {
+    std::lock_guard<std::mutex> guard(registered_allreduces_mutex);
+    if (handle >= 0 && handle < (int32_t)registered_allreduces.size()) {
+      registered = registered_allreduces[handle];
+    }
+  }
+  if (registered == nullptr) {
+    return Status::InvalidArgument("Unknown registered allreduce handle " +
+                                   std::to_string(handle) + ".");
+  }
+  const auto& name = registered->message.tensor_name();
+  if (tensor->dtype() != registered->message.tensor_type() ||
+      tensor->shape() != registered->shape) {
+    return Status::InvalidArgument(
+        "Tensor " + name + " does not match the type and shape it was "
+        "registered with.");
+  }
+  Status status =
+      CheckOutputStatistics(*tensor, registered->message.device(),
+                            registered->reduce_op, norm_sqrd, found_inf);
+  if (status.ok()) {
+    status = CheckOptimizerStep(*tensor, registered->message.device(),
+                                registered->reduce_op, optimizer_step);
+  }
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Oversized tensors are reduced in parts, which have their own names, and
+  // the request is built again once an elastic job changed its size.
+  int64_t partition_bytes = horovod_global.partition_bytes;
+  if ((partition_bytes > 0 && registered->reduce_op != ReduceOp::ADASUM &&
+       tensor->size() > partition_bytes) ||
+      registered->size != horovod_global.controller->GetSize()) {
+    return EnqueueTensorAllreduce(
+        context, tensor, output, ready_event, name,
+        registered->message.device(), callback, registered->reduce_op,
+        registered->prescale_factor, registered->postscale_factor,
+        registered->message.priority(), batcher, batch_key, norm_sqrd,
+        found_inf, optimizer_step);
+  }
+
+  Request message = registered->message;
+  message.set_request_rank(horovod_global.controller->GetRank());
+  TensorTableEntry e;
+  PrepareAllreduceEntry(context, tensor, output, ready_event, name,
+                        message.device(), callback, batcher, batch_key, e);
+  e.norm_sqrd = norm_sqrd;
+  e.found_inf = found_inf;
+  e.optimizer_step = optimizer_step;
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank()) << "Enqueued " << name;
+  }
+  return status;
+}
+
 // Contexts and controller must be initialized and the background thread
 // must be running before this function is called.
 Status EnqueueTensorAllgather(std::shared_ptr<OpContext> context,
@@ -1100,6 +2356,7 @@ Status EnqueueTensorAllgather(std::shared_ptr<OpContext> context,
   e.ready_event = ready_event;
   e.device = device;
   e.callback = callback;
+  TrackOverlapStats(e);
 
   if (horovod_global.shut_down) {
     return SHUT_DOWN_ERROR;
@@ -1139,6 +2396,7 @@ Status EnqueueTensorBroadcast(std::shared_ptr<OpContext> context,
   e.ready_event = ready_event;
   e.device = device;
   e.callback = callback;
+  TrackOverlapStats(e);
 
   if (horovod_global.shut_down) {
     return SHUT_DOWN_ERROR;
@@ -1157,7 +2415,8 @@ Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
                              std::shared_ptr<Tensor> splits,
                              std::shared_ptr<ReadyEvent> ready_event,
                              const std::string name, const int device,
-                             StatusCallback callback) {
+                             StatusCallback callback,
+                             bool splits_on_device) {
   // Check arguments
   if (splits->shape().dims() > 1) {
     return Status::InvalidArgument("alltoall expects a 1D splits tensor");
@@ -1165,6 +2424,11 @@ Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
   if (splits->dtype() != HOROVOD_INT32) {
     return Status::InvalidArgument("alltoall expects splits to contain 32-bit integer elements.");
   }
+  if (splits_on_device &&
+      (!horovod_global.alltoall_device_splits || device == CPU_DEVICE_ID)) {
+    return Status::InvalidArgument("alltoall splits on the device require a GPU tensor and "
+                                   HOROVOD_ALLTOALL_DEVICE_SPLITS "=1.");
+  }
 
   Request message;
   message.set_request_rank(horovod_global.controller->GetRank());
@@ -1183,11 +2447,15 @@ Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
   e.ready_event = ready_event;
   e.device = device;
   e.callback = callback;
+  TrackOverlapStats(e);
 
   int64_t splits_first_dim = splits->shape().dim_size(0);
   int64_t tensor_first_dim = tensor->shape().dim_size(0);
   int world_size = horovod_global.controller->GetSize();
-  if (splits_first_dim == world_size) {
+  if (splits_on_device && splits_first_dim == world_size) {
+    // Checked against the first dimension of the tensor by the alltoall.
+    e.device_splits = splits;
+  } else if (splits_first_dim == world_size) {
     auto splits_data = static_cast<const int32_t*>(splits->data());
     auto sum = std::accumulate(splits_data, splits_data + splits_first_dim, 0);
     if (sum > tensor_first_dim) {
@@ -1215,6 +2483,42 @@ Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
   return status;
 }
 
+// Contexts and controller must be initialized and the background thread
+// must be running before this function is called.
+Status EnqueueTensorReducescatter(std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  const std::string name, const int device,
+                                  StatusCallback callback) {
+  Request message;
+  message.set_request_rank(horovod_global.controller->GetRank());
+  message.set_tensor_name(name);
+  message.set_tensor_type(tensor->dtype());
+  message.set_device(device);
+  message.set_request_type(Request::REDUCESCATTER);
+  for (int i = 0; i < tensor->shape().dims(); ++i) {
+    message.add_tensor_shape((int64_t)tensor->shape().dim_size(i));
+  }
+
+  TensorTableEntry e;
+  e.tensor_name = name;
+  e.context = context;
+  e.tensor = tensor;
+  e.ready_event = ready_event;
+  e.device = device;
+  e.callback = callback;
+  TrackOverlapStats(e);
+
+  if (horovod_global.shut_down) {
+    return SHUT_DOWN_ERROR;
+  }
+  Status status = horovod_global.tensor_queue.AddToTensorQueue(e, message);
+  if (status.ok()) {
+    LOG(TRACE, horovod_global.controller->GetRank()) << "Enqueued " << name;
+  }
+  return status;
+}
+
 // Contexts and controller must be initialized and the background thread
 // must be running before this function is called.
 Status EnqueueJoin(std::shared_ptr<OpContext> context,
@@ -32,6 +32,10 @@ namespace common {
 // Check that Horovod is initialized.
 Status CheckInitialized();
 
+// Returns true if EnqueueTensorAlltoall takes the splits of GPU tensors on
+// the device of the tensor.
+bool AlltoallDeviceSplits();
+
 enum ReduceOp {
     AVERAGE = 0, // This value should never appear past framework code, as
                  // averaging is taken care of there.
@@ -100,6 +104,46 @@ bool horovod_cuda_built();
 // C interface to return flag indicating whether Horovod was compiled with ROCm support.
 bool horovod_rocm_built();
 
+// C interface to send partially filled fusion groups once the allreduces
+// enqueued so far have been negotiated. Returns false if Horovod is not
+// initialized.
+bool horovod_flush_fusion_groups();
+
+// C interface to drop the fusion buffers once the current cycle is done, so
+// that their memory is freed while the rank is idle. They are allocated again
+// by the next fused operation. Returns false if Horovod is not initialized.
+bool horovod_release_fusion_buffers();
+
+// C interface to return the bytes of the fusion buffers allocated, or -1 if
+// Horovod is not initialized.
+int64_t horovod_fusion_buffer_bytes();
+
+// C interface to record that a training step was completed, for the
+// autotuner scoring with HOROVOD_AUTOTUNE_SCORE=step_time. Returns false if
+// Horovod is not initialized.
+bool horovod_step_completed();
+
+// C interface to return the overlap stats of the last steps on this rank as
+// JSON. Returns nullptr if Horovod is not initialized.
+const char* horovod_overlap_stats();
+
+// C interface to return the hot path metrics of this rank in the Prometheus
+// text format. Returns nullptr if Horovod is not initialized.
+const char* horovod_metrics();
+
+// C interface to get the straggler score of every rank, in seconds. Writes up
+// to size scores and returns their number, which is 0 on all ranks but the
+// coordinator. Returns -1 if Horovod is not initialized.
+int horovod_straggler_scores(double* scores, int size);
+
+// C interface to return the number of ranks in the process set, 0 if there
+// is no such set. Returns -1 if Horovod is not initialized.
+int horovod_process_set_size(int process_set_id);
+
+// C interface to return the position of the calling process in the process
+// set, -1 if it is no member or Horovod is not initialized.
+int horovod_process_set_rank(int process_set_id);
+
 // C interface to return value of the ReduceOp::AVERAGE enum field.
 int horovod_reduce_op_average();
 
@@ -119,7 +163,68 @@ Status EnqueueTensorAllreduce(std::shared_ptr<OpContext> context,
                               StatusCallback callback,
                               ReduceOp reduce_op = ReduceOp::SUM,
                               double prescale_factor = 1.0,
-                              double postscale_factor = 1.0);
+                              double postscale_factor = 1.0,
+                              int32_t priority = 0,
+                              CompletionBatcher* batcher = nullptr,
+                              int batch_key = 0,
+                              std::shared_ptr<Tensor> norm_sqrd = nullptr,
+                              std::shared_ptr<Tensor> found_inf = nullptr,
+                              std::shared_ptr<OptimizerStep> optimizer_step = nullptr);
+
+// Enqueues allreduces that become ready together, with one ready event. They
+// are negotiated in the same cycle and fused together as far as the fusion
+// buffer allows. Oversized tensors are not reduced in parts.
+Status EnqueueTensorAllreduces(std::vector<std::shared_ptr<OpContext>>& contexts,
+                               std::vector<std::shared_ptr<Tensor>>& tensors,
+                               std::vector<std::shared_ptr<Tensor>>& outputs,
+                               std::shared_ptr<ReadyEvent> ready_event,
+                               std::vector<std::string>& names,
+                               const int device,
+                               std::vector<StatusCallback>& callbacks,
+                               ReduceOp reduce_op = ReduceOp::SUM,
+                               double prescale_factor = 1.0,
+                               double postscale_factor = 1.0,
+                               int32_t priority = 0);
+
+// Registers an allreduce that is enqueued on every step with tensors of the
+// same name, type and shape. EnqueueRegisteredAllreduce then only takes the
+// returned handle and the tensors, instead of building the request again.
+Status RegisterTensorAllreduce(const std::string& name, DataType dtype,
+                               const TensorShape& shape, const int device,
+                               ReduceOp reduce_op, double prescale_factor,
+                               double postscale_factor, int32_t priority,
+                               int32_t* handle);
+
+void UnregisterTensorAllreduce(int32_t handle);
+
+Status EnqueueRegisteredAllreduce(int32_t handle,
+                                  std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<Tensor> output,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  StatusCallback callback,
+                                  CompletionBatcher* batcher = nullptr,
+                                  int batch_key = 0,
+                                  std::shared_ptr<Tensor> norm_sqrd = nullptr,
+                                  std::shared_ptr<Tensor> found_inf = nullptr,
+                                  std::shared_ptr<OptimizerStep> optimizer_step = nullptr);
+
+// Allreduces the tensor among the ranks of a process set of
+// HOROVOD_PROCESS_SETS, concurrently with the collectives of other sets, or
+// among all ranks for process set 0. Every rank of the set must enqueue the
+// tensor under the same name, which only needs to be unique within the set.
+// Oversized tensors are not reduced in parts.
+Status EnqueueProcessSetAllreduce(int32_t process_set_id,
+                                  std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<Tensor> output,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  const std::string name, const int device,
+                                  StatusCallback callback,
+                                  ReduceOp reduce_op = ReduceOp::SUM,
+                                  double prescale_factor = 1.0,
+                                  double postscale_factor = 1.0,
+                                  int32_t priority = 0);
 
 Status EnqueueTensorAllgather(std::shared_ptr<OpContext> context,
                               std::shared_ptr<Tensor> tensor,
@@ -139,7 +244,16 @@ Status EnqueueTensorAlltoall(std::shared_ptr<OpContext> context,
                              std::shared_ptr<Tensor> splits,
                              std::shared_ptr<ReadyEvent> ready_event,
                              const std::string name, const int device,
-                             StatusCallback callback);
+                             StatusCallback callback,
+                             bool splits_on_device = false);
+
+// The tensor is summed across ranks and split along its first dimension,
+// each rank receiving its part in the output of the context.
+Status EnqueueTensorReducescatter(std::shared_ptr<OpContext> context,
+                                  std::shared_ptr<Tensor> tensor,
+                                  std::shared_ptr<ReadyEvent> ready_event,
+                                  const std::string name, const int device,
+                                  StatusCallback callback);
 
 Status EnqueueJoin(std::shared_ptr<OpContext> context,
                               std::shared_ptr<ReadyEvent> ready_event,
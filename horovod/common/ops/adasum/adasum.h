@@ -18,6 +18,8 @@
 
 #include <cstring>
 #include <float.h>
+#include <functional>
+#include <vector>
 
 #if __AVX__ && __F16C__ && __FMA__
 #include <emmintrin.h>
@@ -26,6 +28,8 @@
 
 #include "../../common.h"
 #include "../../global_state.h"
+#include "../../parallel_for.h"
+#include "adasum_kernels.h"
 
 namespace horovod {
 namespace common {
@@ -60,6 +64,20 @@ protected:
                                     int tag, Communicator_type communicator,
                                     HorovodGlobalState* global_state) = 0;
 
+  // Like PointToPointSendRecv, but calls on_received(begin, end) with each
+  // byte range of output_data_buffer as soon as it has arrived, so that it can
+  // be reduced while the rest is in flight. Returns false without sending
+  // anything if the transfer is not split, in which case PointToPointSendRecv
+  // is used.
+  virtual bool PointToPointSendRecvOverlapped(
+      void* input_data_buffer, int64_t input_buffer_length,
+      void* output_data_buffer, int64_t output_buffer_length,
+      DataType horovod_datatype, int dst_src_rank, int tag,
+      Communicator_type communicator, HorovodGlobalState* global_state,
+      const std::function<void(int64_t, int64_t)>& on_received) {
+    return false;
+  }
+
   virtual void SumAllreduceWithComm(std::vector<TensorTableEntry>& entries,
                                     void* data, int num_elements,
                                     DataType horovod_datatype,
@@ -79,6 +97,7 @@ protected:
                               HorovodGlobalState* global_state) {
     switch (data_type) {
     case DataType::HOROVOD_FLOAT16:
+    case DataType::HOROVOD_BFLOAT16:
       FusedAllreduce(entries, (uint16_t*)grad_buffer, (uint16_t*)recv_buffer,
                      data_type, tensor_counts, start_level, communicator, tag,
                      reduction_comms, global_state);
@@ -98,44 +117,147 @@ protected:
     }
   }
 
+  // Large buffers are split between the CPU reduction threads. The partial
+  // products of the ranges are added in order.
   virtual void DispatchComputeDotAndNormSqrds(const void* __restrict__ a,
                                               const void* __restrict__ b,
                                               DataType horovod_datatype,
                                               int count, double& dotProduct,
                                               double& anormsq, double& bnormsq,
                                               int layerid) {
+    CheckReductionDataType(horovod_datatype);
+    int64_t min_grain = CPU_REDUCTION_MIN_BYTES_PER_THREAD /
+                        (int64_t)DataType_Size(horovod_datatype);
+    std::vector<double> partials(
+        3 * NumParallelRanges(count, min_grain), 0.);
+    ParallelFor(count, min_grain, [&](int range, int64_t begin, int64_t end) {
+      ComputeDotAndNormSqrdsRange(a, b, horovod_datatype, begin, end,
+                                  partials[3 * range],
+                                  partials[3 * range + 1],
+                                  partials[3 * range + 2], layerid);
+    });
+    dotProduct = 0.;
+    anormsq = 0.;
+    bnormsq = 0.;
+    for (size_t i = 0; i < partials.size(); i += 3) {
+      dotProduct += partials[i];
+      anormsq += partials[i + 1];
+      bnormsq += partials[i + 2];
+    }
+  }
+
+  virtual void DispatchScaledAdd(DataType horovod_datatype, int count,
+                                 double acoeff, void* __restrict__ a,
+                                 double bcoeff, void* __restrict__ b,
+                                 int layerid) {
+    CheckReductionDataType(horovod_datatype);
+    int64_t min_grain = CPU_REDUCTION_MIN_BYTES_PER_THREAD /
+                        (int64_t)DataType_Size(horovod_datatype);
+    ParallelFor(count, min_grain, [&](int range, int64_t begin, int64_t end) {
+      ScaledAddRange(horovod_datatype, begin, end, acoeff, a, bcoeff, b,
+                     layerid);
+    });
+  }
+
+  // Throws for data types the kernels don't support, before any of them runs
+  // on a reduction thread.
+  void CheckReductionDataType(DataType horovod_datatype) {
+#if __AVX__ && __F16C__ && __FMA__
+    if (horovod_datatype == DataType::HOROVOD_FLOAT16) {
+      return;
+    }
+#endif
+    if (horovod_datatype != DataType::HOROVOD_BFLOAT16 &&
+        horovod_datatype != DataType::HOROVOD_FLOAT32 &&
+        horovod_datatype != DataType::HOROVOD_FLOAT64) {
+      throw std::logic_error("Unsupported data type.");
+    }
+  }
+
+  void ComputeDotAndNormSqrdsRange(const void* __restrict__ a,
+                                   const void* __restrict__ b,
+                                   DataType horovod_datatype, int64_t begin,
+                                   int64_t end, double& dotProduct,
+                                   double& anormsq, double& bnormsq,
+                                   int layerid) {
+    int count = (int)(end - begin);
+    if (horovod_datatype == DataType::HOROVOD_BFLOAT16) {
+      ComputeDotAndNormSqrdsbf16((const uint16_t*)a + begin,
+                                 (const uint16_t*)b + begin, count, dotProduct,
+                                 anormsq, bnormsq);
+      return;
+    }
+#if HOROVOD_X86_DISPATCH
+    if (is_avx512f()) {
+      if (horovod_datatype == DataType::HOROVOD_FLOAT16) {
+        ComputeDotAndNormSqrdsfp16AVX512((const uint16_t*)a + begin,
+                                         (const uint16_t*)b + begin, count,
+                                         dotProduct, anormsq, bnormsq);
+      } else if (horovod_datatype == DataType::HOROVOD_FLOAT32) {
+        ComputeDotAndNormSqrdsAVX512((const float*)a + begin,
+                                     (const float*)b + begin, count,
+                                     dotProduct, anormsq, bnormsq);
+      } else {
+        ComputeDotAndNormSqrdsAVX512((const double*)a + begin,
+                                     (const double*)b + begin, count,
+                                     dotProduct, anormsq, bnormsq);
+      }
+      return;
+    }
+#endif
 #if __AVX__ && __F16C__ && __FMA__
     if (horovod_datatype == DataType::HOROVOD_FLOAT16) {
-      ComputeDotAndNormSqrdsfp16((uint16_t*)a, (uint16_t*)b, count, dotProduct,
+      ComputeDotAndNormSqrdsfp16((const uint16_t*)a + begin,
+                                 (const uint16_t*)b + begin, count, dotProduct,
                                  anormsq, bnormsq, layerid);
     } else
 #endif
     if (horovod_datatype == DataType::HOROVOD_FLOAT32) {
-      ComputeDotAndNormSqrds((float*)a, (float*)b, count, dotProduct, anormsq,
-                             bnormsq, layerid);
-    } else if (horovod_datatype == DataType::HOROVOD_FLOAT64) {
-      ComputeDotAndNormSqrds((double*)a, (double*)b, count, dotProduct, anormsq,
-                             bnormsq, layerid);
+      ComputeDotAndNormSqrds((const float*)a + begin, (const float*)b + begin,
+                             count, dotProduct, anormsq, bnormsq, layerid);
     } else {
-      throw std::logic_error("Unsupported data type.");
+      ComputeDotAndNormSqrds((const double*)a + begin,
+                             (const double*)b + begin, count, dotProduct,
+                             anormsq, bnormsq, layerid);
     }
   }
 
-  virtual void DispatchScaledAdd(DataType horovod_datatype, int count,
-                                 double acoeff, void* __restrict__ a,
-                                 double bcoeff, void* __restrict__ b,
-                                 int layerid) {
+  void ScaledAddRange(DataType horovod_datatype, int64_t begin, int64_t end,
+                      double acoeff, void* __restrict__ a, double bcoeff,
+                      void* __restrict__ b, int layerid) {
+    int count = (int)(end - begin);
+    if (horovod_datatype == DataType::HOROVOD_BFLOAT16) {
+      ScaledAddbf16(count, acoeff, (uint16_t*)a + begin, bcoeff,
+                    (const uint16_t*)b + begin);
+      return;
+    }
+#if HOROVOD_X86_DISPATCH
+    if (is_avx512f()) {
+      if (horovod_datatype == DataType::HOROVOD_FLOAT16) {
+        ScaledAddfp16AVX512(count, acoeff, (uint16_t*)a + begin, bcoeff,
+                            (const uint16_t*)b + begin);
+      } else if (horovod_datatype == DataType::HOROVOD_FLOAT32) {
+        ScaledAddAVX512(count, acoeff, (float*)a + begin, bcoeff,
+                        (const float*)b + begin);
+      } else {
+        ScaledAddAVX512(count, acoeff, (double*)a + begin, bcoeff,
+                        (const double*)b + begin);
+      }
+      return;
+    }
+#endif
 #if __AVX__ && __F16C__ && __FMA__
     if (horovod_datatype == DataType::HOROVOD_FLOAT16) {
-      ScaledAddfp16(count, acoeff, (uint16_t*)a, bcoeff, (uint16_t*)b, layerid);
+      ScaledAddfp16(count, acoeff, (uint16_t*)a + begin, bcoeff,
+                    (uint16_t*)b + begin, layerid);
     } else
 #endif
     if (horovod_datatype == DataType::HOROVOD_FLOAT32) {
-      ScaledAdd(count, acoeff, (float*)a, bcoeff, (float*)b, layerid);
-    } else if (horovod_datatype == DataType::HOROVOD_FLOAT64) {
-      ScaledAdd(count, acoeff, (double*)a, bcoeff, (double*)b, layerid);
+      ScaledAdd(count, acoeff, (float*)a + begin, bcoeff, (float*)b + begin,
+                layerid);
     } else {
-      throw std::logic_error("Unsupported data type.");
+      ScaledAdd(count, acoeff, (double*)a + begin, bcoeff, (double*)b + begin,
+                layerid);
     }
   }
 
@@ -291,18 +413,46 @@ private:
 
       nghrCountVec_index++;
 
-      this->PointToPointSendRecv(
+      // The half kept by this rank, and where the neighbor's copy of it is
+      // received.
+      T* my_grad_buffer =
+          (rank & level) != 0 ? &grad_buffer[nghrCount] : grad_buffer;
+      T* my_recv_buffer = &recv_buffer[recvOffset];
+      bool isLeftNeighbor = (rank & level) == 0;
+      std::fill(normAndDots.begin(),
+                normAndDots.begin() + 3 * tensor_counts.size(), 0.);
+      bool overlapped = this->PointToPointSendRecvOverlapped(
           (char*)(&grad_buffer[sendOffset]), nghrCount * per_element_size,
-          (char*)(&recv_buffer[recvOffset]), myCount * per_element_size,
-          horovod_datatype, neighbor_rank, tag, communicator, global_state);
+          (char*)my_recv_buffer, myCount * per_element_size, horovod_datatype,
+          neighbor_rank, tag, communicator, global_state,
+          [&](int64_t begin, int64_t end) {
+            AccumulateDotAndNormSqrds(
+                (uint8_t*)my_grad_buffer, (uint8_t*)my_recv_buffer,
+                horovod_datatype, tensor_counts, begin / per_element_size,
+                end / per_element_size, isLeftNeighbor, normAndDots, tag,
+                per_element_size);
+          });
+      if (!overlapped) {
+        this->PointToPointSendRecv(
+            (char*)(&grad_buffer[sendOffset]), nghrCount * per_element_size,
+            (char*)my_recv_buffer, myCount * per_element_size,
+            horovod_datatype, neighbor_rank, tag, communicator, global_state);
+      }
+      grad_buffer = my_grad_buffer;
       if ((rank & level) != 0) {
-        grad_buffer = &grad_buffer[nghrCount];
         recv_buffer = &recv_buffer[nghrCount];
       }
-      FusedPairwiseReduceWithComm(
-          entries, (uint8_t*)grad_buffer, (uint8_t*)recv_buffer,
-          horovod_datatype, tensor_counts, tag, reduction_comms[comm_index],
-          (rank & level) == 0, normAndDots, global_state);
+      if (overlapped) {
+        ScaledAddWithComm(entries, (uint8_t*)grad_buffer,
+                          (uint8_t*)recv_buffer, horovod_datatype,
+                          tensor_counts, tag, reduction_comms[comm_index],
+                          isLeftNeighbor, normAndDots, global_state);
+      } else {
+        FusedPairwiseReduceWithComm(
+            entries, (uint8_t*)grad_buffer, (uint8_t*)recv_buffer,
+            horovod_datatype, tensor_counts, tag, reduction_comms[comm_index],
+            isLeftNeighbor, normAndDots, global_state);
+      }
     }
 
     for (level = (size >> 1); level > 0; level = (level >> 1)) {
@@ -335,14 +485,17 @@ private:
     size = orgSize;
   }
 
-  void FusedPairwiseReduceWithComm(std::vector<TensorTableEntry>& entries,
-                                   uint8_t* a, uint8_t* b,
-                                   DataType horovod_datatype,
-                                   std::vector<int>& tensor_counts, int layerid,
-                                   Communicator_type& comm, bool isLeftNeighbor,
-                                   std::vector<double>& normAndDots,
-                                   HorovodGlobalState* global_state) {
-    static double sqrt_double_min = std::sqrt(DBL_MIN);
+protected:
+  // Replaces a with the Adasum of a and b for every tensor, computing the dot
+  // products and norms over the reduction group of comm.
+  virtual void
+  FusedPairwiseReduceWithComm(std::vector<TensorTableEntry>& entries,
+                              uint8_t* a, uint8_t* b,
+                              DataType horovod_datatype,
+                              std::vector<int>& tensor_counts, int layerid,
+                              Communicator_type& comm, bool isLeftNeighbor,
+                              std::vector<double>& normAndDots,
+                              HorovodGlobalState* global_state) {
     int per_element_size =
         global_state->controller->GetTypeSize(horovod_datatype);
     int bytesSoFar = 0;
@@ -365,11 +518,26 @@ private:
       bytesSoFar += tensor_counts[i] * per_element_size;
     }
 
+    ScaledAddWithComm(entries, a, b, horovod_datatype, tensor_counts, layerid,
+                      comm, isLeftNeighbor, normAndDots, global_state);
+  }
+
+  // Sums the dot products and norms of this rank in normAndDots over the
+  // reduction group of comm, and replaces a with the Adasum of a and b.
+  void ScaledAddWithComm(std::vector<TensorTableEntry>& entries, uint8_t* a,
+                         uint8_t* b, DataType horovod_datatype,
+                         std::vector<int>& tensor_counts, int layerid,
+                         Communicator_type& comm, bool isLeftNeighbor,
+                         std::vector<double>& normAndDots,
+                         HorovodGlobalState* global_state) {
+    static double sqrt_double_min = std::sqrt(DBL_MIN);
+    int per_element_size =
+        global_state->controller->GetTypeSize(horovod_datatype);
     SumAllreduceWithComm(entries, (void*)normAndDots.data(),
                          3 * tensor_counts.size(), DataType::HOROVOD_FLOAT64,
                          comm, global_state);
 
-    bytesSoFar = 0;
+    int bytesSoFar = 0;
     for (size_t i = 0; i < tensor_counts.size(); i++) {
       double dotProduct = normAndDots[i * 3];
       double anormsq;
@@ -397,6 +565,37 @@ private:
     }
   }
 
+  // Adds the dot products and squared norms of elements [begin, end) of the
+  // fused a and b to normAndDots, splitting the range at tensor boundaries.
+  void AccumulateDotAndNormSqrds(uint8_t* a, uint8_t* b,
+                                 DataType horovod_datatype,
+                                 const std::vector<int>& tensor_counts,
+                                 int64_t begin, int64_t end,
+                                 bool isLeftNeighbor,
+                                 std::vector<double>& normAndDots, int layerid,
+                                 int per_element_size) {
+    int64_t tensor_begin = 0;
+    for (size_t i = 0; i < tensor_counts.size() && tensor_begin < end; i++) {
+      int64_t tensor_end = tensor_begin + tensor_counts[i];
+      int64_t first = std::max(begin, tensor_begin);
+      int64_t last = std::min(end, tensor_end);
+      if (first < last) {
+        double dotProduct = 0.;
+        double anormsq = 0.;
+        double bnormsq = 0.;
+        DispatchComputeDotAndNormSqrds(&a[first * per_element_size],
+                                       &b[first * per_element_size],
+                                       horovod_datatype, (int)(last - first),
+                                       dotProduct, anormsq, bnormsq, layerid);
+        normAndDots[i * 3] += dotProduct;
+        normAndDots[i * 3 + 1] += isLeftNeighbor ? anormsq : bnormsq;
+        normAndDots[i * 3 + 2] += isLeftNeighbor ? bnormsq : anormsq;
+      }
+      tensor_begin = tensor_end;
+    }
+  }
+
+private:
   // Given two vectors compute their dot product and the squared norm for each.
   template <typename T>
   void ComputeDotAndNormSqrds(const T* __restrict__ a, const T* __restrict__ b,
@@ -422,6 +621,36 @@ private:
     }
   }
 
+  // bfloat16 versions of the above, converting one element at a time.
+  void ComputeDotAndNormSqrdsbf16(const uint16_t* __restrict__ a,
+                                  const uint16_t* __restrict__ b, int count,
+                                  double& dotProduct, double& anormsq,
+                                  double& bnormsq) {
+    dotProduct = 0.;
+    anormsq = 0.;
+    bnormsq = 0.;
+
+    for (int i = 0; i < count; i++) {
+      float a_float, b_float;
+      BFloat16Bits2Float(a + i, &a_float);
+      BFloat16Bits2Float(b + i, &b_float);
+      dotProduct += (double)a_float * (double)b_float;
+      anormsq += (double)a_float * (double)a_float;
+      bnormsq += (double)b_float * (double)b_float;
+    }
+  }
+
+  void ScaledAddbf16(int n, double acoeff, uint16_t* __restrict__ a,
+                     double bcoeff, const uint16_t* __restrict__ b) {
+    for (int i = 0; i < n; i++) {
+      float a_float, b_float;
+      BFloat16Bits2Float(a + i, &a_float);
+      BFloat16Bits2Float(b + i, &b_float);
+      float sum = (float)(acoeff * a_float + bcoeff * b_float);
+      Float2BFloat16Bits(&sum, a + i);
+    }
+  }
+
 
 #if __AVX__ && __F16C__ && __FMA__
   inline void ComputeDotAndNormSqrdsfp16(const uint16_t* __restrict__ a,
@@ -0,0 +1,212 @@
+// Copyright 2019 Microsoft. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "adasum_kernels.h"
+
+#if HOROVOD_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace horovod {
+namespace common {
+
+#if HOROVOD_X86_DISPATCH
+namespace {
+
+// The mask-less forms of the AVX-512 conversions and shifts take an undefined
+// pass-through operand that GCC warns about, the zero-masking forms with all
+// lanes set compile to the same instructions.
+constexpr __mmask16 ALL_LANES_16 = 0xFFFF;
+constexpr __mmask8 ALL_LANES_8 = 0xFF;
+
+// Splits 16 floats into two halves of 8 doubles, with AVX-512F only. The
+// casts to the lower half are extracts in GCC as well.
+__attribute__((target("avx512f"))) inline void
+Mm512CvtpsPd(__m512 v, __m512d& bot, __m512d& top) {
+  bot = _mm512_maskz_cvtps_pd(
+      ALL_LANES_8, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(
+                       ALL_LANES_8, _mm512_castps_pd(v), 0)));
+  top = _mm512_maskz_cvtps_pd(
+      ALL_LANES_8, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(
+                       ALL_LANES_8, _mm512_castps_pd(v), 1)));
+}
+
+// _mm512_reduce_add_pd, on top of the zero-masking extract.
+__attribute__((target("avx512f"))) inline double Mm512ReduceAddPd(__m512d v) {
+  __m256d sum = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(ALL_LANES_8, v, 0),
+                              _mm512_maskz_extractf64x4_pd(ALL_LANES_8, v, 1));
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum),
+                            _mm256_extractf128_pd(sum, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+} // namespace
+
+__attribute__((target("avx512f"))) void
+ComputeDotAndNormSqrdsAVX512(const float* a, const float* b, int64_t count,
+                             double& dotProduct, double& anormsq,
+                             double& bnormsq) {
+  __m512d dotProductVec = _mm512_setzero_pd();
+  __m512d anormVec = _mm512_setzero_pd();
+  __m512d bnormVec = _mm512_setzero_pd();
+  int64_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512d aBot, aTop, bBot, bTop;
+    Mm512CvtpsPd(_mm512_loadu_ps(a + i), aBot, aTop);
+    Mm512CvtpsPd(_mm512_loadu_ps(b + i), bBot, bTop);
+    dotProductVec = _mm512_fmadd_pd(aBot, bBot, dotProductVec);
+    dotProductVec = _mm512_fmadd_pd(aTop, bTop, dotProductVec);
+    anormVec = _mm512_fmadd_pd(aBot, aBot, anormVec);
+    anormVec = _mm512_fmadd_pd(aTop, aTop, anormVec);
+    bnormVec = _mm512_fmadd_pd(bBot, bBot, bnormVec);
+    bnormVec = _mm512_fmadd_pd(bTop, bTop, bnormVec);
+  }
+  dotProduct = Mm512ReduceAddPd(dotProductVec);
+  anormsq = Mm512ReduceAddPd(anormVec);
+  bnormsq = Mm512ReduceAddPd(bnormVec);
+  for (; i < count; ++i) {
+    dotProduct += (double)a[i] * (double)b[i];
+    anormsq += (double)a[i] * (double)a[i];
+    bnormsq += (double)b[i] * (double)b[i];
+  }
+}
+
+__attribute__((target("avx512f"))) void
+ComputeDotAndNormSqrdsAVX512(const double* a, const double* b, int64_t count,
+                             double& dotProduct, double& anormsq,
+                             double& bnormsq) {
+  __m512d dotProductVec = _mm512_setzero_pd();
+  __m512d anormVec = _mm512_setzero_pd();
+  __m512d bnormVec = _mm512_setzero_pd();
+  int64_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m512d aVec = _mm512_loadu_pd(a + i);
+    __m512d bVec = _mm512_loadu_pd(b + i);
+    dotProductVec = _mm512_fmadd_pd(aVec, bVec, dotProductVec);
+    anormVec = _mm512_fmadd_pd(aVec, aVec, anormVec);
+    bnormVec = _mm512_fmadd_pd(bVec, bVec, bnormVec);
+  }
+  dotProduct = Mm512ReduceAddPd(dotProductVec);
+  anormsq = Mm512ReduceAddPd(anormVec);
+  bnormsq = Mm512ReduceAddPd(bnormVec);
+  for (; i < count; ++i) {
+    dotProduct += a[i] * b[i];
+    anormsq += a[i] * a[i];
+    bnormsq += b[i] * b[i];
+  }
+}
+
+__attribute__((target("avx512f"))) void
+ComputeDotAndNormSqrdsfp16AVX512(const uint16_t* a, const uint16_t* b,
+                                 int64_t count, double& dotProduct,
+                                 double& anormsq, double& bnormsq) {
+  __m512d dotProductVec = _mm512_setzero_pd();
+  __m512d anormVec = _mm512_setzero_pd();
+  __m512d bnormVec = _mm512_setzero_pd();
+  int64_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512d aBot, aTop, bBot, bTop;
+    Mm512CvtpsPd(_mm512_maskz_cvtph_ps(
+                     ALL_LANES_16, _mm256_loadu_si256((const __m256i*)(a + i))),
+                 aBot, aTop);
+    Mm512CvtpsPd(_mm512_maskz_cvtph_ps(
+                     ALL_LANES_16, _mm256_loadu_si256((const __m256i*)(b + i))),
+                 bBot, bTop);
+    dotProductVec = _mm512_fmadd_pd(aBot, bBot, dotProductVec);
+    dotProductVec = _mm512_fmadd_pd(aTop, bTop, dotProductVec);
+    anormVec = _mm512_fmadd_pd(aBot, aBot, anormVec);
+    anormVec = _mm512_fmadd_pd(aTop, aTop, anormVec);
+    bnormVec = _mm512_fmadd_pd(bBot, bBot, bnormVec);
+    bnormVec = _mm512_fmadd_pd(bTop, bTop, bnormVec);
+  }
+  dotProduct = Mm512ReduceAddPd(dotProductVec);
+  anormsq = Mm512ReduceAddPd(anormVec);
+  bnormsq = Mm512ReduceAddPd(bnormVec);
+  for (; i < count; ++i) {
+    float a_float;
+    float b_float;
+    HalfBits2Float(a + i, &a_float);
+    HalfBits2Float(b + i, &b_float);
+    dotProduct += (double)a_float * (double)b_float;
+    anormsq += (double)a_float * (double)a_float;
+    bnormsq += (double)b_float * (double)b_float;
+  }
+}
+
+__attribute__((target("avx512f"))) void
+ScaledAddAVX512(int64_t count, double acoeff, float* a, double bcoeff,
+                const float* b) {
+  __m512d acoeffVec = _mm512_set1_pd(acoeff);
+  __m512d bcoeffVec = _mm512_set1_pd(bcoeff);
+  int64_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m512d aVec = _mm512_maskz_cvtps_pd(ALL_LANES_8, _mm256_loadu_ps(a + i));
+    __m512d bVec = _mm512_maskz_cvtps_pd(ALL_LANES_8, _mm256_loadu_ps(b + i));
+    aVec = _mm512_mul_pd(acoeffVec, aVec);
+    _mm256_storeu_ps(a + i,
+                     _mm512_maskz_cvtpd_ps(
+                         ALL_LANES_8, _mm512_fmadd_pd(bcoeffVec, bVec, aVec)));
+  }
+  for (; i < count; ++i) {
+    a[i] = acoeff * a[i] + bcoeff * b[i];
+  }
+}
+
+__attribute__((target("avx512f"))) void
+ScaledAddAVX512(int64_t count, double acoeff, double* a, double bcoeff,
+                const double* b) {
+  __m512d acoeffVec = _mm512_set1_pd(acoeff);
+  __m512d bcoeffVec = _mm512_set1_pd(bcoeff);
+  int64_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m512d aVec = _mm512_mul_pd(acoeffVec, _mm512_loadu_pd(a + i));
+    _mm512_storeu_pd(
+        a + i, _mm512_fmadd_pd(bcoeffVec, _mm512_loadu_pd(b + i), aVec));
+  }
+  for (; i < count; ++i) {
+    a[i] = acoeff * a[i] + bcoeff * b[i];
+  }
+}
+
+__attribute__((target("avx512f"))) void
+ScaledAddfp16AVX512(int64_t count, double acoeff, uint16_t* a, double bcoeff,
+                    const uint16_t* b) {
+  __m512 acoeffVec = _mm512_set1_ps((float)acoeff);
+  __m512 bcoeffVec = _mm512_set1_ps((float)bcoeff);
+  int64_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 aVec = _mm512_maskz_cvtph_ps(
+        ALL_LANES_16, _mm256_loadu_si256((const __m256i*)(a + i)));
+    __m512 bVec = _mm512_maskz_cvtph_ps(
+        ALL_LANES_16, _mm256_loadu_si256((const __m256i*)(b + i)));
+    aVec = _mm512_mul_ps(acoeffVec, aVec);
+    _mm256_storeu_si256((__m256i*)(a + i),
+                        _mm512_maskz_cvtps_ph(
+                            ALL_LANES_16,
+                            _mm512_fmadd_ps(bcoeffVec, bVec, aVec), 0));
+  }
+  for (; i < count; ++i) {
+    float a_float;
+    float b_float;
+    HalfBits2Float(a + i, &a_float);
+    HalfBits2Float(b + i, &b_float);
+    float out_float = (float)acoeff * a_float + (float)bcoeff * b_float;
+    Float2HalfBits(&out_float, a + i);
+  }
+}
+#endif
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,53 @@
+// Copyright 2019 Microsoft. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_ADASUM_KERNELS_H
+#define HOROVOD_ADASUM_KERNELS_H
+
+#include <stdint.h>
+
+#include "../../half.h"
+
+namespace horovod {
+namespace common {
+
+#if HOROVOD_X86_DISPATCH
+// AVX-512 variants of the Adasum kernels, used when is_avx512f(). They are
+// compiled for AVX-512 whatever the build flags are, and handle all count
+// elements. Products are accumulated in double like in the generic kernels.
+void ComputeDotAndNormSqrdsAVX512(const float* a, const float* b, int64_t count,
+                                  double& dotProduct, double& anormsq,
+                                  double& bnormsq);
+void ComputeDotAndNormSqrdsAVX512(const double* a, const double* b,
+                                  int64_t count, double& dotProduct,
+                                  double& anormsq, double& bnormsq);
+void ComputeDotAndNormSqrdsfp16AVX512(const uint16_t* a, const uint16_t* b,
+                                      int64_t count, double& dotProduct,
+                                      double& anormsq, double& bnormsq);
+
+// a = acoeff * a + bcoeff * b, in double for float and double, and in float
+// for float16 like ScaledAddfp16.
+void ScaledAddAVX512(int64_t count, double acoeff, float* a, double bcoeff,
+                     const float* b);
+void ScaledAddAVX512(int64_t count, double acoeff, double* a, double bcoeff,
+                     const double* b);
+void ScaledAddfp16AVX512(int64_t count, double acoeff, uint16_t* a,
+                         double bcoeff, const uint16_t* b);
+#endif
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_ADASUM_KERNELS_H
@@ -122,5 +122,57 @@ void AdasumMPI::PointToPointSendRecv(
     }
   }
 }
+
+bool AdasumMPI::PointToPointSendRecvOverlapped(
+    void* input_data_buffer, int64_t input_buffer_length,
+    void* output_data_buffer, int64_t output_buffer_length,
+    DataType horovod_datatype, int dst_src_rank, int tag, MPI_Comm communicator,
+    HorovodGlobalState* global_state,
+    const std::function<void(int64_t, int64_t)>& on_received) {
+  int element_size = global_state->controller->GetTypeSize(horovod_datatype);
+  int input_count = input_buffer_length / element_size;
+  int output_count = output_buffer_length / element_size;
+  int chunk_count =
+      std::max((int)(global_state->adasum_mpi_chunk_size / element_size), 1);
+  if (output_count <= chunk_count) {
+    return false;
+  }
+
+  auto datatype = mpi_context_->GetMPIDataType(horovod_datatype);
+  std::vector<MPI_Request> recv_requests;
+  std::vector<MPI_Request> send_requests;
+  int status = MPI_SUCCESS;
+  for (int i = 0; i < output_count && status == MPI_SUCCESS; i += chunk_count) {
+    recv_requests.emplace_back();
+    status = MPI_Irecv((char*)output_data_buffer + (int64_t)i * element_size,
+                       std::min(chunk_count, output_count - i), datatype,
+                       dst_src_rank, tag, communicator, &recv_requests.back());
+  }
+  for (int i = 0; i < input_count && status == MPI_SUCCESS; i += chunk_count) {
+    send_requests.emplace_back();
+    status = MPI_Isend((char*)input_data_buffer + (int64_t)i * element_size,
+                       std::min(chunk_count, input_count - i), datatype,
+                       dst_src_rank, tag, communicator, &send_requests.back());
+  }
+  if (status != MPI_SUCCESS) {
+    throw std::logic_error(
+        "MPI_Isend/MPI_Irecv failed, see MPI output for details.");
+  }
+
+  // Chunks with the same tag arrive in order.
+  for (size_t c = 0; c < recv_requests.size(); ++c) {
+    if (MPI_Wait(&recv_requests[c], MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+      throw std::logic_error("MPI_Wait failed, see MPI output for details.");
+    }
+    int64_t begin = (int64_t)c * chunk_count;
+    int64_t end = std::min(begin + chunk_count, (int64_t)output_count);
+    on_received(begin * element_size, end * element_size);
+  }
+  if (MPI_Waitall((int)send_requests.size(), send_requests.data(),
+                  MPI_STATUSES_IGNORE) != MPI_SUCCESS) {
+    throw std::logic_error("MPI_Waitall failed, see MPI output for details.");
+  }
+  return true;
+}
 } // namespace common
 } // namespace horovod
@@ -15,6 +15,10 @@
 
 #include "adasum_gpu_operations.h"
 
+#ifdef NCCL_P2P_SUPPORTED
+#include "cuda/cuda_kernels.h"
+#endif
+
 namespace horovod {
 namespace common {
 
@@ -23,7 +27,11 @@ AdasumGpuAllreduceOp::AdasumGpuAllreduceOp(MPIContext* mpi_context,
                                            GPUContext* gpu_context,
                                            HorovodGlobalState* global_state)
     : AdasumMPI(mpi_context, global_state),
-      NCCLAllreduce(nccl_context, gpu_context, global_state, Communicator::LOCAL) {
+      NCCLAllreduce(nccl_context, gpu_context, global_state, Communicator::LOCAL)
+#ifdef NCCL_P2P_SUPPORTED
+      , global_nccl_op_context_(nccl_context, global_state, Communicator::GLOBAL)
+#endif
+{
   // Pre-allocate host buffer size equal to the fusion buffer length
   current_host_buffer_length =
       global_state->parameter_manager.TensorFusionThresholdBytes();
@@ -67,6 +75,19 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
   }
   gpu_op_context_.InitGPU(entries);
   nccl_op_context_.InitNCCLComm(entries, nccl_device_map);
+  bool device_reduction = false;
+#ifdef NCCL_P2P_SUPPORTED
+  // The VHDD levels pair ranks across nodes, which needs every local rank to
+  // take part and a power of two ranks for the recursive doubling of the
+  // dot products and norms.
+  int size = global_state_->controller->GetSize();
+  device_reduction = global_state_->adasum_gpu_device_reduction &&
+                     global_state_->controller->IsHomogeneous() &&
+                     (size & (size - 1)) == 0;
+  if (device_reduction) {
+    global_nccl_op_context_.InitNCCLComm(entries, response.devices());
+  }
+#endif
   gpu_op_context_.InitGPUQueue(entries, response);
   const void* fused_input_data;
   void* buffer_data;
@@ -107,10 +128,7 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
   // is divisible by local_size. This is always possible since we
   // set the fusion buffer size divisible by local_size.
   if (global_state_->controller->IsHomogeneous() && entries.size() > 1) {
-    // Making sure the number of elements is divisible by
-    // FUSION_BUFFER_ATOMIC_UNIT for improved performance
-    int div = local_size * FUSION_BUFFER_ATOMIC_UNIT;
-    num_elements = ((num_elements + div - 1) / div) * div;
+    num_elements = PaddedNumElements(entries);
     buffer_len = num_elements * element_size;
   }
 
@@ -158,12 +176,33 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
                                  ? buffer_len_per_rank + buffer_len_remaining
                                  : buffer_len_per_rank;
 
+  // The receive buffer of the VHDD exchanges, followed by the dot products
+  // and norms.
+  uint8_t* device_recv_buffer = nullptr;
+#ifdef NCCL_P2P_SUPPORTED
+  if (device_reduction) {
+    int64_t norm_and_dots_offset =
+        (total_buffer_len + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+    void* scratch_data;
+    Status status = gpu_op_context_.AllocateScratch(
+        first_entry, norm_and_dots_offset + 6 * entries.size() * sizeof(double),
+        &scratch_data);
+    if (!status.ok()) {
+      return status;
+    }
+    device_recv_buffer = (uint8_t*)scratch_data;
+    device_norm_and_dots_ =
+        (double*)(device_recv_buffer + norm_and_dots_offset);
+  }
+#endif
+
   auto& timeline = global_state_->timeline;
   if (num_elements_per_rank > 0) {
     auto nccl_result = ncclReduceScatter(
         fused_input_data, buffer_data_at_rank_offset,
         (size_t)num_elements_per_rank, GetNCCLDataType(first_entry.tensor),
-        ncclSum, *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
+        ncclSum, *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+        response.block_num, response.thread_num);
 
     nccl_context_->ErrorCheck("ncclReduceScatter", nccl_result, *nccl_op_context_.nccl_comm_);
     if (global_state_->timeline.Initialized()) {
@@ -188,25 +227,6 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
   }
 
   if (global_state_->controller->IsHomogeneous() || is_root_rank) {
-    // cudaHostAlloc is significantly slower than malloc.  Pre-allocating
-    // a buffer is not safe since the tensor can be arbitrarily large.
-    host_buffer = GetHostBuffer((uint64_t)total_buffer_len);
-    // Synchronize.
-    gpu_context_->WaitForEvents(gpu_op_context_.event_queue, entries,
-                                 timeline);
-
-    // According to https://docs.nvidia.com/cuda/cuda-runtime-api/
-    // api-sync-behavior.html#api-sync-behavior__memcpy-async,
-    // cudaMemcpyAsync is synchronous with respect to the host, so we
-    // memcpy (effectively) synchronously to generate an accurate timeline
-    timeline.ActivityStartAll(entries, MEMCPY_IN_HOST_BUFFER);
-    gpu_context_->MemcpyAsyncD2H(host_buffer, buffer_data_at_rank_offset,
-                                 total_buffer_len, *gpu_op_context_.stream);
-
-    timeline.ActivityEndAll(entries);
-
-    timeline.ActivityStartAll(entries, MPI_ADASUM_ALLREDUCE);
-
     // Since Adasum is not a per-element operation, an allreduce for fused
     // tensors needs to know boundaries of tensors. Calculate here the count
     // of elements for each tensor owned by this rank.
@@ -251,21 +271,55 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
       }
     }
 
-    auto recv_buffer = GetRecvBuffer(total_buffer_len);
-    DispatchFusedAllreduce(
-        entries, (void*)host_buffer, (void*)recv_buffer, tensor_counts,
-        local_size, // start_level
-        global_state_->controller->IsHomogeneous()
-            ? MPI_COMM_WORLD
-            : mpi_context_->GetMPICommunicator(Communicator::CROSS),
-        0, reduction_comms_, first_entry.tensor->dtype(), global_state_);
-    timeline.ActivityEndAll(entries);
-
-    timeline.ActivityStartAll(entries, MEMCPY_OUT_HOST_BUFFER);
-    gpu_context_->MemcpyAsyncH2D(buffer_data_at_rank_offset,
-                                 host_buffer, total_buffer_len,
-                                 *gpu_op_context_.stream);
-    timeline.ActivityEndAll(entries);
+#ifdef NCCL_P2P_SUPPORTED
+    device_reduction_ = device_reduction;
+#endif
+    if (device_reduction) {
+      DispatchFusedAllreduce(
+          entries, buffer_data_at_rank_offset, (void*)device_recv_buffer,
+          tensor_counts, local_size, // start_level
+          MPI_COMM_WORLD, 0, reduction_comms_, first_entry.tensor->dtype(),
+          global_state_);
+      if (global_state_->timeline.Initialized()) {
+        gpu_context_->RecordEvent(gpu_op_context_.event_queue,
+                                  NCCL_ADASUM_ALLREDUCE,
+                                  *gpu_op_context_.stream);
+      }
+    } else {
+      // cudaHostAlloc is significantly slower than malloc.  Pre-allocating
+      // a buffer is not safe since the tensor can be arbitrarily large.
+      host_buffer = GetHostBuffer((uint64_t)total_buffer_len);
+      // Synchronize.
+      gpu_context_->WaitForEvents(gpu_op_context_.event_queue, entries,
+                                  timeline);
+
+      // According to https://docs.nvidia.com/cuda/cuda-runtime-api/
+      // api-sync-behavior.html#api-sync-behavior__memcpy-async,
+      // cudaMemcpyAsync is synchronous with respect to the host, so we
+      // memcpy (effectively) synchronously to generate an accurate timeline
+      timeline.ActivityStartAll(entries, MEMCPY_IN_HOST_BUFFER);
+      gpu_context_->MemcpyAsyncD2H(host_buffer, buffer_data_at_rank_offset,
+                                   total_buffer_len, *gpu_op_context_.stream);
+
+      timeline.ActivityEndAll(entries);
+
+      timeline.ActivityStartAll(entries, MPI_ADASUM_ALLREDUCE);
+      auto recv_buffer = GetRecvBuffer(total_buffer_len);
+      DispatchFusedAllreduce(
+          entries, (void*)host_buffer, (void*)recv_buffer, tensor_counts,
+          local_size, // start_level
+          global_state_->controller->IsHomogeneous()
+              ? MPI_COMM_WORLD
+              : mpi_context_->GetMPICommunicator(Communicator::CROSS),
+          0, reduction_comms_, first_entry.tensor->dtype(), global_state_);
+      timeline.ActivityEndAll(entries);
+
+      timeline.ActivityStartAll(entries, MEMCPY_OUT_HOST_BUFFER);
+      gpu_context_->MemcpyAsyncH2D(buffer_data_at_rank_offset,
+                                   host_buffer, total_buffer_len,
+                                   *gpu_op_context_.stream);
+      timeline.ActivityEndAll(entries);
+    }
   }
 
   if (num_elements_per_rank > 0) {
@@ -273,7 +327,8 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
         "ncclAllGather", ncclAllGather(buffer_data_at_rank_offset, buffer_data,
                                        (size_t)num_elements_per_rank,
                                        GetNCCLDataType(first_entry.tensor),
-                                       *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream),
+                                       *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                       response.block_num, response.thread_num),
         *nccl_op_context_.nccl_comm_);
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER,
@@ -285,7 +340,7 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
         "ncclBcast",
         ncclBcast(buffer_data_remainder, (size_t)num_elements_remaining,
                   GetNCCLDataType(first_entry.tensor), root_rank, *nccl_op_context_.nccl_comm_,
-                  *gpu_op_context_.stream),
+                  *gpu_op_context_.stream, response.block_num, response.thread_num),
         *nccl_op_context_.nccl_comm_);
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_BCAST,
@@ -312,6 +367,142 @@ AdasumGpuAllreduceOp::NcclHierarchical(std::vector<TensorTableEntry>& entries,
   return gpu_op_context_.FinalizeGPUQueue(entries, false);
 }
 
+#ifdef NCCL_P2P_SUPPORTED
+void AdasumGpuAllreduceOp::PointToPointSendRecv(
+    void* input_data_buffer, int64_t input_buffer_length,
+    void* output_data_buffer, int64_t output_buffer_length,
+    DataType horovod_datatype, int dst_src_rank, int tag, MPI_Comm communicator,
+    HorovodGlobalState* global_state) {
+  if (!device_reduction_) {
+    AdasumMPI::PointToPointSendRecv(input_data_buffer, input_buffer_length,
+                                    output_data_buffer, output_buffer_length,
+                                    horovod_datatype, dst_src_rank, tag,
+                                    communicator, global_state);
+    return;
+  }
+
+  // Ranks of MPI_COMM_WORLD are the ranks of the global communicator. Both
+  // sides skip the same empty halves.
+  auto& nccl_comm = *global_nccl_op_context_.nccl_comm_;
+  auto& stream = *gpu_op_context_.stream;
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), nccl_comm);
+  if (input_buffer_length > 0) {
+    nccl_context_->ErrorCheck(
+        "ncclSend",
+        ncclSend(input_data_buffer, (size_t)input_buffer_length, ncclChar,
+                 dst_src_rank, nccl_comm, stream),
+        nccl_comm);
+  }
+  if (output_buffer_length > 0) {
+    nccl_context_->ErrorCheck(
+        "ncclRecv",
+        ncclRecv(output_data_buffer, (size_t)output_buffer_length, ncclChar,
+                 dst_src_rank, nccl_comm, stream),
+        nccl_comm);
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), nccl_comm);
+}
+
+bool AdasumGpuAllreduceOp::PointToPointSendRecvOverlapped(
+    void* input_data_buffer, int64_t input_buffer_length,
+    void* output_data_buffer, int64_t output_buffer_length,
+    DataType horovod_datatype, int dst_src_rank, int tag, MPI_Comm communicator,
+    HorovodGlobalState* global_state,
+    const std::function<void(int64_t, int64_t)>& on_received) {
+  // The device path reduces whole halves on the stream.
+  if (device_reduction_) {
+    return false;
+  }
+  return AdasumMPI::PointToPointSendRecvOverlapped(
+      input_data_buffer, input_buffer_length, output_data_buffer,
+      output_buffer_length, horovod_datatype, dst_src_rank, tag, communicator,
+      global_state, on_received);
+}
+
+void AdasumGpuAllreduceOp::FusedPairwiseReduceWithComm(
+    std::vector<TensorTableEntry>& entries, uint8_t* a, uint8_t* b,
+    DataType horovod_datatype, std::vector<int>& tensor_counts, int layerid,
+    MPI_Comm& comm, bool isLeftNeighbor, std::vector<double>& normAndDots,
+    HorovodGlobalState* global_state) {
+  if (!device_reduction_) {
+    AdasumMPI::FusedPairwiseReduceWithComm(
+        entries, a, b, horovod_datatype, tensor_counts, layerid, comm,
+        isLeftNeighbor, normAndDots, global_state);
+    return;
+  }
+
+  auto& stream = *gpu_op_context_.stream;
+  int num_tensors = (int)tensor_counts.size();
+  int per_element_size =
+      global_state->controller->GetTypeSize(horovod_datatype);
+  double* norm_and_dots = device_norm_and_dots_;
+  double* recv_norm_and_dots = device_norm_and_dots_ + 3 * num_tensors;
+
+  // Tensors are handled in batches of up to ADASUM_BATCH_CAPACITY.
+  std::vector<AdasumBatchParams> batches;
+  std::vector<int64_t> batch_offsets;
+  int64_t offset = 0;
+  for (int first = 0; first < num_tensors; first += ADASUM_BATCH_CAPACITY) {
+    int count = std::min(ADASUM_BATCH_CAPACITY, num_tensors - first);
+    batches.emplace_back();
+    auto& params = batches.back();
+    params.offsets[0] = 0;
+    for (int i = 0; i < count; ++i) {
+      params.offsets[i + 1] = params.offsets[i] + tensor_counts[first + i];
+    }
+    batch_offsets.push_back(offset * per_element_size);
+    offset += params.offsets[count];
+  }
+
+  gpu_context_->ErrorCheck(
+      "cudaMemsetAsync",
+      cudaMemsetAsync(norm_and_dots, 0, 3 * num_tensors * sizeof(double),
+                      stream));
+  for (size_t batch = 0; batch < batches.size(); ++batch) {
+    int first = (int)batch * ADASUM_BATCH_CAPACITY;
+    AdasumDotAndNormSqrdsCudaImpl(
+        a + batch_offsets[batch], b + batch_offsets[batch], batches[batch],
+        std::min(ADASUM_BATCH_CAPACITY, num_tensors - first), horovod_datatype,
+        norm_and_dots + 3 * first, isLeftNeighbor, stream);
+  }
+
+  // The reduction group of comm holds the ranks that differ from this one in
+  // the lowest bits, so recursive doubling over those bits sums the dot
+  // products and norms. Both ranks of a pair add the same two values, which
+  // leaves the whole group with the same sums.
+  int rank = global_state->controller->GetRank();
+  int group_size = GetSizeWithComm(comm);
+  for (int bit = 1; bit < group_size; bit <<= 1) {
+    PointToPointSendRecv(norm_and_dots, 3 * num_tensors * sizeof(double),
+                         recv_norm_and_dots, 3 * num_tensors * sizeof(double),
+                         DataType::HOROVOD_FLOAT64, rank ^ bit, layerid,
+                         comm, global_state);
+    AdasumAccumulateCudaImpl(norm_and_dots, recv_norm_and_dots,
+                             3 * num_tensors, stream);
+  }
+
+  for (size_t batch = 0; batch < batches.size(); ++batch) {
+    int first = (int)batch * ADASUM_BATCH_CAPACITY;
+    AdasumScaledAddCudaImpl(
+        a + batch_offsets[batch], b + batch_offsets[batch], batches[batch],
+        std::min(ADASUM_BATCH_CAPACITY, num_tensors - first), horovod_datatype,
+        norm_and_dots + 3 * first, isLeftNeighbor, stream);
+  }
+}
+#endif
+
+int64_t AdasumGpuAllreduceOp::PaddedNumElements(
+    const std::vector<TensorTableEntry>& entries) const {
+  auto num_elements = AllreduceOp::PaddedNumElements(entries);
+  if (global_state_->controller->IsHomogeneous() && entries.size() > 1) {
+    // Making sure the number of elements is divisible by
+    // FUSION_BUFFER_ATOMIC_UNIT for improved performance
+    int64_t div = global_state_->controller->GetLocalSize() * FUSION_BUFFER_ATOMIC_UNIT;
+    num_elements = ((num_elements + div - 1) / div) * div;
+  }
+  return num_elements;
+}
+
 bool AdasumGpuAllreduceOp::Enabled(
     const ParameterManager& param_manager,
     const std::vector<TensorTableEntry>& entries,
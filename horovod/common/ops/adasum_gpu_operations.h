@@ -38,15 +38,69 @@ public:
   Status Execute(std::vector<TensorTableEntry>& entries,
                  const Response& response) override;
 
+  // The cross-node reduction uses MPI.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return false;
+  }
+
+  bool JoinsLaunchBatch(const std::vector<TensorTableEntry>& entries,
+                        const Response& response) const override {
+    return false;
+  }
+
 protected:
   Status NcclHierarchical(std::vector<TensorTableEntry>& entries,
                           const Response& response);
 
+  // Fused entries of a homogeneous cluster are padded to a multiple of
+  // local_size * FUSION_BUFFER_ATOMIC_UNIT, like in NCCLHierarchicalAllreduce.
+  int64_t
+  PaddedNumElements(const std::vector<TensorTableEntry>& entries) const override;
+
   // Get host buffer
   uint8_t* GetHostBuffer(uint64_t buffer_length);
 
+#ifdef NCCL_P2P_SUPPORTED
+  // With device_reduction_ set, the VHDD exchanges go through ncclSend and
+  // ncclRecv on the global communicator, and the dot products, norms and
+  // scaled adds run on the GPU stream, so the cross-node reduction stays on
+  // the device.
+  void PointToPointSendRecv(void* input_data_buffer,
+                            int64_t input_buffer_length,
+                            void* output_data_buffer,
+                            int64_t output_buffer_length,
+                            DataType horovod_datatype, int dst_src_rank,
+                            int tag, MPI_Comm communicator,
+                            HorovodGlobalState* global_state) override;
+
+  bool PointToPointSendRecvOverlapped(
+      void* input_data_buffer, int64_t input_buffer_length,
+      void* output_data_buffer, int64_t output_buffer_length,
+      DataType horovod_datatype, int dst_src_rank, int tag,
+      MPI_Comm communicator, HorovodGlobalState* global_state,
+      const std::function<void(int64_t, int64_t)>& on_received) override;
+
+  void
+  FusedPairwiseReduceWithComm(std::vector<TensorTableEntry>& entries,
+                              uint8_t* a, uint8_t* b,
+                              DataType horovod_datatype,
+                              std::vector<int>& tensor_counts, int layerid,
+                              MPI_Comm& comm, bool isLeftNeighbor,
+                              std::vector<double>& normAndDots,
+                              HorovodGlobalState* global_state) override;
+#endif
+
 private:
   uint64_t current_host_buffer_length;
+
+#ifdef NCCL_P2P_SUPPORTED
+  bool device_reduction_ = false;
+  NCCLOpContext global_nccl_op_context_;
+  // Device scratch of 6 doubles per tensor, for the dot products and norms
+  // and for those received in the reduction group.
+  double* device_norm_and_dots_ = nullptr;
+#endif
 };
 } // namespace common
 } // namespace horovod
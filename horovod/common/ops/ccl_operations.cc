@@ -28,6 +28,9 @@
         }                                                                   \
   } while (0)
 
+// The fusion buffers of the slots are kept apart from the stream buffers used
+// by the other CPU operations.
+#define CCL_FUSION_BUFFER_INDEX(slot) (-1 - (slot))
 
 namespace horovod {
 namespace common {
@@ -48,21 +51,61 @@ ccl_datatype_t GetCCLDataType(const std::shared_ptr<Tensor>& tensor) {
   }
 }
 
-void CCLContext::Init() {
+void CCLContext::Init(int num_in_flight_ops) {
 
   LOG(DEBUG) << "Background thread start";
 
   // Initialize CCL
   ccl_init();
+
+  if (num_in_flight_ops < 1) {
+    LOG(WARNING) << "HOROVOD_CCL_IN_FLIGHT_OPS must be positive, got "
+                 << num_in_flight_ops << ". Using 1.";
+    num_in_flight_ops = 1;
+  }
+  slot_busy_.assign(num_in_flight_ops, false);
+  next_slot_ = 0;
+  finalizer_thread_pool.create(num_in_flight_ops);
 }
 
 void CCLContext::Finalize() {
   LOG(DEBUG) << "Background thread destroy";
 
+  // The allreduces still in flight are finalized before CCL goes away.
+  {
+    std::unique_lock<std::mutex> lock(slots_mutex_);
+    slots_cond_.wait(lock, [this] {
+      for (bool busy : slot_busy_) {
+        if (busy) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+  finalizer_thread_pool.reset();
+
   // Finalize CCL
   ccl_finalize();
 }
 
+int CCLContext::AcquireSlot() {
+  std::unique_lock<std::mutex> lock(slots_mutex_);
+  int slot = next_slot_;
+  next_slot_ = (next_slot_ + 1) % (int)slot_busy_.size();
+  slots_cond_.wait(lock, [this, slot] { return !slot_busy_[slot]; });
+  slot_busy_[slot] = true;
+  return slot;
+}
+
+void CCLContext::ReleaseSlot(int slot) {
+  {
+    std::lock_guard<std::mutex> guard(slots_mutex_);
+    slot_busy_[slot] = false;
+  }
+  slots_cond_.notify_all();
+}
+
 CCLAllreduce::CCLAllreduce(CCLContext* ccl_context, HorovodGlobalState* global_state)
     : AllreduceOp(global_state), ccl_context_(ccl_context) {}
 
@@ -74,47 +117,94 @@ Status CCLAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Respo
   size_t buffer_len;
   int64_t num_elements = NumElements(entries);
 
+  // The fusion buffer of the slot may still be used by its last allreduce.
+  int slot = ccl_context_->AcquireSlot();
+  std::shared_ptr<PersistentBuffer> fusion_buffer;
+
   // Copy memory into the fusion buffer.
   auto& timeline = global_state_->timeline;
-  if (entries.size() > 1) {
-    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
-    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
-    timeline.ActivityEndAll(entries);
-  } else {
-    fused_input_data = first_entry.tensor->data();
-    buffer_data = (void*) first_entry.output->data();
-    buffer_len = (size_t) first_entry.output->size();
-  }
-
-  if (response.prescale_factor() != 1.0) {
-    // Execute prescaling op
-    ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
-    fused_input_data = buffer_data; // for unfused, scale is done out of place
-  }
-
-  // Do allreduce.
-  timeline.ActivityStartAll(entries, CCL_ALLREDUCE);
-  const void* sendbuf = entries.size() > 1 || fused_input_data == buffer_data
-                        ? buffer_data : fused_input_data;
   ccl_request_t ccl_req;
-  CCL_CALL(ccl_allreduce((void*)sendbuf, buffer_data, num_elements, GetCCLDataType(first_entry.tensor),
-                         ccl_reduction_sum, nullptr /*attr*/, nullptr /*comm*/, nullptr /*stream*/, &ccl_req));
-  CCL_CALL(ccl_wait(ccl_req));
-  timeline.ActivityEndAll(entries);
+  try {
+    if (entries.size() > 1) {
+      int fusion_buffer_index = CCL_FUSION_BUFFER_INDEX(slot);
+      Status status = global_state_->fusion_buffer.InitializeBuffer(
+          global_state_->controller->TensorFusionThresholdBytes(), 0,
+          first_entry.device, first_entry.context, fusion_buffer_index,
+          [&]() { timeline.ActivityStartAll(entries, INIT_FUSION_BUFFER); },
+          [&]() { timeline.ActivityEndAll(entries); });
+      if (!status.ok()) {
+        ccl_context_->ReleaseSlot(slot);
+        return status;
+      }
+      std::swap(global_state_->fusion_buffer_index, fusion_buffer_index);
+      timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+      MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+      timeline.ActivityEndAll(entries);
+      // Claim a std::shared_ptr to the fusion buffer to prevent its memory
+      // from being reclaimed during finalization.
+      fusion_buffer = global_state_->fusion_buffer.GetBuffer(
+          first_entry.device, first_entry.context->framework(),
+          global_state_->fusion_buffer_index);
+      std::swap(global_state_->fusion_buffer_index, fusion_buffer_index);
+    } else {
+      fused_input_data = first_entry.tensor->data();
+      buffer_data = (void*) first_entry.output->data();
+      buffer_len = (size_t) first_entry.output->size();
+    }
 
-  if (response.postscale_factor() != 1.0) {
-    // Execute postscaling op
-    ScaleBuffer(response.postscale_factor(), entries, buffer_data, buffer_data, num_elements);
-  }
+    if (response.prescale_factor() != 1.0) {
+      // Execute prescaling op
+      ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
+      fused_input_data = buffer_data; // for unfused, scale is done out of place
+    }
 
-  // Copy memory out of the fusion buffer.
-  if (entries.size() > 1) {
-    timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
-    MemcpyOutFusionBuffer(buffer_data, entries);
-    timeline.ActivityEndAll(entries);
+    // Do allreduce.
+    timeline.ActivityStartAll(entries, CCL_ALLREDUCE);
+    const void* sendbuf = entries.size() > 1 || fused_input_data == buffer_data
+                          ? buffer_data : fused_input_data;
+    CCL_CALL(ccl_allreduce((void*)sendbuf, buffer_data, num_elements, GetCCLDataType(first_entry.tensor),
+                           ccl_reduction_sum, nullptr /*attr*/, nullptr /*comm*/, nullptr /*stream*/, &ccl_req));
+  } catch (...) {
+    ccl_context_->ReleaseSlot(slot);
+    throw;
   }
 
-  return Status::OK();
+  // Wait for the allreduce and copy memory out of the fusion buffer on the
+  // thread of the slot, while the background thread moves on.
+  double postscale_factor = response.postscale_factor();
+  auto ccl_context = ccl_context_;
+  ccl_context_->finalizer_thread_pool.execute(
+      slot, [this, entries, ccl_req, buffer_data, num_elements, postscale_factor,
+             fusion_buffer, slot, ccl_context, &timeline]() mutable {
+    Status status;
+    try {
+      CCL_CALL(ccl_wait(ccl_req));
+      timeline.ActivityEndAll(entries);
+
+      if (postscale_factor != 1.0) {
+        // Execute postscaling op
+        ScaleBuffer(postscale_factor, entries, buffer_data, buffer_data, num_elements);
+      }
+
+      // Copy memory out of the fusion buffer.
+      if (entries.size() > 1) {
+        timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+        MemcpyOutFusionBuffer(buffer_data, entries);
+        timeline.ActivityEndAll(entries);
+      }
+    } catch (const std::exception& ex) {
+      status = Status::UnknownError(ex.what());
+    }
+    fusion_buffer.reset();
+    ccl_context->ReleaseSlot(slot);
+
+    for (auto& e : entries) {
+      timeline.End(e.tensor_name, status.ok() ? e.output : nullptr);
+    }
+    InvokeCallbacks(entries, status);
+  });
+
+  return Status::InProgress();
 }
 
 bool CCLAllreduce::Enabled(const ParameterManager& param_manager,
@@ -147,36 +237,20 @@ bool CCLAllgather::Enabled(const ParameterManager& param_manager,
 Status CCLAllgather::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
+  // Sizes of subcomponents of each entry from all ranks, and offset of each
+  // subcomponent of every entry in the final buffer after allgatherv
   int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
 
   auto& first_entry = entries[0];
 
   timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
   Status status = AllocateOutput(entries, response, entry_component_sizes, recvcounts);
   if (!status.ok()) {
-    /* Cleanup */
-    for (size_t ec = 0; ec < entries.size(); ++ec) {
-      delete[] entry_component_sizes[ec];
-      delete[] entry_component_offsets[ec];
-    }
-    delete[] entry_component_sizes;
-    delete[] entry_component_offsets;
-    delete[] recvcounts;
-    delete[] displcmnts;
     return status;
   }
   timeline.ActivityEndAll(entries);
@@ -199,7 +273,8 @@ Status CCLAllgather::Execute(std::vector<TensorTableEntry>& entries, const Respo
     buffer_data = (void*) first_entry.output->data();
   }
 
-  auto* rcounts = new uint64_t[global_size]();
+  rcounts_.assign(global_size, 0);
+  auto* rcounts = rcounts_.data();
   for (unsigned int rc = 0; rc < global_size; rc++) {
     rcounts[rc] = recvcounts[rc] * element_size;
   }
@@ -219,17 +294,6 @@ Status CCLAllgather::Execute(std::vector<TensorTableEntry>& entries, const Respo
     timeline.ActivityEndAll(entries);
   }
 
-  delete[] rcounts;
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
-
   return Status::OK();
 }
 
@@ -237,13 +301,16 @@ CCLBroadcast::CCLBroadcast(CCLContext* ccl_context, HorovodGlobalState* global_s
     : BroadcastOp(global_state), ccl_context_(ccl_context) {}
 
 Status CCLBroadcast::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& e = entries[0];
 
   // On root rank, CCL_Bcast sends data, on other ranks it receives data.
   void* data_ptr;
   size_t size;
-  if (global_state_->controller->GetRank() == e.root_rank) {
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, size);
+    global_state_->timeline.ActivityEndAll(entries);
+  } else if (global_state_->controller->GetRank() == e.root_rank) {
     data_ptr = (void*) e.tensor->data();
     size = e.tensor->size();
   } else {
@@ -258,6 +325,12 @@ Status CCLBroadcast::Execute(std::vector<TensorTableEntry>& entries, const Respo
   CCL_CALL(ccl_wait(ccl_req));
   global_state_->timeline.ActivityEndAll(entries);
 
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(data_ptr, entries);
+    global_state_->timeline.ActivityEndAll(entries);
+  }
+
   return Status::OK();
 }
 
@@ -18,22 +18,44 @@
 #ifndef HOROVOD_CCL_OPERATIONS_H
 #define HOROVOD_CCL_OPERATIONS_H
 
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <pthread.h>
+#include <vector>
 
 #include "ccl.h"
 
 #include "collective_operations.h"
 #include "../common.h"
 #include "../global_state.h"
+#include "../thread_pool.h"
 
 namespace horovod {
 namespace common {
 
+// Allreduces are launched on the background thread and finalized on the
+// thread of their slot, so up to num_in_flight_ops of them are in flight
+// while the next cycles are negotiated. Each slot has a fusion buffer of its
+// own.
 struct CCLContext {
-  void Init();
+  void Init(int num_in_flight_ops);
 
   void Finalize();
+
+  // Waits until the last allreduce of the next slot is finalized, and returns
+  // the slot.
+  int AcquireSlot();
+
+  void ReleaseSlot(int slot);
+
+  ThreadPool finalizer_thread_pool;
+
+private:
+  std::mutex slots_mutex_;
+  std::condition_variable slots_cond_;
+  std::vector<bool> slot_busy_;
+  int next_slot_ = 0;
 };
 
 class CCLAllreduce : public AllreduceOp {
@@ -70,6 +92,10 @@ public:
 
 protected:
   CCLContext* ccl_context_;
+
+private:
+  // Byte counts of the ranks, kept like allgather_layout_.
+  std::vector<uint64_t> rcounts_;
 };
 
 class CCLBroadcast : public BroadcastOp {
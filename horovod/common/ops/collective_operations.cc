@@ -16,6 +16,9 @@
 // =============================================================================
 
 #include "collective_operations.h"
+
+#include <algorithm>
+
 #include "../message.h"
 
 namespace horovod {
@@ -39,10 +42,21 @@ AllreduceOp::AllreduceOp(HorovodGlobalState* global_state)
 void AllreduceOp::MemcpyInFusionBuffer(
     const std::vector<TensorTableEntry>& entries, const void*& fused_input_data,
     void*& buffer_data, size_t& buffer_len) {
-  // Access the fusion buffer.
   auto& first_entry = entries[0];
+  if (EntriesAreContiguousInPlace(entries)) {
+    // The entries already form the fused buffer, reduce them where they are.
+    buffer_data = const_cast<void*>(first_entry.output->data());
+    buffer_len = 0;
+    for (auto& e : entries) {
+      buffer_len += (size_t)e.output->size();
+    }
+    fused_input_data = buffer_data;
+    return;
+  }
+
+  // Access the fusion buffer.
   auto buffer = global_state_->fusion_buffer.GetBuffer(
-      first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
+      first_entry.device, first_entry.context->framework(), global_state_->fusion_buffer_index);
   buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
 
   int64_t offset = 0;
@@ -62,6 +76,11 @@ void AllreduceOp::MemcpyInFusionBuffer(
 
 void AllreduceOp::MemcpyOutFusionBuffer(
     const void* buffer_data, std::vector<TensorTableEntry>& entries) {
+  if (buffer_data == entries[0].output->data()) {
+    // Reduced in place by MemcpyInFusionBuffer, nothing to copy out.
+    return;
+  }
+
   int64_t offset = 0;
   for (auto& e : entries) {
     void* buffer_data_at_offset = (uint8_t*)buffer_data + offset;
@@ -70,6 +89,31 @@ void AllreduceOp::MemcpyOutFusionBuffer(
   }
 }
 
+bool AllreduceOp::EntriesAreContiguousInPlace(
+    const std::vector<TensorTableEntry>& entries) const {
+  auto next_data = (const uint8_t*)entries[0].output->data();
+  int64_t num_elements = 0;
+  for (auto& e : entries) {
+    if (e.tensor->data() != e.output->data() || e.output->data() != next_data ||
+        e.tensor->size() != e.output->size()) {
+      return false;
+    }
+    next_data += e.output->size();
+    num_elements += e.tensor->shape().num_elements();
+  }
+  // The padding would be read and written past the end of the last entry.
+  return PaddedNumElements(entries) == num_elements;
+}
+
+int64_t AllreduceOp::PaddedNumElements(
+    const std::vector<TensorTableEntry>& entries) const {
+  int64_t num_elements = 0;
+  for (auto& e : entries) {
+    num_elements += e.tensor->shape().num_elements();
+  }
+  return num_elements;
+}
+
 void AllreduceOp::MemcpyEntryInFusionBuffer(
     const std::vector<TensorTableEntry>& entries, const TensorTableEntry& e,
     void* buffer_data_at_offset) {
@@ -113,6 +157,9 @@ void AllreduceOp::ScaleBuffer(
     case HOROVOD_FLOAT64:
       ScaleBufferCPUImpl((const double*) fused_input_data, (double*) buffer_data, num_elements, scale_factor);
       break;
+    case HOROVOD_BFLOAT16:
+      ScaleBufferCPUImpl((const BFloat16*) fused_input_data, (BFloat16*) buffer_data, num_elements, (float) scale_factor);
+      break;
     default:
       throw std::logic_error("Type " + DataType_Name(dtype) +
                              " not supported by ScaleBufferCPUImpl.");
@@ -120,6 +167,22 @@ void AllreduceOp::ScaleBuffer(
 }
 
 // Allgather
+void AllgatherLayout::Reset(size_t num_entries, int global_size) {
+  // assign() keeps the capacity of earlier operations.
+  entry_component_sizes_.assign(num_entries * global_size, 0);
+  entry_component_offsets_.assign(num_entries * global_size, 0);
+  entry_component_size_rows_.resize(num_entries);
+  entry_component_offset_rows_.resize(num_entries);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    entry_component_size_rows_[ec] =
+        entry_component_sizes_.data() + ec * global_size;
+    entry_component_offset_rows_[ec] =
+        entry_component_offsets_.data() + ec * global_size;
+  }
+  recvcounts_.assign(global_size, 0);
+  displcmnts_.assign(global_size, 0);
+}
+
 AllgatherOp::AllgatherOp(HorovodGlobalState* global_state)
     : HorovodOp(global_state) {}
 
@@ -201,7 +264,7 @@ void AllgatherOp::MemcpyInFusionBuffer(
   // Access the fusion buffer.
   auto& first_entry = entries[0];
   auto buffer = global_state_->fusion_buffer.GetBuffer(
-      first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
+      first_entry.device, first_entry.context->framework(), global_state_->fusion_buffer_index);
   buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
 
   int64_t offset = displcmnts[global_state_->controller->GetRank()] * element_size;
@@ -250,9 +313,153 @@ void AllgatherOp::MemcpyEntryOutFusionBuffer(
 BroadcastOp::BroadcastOp(HorovodGlobalState* global_state)
     : HorovodOp(global_state) {}
 
+void BroadcastOp::MemcpyInFusionBuffer(
+    const std::vector<TensorTableEntry>& entries, void*& buffer_data,
+    size_t& buffer_len) {
+  auto& first_entry = entries[0];
+  auto buffer = global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(),
+      global_state_->fusion_buffer_index);
+  buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+  bool is_root_rank =
+      global_state_->controller->GetRank() == first_entry.root_rank;
+  buffer_len = 0;
+  for (auto& e : entries) {
+    if (is_root_rank) {
+      MemcpyEntryInFusionBuffer(e, (uint8_t*)buffer_data + buffer_len);
+    }
+    buffer_len += (size_t)e.tensor->size();
+  }
+}
+
+void BroadcastOp::MemcpyOutFusionBuffer(
+    const void* buffer_data, std::vector<TensorTableEntry>& entries) {
+  if (global_state_->controller->GetRank() == entries[0].root_rank) {
+    // The outputs of the root rank already hold its tensors.
+    return;
+  }
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    MemcpyEntryOutFusionBuffer((const uint8_t*)buffer_data + offset, e);
+    offset += e.output->size();
+  }
+}
+
+void BroadcastOp::MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                            void* buffer_data_at_offset) {
+  std::memcpy(buffer_data_at_offset, e.tensor->data(),
+              (size_t)e.tensor->size());
+}
+
+void BroadcastOp::MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                             TensorTableEntry& e) {
+  std::memcpy((void*)e.output->data(), buffer_data_at_offset,
+              (size_t)e.output->size());
+}
+
 AlltoallOp::AlltoallOp(HorovodGlobalState* global_state)
     : HorovodOp(global_state) {}
 
+// Reducescatter
+ReducescatterOp::ReducescatterOp(HorovodGlobalState* global_state)
+    : HorovodOp(global_state) {}
+
+void ReducescatterOp::ComponentRows(const TensorTableEntry& e, int rank,
+                                    int64_t& first_row,
+                                    int64_t& num_rows) const {
+  int64_t global_size = global_state_->controller->GetSize();
+  int64_t dim_size = e.tensor->shape().dim_size(0);
+  int64_t rows = dim_size / global_size;
+  int64_t extra_rows = dim_size % global_size;
+  num_rows = rows + (rank < extra_rows ? 1 : 0);
+  first_row = rank * rows + std::min((int64_t)rank, extra_rows);
+}
+
+Status ReducescatterOp::AllocateOutput(std::vector<TensorTableEntry>& entries,
+                                       std::vector<int64_t>& recvcounts) {
+  int global_size = global_state_->controller->GetSize();
+  int global_rank = global_state_->controller->GetRank();
+  recvcounts.assign(global_size, 0);
+  for (auto& e : entries) {
+    TensorShape slice_shape;
+    for (int i = 1; i < e.tensor->shape().dims(); ++i) {
+      slice_shape.AddDim(e.tensor->shape().dim_size(i));
+    }
+    int64_t slice_num_elements = slice_shape.num_elements();
+
+    int64_t first_row;
+    int64_t num_rows;
+    for (int rc = 0; rc < global_size; ++rc) {
+      ComponentRows(e, rc, first_row, num_rows);
+      recvcounts[rc] += num_rows * slice_num_elements;
+    }
+
+    ComponentRows(e, global_rank, first_row, num_rows);
+    TensorShape output_shape;
+    output_shape.AddDim(num_rows);
+    output_shape.AppendShape(slice_shape);
+    Status status = e.context->AllocateOutput(output_shape, &e.output);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::OK();
+}
+
+void ReducescatterOp::MemcpyInFusionBuffer(
+    const std::vector<TensorTableEntry>& entries, void*& buffer_data,
+    size_t& buffer_len) {
+  auto& first_entry = entries[0];
+  auto buffer = global_state_->fusion_buffer.GetBuffer(
+      first_entry.device, first_entry.context->framework(),
+      global_state_->fusion_buffer_index);
+  buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+  int global_size = global_state_->controller->GetSize();
+  buffer_len = 0;
+  for (int rc = 0; rc < global_size; ++rc) {
+    for (auto& e : entries) {
+      int64_t dim_size = e.tensor->shape().dim_size(0);
+      int64_t row_size = dim_size > 0 ? e.tensor->size() / dim_size : 0;
+      int64_t first_row;
+      int64_t num_rows;
+      ComponentRows(e, rc, first_row, num_rows);
+      size_t entry_size = (size_t)(num_rows * row_size);
+      if (entry_size > 0) {
+        MemcpyEntryInFusionBuffer(e, first_row * row_size, entry_size,
+                                  (uint8_t*)buffer_data + buffer_len);
+      }
+      buffer_len += entry_size;
+    }
+  }
+}
+
+void ReducescatterOp::MemcpyOutFusionBuffer(
+    const void* buffer_data, std::vector<TensorTableEntry>& entries) {
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    if (e.output->size() > 0) {
+      MemcpyEntryOutFusionBuffer((const uint8_t*)buffer_data + offset, e);
+    }
+    offset += e.output->size();
+  }
+}
+
+void ReducescatterOp::MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                                int64_t entry_offset,
+                                                size_t entry_size,
+                                                void* buffer_data_at_offset) {
+  std::memcpy(buffer_data_at_offset,
+              (const uint8_t*)e.tensor->data() + entry_offset, entry_size);
+}
+
+void ReducescatterOp::MemcpyEntryOutFusionBuffer(
+    const void* buffer_data_at_offset, TensorTableEntry& e) {
+  std::memcpy((void*)e.output->data(), buffer_data_at_offset,
+              (size_t)e.output->size());
+}
+
 // Join
 JoinOp::JoinOp(HorovodGlobalState* global_state) : HorovodOp(global_state) {}
 
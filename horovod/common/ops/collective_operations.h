@@ -42,12 +42,44 @@ public:
   virtual Status Execute(std::vector<TensorTableEntry>& entries,
                          const Response& response) = 0;
 
+  // Returns true if the operation makes its GPU stream wait for the ready
+  // events of the entries, so that the background thread does not have to
+  // wait for them on the host before executing it.
+  virtual bool WaitsForReadyEventsOnDevice() const { return false; }
+
+  // Returns true if executing the response does not communicate through the
+  // controller, so that it can run on the execution thread while the
+  // background thread negotiates the next cycle.
+  virtual bool ExecutesWithoutController(
+      const std::vector<TensorTableEntry>& entries,
+      const Response& response) const {
+    return false;
+  }
+
+  // Returns true if the operation launches its NCCL calls in the
+  // NCCLLaunchBatch of the cycle. The batch is flushed before the other
+  // operations.
+  virtual bool JoinsLaunchBatch(const std::vector<TensorTableEntry>& entries,
+                                const Response& response) const {
+    return false;
+  }
+
 protected:
   int64_t NumElements(std::vector<TensorTableEntry>& entries);
 
   HorovodGlobalState* global_state_;
 };
 
+// Kinds of allreduce operations, selected by size with
+// HOROVOD_ALLREDUCE_DISPATCH.
+enum class AllreduceAlgorithm {
+  // The first enabled operation, the default.
+  AUTO = 0,
+  FLAT = 1,
+  HIERARCHICAL = 2,
+  TORUS = 3
+};
+
 class AllreduceOp : public HorovodOp {
 public:
   AllreduceOp(HorovodGlobalState* global_state);
@@ -61,6 +93,22 @@ public:
                        const std::vector<TensorTableEntry>& entries,
                        const Response& response) const = 0;
 
+  virtual AllreduceAlgorithm Algorithm() const {
+    return AllreduceAlgorithm::FLAT;
+  }
+
+  // Returns true if the operation can execute the response when the
+  // dispatch table selects its algorithm, whatever the tuned parameters and
+  // options that enable it say.
+  virtual bool Supports(const std::vector<TensorTableEntry>& entries,
+                        const Response& response) const {
+    return Enabled(global_state_->parameter_manager, entries, response);
+  }
+
+  // Returns true if the operation can execute the responses of process sets
+  // on the communicators of the sets.
+  virtual bool SupportsProcessSets() const { return false; }
+
 protected:
   virtual void
   MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
@@ -70,6 +118,18 @@ protected:
   virtual void MemcpyOutFusionBuffer(const void* buffer_data,
                                      std::vector<TensorTableEntry>& entries);
 
+  // Returns true if every entry is reduced in place and the entries lie back
+  // to back in memory in response order, like gradients allocated from one
+  // contiguous buffer, and the operation does not pad them. The fusion buffer
+  // is not used for such entries.
+  bool
+  EntriesAreContiguousInPlace(const std::vector<TensorTableEntry>& entries) const;
+
+  // Returns the number of elements the operation reduces for the fused
+  // entries, including the padding it reduces past the last entry.
+  virtual int64_t
+  PaddedNumElements(const std::vector<TensorTableEntry>& entries) const;
+
   virtual void
   MemcpyEntryInFusionBuffer(const std::vector<TensorTableEntry>& entries,
                             const TensorTableEntry& e,
@@ -124,6 +184,39 @@ void ScaleBufferCPUImpl(const unsigned short* input, unsigned short* output, int
 
 }
 
+// Specialization for bfloat16
+template <> inline
+void ScaleBufferCPUImpl(const BFloat16* input, BFloat16* output, int64_t num_elements, float scale_factor) {
+  for (int64_t i = 0; i < num_elements; ++i) {
+    float in_float;
+    BFloat16Bits2Float(&input[i].bits, &in_float);
+    float out_float = scale_factor * in_float;
+    Float2BFloat16Bits(&out_float, &output[i].bits);
+  }
+}
+
+// Per-rank sizes and offsets of the entries of an allgather, as rows of
+// flat arrays. The arrays are kept by the op and reused, so that allgathers
+// of many fused entries across many ranks do not allocate.
+class AllgatherLayout {
+public:
+  // Zeroes the layout of num_entries entries gathered from global_size ranks.
+  void Reset(size_t num_entries, int global_size);
+
+  int64_t** EntryComponentSizes() { return entry_component_size_rows_.data(); }
+  int64_t** EntryComponentOffsets() { return entry_component_offset_rows_.data(); }
+  int* RecvCounts() { return recvcounts_.data(); }
+  int* Displacements() { return displcmnts_.data(); }
+
+private:
+  std::vector<int64_t> entry_component_sizes_;
+  std::vector<int64_t> entry_component_offsets_;
+  std::vector<int64_t*> entry_component_size_rows_;
+  std::vector<int64_t*> entry_component_offset_rows_;
+  std::vector<int> recvcounts_;
+  std::vector<int> displcmnts_;
+};
+
 class AllgatherOp : public HorovodOp {
 public:
   AllgatherOp(HorovodGlobalState* global_state);
@@ -173,6 +266,8 @@ protected:
                              TensorTableEntry& e,
                              int64_t entry_offset,
                              size_t entry_size);
+
+  AllgatherLayout allgather_layout_;
 };
 
 class BroadcastOp : public HorovodOp {
@@ -187,6 +282,31 @@ public:
   virtual bool Enabled(const ParameterManager& param_manager,
                        const std::vector<TensorTableEntry>& entries,
                        const Response& response) const = 0;
+
+protected:
+  // Fused broadcasts share a root rank, which packs its tensors into the
+  // fusion buffer. The other ranks receive into the fusion buffer and unpack
+  // it into their outputs.
+  virtual void MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                    void*& buffer_data, size_t& buffer_len);
+
+  virtual void MemcpyOutFusionBuffer(const void* buffer_data,
+                                     std::vector<TensorTableEntry>& entries);
+
+  virtual void MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                         void* buffer_data_at_offset);
+
+  virtual void MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                          TensorTableEntry& e);
+};
+
+// Counts and displacements of one entry of an alltoall.
+template <typename T>
+struct AlltoallParams {
+  std::vector<T> sdispls;
+  std::vector<T> rdispls;
+  std::vector<T> sendcounts;
+  std::vector<T> recvcounts;
 };
 
 class AlltoallOp : public HorovodOp {
@@ -209,13 +329,58 @@ protected:
                                 std::vector<T>& rdispls,
                                 std::vector<T>& sendcounts,
                                 std::vector<T>& recvcounts) {
-    auto world_size = global_state_->controller->GetSize();
-
-    const auto& splits = e.splits;
     std::vector<int32_t> recvsplits;
     // Perform alltoall of splits to get expeceted receive splits
+    global_state_->controller->AlltoallGetRecvSplits(e.splits, recvsplits);
+    return PrepareEntryOutputAndParams(e, recvsplits, 0, 1, sdispls, rdispls,
+                                       sendcounts, recvcounts);
+  }
+
+  // Fused alltoalls exchange the splits of all entries at once, and prepare
+  // the counts and displacements of every entry.
+  template <typename T>
+  Status PrepareOutputAndParams(std::vector<TensorTableEntry>& entries,
+                                std::vector<AlltoallParams<T>>& params) {
+    auto world_size = global_state_->controller->GetSize();
+    size_t num_entries = entries.size();
+
+    // The splits of all entries for a rank are sent together.
+    std::vector<int32_t> splits(world_size * num_entries);
+    for (size_t ec = 0; ec < num_entries; ++ec) {
+      for (int i = 0; i < world_size; ++i) {
+        splits[i * num_entries + ec] = entries[ec].splits[i];
+      }
+    }
+    std::vector<int32_t> recvsplits;
     global_state_->controller->AlltoallGetRecvSplits(splits, recvsplits);
 
+    params.resize(num_entries);
+    for (size_t ec = 0; ec < num_entries; ++ec) {
+      auto& p = params[ec];
+      Status status = PrepareEntryOutputAndParams(
+          entries[ec], recvsplits, ec, num_entries, p.sdispls, p.rdispls,
+          p.sendcounts, p.recvcounts);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return Status::OK();
+  }
+
+  // recvsplits holds stride splits from every rank, the ones of this entry at
+  // index.
+  template <typename T>
+  Status PrepareEntryOutputAndParams(TensorTableEntry& e,
+                                     const std::vector<int32_t>& recvsplits,
+                                     size_t index, size_t stride,
+                                     std::vector<T>& sdispls,
+                                     std::vector<T>& rdispls,
+                                     std::vector<T>& sendcounts,
+                                     std::vector<T>& recvcounts) {
+    auto world_size = global_state_->controller->GetSize();
+
+    const auto& splits = e.splits;
+
     // Every tensor participating in Alltoall operation may have different
     // first dimension size, but the rest of dimensions are same for all
     // tensors.  Here we get shape of tensor sliced by first dimension.
@@ -226,16 +391,17 @@ protected:
     int64_t slice_num_elements = slice_shape.num_elements();
 
     // Prepare send/recvcounts and displacements for Alltoallv
-    sdispls.resize(world_size);
-    rdispls.resize(world_size);
+    sdispls.assign(world_size, 0);
+    rdispls.assign(world_size, 0);
     sendcounts.resize(world_size);
     recvcounts.resize(world_size);
 
     size_t output_first_dim = 0;
     for (int i = 0; i < world_size; ++i) {
+      auto recvsplit = recvsplits[i * stride + index];
       sendcounts[i] = splits[i] * slice_num_elements;
-      recvcounts[i] = recvsplits[i] * slice_num_elements;
-      output_first_dim += recvsplits[i];
+      recvcounts[i] = recvsplit * slice_num_elements;
+      output_first_dim += recvsplit;
     }
 
     for (int i = 1; i < world_size; ++i) {
@@ -256,6 +422,48 @@ protected:
   }
 };
 
+class ReducescatterOp : public HorovodOp {
+public:
+  ReducescatterOp(HorovodGlobalState* global_state);
+
+  virtual ~ReducescatterOp() = default;
+
+  virtual Status Execute(std::vector<TensorTableEntry>& entries,
+                         const Response& response) = 0;
+
+  virtual bool Enabled(const ParameterManager& param_manager,
+                       const std::vector<TensorTableEntry>& entries,
+                       const Response& response) const = 0;
+
+protected:
+  // The first dimension of each entry is split across the ranks, the first
+  // dim_size % size ranks receiving one more row than the others.
+  void ComponentRows(const TensorTableEntry& e, int rank, int64_t& first_row,
+                     int64_t& num_rows) const;
+
+  // Allocates the output of each entry for this rank, and sets the number of
+  // elements every rank receives from the reduced entries.
+  virtual Status AllocateOutput(std::vector<TensorTableEntry>& entries,
+                                std::vector<int64_t>& recvcounts);
+
+  // Fused entries are packed rank by rank, the rows of every entry for rank
+  // 0 first, so that the part of each rank is contiguous in the buffer.
+  virtual void MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                    void*& buffer_data, size_t& buffer_len);
+
+  // Unpacks the reduced part of this rank into the outputs.
+  virtual void MemcpyOutFusionBuffer(const void* buffer_data,
+                                     std::vector<TensorTableEntry>& entries);
+
+  virtual void MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                         int64_t entry_offset,
+                                         size_t entry_size,
+                                         void* buffer_data_at_offset);
+
+  virtual void MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                          TensorTableEntry& e);
+};
+
 class JoinOp : public HorovodOp {
 public:
   JoinOp(HorovodGlobalState* global_state);
@@ -15,8 +15,12 @@
 
 #include "cuda_kernels.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <cuda_fp16.h>
+#if CUDART_VERSION >= 11000
+#include <cuda_bf16.h>
+#endif
 
 namespace horovod {
 namespace common {
@@ -73,6 +77,232 @@ __global__ void scale_buffer_k(const __half* input, __half* output, int64_t num_
 #endif
 }
 
+#if CUDART_VERSION >= 11000
+// Specialization for bfloat16, scaled in float32
+template<>
+__global__ void scale_buffer_k(const __nv_bfloat16* input, __nv_bfloat16* output, int64_t num_elements,
+                               const float scale_factor) {
+
+  const size_t idx = static_cast<size_t>(blockDim.x) * blockIdx.x + threadIdx.x;
+
+  for (size_t i = idx; i < num_elements; i += gridDim.x * blockDim.x) {
+    output[i] = __float2bfloat16(scale_factor * __bfloat162float(input[i]));
+  }
+}
+#endif
+
+// Copies the whole elements of type T of a byte range and returns the number
+// of bytes copied.
+template<typename T>
+__device__ size_t batched_memcpy_d(const void* in, void* out, size_t size, size_t idx, size_t stride) {
+  const T* input = reinterpret_cast<const T*>(in);
+  T* output = reinterpret_cast<T*>(out);
+  const size_t num_elements = size / sizeof(T);
+  for (size_t i = idx; i < num_elements; i += stride) {
+    output[i] = input[i];
+  }
+  return num_elements * sizeof(T);
+}
+
+#define BATCHED_D2D_BLOCKS_PER_COPY 4
+__global__ void batched_memcpy_k(BatchedD2DParams params) {
+  const size_t copy = blockIdx.x / BATCHED_D2D_BLOCKS_PER_COPY;
+  const size_t idx = static_cast<size_t>(blockDim.x) * (blockIdx.x % BATCHED_D2D_BLOCKS_PER_COPY) + threadIdx.x;
+  const size_t stride = static_cast<size_t>(blockDim.x) * BATCHED_D2D_BLOCKS_PER_COPY;
+
+  const char* input = reinterpret_cast<const char*>(params.in[copy]);
+  char* output = reinterpret_cast<char*>(params.out[copy]);
+  const size_t size = params.sizes[copy];
+
+  // Copy with the widest accesses the alignment of both pointers allows, then
+  // copy the remaining bytes one by one.
+  const size_t alignment = reinterpret_cast<size_t>(input) | reinterpret_cast<size_t>(output);
+  size_t copied = 0;
+  if (alignment % sizeof(uint4) == 0) {
+    copied = batched_memcpy_d<uint4>(input, output, size, idx, stride);
+  } else if (alignment % sizeof(uint32_t) == 0) {
+    copied = batched_memcpy_d<uint32_t>(input, output, size, idx, stride);
+  }
+  batched_memcpy_d<char>(input + copied, output + copied, size - copied, idx, stride);
+}
+
+#define NTHREADS_BATCHED_D2D_KERNEL 256
+void BatchedD2DMemcpyCudaImpl(BatchedD2DParams& params, int num_copies, cudaStream_t stream) {
+  const int64_t blocks = (int64_t) num_copies * BATCHED_D2D_BLOCKS_PER_COPY;
+  batched_memcpy_k<<<blocks, NTHREADS_BATCHED_D2D_KERNEL, 0, stream>>>(params);
+}
+
+template<typename T, typename TS>
+__device__ T scale_d(const T input, const TS scale_factor) {
+  return scale_factor * input;
+}
+
+template<>
+__device__ __half scale_d(const __half input, const __half scale_factor) {
+#if __CUDA_ARCH__ > 530
+  return scale_factor * input;
+#else
+  return __float2half(__half2float(scale_factor) * __half2float(input));
+#endif
+}
+
+#if CUDART_VERSION >= 11000
+template<>
+__device__ __nv_bfloat16 scale_d(const __nv_bfloat16 input, const float scale_factor) {
+  return __float2bfloat16(scale_factor * __bfloat162float(input));
+}
+#endif
+
+template<typename T, typename TS>
+__global__ void batched_scaled_memcpy_k(BatchedD2DParams params, int blocks_per_copy, const TS scale_factor) {
+  const size_t copy = blockIdx.x / blocks_per_copy;
+  const size_t idx = static_cast<size_t>(blockDim.x) * (blockIdx.x % blocks_per_copy) + threadIdx.x;
+  const size_t stride = static_cast<size_t>(blockDim.x) * blocks_per_copy;
+
+  const T* input = reinterpret_cast<const T*>(params.in[copy]);
+  T* output = reinterpret_cast<T*>(params.out[copy]);
+  const size_t num_elements = params.sizes[copy] / sizeof(T);
+
+  for (size_t i = idx; i < num_elements; i += stride) {
+    output[i] = scale_d(input[i], scale_factor);
+  }
+}
+
+// Large copies are not left to cudaMemcpyAsync when scaling, so the blocks per
+// copy grow with the largest copy of the launch.
+#define BATCHED_SCALED_D2D_BYTES_PER_BLOCK (64 * 1024)
+#define BATCHED_SCALED_D2D_MAX_BLOCKS_PER_COPY 64
+
+template<typename T, typename TS>
+void BatchedScaledD2DMemcpy(BatchedD2DParams& params, int num_copies, TS scale_factor,
+                            cudaStream_t stream) {
+  size_t max_size = 0;
+  for (int i = 0; i < num_copies; ++i) {
+    max_size = std::max(max_size, params.sizes[i]);
+  }
+  const int blocks_per_copy = (int) std::min<size_t>(
+      BATCHED_SCALED_D2D_MAX_BLOCKS_PER_COPY,
+      (max_size + BATCHED_SCALED_D2D_BYTES_PER_BLOCK - 1) / BATCHED_SCALED_D2D_BYTES_PER_BLOCK + 1);
+  const int64_t blocks = (int64_t) num_copies * blocks_per_copy;
+  batched_scaled_memcpy_k<T, TS><<<blocks, NTHREADS_BATCHED_D2D_KERNEL, 0, stream>>>(
+      params, blocks_per_copy, scale_factor);
+}
+
+void BatchedScaledD2DMemcpyCudaImpl(BatchedD2DParams& params, int num_copies, double scale_factor,
+                                    DataType dtype, cudaStream_t stream) {
+  switch (dtype) {
+    case HOROVOD_UINT8:
+      BatchedScaledD2DMemcpy<uint8_t, double>(params, num_copies, scale_factor, stream);
+      break;
+    case HOROVOD_INT8:
+      BatchedScaledD2DMemcpy<int8_t, double>(params, num_copies, scale_factor, stream);
+      break;
+    case HOROVOD_INT32:
+      BatchedScaledD2DMemcpy<int32_t, double>(params, num_copies, scale_factor, stream);
+      break;
+    case HOROVOD_INT64:
+      BatchedScaledD2DMemcpy<int64_t, double>(params, num_copies, scale_factor, stream);
+      break;
+    case HOROVOD_FLOAT16:
+      BatchedScaledD2DMemcpy<__half, __half>(params, num_copies, __float2half((float) scale_factor), stream);
+      break;
+    case HOROVOD_FLOAT32:
+      BatchedScaledD2DMemcpy<float, float>(params, num_copies, (float) scale_factor, stream);
+      break;
+    case HOROVOD_FLOAT64:
+      BatchedScaledD2DMemcpy<double, double>(params, num_copies, scale_factor, stream);
+      break;
+#if CUDART_VERSION >= 11000
+    case HOROVOD_BFLOAT16:
+      BatchedScaledD2DMemcpy<__nv_bfloat16, float>(params, num_copies, (float) scale_factor, stream);
+      break;
+#endif
+    default:
+      throw std::logic_error("Type " + DataType_Name(dtype) +
+                             " not supported by BatchedScaledD2DMemcpyCudaImpl.");
+  }
+}
+
+template<typename T>
+__device__ T cast_d(const float input) {
+  return (T) input;
+}
+
+template<>
+__device__ __half cast_d(const float input) {
+  return __float2half(input);
+}
+
+__device__ float to_float_d(const float input) {
+  return input;
+}
+
+__device__ float to_float_d(const __half input) {
+  return __half2float(input);
+}
+
+#if CUDART_VERSION >= 11000
+template<>
+__device__ __nv_bfloat16 cast_d(const float input) {
+  return __float2bfloat16(input);
+}
+
+__device__ float to_float_d(const __nv_bfloat16 input) {
+  return __bfloat162float(input);
+}
+#endif
+
+// Like batched_scaled_memcpy_k, with sizes counting elements, which are
+// scaled in float32 and stored as TO.
+template<typename TI, typename TO>
+__global__ void batched_cast_memcpy_k(BatchedD2DParams params, int blocks_per_copy, const float scale_factor) {
+  const size_t copy = blockIdx.x / blocks_per_copy;
+  const size_t idx = static_cast<size_t>(blockDim.x) * (blockIdx.x % blocks_per_copy) + threadIdx.x;
+  const size_t stride = static_cast<size_t>(blockDim.x) * blocks_per_copy;
+
+  const TI* input = reinterpret_cast<const TI*>(params.in[copy]);
+  TO* output = reinterpret_cast<TO*>(params.out[copy]);
+  const size_t num_elements = params.sizes[copy];
+
+  for (size_t i = idx; i < num_elements; i += stride) {
+    output[i] = cast_d<TO>(scale_factor * to_float_d(input[i]));
+  }
+}
+
+template<typename TI, typename TO>
+void BatchedCastD2DMemcpy(BatchedD2DParams& params, int num_copies, float scale_factor,
+                          cudaStream_t stream) {
+  size_t max_size = 0;
+  for (int i = 0; i < num_copies; ++i) {
+    max_size = std::max(max_size, params.sizes[i] * sizeof(TI));
+  }
+  const int blocks_per_copy = (int) std::min<size_t>(
+      BATCHED_SCALED_D2D_MAX_BLOCKS_PER_COPY,
+      (max_size + BATCHED_SCALED_D2D_BYTES_PER_BLOCK - 1) / BATCHED_SCALED_D2D_BYTES_PER_BLOCK + 1);
+  const int64_t blocks = (int64_t) num_copies * blocks_per_copy;
+  batched_cast_memcpy_k<TI, TO><<<blocks, NTHREADS_BATCHED_D2D_KERNEL, 0, stream>>>(
+      params, blocks_per_copy, scale_factor);
+}
+
+void BatchedCastD2DMemcpyCudaImpl(BatchedD2DParams& params, int num_copies, double scale_factor,
+                                  DataType in_dtype, DataType out_dtype, cudaStream_t stream) {
+  if (in_dtype == HOROVOD_FLOAT32 && out_dtype == HOROVOD_FLOAT16) {
+    BatchedCastD2DMemcpy<float, __half>(params, num_copies, (float) scale_factor, stream);
+  } else if (in_dtype == HOROVOD_FLOAT16 && out_dtype == HOROVOD_FLOAT32) {
+    BatchedCastD2DMemcpy<__half, float>(params, num_copies, (float) scale_factor, stream);
+#if CUDART_VERSION >= 11000
+  } else if (in_dtype == HOROVOD_FLOAT32 && out_dtype == HOROVOD_BFLOAT16) {
+    BatchedCastD2DMemcpy<float, __nv_bfloat16>(params, num_copies, (float) scale_factor, stream);
+  } else if (in_dtype == HOROVOD_BFLOAT16 && out_dtype == HOROVOD_FLOAT32) {
+    BatchedCastD2DMemcpy<__nv_bfloat16, float>(params, num_copies, (float) scale_factor, stream);
+#endif
+  } else {
+    throw std::logic_error("Cast from " + DataType_Name(in_dtype) + " to " +
+                           DataType_Name(out_dtype) +
+                           " not supported by BatchedCastD2DMemcpyCudaImpl.");
+  }
+}
+
 #define NTHREADS_SCALE_BUFFER_KERNEL 512
 void ScaleBufferCudaImpl(const void* fused_input_data, void* buffer_data, const int64_t num_elements, double scale_factor,
                          DataType dtype, cudaStream_t stream) {
@@ -117,12 +347,436 @@ void ScaleBufferCudaImpl(const void* fused_input_data, void* buffer_data, const
       scale_buffer_k<<<blocks, threads, 0, stream>>>((const double*) fused_input_data, (double*) buffer_data,
                                                      num_elements, scale_factor);
       break;
+#if CUDART_VERSION >= 11000
+    case HOROVOD_BFLOAT16:
+      scale_buffer_k<<<blocks, threads, 0, stream>>>((const __nv_bfloat16*) fused_input_data,
+                                                     (__nv_bfloat16*) buffer_data, num_elements,
+                                                     (float) scale_factor);
+      break;
+#endif
     default:
       throw std::logic_error("Type " + DataType_Name(dtype) +
                              " not supported by ScaleBufferCudaImpl.");
   }
 }
 
+// 16-bit values are accumulated in float32 inside the kernels, the buffers
+// are never converted as a whole.
+template<typename T>
+struct AdasumAccumulator {
+  typedef double type;
+};
+
+template<>
+struct AdasumAccumulator<__half> {
+  typedef float type;
+};
+
+template<typename T>
+__device__ typename AdasumAccumulator<T>::type adasum_load_d(const T* data, int64_t i) {
+  return data[i];
+}
+
+template<>
+__device__ float adasum_load_d(const __half* data, int64_t i) {
+  return __half2float(data[i]);
+}
+
+template<typename T>
+__device__ void adasum_store_d(T* data, int64_t i, typename AdasumAccumulator<T>::type value) {
+  data[i] = (T) value;
+}
+
+template<>
+__device__ void adasum_store_d(__half* data, int64_t i, float value) {
+  data[i] = __float2half(value);
+}
+
+#if CUDART_VERSION >= 11000
+template<>
+struct AdasumAccumulator<__nv_bfloat16> {
+  typedef float type;
+};
+
+template<>
+__device__ float adasum_load_d(const __nv_bfloat16* data, int64_t i) {
+  return __bfloat162float(data[i]);
+}
+
+template<>
+__device__ void adasum_store_d(__nv_bfloat16* data, int64_t i, float value) {
+  data[i] = __float2bfloat16(value);
+}
+#endif
+
+__device__ void atomic_add_double_d(double* address, double value) {
+#if __CUDA_ARCH__ >= 600
+  atomicAdd(address, value);
+#else
+  unsigned long long* address_as_ull = reinterpret_cast<unsigned long long*>(address);
+  unsigned long long old = *address_as_ull;
+  unsigned long long assumed;
+  do {
+    assumed = old;
+    old = atomicCAS(address_as_ull, assumed,
+                    __double_as_longlong(value + __longlong_as_double(assumed)));
+  } while (assumed != old);
+#endif
+}
+
+#define NTHREADS_ADASUM_KERNEL 256
+
+template<typename T>
+__global__ void adasum_dot_and_norms_k(const T* a, const T* b, AdasumBatchParams params,
+                                       int blocks_per_tensor, double* norm_and_dots,
+                                       bool is_left_neighbor) {
+  const int tensor = blockIdx.x / blocks_per_tensor;
+  const int64_t end = params.offsets[tensor + 1];
+  const int64_t stride = static_cast<int64_t>(blockDim.x) * blocks_per_tensor;
+
+  typedef typename AdasumAccumulator<T>::type acc_t;
+  acc_t dot = 0, anormsq = 0, bnormsq = 0;
+  for (int64_t i = params.offsets[tensor] +
+                   static_cast<int64_t>(blockDim.x) * (blockIdx.x % blocks_per_tensor) + threadIdx.x;
+       i < end; i += stride) {
+    const acc_t x = adasum_load_d(a, i);
+    const acc_t y = adasum_load_d(b, i);
+    dot += x * y;
+    anormsq += x * x;
+    bnormsq += y * y;
+  }
+
+  // The partial sums of the threads are added in double.
+  __shared__ double partials[3][NTHREADS_ADASUM_KERNEL];
+  partials[0][threadIdx.x] = dot;
+  partials[1][threadIdx.x] = anormsq;
+  partials[2][threadIdx.x] = bnormsq;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) {
+      for (int k = 0; k < 3; ++k) {
+        partials[k][threadIdx.x] += partials[k][threadIdx.x + s];
+      }
+    }
+    __syncthreads();
+  }
+
+  if (threadIdx.x == 0) {
+    double* result = norm_and_dots + 3 * tensor;
+    atomic_add_double_d(&result[0], partials[0][0]);
+    atomic_add_double_d(&result[is_left_neighbor ? 1 : 2], partials[1][0]);
+    atomic_add_double_d(&result[is_left_neighbor ? 2 : 1], partials[2][0]);
+  }
+}
+
+// sqrt(DBL_MIN), below which a squared norm is treated as zero.
+#define ADASUM_SQRT_DBL_MIN 1.4916681462400413e-154
+
+template<typename T>
+__global__ void adasum_scaled_add_k(T* a, const T* b, AdasumBatchParams params,
+                                    int blocks_per_tensor, const double* norm_and_dots,
+                                    bool is_left_neighbor) {
+  const int tensor = blockIdx.x / blocks_per_tensor;
+  const int64_t end = params.offsets[tensor + 1];
+  const int64_t stride = static_cast<int64_t>(blockDim.x) * blocks_per_tensor;
+
+  const double* result = norm_and_dots + 3 * tensor;
+  const double dot = result[0];
+  const double anormsq = result[is_left_neighbor ? 1 : 2];
+  const double bnormsq = result[is_left_neighbor ? 2 : 1];
+  typedef typename AdasumAccumulator<T>::type acc_t;
+  const acc_t acoeff = anormsq >= ADASUM_SQRT_DBL_MIN ? 1.0 - dot / anormsq * 0.5 : 1.0;
+  const acc_t bcoeff = bnormsq >= ADASUM_SQRT_DBL_MIN ? 1.0 - dot / bnormsq * 0.5 : 1.0;
+
+  for (int64_t i = params.offsets[tensor] +
+                   static_cast<int64_t>(blockDim.x) * (blockIdx.x % blocks_per_tensor) + threadIdx.x;
+       i < end; i += stride) {
+    adasum_store_d(a, i, acoeff * adasum_load_d(a, i) + bcoeff * adasum_load_d(b, i));
+  }
+}
+
+// The blocks per tensor grow with the largest tensor of the launch.
+#define ADASUM_ELEMENTS_PER_BLOCK (64 * 1024)
+#define ADASUM_MAX_BLOCKS_PER_TENSOR 64
+
+int AdasumBlocksPerTensor(const AdasumBatchParams& params, int num_tensors) {
+  int64_t max_count = 0;
+  for (int i = 0; i < num_tensors; ++i) {
+    max_count = std::max(max_count, params.offsets[i + 1] - params.offsets[i]);
+  }
+  return (int) std::min<int64_t>(ADASUM_MAX_BLOCKS_PER_TENSOR,
+                                 (max_count + ADASUM_ELEMENTS_PER_BLOCK - 1) / ADASUM_ELEMENTS_PER_BLOCK + 1);
+}
+
+void AdasumDotAndNormSqrdsCudaImpl(const void* a, const void* b, AdasumBatchParams& params,
+                                   int num_tensors, DataType dtype, double* norm_and_dots,
+                                   bool is_left_neighbor, cudaStream_t stream) {
+  if (num_tensors == 0) {
+    return;
+  }
+  const int blocks_per_tensor = AdasumBlocksPerTensor(params, num_tensors);
+  const int64_t blocks = (int64_t) num_tensors * blocks_per_tensor;
+  switch (dtype) {
+    case HOROVOD_FLOAT16:
+      adasum_dot_and_norms_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (const __half*) a, (const __half*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+    case HOROVOD_FLOAT32:
+      adasum_dot_and_norms_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (const float*) a, (const float*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+    case HOROVOD_FLOAT64:
+      adasum_dot_and_norms_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (const double*) a, (const double*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+#if CUDART_VERSION >= 11000
+    case HOROVOD_BFLOAT16:
+      adasum_dot_and_norms_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (const __nv_bfloat16*) a, (const __nv_bfloat16*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+#endif
+    default:
+      throw std::logic_error("Type " + DataType_Name(dtype) +
+                             " not supported by AdasumDotAndNormSqrdsCudaImpl.");
+  }
+}
+
+void AdasumScaledAddCudaImpl(void* a, const void* b, AdasumBatchParams& params, int num_tensors,
+                             DataType dtype, const double* norm_and_dots, bool is_left_neighbor,
+                             cudaStream_t stream) {
+  if (num_tensors == 0) {
+    return;
+  }
+  const int blocks_per_tensor = AdasumBlocksPerTensor(params, num_tensors);
+  const int64_t blocks = (int64_t) num_tensors * blocks_per_tensor;
+  switch (dtype) {
+    case HOROVOD_FLOAT16:
+      adasum_scaled_add_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (__half*) a, (const __half*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+    case HOROVOD_FLOAT32:
+      adasum_scaled_add_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (float*) a, (const float*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+    case HOROVOD_FLOAT64:
+      adasum_scaled_add_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (double*) a, (const double*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+#if CUDART_VERSION >= 11000
+    case HOROVOD_BFLOAT16:
+      adasum_scaled_add_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(
+          (__nv_bfloat16*) a, (const __nv_bfloat16*) b, params, blocks_per_tensor, norm_and_dots, is_left_neighbor);
+      break;
+#endif
+    default:
+      throw std::logic_error("Type " + DataType_Name(dtype) +
+                             " not supported by AdasumScaledAddCudaImpl.");
+  }
+}
+
+__global__ void adasum_accumulate_k(double* inout, const double* in, int count) {
+  const int idx = blockDim.x * blockIdx.x + threadIdx.x;
+  for (int i = idx; i < count; i += gridDim.x * blockDim.x) {
+    inout[i] += in[i];
+  }
+}
+
+void AdasumAccumulateCudaImpl(double* inout, const double* in, int count, cudaStream_t stream) {
+  if (count == 0) {
+    return;
+  }
+  const int blocks = (count + NTHREADS_ADASUM_KERNEL - 1) / NTHREADS_ADASUM_KERNEL;
+  adasum_accumulate_k<<<blocks, NTHREADS_ADASUM_KERNEL, 0, stream>>>(inout, in, count);
+}
+
+// The value x is stored as in T.
+template<typename T>
+__device__ typename AdasumAccumulator<T>::type adasum_round_d(
+    typename AdasumAccumulator<T>::type x) {
+  T stored;
+  adasum_store_d(&stored, 0, x);
+  return adasum_load_d(&stored, 0);
+}
+
+// Like batched_cast_memcpy_k, and adds up the squares of the stored elements,
+// in the precision of the Adasum kernels, and looks for infs and NaNs.
+template<typename TI, typename TO>
+__global__ void batched_norm_memcpy_k(BatchedNormD2DParams params, int blocks_per_copy,
+                                      const double scale_factor) {
+  const size_t copy = blockIdx.x / blocks_per_copy;
+  const size_t idx = static_cast<size_t>(blockDim.x) * (blockIdx.x % blocks_per_copy) + threadIdx.x;
+  const size_t stride = static_cast<size_t>(blockDim.x) * blocks_per_copy;
+
+  const TI* input = reinterpret_cast<const TI*>(params.in[copy]);
+  TO* output = reinterpret_cast<TO*>(params.out[copy]);
+  const size_t num_elements = params.sizes[copy];
+  const bool store = static_cast<const void*>(input) != static_cast<const void*>(output) ||
+                     scale_factor != 1.0;
+
+  typedef typename AdasumAccumulator<TO>::type acc_t;
+  const acc_t scale = (acc_t) scale_factor;
+  const bool check_finite = params.found_infs[copy] != nullptr;
+  acc_t normsq = 0;
+  bool finite = true;
+  for (size_t i = idx; i < num_elements; i += stride) {
+    const acc_t x = scale * (acc_t) adasum_load_d(input, i);
+    if (store) {
+      adasum_store_d(output, i, x);
+    }
+    normsq += x * x;
+    if (check_finite) {
+      finite = finite && isfinite(adasum_round_d<TO>(x));
+    }
+  }
+  // Every thread that saw an overflow writes the same value.
+  if (!finite) {
+    *params.found_infs[copy] = 1.0f;
+  }
+
+  // The whole block works on the same copy.
+  if (params.norm_sqrds[copy] == nullptr) {
+    return;
+  }
+  __shared__ double partials[NTHREADS_BATCHED_D2D_KERNEL];
+  partials[threadIdx.x] = normsq;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) {
+      partials[threadIdx.x] += partials[threadIdx.x + s];
+    }
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) {
+    atomic_add_double_d(params.norm_sqrds[copy], partials[0]);
+  }
+}
+
+template<typename TI, typename TO>
+void BatchedNormD2DMemcpy(BatchedNormD2DParams& params, int num_copies, double scale_factor,
+                          cudaStream_t stream) {
+  size_t max_size = 0;
+  for (int i = 0; i < num_copies; ++i) {
+    max_size = std::max(max_size, params.sizes[i] * sizeof(TI));
+  }
+  const int blocks_per_copy = (int) std::min<size_t>(
+      BATCHED_SCALED_D2D_MAX_BLOCKS_PER_COPY,
+      (max_size + BATCHED_SCALED_D2D_BYTES_PER_BLOCK - 1) / BATCHED_SCALED_D2D_BYTES_PER_BLOCK + 1);
+  const int64_t blocks = (int64_t) num_copies * blocks_per_copy;
+  batched_norm_memcpy_k<TI, TO><<<blocks, NTHREADS_BATCHED_D2D_KERNEL, 0, stream>>>(
+      params, blocks_per_copy, scale_factor);
+}
+
+void BatchedNormD2DMemcpyCudaImpl(BatchedNormD2DParams& params, int num_copies,
+                                  double scale_factor, DataType in_dtype,
+                                  DataType out_dtype, cudaStream_t stream) {
+  if (in_dtype == out_dtype && in_dtype == HOROVOD_FLOAT16) {
+    BatchedNormD2DMemcpy<__half, __half>(params, num_copies, scale_factor, stream);
+  } else if (in_dtype == out_dtype && in_dtype == HOROVOD_FLOAT32) {
+    BatchedNormD2DMemcpy<float, float>(params, num_copies, scale_factor, stream);
+  } else if (in_dtype == out_dtype && in_dtype == HOROVOD_FLOAT64) {
+    BatchedNormD2DMemcpy<double, double>(params, num_copies, scale_factor, stream);
+  } else if (in_dtype == HOROVOD_FLOAT16 && out_dtype == HOROVOD_FLOAT32) {
+    BatchedNormD2DMemcpy<__half, float>(params, num_copies, scale_factor, stream);
+#if CUDART_VERSION >= 11000
+  } else if (in_dtype == out_dtype && in_dtype == HOROVOD_BFLOAT16) {
+    BatchedNormD2DMemcpy<__nv_bfloat16, __nv_bfloat16>(params, num_copies, scale_factor, stream);
+  } else if (in_dtype == HOROVOD_BFLOAT16 && out_dtype == HOROVOD_FLOAT32) {
+    BatchedNormD2DMemcpy<__nv_bfloat16, float>(params, num_copies, scale_factor, stream);
+#endif
+  } else {
+    throw std::logic_error("Copy from " + DataType_Name(in_dtype) + " to " +
+                           DataType_Name(out_dtype) +
+                           " not supported by BatchedNormD2DMemcpyCudaImpl.");
+  }
+}
+
+template<typename T>
+__global__ void batched_optimizer_step_k(BatchedOptimizerStepParams params, int blocks_per_param,
+                                         const OptimizerStepHyperparameters hp) {
+  const size_t param = blockIdx.x / blocks_per_param;
+  const size_t idx = static_cast<size_t>(blockDim.x) * (blockIdx.x % blocks_per_param) + threadIdx.x;
+  const size_t stride = static_cast<size_t>(blockDim.x) * blocks_per_param;
+
+  T* parameter = reinterpret_cast<T*>(params.parameters[param]);
+  const T* grad = reinterpret_cast<const T*>(params.grads[param]);
+  T* state0 = reinterpret_cast<T*>(params.states0[param]);
+  T* state1 = reinterpret_cast<T*>(params.states1[param]);
+  const size_t num_elements = params.sizes[param];
+
+  typedef typename AdasumAccumulator<T>::type acc_t;
+  const acc_t lr = (acc_t) hp.lr;
+  const acc_t weight_decay = (acc_t) hp.weight_decay;
+  for (size_t i = idx; i < num_elements; i += stride) {
+    acc_t p = adasum_load_d(parameter, i);
+    acc_t g = adasum_load_d(grad, i);
+    if (hp.adam) {
+      if (hp.decoupled_weight_decay) {
+        p *= (acc_t) 1 - lr * weight_decay;
+      } else {
+        g += weight_decay * p;
+      }
+      const acc_t m = (acc_t) hp.beta1 * adasum_load_d(state0, i) + (acc_t) (1.0 - hp.beta1) * g;
+      const acc_t v = (acc_t) hp.beta2 * adasum_load_d(state1, i) + (acc_t) (1.0 - hp.beta2) * g * g;
+      adasum_store_d(state0, i, m);
+      adasum_store_d(state1, i, v);
+      const acc_t denom = sqrt(v) / (acc_t) sqrt(hp.bias_correction2) + (acc_t) hp.eps;
+      p -= lr / (acc_t) hp.bias_correction1 * m / denom;
+    } else {
+      g += weight_decay * p;
+      if (state0 != nullptr) {
+        const acc_t momentum = (acc_t) hp.momentum;
+        const acc_t buf = hp.first_step
+                              ? g
+                              : momentum * adasum_load_d(state0, i) + (acc_t) (1.0 - hp.dampening) * g;
+        adasum_store_d(state0, i, buf);
+        g = hp.nesterov ? g + momentum * buf : buf;
+      }
+      p -= lr * g;
+    }
+    adasum_store_d(parameter, i, p);
+  }
+}
+
+template<typename T>
+void BatchedOptimizerStep(BatchedOptimizerStepParams& params, int num_params,
+                          const OptimizerStepHyperparameters& hyperparameters,
+                          cudaStream_t stream) {
+  size_t max_size = 0;
+  for (int i = 0; i < num_params; ++i) {
+    max_size = std::max(max_size, params.sizes[i] * sizeof(T));
+  }
+  const int blocks_per_param = (int) std::min<size_t>(
+      BATCHED_SCALED_D2D_MAX_BLOCKS_PER_COPY,
+      (max_size + BATCHED_SCALED_D2D_BYTES_PER_BLOCK - 1) / BATCHED_SCALED_D2D_BYTES_PER_BLOCK + 1);
+  const int64_t blocks = (int64_t) num_params * blocks_per_param;
+  batched_optimizer_step_k<T><<<blocks, NTHREADS_BATCHED_D2D_KERNEL, 0, stream>>>(
+      params, blocks_per_param, hyperparameters);
+}
+
+void BatchedOptimizerStepCudaImpl(BatchedOptimizerStepParams& params, int num_params,
+                                  const OptimizerStepHyperparameters& hyperparameters,
+                                  DataType dtype, cudaStream_t stream) {
+  switch (dtype) {
+    case HOROVOD_FLOAT16:
+      BatchedOptimizerStep<__half>(params, num_params, hyperparameters, stream);
+      break;
+#if CUDART_VERSION >= 11000
+    case HOROVOD_BFLOAT16:
+      BatchedOptimizerStep<__nv_bfloat16>(params, num_params, hyperparameters, stream);
+      break;
+#endif
+    case HOROVOD_FLOAT32:
+      BatchedOptimizerStep<float>(params, num_params, hyperparameters, stream);
+      break;
+    case HOROVOD_FLOAT64:
+      BatchedOptimizerStep<double>(params, num_params, hyperparameters, stream);
+      break;
+    default:
+      throw std::logic_error("Type " + DataType_Name(dtype) +
+                             " not supported by BatchedOptimizerStepCudaImpl.");
+  }
+}
+
 } // namespace common
 } // namespace horovod
 
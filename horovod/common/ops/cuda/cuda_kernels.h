@@ -21,9 +21,127 @@
 namespace horovod {
 namespace common {
 
+// Number of copies done by one launch of the batched copy kernel, bounded by
+// the 4KB limit on kernel parameters.
+#define BATCHED_D2D_CAPACITY 160
+
+// Copies of at least this many bytes are left to cudaMemcpyAsync, which
+// reaches the full bandwidth for them.
+#define BATCHED_D2D_MAX_BYTES (1 << 20)
+
+struct BatchedD2DParams {
+  void* out[BATCHED_D2D_CAPACITY];
+  void* in[BATCHED_D2D_CAPACITY];
+  size_t sizes[BATCHED_D2D_CAPACITY];
+};
+
+// Performs num_copies device to device copies described by params in a single
+// kernel launch.
+void BatchedD2DMemcpyCudaImpl(BatchedD2DParams& params, int num_copies, cudaStream_t stream);
+
+// Performs num_copies device to device copies of elements of type dtype
+// described by params and scales the copied elements by scale_factor, in a
+// single kernel launch.
+void BatchedScaledD2DMemcpyCudaImpl(BatchedD2DParams& params, int num_copies, double scale_factor,
+                                    DataType dtype, cudaStream_t stream);
+
+// Performs num_copies device to device copies of params.sizes[i] elements,
+// converted from in_dtype to out_dtype and scaled by scale_factor, in a single
+// kernel launch. Converts float32 to half precision and back.
+void BatchedCastD2DMemcpyCudaImpl(BatchedD2DParams& params, int num_copies, double scale_factor,
+                                  DataType in_dtype, DataType out_dtype, cudaStream_t stream);
+
 void ScaleBufferCudaImpl(const void* fused_input_data, void* buffer_data, const int64_t num_elements,
                          double scale_factor, DataType dtype, cudaStream_t stream);
 
+// Number of tensors handled by one launch of the Adasum kernels, bounded by
+// the 4KB limit on kernel parameters.
+#define ADASUM_BATCH_CAPACITY 256
+
+// Tensors of a buffer, tensor i holding the elements [offsets[i],
+// offsets[i + 1]).
+struct AdasumBatchParams {
+  int64_t offsets[ADASUM_BATCH_CAPACITY + 1];
+};
+
+// Adds the dot product of a and b for every tensor of the batch to
+// norm_and_dots[3 * i], and their squared norms to norm_and_dots[3 * i + 1]
+// and norm_and_dots[3 * i + 2], the one of the left neighbor first. a belongs
+// to the left neighbor if is_left_neighbor.
+void AdasumDotAndNormSqrdsCudaImpl(const void* a, const void* b, AdasumBatchParams& params,
+                                   int num_tensors, DataType dtype, double* norm_and_dots,
+                                   bool is_left_neighbor, cudaStream_t stream);
+
+// Updates every tensor of the batch to acoeff * a + bcoeff * b, with the
+// Adasum coefficients computed from its entries of norm_and_dots.
+void AdasumScaledAddCudaImpl(void* a, const void* b, AdasumBatchParams& params, int num_tensors,
+                             DataType dtype, const double* norm_and_dots, bool is_left_neighbor,
+                             cudaStream_t stream);
+
+// Adds in to inout, element by element.
+void AdasumAccumulateCudaImpl(double* inout, const double* in, int count, cudaStream_t stream);
+
+// Number of copies done by one launch of the norm accumulating copy kernel,
+// bounded by the 4KB limit on kernel parameters.
+#define BATCHED_NORM_D2D_CAPACITY 96
+
+// Copies of sizes[i] elements, the squared norms they are added to and the
+// flags set if they overflow, null for the copies without one.
+struct BatchedNormD2DParams {
+  void* out[BATCHED_NORM_D2D_CAPACITY];
+  void* in[BATCHED_NORM_D2D_CAPACITY];
+  size_t sizes[BATCHED_NORM_D2D_CAPACITY];
+  double* norm_sqrds[BATCHED_NORM_D2D_CAPACITY];
+  float* found_infs[BATCHED_NORM_D2D_CAPACITY];
+};
+
+// Like BatchedCastD2DMemcpyCudaImpl, in_dtype and out_dtype being possibly
+// the same, adds the squared L2 norm of the elements copied to out[i] to
+// *norm_sqrds[i] and sets *found_infs[i] to one if one of them, as stored, is
+// an inf or a NaN. Copies with in[i] == out[i] and no scaling only read.
+void BatchedNormD2DMemcpyCudaImpl(BatchedNormD2DParams& params, int num_copies,
+                                  double scale_factor, DataType in_dtype,
+                                  DataType out_dtype, cudaStream_t stream);
+
+// Number of parameters updated by one launch of the optimizer step kernel,
+// bounded by the 4KB limit on kernel parameters.
+#define BATCHED_OPTIMIZER_STEP_CAPACITY 96
+
+// Parameters of sizes[i] elements, their reduced gradients and their states,
+// see OptimizerStep. states0[i] is null for SGD without momentum.
+struct BatchedOptimizerStepParams {
+  void* parameters[BATCHED_OPTIMIZER_STEP_CAPACITY];
+  void* grads[BATCHED_OPTIMIZER_STEP_CAPACITY];
+  void* states0[BATCHED_OPTIMIZER_STEP_CAPACITY];
+  void* states1[BATCHED_OPTIMIZER_STEP_CAPACITY];
+  size_t sizes[BATCHED_OPTIMIZER_STEP_CAPACITY];
+};
+
+// The hyperparameters shared by the parameters of a launch, with the bias
+// corrections of Adam computed from its step.
+struct OptimizerStepHyperparameters {
+  bool adam;
+  double lr;
+  double weight_decay;
+  double momentum;
+  double dampening;
+  bool nesterov;
+  bool first_step;
+  double beta1;
+  double beta2;
+  double eps;
+  double bias_correction1;
+  double bias_correction2;
+  bool decoupled_weight_decay;
+};
+
+// Updates num_params parameters of type dtype from their gradients like
+// torch.optim.SGD or torch.optim.Adam(W), in the precision of the Adasum
+// kernels.
+void BatchedOptimizerStepCudaImpl(BatchedOptimizerStepParams& params, int num_params,
+                                  const OptimizerStepHyperparameters& hyperparameters,
+                                  DataType dtype, cudaStream_t stream);
+
 } // namespace common
 } // namespace horovod
 
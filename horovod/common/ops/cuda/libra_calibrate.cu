@@ -0,0 +1,389 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// Offline calibration of the Libra channel table.
+//
+// Sweeps ncclAllReduce over message sizes, block (channel) counts and
+// threads per block, on all GPUs of the node, while a synthetic compute load
+// runs on every GPU. For every message size and number of concurrent
+// allreduces, the allocation that finishes both the allreduces and the
+// compute load first is written out in the format read by
+// HOROVOD_LIBRA_CHANNEL_TABLE:
+//
+//   max_bytes concurrent_groups block_num thread_num
+//
+// With --cost-output, the time of the allreduces of every measured point,
+// with the compute load beside them, is written out as well. It is the cost
+// model of the offline fusion plan simulator:
+//
+//   bytes concurrent_groups block_num thread_num milliseconds
+//
+// Usage:
+//   horovod_libra_calibrate [--output FILE] [--cost-output FILE]
+//                           [--min-bytes N] [--max-bytes N]
+//                           [--blocks 1,2,4,...] [--threads 128,256,...]
+//                           [--concurrency 1,2,...] [--iterations N]
+//                           [--load-ms N]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cuda_runtime.h>
+#include <nccl.h>
+
+#define CUDA_CHECK(cmd)                                                        \
+  do {                                                                         \
+    cudaError_t e = cmd;                                                       \
+    if (e != cudaSuccess) {                                                    \
+      std::cerr << #cmd << " failed: " << cudaGetErrorString(e) << std::endl; \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
+
+#define NCCL_CHECK(cmd)                                                        \
+  do {                                                                         \
+    ncclResult_t r = cmd;                                                      \
+    if (r != ncclSuccess) {                                                    \
+      std::cerr << #cmd << " failed: " << ncclGetErrorString(r) << std::endl; \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
+
+namespace {
+
+// Stand-in for the GEMMs of a training step: every thread runs a chain of
+// dependent FMAs, which keeps the SMs busy without touching much memory.
+__global__ void synthetic_load_k(float* data, int iterations) {
+  const size_t idx = static_cast<size_t>(blockDim.x) * blockIdx.x + threadIdx.x;
+  float a = data[idx];
+  float b = a * 0.5f + 1.0f;
+  for (int i = 0; i < iterations; ++i) {
+    a = fmaf(a, b, 0.999f);
+    b = fmaf(b, a, 0.001f);
+  }
+  data[idx] = a + b;
+}
+
+#define LOAD_THREADS 256
+#define LOAD_BLOCKS_PER_SM 4
+
+struct Options {
+  std::string output = "libra_channel_table.txt";
+  std::string cost_output;
+  int64_t min_bytes = 4 * 1024;
+  int64_t max_bytes = 256 * 1024 * 1024;
+  std::vector<int> blocks = {1, 2, 4, 8, 12, 16, 24, 32};
+  std::vector<int> threads = {128, 256, 512};
+  std::vector<int> concurrency = {1, 2, 4};
+  int iterations = 5;
+  float load_ms = 0;
+};
+
+struct Device {
+  int id;
+  int sm_count;
+  // One communicator per concurrent allreduce, NCCL does not allow
+  // concurrent operations on one communicator.
+  std::vector<ncclComm_t> comms;
+  cudaStream_t load_stream;
+  std::vector<cudaStream_t> comm_streams;
+  std::vector<float*> buffers;
+  float* load_data;
+  int load_iterations;
+  cudaEvent_t start;
+  cudaEvent_t load_done;
+  std::vector<cudaEvent_t> comm_done;
+};
+
+std::vector<int> ParseList(const char* value) {
+  std::vector<int> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(std::atoi(item.c_str()));
+  }
+  return result;
+}
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      std::exit(1);
+    }
+    const char* value = argv[++i];
+    if (arg == "--output") {
+      options.output = value;
+    } else if (arg == "--cost-output") {
+      options.cost_output = value;
+    } else if (arg == "--min-bytes") {
+      options.min_bytes = std::atoll(value);
+    } else if (arg == "--max-bytes") {
+      options.max_bytes = std::atoll(value);
+    } else if (arg == "--blocks") {
+      options.blocks = ParseList(value);
+    } else if (arg == "--threads") {
+      options.threads = ParseList(value);
+    } else if (arg == "--concurrency") {
+      options.concurrency = ParseList(value);
+    } else if (arg == "--iterations") {
+      options.iterations = std::max(1, std::atoi(value));
+    } else if (arg == "--load-ms") {
+      options.load_ms = (float)std::atof(value);
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      std::exit(1);
+    }
+  }
+  return options;
+}
+
+void LaunchLoad(Device& device) {
+  int blocks = device.sm_count * LOAD_BLOCKS_PER_SM;
+  synthetic_load_k<<<blocks, LOAD_THREADS, 0, device.load_stream>>>(
+      device.load_data, device.load_iterations);
+}
+
+// Pick the load length so that it takes about load_ms on its own.
+void CalibrateLoad(Device& device, float load_ms) {
+  CUDA_CHECK(cudaSetDevice(device.id));
+  device.load_iterations = 1 << 12;
+  for (int attempt = 0; attempt < 8; ++attempt) {
+    CUDA_CHECK(cudaEventRecord(device.start, device.load_stream));
+    LaunchLoad(device);
+    CUDA_CHECK(cudaEventRecord(device.load_done, device.load_stream));
+    CUDA_CHECK(cudaEventSynchronize(device.load_done));
+    float elapsed;
+    CUDA_CHECK(cudaEventElapsedTime(&elapsed, device.start, device.load_done));
+    if (elapsed <= 0) {
+      device.load_iterations *= 16;
+      continue;
+    }
+    device.load_iterations =
+        std::max(1, (int)(device.load_iterations * load_ms / elapsed));
+  }
+}
+
+// Runs one sweep point and returns the time until both the allreduces and
+// the compute load finished on the slowest GPU. comm_time is set to the time
+// until the allreduces alone finished.
+float Measure(std::vector<Device>& devices, int64_t bytes, int concurrency,
+              int block_num, int thread_num, int iterations,
+              float& comm_time) {
+  size_t count = bytes / sizeof(float);
+  float total = 0;
+  float comm_total = 0;
+  for (int iteration = -1; iteration < iterations; ++iteration) {
+    for (auto& device : devices) {
+      CUDA_CHECK(cudaSetDevice(device.id));
+      CUDA_CHECK(cudaEventRecord(device.start, device.load_stream));
+      for (int k = 0; k < concurrency; ++k) {
+        CUDA_CHECK(cudaStreamWaitEvent(device.comm_streams[k], device.start, 0));
+      }
+      LaunchLoad(device);
+      CUDA_CHECK(cudaEventRecord(device.load_done, device.load_stream));
+    }
+
+    NCCL_CHECK(ncclGroupStart());
+    for (auto& device : devices) {
+      for (int k = 0; k < concurrency; ++k) {
+        NCCL_CHECK(ncclAllReduce(device.buffers[k], device.buffers[k], count,
+                                 ncclFloat, ncclSum, device.comms[k],
+                                 device.comm_streams[k], block_num, thread_num));
+      }
+    }
+    NCCL_CHECK(ncclGroupEnd());
+    for (auto& device : devices) {
+      CUDA_CHECK(cudaSetDevice(device.id));
+      for (int k = 0; k < concurrency; ++k) {
+        CUDA_CHECK(cudaEventRecord(device.comm_done[k], device.comm_streams[k]));
+      }
+    }
+
+    float slowest = 0;
+    float comm_slowest = 0;
+    for (auto& device : devices) {
+      CUDA_CHECK(cudaSetDevice(device.id));
+      float finish;
+      CUDA_CHECK(cudaEventSynchronize(device.load_done));
+      CUDA_CHECK(cudaEventElapsedTime(&finish, device.start, device.load_done));
+      for (int k = 0; k < concurrency; ++k) {
+        CUDA_CHECK(cudaEventSynchronize(device.comm_done[k]));
+        float comm_finish;
+        CUDA_CHECK(cudaEventElapsedTime(&comm_finish, device.start,
+                                        device.comm_done[k]));
+        finish = std::max(finish, comm_finish);
+        comm_slowest = std::max(comm_slowest, comm_finish);
+      }
+      slowest = std::max(slowest, finish);
+    }
+    // The first iteration is a warmup.
+    if (iteration >= 0) {
+      total += slowest;
+      comm_total += comm_slowest;
+    }
+  }
+  comm_time = comm_total / iterations;
+  return total / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options = ParseOptions(argc, argv);
+
+  int num_devices;
+  CUDA_CHECK(cudaGetDeviceCount(&num_devices));
+  if (num_devices < 1) {
+    std::cerr << "No GPUs found." << std::endl;
+    return 1;
+  }
+  int max_concurrency =
+      *std::max_element(options.concurrency.begin(), options.concurrency.end());
+
+  std::vector<int> device_ids(num_devices);
+  for (int i = 0; i < num_devices; ++i) {
+    device_ids[i] = i;
+  }
+  std::vector<Device> devices(num_devices);
+  for (int k = 0; k < max_concurrency; ++k) {
+    std::vector<ncclComm_t> comms(num_devices);
+    NCCL_CHECK(ncclCommInitAll(comms.data(), num_devices, device_ids.data()));
+    for (int i = 0; i < num_devices; ++i) {
+      devices[i].comms.push_back(comms[i]);
+    }
+  }
+
+  for (int i = 0; i < num_devices; ++i) {
+    auto& device = devices[i];
+    device.id = i;
+    CUDA_CHECK(cudaSetDevice(i));
+    CUDA_CHECK(cudaDeviceGetAttribute(&device.sm_count,
+                                      cudaDevAttrMultiProcessorCount, i));
+    int lowest_priority, greatest_priority;
+    CUDA_CHECK(cudaDeviceGetStreamPriorityRange(&lowest_priority,
+                                                &greatest_priority));
+    // Same priorities as Horovod and the framework compute streams.
+    CUDA_CHECK(cudaStreamCreateWithPriority(
+        &device.load_stream, cudaStreamNonBlocking, lowest_priority));
+    device.comm_streams.resize(max_concurrency);
+    device.buffers.resize(max_concurrency);
+    device.comm_done.resize(max_concurrency);
+    for (int k = 0; k < max_concurrency; ++k) {
+      CUDA_CHECK(cudaStreamCreateWithPriority(
+          &device.comm_streams[k], cudaStreamNonBlocking, greatest_priority));
+      CUDA_CHECK(cudaMalloc(&device.buffers[k], options.max_bytes));
+      CUDA_CHECK(cudaMemset(device.buffers[k], 0, options.max_bytes));
+      CUDA_CHECK(cudaEventCreate(&device.comm_done[k]));
+    }
+    size_t load_elements =
+        (size_t)device.sm_count * LOAD_BLOCKS_PER_SM * LOAD_THREADS;
+    CUDA_CHECK(cudaMalloc(&device.load_data, load_elements * sizeof(float)));
+    CUDA_CHECK(cudaMemset(device.load_data, 0, load_elements * sizeof(float)));
+    CUDA_CHECK(cudaEventCreate(&device.start));
+    CUDA_CHECK(cudaEventCreate(&device.load_done));
+  }
+
+  std::ofstream output(options.output);
+  if (!output.good()) {
+    std::cerr << "Unable to open " << options.output << std::endl;
+    return 1;
+  }
+  output << "# Libra channel table, " << num_devices << " GPUs, "
+         << devices[0].sm_count << " SMs per GPU\n"
+         << "# max_bytes concurrent_groups block_num thread_num\n";
+  std::ofstream cost_output;
+  if (!options.cost_output.empty()) {
+    cost_output.open(options.cost_output);
+    if (!cost_output.good()) {
+      std::cerr << "Unable to open " << options.cost_output << std::endl;
+      return 1;
+    }
+    cost_output << "# Libra allreduce costs, " << num_devices << " GPUs, "
+                << devices[0].sm_count << " SMs per GPU\n"
+                << "# bytes concurrent_groups block_num thread_num "
+                   "milliseconds\n";
+  }
+
+  for (auto concurrency : options.concurrency) {
+    for (int64_t bytes = options.min_bytes; bytes <= options.max_bytes;
+         bytes *= 4) {
+      // Scale the load with the message, so that it is long enough to
+      // overlap with the allreduce.
+      float load_ms = options.load_ms > 0
+                          ? options.load_ms
+                          : std::max(1.0f, bytes * concurrency / 1e6f / 10);
+      for (auto& device : devices) {
+        CalibrateLoad(device, load_ms);
+      }
+
+      float best_time = -1;
+      int best_blocks = 0;
+      int best_threads = 0;
+      for (auto block_num : options.blocks) {
+        for (auto thread_num : options.threads) {
+          float comm_time;
+          float time = Measure(devices, bytes, concurrency, block_num,
+                               thread_num, options.iterations, comm_time);
+          if (cost_output.is_open()) {
+            cost_output << bytes << " " << concurrency << " " << block_num
+                        << " " << thread_num << " " << comm_time << "\n";
+          }
+          if (best_time < 0 || time < best_time) {
+            best_time = time;
+            best_blocks = block_num;
+            best_threads = thread_num;
+          }
+        }
+      }
+      std::cout << "bytes=" << bytes << " concurrency=" << concurrency
+                << " load_ms=" << load_ms << " best block_num=" << best_blocks
+                << " thread_num=" << best_threads << " (" << best_time
+                << " ms)" << std::endl;
+      output << bytes << " " << concurrency << " " << best_blocks << " "
+             << best_threads << "\n";
+    }
+  }
+  output.close();
+  std::cout << "Wrote " << options.output << std::endl;
+  if (cost_output.is_open()) {
+    cost_output.close();
+    std::cout << "Wrote " << options.cost_output << std::endl;
+  }
+
+  for (auto& device : devices) {
+    CUDA_CHECK(cudaSetDevice(device.id));
+    for (int k = 0; k < max_concurrency; ++k) {
+      CUDA_CHECK(cudaFree(device.buffers[k]));
+      CUDA_CHECK(cudaStreamDestroy(device.comm_streams[k]));
+      CUDA_CHECK(cudaEventDestroy(device.comm_done[k]));
+      NCCL_CHECK(ncclCommDestroy(device.comms[k]));
+    }
+    CUDA_CHECK(cudaFree(device.load_data));
+    CUDA_CHECK(cudaStreamDestroy(device.load_stream));
+    CUDA_CHECK(cudaEventDestroy(device.start));
+    CUDA_CHECK(cudaEventDestroy(device.load_done));
+  }
+  return 0;
+}
@@ -32,15 +32,8 @@ public:
       return status;
     }
 
-    auto& mutex = cuda_events_mutex;
-    {
-      std::lock_guard<std::mutex> guard(mutex);
-      auto& queue = cuda_events[device];
-      if (!queue.empty()) {
-        *event = queue.front();
-        queue.pop();
-        return cudaSuccess;
-      }
+    if (device < GPU_EVENT_MAX_DEVICES && cuda_events[device].Pop(event)) {
+      return cudaSuccess;
     }
     return cudaEventCreateWithFlags(event, cudaEventDisableTiming);
   }
@@ -52,14 +45,10 @@ public:
       return status;
     }
 
-    auto& mutex = cuda_events_mutex;
-    {
-      std::lock_guard<std::mutex> guard(mutex);
-      auto& queue = cuda_events[device];
-      queue.push(event);
+    if (device < GPU_EVENT_MAX_DEVICES && cuda_events[device].Push(event)) {
+      return cudaSuccess;
     }
-
-    return cudaSuccess;
+    return cudaEventDestroy(event);
   }
 
   void ErrorCheck(std::string op_name, cudaError_t cuda_result) {
@@ -111,7 +100,8 @@ public:
 
   void WaitForEvents(std::queue<std::pair<std::string, cudaEvent_t>>& event_queue,
       const std::vector<TensorTableEntry>& entries, Timeline& timeline,
-      const std::function<void()>& error_check_callback) {
+      const std::function<void()>& error_check_callback,
+      const GPUEventWaiter::Policy& policy) {
     while (!event_queue.empty()) {
       std::string name;
       cudaEvent_t event;
@@ -123,6 +113,7 @@ public:
 
       // Check for async (networking) errors while waiting for the event to complete
       cudaError_t cuda_result;
+      GPUEventWaiter waiter(policy, error_check_callback);
       while (true) {
         cuda_result = cudaEventQuery(event);
         if (cuda_result == cudaSuccess) {
@@ -133,10 +124,7 @@ public:
           throw std::logic_error(std::string("cudaEventQuery failed: ") + cudaGetErrorString(cuda_result));
         }
 
-        if (error_check_callback) {
-          error_check_callback();
-        }
-        std::this_thread::yield();
+        waiter.Pause();
       }
 
       if (name != "") {
@@ -146,18 +134,80 @@ public:
     }
   }
 
-  void StreamCreate(cudaStream_t *stream) {
-    int greatest_priority;
+  void StreamCreate(cudaStream_t *stream, bool high_priority) {
+    int least_priority, greatest_priority;
     ErrorCheck("cudaDeviceGetStreamPriorityRange",
-        cudaDeviceGetStreamPriorityRange(NULL, &greatest_priority));
+        cudaDeviceGetStreamPriorityRange(&least_priority, &greatest_priority));
     ErrorCheck("cudaStreamCreateWithPriority",
-        cudaStreamCreateWithPriority(stream, cudaStreamNonBlocking, greatest_priority));
+        cudaStreamCreateWithPriority(stream, cudaStreamNonBlocking,
+                                      high_priority ? greatest_priority : least_priority));
   }
 
   void StreamSynchronize(cudaStream_t stream) {
     ErrorCheck("cudaStreamSynchronize", cudaStreamSynchronize(stream));
   }
 
+  void StreamWaitStream(cudaStream_t waiting_stream, cudaStream_t stream) {
+    // The wait captures the event as recorded now, so the event can go back
+    // to the pool right away.
+    cudaEvent_t event;
+    ErrorCheck("GetGpuEvent", GetGpuEvent(&event));
+    ErrorCheck("cudaEventRecord", cudaEventRecord(event, stream));
+    ErrorCheck("cudaStreamWaitEvent", cudaStreamWaitEvent(waiting_stream, event, 0));
+    ErrorCheck("ReleaseGpuEvent", ReleaseGpuEvent(event));
+  }
+
+  void StreamWaitEvent(cudaStream_t stream, cudaEvent_t event) {
+    ErrorCheck("cudaStreamWaitEvent", cudaStreamWaitEvent(stream, event, 0));
+  }
+
+  void EventSynchronize(cudaEvent_t event) {
+    ErrorCheck("cudaEventSynchronize", cudaEventSynchronize(event));
+  }
+
+#if CUDART_VERSION >= 11040
+  void StreamBeginCapture(cudaStream_t stream) {
+    // Other threads keep using CUDA while the background thread captures.
+    ErrorCheck("cudaStreamBeginCapture",
+               cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal));
+  }
+
+  std::shared_ptr<void> StreamEndCapture(cudaStream_t stream) {
+    cudaGraph_t graph = nullptr;
+    cudaGraphExec_t graph_exec = nullptr;
+    auto result = cudaStreamEndCapture(stream, &graph);
+    if (result == cudaSuccess) {
+      result = cudaGraphInstantiateWithFlags(&graph_exec, graph, 0);
+      cudaGraphDestroy(graph);
+    }
+    if (result != cudaSuccess) {
+      // Clear the error of the invalidated capture.
+      cudaGetLastError();
+      return nullptr;
+    }
+    return std::shared_ptr<void>(graph_exec, [](void* exec) {
+      cudaGraphExecDestroy(static_cast<cudaGraphExec_t>(exec));
+    });
+  }
+
+  void GraphLaunch(const std::shared_ptr<void>& graph, cudaStream_t stream) {
+    ErrorCheck("cudaGraphLaunch",
+               cudaGraphLaunch(static_cast<cudaGraphExec_t>(graph.get()), stream));
+  }
+#else
+  void StreamBeginCapture(cudaStream_t stream) {
+    throw std::logic_error("CUDA graphs need CUDA 11.4 or later.");
+  }
+
+  std::shared_ptr<void> StreamEndCapture(cudaStream_t stream) {
+    throw std::logic_error("CUDA graphs need CUDA 11.4 or later.");
+  }
+
+  void GraphLaunch(const std::shared_ptr<void>& graph, cudaStream_t stream) {
+    throw std::logic_error("CUDA graphs need CUDA 11.4 or later.");
+  }
+#endif
+
   int GetDevice() {
     int device;
     ErrorCheck("cudaGetDevice", cudaGetDevice(&device));
@@ -168,6 +218,32 @@ public:
     ErrorCheck("cudaSetDevice", cudaSetDevice(device));
   }
 
+  int GetDeviceCount() {
+    int count;
+    if (cudaGetDeviceCount(&count) != cudaSuccess) {
+      return 0;
+    }
+    return count;
+  }
+
+  // Returns an empty string if the bus id cannot be queried.
+  std::string GetPCIBusId(int device) {
+    char bus_id[32];
+    if (cudaDeviceGetPCIBusId(bus_id, sizeof(bus_id), device) != cudaSuccess) {
+      return "";
+    }
+    return bus_id;
+  }
+
+  int GetMultiProcessorCount(int device) {
+    int count;
+    if (cudaDeviceGetAttribute(&count, cudaDevAttrMultiProcessorCount,
+                               device) != cudaSuccess) {
+      return 0;
+    }
+    return count;
+  }
+
   void MemcpyAsyncD2D(void* dst, const void* src, size_t count, cudaStream_t stream) {
     ErrorCheck("cudaMemcpyAsync", cudaMemcpyAsync(dst, src, count, cudaMemcpyDeviceToDevice, stream));
   }
@@ -180,6 +256,72 @@ public:
     ErrorCheck("cudaMemcpyAsync", cudaMemcpyAsync(dst, src, count, cudaMemcpyDeviceToHost, stream));
   }
 
+  void HostAlloc(void** ptr, size_t size) {
+    ErrorCheck("cudaHostAlloc", cudaHostAlloc(ptr, size, cudaHostAllocDefault));
+  }
+
+  void HostFree(void* ptr) {
+    ErrorCheck("cudaFreeHost", cudaFreeHost(ptr));
+  }
+
+#if CUDART_VERSION >= 11020
+  void* PoolMalloc(int device, size_t size, uint64_t release_bytes) {
+    if (device >= GPU_EVENT_MAX_DEVICES) {
+      throw std::logic_error("Memory pools are limited to " +
+                             std::to_string(GPU_EVENT_MAX_DEVICES) + " devices.");
+    }
+    auto& pool = memory_pools[device];
+    {
+      std::lock_guard<std::mutex> guard(memory_pools_mutex);
+      if (pool.pool == nullptr) {
+        cudaMemPoolProps props = {};
+        props.allocType = cudaMemAllocationTypePinned;
+        props.location.type = cudaMemLocationTypeDevice;
+        props.location.id = device;
+        ErrorCheck("cudaMemPoolCreate", cudaMemPoolCreate(&pool.pool, &props));
+        ErrorCheck("cudaMemPoolSetAttribute",
+                   cudaMemPoolSetAttribute(pool.pool, cudaMemPoolAttrReleaseThreshold,
+                                           &release_bytes));
+        ErrorCheck("cudaStreamCreateWithFlags",
+                   cudaStreamCreateWithFlags(&pool.stream, cudaStreamNonBlocking));
+      }
+    }
+    void* ptr;
+    ErrorCheck("cudaMallocFromPoolAsync",
+               cudaMallocFromPoolAsync(&ptr, size, pool.pool, pool.stream));
+    // The memory is used by the streams of the operations right away. Memory
+    // coming back from the pool makes the wait short.
+    ErrorCheck("cudaStreamSynchronize", cudaStreamSynchronize(pool.stream));
+    return ptr;
+  }
+
+  // Only called once the operations using the memory completed.
+  void PoolFree(int device, void* ptr) {
+    ErrorCheck("cudaFreeAsync",
+               cudaFreeAsync(ptr, memory_pools[device].stream));
+  }
+
+  void PoolTrim() {
+    std::lock_guard<std::mutex> guard(memory_pools_mutex);
+    for (auto& pool : memory_pools) {
+      if (pool.pool != nullptr) {
+        // Memory freed on the stream only goes back to the pool once the
+        // stream reaches the free.
+        ErrorCheck("cudaStreamSynchronize", cudaStreamSynchronize(pool.stream));
+        ErrorCheck("cudaMemPoolTrimTo", cudaMemPoolTrimTo(pool.pool, 0));
+      }
+    }
+  }
+#else
+  void* PoolMalloc(int device, size_t size, uint64_t release_bytes) {
+    throw std::logic_error("CUDA memory pools need CUDA 11.2 or later.");
+  }
+
+  void PoolFree(int device, void* ptr) {}
+
+  void PoolTrim() {}
+#endif
+
   void ScaleBufferImpl(const void* fused_input_data, void* buffer_data, int64_t num_elements,
                        double scale_factor, DataType dtype, cudaStream_t stream) {
     ScaleBufferCudaImpl(fused_input_data, buffer_data, num_elements, scale_factor, dtype, stream);
@@ -190,8 +332,19 @@ public:
 
 private:
   // We reuse CUDA events as it appears that their creation carries non-zero cost.
-  std::unordered_map<int, std::queue<cudaEvent_t>> cuda_events;
-  std::mutex cuda_events_mutex;
+  std::array<GPUEventFreeList, GPU_EVENT_MAX_DEVICES> cuda_events;
+
+#if CUDART_VERSION >= 11020
+  // Stream-ordered pools of the devices, created on first use and kept for
+  // the lifetime of the process, with the stream their memory is allocated
+  // and freed on.
+  struct MemoryPool {
+    cudaMemPool_t pool = nullptr;
+    cudaStream_t stream = nullptr;
+  };
+  std::mutex memory_pools_mutex;
+  std::array<MemoryPool, GPU_EVENT_MAX_DEVICES> memory_pools;
+#endif
 };
 
 #include "gpu_context_impl.cc"
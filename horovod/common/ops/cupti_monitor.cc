@@ -0,0 +1,276 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "cupti_monitor.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if HAVE_CUPTI
+#include <cupti.h>
+#endif
+
+#include "../logging.h"
+
+namespace horovod {
+namespace common {
+
+#define CUPTI_BUFFER_SIZE (8 * 1024 * 1024)
+#define CUPTI_BUFFER_ALIGNMENT 8
+// Other kernels are kept this long after they ended, in nanoseconds.
+#define CUPTI_OVERLAP_WINDOW_NS 1000000000ULL
+// NCCL kernels whose launch was not seen after this many flushes are dropped.
+#define CUPTI_MAX_KERNEL_AGE 2
+// Launches whose kernel was never seen are forgotten after this many more.
+#define CUPTI_MAX_PENDING_LAUNCHES 65536
+
+#if HAVE_CUPTI
+// CUPTI callbacks take no user data, only one monitor runs at a time.
+static CuptiKernelMonitor* active_monitor = nullptr;
+
+static void CUPTIAPI BufferRequested(uint8_t** buffer, size_t* size,
+                                     size_t* max_num_records) {
+  *size = CUPTI_BUFFER_SIZE;
+  *buffer = (uint8_t*)aligned_alloc(CUPTI_BUFFER_ALIGNMENT, CUPTI_BUFFER_SIZE);
+  *max_num_records = 0;
+}
+
+static void CUPTIAPI BufferCompleted(CUcontext context, uint32_t stream_id,
+                                     uint8_t* buffer, size_t size,
+                                     size_t valid_size) {
+  auto monitor = active_monitor;
+  if (monitor != nullptr && valid_size > 0) {
+    monitor->ProcessBuffer(buffer, valid_size);
+  }
+  free(buffer);
+}
+
+static bool CuptiCheck(const char* name, CUptiResult result) {
+  if (result == CUPTI_SUCCESS) {
+    return true;
+  }
+  const char* reason;
+  cuptiGetResultString(result, &reason);
+  LOG(WARNING) << name << " failed: " << reason
+               << ", Libra kernel feedback is disabled.";
+  return false;
+}
+#endif
+
+bool CuptiKernelMonitor::Start(ChannelFeedback* feedback,
+                               HorovodMetrics* metrics) {
+  if (enabled_) {
+    return true;
+  }
+#if HAVE_CUPTI
+  feedback_ = feedback;
+  metrics_ = metrics;
+  active_monitor = this;
+  if (!CuptiCheck("cuptiActivityRegisterCallbacks",
+                  cuptiActivityRegisterCallbacks(BufferRequested,
+                                                 BufferCompleted)) ||
+      !CuptiCheck("cuptiActivityEnable",
+                  cuptiActivityEnable(CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL)) ||
+      !CuptiCheck("cuptiActivityEnable", cuptiActivityEnable(
+          CUPTI_ACTIVITY_KIND_EXTERNAL_CORRELATION))) {
+    active_monitor = nullptr;
+    return false;
+  }
+  last_flush_ = std::chrono::steady_clock::now();
+  enabled_ = true;
+  return true;
+#else
+  LOG(WARNING) << "HOROVOD_LIBRA_KERNEL_FEEDBACK is set, but Horovod was "
+                  "built without CUPTI, the Libra allocation stays open loop.";
+  return false;
+#endif
+}
+
+void CuptiKernelMonitor::Stop() {
+  if (!enabled_) {
+    return;
+  }
+  enabled_ = false;
+#if HAVE_CUPTI
+  cuptiActivityDisable(CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL);
+  cuptiActivityDisable(CUPTI_ACTIVITY_KIND_EXTERNAL_CORRELATION);
+  cuptiActivityFlushAll(0);
+  active_monitor = nullptr;
+  std::lock_guard<std::mutex> guard(records_mutex_);
+  external_ids_.clear();
+  nccl_kernels_.clear();
+  other_kernels_.clear();
+  std::lock_guard<std::mutex> launch_guard(launch_mutex_);
+  launches_.clear();
+#endif
+}
+
+void CuptiKernelMonitor::LaunchStart(const std::string& group_name,
+                                     int block_num) {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_CUPTI
+  uint64_t external_id;
+  {
+    std::lock_guard<std::mutex> guard(launch_mutex_);
+    external_id = next_external_id_++;
+    launches_[external_id] = Launch{group_name, block_num};
+    launches_.erase(external_id - CUPTI_MAX_PENDING_LAUNCHES);
+  }
+  cuptiActivityPushExternalCorrelationId(
+      CUPTI_EXTERNAL_CORRELATION_KIND_CUSTOM0, external_id);
+#endif
+}
+
+void CuptiKernelMonitor::LaunchEnd() {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_CUPTI
+  uint64_t external_id;
+  cuptiActivityPopExternalCorrelationId(
+      CUPTI_EXTERNAL_CORRELATION_KIND_CUSTOM0, &external_id);
+#endif
+}
+
+void CuptiKernelMonitor::MaybeFlush() {
+  if (!enabled_) {
+    return;
+  }
+#if HAVE_CUPTI
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_flush_ < std::chrono::seconds(1)) {
+    return;
+  }
+  last_flush_ = now;
+  // Completed buffers are handed to BufferCompleted on this thread.
+  cuptiActivityFlushAll(0);
+  std::lock_guard<std::mutex> guard(records_mutex_);
+  ResolveKernels();
+#endif
+}
+
+void CuptiKernelMonitor::ProcessBuffer(uint8_t* buffer, size_t valid_size) {
+#if HAVE_CUPTI
+  std::lock_guard<std::mutex> guard(records_mutex_);
+  CUpti_Activity* record = nullptr;
+  while (cuptiActivityGetNextRecord(buffer, valid_size, &record) ==
+         CUPTI_SUCCESS) {
+    if (record->kind == CUPTI_ACTIVITY_KIND_EXTERNAL_CORRELATION) {
+      auto correlation = (CUpti_ActivityExternalCorrelation*)record;
+      if (correlation->externalKind ==
+          CUPTI_EXTERNAL_CORRELATION_KIND_CUSTOM0) {
+        external_ids_[correlation->correlationId] = correlation->externalId;
+      }
+    } else if (record->kind == CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL ||
+               record->kind == CUPTI_ACTIVITY_KIND_KERNEL) {
+      // The fields read here have the same layout in every kernel record
+      // version.
+      auto activity = (CUpti_ActivityKernel4*)record;
+      Kernel kernel;
+      kernel.start = activity->start;
+      kernel.end = activity->end;
+      kernel.correlation_id = activity->correlationId;
+      kernel.launched_blocks =
+          activity->gridX * activity->gridY * activity->gridZ;
+      kernel.age = 0;
+      if (activity->name != nullptr &&
+          std::strstr(activity->name, "nccl") != nullptr) {
+        nccl_kernels_.push_back(kernel);
+      } else {
+        other_kernels_.push_back(kernel);
+      }
+    }
+  }
+#endif
+}
+
+void CuptiKernelMonitor::ResolveKernels() {
+  if (nccl_kernels_.empty()) {
+    return;
+  }
+  std::sort(other_kernels_.begin(), other_kernels_.end(),
+            [](const Kernel& a, const Kernel& b) { return a.end < b.end; });
+
+  std::vector<Kernel> pending;
+  for (auto& kernel : nccl_kernels_) {
+    auto external = external_ids_.find(kernel.correlation_id);
+    Launch launch;
+    bool found = false;
+    if (external != external_ids_.end()) {
+      std::lock_guard<std::mutex> guard(launch_mutex_);
+      auto it = launches_.find(external->second);
+      if (it != launches_.end()) {
+        launch = std::move(it->second);
+        launches_.erase(it);
+        found = true;
+      }
+      external_ids_.erase(external);
+    }
+    if (!found) {
+      // The record of the launch may come with a later buffer.
+      if (external == external_ids_.end() &&
+          ++kernel.age <= CUPTI_MAX_KERNEL_AGE) {
+        pending.push_back(kernel);
+      }
+      continue;
+    }
+
+    // Time of the kernel covered by the union of the other kernels.
+    uint64_t covered = 0;
+    uint64_t covered_until = kernel.start;
+    std::vector<std::pair<uint64_t, uint64_t>> intervals;
+    for (auto it = std::lower_bound(
+             other_kernels_.begin(), other_kernels_.end(), kernel.start,
+             [](const Kernel& k, uint64_t start) { return k.end < start; });
+         it != other_kernels_.end(); ++it) {
+      if (it->start < kernel.end) {
+        intervals.emplace_back(std::max(it->start, kernel.start),
+                               std::min(it->end, kernel.end));
+      }
+    }
+    std::sort(intervals.begin(), intervals.end());
+    for (auto& interval : intervals) {
+      uint64_t begin = std::max(interval.first, covered_until);
+      if (interval.second > begin) {
+        covered += interval.second - begin;
+        covered_until = interval.second;
+      }
+    }
+
+    double seconds = (kernel.end - kernel.start) * 1e-9;
+    double overlap = kernel.end > kernel.start
+                         ? (double)covered / (kernel.end - kernel.start)
+                         : 0;
+    metrics_->nccl_kernel_seconds.Observe(seconds);
+    metrics_->nccl_kernel_overlap.Observe(overlap);
+    feedback_->Record(launch.group_name, launch.block_num,
+                      kernel.launched_blocks, seconds, overlap);
+  }
+  nccl_kernels_ = std::move(pending);
+
+  if (!other_kernels_.empty()) {
+    uint64_t newest = other_kernels_.back().end;
+    while (!other_kernels_.empty() &&
+           other_kernels_.front().end + CUPTI_OVERLAP_WINDOW_NS < newest) {
+      other_kernels_.pop_front();
+    }
+  }
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,103 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_CUPTI_MONITOR_H
+#define HOROVOD_CUPTI_MONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../channel_allocator.h"
+#include "../metrics.h"
+
+namespace horovod {
+namespace common {
+
+// Subscribes to the CUPTI kernel activity of the process, and attributes the
+// NCCL kernels to the fusion groups that launched them through external
+// correlation ids. For every NCCL kernel it measures the duration, the
+// blocks it was actually launched with and the fraction of its duration that
+// ran next to other kernels of the device, and feeds them to the
+// ChannelFeedback of the coordinator. Set HOROVOD_LIBRA_KERNEL_FEEDBACK=1 to
+// enable it; it does nothing unless Horovod was built with CUPTI.
+class CuptiKernelMonitor {
+public:
+  CuptiKernelMonitor() = default;
+  CuptiKernelMonitor(const CuptiKernelMonitor&) = delete;
+
+  // Returns false if CUPTI is not available.
+  bool Start(ChannelFeedback* feedback, HorovodMetrics* metrics);
+  void Stop();
+  bool IsEnabled() const { return enabled_; }
+
+  // Tags the kernels launched by the calling thread until LaunchEnd with the
+  // group, whose first tensor is group_name.
+  void LaunchStart(const std::string& group_name, int block_num);
+  void LaunchEnd();
+
+  // Hands the completed activity records to the monitor, at most once per
+  // second. Called by the background thread.
+  void MaybeFlush();
+
+  // Called by CUPTI with a buffer of completed records.
+  void ProcessBuffer(uint8_t* buffer, size_t valid_size);
+
+private:
+  struct Launch {
+    std::string group_name;
+    int block_num;
+  };
+  struct Kernel {
+    uint64_t start;
+    uint64_t end;
+    uint32_t correlation_id;
+    int launched_blocks;
+    // Flushes the kernel waited for the record of its launch.
+    int age;
+  };
+
+  // Matches the NCCL kernels with their launches and the other kernels
+  // around them.
+  void ResolveKernels();
+
+  std::atomic_bool enabled_{false};
+  ChannelFeedback* feedback_ = nullptr;
+  HorovodMetrics* metrics_ = nullptr;
+  std::chrono::steady_clock::time_point last_flush_;
+
+  // Launches by external id, set by LaunchStart.
+  std::mutex launch_mutex_;
+  uint64_t next_external_id_ = 1;
+  std::unordered_map<uint64_t, Launch> launches_;
+
+  // Guards the records below, filled by the CUPTI buffer callbacks.
+  std::mutex records_mutex_;
+  std::unordered_map<uint32_t, uint64_t> external_ids_;
+  std::vector<Kernel> nccl_kernels_;
+  // Kernels that are not NCCL kernels, by end time, kept as long as they can
+  // overlap with an NCCL kernel not resolved yet.
+  std::deque<Kernel> other_kernels_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_CUPTI_MONITOR_H
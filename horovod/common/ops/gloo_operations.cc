@@ -15,6 +15,8 @@
 
 #include "gloo_operations.h"
 
+#include <algorithm>
+
 #include "gloo/allgather.h"
 #include "gloo/allgatherv.h"
 #include "gloo/allreduce.h"
@@ -25,10 +27,39 @@
 
 #include "../common.h"
 #include "../global_state.h"
+#include "../half.h"
 
 namespace horovod {
 namespace common {
 
+// Buffers are striped over the Gloo lanes in stripes of at least this size.
+#define GLOO_LANE_MIN_STRIPE_BYTES (1024 * 1024)
+
+namespace {
+
+template <typename T>
+void GlooSum(void* c, const void* a, const void* b, size_t n) {
+  ::gloo::sum<T>(c, a, b, n);
+}
+
+template <>
+void GlooSum<BFloat16>(void* c, const void* a, const void* b, size_t n) {
+  BFloat16Sum((const unsigned short*)a, (const unsigned short*)b,
+              (unsigned short*)c, (int64_t)n);
+}
+
+GlooAllreduceAlgorithm
+SelectAllreduceAlgorithm(const ParameterManager& param_manager,
+                         int64_t num_bytes) {
+  return num_bytes <= param_manager.GlooBcubeThresholdBytes()
+             ? GlooAllreduceAlgorithm::BCUBE
+             : GlooAllreduceAlgorithm::RING;
+}
+
+} // namespace
+
+namespace {
+
 IGlooAlgorithms* GetAlgorithmsForType(DataType dtype,
                                       GlooContext* gloo_context) {
   switch (dtype) {
@@ -52,25 +83,62 @@ IGlooAlgorithms* GetAlgorithmsForType(DataType dtype,
     return new GlooAlgorithms<double>(gloo_context);
   case HOROVOD_BOOL:
     return new GlooAlgorithms<bool>(gloo_context);
+  case HOROVOD_BFLOAT16:
+    return new GlooAlgorithms<BFloat16>(gloo_context);
   default:
     throw std::logic_error("Type " + DataType_Name(dtype) +
                            " is not supported in Gloo mode.");
   }
 }
 
+} // namespace
+
+GlooAlgorithmsTable::GlooAlgorithmsTable(GlooContext* gloo_context) {
+  for (int dtype = 0; dtype < (int)algorithms_.size(); ++dtype) {
+    algorithms_[dtype].reset(
+        GetAlgorithmsForType((DataType)dtype, gloo_context));
+  }
+}
+
+IGlooAlgorithms& GlooAlgorithmsTable::Get(DataType dtype) const {
+  if (dtype < 0 || dtype >= (int)algorithms_.size()) {
+    throw std::logic_error("Type " + DataType_Name(dtype) +
+                           " is not supported in Gloo mode.");
+  }
+  return *algorithms_[dtype];
+}
+
 template <typename T>
 GlooAlgorithms<T>::GlooAlgorithms(GlooContext* gloo_context)
     : gloo_context_(gloo_context) {}
 
 template <typename T>
-void GlooAlgorithms<T>::Allreduce(void* buffer_data, int num_elements) {
-  gloo::AllreduceOptions opts(gloo_context_->ctx);
-  opts.setOutput<T>(static_cast<T*>(buffer_data), (size_t) num_elements);
-
-  void (*func)(void*, const void*, const void*, size_t) = &::gloo::sum<T>;
-  opts.setReduceFunction(gloo::AllreduceOptions::Func(func));
-
-  gloo::allreduce(opts);
+void GlooAlgorithms<T>::Allreduce(void* buffer_data, int num_elements,
+                                  GlooAllreduceAlgorithm algorithm) {
+  // Every rank stripes the buffer the same way, as the sizes and the number of
+  // lanes are the same on all of them.
+  int64_t num_stripes =
+      std::min((int64_t)gloo_context_->NumLanes(),
+               (int64_t)num_elements * (int64_t)sizeof(T) /
+                   GLOO_LANE_MIN_STRIPE_BYTES);
+  num_stripes = std::max(num_stripes, (int64_t)1);
+  int64_t per_stripe = (num_elements + num_stripes - 1) / num_stripes;
+
+  gloo_context_->RunOnLanes((int)num_stripes, [&](int lane) {
+    int64_t begin = std::min(lane * per_stripe, (int64_t)num_elements);
+    int64_t count = std::min(per_stripe, (int64_t)num_elements - begin);
+
+    gloo::AllreduceOptions opts(gloo_context_->LaneContext(lane));
+    opts.setOutput<T>(static_cast<T*>(buffer_data) + begin, (size_t)count);
+    opts.setAlgorithm(algorithm == GlooAllreduceAlgorithm::BCUBE
+                          ? gloo::AllreduceOptions::Algorithm::BCUBE
+                          : gloo::AllreduceOptions::Algorithm::RING);
+
+    void (*func)(void*, const void*, const void*, size_t) = &GlooSum<T>;
+    opts.setReduceFunction(gloo::AllreduceOptions::Func(func));
+
+    gloo::allreduce(opts);
+  });
 }
 
 template <typename T>
@@ -114,7 +182,8 @@ template <typename T> int GlooAlgorithms<T>::ElementSize() const {
 
 GlooAllreduce::GlooAllreduce(GlooContext* gloo_context,
                              HorovodGlobalState* global_state)
-    : AllreduceOp(global_state), gloo_context_(gloo_context) {}
+    : AllreduceOp(global_state), gloo_context_(gloo_context),
+      gloo_algorithms_(gloo_context) {}
 
 Status GlooAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
@@ -145,9 +214,12 @@ Status GlooAllreduce::Execute(std::vector<TensorTableEntry>& entries,
 
   // Do allreduce.
   timeline.ActivityStartAll(entries, GLOO_ALLREDUCE);
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_));
-  gloo_algos->Allreduce(buffer_data, num_elements);
+  auto& gloo_algos = gloo_algorithms_.Get(first_entry.tensor->dtype());
+  gloo_algos.Allreduce(
+      buffer_data, num_elements,
+      SelectAllreduceAlgorithm(global_state_->parameter_manager,
+                               (int64_t)num_elements *
+                                   gloo_algos.ElementSize()));
   timeline.ActivityEndAll(entries);
 
   if (response.postscale_factor() != 1.0) {
@@ -173,7 +245,8 @@ bool GlooAllreduce::Enabled(const ParameterManager& param_manager,
 
 GlooAllgather::GlooAllgather(GlooContext* gloo_context,
                              HorovodGlobalState* global_state)
-    : AllgatherOp(global_state), gloo_context_(gloo_context) {}
+    : AllgatherOp(global_state), gloo_context_(gloo_context),
+      gloo_algorithms_(gloo_context) {}
 
 bool GlooAllgather::Enabled(const ParameterManager& param_manager,
                             const std::vector<TensorTableEntry>& entries,
@@ -185,21 +258,14 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t*[entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t*[entries.size()];
-
+  // Sizes of subcomponents of each entry from all ranks, and offset of each
+  // subcomponent of every entry in the final buffer after allgatherv
   int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
 
   auto& first_entry = entries[0];
 
@@ -207,15 +273,6 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
   Status status =
       AllocateOutput(entries, response, entry_component_sizes, recvcounts);
   if (!status.ok()) {
-    /* Cleanup */
-    for (size_t ec = 0; ec < entries.size(); ++ec) {
-      delete[] entry_component_sizes[ec];
-      delete[] entry_component_offsets[ec];
-    }   
-    delete[] entry_component_sizes;
-    delete[] entry_component_offsets;
-    delete[] recvcounts;
-    delete[] displcmnts;
     return status;
   }
   timeline.ActivityEndAll(entries);
@@ -224,9 +281,8 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
   SetEntryComponentOffsets(entries, entry_component_sizes, recvcounts,
                            entry_component_offsets);
 
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(first_entry.tensor->dtype(), gloo_context_));
-  int element_size = gloo_algos->ElementSize();
+  auto& gloo_algos = gloo_algorithms_.Get(first_entry.tensor->dtype());
+  int element_size = gloo_algos.ElementSize();
 
   void* sendbuf = nullptr;
   void* buffer_data;
@@ -248,7 +304,7 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
 
   // call gloo allgather api
   global_state_->timeline.ActivityStartAll(entries, GLOO_ALLGATHER);
-  gloo_algos->Allgather(sendbuf, buffer_data, recvcounts, displcmnts);
+  gloo_algos.Allgather(sendbuf, buffer_data, recvcounts, displcmnts);
   global_state_->timeline.ActivityEndAll(entries);
 
   // if multiple tensors are gathered, restore the sequence from output
@@ -259,45 +315,48 @@ Status GlooAllgather::Execute(std::vector<TensorTableEntry>& entries,
     timeline.ActivityEndAll(entries);
   }
 
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
-
   return Status::OK();
 }
 
 GlooBroadcast::GlooBroadcast(GlooContext* gloo_context,
                              HorovodGlobalState* global_state)
-    : BroadcastOp(global_state), gloo_context_(gloo_context) {}
+    : BroadcastOp(global_state), gloo_context_(gloo_context),
+      gloo_algorithms_(gloo_context) {}
 
 Status GlooBroadcast::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& e = entries[0];
 
   // On root rank, MPI_Bcast sends data, on other ranks it receives data.
   // for gloo broadcast, only output needs to be set if inplace
 
   void* data_ptr;
-  if (global_state_->controller->GetRank() == e.root_rank) {
+  size_t data_len;
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, data_len);
+    global_state_->timeline.ActivityEndAll(entries);
+  } else if (global_state_->controller->GetRank() == e.root_rank) {
     data_ptr = (void*)e.tensor->data();
+    data_len = (size_t)e.tensor->size();
   } else {
     data_ptr = (void*)e.output->data();
+    data_len = (size_t)e.tensor->size();
   }
 
   global_state_->timeline.ActivityStartAll(entries, GLOO_BCAST);
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(e.tensor->dtype(), gloo_context_));
-  gloo_algos->Broadcast(data_ptr, (int)e.tensor->shape().num_elements(),
+  auto& gloo_algos = gloo_algorithms_.Get(e.tensor->dtype());
+  gloo_algos.Broadcast(data_ptr,
+                        (int)(data_len / DataType_Size(e.tensor->dtype())),
                         e.root_rank);
   global_state_->timeline.ActivityEndAll(entries);
 
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(data_ptr, entries);
+    global_state_->timeline.ActivityEndAll(entries);
+  }
+
   return Status::OK();
 }
 
@@ -309,25 +368,24 @@ bool GlooBroadcast::Enabled(const ParameterManager& param_manager,
 
 GlooAlltoall::GlooAlltoall(GlooContext* gloo_context,
                            HorovodGlobalState* global_state)
-    : AlltoallOp(global_state), gloo_context_(gloo_context) {}
+    : AlltoallOp(global_state), gloo_context_(gloo_context),
+      gloo_algorithms_(gloo_context) {}
 
 Status GlooAlltoall::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
-
-  std::vector<int64_t> sdispls, rdispls;
-  std::vector<int64_t> sendcounts, recvcounts;
-  Status status = PrepareOutputAndParams(e, sdispls, rdispls, sendcounts, recvcounts);
+  std::vector<AlltoallParams<int64_t>> params;
+  Status status = PrepareOutputAndParams(entries, params);
   if (!status.ok()) {
     return status;
   }
 
   global_state_->timeline.ActivityStartAll(entries, MPI_ALLTOALL);
 
-  std::unique_ptr<IGlooAlgorithms> gloo_algos(
-      GetAlgorithmsForType(e.tensor->dtype(), gloo_context_));
-  gloo_algos->Alltoall((void*)e.tensor->data(), (void*)e.output->data(),
-                       sendcounts, recvcounts);
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    auto& e = entries[ec];
+    auto& gloo_algos = gloo_algorithms_.Get(e.tensor->dtype());
+    gloo_algos.Alltoall((void*)e.tensor->data(), (void*)e.output->data(),
+                         params[ec].sendcounts, params[ec].recvcounts);
+  }
 
   global_state_->timeline.ActivityEndAll(entries);
 
@@ -340,5 +398,67 @@ bool GlooAlltoall::Enabled(const ParameterManager& param_manager,
   return true;
 }
 
+GlooReducescatter::GlooReducescatter(GlooContext* gloo_context,
+                                     HorovodGlobalState* global_state)
+    : ReducescatterOp(global_state), gloo_context_(gloo_context),
+      gloo_algorithms_(gloo_context) {}
+
+Status GlooReducescatter::Execute(std::vector<TensorTableEntry>& entries,
+                                  const Response& response) {
+  auto& first_entry = entries[0];
+  auto& timeline = global_state_->timeline;
+
+  std::vector<int64_t> recvcounts;
+  timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, recvcounts);
+  if (!status.ok()) {
+    return status;
+  }
+  timeline.ActivityEndAll(entries);
+
+  // The reduction is done in place, so the input is copied first: into the
+  // fusion buffer for fused entries, and into a scratch buffer otherwise.
+  void* buffer_data;
+  size_t buffer_len;
+  std::vector<uint8_t> scratch;
+  if (entries.size() > 1) {
+    timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    timeline.ActivityEndAll(entries);
+  } else {
+    buffer_len = (size_t)first_entry.tensor->size();
+    scratch.resize(buffer_len);
+    std::memcpy(scratch.data(), first_entry.tensor->data(), buffer_len);
+    buffer_data = scratch.data();
+  }
+
+  // Gloo has no reduce-scatter with uneven parts, so the whole buffer is
+  // reduced and each rank keeps its own part.
+  timeline.ActivityStartAll(entries, GLOO_REDUCESCATTER);
+  auto& gloo_algos = gloo_algorithms_.Get(first_entry.tensor->dtype());
+  int element_size = gloo_algos.ElementSize();
+  gloo_algos.Allreduce(
+      buffer_data, (int)(buffer_len / element_size),
+      SelectAllreduceAlgorithm(global_state_->parameter_manager,
+                               (int64_t)buffer_len));
+  timeline.ActivityEndAll(entries);
+
+  int64_t offset = 0;
+  for (int rc = 0; rc < global_state_->controller->GetRank(); ++rc) {
+    offset += recvcounts[rc] * element_size;
+  }
+  timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+  MemcpyOutFusionBuffer((uint8_t*)buffer_data + offset, entries);
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+bool GlooReducescatter::Enabled(const ParameterManager& param_manager,
+                                const std::vector<TensorTableEntry>& entries,
+                                const Response& response) const {
+  return true;
+}
+
 } // namespace common
 } // namespace horovod
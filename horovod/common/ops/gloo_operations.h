@@ -17,6 +17,8 @@
 #define HOROVOD_GLOO_OPERATIONS_H
 
 #include <stdint.h>
+#include <array>
+#include <memory>
 #include <vector>
 
 #include "collective_operations.h"
@@ -25,9 +27,15 @@
 namespace horovod {
 namespace common {
 
+// Ring suits bandwidth bound allreduces. Bcube is recursive halving and
+// doubling when the number of ranks is a power of two, and takes fewer steps
+// for latency bound ones.
+enum class GlooAllreduceAlgorithm { RING, BCUBE };
+
 class IGlooAlgorithms {
 public:
-  virtual void Allreduce(void* buffer_data, int num_elements) = 0;
+  virtual void Allreduce(void* buffer_data, int num_elements,
+                         GlooAllreduceAlgorithm algorithm) = 0;
 
   virtual void Allgather(void* buffer_data, void* buffer_out, int* recvcounts,
                          int* displcmnts) = 0;
@@ -48,7 +56,8 @@ public:
 
   ~GlooAlgorithms() = default;
 
-  void Allreduce(void* buffer_data, int num_elements) override;
+  void Allreduce(void* buffer_data, int num_elements,
+                 GlooAllreduceAlgorithm algorithm) override;
 
   void Allgather(void* buffer_data, void* buffer_out, int* recvcounts,
                  int* displcmnts) override;
@@ -65,6 +74,20 @@ private:
   GlooContext* gloo_context_;
 };
 
+// The algorithms of every data type, created once when an op is created
+// instead of on the heap for every collective it runs.
+class GlooAlgorithmsTable {
+public:
+  GlooAlgorithmsTable(GlooContext* gloo_context);
+
+  // Throws for data types not supported in Gloo mode.
+  IGlooAlgorithms& Get(DataType dtype) const;
+
+private:
+  std::array<std::unique_ptr<IGlooAlgorithms>, HOROVOD_BFLOAT16 + 1>
+      algorithms_;
+};
+
 class GlooAllreduce : public AllreduceOp {
 public:
   GlooAllreduce(GlooContext* gloo_context, HorovodGlobalState* global_state);
@@ -80,6 +103,7 @@ public:
 
 protected:
   GlooContext* gloo_context_;
+  GlooAlgorithmsTable gloo_algorithms_;
 };
 
 class GlooAllgather : public AllgatherOp {
@@ -95,6 +119,7 @@ public:
 
 protected:
   GlooContext* gloo_context_;
+  GlooAlgorithmsTable gloo_algorithms_;
 };
 
 class GlooBroadcast : public BroadcastOp {
@@ -110,6 +135,7 @@ public:
 
 protected:
   GlooContext* gloo_context_;
+  GlooAlgorithmsTable gloo_algorithms_;
 };
 
 class GlooAlltoall : public AlltoallOp {
@@ -124,6 +150,24 @@ public:
 
 protected:
   GlooContext* gloo_context_;
+  GlooAlgorithmsTable gloo_algorithms_;
+};
+
+class GlooReducescatter : public ReducescatterOp {
+public:
+  GlooReducescatter(GlooContext* gloo_context,
+                    HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  GlooContext* gloo_context_;
+  GlooAlgorithmsTable gloo_algorithms_;
 };
 
 } // namespace common
@@ -1,8 +1,11 @@
 GPUContext::GPUContext() : pimpl{new impl} {}
 GPUContext::~GPUContext() = default;
 
-void GPUContext::Finalize() {
+void GPUContext::Finalize(bool keep_pinned_buffers) {
   finalizer_thread_pool.reset();
+  if (!keep_pinned_buffers) {
+    pinned_host_buffers.Finalize();
+  }
 }
 
 void GPUContext::ErrorCheck(std::string op_name, gpuError_t gpu_result) {
@@ -19,17 +22,42 @@ void GPUContext::RecordEvent(std::queue<std::pair<std::string, gpuEvent_t>>& eve
 // }
 
 void GPUContext::WaitForEvents(std::queue<std::pair<std::string, gpuEvent_t>>& event_queue, const std::vector<TensorTableEntry>& entries, Timeline& timeline, const std::function<void()>& error_check_callback) {
-  pimpl->WaitForEvents(event_queue, entries, timeline, error_check_callback);
+  pimpl->WaitForEvents(event_queue, entries, timeline, error_check_callback,
+                       event_wait_policy);
 }
 
-void GPUContext::StreamCreate(gpuStream_t *stream) {
-  pimpl->StreamCreate(stream);
+void GPUContext::StreamCreate(gpuStream_t *stream, bool high_priority) {
+  pimpl->StreamCreate(stream, high_priority);
 }
 
 void GPUContext::StreamSynchronize(gpuStream_t stream) {
   pimpl->StreamSynchronize(stream);
 }
 
+void GPUContext::StreamWaitStream(gpuStream_t waiting_stream, gpuStream_t stream) {
+  pimpl->StreamWaitStream(waiting_stream, stream);
+}
+
+void GPUContext::StreamWaitEvent(gpuStream_t stream, gpuEvent_t event) {
+  pimpl->StreamWaitEvent(stream, event);
+}
+
+void GPUContext::EventSynchronize(gpuEvent_t event) {
+  pimpl->EventSynchronize(event);
+}
+
+void GPUContext::StreamBeginCapture(gpuStream_t stream) {
+  pimpl->StreamBeginCapture(stream);
+}
+
+std::shared_ptr<void> GPUContext::StreamEndCapture(gpuStream_t stream) {
+  return pimpl->StreamEndCapture(stream);
+}
+
+void GPUContext::GraphLaunch(const std::shared_ptr<void>& graph, gpuStream_t stream) {
+  pimpl->GraphLaunch(graph, stream);
+}
+
 int GPUContext::GetDevice() {
   return pimpl->GetDevice();
 }
@@ -38,6 +66,18 @@ void GPUContext::SetDevice(int device) {
   pimpl->SetDevice(device);
 }
 
+int GPUContext::GetMultiProcessorCount(int device) {
+  return pimpl->GetMultiProcessorCount(device);
+}
+
+int GPUContext::GetLocalNumaNode(int local_rank) {
+  int count = pimpl->GetDeviceCount();
+  if (count <= 0) {
+    return -1;
+  }
+  return pci_numa_node(pimpl->GetPCIBusId(local_rank % count));
+}
+
 void GPUContext::MemcpyAsyncD2D(void* dst, const void* src, size_t count, gpuStream_t stream) {
   pimpl->MemcpyAsyncD2D(dst, src, count, stream);
 }
@@ -50,6 +90,48 @@ void GPUContext::MemcpyAsyncD2H(void* dst, const void* src, size_t count, gpuStr
   pimpl->MemcpyAsyncD2H(dst, src, count, stream);
 }
 
+void GPUContext::HostAlloc(void** ptr, size_t size) {
+  pimpl->HostAlloc(ptr, size);
+}
+
+void GPUContext::HostFree(void* ptr) {
+  pimpl->HostFree(ptr);
+}
+
+namespace {
+
+class PooledGPUBuffer : public PersistentBuffer {
+public:
+  explicit PooledGPUBuffer(std::shared_ptr<void> data) : data_(std::move(data)) {}
+
+  const void* AccessData(std::shared_ptr<OpContext> context) const override {
+    return data_.get();
+  }
+
+private:
+  std::shared_ptr<void> data_;
+};
+
+} // namespace
+
+std::shared_ptr<PersistentBuffer> GPUContext::AllocatePooled(int device, int64_t size) {
+  int current_device = pimpl->GetDevice();
+  pimpl->SetDevice(device);
+  void* ptr;
+  try {
+    ptr = pimpl->PoolMalloc(device, (size_t)size, memory_pool_release_bytes);
+  } catch (const std::exception&) {
+    pimpl->SetDevice(current_device);
+    throw;
+  }
+  pimpl->SetDevice(current_device);
+  auto* impl = pimpl.get();
+  return std::make_shared<PooledGPUBuffer>(std::shared_ptr<void>(
+      ptr, [impl, device](void* data) { impl->PoolFree(device, data); }));
+}
+
+void GPUContext::TrimMemoryPools() { pimpl->PoolTrim(); }
+
 void GPUContext::ScaleBufferImpl(const void* fused_input_data, void* buffer_data, int64_t num_elements,
                                  double scale_factor, DataType dtype, gpuStream_t stream) {
   pimpl->ScaleBufferImpl(fused_input_data, buffer_data, num_elements, scale_factor, dtype, stream);
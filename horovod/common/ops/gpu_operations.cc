@@ -15,12 +15,197 @@
 // =============================================================================
 
 #include "gpu_operations.h"
+#include "../logging.h"
 
+#if HAVE_CUDA
+#include "cuda/cuda_kernels.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
 #include <thread>
 
 namespace horovod {
 namespace common {
 
+#if HAVE_CUDA
+namespace {
+
+// Gathers the small device to device copies of a fusion buffer into launches
+// of the batched copy kernel. Large copies go to cudaMemcpyAsync right away,
+// unless the copied elements are scaled or cast to out_dtype on the way.
+class BatchedD2DMemcpy {
+public:
+  BatchedD2DMemcpy(GPUContext* gpu_context, gpuStream_t stream,
+                   double scale_factor = 1.0, DataType dtype = HOROVOD_UINT8)
+      : BatchedD2DMemcpy(gpu_context, stream, scale_factor, dtype, dtype) {}
+
+  BatchedD2DMemcpy(GPUContext* gpu_context, gpuStream_t stream,
+                   double scale_factor, DataType dtype, DataType out_dtype)
+      : gpu_context_(gpu_context), stream_(stream), scale_factor_(scale_factor),
+        dtype_(dtype), out_dtype_(out_dtype) {}
+
+  // Copies size bytes of in, which take another size at out when cast.
+  void Add(void* out, const void* in, size_t size) {
+    bool cast = out_dtype_ != dtype_;
+    if (scale_factor_ == 1.0 && !cast && size >= BATCHED_D2D_MAX_BYTES) {
+      gpu_context_->MemcpyAsyncD2D(out, in, size, stream_);
+      return;
+    }
+    params_.out[num_copies_] = out;
+    params_.in[num_copies_] = const_cast<void*>(in);
+    params_.sizes[num_copies_] = cast ? size / DataType_Size(dtype_) : size;
+    if (++num_copies_ == BATCHED_D2D_CAPACITY) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (num_copies_ > 0) {
+      if (out_dtype_ != dtype_) {
+        BatchedCastD2DMemcpyCudaImpl(params_, num_copies_, scale_factor_, dtype_, out_dtype_,
+                                     stream_);
+      } else if (scale_factor_ == 1.0) {
+        BatchedD2DMemcpyCudaImpl(params_, num_copies_, stream_);
+      } else {
+        BatchedScaledD2DMemcpyCudaImpl(params_, num_copies_, scale_factor_, dtype_, stream_);
+      }
+      gpu_context_->ErrorCheck("BatchedD2DMemcpyCudaImpl", cudaGetLastError());
+      num_copies_ = 0;
+    }
+  }
+
+private:
+  GPUContext* gpu_context_;
+  gpuStream_t stream_;
+  double scale_factor_;
+  DataType dtype_;
+  DataType out_dtype_;
+  BatchedD2DParams params_;
+  int num_copies_ = 0;
+};
+
+// Gathers the copies out of a fusion buffer into launches of the kernel that
+// adds up the squared norms of the copied elements, and looks for overflows,
+// on the way.
+class NormAccumulatingD2DMemcpy {
+public:
+  NormAccumulatingD2DMemcpy(GPUContext* gpu_context, gpuStream_t stream, double scale_factor,
+                            DataType dtype, DataType out_dtype)
+      : gpu_context_(gpu_context), stream_(stream), scale_factor_(scale_factor),
+        dtype_(dtype), out_dtype_(out_dtype) {}
+
+  // Copies num_elements elements of in to out, norm_sqrd and found_inf can be
+  // null.
+  void Add(void* out, const void* in, int64_t num_elements, double* norm_sqrd,
+           float* found_inf) {
+    params_.out[num_copies_] = out;
+    params_.in[num_copies_] = const_cast<void*>(in);
+    params_.sizes[num_copies_] = (size_t)num_elements;
+    params_.norm_sqrds[num_copies_] = norm_sqrd;
+    params_.found_infs[num_copies_] = found_inf;
+    if (++num_copies_ == BATCHED_NORM_D2D_CAPACITY) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (num_copies_ > 0) {
+      BatchedNormD2DMemcpyCudaImpl(params_, num_copies_, scale_factor_, dtype_, out_dtype_,
+                                   stream_);
+      gpu_context_->ErrorCheck("BatchedNormD2DMemcpyCudaImpl", cudaGetLastError());
+      num_copies_ = 0;
+    }
+  }
+
+private:
+  GPUContext* gpu_context_;
+  gpuStream_t stream_;
+  double scale_factor_;
+  DataType dtype_;
+  DataType out_dtype_;
+  BatchedNormD2DParams params_;
+  int num_copies_ = 0;
+};
+
+double* NormSqrdData(const TensorTableEntry& e) {
+  return e.norm_sqrd != nullptr ? (double*)e.norm_sqrd->data() : nullptr;
+}
+
+float* FoundInfData(const TensorTableEntry& e) {
+  return e.found_inf != nullptr ? (float*)e.found_inf->data() : nullptr;
+}
+
+bool SameHyperparameters(const OptimizerStep& a, const OptimizerStep& b) {
+  return a.kind == b.kind && a.lr == b.lr && a.weight_decay == b.weight_decay &&
+         a.momentum == b.momentum && a.dampening == b.dampening &&
+         a.nesterov == b.nesterov && a.first_step == b.first_step &&
+         a.beta1 == b.beta1 && a.beta2 == b.beta2 && a.eps == b.eps &&
+         a.step == b.step && a.decoupled_weight_decay == b.decoupled_weight_decay;
+}
+
+OptimizerStepHyperparameters Hyperparameters(const OptimizerStep& step) {
+  OptimizerStepHyperparameters hyperparameters;
+  hyperparameters.adam = step.kind == OptimizerStep::ADAM;
+  hyperparameters.lr = step.lr;
+  hyperparameters.weight_decay = step.weight_decay;
+  hyperparameters.momentum = step.momentum;
+  hyperparameters.dampening = step.dampening;
+  hyperparameters.nesterov = step.nesterov;
+  hyperparameters.first_step = step.first_step;
+  hyperparameters.beta1 = step.beta1;
+  hyperparameters.beta2 = step.beta2;
+  hyperparameters.eps = step.eps;
+  hyperparameters.bias_correction1 = 1.0 - std::pow(step.beta1, (double)step.step);
+  hyperparameters.bias_correction2 = 1.0 - std::pow(step.beta2, (double)step.step);
+  hyperparameters.decoupled_weight_decay = step.decoupled_weight_decay;
+  return hyperparameters;
+}
+
+// Updates the parameters of the entries with an optimizer step from their
+// outputs, in launches of the parameters with the same type and
+// hyperparameters.
+void LaunchOptimizerSteps(GPUContext* gpu_context, gpuStream_t stream,
+                          const std::vector<TensorTableEntry>& entries) {
+  BatchedOptimizerStepParams params;
+  const OptimizerStep* first_step = nullptr;
+  DataType dtype = HOROVOD_FLOAT32;
+  int num_params = 0;
+  auto flush = [&]() {
+    if (num_params > 0) {
+      BatchedOptimizerStepCudaImpl(params, num_params, Hyperparameters(*first_step), dtype,
+                                   stream);
+      gpu_context->ErrorCheck("BatchedOptimizerStepCudaImpl", cudaGetLastError());
+      num_params = 0;
+    }
+  };
+  for (auto& e : entries) {
+    if (e.optimizer_step == nullptr) {
+      continue;
+    }
+    auto& step = *e.optimizer_step;
+    if (num_params > 0 && (num_params == BATCHED_OPTIMIZER_STEP_CAPACITY ||
+                           e.output->dtype() != dtype ||
+                           !SameHyperparameters(*first_step, step))) {
+      flush();
+    }
+    if (num_params == 0) {
+      first_step = &step;
+      dtype = e.output->dtype();
+    }
+    params.parameters[num_params] = (void*)step.parameter->data();
+    params.grads[num_params] = (void*)e.output->data();
+    params.states0[num_params] = step.state0 != nullptr ? (void*)step.state0->data() : nullptr;
+    params.states1[num_params] = step.state1 != nullptr ? (void*)step.state1->data() : nullptr;
+    params.sizes[num_params] = (size_t)e.output->shape().num_elements();
+    ++num_params;
+  }
+  flush();
+}
+
+} // namespace
+#endif
+
 GPUOpContext::GPUOpContext(GPUContext* context, HorovodGlobalState* global_state)
     : gpu_context_(context), global_state_(global_state) {
       // for(int i=0;i<5;i++){
@@ -33,94 +218,359 @@ GPUOpContext::GPUOpContext(GPUContext* context, HorovodGlobalState* global_state
       // }
     }
 
-void GPUOpContext::InitGPU(const std::vector<TensorTableEntry>& entries,bool is_allreduce,bool is_para) {
-  auto& first_entry = entries[0];
-  gpu_context_->SetDevice(first_entry.device);
-  int stream_index = first_entry.device;
-  if(is_allreduce){
-    stream_index =  global_state_->stream_assignment[global_state_->current_gpu_stream]; 
-    if(is_para) {
-      stream_index = 8;
+GPUEventFreeList::~GPUEventFreeList() {
+  for (auto& chunk : chunks_) {
+    delete[] chunk.load();
+  }
+}
+
+bool GPUEventFreeList::Pop(gpuEvent_t* event) {
+  uint32_t index = PopNode(events_);
+  if (index == 0) {
+    return false;
+  }
+  auto node = NodeAt(index - 1);
+  *event = node->event;
+  PushNode(spare_nodes_, node, index);
+  return true;
+}
+
+bool GPUEventFreeList::Push(gpuEvent_t event) {
+  uint32_t index = PopNode(spare_nodes_);
+  if (index == 0) {
+    index = num_nodes_.fetch_add(1) + 1;
+    if (index > GPU_EVENT_FREE_LIST_CAPACITY) {
+      num_nodes_.fetch_sub(1);
+      return false;
+    }
+  }
+  auto node = NodeAt(index - 1);
+  node->event = event;
+  PushNode(events_, node, index);
+  return true;
+}
+
+GPUEventFreeList::Node* GPUEventFreeList::NodeAt(uint32_t index) {
+  auto& chunk = chunks_[index / kChunkSize];
+  auto nodes = chunk.load(std::memory_order_acquire);
+  if (nodes == nullptr) {
+    auto new_nodes = new Node[kChunkSize];
+    if (chunk.compare_exchange_strong(nodes, new_nodes,
+                                      std::memory_order_acq_rel)) {
+      nodes = new_nodes;
+    } else {
+      delete[] new_nodes;
+    }
+  }
+  return &nodes[index % kChunkSize];
+}
+
+void GPUEventFreeList::PushNode(std::atomic<uint64_t>& head, Node* node,
+                                uint32_t index) {
+  auto top = head.load(std::memory_order_relaxed);
+  do {
+    node->next.store((uint32_t)top, std::memory_order_relaxed);
+  } while (!head.compare_exchange_weak(top, (top & ~0xffffffffULL) | index,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed));
+}
+
+uint32_t GPUEventFreeList::PopNode(std::atomic<uint64_t>& head) {
+  auto top = head.load(std::memory_order_acquire);
+  while (true) {
+    uint32_t index = (uint32_t)top;
+    if (index == 0) {
+      return 0;
+    }
+    uint32_t next = NodeAt(index - 1)->next.load(std::memory_order_relaxed);
+    uint64_t count = (top >> 32) + 1;
+    if (head.compare_exchange_weak(top, (count << 32) | next,
+                                   std::memory_order_acquire,
+                                   std::memory_order_acquire)) {
+      return index;
+    }
+  }
+}
+
+std::shared_ptr<void> PinnedHostBufferPool::Acquire(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  size_t bucket = 1;
+  while (bucket < size) {
+    bucket <<= 1;
+  }
+
+  void* buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& free_buffers = free_buffers_[bucket];
+    if (!free_buffers.empty()) {
+      buffer = free_buffers.back();
+      free_buffers.pop_back();
+    }
+  }
+  if (buffer == nullptr) {
+    context_->HostAlloc(&buffer, bucket);
+  }
+  return std::shared_ptr<void>(
+      buffer, [this, bucket](void* released) { Release(released, bucket); });
+}
+
+GPUEventWaiter::GPUEventWaiter(const Policy& policy,
+                               const std::function<void()>& error_check_callback)
+    : policy_(policy), error_check_callback_(error_check_callback),
+      start_(std::chrono::steady_clock::now()),
+      next_error_check_(start_) {}
+
+void GPUEventWaiter::Pause() {
+  auto now = std::chrono::steady_clock::now();
+  if (error_check_callback_ && now >= next_error_check_) {
+    error_check_callback_();
+    next_error_check_ =
+        now + std::chrono::microseconds((int64_t)(policy_.error_check_ms * 1000));
+  }
+  if (now - start_ < std::chrono::microseconds(policy_.spin_us)) {
+    std::this_thread::yield();
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(sleep_us_));
+  sleep_us_ = std::min(sleep_us_ * 2, (int64_t)GPU_EVENT_MAX_SLEEP_US);
+}
+
+void PinnedHostBufferPool::Release(void* buffer, size_t size) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!finalized_) {
+      free_buffers_[size].push_back(buffer);
+      return;
+    }
+  }
+  context_->HostFree(buffer);
+}
+
+void PinnedHostBufferPool::Finalize() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  finalized_ = true;
+  for (auto& free_buffers : free_buffers_) {
+    for (auto buffer : free_buffers.second) {
+      context_->HostFree(buffer);
+    }
+  }
+  free_buffers_.clear();
+}
+
+std::shared_ptr<void> GPUGraphCache::Lookup(const std::string& key, bool& capture) {
+  capture = false;
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    if (entries_.size() >= GPU_GRAPH_CACHE_CAPACITY) {
+      entries_.clear();
     }
-    // gpuStream_t& stream = gpu_context_->streams[global_state_->current_nccl_stream][stream_index];
-    // this->stream = this->para_streams[stream_index];
-    // if(this->stream == NULL) std::cout<<"NULL STREAM!!!\n";
+    it = entries_.emplace(key, Entry()).first;
   }
-  gpuStream_t& stream = gpu_context_->streams[global_state_->current_nccl_stream][stream_index];
+  auto& entry = it->second;
+  if (entry.graph == nullptr && entry.capturable) {
+    capture = ++entry.uses > GPU_GRAPH_WARMUP_USES;
+  }
+  return entry.graph;
+}
+
+void GPUGraphCache::Put(const std::string& key, std::shared_ptr<void> graph) {
+  auto& entry = entries_[key];
+  entry.capturable = graph != nullptr;
+  entry.graph = std::move(graph);
+}
+
+void GPUStreamPool::Initialize(int num_slots) {
+  streams_.resize(num_slots);
+}
+
+gpuStream_t& GPUStreamPool::Lease(Role role, int slot, int device, int index,
+                                  int32_t priority) {
+  bool high_priority = HighPriority(role, priority);
+  auto& stream =
+      streams_[slot][high_priority][std::make_tuple((int)role, device, index)];
   if (stream == nullptr) {
-    gpu_context_->StreamCreate(&stream);
+    context_->StreamCreate(&stream, high_priority);
   }
-  // Ensure stream is in the map before executing reduction.
+  return stream;
 }
 
-// fzh-alloc
-void GPUOpContext::InitNewStream(int times){
-  times = (times % 10) + 3;
-  gpuStream_t* new_stream_ = &gpu_context_->streams[global_state_->current_nccl_stream][times];
-  if(new_stream_ == nullptr){
-    gpu_context_->StreamCreate(new_stream_);
+bool GPUStreamPool::HighPriority(Role role, int32_t priority) const {
+  switch (priority_policy_) {
+  case StreamPriorityPolicy::LOW:
+    return false;
+  case StreamPriorityPolicy::LAYER:
+    // Only Libra allreduces carry layer priorities.
+    return (role != ALLREDUCE && role != SPLIT_ALLREDUCE && role != PACK &&
+            role != STAGING) ||
+           priority < high_priority_layers_;
+  default:
+    return true;
   }
-  this->new_stream = new_stream_;
 }
 
+gpuStream_t& GPUOpContext::LeaseStream(int device, bool is_allreduce,
+                                       int32_t priority) {
+  auto role = GPUStreamPool::DEFAULT;
+  int index = 0;
+  if (is_allreduce) {
+    role = GPUStreamPool::ALLREDUCE;
+    int streams = global_state_->parameter_manager.LibraStreams();
+    if (streams > 0) {
+      index = global_state_->current_gpu_stream % streams;
+    } else if (!global_state_->stream_assignment.empty()) {
+      index = global_state_->stream_assignment[global_state_->current_gpu_stream %
+                                               global_state_->stream_assignment.size()];
+    }
+  }
+  global_state_->stream_index = index;
+  return gpu_context_->stream_pool.Lease(role, global_state_->current_nccl_stream, device, index,
+                                         priority);
+}
 
-void GPUOpContext::InitGPUQueue(const std::vector<TensorTableEntry>& entries, const Response& response,bool is_allreduce,bool is_para) {
-  event_queue = std::queue<std::pair<std::string, gpuEvent_t>>();
-  int stream_index = entries[0].device;
-  if(is_allreduce){
-    stream_index =  global_state_->stream_assignment[global_state_->current_gpu_stream];
-    if(is_para) {
-      stream_index = 8;
-    } 
-    global_state_->stream_index = stream_index;
+void GPUOpContext::InitGPU(const std::vector<TensorTableEntry>& entries,bool is_allreduce) {
+  auto& first_entry = entries[0];
+  gpu_context_->SetDevice(first_entry.device);
+  if (is_allreduce) {
+    // The stream depends on the response, InitGPUQueue leases it.
+    return;
   }
-  this->stream = &gpu_context_->streams[global_state_->current_nccl_stream][stream_index];
-  if(is_allreduce){
-    printf("all reduce stream id %d\n",stream_index);
+  // Ensure stream is in the pool before executing reduction.
+  // Operations that do not call InitGPUQueue copy on this stream too.
+  this->stream = &LeaseStream(first_entry.device, is_allreduce);
+}
+
+void GPUOpContext::InitSplitStream(const Response& response) {
+  // The split stream of a slot and stream index is only ever used by the
+  // groups leasing the same ALLREDUCE stream, which run in order.
+  this->split_stream = &gpu_context_->stream_pool.Lease(
+      GPUStreamPool::SPLIT_ALLREDUCE, global_state_->current_nccl_stream,
+      gpu_context_->GetDevice(), global_state_->stream_index, response.priority());
+}
+
+Status GPUOpContext::AllocateScratch(const TensorTableEntry& entry, int64_t size,
+                                     void** data) {
+  std::shared_ptr<PersistentBuffer> buffer;
+  if (gpu_context_->memory_pool) {
+    try {
+      buffer = gpu_context_->AllocatePooled(entry.device, size);
+    } catch (const std::exception& ex) {
+      return Status::UnknownError(ex.what());
+    }
+  } else {
+    Status status = entry.context->AllocatePersistent(size, &buffer);
+    if (!status.ok()) {
+      return status;
+    }
   }
-  else{
-    printf("not all reduce stream id %d\n",stream_index);
+  *data = const_cast<void*>(buffer->AccessData(entry.context));
+  scratch_buffers.push_back(std::move(buffer));
+  return Status::OK();
+}
+
+void GPUOpContext::InitGPUQueue(const std::vector<TensorTableEntry>& entries, const Response& response,bool is_allreduce) {
+  event_queue = std::queue<std::pair<std::string, gpuEvent_t>>();
+  this->stream = &LeaseStream(entries[0].device, is_allreduce,
+                              response.priority());
+  LOG(TRACE) << (is_allreduce ? "Allreduce" : "Collective")
+             << " uses stream " << global_state_->stream_index << ".";
+
+  // Order this operation after the previous one that used the fusion buffer
+  // and communicator of this stream slot on another stream.
+  auto& last_stream =
+      gpu_context_->last_slot_streams[global_state_->current_nccl_stream][entries[0].device];
+  if (last_stream != nullptr && last_stream != *stream) {
+    gpu_context_->StreamWaitStream(*stream, last_stream);
   }
+  last_stream = *stream;
+
+  // Order this operation after the computation of its inputs, the
+  // background thread does not wait for them on the host.
+  for (auto& e : entries) {
+    if (e.ready_event != nullptr && e.ready_event->event() != nullptr) {
+      gpu_context_->StreamWaitEvent(*stream, e.ready_event->event());
+    }
+  }
+
   if (global_state_->timeline.Initialized()) {
     gpu_context_->RecordEvent(event_queue, QUEUE, *stream);
   }
-  if(is_allreduce){
+  int streams = global_state_->parameter_manager.LibraStreams();
+  if (is_allreduce && streams > 0) {
+    global_state_->current_gpu_stream = (global_state_->current_gpu_stream + 1) % streams;
+  } else if(is_allreduce && !global_state_->stream_assignment.empty()){
     global_state_->current_gpu_stream = (global_state_->current_gpu_stream+1)%(global_state_->stream_assignment.size());
   }
 }
 
+void GPUOpContext::FinishOutputs(const std::vector<TensorTableEntry>& entries) {
+#if HAVE_CUDA
+  // Operations without a copy out of the fusion buffer that adds up the
+  // norms and looks for overflows read the outputs once more.
+  if (!norms_accumulated) {
+    for (auto& e : entries) {
+      if (e.norm_sqrd != nullptr || e.found_inf != nullptr) {
+        NormAccumulatingD2DMemcpy norms(gpu_context_, *stream, 1.0, e.output->dtype(),
+                                        e.output->dtype());
+        norms.Add((void*)e.output->data(), e.output->data(),
+                  e.output->shape().num_elements(), NormSqrdData(e), FoundInfData(e));
+        norms.Flush();
+      }
+    }
+  }
+
+  // The optimizer steps run on the stream of the allreduce before the
+  // completion event, and overlap the communication of the next groups.
+  LaunchOptimizerSteps(gpu_context_, *stream, entries);
+#endif
+  norms_accumulated = false;
+}
+
 Status GPUOpContext::FinalizeGPUQueue(const std::vector<TensorTableEntry>& entries, bool free_host_buffer /*= true*/,
                                       const std::function<void()>& error_check_callback) {
+  FinishOutputs(entries);
+
   // Use completion marker via event because it's faster than blocking gpuStreamSynchronize() in this thread.
   gpu_context_->RecordEvent(event_queue, "", *stream);
 
   auto& first_entry = entries[0];
-  void* cpu_buffer = host_buffer;
+  void* cpu_buffer = pinned_host_buffer != nullptr ? nullptr : host_buffer;
+  auto pinned_buffer = std::move(pinned_host_buffer);
+  host_buffer = nullptr;
+  pinned_host_buffer.reset();
+  auto scratch = std::move(scratch_buffers);
+  scratch_buffers.clear();
   auto& evt_queue = event_queue;
   // auto& evt_queue_fzh = event_queue_fzh;
   auto& timeline = global_state_->timeline;
   auto& gpu_context = gpu_context_;
+  auto& gpu_ops_in_flight = global_state_->metrics.gpu_ops_in_flight;
 
   // Claim a std::shared_ptr to the fusion buffer to prevent its memory from being reclaimed
   // during finalization.
   auto fusion_buffer = global_state_->fusion_buffer.GetBuffer(
-      first_entry.device, first_entry.context->framework(), global_state_->current_nccl_stream);
-  gpu_context_->finalizer_thread_pool.execute([entries, first_entry, cpu_buffer, fusion_buffer, free_host_buffer,
-                                                evt_queue, &timeline, &gpu_context, error_check_callback]() mutable {
+      first_entry.device, first_entry.context->framework(), global_state_->fusion_buffer_index);
+  gpu_ops_in_flight.Add(1);
+  gpu_context_->finalizer_thread_pool.execute(
+      global_state_->current_nccl_stream,
+      [entries, first_entry, cpu_buffer, pinned_buffer, scratch, fusion_buffer, free_host_buffer, evt_queue,
+       &timeline, &gpu_context, &gpu_ops_in_flight, error_check_callback]() mutable {
     gpu_context->SetDevice(first_entry.device);
 
     gpu_context->WaitForEvents(evt_queue, entries, timeline, error_check_callback);
     if (free_host_buffer && cpu_buffer != nullptr) {
       free(cpu_buffer);
     }
+    pinned_buffer.reset();
+    scratch.clear();
     // shutdown allreduce
     for (auto& e : entries) {
       timeline.End(e.tensor_name, e.output);
-      // Callback can be null if the rank sent Join request.
-      if (e.callback != nullptr) {
-        e.callback(Status::OK());
-      }
     }
+    InvokeCallbacks(entries, Status::OK());
+    gpu_ops_in_flight.Add(-1);
   });
   //if(this->thread_fzh.joinable()) this->thread_fzh.join();
   // Update current stream
@@ -139,24 +589,227 @@ bool GPUAllreduce::Enabled(const ParameterManager& param_manager,
   return entries[0].device != CPU_DEVICE_ID;
 }
 
+DataType GPUAllreduce::FusionBufferDtype(const std::vector<TensorTableEntry>& entries) const {
+  auto dtype = entries[0].tensor->dtype();
+#if HAVE_CUDA
+  // Only the batched copies cast. The decision must not depend on the layout
+  // of the tensors, which differs between ranks.
+  if (entries.size() > 1 && dtype == HOROVOD_FLOAT32 && global_state_->batch_d2d_memcopies &&
+      CompressesFusionBuffer()) {
+    if (global_state_->fusion_compression == FusionCompression::FP16) {
+      return HOROVOD_FLOAT16;
+    }
+    if (global_state_->fusion_compression == FusionCompression::BF16) {
+      return HOROVOD_BFLOAT16;
+    }
+  }
+#endif
+  return dtype;
+}
+
+void GPUAllreduce::MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                        const void*& fused_input_data, void*& buffer_data,
+                                        size_t& buffer_len) {
+#if HAVE_CUDA
+  if (global_state_->batch_d2d_memcopies && !EntriesAreContiguousInPlace(entries)) {
+    auto& first_entry = entries[0];
+    auto buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(), global_state_->fusion_buffer_index);
+    buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+    int64_t offset = 0;
+    global_state_->timeline.ActivityStart("lyz-p1", "callAsynCpy");
+    BatchedD2DMemcpy memcpy(gpu_context_, *gpu_op_context_.stream);
+    for (auto& e : entries) {
+      memcpy.Add((uint8_t*)buffer_data + offset, e.tensor->data(), (size_t)e.tensor->size());
+      offset += e.tensor->size();
+    }
+    memcpy.Flush();
+    global_state_->timeline.ActivityEnd("lyz-p1");
+
+    buffer_len = (size_t)offset;
+    fused_input_data = buffer_data;
+    return;
+  }
+#endif
+  AllreduceOp::MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+}
+
+void GPUAllreduce::MemcpyOutFusionBuffer(const void* buffer_data,
+                                         std::vector<TensorTableEntry>& entries) {
+#if HAVE_CUDA
+  if (global_state_->batch_d2d_memcopies && buffer_data != entries[0].output->data()) {
+    int64_t offset = 0;
+    BatchedD2DMemcpy memcpy(gpu_context_, *gpu_op_context_.stream);
+    for (auto& e : entries) {
+      memcpy.Add((void*)e.output->data(), (const uint8_t*)buffer_data + offset,
+                 (size_t)e.output->size());
+      offset += e.output->size();
+    }
+    memcpy.Flush();
+    return;
+  }
+#endif
+  AllreduceOp::MemcpyOutFusionBuffer(buffer_data, entries);
+}
+
+void GPUAllreduce::ScaledMemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                              double scale_factor, const void*& fused_input_data,
+                                              void*& buffer_data, size_t& buffer_len) {
+#if HAVE_CUDA
+  auto buffer_dtype = FusionBufferDtype(entries);
+  bool compressed = buffer_dtype != entries[0].tensor->dtype();
+  if ((scale_factor != 1.0 || compressed) && global_state_->batch_d2d_memcopies &&
+      (compressed || !EntriesAreContiguousInPlace(entries))) {
+    auto& first_entry = entries[0];
+    auto buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(), global_state_->fusion_buffer_index);
+    buffer_data = const_cast<void*>(buffer->AccessData(first_entry.context));
+
+    int64_t offset = 0;
+    int element_size = DataType_Size(buffer_dtype);
+    global_state_->timeline.ActivityStart("lyz-p1", "callAsynCpy");
+    BatchedD2DMemcpy memcpy(gpu_context_, *gpu_op_context_.stream, scale_factor,
+                            first_entry.tensor->dtype(), buffer_dtype);
+    for (auto& e : entries) {
+      memcpy.Add((uint8_t*)buffer_data + offset, e.tensor->data(), (size_t)e.tensor->size());
+      offset += e.tensor->shape().num_elements() * element_size;
+    }
+    memcpy.Flush();
+    global_state_->timeline.ActivityEnd("lyz-p1");
+
+    buffer_len = (size_t)offset;
+    fused_input_data = buffer_data;
+    return;
+  }
+#endif
+  MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+  if (scale_factor != 1.0) {
+    int64_t num_elements = 0;
+    for (auto& e : entries) {
+      num_elements += e.tensor->shape().num_elements();
+    }
+    ScaleBuffer(scale_factor, entries, fused_input_data, buffer_data, num_elements);
+    fused_input_data = buffer_data;
+  }
+}
+
+void GPUAllreduce::PipelinedMemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                                 const Response& response,
+                                                 const void*& fused_input_data,
+                                                 void*& buffer_data, size_t& buffer_len) {
+  if (!global_state_->fusion_double_buffering) {
+    ScaledMemcpyInFusionBuffer(entries, response.prescale_factor(), fused_input_data,
+                               buffer_data, buffer_len);
+    return;
+  }
+
+  auto& pack_stream = gpu_context_->stream_pool.Lease(
+      GPUStreamPool::PACK, global_state_->current_nccl_stream, entries[0].device, 0,
+      response.priority());
+  for (auto& e : entries) {
+    if (e.ready_event != nullptr && e.ready_event->event() != nullptr) {
+      gpu_context_->StreamWaitEvent(pack_stream, e.ready_event->event());
+    }
+  }
+
+  auto op_stream = gpu_op_context_.stream;
+  gpu_op_context_.stream = &pack_stream;
+  ScaledMemcpyInFusionBuffer(entries, response.prescale_factor(), fused_input_data,
+                             buffer_data, buffer_len);
+  gpu_op_context_.stream = op_stream;
+
+  gpu_context_->StreamWaitStream(*op_stream, pack_stream);
+  gpu_context_->StreamWaitStream(pack_stream, *op_stream);
+}
+
+void GPUAllreduce::ScaledMemcpyOutFusionBuffer(double scale_factor, const void* buffer_data,
+                                               std::vector<TensorTableEntry>& entries) {
+#if HAVE_CUDA
+  auto buffer_dtype = FusionBufferDtype(entries);
+  bool compressed = buffer_dtype != entries[0].tensor->dtype();
+  if ((scale_factor != 1.0 || compressed) && global_state_->batch_d2d_memcopies &&
+      buffer_data != entries[0].output->data()) {
+    int64_t offset = 0;
+    int element_size = DataType_Size(buffer_dtype);
+    BatchedD2DMemcpy memcpy(gpu_context_, *gpu_op_context_.stream, scale_factor,
+                            buffer_dtype, entries[0].tensor->dtype());
+    for (auto& e : entries) {
+      int64_t size = e.output->shape().num_elements() * element_size;
+      memcpy.Add((void*)e.output->data(), (const uint8_t*)buffer_data + offset, (size_t)size);
+      offset += size;
+    }
+    memcpy.Flush();
+    return;
+  }
+#endif
+  if (scale_factor != 1.0) {
+    int64_t num_elements = 0;
+    for (auto& e : entries) {
+      num_elements += e.tensor->shape().num_elements();
+    }
+    ScaleBuffer(scale_factor, entries, buffer_data, (void*)buffer_data, num_elements);
+  }
+  MemcpyOutFusionBuffer(buffer_data, entries);
+}
+
+bool GPUAllreduce::AccumulatesNorms(const std::vector<TensorTableEntry>& entries) const {
+  for (auto& e : entries) {
+    if (e.norm_sqrd != nullptr || e.found_inf != nullptr) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GPUAllreduce::HasOptimizerSteps(const std::vector<TensorTableEntry>& entries) const {
+  for (auto& e : entries) {
+    if (e.optimizer_step != nullptr) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GPUAllreduce::NormMemcpyOutFusionBuffer(double scale_factor, const void* buffer_data,
+                                             std::vector<TensorTableEntry>& entries) {
+#if HAVE_CUDA
+  auto buffer_dtype = FusionBufferDtype(entries);
+  int element_size = DataType_Size(buffer_dtype);
+  NormAccumulatingD2DMemcpy memcpy(gpu_context_, *gpu_op_context_.stream, scale_factor,
+                                   buffer_dtype, entries[0].tensor->dtype());
+  int64_t offset = 0;
+  for (auto& e : entries) {
+    int64_t num_elements = e.output->shape().num_elements();
+    memcpy.Add((void*)e.output->data(), (const uint8_t*)buffer_data + offset, num_elements,
+               NormSqrdData(e), FoundInfData(e));
+    offset += num_elements * element_size;
+  }
+  memcpy.Flush();
+  gpu_op_context_.norms_accumulated = true;
+#else
+  throw std::logic_error("Gradient norms and overflows are only computed on CUDA devices.");
+#endif
+}
+
 void GPUAllreduce::MemcpyEntryInFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                              const TensorTableEntry& e, void* buffer_data_at_offset) {
   auto& first_entry = entries[0];
   gpu_context_->MemcpyAsyncD2D(buffer_data_at_offset, e.tensor->data(), (size_t) e.tensor->size(),
-                               gpu_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+                               *gpu_op_context_.stream);
 }
 
 void GPUAllreduce::MemcpyEntryOutFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                                const void* buffer_data_at_offset, TensorTableEntry& e) {
   auto& first_entry = entries[0];
   gpu_context_->MemcpyAsyncD2D((void*) e.output->data(), buffer_data_at_offset, (size_t) e.tensor->size(),
-                               gpu_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+                               *gpu_op_context_.stream);
 }
 
 void GPUAllreduce::ScaleBuffer(double scale_factor, const std::vector<TensorTableEntry>& entries,
                                const void* fused_input_data, void* buffer_data, int64_t num_elements) {
   gpu_context_->ScaleBufferImpl(fused_input_data, buffer_data, num_elements, scale_factor, entries[0].tensor->dtype(),
-                                gpu_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+                                *gpu_op_context_.stream);
 
 }
 
@@ -173,7 +826,7 @@ void GPUAllgather::MemcpyEntryInFusionBuffer(const std::vector<TensorTableEntry>
                                              const TensorTableEntry& e, void* buffer_data_at_offset) {
   auto& first_entry = entries[0];
   gpu_context_->MemcpyAsyncD2D(buffer_data_at_offset, e.tensor->data(), (size_t) e.tensor->size(),
-                               gpu_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+                               *gpu_op_context_.stream);
 }
 
 void GPUAllgather::MemcpyEntryOutFusionBuffer(const std::vector<TensorTableEntry>& entries,
@@ -181,7 +834,7 @@ void GPUAllgather::MemcpyEntryOutFusionBuffer(const std::vector<TensorTableEntry
                                               int64_t entry_offset, size_t entry_size) {
   auto& first_entry = entries[0];
   gpu_context_->MemcpyAsyncD2D((int8_t*)e.output->data() + entry_offset, buffer_data_at_offset, entry_size,
-                               gpu_context_->streams[global_state_->current_nccl_stream][first_entry.device]);
+                               *gpu_op_context_.stream);
 }
 
 GPUBroadcast::GPUBroadcast(GPUContext* context,
@@ -194,6 +847,18 @@ bool GPUBroadcast::Enabled(const ParameterManager& param_manager,
   return entries[0].device != CPU_DEVICE_ID;
 }
 
+void GPUBroadcast::MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                             void* buffer_data_at_offset) {
+  gpu_context_->MemcpyAsyncD2D(buffer_data_at_offset, e.tensor->data(),
+                               (size_t)e.tensor->size(), *gpu_op_context_.stream);
+}
+
+void GPUBroadcast::MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                              TensorTableEntry& e) {
+  gpu_context_->MemcpyAsyncD2D((void*)e.output->data(), buffer_data_at_offset,
+                               (size_t)e.output->size(), *gpu_op_context_.stream);
+}
+
 GPUAlltoall::GPUAlltoall(GPUContext* context,
 		         HorovodGlobalState* global_state)
     : AlltoallOp(global_state), gpu_context_(context), gpu_op_context_(context, global_state) {}
@@ -204,5 +869,30 @@ bool GPUAlltoall::Enabled(const ParameterManager& param_manager,
   return entries[0].device != CPU_DEVICE_ID;
 }
 
+GPUReducescatter::GPUReducescatter(GPUContext* context,
+                                   HorovodGlobalState* global_state)
+    : ReducescatterOp(global_state), gpu_context_(context), gpu_op_context_(context, global_state) {}
+
+bool GPUReducescatter::Enabled(const ParameterManager& param_manager,
+                               const std::vector<TensorTableEntry>& entries,
+                               const Response& response) const {
+  return entries[0].device != CPU_DEVICE_ID;
+}
+
+void GPUReducescatter::MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                                 int64_t entry_offset,
+                                                 size_t entry_size,
+                                                 void* buffer_data_at_offset) {
+  gpu_context_->MemcpyAsyncD2D(buffer_data_at_offset,
+                               (const uint8_t*)e.tensor->data() + entry_offset,
+                               entry_size, *gpu_op_context_.stream);
+}
+
+void GPUReducescatter::MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                                  TensorTableEntry& e) {
+  gpu_context_->MemcpyAsyncD2D((void*)e.output->data(), buffer_data_at_offset,
+                               (size_t)e.output->size(), *gpu_op_context_.stream);
+}
+
 } // namespace common
 } // namespace horovod
@@ -18,6 +18,12 @@
 #ifndef HOROVOD_GPU_OPERATIONS_H
 #define HOROVOD_GPU_OPERATIONS_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <unordered_map>
 #include <vector>
@@ -37,17 +43,196 @@ using gpuStream_t = hipStream_t;
 #endif
 
 #include "collective_operations.h"
+#include "../hashes.h"
 #include "../thread_pool.h"
+#include "../utils/env_parser.h"
 
 namespace horovod {
 namespace common {
 
+class GPUContext;
+
+// Owns the GPU streams of the operations and leases them by role. A stream is
+// created the first time it is leased, at the priority of its role, and then
+// lives as long as the pool. Streams of different roles, stream slots
+// (current_nccl_stream) or devices are never shared.
+class GPUStreamPool {
+public:
+  enum Role {
+    // Collectives other than the Libra allreduce, and the MPI GPU operations.
+    DEFAULT = 0,
+    // Libra allreduce, one stream per HOROVOD_STREAM_ASSIGNMENT index.
+    ALLREDUCE = 1,
+    // Second part of split Libra allreduces, one stream per ALLREDUCE stream.
+    SPLIT_ALLREDUCE = 2,
+    // Packing of allreduce fusion buffers with HOROVOD_FUSION_DOUBLE_BUFFERING.
+    PACK = 3,
+    // Host staging copies of pipelined hierarchical allreduces, one stream per
+    // ALLREDUCE stream.
+    STAGING = 4
+  };
+
+  explicit GPUStreamPool(GPUContext* context) : context_(context) {}
+
+  void Initialize(int num_slots);
+
+  // The current device must be the given device. The reference stays valid
+  // for the lifetime of the pool. The priority is the scheduling priority of
+  // the response the stream is leased for.
+  gpuStream_t& Lease(Role role, int slot, int device, int index = 0,
+                     int32_t priority = 0);
+
+  bool HighPriority(Role role, int32_t priority) const;
+
+  void SetPriorityPolicy(StreamPriorityPolicy policy) { priority_policy_ = policy; }
+  void SetHighPriorityLayers(int value) { high_priority_layers_ = value; }
+
+private:
+  GPUContext* context_;
+  StreamPriorityPolicy priority_policy_ = StreamPriorityPolicy::HIGH;
+  // With the LAYER policy, responses of a lower priority use high priority
+  // streams.
+  int high_priority_layers_ = 1;
+  // Keyed by (role, device, index) within each slot, for low and high
+  // priority streams.
+  std::vector<std::array<std::unordered_map<std::tuple<int, int, int>, gpuStream_t>, 2>> streams_;
+};
+
+// Idle GPU events of one device. Events are recorded by the background and
+// execution threads and released by the finalizer threads, so the list is a
+// lock-free stack rather than a queue behind a mutex. Push fails once the list
+// holds GPU_EVENT_FREE_LIST_CAPACITY events, and the caller destroys the
+// event instead.
+#define GPU_EVENT_FREE_LIST_CAPACITY (1 << 16)
+
+// Events of devices with a higher ordinal are not reused.
+#define GPU_EVENT_MAX_DEVICES 64
+
+class GPUEventFreeList {
+public:
+  GPUEventFreeList() = default;
+  GPUEventFreeList(const GPUEventFreeList&) = delete;
+  ~GPUEventFreeList();
+
+  bool Pop(gpuEvent_t* event);
+  bool Push(gpuEvent_t event);
+
+private:
+  // Nodes are allocated in chunks that live as long as the list, so a node
+  // can still be read after another thread popped it. The heads pack the
+  // index of the top node plus one with a counter that changes on every pop.
+  static constexpr uint32_t kChunkSize = 1024;
+  static constexpr uint32_t kNumChunks =
+      GPU_EVENT_FREE_LIST_CAPACITY / kChunkSize;
+
+  struct Node {
+    gpuEvent_t event;
+    std::atomic<uint32_t> next{0};
+  };
+
+  Node* NodeAt(uint32_t index);
+  static void PushNode(std::atomic<uint64_t>& head, Node* node, uint32_t index);
+  uint32_t PopNode(std::atomic<uint64_t>& head);
+
+  // Nodes holding an idle event, and nodes without one.
+  std::atomic<uint64_t> events_{0};
+  std::atomic<uint64_t> spare_nodes_{0};
+  std::atomic<uint32_t> num_nodes_{0};
+  std::array<std::atomic<Node*>, kNumChunks> chunks_{};
+};
+
+// The longest sleep between two queries of an event that is not ready.
+#define GPU_EVENT_MAX_SLEEP_US 200
+
+// Paces the host while it waits for a GPU event. It spins for spin_us, then
+// sleeps between the queries for longer and longer, up to
+// GPU_EVENT_MAX_SLEEP_US, so that waits for long kernels do not keep a core
+// busy. The error check runs at most every error_check_ms, since checking
+// NCCL communicators for asynchronous errors is not free either.
+class GPUEventWaiter {
+public:
+  struct Policy {
+    int64_t spin_us = 50;
+    double error_check_ms = 5;
+  };
+
+  GPUEventWaiter(const Policy& policy,
+                 const std::function<void()>& error_check_callback);
+
+  // Called after every query that found the event not ready.
+  void Pause();
+
+private:
+  const Policy& policy_;
+  const std::function<void()>& error_check_callback_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point next_error_check_;
+  int64_t sleep_us_ = 1;
+};
+
+// Keeps pinned host buffers for staging device data through host memory,
+// since allocating pinned memory is much slower than malloc. Sizes are
+// rounded up to powers of two, and a buffer goes back to the pool when the
+// last reference to it is released.
+class PinnedHostBufferPool {
+public:
+  explicit PinnedHostBufferPool(GPUContext* context) : context_(context) {}
+  PinnedHostBufferPool(const PinnedHostBufferPool&) = delete;
+
+  // Returns a buffer of at least size bytes, null if size is 0.
+  std::shared_ptr<void> Acquire(size_t size);
+
+  // Frees the pooled buffers. Buffers still referenced are freed when they
+  // are released.
+  void Finalize();
+
+private:
+  void Release(void* buffer, size_t size);
+
+  GPUContext* context_;
+  std::mutex mutex_;
+  bool finalized_ = false;
+  // Free buffers keyed by their size.
+  std::unordered_map<size_t, std::vector<void*>> free_buffers_;
+};
+
+// A group is captured the first time it is performed again after this many
+// uses, so that the buffers it touches are allocated by then.
+#define GPU_GRAPH_WARMUP_USES 3
+
+// The cache is cleared once it holds this many groups.
+#define GPU_GRAPH_CACHE_CAPACITY 256
+
+// Instantiated CUDA graphs of the operations of an op, keyed by everything the
+// captured launches depend on. Only used by the background thread.
+class GPUGraphCache {
+public:
+  // Returns the graph of the key, or null. Sets capture if the caller should
+  // capture the graph of the key and Put it.
+  std::shared_ptr<void> Lookup(const std::string& key, bool& capture);
+
+  // A null graph marks the key as not capturable.
+  void Put(const std::string& key, std::shared_ptr<void> graph);
+
+  void Clear() { entries_.clear(); }
+
+private:
+  struct Entry {
+    int uses = 0;
+    bool capturable = true;
+    std::shared_ptr<void> graph;
+  };
+  std::unordered_map<std::string, Entry> entries_;
+};
+
 class GPUContext {
 public:
   GPUContext();
   ~GPUContext();
 
-  void Finalize();
+  // Stops the finalizer threads. The pooled pinned buffers are freed unless
+  // keep_pinned_buffers is set, for Horovod to be initialized again.
+  void Finalize(bool keep_pinned_buffers = false);
 
   // The GPU stream used for data transfers and within-allreduce operations.
   // A naive implementation would use the TensorFlow StreamExecutor GPU
@@ -63,7 +248,13 @@ public:
   // other parts of the graph. Overlaying memory transfers and compute during
   // backpropagation is crucial for good performance, so we cannot use the
   // TensorFlow stream, and must use our own stream.
-  std::vector<std::unordered_map<int, gpuStream_t>> streams;
+  GPUStreamPool stream_pool{this};
+
+  // The fusion buffer and NCCL communicator of a stream slot
+  // (current_nccl_stream) are shared by every stream of that slot. This is the
+  // stream, per slot and device, that last used them. An operation running on
+  // another stream of the slot must wait for it.
+  std::vector<std::unordered_map<int, gpuStream_t>> last_slot_streams;
 
   void ErrorCheck(std::string op_name, gpuError_t gpu_result);
 
@@ -77,23 +268,72 @@ public:
   // void WaitForEventsFzh(HorovodGlobalState& state,
   //                     const std::function<void()>& error_check_callback = nullptr);
 
-  void StreamCreate(gpuStream_t *stream);
+  void StreamCreate(gpuStream_t *stream, bool high_priority = true);
   void StreamSynchronize(gpuStream_t stream);
 
+  // Make waiting_stream wait for the work enqueued on stream so far, without
+  // blocking the host.
+  void StreamWaitStream(gpuStream_t waiting_stream, gpuStream_t stream);
+
+  void StreamWaitEvent(gpuStream_t stream, gpuEvent_t event);
+
+  // Blocks the host until the event completed.
+  void EventSynchronize(gpuEvent_t event);
+
+  // Capture the work enqueued on stream by this thread into a graph instead
+  // of running it. StreamEndCapture returns the instantiated graph, or null if
+  // the work could not be captured, in which case none of it ran.
+  void StreamBeginCapture(gpuStream_t stream);
+  std::shared_ptr<void> StreamEndCapture(gpuStream_t stream);
+
+  void GraphLaunch(const std::shared_ptr<void>& graph, gpuStream_t stream);
+
   int GetDevice();
 
+  // Returns 0 if the number of multiprocessors cannot be queried.
+  int GetMultiProcessorCount(int device);
+
+  // Returns the NUMA node the device of the local rank is attached to, taking
+  // the devices in turns, or -1 if it is unknown.
+  int GetLocalNumaNode(int local_rank);
+
   void SetDevice(int device);
 
   void MemcpyAsyncD2D(void* dst, const void* src, size_t count, gpuStream_t stream);
   void MemcpyAsyncH2D(void* dst, const void* src, size_t count, gpuStream_t stream);
   void MemcpyAsyncD2H(void* dst, const void* src, size_t count, gpuStream_t stream);
 
+  // Allocates and frees pinned host memory.
+  void HostAlloc(void** ptr, size_t size);
+  void HostFree(void* ptr);
+
+  // Allocates device memory of device from a stream-ordered pool of its own,
+  // which keeps freed memory for the next allocations up to
+  // memory_pool_release_bytes. The memory goes back to the pool once the
+  // buffer is released, which must happen after the GPU work using it.
+  std::shared_ptr<PersistentBuffer> AllocatePooled(int device, int64_t size);
+
+  // Returns the memory kept by the pools of AllocatePooled to the device.
+  void TrimMemoryPools();
+
+  // With HOROVOD_CUDA_MEMORY_POOL, the fusion buffers and the scratch buffers
+  // of the operations come from AllocatePooled rather than from the framework.
+  bool memory_pool = false;
+  uint64_t memory_pool_release_bytes = UINT64_MAX;
+
   void ScaleBufferImpl(const void* fused_input_data, void* buffer_data, int64_t num_elements,
                        double scale_factor, DataType dtype, gpuStream_t stream);
 
   // Thread pool for finalizer threads
   ThreadPool finalizer_thread_pool;
 
+  // How WaitForEvents waits, with HOROVOD_GPU_EVENT_SPIN_US and
+  // HOROVOD_GPU_ERROR_CHECK_MS.
+  GPUEventWaiter::Policy event_wait_policy;
+
+  // Host staging buffers of the operations that reduce through host memory.
+  PinnedHostBufferPool pinned_host_buffers{this};
+
 private:
   class impl;
   std::unique_ptr<impl> pimpl;
@@ -104,12 +344,13 @@ public:
   GPUOpContext(GPUContext* context,
                HorovodGlobalState* global_state);
 
-  void InitGPU(const std::vector<TensorTableEntry>& entrie,bool is_allreduce=false,bool is_para=false);
+  void InitGPU(const std::vector<TensorTableEntry>& entrie,bool is_allreduce=false);
 
-  // fzh-alloc
-  void InitNewStream(int );
+  // Leases split_stream for the second part of a split group, after
+  // InitGPUQueue leased the stream of the first part.
+  void InitSplitStream(const Response& response);
 
-  void InitGPUQueue(const std::vector<TensorTableEntry>& entries, const Response& response,bool is_allreduce=false,bool is_para=false);
+  void InitGPUQueue(const std::vector<TensorTableEntry>& entries, const Response& response,bool is_allreduce=false);
 
   Status FinalizeGPUQueue(const std::vector<TensorTableEntry>& entries, bool free_host_buffer = true,
                           const std::function<void()>& error_check_callback = nullptr);
@@ -125,11 +366,34 @@ public:
   // https://devblogs.nvidia.com/how-implement-performance-metrics-cuda-cc/
   std::queue<std::pair<std::string, gpuEvent_t>> event_queue;
   gpuStream_t* stream;
-  // fzh-alloc
-  gpuStream_t* new_stream;
+  // Stream of the second part of a split group.
+  gpuStream_t* split_stream = nullptr;
   void* host_buffer = nullptr;
+  // Set instead of freeing host_buffer when it comes from the pinned pool.
+  // The finalizer keeps it until the operation completed on the GPU.
+  std::shared_ptr<void> pinned_host_buffer;
+  // Device scratch buffers of the operation, kept by the finalizer until the
+  // operation completed on the GPU.
+  std::vector<std::shared_ptr<PersistentBuffer>> scratch_buffers;
+
+  // Allocates a scratch buffer of size bytes on the device of entry, kept in
+  // scratch_buffers, from the memory pool if enabled.
+  Status AllocateScratch(const TensorTableEntry& entry, int64_t size, void** data);
+  // Set once the squared norms and the overflow flags of the entries were
+  // computed by the copy out of the fusion buffer. FinalizeGPUQueue computes
+  // them from the outputs otherwise.
+  bool norms_accumulated = false;
+
+  // Enqueues the work on the outputs of the entries that follows their
+  // operation on the stream: the norms and overflow flags not computed by the
+  // copy out of the fusion buffer, and the optimizer steps. Called by
+  // FinalizeGPUQueue, operations that complete otherwise call it themselves.
+  void FinishOutputs(const std::vector<TensorTableEntry>& entries);
 
 private:
+  gpuStream_t& LeaseStream(int device, bool is_allreduce,
+                           int32_t priority = 0);
+
   GPUContext* gpu_context_;
   HorovodGlobalState* global_state_;
 };
@@ -144,6 +408,58 @@ public:
                const Response& response) const override;
 
 protected:
+  // Type of the elements of the fusion buffer of entries. With
+  // HOROVOD_FUSION_COMPRESSION, fused float32 entries are cast to half
+  // precision by the batched copies in and back by the ones out.
+  DataType FusionBufferDtype(const std::vector<TensorTableEntry>& entries) const;
+
+  // Whether the collective of the operation can reduce a compressed fusion
+  // buffer.
+  virtual bool CompressesFusionBuffer() const { return false; }
+
+  // With HOROVOD_BATCH_D2D_MEMCOPIES, copies the small entries of a group with
+  // one kernel launch instead of one cudaMemcpyAsync per entry.
+  void MemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                            const void*& fused_input_data, void*& buffer_data,
+                            size_t& buffer_len) override;
+
+  void MemcpyOutFusionBuffer(const void* buffer_data,
+                             std::vector<TensorTableEntry>& entries) override;
+
+  // Like MemcpyInFusionBuffer followed by ScaleBuffer on the fused buffer,
+  // in a single pass over the data when the copy is batched.
+  void ScaledMemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                  double scale_factor, const void*& fused_input_data,
+                                  void*& buffer_data, size_t& buffer_len);
+
+  // Like ScaledMemcpyInFusionBuffer, but packs on the pack stream of the slot
+  // with HOROVOD_FUSION_DOUBLE_BUFFERING. The operation stream waits for the
+  // pack, and the next pack of the slot, which reuses the buffer of the
+  // previous group, waits for everything queued on the operation stream so
+  // far. Packing a group thus overlaps the collective of the previous one.
+  void PipelinedMemcpyInFusionBuffer(const std::vector<TensorTableEntry>& entries,
+                                     const Response& response, const void*& fused_input_data,
+                                     void*& buffer_data, size_t& buffer_len);
+
+  // Like ScaleBuffer on the fused buffer followed by MemcpyOutFusionBuffer,
+  // in a single pass over the data when the copy is batched.
+  void ScaledMemcpyOutFusionBuffer(double scale_factor, const void* buffer_data,
+                                   std::vector<TensorTableEntry>& entries);
+
+  // Whether an entry has a norm_sqrd the squared norm of its output is added
+  // to, or a found_inf flag.
+  bool AccumulatesNorms(const std::vector<TensorTableEntry>& entries) const;
+
+  // Whether an entry has an optimizer step.
+  bool HasOptimizerSteps(const std::vector<TensorTableEntry>& entries) const;
+
+  // Like ScaledMemcpyOutFusionBuffer, and adds the squared norms of the
+  // outputs to the norm_sqrd of their entries and sets their found_inf flags
+  // in the same pass. The fusion
+  // buffer can be the output of a single entry.
+  void NormMemcpyOutFusionBuffer(double scale_factor, const void* buffer_data,
+                                 std::vector<TensorTableEntry>& entries);
+
   void MemcpyEntryInFusionBuffer(const std::vector<TensorTableEntry>& entries,
                                  const TensorTableEntry& e, void* buffer_data_at_offset) override;
 
@@ -189,6 +505,12 @@ public:
                const Response& response) const override;
 
 protected:
+  void MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                 void* buffer_data_at_offset) override;
+
+  void MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                  TensorTableEntry& e) override;
+
   struct GPUContext* gpu_context_;
   GPUOpContext gpu_op_context_;
 };
@@ -205,6 +527,27 @@ protected:
   GPUOpContext gpu_op_context_;
 };
 
+class GPUReducescatter : public ReducescatterOp {
+public:
+  GPUReducescatter(GPUContext* context,
+                   HorovodGlobalState* global_state);
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+protected:
+  void MemcpyEntryInFusionBuffer(const TensorTableEntry& e,
+                                 int64_t entry_offset, size_t entry_size,
+                                 void* buffer_data_at_offset) override;
+
+  void MemcpyEntryOutFusionBuffer(const void* buffer_data_at_offset,
+                                  TensorTableEntry& e) override;
+
+  GPUContext* gpu_context_;
+  GPUOpContext gpu_op_context_;
+};
+
 } // namespace common
 } // namespace horovod
 
@@ -31,17 +31,9 @@ public:
       return status;
     }
 
-    auto& mutex = hip_events_mutex;
-    {
-      std::lock_guard<std::mutex> guard(mutex);
-      auto& queue = hip_events[device];
-      if (!queue.empty()) {
-        *event = queue.front();
-        queue.pop();
-        return hipSuccess;
-      }
+    if (device < GPU_EVENT_MAX_DEVICES && hip_events[device].Pop(event)) {
+      return hipSuccess;
     }
-
     return hipEventCreateWithFlags(event, hipEventDisableTiming);
   }
 
@@ -52,14 +44,10 @@ public:
       return status;
     }
 
-    auto& mutex = hip_events_mutex;
-    {
-      std::lock_guard<std::mutex> guard(mutex);
-      auto& queue = hip_events[device];
-      queue.push(event);
+    if (device < GPU_EVENT_MAX_DEVICES && hip_events[device].Push(event)) {
+      return hipSuccess;
     }
-
-    return hipSuccess;
+    return hipEventDestroy(event);
   }
 
   void ErrorCheck(std::string op_name, hipError_t hip_result) {
@@ -77,7 +65,8 @@ public:
 
   void WaitForEvents(std::queue<std::pair<std::string, hipEvent_t>>& event_queue,
       const std::vector<TensorTableEntry>& entries, Timeline& timeline,
-      const std::function<void()>& error_check_callback) {
+      const std::function<void()>& error_check_callback,
+      const GPUEventWaiter::Policy& policy) {
     while (!event_queue.empty()) {
       std::string name;
       hipEvent_t event;
@@ -89,6 +78,7 @@ public:
 
       // Check for async (networking) errors while waiting for the event to complete
       hipError_t hip_result;
+      GPUEventWaiter waiter(policy, error_check_callback);
       while (true) {
         hip_result = hipEventQuery(event);
         if (hip_result == hipSuccess) {
@@ -99,10 +89,7 @@ public:
           throw std::logic_error(std::string("hipEventQuery failed: ") + hipGetErrorString(hip_result));
         }
 
-        if (error_check_callback) {
-          error_check_callback();
-        }
-        std::this_thread::yield();
+        waiter.Pause();
       }
 
       if (name != "") {
@@ -112,18 +99,49 @@ public:
     }
   }
 
-  void StreamCreate(hipStream_t *stream) {
-    int greatest_priority;
+  void StreamCreate(hipStream_t *stream, bool high_priority) {
+    int least_priority, greatest_priority;
     ErrorCheck("hipDeviceGetStreamPriorityRange",
-        hipDeviceGetStreamPriorityRange(NULL, &greatest_priority));
+        hipDeviceGetStreamPriorityRange(&least_priority, &greatest_priority));
     ErrorCheck("hipStreamCreateWithPriority",
-        hipStreamCreateWithPriority(stream, hipStreamNonBlocking, greatest_priority));
+        hipStreamCreateWithPriority(stream, hipStreamNonBlocking,
+                                      high_priority ? greatest_priority : least_priority));
   }
 
   void StreamSynchronize(hipStream_t stream) {
     ErrorCheck("hipStreamSynchronize", hipStreamSynchronize(stream));
   }
 
+  void StreamWaitStream(hipStream_t waiting_stream, hipStream_t stream) {
+    // The wait captures the event as recorded now, so the event can go back
+    // to the pool right away.
+    hipEvent_t event;
+    ErrorCheck("GetGpuEvent", GetGpuEvent(&event));
+    ErrorCheck("hipEventRecord", hipEventRecord(event, stream));
+    ErrorCheck("hipStreamWaitEvent", hipStreamWaitEvent(waiting_stream, event, 0));
+    ErrorCheck("ReleaseGpuEvent", ReleaseGpuEvent(event));
+  }
+
+  void StreamWaitEvent(hipStream_t stream, hipEvent_t event) {
+    ErrorCheck("hipStreamWaitEvent", hipStreamWaitEvent(stream, event, 0));
+  }
+
+  void EventSynchronize(hipEvent_t event) {
+    ErrorCheck("hipEventSynchronize", hipEventSynchronize(event));
+  }
+
+  void StreamBeginCapture(hipStream_t stream) {
+    throw std::logic_error("Graph capture is not supported with ROCm.");
+  }
+
+  std::shared_ptr<void> StreamEndCapture(hipStream_t stream) {
+    throw std::logic_error("Graph capture is not supported with ROCm.");
+  }
+
+  void GraphLaunch(const std::shared_ptr<void>& graph, hipStream_t stream) {
+    throw std::logic_error("Graph capture is not supported with ROCm.");
+  }
+
   int GetDevice() {
     int device;
     ErrorCheck("hipGetDevice", hipGetDevice(&device));
@@ -134,6 +152,32 @@ public:
     ErrorCheck("hipSetDevice", hipSetDevice(device));
   }
 
+  int GetDeviceCount() {
+    int count;
+    if (hipGetDeviceCount(&count) != hipSuccess) {
+      return 0;
+    }
+    return count;
+  }
+
+  // Returns an empty string if the bus id cannot be queried.
+  std::string GetPCIBusId(int device) {
+    char bus_id[32];
+    if (hipDeviceGetPCIBusId(bus_id, sizeof(bus_id), device) != hipSuccess) {
+      return "";
+    }
+    return bus_id;
+  }
+
+  int GetMultiProcessorCount(int device) {
+    int count;
+    if (hipDeviceGetAttribute(&count, hipDeviceAttributeMultiprocessorCount,
+                              device) != hipSuccess) {
+      return 0;
+    }
+    return count;
+  }
+
   void MemcpyAsyncD2D(void* dst, const void* src, size_t count, hipStream_t stream) {
     ErrorCheck("hipMemcpyAsync", hipMemcpyAsync(dst, src, count, hipMemcpyDeviceToDevice, stream));
   }
@@ -146,15 +190,30 @@ public:
     ErrorCheck("hipMemcpyAsync", hipMemcpyAsync(dst, src, count, hipMemcpyDeviceToHost, stream));
   }
 
+  void HostAlloc(void** ptr, size_t size) {
+    ErrorCheck("hipHostMalloc", hipHostMalloc(ptr, size, hipHostMallocDefault));
+  }
+
+  void HostFree(void* ptr) {
+    ErrorCheck("hipHostFree", hipHostFree(ptr));
+  }
+
   void ScaleBufferImpl(const void* fused_input_data, void* buffer_data, int64_t num_elements,
                    double scale_factor, DataType dtype, hipStream_t stream) {
     throw std::logic_error("ScaleBuffer not implemented for AMD GPUs.");
   }
 
+  void* PoolMalloc(int device, size_t size, uint64_t release_bytes) {
+    throw std::logic_error("Memory pools are not supported with ROCm.");
+  }
+
+  void PoolFree(int device, void* ptr) {}
+
+  void PoolTrim() {}
+
 private:
   // We reuse HIP events as it appears that their creation carries non-zero cost.
-  std::unordered_map<int, std::queue<hipEvent_t>> hip_events;
-  std::mutex hip_events_mutex;
+  std::array<GPUEventFreeList, GPU_EVENT_MAX_DEVICES> hip_events;
 };
 
 #include "gpu_context_impl.cc"
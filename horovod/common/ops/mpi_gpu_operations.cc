@@ -42,7 +42,7 @@ Status MPI_GPUAllreduce::Execute(std::vector<TensorTableEntry>& entries, const R
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
     MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
 
-    gpu_context_->StreamSynchronize(gpu_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
 
     timeline.ActivityEndAll(entries);
   } else {
@@ -55,6 +55,8 @@ Status MPI_GPUAllreduce::Execute(std::vector<TensorTableEntry>& entries, const R
     // Execute prescaling op
     ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
     fused_input_data = buffer_data; // for unfused, scale is done out of place
+    // MPI is not ordered after the work of the stream.
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
   }
 
   // Do allreduce.
@@ -81,9 +83,18 @@ Status MPI_GPUAllreduce::Execute(std::vector<TensorTableEntry>& entries, const R
     timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
     MemcpyOutFusionBuffer(buffer_data, entries);
 
-    gpu_context_->StreamSynchronize(gpu_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
 
     timeline.ActivityEndAll(entries);
+  } else if (response.postscale_factor() != 1.0) {
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
+  }
+
+  // MPI allreduces complete without FinalizeGPUQueue, the norms and overflow
+  // flags of the outputs, and their optimizer steps, are computed here.
+  if (AccumulatesNorms(entries) || HasOptimizerSteps(entries)) {
+    gpu_op_context_.FinishOutputs(entries);
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
   }
 
   return Status::OK();
@@ -100,21 +111,14 @@ Status MPI_GPUAllgather::Execute(std::vector<TensorTableEntry>& entries, const R
 
   gpu_op_context_.InitGPU(entries);
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
+  // Sizes of subcomponents of each entry from all ranks, and offset of each
+  // subcomponent of every entry in the final buffer after allgatherv
   int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
 
   auto& first_entry = entries[0];
 
@@ -138,7 +142,7 @@ Status MPI_GPUAllgather::Execute(std::vector<TensorTableEntry>& entries, const R
     timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
     MemcpyInFusionBuffer(entries, displcmnts, element_size, buffer_data);
 
-    gpu_context_->StreamSynchronize(gpu_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
 
     timeline.ActivityEndAll(entries);
   } else {
@@ -166,21 +170,11 @@ Status MPI_GPUAllgather::Execute(std::vector<TensorTableEntry>& entries, const R
     MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
                           buffer_data, element_size, entries);
 
-    gpu_context_->StreamSynchronize(gpu_context_->streams[global_state_->current_nccl_stream][entries[0].device]);
+    gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
 
     timeline.ActivityEndAll(entries);
   }
 
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
-
   return Status::OK();
 }
 
@@ -191,29 +185,26 @@ MPI_GPUAlltoall::MPI_GPUAlltoall(MPIContext* mpi_context,
       mpi_context_(mpi_context) {}
 
 Status MPI_GPUAlltoall::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-
   gpu_op_context_.InitGPU(entries);
-  auto e = entries[0];
 
-  std::vector<int32_t> sdispls, rdispls;
-  std::vector<int32_t> sendcounts, recvcounts;
-  Status status = PrepareOutputAndParams(e, sdispls, rdispls, sendcounts, recvcounts);
+  std::vector<AlltoallParams<int32_t>> params;
+  Status status = PrepareOutputAndParams(entries, params);
   if (!status.ok()) {
     return status;
   }
 
-  const void* sendbuf = e.tensor->data();
-  void* buffer_data = (void*) e.output->data();
   global_state_->timeline.ActivityStartAll(entries, MPI_ALLTOALL);
-
-  int op = MPI_Alltoallv(sendbuf, sendcounts.data(), sdispls.data(),
-                         mpi_context_->GetMPIDataType(e.tensor->dtype()),
-                         buffer_data, recvcounts.data(), rdispls.data(),
-                         mpi_context_->GetMPIDataType(e.output->dtype()),
-                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
-  if (op != MPI_SUCCESS) {
-    throw std::runtime_error("MPI_Alltoallv failed, see MPI output for details.");
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    auto& e = entries[ec];
+    auto& p = params[ec];
+    int op = MPI_Alltoallv(e.tensor->data(), p.sendcounts.data(), p.sdispls.data(),
+                           mpi_context_->GetMPIDataType(e.tensor->dtype()),
+                           (void*) e.output->data(), p.recvcounts.data(), p.rdispls.data(),
+                           mpi_context_->GetMPIDataType(e.output->dtype()),
+                           mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Alltoallv failed, see MPI output for details.");
+    }
   }
   global_state_->timeline.ActivityEndAll(entries);
 
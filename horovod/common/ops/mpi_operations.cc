@@ -17,15 +17,52 @@
 
 #include "mpi_operations.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace horovod {
 namespace common {
 
+namespace {
+
+// Copies the bytes [begin, end) of the fused entries, whose offsets in the
+// fusion buffer are given, between the entries and the fusion buffer.
+void MemcpyFusedRange(std::vector<TensorTableEntry>& entries,
+                      const std::vector<int64_t>& offsets, int64_t begin,
+                      int64_t end, uint8_t* buffer_data, bool into_buffer) {
+  size_t ec = std::upper_bound(offsets.begin(), offsets.end(), begin) -
+              offsets.begin() - 1;
+  for (; ec < entries.size() && offsets[ec] < end; ++ec) {
+    int64_t copy_begin = std::max(begin, offsets[ec]);
+    int64_t copy_end = std::min(end, offsets[ec + 1]);
+    int64_t entry_offset = copy_begin - offsets[ec];
+    if (into_buffer) {
+      std::memcpy(buffer_data + copy_begin,
+                  (const uint8_t*)entries[ec].tensor->data() + entry_offset,
+                  (size_t)(copy_end - copy_begin));
+    } else {
+      std::memcpy((uint8_t*)entries[ec].output->data() + entry_offset,
+                  buffer_data + copy_begin, (size_t)(copy_end - copy_begin));
+    }
+  }
+}
+
+} // namespace
+
 MPIAllreduce::MPIAllreduce(MPIContext* mpi_context, HorovodGlobalState* global_state)
     : AllreduceOp(global_state), mpi_context_(mpi_context) {}
 
 Status MPIAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& first_entry = entries[0];
 
+  // Every rank fuses the same entries, so all take the same path.
+  int64_t chunk_bytes = global_state_->mpi_allreduce_chunk_bytes;
+  if (entries.size() > 1 && chunk_bytes > 0 &&
+      NumElements(entries) * (int64_t)DataType_Size(first_entry.tensor->dtype()) >
+          chunk_bytes) {
+    return ExecutePipelined(entries, response);
+  }
+
   const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
@@ -57,7 +94,8 @@ Status MPIAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Respo
                          (int) num_elements,
                          mpi_context_->GetMPIDataType(first_entry.tensor),
                          mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
-                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+                         mpi_context_->GetProcessSetCommunicator(
+                             response.process_set_id()));
   if (op != MPI_SUCCESS) {
     throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
   }
@@ -78,12 +116,221 @@ Status MPIAllreduce::Execute(std::vector<TensorTableEntry>& entries, const Respo
   return Status::OK();
 }
 
+Status MPIAllreduce::ExecutePipelined(std::vector<TensorTableEntry>& entries,
+                                      const Response& response) {
+  auto& first_entry = entries[0];
+  int64_t num_elements = NumElements(entries);
+  auto element_size = (int64_t)DataType_Size(first_entry.tensor->dtype());
+  int64_t chunk_elements =
+      std::max(global_state_->mpi_allreduce_chunk_bytes / element_size, (int64_t)1);
+
+  // Entries that already form the fused buffer are reduced where they are.
+  bool in_place = EntriesAreContiguousInPlace(entries);
+  uint8_t* buffer_data;
+  if (in_place) {
+    buffer_data = (uint8_t*)first_entry.output->data();
+  } else {
+    auto buffer = global_state_->fusion_buffer.GetBuffer(
+        first_entry.device, first_entry.context->framework(), global_state_->fusion_buffer_index);
+    buffer_data = (uint8_t*)const_cast<void*>(buffer->AccessData(first_entry.context));
+  }
+
+  std::vector<int64_t> offsets(entries.size() + 1, 0);
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    offsets[ec + 1] = offsets[ec] + entries[ec].tensor->size();
+  }
+
+  auto dtype = mpi_context_->GetMPIDataType(first_entry.tensor);
+  auto sum_op = mpi_context_->GetMPISumOp(first_entry.tensor->dtype());
+  auto comm = mpi_context_->GetProcessSetCommunicator(response.process_set_id());
+  int64_t num_chunks = (num_elements + chunk_elements - 1) / chunk_elements;
+  std::vector<MPI_Request> requests(num_chunks, MPI_REQUEST_NULL);
+
+  auto& timeline = global_state_->timeline;
+  timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
+  for (int64_t i = 0; i <= num_chunks; ++i) {
+    if (i < num_chunks) {
+      int64_t begin = i * chunk_elements;
+      int64_t count = std::min(chunk_elements, num_elements - begin);
+      uint8_t* chunk_data = buffer_data + begin * element_size;
+      if (!in_place) {
+        MemcpyFusedRange(entries, offsets, begin * element_size,
+                         (begin + count) * element_size, buffer_data, true);
+      }
+      if (response.prescale_factor() != 1.0) {
+        ScaleBuffer(response.prescale_factor(), entries, chunk_data, chunk_data, count);
+      }
+      int op = MPI_Iallreduce(MPI_IN_PLACE, chunk_data, (int) count, dtype,
+                              sum_op, comm, &requests[i]);
+      if (op != MPI_SUCCESS) {
+        throw std::runtime_error("MPI_Iallreduce failed, see MPI output for details.");
+      }
+    }
+    if (i > 0) {
+      int64_t begin = (i - 1) * chunk_elements;
+      int64_t count = std::min(chunk_elements, num_elements - begin);
+      uint8_t* chunk_data = buffer_data + begin * element_size;
+      int op = MPI_Wait(&requests[i - 1], MPI_STATUS_IGNORE);
+      if (op != MPI_SUCCESS) {
+        throw std::runtime_error("MPI_Wait failed, see MPI output for details.");
+      }
+      if (response.postscale_factor() != 1.0) {
+        ScaleBuffer(response.postscale_factor(), entries, chunk_data, chunk_data, count);
+      }
+      if (!in_place) {
+        MemcpyFusedRange(entries, offsets, begin * element_size,
+                         (begin + count) * element_size, buffer_data, false);
+      }
+    }
+  }
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
 bool MPIAllreduce::Enabled(const ParameterManager& param_manager,
                            const std::vector<TensorTableEntry>& entries,
                            const Response& response) const {
   return true;
 }
 
+MPIHierarchicalAllreduce::MPIHierarchicalAllreduce(MPIContext* mpi_context,
+                                                   HorovodGlobalState* global_state)
+    : MPIAllreduce(mpi_context, global_state) {}
+
+Status MPIHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
+                                         const Response& response) {
+  auto& timeline = global_state_->timeline;
+  auto& first_entry = entries[0];
+  int local_size = global_state_->controller->GetLocalSize();
+  int local_rank = global_state_->controller->GetLocalRank();
+
+  int64_t num_elements = NumElements(entries);
+  int64_t element_size = mpi_context_->GetMPITypeSize(first_entry.tensor->dtype());
+  int64_t buffer_bytes = num_elements * element_size;
+
+  // Every local rank executes the same response, so all of them grow the
+  // window together.
+  if (segment_bytes_ < buffer_bytes) {
+    timeline.ActivityStartAll(entries, ALLOCATE_SHARED_BUFFER);
+    if (mpi_context_->allreduce_window != MPI_WIN_NULL) {
+      MPI_Win_free(&mpi_context_->allreduce_window);
+    }
+    // Doubling keeps reallocations rare.
+    int64_t segment_bytes = std::max(buffer_bytes, 2 * segment_bytes_);
+    void* base;
+    int op = MPI_Win_allocate_shared(
+        segment_bytes, 1, MPI_INFO_NULL,
+        mpi_context_->GetMPICommunicator(Communicator::LOCAL), &base,
+        &mpi_context_->allreduce_window);
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Win_allocate_shared failed, see MPI output for details.");
+    }
+    segments_.resize(local_size);
+    for (int i = 0; i < local_size; ++i) {
+      int disp_unit;
+      MPI_Aint winsize;
+      MPI_Win_shared_query(mpi_context_->allreduce_window, i, &winsize,
+                           &disp_unit, &segments_[i]);
+    }
+    PrepareHostMemory(segments_[local_rank], segment_bytes,
+                      global_state_->host_page_size, global_state_->host_prefault);
+    if (global_state_->host_prefault) {
+      // The other local ranks access the segment once it is faulted in.
+      MPI_Barrier(mpi_context_->GetMPICommunicator(Communicator::LOCAL));
+    }
+    segment_bytes_ = segment_bytes;
+    timeline.ActivityEndAll(entries);
+  }
+
+  std::vector<int64_t> offsets(entries.size() + 1, 0);
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    offsets[ec + 1] = offsets[ec] + entries[ec].tensor->size();
+  }
+
+  // Local rank i reduces and owns the elements [begin(i), begin(i + 1)).
+  int64_t chunk_elements = (num_elements + local_size - 1) / local_size;
+  auto chunk_begin = [&](int i) {
+    return std::min(i * chunk_elements, num_elements);
+  };
+
+  timeline.ActivityStartAll(entries, MEMCPY_IN_SHARED_BUFFER);
+  auto* segment = segments_[local_rank];
+  MemcpyFusedRange(entries, offsets, 0, buffer_bytes, segment, true);
+  if (response.prescale_factor() != 1.0) {
+    ScaleBuffer(response.prescale_factor(), entries, segment, segment, num_elements);
+  }
+  LocalBarrier();
+  timeline.ActivityEndAll(entries);
+
+  int64_t begin = chunk_begin(local_rank);
+  int64_t count = chunk_begin(local_rank + 1) - begin;
+  auto* chunk_data = segment + begin * element_size;
+  auto dtype = mpi_context_->GetMPIDataType(first_entry.tensor);
+  auto sum_op = mpi_context_->GetMPISumOp(first_entry.tensor->dtype());
+
+  // Starting at different peers spreads the reads over the segments.
+  timeline.ActivityStartAll(entries, SHARED_REDUCESCATTER);
+  for (int i = 1; i < local_size && count > 0; ++i) {
+    auto* peer_segment = segments_[(local_rank + i) % local_size];
+    int op = MPI_Reduce_local(peer_segment + begin * element_size, chunk_data,
+                              (int) count, dtype, sum_op);
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Reduce_local failed, see MPI output for details.");
+    }
+  }
+  timeline.ActivityEndAll(entries);
+
+  // The cluster is homogeneous, so the peers across nodes own the same chunk.
+  if (global_state_->controller->GetCrossSize() > 1 && count > 0) {
+    timeline.ActivityStartAll(entries, MPI_CROSS_ALLREDUCE);
+    int op = MPI_Allreduce(MPI_IN_PLACE, chunk_data, (int) count, dtype, sum_op,
+                           mpi_context_->GetMPICommunicator(Communicator::CROSS));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+    }
+    timeline.ActivityEndAll(entries);
+  }
+
+  if (response.postscale_factor() != 1.0 && count > 0) {
+    ScaleBuffer(response.postscale_factor(), entries, chunk_data, chunk_data, count);
+  }
+
+  timeline.ActivityStartAll(entries, MEMCPY_OUT_SHARED_BUFFER);
+  LocalBarrier();
+  for (int i = 0; i < local_size; ++i) {
+    MemcpyFusedRange(entries, offsets, chunk_begin(i) * element_size,
+                     chunk_begin(i + 1) * element_size, segments_[i], false);
+  }
+  // The segments are written again by the next allreduce.
+  LocalBarrier();
+  timeline.ActivityEndAll(entries);
+
+  return Status::OK();
+}
+
+bool MPIHierarchicalAllreduce::Enabled(const ParameterManager& param_manager,
+                                       const std::vector<TensorTableEntry>& entries,
+                                       const Response& response) const {
+  return entries[0].device == CPU_DEVICE_ID &&
+         param_manager.HierarchicalAllreduce() &&
+         global_state_->controller->IsHomogeneous();
+}
+
+bool MPIHierarchicalAllreduce::Supports(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return entries[0].device == CPU_DEVICE_ID &&
+         global_state_->controller->IsHomogeneous();
+}
+
+void MPIHierarchicalAllreduce::LocalBarrier() {
+  int op = MPI_Barrier(mpi_context_->GetMPICommunicator(Communicator::LOCAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Barrier failed, see MPI output for details.");
+  }
+}
+
 MPIAllgather::MPIAllgather(MPIContext* mpi_context, HorovodGlobalState* global_state)
     : AllgatherOp(global_state), mpi_context_(mpi_context) {}
 
@@ -96,36 +343,20 @@ bool MPIAllgather::Enabled(const ParameterManager& param_manager,
 Status MPIAllgather::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
+  // Sizes of subcomponents of each entry from all ranks, and offset of each
+  // subcomponent of every entry in the final buffer after allgatherv
   int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
 
   auto& first_entry = entries[0];
 
   timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
   Status status = AllocateOutput(entries, response, entry_component_sizes, recvcounts);
   if (!status.ok()) {
-    /* Cleanup */
-    for (size_t ec = 0; ec < entries.size(); ++ec) {
-      delete[] entry_component_sizes[ec];
-      delete[] entry_component_offsets[ec];
-    }   
-    delete[] entry_component_sizes;
-    delete[] entry_component_offsets;
-    delete[] recvcounts;
-    delete[] displcmnts;
     return status;
   }
   timeline.ActivityEndAll(entries);
@@ -170,16 +401,6 @@ Status MPIAllgather::Execute(std::vector<TensorTableEntry>& entries, const Respo
     timeline.ActivityEndAll(entries);
   }
 
-  delete[] recvcounts;
-  delete[] displcmnts;
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
-  }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
-
   return Status::OK();
 }
 
@@ -190,36 +411,20 @@ MPIHierarchicalAllgather::MPIHierarchicalAllgather(MPIContext* mpi_context,
 Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
   auto& timeline = global_state_->timeline;
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
-
+  // Sizes of subcomponents of each entry from all ranks, and offset of each
+  // subcomponent of every entry in the final buffer after allgatherv
   int global_size = global_state_->controller->GetSize();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
-
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
-  }
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
 
   auto& first_entry = entries[0];
 
   timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
   Status status = AllocateOutput(entries, response, entry_component_sizes, recvcounts);
   if (!status.ok()) {
-    /* Cleanup */
-    for (size_t ec = 0; ec < entries.size(); ++ec) {
-      delete[] entry_component_sizes[ec];
-      delete[] entry_component_offsets[ec];
-    }   
-    delete[] entry_component_sizes;
-    delete[] entry_component_offsets;
-    delete[] recvcounts;
-    delete[] displcmnts;
     return status;
   }
   timeline.ActivityEndAll(entries);
@@ -258,6 +463,14 @@ Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
                            &winsize,
                            &disp_unit,
                            &global_state_->shared_buffer);
+    } else {
+      PrepareHostMemory(global_state_->shared_buffer, total_size_in_bytes,
+                        global_state_->host_page_size,
+                        global_state_->host_prefault);
+    }
+    if (global_state_->host_prefault) {
+      // The other local ranks copy in once the window is faulted in.
+      Barrier();
     }
     global_state_->shared_buffer_size = total_size_in_bytes;
     timeline.ActivityEndAll(entries);
@@ -268,8 +481,10 @@ Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
   int cross_size = global_state_->controller->GetCrossSize();
   int local_size = global_state_->controller->GetLocalSize();
   int local_rank = global_state_->controller->GetLocalRank();
-  auto* cross_recvcounts = new int[cross_size]();
-  auto* cross_displcmnts = new int[cross_size]();
+  cross_recvcounts_.assign(cross_size, 0);
+  cross_displcmnts_.assign(cross_size, 0);
+  auto* cross_recvcounts = cross_recvcounts_.data();
+  auto* cross_displcmnts = cross_displcmnts_.data();
 
   if (global_state_->controller->IsHomogeneous()) {
     for (int i = 0; i < global_state_->controller->GetCrossSize(); ++i) {
@@ -331,10 +546,6 @@ Status MPIHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
   Barrier();
   timeline.ActivityEndAll(entries);
 
-  // Free the buffers
-  delete[] cross_displcmnts;
-  delete[] cross_recvcounts;
-
   return Status::OK();
 }
 
@@ -355,20 +566,26 @@ MPIBroadcast::MPIBroadcast(MPIContext* mpi_context, HorovodGlobalState* global_s
     : BroadcastOp(global_state), mpi_context_(mpi_context) {}
 
 Status MPIBroadcast::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& e = entries[0];
 
   // On root rank, MPI_Bcast sends data, on other ranks it receives data.
   void* data_ptr;
-  if (global_state_->controller->GetRank() == e.root_rank) {
+  size_t data_len;
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, data_ptr, data_len);
+    global_state_->timeline.ActivityEndAll(entries);
+  } else if (global_state_->controller->GetRank() == e.root_rank) {
     data_ptr = (void*) e.tensor->data();
+    data_len = (size_t) e.tensor->size();
   } else {
     data_ptr = (void*) e.output->data();
+    data_len = (size_t) e.tensor->size();
   }
 
   global_state_->timeline.ActivityStartAll(entries, MPI_BCAST);
   int op = MPI_Bcast(data_ptr,
-                     (int) e.tensor->shape().num_elements(),
+                     (int) (data_len / DataType_Size(e.tensor->dtype())),
                      mpi_context_->GetMPIDataType(e.tensor->dtype()),
                      e.root_rank,
                      mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
@@ -377,6 +594,12 @@ Status MPIBroadcast::Execute(std::vector<TensorTableEntry>& entries, const Respo
   }
   global_state_->timeline.ActivityEndAll(entries);
 
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(data_ptr, entries);
+    global_state_->timeline.ActivityEndAll(entries);
+  }
+
   return Status::OK();
 }
 
@@ -390,27 +613,24 @@ MPIAlltoall::MPIAlltoall(MPIContext* mpi_context, HorovodGlobalState* global_sta
     : AlltoallOp(global_state), mpi_context_(mpi_context) {}
 
 Status MPIAlltoall::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
-
-  std::vector<int32_t> sdispls, rdispls;
-  std::vector<int32_t> sendcounts, recvcounts;
-  Status status = PrepareOutputAndParams(e, sdispls, rdispls, sendcounts, recvcounts);
+  std::vector<AlltoallParams<int32_t>> params;
+  Status status = PrepareOutputAndParams(entries, params);
   if (!status.ok()) {
     return status;
   }
 
-  const void* sendbuf = e.tensor->data();
-  void* buffer_data = (void*) e.output->data();
   global_state_->timeline.ActivityStartAll(entries, MPI_ALLTOALL);
-
-  int op = MPI_Alltoallv(sendbuf, sendcounts.data(), sdispls.data(),
-                         mpi_context_->GetMPIDataType(e.tensor->dtype()),
-                         buffer_data, recvcounts.data(), rdispls.data(),
-                         mpi_context_->GetMPIDataType(e.output->dtype()),
-                         mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
-  if (op != MPI_SUCCESS) {
-    throw std::runtime_error("MPI_Alltoallv failed, see MPI output for details.");
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    auto& e = entries[ec];
+    auto& p = params[ec];
+    int op = MPI_Alltoallv(e.tensor->data(), p.sendcounts.data(), p.sdispls.data(),
+                           mpi_context_->GetMPIDataType(e.tensor->dtype()),
+                           (void*) e.output->data(), p.recvcounts.data(), p.rdispls.data(),
+                           mpi_context_->GetMPIDataType(e.output->dtype()),
+                           mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+    if (op != MPI_SUCCESS) {
+      throw std::runtime_error("MPI_Alltoallv failed, see MPI output for details.");
+    }
   }
   global_state_->timeline.ActivityEndAll(entries);
 
@@ -423,5 +643,60 @@ bool MPIAlltoall::Enabled(const ParameterManager& param_manager,
   return true;
 }
 
+MPIReducescatter::MPIReducescatter(MPIContext* mpi_context, HorovodGlobalState* global_state)
+    : ReducescatterOp(global_state), mpi_context_(mpi_context) {}
+
+Status MPIReducescatter::Execute(std::vector<TensorTableEntry>& entries, const Response& response) {
+  auto& first_entry = entries[0];
+
+  std::vector<int64_t> recvcounts;
+  global_state_->timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, recvcounts);
+  if (!status.ok()) {
+    return status;
+  }
+  global_state_->timeline.ActivityEndAll(entries);
+  std::vector<int> counts(recvcounts.begin(), recvcounts.end());
+
+  // Fused entries are reduced in place in the fusion buffer, which leaves the
+  // part of this rank at the start of the buffer.
+  const void* sendbuf;
+  void* buffer_data;
+  if (entries.size() > 1) {
+    size_t buffer_len;
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_IN_FUSION_BUFFER);
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    global_state_->timeline.ActivityEndAll(entries);
+    sendbuf = MPI_IN_PLACE;
+  } else {
+    sendbuf = first_entry.tensor->data();
+    buffer_data = (void*)first_entry.output->data();
+  }
+
+  global_state_->timeline.ActivityStartAll(entries, MPI_REDUCESCATTER);
+  int op = MPI_Reduce_scatter(sendbuf, buffer_data, counts.data(),
+                              mpi_context_->GetMPIDataType(first_entry.tensor),
+                              mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
+                              mpi_context_->GetMPICommunicator(Communicator::GLOBAL));
+  if (op != MPI_SUCCESS) {
+    throw std::runtime_error("MPI_Reduce_scatter failed, see MPI output for details.");
+  }
+  global_state_->timeline.ActivityEndAll(entries);
+
+  if (entries.size() > 1) {
+    global_state_->timeline.ActivityStartAll(entries, MEMCPY_OUT_FUSION_BUFFER);
+    MemcpyOutFusionBuffer(buffer_data, entries);
+    global_state_->timeline.ActivityEndAll(entries);
+  }
+
+  return Status::OK();
+}
+
+bool MPIReducescatter::Enabled(const ParameterManager& param_manager,
+                               const std::vector<TensorTableEntry>& entries,
+                               const Response& response) const {
+  return true;
+}
+
 } // namespace common
 } // namespace horovod
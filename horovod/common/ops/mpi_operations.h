@@ -42,10 +42,63 @@ public:
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
+  // Runs on the data communicator, apart from the negotiation.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return mpi_context_->SeparatesControl();
+  }
+
+  bool SupportsProcessSets() const override { return true; }
+
 protected:
+  // With HOROVOD_MPI_ALLREDUCE_CHUNK_MB, reduces fused entries in chunks with
+  // MPI_Iallreduce: chunk i+1 is copied into the fusion buffer and chunk i-1
+  // copied out of it while chunk i is reduced.
+  Status ExecutePipelined(std::vector<TensorTableEntry>& entries,
+                          const Response& response);
+
   MPIContext* mpi_context_;
 };
 
+// Allreduces CPU tensors through a shared memory window within every node.
+// Each local rank copies its input into its segment of the window and reduces
+// its chunk of all segments, the ranks with the same local rank allreduce
+// their chunk across nodes, and every rank copies the chunks out of the
+// segments of their owners.
+class MPIHierarchicalAllreduce : public MPIAllreduce {
+public:
+  MPIHierarchicalAllreduce(MPIContext* mpi_context, HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries, const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+  AllreduceAlgorithm Algorithm() const override {
+    return AllreduceAlgorithm::HIERARCHICAL;
+  }
+
+  bool Supports(const std::vector<TensorTableEntry>& entries,
+                const Response& response) const override;
+
+  // The node-local communicators are shared with the hierarchical
+  // negotiation.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return false;
+  }
+
+  bool SupportsProcessSets() const override { return false; }
+
+private:
+  void LocalBarrier();
+
+  // Segments of the local ranks in the window of the MPI context.
+  std::vector<uint8_t*> segments_;
+  int64_t segment_bytes_ = 0;
+};
+
 class MPIAllgather : public AllgatherOp {
 public:
   MPIAllgather(MPIContext* mpi_context, HorovodGlobalState* global_state);
@@ -56,6 +109,12 @@ public:
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
+  // Runs on the data communicator, apart from the negotiation.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return mpi_context_->SeparatesControl();
+  }
+
 protected:
   MPIContext* mpi_context_;
 };
@@ -70,8 +129,19 @@ public:
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
+  // The node-local communicators are shared with the hierarchical
+  // negotiation.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return false;
+  }
+
 private:
   void Barrier();
+
+  // Cross-node recvcounts and displacements, kept like allgather_layout_.
+  std::vector<int> cross_recvcounts_;
+  std::vector<int> cross_displcmnts_;
 };
 
 class MPIBroadcast : public BroadcastOp {
@@ -84,6 +154,12 @@ public:
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
+  // Runs on the data communicator, apart from the negotiation.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return mpi_context_->SeparatesControl();
+  }
+
 protected:
   MPIContext* mpi_context_;
 };
@@ -102,6 +178,26 @@ protected:
   MPIContext* mpi_context_;
 };
 
+class MPIReducescatter : public ReducescatterOp {
+public:
+  MPIReducescatter(MPIContext* mpi_context, HorovodGlobalState* global_state);
+
+  Status Execute(std::vector<TensorTableEntry>& entries, const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+  // Runs on the data communicator, apart from the negotiation.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return mpi_context_->SeparatesControl();
+  }
+
+protected:
+  MPIContext* mpi_context_;
+};
+
 } // namespace common
 } // namespace horovod
 
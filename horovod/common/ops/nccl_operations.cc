@@ -16,15 +16,41 @@
 // =============================================================================
 
 #include "nccl_operations.h"
-// fzh-alloc
-#include <sys/time.h>       // included for 'gettimeofday()'
-#include <time.h>           // included for 'localtime()'
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
 
 namespace horovod {
 namespace common {
 
-ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor) {
-  switch (tensor->dtype()) {
+// Ragged allgathers go around a ring unless the largest block times the
+// number of ring steps exceeds this many times the total size.
+#define RAGGED_ALLGATHER_RING_MAX_SKEW 2
+
+// The parts of a split group start at a multiple of this many bytes.
+#define NCCL_SPLIT_ALIGNMENT 256
+
+// Elements of the first part of a split group, in proportion to the blocks
+// of the two parts. 0 if the group is too small to be split.
+static int64_t SplitElements(int64_t num_elements, int64_t element_size,
+                             int block_num, int split_block_num) {
+  int64_t align = std::max((int64_t)NCCL_SPLIT_ALIGNMENT / element_size,
+                           (int64_t)1);
+  if (num_elements < 2 * align) {
+    return 0;
+  }
+  // NCCL picks the blocks of a group without block_num, the parts get half
+  // of the group each then.
+  double share = block_num > 0
+                     ? (double)block_num / (block_num + split_block_num)
+                     : 0.5;
+  int64_t elements = (int64_t)(num_elements * share) / align * align;
+  return std::min(std::max(elements, align), (num_elements - 1) / align * align);
+}
+
+ncclDataType_t GetNCCLDataType(DataType dtype) {
+  switch (dtype) {
     case HOROVOD_UINT8:
       return ncclUint8;
     case HOROVOD_INT8:
@@ -39,61 +65,444 @@ ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor) {
       return ncclFloat32;
     case HOROVOD_FLOAT64:
       return ncclFloat64;
+#if HAVE_CUDA && NCCL_VERSION_CODE >= NCCL_VERSION(2, 10, 0)
+    case HOROVOD_BFLOAT16:
+      return ncclBfloat16;
+#endif
     default:
-      throw std::logic_error("Type " + DataType_Name(tensor->dtype()) +
+      throw std::logic_error("Type " + DataType_Name(dtype) +
                              " is not supported in NCCL mode.");
   }
 }
 
+ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor) {
+  return GetNCCLDataType(tensor->dtype());
+}
+
+namespace {
+
+// Devices of the ranks of this node, the device map of LOCAL communicators.
+std::vector<int32_t> GetLocalDeviceMap(Controller& controller,
+                                       const Response& response) {
+  std::vector<int32_t> nccl_device_map;
+  nccl_device_map.reserve(controller.GetLocalCommRanks().size());
+  for (int rank : controller.GetLocalCommRanks()) {
+    nccl_device_map.push_back(response.devices()[rank]);
+  }
+  return nccl_device_map;
+}
+
+// Sets NCCL_ALGO and NCCL_PROTO to a tuning while communicators are set up,
+// and restores them afterwards. Does nothing without a tuning. ncclConfig_t
+// has no fields for them, unlike the channel cap and the traffic class, so
+// only the communicators of HOROVOD_LIBRA_NCCL_TUNINGS change the environment.
+class NCCLTuningEnvironment {
+public:
+  explicit NCCLTuningEnvironment(const NCCLTuning* tuning) {
+    if (tuning == nullptr) {
+      return;
+    }
+    Set("NCCL_ALGO", tuning->algorithm);
+    Set("NCCL_PROTO", tuning->protocol);
+  }
+
+  ~NCCLTuningEnvironment() {
+    for (auto& variable : saved_) {
+      if (variable.second.first) {
+        setenv(variable.first.c_str(), variable.second.second.c_str(), 1);
+      } else {
+        unsetenv(variable.first.c_str());
+      }
+    }
+  }
+
+private:
+  void Set(const std::string& name, const std::string& value) {
+    if (value.empty()) {
+      return;
+    }
+    auto previous = std::getenv(name.c_str());
+    saved_.emplace_back(name, std::make_pair(previous != nullptr,
+                                             previous != nullptr
+                                                 ? std::string(previous)
+                                                 : std::string()));
+    setenv(name.c_str(), value.c_str(), 1);
+  }
+
+  std::vector<std::pair<std::string, std::pair<bool, std::string>>> saved_;
+};
+
+} // namespace
+
+void NCCLLaunchBatch::Join(ncclComm_t& nccl_comm, int fusion_buffer_index,
+                           bool uses_fusion_buffer) {
+  if (uses_fusion_buffer) {
+    // The fusion buffer would be overwritten before the earlier allreduce
+    // ran.
+    if (fusion_buffers_.count(fusion_buffer_index) > 0) {
+      Flush();
+    }
+    fusion_buffers_.insert(fusion_buffer_index);
+  }
+  if (!group_open_) {
+    auto nccl_result = ncclGroupStart();
+    if (nccl_result != ncclSuccess) {
+      ncclCommAbort(nccl_comm);
+      throw std::logic_error(std::string("ncclGroupStart failed: ") +
+                             ncclGetErrorString(nccl_result));
+    }
+    group_open_ = true;
+    group_comm_ = nccl_comm;
+  }
+}
+
+void NCCLLaunchBatch::Defer(std::function<void(const Status&)> finish) {
+  deferred_.push_back(std::move(finish));
+}
+
+void NCCLLaunchBatch::Flush() {
+  if (!group_open_) {
+    return;
+  }
+  group_open_ = false;
+  fusion_buffers_.clear();
+  Status status = Status::OK();
+  auto nccl_result = ncclGroupEnd();
+  if (nccl_result != ncclSuccess) {
+    ncclCommAbort(group_comm_);
+    status = Status::UnknownError(std::string("ncclGroupEnd failed: ") +
+                                  ncclGetErrorString(nccl_result));
+  }
+  auto deferred = std::move(deferred_);
+  deferred_.clear();
+  for (auto& finish : deferred) {
+    finish(status);
+  }
+}
+
+void NCCLBufferRegistry::Register(ncclComm_t comm,
+                                  const FusionBufferManager& buffers,
+                                  const void* data) {
+  if (!enabled_ || comm == nullptr) {
+    return;
+  }
+#if defined(NCCL_REGISTRATION_SUPPORTED)
+  const void* base;
+  int64_t size;
+  if (!buffers.FindAllocation(data, base, size)) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto key = std::make_pair(comm, base);
+  if (handles_.count(key) > 0) {
+    return;
+  }
+  void* handle = nullptr;
+  auto nccl_result =
+      ncclCommRegister(comm, const_cast<void*>(base), (size_t)size, &handle);
+  if (nccl_result != ncclSuccess) {
+    LOG(WARNING) << "ncclCommRegister failed: "
+                 << ncclGetErrorString(nccl_result)
+                 << ", fusion buffers are not registered with NCCL.";
+    enabled_ = false;
+    return;
+  }
+  handles_[key] = handle;
+#else
+  LOG(WARNING) << HOROVOD_NCCL_REGISTER_BUFFERS
+               << " requires NCCL 2.19 or later, it is ignored.";
+  enabled_ = false;
+#endif
+}
+
+void NCCLBufferRegistry::Release(const void* base) {
+#if defined(NCCL_REGISTRATION_SUPPORTED)
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = handles_.begin(); it != handles_.end();) {
+    if (it->first.second == base) {
+      ncclCommDeregister(it->first.first, it->second);
+      it = handles_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+#endif
+}
+
+void NCCLBufferRegistry::Clear() {
+#if defined(NCCL_REGISTRATION_SUPPORTED)
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto& entry : handles_) {
+    ncclCommDeregister(entry.first.first, entry.second);
+  }
+  handles_.clear();
+#endif
+}
+
+void NCCLBufferRegistry::Drop(ncclComm_t comm) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = handles_.begin(); it != handles_.end();) {
+    if (it->first.first == comm) {
+      it = handles_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 void NCCLContext::ErrorCheck(std::string op_name, ncclResult_t nccl_result, ncclComm_t& nccl_comm) {
   if (nccl_result != ncclSuccess) {
-    ncclCommAbort(nccl_comm);
+    if (nccl_comm != nullptr) {
+      buffer_registry.Drop(nccl_comm);
+      ncclCommAbort(nccl_comm);
+      nccl_comm = nullptr;
+    }
     throw std::logic_error(std::string(op_name) + " failed: " + ncclGetErrorString(nccl_result));
   }
 }
 
 void NCCLContext::ShutDown(){
+  kernel_monitor.Stop();
+  buffer_registry.Clear();
   for(auto it = nccl_comms.begin(); it != nccl_comms.end(); ++it) {
     for (auto entry = it->begin(); entry != it->end(); ++entry) {
       ncclCommDestroy(entry->second);
     }
   }
   nccl_comms.clear();
+  for (auto& comms : nccl_cross_comms) {
+    for (auto& entry : comms) {
+      ncclCommDestroy(entry.second);
+    }
+  }
+  nccl_cross_comms.clear();
+  for (auto& comms : nccl_split_comms) {
+    for (auto& entry : comms) {
+      ncclCommDestroy(entry.second);
+    }
+  }
+  nccl_split_comms.clear();
+  for (auto& tuned_comms : nccl_tuned_comms) {
+    for (auto& comms : tuned_comms) {
+      for (auto& entry : comms) {
+        ncclCommDestroy(entry.second);
+      }
+    }
+  }
+  nccl_tuned_comms.clear();
+}
+
+std::vector<int32_t> NCCLDeviceMap(const Response& response) {
+  if (response.process_set_id() == 0) {
+    return response.devices();
+  }
+  auto nccl_device_map = response.devices();
+  nccl_device_map.push_back(-response.process_set_id());
+  return nccl_device_map;
 }
 
 void NCCLOpContext::InitNCCLComm(const std::vector<TensorTableEntry>& entries,
-                                 const std::vector<int32_t>& nccl_device_map) {
+                                 const std::vector<int32_t>& nccl_device_map,
+                                 int nccl_tuning, int32_t process_set_id) {
   // Ensure NCCL communicator is in the map before executing operation.
-  ncclComm_t& nccl_comm = nccl_context_->nccl_comms[global_state_->current_nccl_stream][nccl_device_map];
+  ncclComm_t& nccl_comm = Comms()[global_state_->current_nccl_stream][nccl_device_map];
   if (nccl_comm == nullptr) {
     auto& timeline = global_state_->timeline;
     timeline.ActivityStartAll(entries, INIT_NCCL);
+    InitNCCLComms(nccl_device_map, process_set_id);
+    timeline.ActivityEndAll(entries);
+  }
+
+  nccl_comm_ = &nccl_comm;
+  if (nccl_tuning > 0 && UsesTunedComms() &&
+      nccl_tuning <= (int)nccl_context_->nccl_tuned_comms.size()) {
+    nccl_comm_ = &nccl_context_->nccl_tuned_comms[nccl_tuning - 1]
+                                                 [global_state_->current_nccl_stream]
+                                                 [nccl_device_map];
+  }
+  nccl_split_comm_ =
+      UsesSplitComms()
+          ? &nccl_context_->nccl_split_comms[global_state_->current_nccl_stream]
+                                            [nccl_device_map]
+          : nullptr;
+}
 
-    int nccl_rank, nccl_size;
-    Communicator nccl_id_bcast_comm;
-    PopulateNCCLCommStrategy(nccl_rank, nccl_size, nccl_id_bcast_comm);
+void NCCLOpContext::InitNCCLComms(const std::vector<int32_t>& nccl_device_map,
+                                  int32_t process_set_id) {
+  // Every rank creates the same set of communicators here, since they are
+  // only ever created for the same device maps in the same order.
+  std::vector<ncclComm_t*> missing_comms;
+  std::vector<int> missing_streams;
+  // 0 for the communicators with the NCCL defaults, tunings come last.
+  std::vector<int> missing_tunings;
+  auto add_missing = [&](std::vector<std::unordered_map<std::vector<int32_t>,
+                                                       ncclComm_t>>& comms,
+                         int tuning) {
+    for (size_t stream = 0; stream < comms.size(); ++stream) {
+      ncclComm_t& nccl_comm = comms[stream][nccl_device_map];
+      if (nccl_comm == nullptr) {
+        missing_comms.push_back(&nccl_comm);
+        missing_streams.push_back((int)stream);
+        missing_tunings.push_back(tuning);
+      }
+    }
+  };
+  add_missing(Comms(), 0);
+  if (UsesSplitComms()) {
+    add_missing(nccl_context_->nccl_split_comms, 0);
+  }
+  if (UsesTunedComms()) {
+    auto& tuned_comms = nccl_context_->nccl_tuned_comms;
+    for (size_t tuning = 0; tuning < tuned_comms.size(); ++tuning) {
+      add_missing(tuned_comms[tuning], (int)tuning + 1);
+    }
+  }
+  if (missing_comms.empty()) {
+    return;
+  }
 
-    ncclUniqueId nccl_id;
-    if (nccl_rank == 0) {
-      nccl_context_->ErrorCheck("ncclGetUniqueId", ncclGetUniqueId(&nccl_id), nccl_comm);
+  int nccl_rank, nccl_size;
+  Communicator nccl_id_bcast_comm;
+  PopulateNCCLCommStrategy(nccl_rank, nccl_size, nccl_id_bcast_comm,
+                           process_set_id);
+
+  // One broadcast carries the IDs of the communicators of all streams.
+  std::vector<ncclUniqueId> nccl_ids(missing_comms.size());
+  if (nccl_rank == 0) {
+    for (size_t i = 0; i < nccl_ids.size(); ++i) {
+      nccl_context_->ErrorCheck("ncclGetUniqueId", ncclGetUniqueId(&nccl_ids[i]),
+                                *missing_comms[i]);
     }
+  }
 
-    global_state_->controller->Bcast((void*)&nccl_id, sizeof(nccl_id), 0,
-                                         nccl_id_bcast_comm);
+  if (process_set_id != 0) {
+    global_state_->controller->ProcessSetBcast(
+        (void*)nccl_ids.data(), nccl_ids.size() * sizeof(ncclUniqueId),
+        process_set_id);
+  } else {
+    global_state_->controller->Bcast((void*)nccl_ids.data(),
+                                     nccl_ids.size() * sizeof(ncclUniqueId), 0,
+                                     nccl_id_bcast_comm);
+  }
 
-    ncclComm_t new_nccl_comm;
-    auto nccl_result = ncclCommInitRank(&new_nccl_comm, nccl_size, nccl_id, nccl_rank);
-    nccl_context_->ErrorCheck("ncclCommInitRank", nccl_result, nccl_comm);
-    nccl_comm = new_nccl_comm;
+  // Initialize the communicators as a group, so that NCCL sets them up
+  // concurrently instead of one after the other. NCCL reads the algorithm
+  // and protocol from the environment when the group ends, so each tuning
+  // gets a group of its own.
+  std::vector<ncclComm_t> new_nccl_comms(missing_comms.size());
+  ncclComm_t failed_comm = nullptr;
+  auto& traffic_classes = nccl_context_->stream_traffic_classes;
+  size_t begin = 0;
+  while (begin < new_nccl_comms.size()) {
+    int tuning = missing_tunings[begin];
+    size_t end = begin;
+    while (end < new_nccl_comms.size() && missing_tunings[end] == tuning) {
+      ++end;
+    }
+#if HAVE_ROCM
+    // The cap stands in for the blocks of the groups, RCCL applies it to
+    // the channels of the communicator.
+    int max_channels = nccl_context_->rccl_max_channels;
+#else
+    int max_channels = 0;
+#endif
+    NCCLTuningEnvironment tuning_environment(
+        tuning > 0 ? &nccl_context_->nccl_tunings[tuning - 1] : nullptr);
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), failed_comm);
+    for (size_t i = begin; i < end; ++i) {
+#if NCCL_VERSION_CODE >= NCCL_VERSION(2, 17, 0)
+      if (!traffic_classes.empty() || max_channels > 0) {
+        ncclConfig_t config = NCCL_CONFIG_INITIALIZER;
+        if (max_channels > 0) {
+          config.maxCTAs = max_channels;
+        }
+#if NCCL_VERSION_CODE >= NCCL_VERSION(2, 22, 0)
+        if (!traffic_classes.empty()) {
+          config.trafficClass =
+              traffic_classes[missing_streams[i] % traffic_classes.size()];
+        }
+#else
+        if (!traffic_classes.empty() && i == 0) {
+          LOG(WARNING, global_state_->controller->GetRank())
+              << HOROVOD_NCCL_STREAM_TRAFFIC_CLASS
+              << " requires NCCL 2.22 or later, it is ignored.";
+        }
+#endif
+        auto nccl_result = ncclCommInitRankConfig(
+            &new_nccl_comms[i], nccl_size, nccl_ids[i], nccl_rank, &config);
+        nccl_context_->ErrorCheck("ncclCommInitRankConfig", nccl_result,
+                                  failed_comm);
+        continue;
+      }
+#else
+      if (!traffic_classes.empty() && i == 0) {
+        LOG(WARNING, global_state_->controller->GetRank())
+            << HOROVOD_NCCL_STREAM_TRAFFIC_CLASS
+            << " requires NCCL 2.22 or later, it is ignored.";
+      }
+      if (max_channels > 0 && i == 0) {
+        LOG(WARNING, global_state_->controller->GetRank())
+            << "The RCCL channel cap requires a communicator config, it is "
+               "ignored.";
+      }
+#endif
+      auto nccl_result = ncclCommInitRank(&new_nccl_comms[i], nccl_size,
+                                          nccl_ids[i], nccl_rank);
+      nccl_context_->ErrorCheck("ncclCommInitRank", nccl_result, failed_comm);
+    }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), failed_comm);
+    begin = end;
+  }
+  for (size_t i = 0; i < new_nccl_comms.size(); ++i) {
+    *missing_comms[i] = new_nccl_comms[i];
+  }
 
-    // Barrier helps NCCL to synchronize after initialization and avoid
-    // deadlock that we've been seeing without it.
+  // Barrier helps NCCL to synchronize after initialization and avoid
+  // deadlock that we've been seeing without it. The ranks outside a process
+  // set don't take part in creating its communicators.
+  if (process_set_id == 0) {
     global_state_->controller->Barrier(Communicator::GLOBAL);
+  }
+}
 
-    timeline.ActivityEndAll(entries);
+void NCCLOpContext::RegisterBuffer(const void* data) {
+  auto& registry = nccl_context_->buffer_registry;
+  if (!registry.IsEnabled()) {
+    return;
+  }
+  registry.Register(*nccl_comm_, global_state_->fusion_buffer, data);
+  if (nccl_split_comm_ != nullptr) {
+    registry.Register(*nccl_split_comm_, global_state_->fusion_buffer, data);
   }
+}
 
-  nccl_comm_ = &nccl_comm;
+bool NCCLOpContext::NCCLCommsInitialized(
+    const std::vector<int32_t>& nccl_device_map) const {
+  for (auto& nccl_comms : Comms()) {
+    auto it = nccl_comms.find(nccl_device_map);
+    if (it == nccl_comms.end() || it->second == nullptr) {
+      return false;
+    }
+  }
+  if (UsesSplitComms()) {
+    for (auto& nccl_comms : nccl_context_->nccl_split_comms) {
+      auto it = nccl_comms.find(nccl_device_map);
+      if (it == nccl_comms.end() || it->second == nullptr) {
+        return false;
+      }
+    }
+  }
+  if (UsesTunedComms()) {
+    for (auto& tuned_comms : nccl_context_->nccl_tuned_comms) {
+      for (auto& nccl_comms : tuned_comms) {
+        auto it = nccl_comms.find(nccl_device_map);
+        if (it == nccl_comms.end() || it->second == nullptr) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
 }
 
 void NCCLOpContext::AsyncErrorCheck() {
@@ -108,17 +517,36 @@ void NCCLOpContext::AsyncErrorCheck() {
     throw std::logic_error(std::string("NCCL async error: ") + ncclGetErrorString(nccl_async_err));
   }
 
+  if (nccl_split_comm_ != nullptr && *nccl_split_comm_ != nullptr) {
+    nccl_err = ncclCommGetAsyncError(*nccl_split_comm_, &nccl_async_err);
+    if (nccl_err != ncclSuccess) {
+      throw std::logic_error(std::string("ncclGetAsyncError failed: ") + ncclGetErrorString(nccl_err));
+    }
+    if (nccl_async_err != ncclSuccess) {
+      ncclCommAbort(*nccl_split_comm_);
+      throw std::logic_error(std::string("NCCL async error: ") + ncclGetErrorString(nccl_async_err));
+    }
+  }
 
 }
 
 void NCCLOpContext::PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
-                                             Communicator& nccl_id_bcast_comm) {
-  if (communicator_type_ == Communicator::GLOBAL) {
+                                             Communicator& nccl_id_bcast_comm,
+                                             int32_t process_set_id) {
+  if (process_set_id != 0) {
+    auto& process_sets = global_state_->controller->GetProcessSets();
+    nccl_rank = process_sets.RankInSet(process_set_id,
+                                       global_state_->controller->GetRank());
+    nccl_size = process_sets.Size(process_set_id);
+  } else if (communicator_type_ == Communicator::GLOBAL) {
     nccl_rank = global_state_->controller->GetRank();
     nccl_size = global_state_->controller->GetSize();
   } else if (communicator_type_ == Communicator::LOCAL) {
     nccl_rank = global_state_->controller->GetLocalRank();
     nccl_size = global_state_->controller->GetLocalSize();
+  } else if (communicator_type_ == Communicator::CROSS) {
+    nccl_rank = global_state_->controller->GetCrossRank();
+    nccl_size = global_state_->controller->GetCrossSize();
   } else {
     throw std::logic_error("Communicator type " + std::to_string(communicator_type_) +
                             " is not supported in NCCL mode.");
@@ -126,51 +554,86 @@ void NCCLOpContext::PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
   nccl_id_bcast_comm = communicator_type_;
 }
 
+std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>&
+NCCLOpContext::Comms() const {
+  return communicator_type_ == Communicator::CROSS
+             ? nccl_context_->nccl_cross_comms
+             : nccl_context_->nccl_comms;
+}
+
 Status NCCLAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
 
-  // fzh-alloc
+  // Position of the allreduce in the run, the groups of a step take
+  // fusion_group_num consecutive positions.
   static int first = 0;
-  bool para = false;
-  if(first == 0){
-    para = true;
-  }
   first++;
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  time_t sec = tv.tv_sec;
-  suseconds_t usec = tv.tv_usec;
-  struct tm *lt = localtime(&sec);
-  printf("the %d times excute allreduce: ",first);
-  printf("%d-%02d-%02d %02d:%02d:%02d.%03d\n", 
-            lt->tm_year + 1900,
-            lt->tm_mon + 1,
-            lt->tm_mday,
-            lt->tm_hour,
-            lt->tm_min,
-            lt->tm_sec,
-            (int)(usec / 1000));
-  
-  
+  LOG(TRACE, global_state_->controller->GetRank())
+      << "Executing allreduce " << first << " of "
+      << response.tensor_names().size() << " tensors.";
+
   auto& first_entry = entries[0];
   // LOG(INFO)<<"The fusion size is "<<response.tensor_names().size()<<" using stream "<<global_state_->stream_assignment[global_state_->current_gpu_stream];
   // std::string temp = "_stream";
   std::string tag = NCCL_ALLREDUCE;
   // temp += std::to_string(global_state_->stream_assignment[global_state_->current_gpu_stream]);
   gpu_op_context_.InitGPU(entries,true);
-  nccl_op_context_.InitNCCLComm(entries, response.devices());
+  nccl_op_context_.InitNCCLComm(entries, NCCLDeviceMap(response),
+                                response.nccl_tuning,
+                                response.process_set_id());
   gpu_op_context_.InitGPUQueue(entries, response ,true);
   // temp += std::to_string(global_state_->stream_index);
   // std::cout<<"the time is:"<<first<<" use "<<temp<<"\n";
-  
+
+  // A split group synchronizes two streams around its NCCL calls, so it is
+  // not batched.
+  bool split = response.split_block_num > 0;
+  if (split && nccl_op_context_.nccl_split_comm_ == nullptr) {
+    throw std::logic_error("Fusion group of " + first_entry.tensor_name +
+                           " is split, but HOROVOD_LIBRA_SPLIT_BLOCK_NUM is "
+                           "not set on this rank.");
+  }
+  auto& launch_batch = nccl_context_->launch_batch;
+  bool batched = launch_batch.Active() && !split;
+  if (batched) {
+    launch_batch.Join(*nccl_op_context_.nccl_comm_,
+                      global_state_->fusion_buffer_index, entries.size() > 1);
+  } else {
+    launch_batch.Flush();
+  }
+
+  // Events recorded for the timeline cannot be replayed from a graph, and the
+  // pack of double buffering runs on another stream. The norms and overflow
+  // flags of the entries are not part of the key of a graph.
+  if (global_state_->gpu_graphs && !split && !batched &&
+      !global_state_->fusion_double_buffering &&
+      !global_state_->timeline.Initialized() && !AccumulatesNorms(entries)) {
+    return ExecuteGraphed(entries, response);
+  }
 
   const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
 
-  // Copy memory into the fusion buffer.
+  // Position of the group in the step, for the timeline of its launches.
+  auto& timeline = global_state_->timeline;
+  int group = global_state_->fusion_group_num > 0
+                  ? (first - 1) % global_state_->fusion_group_num
+                  : 0;
+  int64_t group_bytes = 0;
+  for (auto& e : entries) {
+    group_bytes += e.tensor->size();
+  }
+
+  // Copy memory into the fusion buffer, prescaling it on the way.
   if (entries.size() > 1) {
-    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+    timeline.LaunchStart(MEMCPY_IN_FUSION_BUFFER, group, response.block_num,
+                         response.thread_num, global_state_->stream_index,
+                         group_bytes);
+    PipelinedMemcpyInFusionBuffer(entries, response, fused_input_data, buffer_data,
+                                  buffer_len);
+    timeline.LaunchEnd();
+    nccl_op_context_.RegisterBuffer(buffer_data);
 
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_IN_FUSION_BUFFER, *gpu_op_context_.stream);
@@ -186,70 +649,495 @@ Status NCCLAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     num_elements += e.tensor->shape().num_elements();
   }
 
-  if (response.prescale_factor() != 1.0) {
+  if (entries.size() == 1 && response.prescale_factor() != 1.0) {
     // Execute prescaling op
     ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
     fused_input_data = buffer_data; // for unfused, scale is done out of place
   }
 
-  // fzh-alloc
-  if(first%(global_state_->fusion_group_num) <= global_state_->fake_num && 
-  first%(global_state_->fusion_group_num) > 0 &&
-  first > global_state_->fake_num && 
-  global_state_->is_para){
-    std::cout<<"group num is "<<(global_state_->fusion_group_num)<<"\n";
-    int blocknum = 0,threadnum = 0;
-    if(global_state_->parallel_threadnum <= 512 ){
-      blocknum = 1;
-      threadnum = global_state_->parallel_threadnum - 1;
-    }
-    else{
-      blocknum = global_state_->parallel_threadnum/512;
-      threadnum = 511;
-    }
-    gpu_op_context_.InitNewStream(first);
-    auto nccl_fzh_result = ncclAllReduce(fused_input_data, buffer_data,
-                                   (size_t) num_elements,
-                                   GetNCCLDataType(first_entry.tensor), ncclSum,
-                                   *nccl_op_context_.nccl_comm_, *gpu_op_context_.new_stream,blocknum,threadnum);
-    nccl_context_->ErrorCheck("ncclAllReduce", nccl_fzh_result, *nccl_op_context_.nccl_comm_);
+  int64_t element_size = DataType_Size(FusionBufferDtype(entries));
+  int64_t split_elements =
+      split ? SplitElements(num_elements, element_size, response.block_num,
+                            response.split_block_num)
+            : 0;
+  if (split_elements > 0) {
+    LOG(TRACE, global_state_->controller->GetRank())
+        << "Splitting the allreduce of " << num_elements << " elements after "
+        << split_elements << " elements.";
+    auto nccl_dtype = GetNCCLDataType(FusionBufferDtype(entries));
+    gpu_op_context_.InitSplitStream(response);
+    auto& split_stream = *gpu_op_context_.split_stream;
+    // The second part reads what was copied into the fusion buffer on the
+    // stream of the group.
+    gpu_context_->StreamWaitStream(split_stream, *gpu_op_context_.stream);
+
+    timeline.AnnotateGroup(entries, NCCL_ALLREDUCE,
+                           {group, (int)entries.size(), group_bytes,
+                            response.block_num, response.thread_num,
+                            global_state_->stream_index});
+    timeline.LaunchStart(NCCL_ALLREDUCE, group, response.block_num,
+                         response.thread_num, global_state_->stream_index,
+                         split_elements * element_size);
+    nccl_context_->kernel_monitor.LaunchStart(response.tensor_names()[0],
+                                              response.block_num);
+    auto nccl_result = ncclAllReduce(fused_input_data, buffer_data,
+                                     (size_t) split_elements, nccl_dtype, ncclSum,
+                                     *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                     response.block_num, response.thread_num);
+    nccl_context_->kernel_monitor.LaunchEnd();
+    nccl_context_->kernel_monitor.MaybeFlush();
+    timeline.LaunchEnd();
+    nccl_context_->ErrorCheck("ncclAllReduce", nccl_result, *nccl_op_context_.nccl_comm_);
+
+    int64_t offset = split_elements * element_size;
+    timeline.LaunchStart(NCCL_ALLREDUCE, group, response.split_block_num,
+                         response.split_thread_num, global_state_->stream_index,
+                         (num_elements - split_elements) * element_size);
+    auto split_result = ncclAllReduce((const uint8_t*) fused_input_data + offset,
+                                      (uint8_t*) buffer_data + offset,
+                                      (size_t) (num_elements - split_elements),
+                                      nccl_dtype, ncclSum,
+                                      *nccl_op_context_.nccl_split_comm_, split_stream,
+                                      response.split_block_num, response.split_thread_num);
+    timeline.LaunchEnd();
+    nccl_context_->ErrorCheck("ncclAllReduce", split_result, *nccl_op_context_.nccl_split_comm_);
+
+    // The copy out of the fusion buffer and the completion of the group wait
+    // for both parts.
+    gpu_context_->StreamWaitStream(*gpu_op_context_.stream, split_stream);
     if (global_state_->timeline.Initialized()) {
-      gpu_context_->RecordEvent(gpu_op_context_.event_queue,"fake_allreduce", *gpu_op_context_.new_stream);
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLREDUCE, *gpu_op_context_.stream);
     }
+    return FinishAllreduce(entries, response, buffer_data, num_elements);
   }
-  else{
-      // Do allreduce.  
-      auto nccl_result = ncclAllReduce(fused_input_data, buffer_data,
-                                        (size_t) num_elements,
-                                        GetNCCLDataType(first_entry.tensor), ncclSum,
-                                        *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,response.block_num, response.thread_num);
-      
-      nccl_context_->ErrorCheck("ncclAllReduce", nccl_result, *nccl_op_context_.nccl_comm_);
+
+  // Do allreduce.
+  timeline.AnnotateGroup(entries, NCCL_ALLREDUCE,
+                         {group, (int)entries.size(), group_bytes,
+                          response.block_num, response.thread_num,
+                          global_state_->stream_index});
+  timeline.LaunchStart(NCCL_ALLREDUCE, group, response.block_num,
+                       response.thread_num, global_state_->stream_index,
+                       group_bytes);
+  nccl_context_->kernel_monitor.LaunchStart(response.tensor_names()[0],
+                                            response.block_num);
+  auto nccl_result = ncclAllReduce(fused_input_data, buffer_data,
+                                    (size_t) num_elements,
+                                    GetNCCLDataType(FusionBufferDtype(entries)), ncclSum,
+                                    *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,response.block_num, response.thread_num);
+  nccl_context_->kernel_monitor.LaunchEnd();
+  nccl_context_->kernel_monitor.MaybeFlush();
+  timeline.LaunchEnd();
+
+  nccl_context_->ErrorCheck("ncclAllReduce", nccl_result, *nccl_op_context_.nccl_comm_);
+  if (batched) {
+    // The rest runs on the stream and fusion buffer of this allreduce
+    // once the group ended. Later allreduces take the next ones.
+    auto op_context = gpu_op_context_;
+    gpu_op_context_.event_queue = {};
+    gpu_op_context_.scratch_buffers.clear();
+    int fusion_buffer_index = global_state_->fusion_buffer_index;
+    int nccl_stream = global_state_->current_nccl_stream;
+    global_state_->current_nccl_stream = (nccl_stream + 1) %
+                                         global_state_->num_nccl_streams;
+    auto batch_entries = entries;
+    launch_batch.Defer([this, batch_entries, response, buffer_data, num_elements,
+                        op_context, fusion_buffer_index,
+                        nccl_stream](const Status& status) mutable {
+      if (!status.ok()) {
+        for (auto& e : batch_entries) {
+          global_state_->timeline.End(e.tensor_name, nullptr);
+        }
+        InvokeCallbacks(batch_entries, status);
+        return;
+      }
+      std::swap(gpu_op_context_, op_context);
+      std::swap(global_state_->fusion_buffer_index, fusion_buffer_index);
+      std::swap(global_state_->current_nccl_stream, nccl_stream);
       if (global_state_->timeline.Initialized()) {
-        gpu_context_->RecordEvent(gpu_op_context_.event_queue,NCCL_ALLREDUCE, *gpu_op_context_.stream);
-        // if(first == 0 && global_state_->is_coordinator){
-        //   global_state_->thread_fzh = std::thread(&horovod::common::GPUContext::WaitForEventsFzh,gpu_context_,
-        //   std::ref(global_state_),
-        //   std::ref(nccl_op_context_.error_check_callback_));
-        // }
+        gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLREDUCE, *gpu_op_context_.stream);
       }
+      Status finish_status;
+      try {
+        finish_status = FinishAllreduce(batch_entries, response, buffer_data, num_elements);
+      } catch (const std::exception& ex) {
+        finish_status = Status::UnknownError(ex.what());
+      }
+      std::swap(global_state_->current_nccl_stream, nccl_stream);
+      std::swap(global_state_->fusion_buffer_index, fusion_buffer_index);
+      std::swap(gpu_op_context_, op_context);
+      if (!finish_status.in_progress()) {
+        for (auto& e : batch_entries) {
+          global_state_->timeline.End(e.tensor_name, finish_status.ok() ? e.output : nullptr);
+        }
+        InvokeCallbacks(batch_entries, finish_status);
+      }
+    });
+    return Status::InProgress();
   }
-  if (response.postscale_factor() != 1.0) {
+  if (global_state_->timeline.Initialized()) {
+    gpu_context_->RecordEvent(gpu_op_context_.event_queue,NCCL_ALLREDUCE, *gpu_op_context_.stream);
+  }
+  return FinishAllreduce(entries, response, buffer_data, num_elements);
+}
+
+Status NCCLAllreduce::FinishAllreduce(std::vector<TensorTableEntry>& entries,
+                                      const Response& response,
+                                      void* buffer_data, int64_t num_elements) {
+  MemcpyOutAllreduce(entries, response, buffer_data, num_elements);
+  return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
+}
+
+void NCCLAllreduce::MemcpyOutAllreduce(std::vector<TensorTableEntry>& entries,
+                                       const Response& response,
+                                       void* buffer_data, int64_t num_elements) {
+  // The squared norms are added up and the overflows looked for by the copy
+  // out of the fusion buffer, or by the postscaling of a single entry, which
+  // the copy then replaces.
+  if (AccumulatesNorms(entries)) {
+    NormMemcpyOutFusionBuffer(response.postscale_factor(), buffer_data, entries);
+    if (entries.size() > 1 && global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+    return;
+  }
+
+  if (entries.size() == 1 && response.postscale_factor() != 1.0) {
     // Execute postscaling op
     ScaleBuffer(response.postscale_factor(), entries, buffer_data, buffer_data, num_elements);
   }
 
-  // Copy memory out of the fusion buffer.
+  // Copy memory out of the fusion buffer, postscaling it on the way.
   if (entries.size() > 1) {
-    MemcpyOutFusionBuffer(buffer_data, entries);
+    ScaledMemcpyOutFusionBuffer(response.postscale_factor(), buffer_data, entries);
 
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
     }
   }
+}
+
+Status NCCLAllreduce::ExecuteGraphed(std::vector<TensorTableEntry>& entries,
+                                     const Response& response) {
+  auto key = GraphKey(entries, response);
+  auto& stream = *gpu_op_context_.stream;
+  bool capture;
+  auto graph = graph_cache_.Lookup(key, capture);
+  if (capture) {
+    // Registration allocates, which is not allowed while capturing.
+    if (entries.size() > 1) {
+      auto& first_entry = entries[0];
+      nccl_op_context_.RegisterBuffer(
+          global_state_->fusion_buffer
+              .GetBuffer(first_entry.device, first_entry.context->framework(),
+                         global_state_->fusion_buffer_index)
+              ->AccessData(first_entry.context));
+    }
+    gpu_context_->StreamBeginCapture(stream);
+    try {
+      EnqueueAllreduce(entries, response);
+    } catch (const std::exception& ex) {
+      gpu_context_->StreamEndCapture(stream);
+      return GraphFailed(ex);
+    }
+    graph = gpu_context_->StreamEndCapture(stream);
+    if (graph == nullptr) {
+      LOG(DEBUG, global_state_->controller->GetRank())
+          << "Could not capture the allreduce of " << entries.size()
+          << " tensors into a CUDA graph, it is launched without one.";
+    }
+    graph_cache_.Put(key, graph);
+  }
+
+  // Nothing ran during the capture.
+  try {
+    if (graph != nullptr) {
+      gpu_context_->GraphLaunch(graph, stream);
+    } else {
+      EnqueueAllreduce(entries, response);
+    }
+  } catch (const std::exception& ex) {
+    return GraphFailed(ex);
+  }
   return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
 }
 
+Status NCCLAllreduce::GraphFailed(const std::exception& ex) {
+  // The communicator may have been aborted and is created again by the next
+  // operation, the graphs captured with it cannot be replayed.
+  graph_cache_.Clear();
+  return Status::UnknownError(ex.what());
+}
+
+void NCCLAllreduce::EnqueueAllreduce(std::vector<TensorTableEntry>& entries,
+                                     const Response& response) {
+  auto& first_entry = entries[0];
+  const void* fused_input_data;
+  void* buffer_data;
+  size_t buffer_len;
+
+  if (entries.size() > 1) {
+    ScaledMemcpyInFusionBuffer(entries, response.prescale_factor(), fused_input_data,
+                               buffer_data, buffer_len);
+  } else {
+    fused_input_data = first_entry.tensor->data();
+    buffer_data = (void*) first_entry.output->data();
+    buffer_len = (size_t) first_entry.output->size();
+  }
+
+  int64_t num_elements = 0;
+  for (auto& e : entries) {
+    num_elements += e.tensor->shape().num_elements();
+  }
+
+  if (entries.size() == 1 && response.prescale_factor() != 1.0) {
+    ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
+    fused_input_data = buffer_data;
+  }
+
+  auto nccl_result = ncclAllReduce(fused_input_data, buffer_data,
+                                   (size_t) num_elements,
+                                   GetNCCLDataType(FusionBufferDtype(entries)), ncclSum,
+                                   *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                   response.block_num, response.thread_num);
+  nccl_context_->ErrorCheck("ncclAllReduce", nccl_result, *nccl_op_context_.nccl_comm_);
+
+  MemcpyOutAllreduce(entries, response, buffer_data, num_elements);
+}
+
+namespace {
+
+template <typename T>
+void AppendGraphKey(std::string& key, const T& value) {
+  key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+std::string NCCLAllreduce::GraphKey(const std::vector<TensorTableEntry>& entries,
+                                    const Response& response) {
+  auto& first_entry = entries[0];
+  std::string key;
+  key.reserve(64 + entries.size() * 3 * sizeof(int64_t));
+  AppendGraphKey(key, *gpu_op_context_.stream);
+  AppendGraphKey(key, *nccl_op_context_.nccl_comm_);
+  const void* fusion_buffer = nullptr;
+  if (entries.size() > 1) {
+    fusion_buffer = global_state_->fusion_buffer
+                        .GetBuffer(first_entry.device, first_entry.context->framework(),
+                                   global_state_->fusion_buffer_index)
+                        ->AccessData(first_entry.context);
+  }
+  AppendGraphKey(key, fusion_buffer);
+  AppendGraphKey(key, response.block_num);
+  AppendGraphKey(key, response.thread_num);
+  AppendGraphKey(key, response.prescale_factor());
+  AppendGraphKey(key, response.postscale_factor());
+  AppendGraphKey(key, first_entry.tensor->dtype());
+  for (auto& e : entries) {
+    AppendGraphKey(key, e.tensor->data());
+    AppendGraphKey(key, e.output->data());
+    AppendGraphKey(key, e.tensor->shape().num_elements());
+  }
+  return key;
+}
+
+Status NCCLTorusAllreduce::Execute(std::vector<TensorTableEntry>& entries,
+                                   const Response& response) {
+  auto& first_entry = entries[0];
+
+  gpu_op_context_.InitGPU(entries, true);
+  nccl_op_context_.InitNCCLComm(entries, LocalDeviceMap(response));
+  cross_nccl_op_context_.InitNCCLComm(entries, response.devices());
+  gpu_op_context_.InitGPUQueue(entries, response, true);
+
+  const void* fused_input_data;
+  void* buffer_data;
+  size_t buffer_len;
+
+  // Copy memory into the fusion buffer, prescaling it on the way.
+  if (entries.size() > 1) {
+    PipelinedMemcpyInFusionBuffer(entries, response, fused_input_data, buffer_data,
+                                  buffer_len);
+
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_IN_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  } else {
+    fused_input_data = first_entry.tensor->data();
+    buffer_data = (void*) first_entry.output->data();
+    buffer_len = (size_t) first_entry.output->size();
+  }
+
+  int64_t num_elements = 0;
+  for (auto& e : entries) {
+    num_elements += e.tensor->shape().num_elements();
+  }
+
+  if (entries.size() == 1 && response.prescale_factor() != 1.0) {
+    // Execute prescaling op
+    ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
+    fused_input_data = buffer_data; // for unfused, scale is done out of place
+  }
+
+  auto buffer_dtype = FusionBufferDtype(entries);
+  int element_size = DataType_Size(buffer_dtype);
+  int local_size = global_state_->controller->GetLocalSize();
+  int local_rank = global_state_->controller->GetLocalRank();
+
+  // Pad the fusion buffer like NCCLHierarchicalAllreduce, so that it divides
+  // by local_size.
+  if (entries.size() > 1) {
+    num_elements = PaddedNumElements(entries);
+    buffer_len = num_elements * element_size;
+  }
+
+  // The part divisible by local_size is reduce-scattered within the node,
+  // each shard is allreduced across nodes, and the shards are gathered
+  // within the node. The remainder is reduced at local rank local_size-1,
+  // allreduced across those ranks and broadcast within the node.
+  int64_t num_elements_per_rank = num_elements / local_size;
+  size_t buffer_len_per_rank = element_size * num_elements_per_rank;
+  void* buffer_data_at_rank_offset =
+      (uint8_t*)buffer_data + buffer_len_per_rank * local_rank;
+  int64_t num_elements_remaining = num_elements % local_size;
+  void* buffer_data_remainder =
+      (uint8_t*)buffer_data + buffer_len_per_rank * local_size;
+  void* fused_input_data_remainder =
+      (uint8_t*)fused_input_data + buffer_len_per_rank * local_size;
+  int root_rank = local_size - 1;
+  bool is_root_rank = local_rank == root_rank;
+  auto nccl_dtype = GetNCCLDataType(buffer_dtype);
+  auto& local_comm = *nccl_op_context_.nccl_comm_;
+  auto& cross_comm = *cross_nccl_op_context_.nccl_comm_;
+
+  if (num_elements_per_rank > 0) {
+    nccl_context_->ErrorCheck("ncclReduceScatter",
+                              ncclReduceScatter(fused_input_data,
+                                                buffer_data_at_rank_offset,
+                                                (size_t) num_elements_per_rank,
+                                                nccl_dtype, ncclSum, local_comm,
+                                                *gpu_op_context_.stream,
+                                                response.block_num, response.thread_num),
+                              local_comm);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_REDUCESCATTER, *gpu_op_context_.stream);
+    }
+  }
+
+  if (num_elements_remaining > 0) {
+    nccl_context_->ErrorCheck("ncclReduce",
+                              ncclReduce(fused_input_data_remainder,
+                                         buffer_data_remainder,
+                                         (size_t) num_elements_remaining,
+                                         nccl_dtype, ncclSum, root_rank, local_comm,
+                                         *gpu_op_context_.stream),
+                              local_comm);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_REDUCE, *gpu_op_context_.stream);
+    }
+  }
+
+  // The shard of the root rank is followed by the remainder, so both are
+  // reduced across nodes at once. All ranks of the cross communicator have
+  // the same local rank and the same count.
+  int64_t cross_num_elements =
+      num_elements_per_rank + (is_root_rank ? num_elements_remaining : 0);
+  if (cross_num_elements > 0) {
+    nccl_context_->ErrorCheck("ncclAllReduce",
+                              ncclAllReduce(buffer_data_at_rank_offset,
+                                            buffer_data_at_rank_offset,
+                                            (size_t) cross_num_elements,
+                                            nccl_dtype, ncclSum, cross_comm,
+                                            *gpu_op_context_.stream,
+                                            response.block_num, response.thread_num),
+                              cross_comm);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLREDUCE, *gpu_op_context_.stream);
+    }
+  }
+
+  if (num_elements_per_rank > 0) {
+    nccl_context_->ErrorCheck("ncclAllGather",
+                              ncclAllGather(buffer_data_at_rank_offset, buffer_data,
+                                            (size_t) num_elements_per_rank,
+                                            nccl_dtype, local_comm,
+                                            *gpu_op_context_.stream,
+                                            response.block_num, response.thread_num),
+                              local_comm);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER, *gpu_op_context_.stream);
+    }
+  }
+  if (num_elements_remaining > 0) {
+    nccl_context_->ErrorCheck("ncclBcast",
+                              ncclBcast(buffer_data_remainder,
+                                        (size_t) num_elements_remaining,
+                                        nccl_dtype, root_rank, local_comm,
+                                        *gpu_op_context_.stream,
+                                        response.block_num, response.thread_num),
+                              local_comm);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_BCAST, *gpu_op_context_.stream);
+    }
+  }
+
+  if (entries.size() == 1 && response.postscale_factor() != 1.0) {
+    // Execute postscaling op
+    ScaleBuffer(response.postscale_factor(), entries, buffer_data, buffer_data, num_elements);
+  }
+
+  // Copy memory out of the fusion buffer, postscaling it on the way.
+  if (entries.size() > 1) {
+    ScaledMemcpyOutFusionBuffer(response.postscale_factor(), buffer_data, entries);
+
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  }
+
+  // Errors of both communicators are checked while waiting.
+  auto local_error_check = nccl_op_context_.error_check_callback_;
+  auto cross_error_check = cross_nccl_op_context_.error_check_callback_;
+  return gpu_op_context_.FinalizeGPUQueue(entries, true,
+                                          [local_error_check, cross_error_check]() {
+                                            local_error_check();
+                                            cross_error_check();
+                                          });
+}
+
+int64_t NCCLTorusAllreduce::PaddedNumElements(
+    const std::vector<TensorTableEntry>& entries) const {
+  auto num_elements = AllreduceOp::PaddedNumElements(entries);
+  if (entries.size() > 1) {
+    int64_t div = global_state_->controller->GetLocalSize() * FUSION_BUFFER_ATOMIC_UNIT;
+    num_elements = ((num_elements + div - 1) / div) * div;
+  }
+  return num_elements;
+}
+
+bool NCCLTorusAllreduce::Enabled(const ParameterManager& param_manager,
+                                 const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const {
+  if (!NCCLAllreduce::Enabled(param_manager, entries, response)) {
+    return false;
+  }
+  return global_state_->torus_allreduce &&
+         global_state_->controller->IsHomogeneous();
+}
+
+bool NCCLTorusAllreduce::Supports(const std::vector<TensorTableEntry>& entries,
+                                  const Response& response) const {
+  return NCCLAllreduce::Enabled(global_state_->parameter_manager, entries,
+                                response) &&
+         global_state_->controller->IsHomogeneous();
+}
+
+std::vector<int32_t>
+NCCLTorusAllreduce::LocalDeviceMap(const Response& response) const {
+  return GetLocalDeviceMap(*global_state_->controller, response);
+}
+
 #if HAVE_MPI
 Status
 NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
@@ -264,17 +1152,20 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     nccl_device_map.push_back(response.devices()[rank]);
   }
 
-  gpu_op_context_.InitGPU(entries);
+  // Fusion groups are placed on the streams of their Libra allocation, like
+  // in NCCLAllreduce.
+  gpu_op_context_.InitGPU(entries, true);
   nccl_op_context_.InitNCCLComm(entries, nccl_device_map);
-  gpu_op_context_.InitGPUQueue(entries, response);
+  gpu_op_context_.InitGPUQueue(entries, response, true);
 
   const void* fused_input_data;
   void* buffer_data;
   size_t buffer_len;
 
-  // Copy memory into the fusion buffer.
+  // Copy memory into the fusion buffer, prescaling it on the way.
   if (entries.size() > 1) {
-    MemcpyInFusionBuffer(entries, fused_input_data, buffer_data, buffer_len);
+    PipelinedMemcpyInFusionBuffer(entries, response, fused_input_data, buffer_data,
+                                  buffer_len);
 
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_IN_FUSION_BUFFER, *gpu_op_context_.stream);
@@ -290,7 +1181,7 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
     num_elements += e.tensor->shape().num_elements();
   }
 
-  if (response.prescale_factor() != 1.0) {
+  if (entries.size() == 1 && response.prescale_factor() != 1.0) {
     // Execute prescaling op
     ScaleBuffer(response.prescale_factor(), entries, fused_input_data, buffer_data, num_elements);
     fused_input_data = buffer_data; // for unfused, scale is done out of place
@@ -306,10 +1197,7 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   // is divisible by local_size. This is always possible since we
   // set the fusion buffer size divisible by local_size.
   if (global_state_->controller->IsHomogeneous() && entries.size() > 1) {
-    // Making sure the number of elements is divisible by
-    // FUSION_BUFFER_ATOMIC_UNIT for improved performance
-    int div = local_size * FUSION_BUFFER_ATOMIC_UNIT;
-    num_elements = ((num_elements + div - 1) / div) * div;
+    num_elements = PaddedNumElements(entries);
     buffer_len = num_elements * element_size;
   }
 
@@ -358,12 +1246,63 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                                  : buffer_len_per_rank;
 
   auto& timeline = global_state_->timeline;
-  if (num_elements_per_rank > 0) {
+
+  // Copies from pinned memory are asynchronous, so the data staged through
+  // the host is split into chunks and each chunk is reduced across nodes as
+  // soon as it reached the host, while the later ones are still being
+  // copied. Copies from pageable memory are (effectively) synchronous, see
+  // https://docs.nvidia.com/cuda/cuda-runtime-api/
+  // api-sync-behavior.html#api-sync-behavior__memcpy-async
+  // CUDA-aware MPI reduces the chunks in device memory instead, without the
+  // copies, once the stream has reduced them within the node.
+  bool on_device = mpi_context_->ReducesOnDevice(first_entry.tensor->dtype());
+  bool pinned = global_state_->pinned_host_staging;
+  int64_t chunk_elements = std::max(total_num_elements, (int64_t)1);
+  int64_t chunk_bytes = global_state_->host_staging_chunk_bytes;
+  bool chunked = (pinned || on_device) && chunk_bytes > 0;
+  if (chunked) {
+    chunk_elements = std::max(chunk_bytes / element_size, (int64_t)1);
+  }
+
+  // The shard of every local rank is chunked the same way, and the root
+  // rank's remainder is chunked after it, so that the cross-node reductions
+  // of a chunk get the same size on every node. When shards span several
+  // chunks, the within-node reduction and gather run chunk by chunk too: the
+  // reduction of chunk i+1 and the gather of chunk i-1 run on the GPU while
+  // chunk i is reduced across nodes. Every local rank has the same shard size
+  // and takes the same decision; this needs all local ranks to stage through
+  // the host, so it is only done on homogeneous clusters.
+  std::vector<std::pair<int64_t, int64_t>> chunks;
+  if (!chunked) {
+    if (total_buffer_len > 0) {
+      chunks.emplace_back(0, total_buffer_len);
+    }
+  } else {
+    for (int64_t offset = 0; offset < num_elements_per_rank; offset += chunk_elements) {
+      chunks.emplace_back(offset * element_size,
+                          std::min(chunk_elements, num_elements_per_rank - offset) * element_size);
+    }
+  }
+  size_t shard_chunks = chunked ? chunks.size() : 0;
+  // On other clusters only the root rank stages through the host, so the
+  // other local ranks would never join the grouped calls of a chunk. They
+  // fall back to one ncclReduceScatter and one ncclAllGather of the shards.
+  bool pipelined = global_state_->controller->IsHomogeneous() &&
+                   num_elements_per_rank > 0 && shard_chunks > 1;
+  if (chunked && is_root_rank) {
+    for (int64_t offset = 0; offset < num_elements_remaining; offset += chunk_elements) {
+      chunks.emplace_back((num_elements_per_rank + offset) * element_size,
+                          std::min(chunk_elements, num_elements_remaining - offset) * element_size);
+    }
+  }
+
+  if (num_elements_per_rank > 0 && !pipelined) {
     auto nccl_result = ncclReduceScatter(fused_input_data,
                                          buffer_data_at_rank_offset,
                                          (size_t) num_elements_per_rank,
                                          GetNCCLDataType(first_entry.tensor),
-                                         ncclSum, *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
+                                         ncclSum, *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                         response.block_num, response.thread_num);
     nccl_context_->ErrorCheck("ncclReduceScatter", nccl_result, *nccl_op_context_.nccl_comm_);
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_REDUCESCATTER, *gpu_op_context_.stream);
@@ -385,45 +1324,130 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   }
 
   if (global_state_->controller->IsHomogeneous() || is_root_rank) {
-    // cudaHostAlloc is significantly slower than malloc.  Pre-allocating
-    // a buffer is not safe since the tensor can be arbitrarily large.
-    gpu_op_context_.host_buffer = malloc(total_buffer_len);
+    // cudaHostAlloc is significantly slower than malloc, so pinned buffers
+    // come from a pool that keeps them across operations.
+    if (on_device) {
+      // Reduced in place.
+    } else if (pinned) {
+      gpu_op_context_.pinned_host_buffer =
+          gpu_context_->pinned_host_buffers.Acquire(total_buffer_len);
+      gpu_op_context_.host_buffer = gpu_op_context_.pinned_host_buffer.get();
+    } else {
+      gpu_op_context_.host_buffer = malloc(total_buffer_len);
+    }
 
     // Synchronize.
     gpu_context_->WaitForEvents(gpu_op_context_.event_queue, entries, timeline, nccl_op_context_.error_check_callback_);
 
-    // According to https://docs.nvidia.com/cuda/cuda-runtime-api/
-    // api-sync-behavior.html#api-sync-behavior__memcpy-async,
-    // cudaMemcpyAsync is synchronous with respect to the host, so we
-    // memcpy (effectively) synchronously to generate an accurate timeline
-    timeline.ActivityStartAll(entries, MEMCPY_IN_HOST_BUFFER);
-    gpu_context_->MemcpyAsyncD2H(gpu_op_context_.host_buffer, buffer_data_at_rank_offset,
-                                 total_buffer_len, *gpu_op_context_.stream);
-    timeline.ActivityEndAll(entries);
+    std::vector<std::queue<std::pair<std::string, gpuEvent_t>>> chunk_events(
+        chunks.size());
+    // When pipelined, the copies of a chunk run on a staging stream, chained
+    // to the reduction and the gather of the chunk on the operation stream by
+    // events, so that they overlap the reductions and gathers of the others.
+    gpuStream_t* copy_stream = gpu_op_context_.stream;
+    if (pipelined) {
+      copy_stream = &gpu_context_->stream_pool.Lease(
+          GPUStreamPool::STAGING, global_state_->current_nccl_stream,
+          first_entry.device, global_state_->stream_index, response.priority());
+    }
+
+    if (!on_device) {
+      timeline.ActivityStartAll(entries, MEMCPY_IN_HOST_BUFFER);
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      int64_t offset = chunks[i].first;
+      int64_t len = chunks[i].second;
+      if (pipelined && i < shard_chunks) {
+        // The reduce-scatter of this chunk: each local rank reduces the
+        // chunk of its shard.
+        nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), *nccl_op_context_.nccl_comm_);
+        for (int rc = 0; rc < local_size; ++rc) {
+          int64_t shard_offset = rc * buffer_len_per_rank + offset;
+          nccl_context_->ErrorCheck("ncclReduce",
+                                    ncclReduce((const uint8_t*)fused_input_data + shard_offset,
+                                               (uint8_t*)buffer_data + shard_offset,
+                                               (size_t) (len / element_size),
+                                               GetNCCLDataType(first_entry.tensor), ncclSum, rc,
+                                               *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream),
+                                    *nccl_op_context_.nccl_comm_);
+        }
+        nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), *nccl_op_context_.nccl_comm_);
+      }
+      if (pipelined) {
+        gpu_context_->StreamWaitStream(*copy_stream, *gpu_op_context_.stream);
+      }
+      if (!on_device) {
+        gpu_context_->MemcpyAsyncD2H((uint8_t*)gpu_op_context_.host_buffer + offset,
+                                     (uint8_t*)buffer_data_at_rank_offset + offset,
+                                     len, *copy_stream);
+      }
+      gpu_context_->RecordEvent(chunk_events[i], "", *copy_stream);
+    }
+    if (!on_device) {
+      if (!chunks.empty()) {
+        gpu_context_->WaitForEvents(chunk_events[0], entries, timeline,
+                                    nccl_op_context_.error_check_callback_);
+      }
+      timeline.ActivityEndAll(entries);
+    }
 
     timeline.ActivityStartAll(entries, MPI_ALLREDUCE);
-    int op = MPI_Allreduce(MPI_IN_PLACE, gpu_op_context_.host_buffer,
-                           (int) total_num_elements,
-                           mpi_context_->GetMPIDataType(first_entry.tensor),
-                           mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
-                           mpi_context_->GetMPICommunicator(Communicator::CROSS));
-    if (op != MPI_SUCCESS) {
-      throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
-    }
-    timeline.ActivityEndAll(entries);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      int64_t offset = chunks[i].first;
+      int64_t len = chunks[i].second;
+      void* chunk_data =
+          on_device ? (uint8_t*)buffer_data_at_rank_offset + offset
+                    : (uint8_t*)gpu_op_context_.host_buffer + offset;
+      gpu_context_->WaitForEvents(chunk_events[i], entries, timeline,
+                                  nccl_op_context_.error_check_callback_);
+      int op = MPI_Allreduce(MPI_IN_PLACE, chunk_data,
+                             (int) (len / element_size),
+                             mpi_context_->GetMPIDataType(first_entry.tensor),
+                             mpi_context_->GetMPISumOp(first_entry.tensor->dtype()),
+                             mpi_context_->GetMPICommunicator(Communicator::CROSS));
+      if (op != MPI_SUCCESS) {
+        throw std::runtime_error("MPI_Allreduce failed, see MPI output for details.");
+      }
+      if (!on_device) {
+        gpu_context_->MemcpyAsyncH2D((uint8_t*)buffer_data_at_rank_offset + offset,
+                                     chunk_data, len, *copy_stream);
+      }
+      if (pipelined) {
+        gpu_context_->StreamWaitStream(*gpu_op_context_.stream, *copy_stream);
+      }
 
-    timeline.ActivityStartAll(entries, MEMCPY_OUT_HOST_BUFFER);
-    gpu_context_->MemcpyAsyncH2D(buffer_data_at_rank_offset, gpu_op_context_.host_buffer,
-                                 total_buffer_len, *gpu_op_context_.stream);
+      if (pipelined && i < shard_chunks) {
+        // The allgather of this chunk.
+        nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), *nccl_op_context_.nccl_comm_);
+        for (int rc = 0; rc < local_size; ++rc) {
+          void* shard_chunk = (uint8_t*)buffer_data + rc * buffer_len_per_rank + offset;
+          nccl_context_->ErrorCheck("ncclBroadcast",
+                                    ncclBroadcast(shard_chunk, shard_chunk, (size_t) len,
+                                                  ncclChar, rc, *nccl_op_context_.nccl_comm_,
+                                                  *gpu_op_context_.stream, response.block_num,
+                                                  response.thread_num),
+                                    *nccl_op_context_.nccl_comm_);
+        }
+        nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), *nccl_op_context_.nccl_comm_);
+      }
+    }
     timeline.ActivityEndAll(entries);
+    // The copies back to the device overlap the reductions, the timeline
+    // shows them until the last one completed.
+    if (!on_device && global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_HOST_BUFFER, *copy_stream);
+    }
+    if (pipelined && global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER, *gpu_op_context_.stream);
+    }
   }
-
-  if (num_elements_per_rank > 0) {
+  if (num_elements_per_rank > 0 && !pipelined) {
     nccl_context_->ErrorCheck("ncclAllGather",
                               ncclAllGather(buffer_data_at_rank_offset, buffer_data,
                                             (size_t) num_elements_per_rank,
                                             GetNCCLDataType(first_entry.tensor),
-                                            *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream),
+                                            *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                            response.block_num, response.thread_num),
                               *nccl_op_context_.nccl_comm_);
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER, *gpu_op_context_.stream);
@@ -434,21 +1458,22 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
                               ncclBcast(buffer_data_remainder,
                                         (size_t) num_elements_remaining,
                                         GetNCCLDataType(first_entry.tensor), root_rank,
-                                        *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream),
+                                        *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                        response.block_num, response.thread_num),
                               *nccl_op_context_.nccl_comm_);
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_BCAST, *gpu_op_context_.stream);
     }
   }
 
-  if (response.postscale_factor() != 1.0) {
+  if (entries.size() == 1 && response.postscale_factor() != 1.0) {
     // Execute postscaling op
     ScaleBuffer(response.postscale_factor(), entries, buffer_data, buffer_data, num_elements);
   }
 
-  // Copy memory out of the fusion buffer.
+  // Copy memory out of the fusion buffer, postscaling it on the way.
   if (entries.size() > 1) {
-    MemcpyOutFusionBuffer(buffer_data, entries);
+    ScaledMemcpyOutFusionBuffer(response.postscale_factor(), buffer_data, entries);
 
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
@@ -458,6 +1483,18 @@ NCCLHierarchicalAllreduce::Execute(std::vector<TensorTableEntry>& entries,
   return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
 }
 
+int64_t NCCLHierarchicalAllreduce::PaddedNumElements(
+    const std::vector<TensorTableEntry>& entries) const {
+  auto num_elements = AllreduceOp::PaddedNumElements(entries);
+  if (global_state_->controller->IsHomogeneous() && entries.size() > 1) {
+    // Making sure the number of elements is divisible by
+    // FUSION_BUFFER_ATOMIC_UNIT for improved performance
+    int64_t div = global_state_->controller->GetLocalSize() * FUSION_BUFFER_ATOMIC_UNIT;
+    num_elements = ((num_elements + div - 1) / div) * div;
+  }
+  return num_elements;
+}
+
 bool NCCLHierarchicalAllreduce::Enabled(const ParameterManager& param_manager,
                                         const std::vector<TensorTableEntry>& entries,
                                         const Response& response) const {
@@ -466,12 +1503,18 @@ bool NCCLHierarchicalAllreduce::Enabled(const ParameterManager& param_manager,
   }
   return param_manager.HierarchicalAllreduce();
 }
+
+bool NCCLHierarchicalAllreduce::Supports(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return NCCLAllreduce::Enabled(global_state_->parameter_manager, entries,
+                                response);
+}
 #endif
 
 Status NCCLBroadcast::Execute(std::vector<TensorTableEntry>& entries,
                               const Response& response) {
-  assert(entries.size() == 1);
-  auto e = entries[0];
+  auto& e = entries[0];
 
   gpu_op_context_.InitGPU(entries);
   nccl_op_context_.InitNCCLComm(entries, response.devices());
@@ -479,64 +1522,152 @@ Status NCCLBroadcast::Execute(std::vector<TensorTableEntry>& entries,
 
   // On root rank, ncclbcast sends data, on other ranks it receives data.
   void* data_ptr;
-  if (global_state_->controller->GetRank() == e.root_rank) {
+  size_t data_len;
+  if (entries.size() > 1) {
+    MemcpyInFusionBuffer(entries, data_ptr, data_len);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_IN_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  } else if (global_state_->controller->GetRank() == e.root_rank) {
     data_ptr = (void*) e.tensor->data();
+    data_len = (size_t) e.tensor->size();
   } else {
     data_ptr = (void*) e.output->data();
+    data_len = (size_t) e.tensor->size();
   }
 
   // We only use 'ncclChar' for this operation because the type format does not matter for a
   // broadcast, only the size of the data.
   nccl_context_->ErrorCheck("ncclBcast",
-                            ncclBcast(data_ptr,
-                                      e.tensor->shape().num_elements() *
-                                      DataType_Size(e.tensor->dtype()),
+                            ncclBcast(data_ptr, data_len,
                                       ncclChar, e.root_rank,
-                                      *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream),
+                                      *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                      response.block_num, response.thread_num),
                             *nccl_op_context_.nccl_comm_);
   if (global_state_->timeline.Initialized()) {
     gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_BCAST, *gpu_op_context_.stream);
   }
 
+  if (entries.size() > 1) {
+    MemcpyOutFusionBuffer(data_ptr, entries);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  }
+
   return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
 }
 
-Status NCCLAllgather::Execute(std::vector<TensorTableEntry>& entries,
-                                const Response& response) {
+Status NCCLReducescatter::Execute(std::vector<TensorTableEntry>& entries,
+                                  const Response& response) {
   auto& first_entry = entries[0];
 
   gpu_op_context_.InitGPU(entries);
   nccl_op_context_.InitNCCLComm(entries, response.devices());
   gpu_op_context_.InitGPUQueue(entries, response);
 
-  // Sizes of subcomponents of each entry from all ranks
-  auto** entry_component_sizes = new int64_t* [entries.size()];
-
-  // Offset of each subcomponent of every entry in the final buffer after
-  // allgatherv
-  auto** entry_component_offsets = new int64_t* [entries.size()];
+  std::vector<int64_t> recvcounts;
+  global_state_->timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, recvcounts);
+  if (!status.ok()) {
+    return status;
+  }
+  global_state_->timeline.ActivityEndAll(entries);
 
   int global_size = global_state_->controller->GetSize();
   int global_rank = global_state_->controller->GetRank();
-  auto* recvcounts = new int[global_size]();
-  auto* displcmnts = new int[global_size]();
+  size_t element_size = DataType_Size(first_entry.tensor->dtype());
+  std::vector<int64_t> displcmnts(global_size, 0);
+  for (int rc = 1; rc < global_size; ++rc) {
+    displcmnts[rc] = displcmnts[rc - 1] + recvcounts[rc - 1];
+  }
 
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    entry_component_sizes[ec] = new int64_t[global_size]();
-    entry_component_offsets[ec] = new int64_t[global_size]();
+  // Fused entries are reduced in place in the fusion buffer, each rank
+  // receiving its part at its own displacement.
+  const void* fused_input_data;
+  void* buffer_data;
+  if (entries.size() > 1) {
+    size_t buffer_len;
+    MemcpyInFusionBuffer(entries, buffer_data, buffer_len);
+    fused_input_data = buffer_data;
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_IN_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  } else {
+    fused_input_data = first_entry.tensor->data();
+    buffer_data = (void*) first_entry.output->data();
+  }
+  auto buffer_data_at_rank_offset = [&](int rc) {
+    return entries.size() > 1
+               ? (uint8_t*)buffer_data + displcmnts[rc] * element_size
+               : (uint8_t*)buffer_data;
+  };
+
+  bool even = std::all_of(recvcounts.begin(), recvcounts.end(),
+                          [&](int64_t count) { return count == recvcounts[0]; });
+  auto nccl_dtype = GetNCCLDataType(first_entry.tensor);
+  if (even) {
+    if (recvcounts[0] > 0) {
+      nccl_context_->ErrorCheck("ncclReduceScatter",
+                                ncclReduceScatter(fused_input_data,
+                                                  buffer_data_at_rank_offset(global_rank),
+                                                  (size_t) recvcounts[0], nccl_dtype, ncclSum,
+                                                  *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                                  response.block_num, response.thread_num),
+                                *nccl_op_context_.nccl_comm_);
+    }
+  } else {
+    // Parts of different sizes are reduced to their rank one by one, in a
+    // single group.
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), *nccl_op_context_.nccl_comm_);
+    for (int rc = 0; rc < global_size; ++rc) {
+      if (recvcounts[rc] == 0) {
+        continue;
+      }
+      nccl_context_->ErrorCheck("ncclReduce",
+                                ncclReduce((const uint8_t*)fused_input_data + displcmnts[rc] * element_size,
+                                           buffer_data_at_rank_offset(rc),
+                                           (size_t) recvcounts[rc], nccl_dtype, ncclSum, rc,
+                                           *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream),
+                                *nccl_op_context_.nccl_comm_);
+    }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), *nccl_op_context_.nccl_comm_);
+  }
+  if (global_state_->timeline.Initialized()) {
+    gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_REDUCESCATTER, *gpu_op_context_.stream);
   }
 
+  if (entries.size() > 1) {
+    MemcpyOutFusionBuffer(buffer_data_at_rank_offset(global_rank), entries);
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  }
+
+  return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
+}
+
+Status NCCLAllgather::Execute(std::vector<TensorTableEntry>& entries,
+                                const Response& response) {
+  auto& first_entry = entries[0];
+
+  gpu_op_context_.InitGPU(entries);
+  nccl_op_context_.InitNCCLComm(entries, response.devices());
+  gpu_op_context_.InitGPUQueue(entries, response);
+
+  // Sizes of subcomponents of each entry from all ranks, and offset of each
+  // subcomponent of every entry in the final buffer after allgatherv
+  int global_size = global_state_->controller->GetSize();
+  int global_rank = global_state_->controller->GetRank();
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
+
   global_state_->timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
   Status status = AllocateOutput(entries, response, entry_component_sizes, recvcounts);
   if (!status.ok()) {
-    for (size_t ec = 0; ec < entries.size(); ++ec) {
-      delete[] entry_component_sizes[ec];
-      delete[] entry_component_offsets[ec];
-    }   
-    delete[] entry_component_sizes;
-    delete[] entry_component_offsets;
-    delete[] recvcounts;
-    delete[] displcmnts;
     return status;
   }
   global_state_->timeline.ActivityEndAll(entries);
@@ -572,18 +1703,44 @@ Status NCCLAllgather::Execute(std::vector<TensorTableEntry>& entries,
     }
   }
 
+  // A ring moves (global_size - 1) times the largest block through every
+  // rank, the grouped broadcasts below the total size and one broadcast per
+  // rank. The ring is used unless one rank contributes much more than the
+  // others. Every rank has the same counts and takes the same decision.
+  bool ring = false;
+#ifdef NCCL_P2P_SUPPORTED
+  if (!same_shape && global_size > 2) {
+    int64_t max_count = 0;
+    int64_t total_count = 0;
+    for (int rc = 0; rc < global_size; ++rc) {
+      max_count = std::max(max_count, (int64_t)recvcounts[rc]);
+      total_count += recvcounts[rc];
+    }
+    ring = (global_size - 1) * max_count <= RAGGED_ALLGATHER_RING_MAX_SKEW * total_count;
+  }
+#endif
+
   // Do allgather.
   if (same_shape) {
     auto nccl_result = ncclAllGather(fused_input_data, buffer_data,
                                      recvcounts[0] * element_size,
                                      ncclChar,
-                                     *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
+                                     *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                     response.block_num, response.thread_num);
 
     nccl_context_->ErrorCheck("ncclAllGather", nccl_result, *nccl_op_context_.nccl_comm_);
 
     if (global_state_->timeline.Initialized()) {
       gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER, *gpu_op_context_.stream);
     }
+#ifdef NCCL_P2P_SUPPORTED
+  } else if (ring) {
+    RingAllgatherv(fused_input_data, buffer_data, recvcounts, displcmnts, element_size);
+
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER, *gpu_op_context_.stream);
+    }
+#endif
   } else {
     nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), *nccl_op_context_.nccl_comm_);
     for (int rc = 0; rc < global_size; ++rc) {
@@ -591,7 +1748,8 @@ Status NCCLAllgather::Execute(std::vector<TensorTableEntry>& entries,
       auto nccl_result = ncclBroadcast(fused_input_data, new_buffer_data,
                                        recvcounts[rc] * element_size,
                                        ncclChar, rc,
-                                       *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
+                                       *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream,
+                                       response.block_num, response.thread_num);
       nccl_context_->ErrorCheck("ncclBroadcast", nccl_result, *nccl_op_context_.nccl_comm_);
     }
     nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), *nccl_op_context_.nccl_comm_);
@@ -611,18 +1769,54 @@ Status NCCLAllgather::Execute(std::vector<TensorTableEntry>& entries,
     }
   }
 
-  delete[] recvcounts;
-  delete[] displcmnts;
+  return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
+}
 
-  for (size_t ec = 0; ec < entries.size(); ++ec) {
-    delete[] entry_component_sizes[ec];
-    delete[] entry_component_offsets[ec];
+#ifdef NCCL_P2P_SUPPORTED
+void NCCLAllgather::RingAllgatherv(const void* fused_input_data, void* buffer_data,
+                                   const int* recvcounts, const int* displcmnts,
+                                   size_t element_size) {
+  int global_size = global_state_->controller->GetSize();
+  int global_rank = global_state_->controller->GetRank();
+  int next = (global_rank + 1) % global_size;
+  int prev = (global_rank + global_size - 1) % global_size;
+  auto& stream = *gpu_op_context_.stream;
+
+  // The block of this rank is sent from the input, and copied to the output
+  // unless it was already copied into the fusion buffer.
+  void* own_block = (uint8_t*)buffer_data + displcmnts[global_rank] * element_size;
+  if (fused_input_data != own_block && recvcounts[global_rank] > 0) {
+    gpu_context_->MemcpyAsyncD2D(own_block, fused_input_data,
+                                 recvcounts[global_rank] * element_size, stream);
   }
-  delete[] entry_component_sizes;
-  delete[] entry_component_offsets;
 
-  return gpu_op_context_.FinalizeGPUQueue(entries, true, nccl_op_context_.error_check_callback_);
+  // Each step is its own group: the block sent in a step is the one received
+  // in the previous step, which the stream order guarantees.
+  for (int step = 0; step < global_size - 1; ++step) {
+    int send_block = (global_rank + global_size - step) % global_size;
+    int recv_block = (global_rank + global_size - step - 1) % global_size;
+    const void* send_data =
+        step == 0 ? fused_input_data
+                  : (uint8_t*)buffer_data + displcmnts[send_block] * element_size;
+    void* recv_data = (uint8_t*)buffer_data + displcmnts[recv_block] * element_size;
+
+    nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), *nccl_op_context_.nccl_comm_);
+    if (recvcounts[recv_block] > 0) {
+      nccl_context_->ErrorCheck("ncclRecv",
+                                ncclRecv(recv_data, recvcounts[recv_block] * element_size,
+                                         ncclChar, prev, *nccl_op_context_.nccl_comm_, stream),
+                                *nccl_op_context_.nccl_comm_);
+    }
+    if (recvcounts[send_block] > 0) {
+      nccl_context_->ErrorCheck("ncclSend",
+                                ncclSend(send_data, recvcounts[send_block] * element_size,
+                                         ncclChar, next, *nccl_op_context_.nccl_comm_, stream),
+                                *nccl_op_context_.nccl_comm_);
+    }
+    nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), *nccl_op_context_.nccl_comm_);
+  }
 }
+#endif
 
 bool NCCLAllgather::Enabled(const ParameterManager& param_manager,
                               const std::vector<TensorTableEntry>& entries,
@@ -630,42 +1824,187 @@ bool NCCLAllgather::Enabled(const ParameterManager& param_manager,
   return entries[0].device != CPU_DEVICE_ID;
 }
 
+Status NCCLHierarchicalAllgather::Execute(std::vector<TensorTableEntry>& entries,
+                                          const Response& response) {
+  auto& first_entry = entries[0];
+  auto& controller = global_state_->controller;
+
+  gpu_op_context_.InitGPU(entries);
+  nccl_op_context_.InitNCCLComm(entries, GetLocalDeviceMap(*controller, response));
+  cross_nccl_op_context_.InitNCCLComm(entries, response.devices());
+  gpu_op_context_.InitGPUQueue(entries, response);
+
+  int global_size = controller->GetSize();
+  int global_rank = controller->GetRank();
+  int local_size = controller->GetLocalSize();
+  int local_rank = controller->GetLocalRank();
+  int cross_size = controller->GetCrossSize();
+  allgather_layout_.Reset(entries.size(), global_size);
+  auto** entry_component_sizes = allgather_layout_.EntryComponentSizes();
+  auto** entry_component_offsets = allgather_layout_.EntryComponentOffsets();
+  auto* recvcounts = allgather_layout_.RecvCounts();
+  auto* displcmnts = allgather_layout_.Displacements();
+
+  global_state_->timeline.ActivityStartAll(entries, ALLOCATE_OUTPUT);
+  Status status = AllocateOutput(entries, response, entry_component_sizes, recvcounts);
+  if (!status.ok()) {
+    return status;
+  }
+  global_state_->timeline.ActivityEndAll(entries);
+
+  SetDisplacements(recvcounts, displcmnts);
+  SetEntryComponentOffsets(entries, entry_component_sizes, recvcounts, entry_component_offsets);
+
+  size_t element_size = DataType_Size(first_entry.tensor->dtype());
+
+  const void* fused_input_data;
+  void* buffer_data;
+
+  // Copy memory into the fusion buffer.
+  if (entries.size() > 1) {
+    MemcpyInFusionBuffer(entries, displcmnts, element_size, buffer_data);
+    fused_input_data = (uint8_t*)buffer_data + displcmnts[global_rank] * element_size;
+
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_IN_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  } else {
+    fused_input_data = first_entry.tensor->data();
+    buffer_data = (void*) first_entry.output->data();
+  }
+
+  // Every rank contributes a block of the same size. Ranks are placed node by
+  // node, so the block of local rank i of node n is block n * local_size + i,
+  // and the blocks of a node are contiguous.
+  size_t block_bytes = recvcounts[0] * element_size;
+  auto* output_data = (uint8_t*) buffer_data;
+
+  // Across nodes, the blocks of the ranks with this local rank are gathered
+  // in a scratch buffer, one per node, and copied to their place.
+  void* scratch_data;
+  status = gpu_op_context_.AllocateScratch(first_entry, cross_size * block_bytes,
+                                           &scratch_data);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto& cross_comm = *cross_nccl_op_context_.nccl_comm_;
+  auto nccl_result = ncclAllGather(fused_input_data, scratch_data, block_bytes,
+                                   ncclChar, cross_comm, *gpu_op_context_.stream,
+                                   response.block_num, response.thread_num);
+  nccl_context_->ErrorCheck("ncclAllGather", nccl_result, cross_comm);
+  for (int node = 0; node < cross_size; ++node) {
+    gpu_context_->MemcpyAsyncD2D(
+        output_data + displcmnts[node * local_size + local_rank] * element_size,
+        (uint8_t*) scratch_data + node * block_bytes, block_bytes,
+        *gpu_op_context_.stream);
+  }
+
+  // Within the node, the blocks of every node are gathered in place.
+  auto& local_comm = *nccl_op_context_.nccl_comm_;
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), local_comm);
+  for (int node = 0; node < cross_size; ++node) {
+    nccl_result = ncclAllGather(
+        output_data + displcmnts[node * local_size + local_rank] * element_size,
+        output_data + displcmnts[node * local_size] * element_size, block_bytes,
+        ncclChar, local_comm, *gpu_op_context_.stream, response.block_num,
+        response.thread_num);
+    nccl_context_->ErrorCheck("ncclAllGather", nccl_result, local_comm);
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), local_comm);
+
+  if (global_state_->timeline.Initialized()) {
+    gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLGATHER, *gpu_op_context_.stream);
+  }
+
+  // Copy memory out of the fusion buffer.
+  if (entries.size() > 1) {
+    MemcpyOutFusionBuffer(entry_component_offsets, entry_component_sizes,
+                          buffer_data, element_size, entries);
+
+    if (global_state_->timeline.Initialized()) {
+      gpu_context_->RecordEvent(gpu_op_context_.event_queue, MEMCPY_OUT_FUSION_BUFFER, *gpu_op_context_.stream);
+    }
+  }
+
+  // Errors of both communicators are checked while waiting.
+  auto local_error_check = nccl_op_context_.error_check_callback_;
+  auto cross_error_check = cross_nccl_op_context_.error_check_callback_;
+  return gpu_op_context_.FinalizeGPUQueue(entries, true,
+                                          [local_error_check, cross_error_check]() {
+                                            local_error_check();
+                                            cross_error_check();
+                                          });
+}
+
+bool NCCLHierarchicalAllgather::Enabled(const ParameterManager& param_manager,
+                                        const std::vector<TensorTableEntry>& entries,
+                                        const Response& response) const {
+  if (!NCCLAllgather::Enabled(param_manager, entries, response) ||
+      !param_manager.HierarchicalAllgather() ||
+      !global_state_->nccl_hierarchical_allgather) {
+    return false;
+  }
+  // The blocks of all ranks are gathered with NCCL Allgather, which needs
+  // them to be of the same size.
+  int global_size = global_state_->controller->GetSize();
+  const auto& tensor_sizes = response.tensor_sizes();
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    for (int rc = 1; rc < global_size; ++rc) {
+      if (tensor_sizes[ec * global_size + rc] != tensor_sizes[ec * global_size]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool NCCLHierarchicalAllgather::ExecutesWithoutController(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return nccl_op_context_.NCCLCommsInitialized(
+             GetLocalDeviceMap(*global_state_->controller, response)) &&
+         cross_nccl_op_context_.NCCLCommsInitialized(response.devices());
+}
+
 Status NCCLAlltoall::Execute(std::vector<TensorTableEntry>& entries,
                              const Response& response) {
 #ifdef NCCL_P2P_SUPPORTED
-  assert(entries.size() == 1);
-  auto e = entries[0];
-
   gpu_op_context_.InitGPU(entries);
   nccl_op_context_.InitNCCLComm(entries, response.devices());
   gpu_op_context_.InitGPUQueue(entries, response);
 
-  std::vector<int32_t> sdispls, rdispls;
-  std::vector<int32_t> sendcounts, recvcounts;
-  Status status = PrepareOutputAndParams(e, sdispls, rdispls, sendcounts, recvcounts);
+  std::vector<AlltoallParams<int32_t>> params;
+  Status status = global_state_->alltoall_device_splits
+                      ? PrepareOutputAndParamsOnDevice(entries, response, params)
+                      : PrepareOutputAndParams(entries, params);
   if (!status.ok()) {
     return status;
   }
 
   auto world_size = global_state_->controller->GetSize();
-  const void* sendbuf = e.tensor->data();
-  void* buffer_data = (void*) e.output->data();
 
+  // The sends and receives of all fused entries go into one group, NCCL
+  // aggregates those to the same peer.
   nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), *nccl_op_context_.nccl_comm_);
+  for (size_t ec = 0; ec < entries.size(); ++ec) {
+    auto& e = entries[ec];
+    auto& p = params[ec];
+    auto element_size = DataType_Size(e.tensor->dtype());
+    for (int i = 0; i < world_size; ++i) {
+      if (p.recvcounts[i] > 0) {
+        auto nccl_result = ncclRecv((uint8_t*) e.output->data() + p.rdispls[i] * element_size,
+                                    p.recvcounts[i] * element_size, ncclChar, i,
+                                    *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
+        nccl_context_->ErrorCheck("ncclRecv", nccl_result, *nccl_op_context_.nccl_comm_);
+      }
 
-  for (int i = 0; i < world_size; ++i) {
-    if (recvcounts[i] > 0) {
-      auto nccl_result = ncclRecv((uint8_t*) e.output->data() + rdispls[i] * DataType_Size(e.tensor->dtype()),
-                                  recvcounts[i] * DataType_Size(e.tensor->dtype()), ncclChar, i,
-                                  *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
-      nccl_context_->ErrorCheck("ncclRecv", nccl_result, *nccl_op_context_.nccl_comm_);
-    }
-
-    if (sendcounts[i] > 0) {
-      auto nccl_result = ncclSend((uint8_t*) e.tensor->data() + sdispls[i] * DataType_Size(e.tensor->dtype()),
-                             sendcounts[i] * DataType_Size(e.tensor->dtype()), ncclChar, i,
-                             *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
-      nccl_context_->ErrorCheck("ncclSend", nccl_result, *nccl_op_context_.nccl_comm_);
+      if (p.sendcounts[i] > 0) {
+        auto nccl_result = ncclSend((uint8_t*) e.tensor->data() + p.sdispls[i] * element_size,
+                                    p.sendcounts[i] * element_size, ncclChar, i,
+                                    *nccl_op_context_.nccl_comm_, *gpu_op_context_.stream);
+        nccl_context_->ErrorCheck("ncclSend", nccl_result, *nccl_op_context_.nccl_comm_);
+      }
     }
   }
   nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), *nccl_op_context_.nccl_comm_);
@@ -684,5 +2023,288 @@ Status NCCLAlltoall::Execute(std::vector<TensorTableEntry>& entries,
 #endif
 }
 
+Status NCCLAlltoall::PrepareOutputAndParamsOnDevice(
+    std::vector<TensorTableEntry>& entries, const Response& response,
+    std::vector<AlltoallParams<int32_t>>& params) {
+  auto& first_entry = entries[0];
+  int world_size = global_state_->controller->GetSize();
+  int rank = global_state_->controller->GetRank();
+  size_t num_entries = entries.size();
+
+  // Every rank contributes a row with the splits of each entry followed by
+  // the first dimension of its tensor, so that all ranks check the splits of
+  // every rank and fail alike.
+  size_t entry_stride = world_size + 1;
+  size_t row = num_entries * entry_stride;
+  size_t row_bytes = row * sizeof(int32_t);
+  void* buffer_data;
+  Status status = gpu_op_context_.AllocateScratch(
+      first_entry, row_bytes * (world_size + 1), &buffer_data);
+  if (!status.ok()) {
+    return status;
+  }
+  auto* gathered_data = (uint8_t*) buffer_data;
+  auto* row_data = gathered_data + row_bytes * world_size;
+
+  std::vector<int32_t> host_row(row, 0);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& e = entries[ec];
+    auto* entry_row = &host_row[ec * entry_stride];
+    std::copy(e.splits.begin(), e.splits.end(), entry_row);
+    entry_row[world_size] = (int32_t) e.tensor->shape().dim_size(0);
+  }
+  gpu_context_->MemcpyAsyncH2D(row_data, host_row.data(), row_bytes,
+                               *gpu_op_context_.stream);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& e = entries[ec];
+    if (e.device_splits != nullptr) {
+      gpu_context_->MemcpyAsyncD2D(row_data + ec * entry_stride * sizeof(int32_t),
+                                   e.device_splits->data(),
+                                   world_size * sizeof(int32_t),
+                                   *gpu_op_context_.stream);
+    }
+  }
+
+  auto& comm = *nccl_op_context_.nccl_comm_;
+  nccl_context_->ErrorCheck("ncclAllGather",
+                            ncclAllGather(row_data, gathered_data, row, ncclInt32,
+                                          comm, *gpu_op_context_.stream,
+                                          response.block_num, response.thread_num),
+                            comm);
+
+  // This thread waits for the splits instead of the framework.
+  std::vector<int32_t> gathered(row * world_size);
+  gpu_context_->MemcpyAsyncD2H(gathered.data(), gathered_data,
+                               row_bytes * world_size, *gpu_op_context_.stream);
+  gpu_context_->StreamSynchronize(*gpu_op_context_.stream);
+
+  for (int i = 0; i < world_size; ++i) {
+    for (size_t ec = 0; ec < num_entries; ++ec) {
+      auto* entry_row = &gathered[i * row + ec * entry_stride];
+      int64_t sum = std::accumulate(entry_row, entry_row + world_size, (int64_t) 0);
+      if (sum > entry_row[world_size]) {
+        return Status::InvalidArgument("Sum of splits entries is greater than the first dimension of tensor.");
+      }
+    }
+  }
+
+  std::vector<int32_t> recvsplits(world_size * num_entries);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& e = entries[ec];
+    auto* own_row = &gathered[rank * row + ec * entry_stride];
+    e.splits.assign(own_row, own_row + world_size);
+    for (int i = 0; i < world_size; ++i) {
+      recvsplits[i * num_entries + ec] = gathered[i * row + ec * entry_stride + rank];
+    }
+  }
+
+  params.resize(num_entries);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& p = params[ec];
+    status = PrepareEntryOutputAndParams(entries[ec], recvsplits, ec,
+                                         num_entries, p.sdispls, p.rdispls,
+                                         p.sendcounts, p.recvcounts);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::OK();
+}
+
+Status NCCLHierarchicalAlltoall::Execute(std::vector<TensorTableEntry>& entries,
+                                         const Response& response) {
+#ifdef NCCL_P2P_SUPPORTED
+  auto& first_entry = entries[0];
+  auto& controller = global_state_->controller;
+
+  gpu_op_context_.InitGPU(entries);
+  nccl_op_context_.InitNCCLComm(entries, GetLocalDeviceMap(*controller, response));
+  cross_nccl_op_context_.InitNCCLComm(entries, response.devices());
+  gpu_op_context_.InitGPUQueue(entries, response);
+
+  int world_size = controller->GetSize();
+  int local_size = controller->GetLocalSize();
+  int cross_size = controller->GetCrossSize();
+  int cross_rank = controller->GetCrossRank();
+  size_t num_entries = entries.size();
+
+  // Ranks are placed node by node, so rank node * local_size + i is local
+  // rank i of the node with cross rank node. Besides its split, a rank sends
+  // to each rank of its node its splits for the ranks with the same local
+  // rank as that one, one per node.
+  size_t entry_stride = 1 + cross_size;
+  size_t stride = num_entries * entry_stride;
+  std::vector<int32_t> splits(world_size * stride, 0);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& entry_splits = entries[ec].splits;
+    for (int i = 0; i < world_size; ++i) {
+      auto* slot = &splits[i * stride + ec * entry_stride];
+      slot[0] = entry_splits[i];
+      if (i / local_size == cross_rank) {
+        for (int node = 0; node < cross_size; ++node) {
+          slot[1 + node] = entry_splits[node * local_size + i % local_size];
+        }
+      }
+    }
+  }
+  std::vector<int32_t> recvsplits;
+  controller->AlltoallGetRecvSplits(splits, recvsplits);
+
+  std::vector<AlltoallParams<int64_t>> params(num_entries);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& p = params[ec];
+    Status status = PrepareEntryOutputAndParams(
+        entries[ec], recvsplits, ec * entry_stride, stride, p.sdispls,
+        p.rdispls, p.sendcounts, p.recvcounts);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  // Segment node * local_size + source is the data of local rank source of
+  // this node for the rank with this local rank on node. The segments for
+  // other nodes are gathered in a scratch buffer node by node, in the order
+  // of the output of the receiving rank, the ones for this node go straight
+  // to the output.
+  std::vector<std::vector<int64_t>> segment_bytes(num_entries);
+  std::vector<std::vector<int64_t>> segment_offsets(num_entries);
+  std::vector<std::vector<int64_t>> node_offsets(num_entries);
+  int64_t scratch_bytes = 0;
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& e = entries[ec];
+    auto& p = params[ec];
+    auto element_size = DataType_Size(e.tensor->dtype());
+    int64_t slice_num_elements = 1;
+    for (int i = 1; i < e.tensor->shape().dims(); ++i) {
+      slice_num_elements *= e.tensor->shape().dim_size(i);
+    }
+    segment_bytes[ec].resize(world_size);
+    segment_offsets[ec].resize(world_size);
+    node_offsets[ec].resize(cross_size + 1);
+    for (int node = 0; node < cross_size; ++node) {
+      node_offsets[ec][node] = scratch_bytes;
+      for (int source = 0; source < local_size; ++source) {
+        int64_t segment = node * local_size + source;
+        segment_bytes[ec][segment] =
+            recvsplits[(cross_rank * local_size + source) * stride +
+                       ec * entry_stride + 1 + node] *
+            slice_num_elements * element_size;
+        if (node == cross_rank) {
+          segment_offsets[ec][segment] =
+              p.rdispls[cross_rank * local_size + source] * element_size;
+        } else {
+          segment_offsets[ec][segment] = scratch_bytes;
+          scratch_bytes += segment_bytes[ec][segment];
+        }
+      }
+    }
+    node_offsets[ec][cross_size] = scratch_bytes;
+  }
+
+  uint8_t* scratch_data = nullptr;
+  if (scratch_bytes > 0) {
+    void* buffer_data;
+    Status status = gpu_op_context_.AllocateScratch(first_entry, scratch_bytes,
+                                                    &buffer_data);
+    if (!status.ok()) {
+      return status;
+    }
+    scratch_data = (uint8_t*) buffer_data;
+  }
+
+  // Exchange within the node. NCCL matches the sends and receives between
+  // two ranks in order, and both sides skip the same empty segments.
+  auto& local_comm = *nccl_op_context_.nccl_comm_;
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), local_comm);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& e = entries[ec];
+    auto& p = params[ec];
+    auto element_size = DataType_Size(e.tensor->dtype());
+    for (int peer = 0; peer < local_size; ++peer) {
+      for (int node = 0; node < cross_size; ++node) {
+        int64_t segment = node * local_size + peer;
+        if (segment_bytes[ec][segment] > 0) {
+          uint8_t* recv_data = node == cross_rank
+                                   ? (uint8_t*) e.output->data()
+                                   : scratch_data;
+          auto nccl_result = ncclRecv(recv_data + segment_offsets[ec][segment],
+                                      segment_bytes[ec][segment], ncclChar, peer,
+                                      local_comm, *gpu_op_context_.stream);
+          nccl_context_->ErrorCheck("ncclRecv", nccl_result, local_comm);
+        }
+
+        if (p.sendcounts[segment] > 0) {
+          auto nccl_result = ncclSend((uint8_t*) e.tensor->data() + p.sdispls[segment] * element_size,
+                                      p.sendcounts[segment] * element_size, ncclChar, peer,
+                                      local_comm, *gpu_op_context_.stream);
+          nccl_context_->ErrorCheck("ncclSend", nccl_result, local_comm);
+        }
+      }
+    }
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), local_comm);
+
+  // Exchange across nodes, one message per node and entry. The data from a
+  // node is ordered by source rank, like the output.
+  auto& cross_comm = *cross_nccl_op_context_.nccl_comm_;
+  nccl_context_->ErrorCheck("ncclGroupStart", ncclGroupStart(), cross_comm);
+  for (size_t ec = 0; ec < num_entries; ++ec) {
+    auto& e = entries[ec];
+    auto& p = params[ec];
+    auto element_size = DataType_Size(e.tensor->dtype());
+    for (int node = 0; node < cross_size; ++node) {
+      if (node == cross_rank) {
+        continue;
+      }
+      int64_t recv_count = 0;
+      for (int source = 0; source < local_size; ++source) {
+        recv_count += p.recvcounts[node * local_size + source];
+      }
+      if (recv_count > 0) {
+        auto nccl_result = ncclRecv((uint8_t*) e.output->data() + p.rdispls[node * local_size] * element_size,
+                                    recv_count * element_size, ncclChar, node,
+                                    cross_comm, *gpu_op_context_.stream);
+        nccl_context_->ErrorCheck("ncclRecv", nccl_result, cross_comm);
+      }
+
+      int64_t send_bytes = node_offsets[ec][node + 1] - node_offsets[ec][node];
+      if (send_bytes > 0) {
+        auto nccl_result = ncclSend(scratch_data + node_offsets[ec][node],
+                                    send_bytes, ncclChar, node,
+                                    cross_comm, *gpu_op_context_.stream);
+        nccl_context_->ErrorCheck("ncclSend", nccl_result, cross_comm);
+      }
+    }
+  }
+  nccl_context_->ErrorCheck("ncclGroupEnd", ncclGroupEnd(), cross_comm);
+
+  if (global_state_->timeline.Initialized()) {
+    gpu_context_->RecordEvent(gpu_op_context_.event_queue, NCCL_ALLTOALL, *gpu_op_context_.stream);
+  }
+
+  // Errors of both communicators are checked while waiting.
+  auto local_error_check = nccl_op_context_.error_check_callback_;
+  auto cross_error_check = cross_nccl_op_context_.error_check_callback_;
+  return gpu_op_context_.FinalizeGPUQueue(entries, true,
+                                          [local_error_check, cross_error_check]() {
+                                            local_error_check();
+                                            cross_error_check();
+                                          });
+#else
+  throw std::runtime_error("NCCLHierarchicalAlltoall requires NCCL version >= 2.7.0.");
+#endif
+}
+
+bool NCCLHierarchicalAlltoall::Enabled(const ParameterManager& param_manager,
+                                       const std::vector<TensorTableEntry>& entries,
+                                       const Response& response) const {
+  if (!NCCLAlltoall::Enabled(param_manager, entries, response)) {
+    return false;
+  }
+  // The node stages are sized by splits exchanged through the controller.
+  return global_state_->hierarchical_alltoall &&
+         !global_state_->alltoall_device_splits;
+}
+
 } // namespace common
 } // namespace horovod
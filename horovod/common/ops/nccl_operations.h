@@ -23,26 +23,185 @@
 #if NCCL_VERSION_CODE >= NCCL_VERSION(2, 7, 0)
 #define NCCL_P2P_SUPPORTED
 #endif
+#if NCCL_VERSION_CODE >= NCCL_VERSION(2, 9, 6) && CUDART_VERSION >= 11040
+#define NCCL_GRAPH_SUPPORTED
+#endif
+#if NCCL_VERSION_CODE >= NCCL_VERSION(2, 19, 0)
+#define NCCL_REGISTRATION_SUPPORTED
+#endif
 #elif HAVE_ROCM
 #include <rccl.h>
+
+// RCCL has no per-call counts of blocks and threads, the collectives run on
+// the channels of their communicator. These take the Libra arguments and
+// ignore them, NCCLContext::rccl_max_channels caps the channels instead.
+inline ncclResult_t ncclAllReduce(const void* sendbuff, void* recvbuff,
+                                  size_t count, ncclDataType_t datatype,
+                                  ncclRedOp_t op, ncclComm_t comm,
+                                  hipStream_t stream, int block_num,
+                                  int thread_num) {
+  return ncclAllReduce(sendbuff, recvbuff, count, datatype, op, comm, stream);
+}
+
+inline ncclResult_t ncclReduceScatter(const void* sendbuff, void* recvbuff,
+                                      size_t recvcount, ncclDataType_t datatype,
+                                      ncclRedOp_t op, ncclComm_t comm,
+                                      hipStream_t stream, int block_num,
+                                      int thread_num) {
+  return ncclReduceScatter(sendbuff, recvbuff, recvcount, datatype, op, comm,
+                           stream);
+}
+
+inline ncclResult_t ncclAllGather(const void* sendbuff, void* recvbuff,
+                                  size_t sendcount, ncclDataType_t datatype,
+                                  ncclComm_t comm, hipStream_t stream,
+                                  int block_num, int thread_num) {
+  return ncclAllGather(sendbuff, recvbuff, sendcount, datatype, comm, stream);
+}
+
+inline ncclResult_t ncclBcast(void* buff, size_t count, ncclDataType_t datatype,
+                              int root, ncclComm_t comm, hipStream_t stream,
+                              int block_num, int thread_num) {
+  return ncclBcast(buff, count, datatype, root, comm, stream);
+}
+
+inline ncclResult_t ncclBroadcast(const void* sendbuff, void* recvbuff,
+                                  size_t count, ncclDataType_t datatype,
+                                  int root, ncclComm_t comm,
+                                  hipStream_t stream, int block_num,
+                                  int thread_num) {
+  return ncclBroadcast(sendbuff, recvbuff, count, datatype, root, comm, stream);
+}
 #endif
 
 #if HAVE_MPI
 #include "../mpi/mpi_context.h"
 #endif
 
+#include "cupti_monitor.h"
 #include "gpu_operations.h"
 
 #include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_set>
 
 namespace horovod {
 namespace common {
 
+ncclDataType_t GetNCCLDataType(DataType dtype);
+
 ncclDataType_t GetNCCLDataType(const std::shared_ptr<Tensor> tensor);
 
+// The key of the communicators of a response: its devices, followed by minus
+// the ID of its process set for the responses of process sets.
+std::vector<int32_t> NCCLDeviceMap(const Response& response);
+
+// Launches the NCCL calls of the allreduces of one cycle under one NCCL
+// group. NCCL defers the calls until the group ends, so the stream work that
+// follows them in an allreduce is deferred until then too.
+class NCCLLaunchBatch {
+public:
+  // Lets allreduces join the batch until Stop.
+  void Start() { active_ = true; }
+
+  bool Active() const { return active_; }
+
+  // Opens the group for an allreduce on the communicator. The batch is
+  // flushed first if it holds an allreduce using the same fusion buffer.
+  void Join(ncclComm_t& nccl_comm, int fusion_buffer_index,
+            bool uses_fusion_buffer);
+
+  // Runs finish once the group ended, with the error if it failed.
+  void Defer(std::function<void(const Status&)> finish);
+
+  // Ends the group and runs the deferred work.
+  void Flush();
+
+  void Stop() {
+    Flush();
+    active_ = false;
+  }
+
+private:
+  bool active_ = false;
+  bool group_open_ = false;
+  ncclComm_t group_comm_ = nullptr;
+  std::unordered_set<int> fusion_buffers_;
+  std::vector<std::function<void(const Status&)>> deferred_;
+};
+
+// Registrations of the fusion buffers with the communicators that reduce
+// them, with HOROVOD_NCCL_REGISTER_BUFFERS, so that NCCL can use NVLS and
+// zero-copy network transfers on them. Whole allocations are registered, the
+// first time a communicator reduces a buffer out of them.
+class NCCLBufferRegistry {
+public:
+  void SetEnabled(bool value) { enabled_ = value; }
+  bool IsEnabled() const { return enabled_; }
+
+  // Registers the allocation of buffers that holds data with the
+  // communicator, if not done yet. Does nothing for data outside of them.
+  void Register(ncclComm_t comm, const FusionBufferManager& buffers,
+                const void* data);
+
+  // Deregisters an allocation from every communicator before it is freed.
+  void Release(const void* base);
+
+  // Deregisters everything before the communicators are destroyed.
+  void Clear();
+
+  // Forgets the registrations of a communicator that was aborted.
+  void Drop(ncclComm_t comm);
+
+private:
+  bool enabled_ = false;
+  std::mutex mutex_;
+  std::map<std::pair<ncclComm_t, const void*>, void*> handles_;
+};
+
 struct NCCLContext {
   std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> nccl_comms;
 
+  // Communicators of the ranks with the same local rank, by the global
+  // device map.
+  std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> nccl_cross_comms;
+
+  // Communicators of the second parts of split groups, with
+  // HOROVOD_LIBRA_SPLIT_BLOCK_NUM. The two parts run at the same time, so
+  // they cannot share a communicator. Empty unless groups are split.
+  std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>> nccl_split_comms;
+
+  // HOROVOD_LIBRA_NCCL_TUNINGS, and the communicators set up with the
+  // algorithm and protocol of each, by tuning and stream. The Libra plan picks
+  // them for the fusion groups it assigns a tuning to.
+  std::vector<NCCLTuning> nccl_tunings;
+  std::vector<std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>>
+      nccl_tuned_comms;
+
+  // InfiniBand traffic class of the communicators of each stream, cycled
+  // over the streams, with HOROVOD_NCCL_STREAM_TRAFFIC_CLASS. Empty for the
+  // NCCL default.
+  std::vector<int> stream_traffic_classes;
+
+#if HAVE_ROCM
+  // Channels of the communicators, the CU budget of a fusion group, with
+  // HOROVOD_RCCL_MAX_CHANNELS. 0 for the RCCL default.
+  int rccl_max_channels = 0;
+#endif
+
+  // Batch of the allreduces of the current cycle, with
+  // HOROVOD_NCCL_GROUP_LAUNCH.
+  NCCLLaunchBatch launch_batch;
+
+  // Measures the NCCL kernels of the fusion groups on the coordinator, with
+  // HOROVOD_LIBRA_KERNEL_FEEDBACK.
+  CuptiKernelMonitor kernel_monitor;
+
+  NCCLBufferRegistry buffer_registry;
+
+  // Aborts nccl_comm and throws if nccl_result is an error. nccl_comm is reset
+  // to null, so that the next operation creates the communicator again.
   void ErrorCheck(std::string op_name, ncclResult_t nccl_result, ncclComm_t& nccl_comm);
 
   void ShutDown();
@@ -52,23 +211,58 @@ class NCCLOpContext {
 public:
   NCCLOpContext(NCCLContext* nccl_context, HorovodGlobalState* global_state,
                 horovod::common::Communicator communicator_type)
-      : nccl_comm_(nullptr),
+      : nccl_comm_(nullptr), nccl_split_comm_(nullptr),
         error_check_callback_(std::bind(&NCCLOpContext::AsyncErrorCheck, this)),
         nccl_context_(nccl_context),
         global_state_(global_state),
         communicator_type_(communicator_type){};
 
+  // nccl_tuning selects the communicators of a Libra NCCL tuning, for the
+  // global communicator only. With a process set, the communicators span the
+  // ranks of the set instead of all ranks.
   void InitNCCLComm(const std::vector<TensorTableEntry>& entries,
-                    const std::vector<int32_t>& nccl_device_map);
+                    const std::vector<int32_t>& nccl_device_map,
+                    int nccl_tuning = 0, int32_t process_set_id = 0);
+
+  // Creates the missing communicators of the device map on every stream at
+  // once. Must be called by all ranks of the communicator.
+  void InitNCCLComms(const std::vector<int32_t>& nccl_device_map,
+                     int32_t process_set_id = 0);
+
+  // Returns true if the communicators of the device map exist on every
+  // stream, so that InitNCCLComm does not go through the controller.
+  bool NCCLCommsInitialized(const std::vector<int32_t>& nccl_device_map) const;
 
   void AsyncErrorCheck();
 
+  // Registers the fusion buffer that holds data with the communicators of
+  // the operation, with HOROVOD_NCCL_REGISTER_BUFFERS.
+  void RegisterBuffer(const void* data);
+
   ncclComm_t* nccl_comm_;
+  // Communicator for the second part of a split group, nullptr unless
+  // groups are split.
+  ncclComm_t* nccl_split_comm_;
   std::function<void()> error_check_callback_;
 
 private:
   void PopulateNCCLCommStrategy(int& nccl_rank, int& nccl_size,
-                                Communicator& nccl_id_bcast_comm);
+                                Communicator& nccl_id_bcast_comm,
+                                int32_t process_set_id);
+
+  std::vector<std::unordered_map<std::vector<int32_t>, ncclComm_t>>& Comms() const;
+
+  // The split communicators are created along with the global ones.
+  bool UsesSplitComms() const {
+    return communicator_type_ == Communicator::GLOBAL &&
+           !nccl_context_->nccl_split_comms.empty();
+  }
+
+  // So are the communicators of the NCCL tunings.
+  bool UsesTunedComms() const {
+    return communicator_type_ == Communicator::GLOBAL &&
+           !nccl_context_->nccl_tuned_comms.empty();
+  }
 
   NCCLContext* nccl_context_;
   HorovodGlobalState* global_state_;
@@ -88,10 +282,59 @@ public:
   Status Execute(std::vector<TensorTableEntry>& entries,
                  const Response& response) override;
 
+  bool WaitsForReadyEventsOnDevice() const override { return true; }
+
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return nccl_op_context_.NCCLCommsInitialized(NCCLDeviceMap(response));
+  }
+
+  // Communicators are not created within a group.
+  bool JoinsLaunchBatch(const std::vector<TensorTableEntry>& entries,
+                        const Response& response) const override {
+    return nccl_context_->launch_batch.Active() &&
+           nccl_op_context_.NCCLCommsInitialized(NCCLDeviceMap(response));
+  }
+
+  bool SupportsProcessSets() const override { return true; }
+
 protected:
+  bool CompressesFusionBuffer() const override { return true; }
+
+  // The stream work of the allreduce after the NCCL call.
+  Status FinishAllreduce(std::vector<TensorTableEntry>& entries,
+                         const Response& response, void* buffer_data,
+                         int64_t num_elements);
+
+  // The copy out of the fusion buffer and the postscaling.
+  void MemcpyOutAllreduce(std::vector<TensorTableEntry>& entries,
+                          const Response& response, void* buffer_data,
+                          int64_t num_elements);
+
   NCCLContext* nccl_context_;
   NCCLOpContext nccl_op_context_;
   HorovodGlobalState* global_state_;
+
+private:
+  // With HOROVOD_CUDA_GRAPHS, replays the stream work of a group from a graph
+  // once the group was performed GPU_GRAPH_WARMUP_USES times with the same
+  // tensors. The waits for the ready events stay outside of the graph.
+  Status ExecuteGraphed(std::vector<TensorTableEntry>& entries,
+                        const Response& response);
+
+  // Drops the captured graphs after a failure and returns its error.
+  Status GraphFailed(const std::exception& ex);
+
+  // Enqueues the stream work of an allreduce, without timeline events.
+  void EnqueueAllreduce(std::vector<TensorTableEntry>& entries,
+                        const Response& response);
+
+  // Everything the enqueued work depends on: the stream, communicator, fusion
+  // buffer, Libra launch configuration, scale factors and tensors.
+  std::string GraphKey(const std::vector<TensorTableEntry>& entries,
+                       const Response& response);
+
+  GPUGraphCache graph_cache_;
 };
 
 class NCCLBroadcast : public GPUBroadcast {
@@ -106,6 +349,38 @@ public:
   Status Execute(std::vector<TensorTableEntry>& entries,
                  const Response& response) override;
 
+  bool WaitsForReadyEventsOnDevice() const override { return true; }
+
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return nccl_op_context_.NCCLCommsInitialized(response.devices());
+  }
+
+protected:
+  NCCLContext* nccl_context_;
+  NCCLOpContext nccl_op_context_;
+  HorovodGlobalState* global_state_;
+};
+
+class NCCLReducescatter : public GPUReducescatter {
+public:
+  NCCLReducescatter(NCCLContext* nccl_context, GPUContext* gpu_context,
+                    HorovodGlobalState* global_state)
+      : GPUReducescatter(gpu_context, global_state),
+        nccl_context_(nccl_context),
+        nccl_op_context_(nccl_context, global_state, Communicator::GLOBAL),
+        global_state_(global_state){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool WaitsForReadyEventsOnDevice() const override { return true; }
+
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return nccl_op_context_.NCCLCommsInitialized(response.devices());
+  }
+
 protected:
   NCCLContext* nccl_context_;
   NCCLOpContext nccl_op_context_;
@@ -115,19 +390,100 @@ protected:
 class NCCLAlltoall : public GPUAlltoall {
 public:
   NCCLAlltoall(NCCLContext* nccl_context, GPUContext* gpu_context,
-               HorovodGlobalState* global_state)
+               HorovodGlobalState* global_state,
+               horovod::common::Communicator communicator_type = Communicator::GLOBAL)
       : GPUAlltoall(gpu_context, global_state),
         nccl_context_(nccl_context),
-        nccl_op_context_(nccl_context, global_state, Communicator::GLOBAL),
+        nccl_op_context_(nccl_context, global_state, communicator_type),
         global_state_(global_state){};
 
   Status Execute(std::vector<TensorTableEntry>& entries,
                  const Response& response) override;
 
+  bool WaitsForReadyEventsOnDevice() const override { return true; }
+
 protected:
   NCCLContext* nccl_context_;
   NCCLOpContext nccl_op_context_;
   HorovodGlobalState* global_state_;
+
+private:
+  // Like PrepareOutputAndParams, with the splits allgathered on the stream of
+  // the operation instead of exchanged through the controller.
+  Status PrepareOutputAndParamsOnDevice(std::vector<TensorTableEntry>& entries,
+                                        const Response& response,
+                                        std::vector<AlltoallParams<int32_t>>& params);
+};
+
+// Alltoall in two stages for ranks placed node by node. Within the node,
+// every rank gathers the data of the node for the ranks with its local rank,
+// then sends it with one message per node across nodes, between the ranks
+// with the same local rank.
+class NCCLHierarchicalAlltoall : public NCCLAlltoall {
+public:
+  NCCLHierarchicalAlltoall(NCCLContext* nccl_context, GPUContext* gpu_context,
+                           HorovodGlobalState* global_state)
+      : NCCLAlltoall(nccl_context, gpu_context, global_state, Communicator::LOCAL),
+        cross_nccl_op_context_(nccl_context, global_state, Communicator::CROSS){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+private:
+  NCCLOpContext cross_nccl_op_context_;
+};
+
+// Hierarchical allreduce that stays on the GPU: NCCL ReduceScatter within the
+// node, NCCL Allreduce across nodes between the ranks with the same local
+// rank, and NCCL Allgather within the node. Requires a homogeneous cluster.
+class NCCLTorusAllreduce : public NCCLAllreduce {
+public:
+  NCCLTorusAllreduce(NCCLContext* nccl_context, GPUContext* gpu_context,
+                     HorovodGlobalState* global_state)
+      : NCCLAllreduce(nccl_context, gpu_context, global_state, Communicator::LOCAL),
+        cross_nccl_op_context_(nccl_context, global_state, Communicator::CROSS){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+  AllreduceAlgorithm Algorithm() const override {
+    return AllreduceAlgorithm::TORUS;
+  }
+
+  bool Supports(const std::vector<TensorTableEntry>& entries,
+                const Response& response) const override;
+
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return nccl_op_context_.NCCLCommsInitialized(LocalDeviceMap(response)) &&
+           cross_nccl_op_context_.NCCLCommsInitialized(response.devices());
+  }
+
+  bool JoinsLaunchBatch(const std::vector<TensorTableEntry>& entries,
+                        const Response& response) const override {
+    return false;
+  }
+
+  bool SupportsProcessSets() const override { return false; }
+
+protected:
+  // Fused entries are padded to a multiple of
+  // local_size * FUSION_BUFFER_ATOMIC_UNIT.
+  int64_t
+  PaddedNumElements(const std::vector<TensorTableEntry>& entries) const override;
+
+private:
+  std::vector<int32_t> LocalDeviceMap(const Response& response) const;
+
+  NCCLOpContext cross_nccl_op_context_;
 };
 
 #if HAVE_MPI
@@ -146,6 +502,35 @@ public:
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
+  AllreduceAlgorithm Algorithm() const override {
+    return AllreduceAlgorithm::HIERARCHICAL;
+  }
+
+  bool Supports(const std::vector<TensorTableEntry>& entries,
+                const Response& response) const override;
+
+  // The cross-node allreduce uses MPI.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return false;
+  }
+
+  bool JoinsLaunchBatch(const std::vector<TensorTableEntry>& entries,
+                        const Response& response) const override {
+    return false;
+  }
+
+  bool SupportsProcessSets() const override { return false; }
+
+protected:
+  // The MPI reduction across nodes is done in the type of the tensors.
+  bool CompressesFusionBuffer() const override { return false; }
+
+  // Fused entries of a homogeneous cluster are padded to a multiple of
+  // local_size * FUSION_BUFFER_ATOMIC_UNIT.
+  int64_t
+  PaddedNumElements(const std::vector<TensorTableEntry>& entries) const override;
+
 private:
   MPIContext* mpi_context_;
 };
@@ -154,24 +539,66 @@ private:
 class NCCLAllgather : public GPUAllgather {
 public:
   NCCLAllgather(NCCLContext* nccl_context, GPUContext* gpu_context,
-                  HorovodGlobalState* global_state)
+                  HorovodGlobalState* global_state,
+                  horovod::common::Communicator communicator_type = Communicator::GLOBAL)
       : GPUAllgather(gpu_context, global_state),
-        nccl_op_context_(nccl_context, global_state, Communicator::GLOBAL),
+        nccl_context_(nccl_context),
+        nccl_op_context_(nccl_context, global_state, communicator_type),
         global_state_(global_state){};
 
   Status Execute(std::vector<TensorTableEntry>& entries,
                  const Response& response) override;
 
+  bool WaitsForReadyEventsOnDevice() const override { return true; }
+
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override {
+    return nccl_op_context_.NCCLCommsInitialized(response.devices());
+  }
+
   bool Enabled(const ParameterManager& param_manager,
                const std::vector<TensorTableEntry>& entries,
                const Response& response) const override;
 
 protected:
+#ifdef NCCL_P2P_SUPPORTED
+  // Allgathers blocks of different sizes around a ring of ncclSend/ncclRecv
+  // steps, each rank forwarding the block it received in the previous step.
+  void RingAllgatherv(const void* fused_input_data, void* buffer_data,
+                      const int* recvcounts, const int* displcmnts,
+                      size_t element_size);
+#endif
+
   NCCLContext* nccl_context_;
   NCCLOpContext nccl_op_context_;
   HorovodGlobalState* global_state_;
 };
 
+// Allgather in two stages for ranks placed node by node, so that every block
+// crosses the network once per node: NCCL Allgather across nodes between the
+// ranks with the same local rank, then NCCL Allgather within the node of the
+// blocks of every node. Requires tensors of the same shape on all ranks.
+class NCCLHierarchicalAllgather : public NCCLAllgather {
+public:
+  NCCLHierarchicalAllgather(NCCLContext* nccl_context, GPUContext* gpu_context,
+                            HorovodGlobalState* global_state)
+      : NCCLAllgather(nccl_context, gpu_context, global_state, Communicator::LOCAL),
+        cross_nccl_op_context_(nccl_context, global_state, Communicator::CROSS){};
+
+  Status Execute(std::vector<TensorTableEntry>& entries,
+                 const Response& response) override;
+
+  bool Enabled(const ParameterManager& param_manager,
+               const std::vector<TensorTableEntry>& entries,
+               const Response& response) const override;
+
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const override;
+
+private:
+  NCCLOpContext cross_nccl_op_context_;
+};
+
 
 } // namespace common
 } // namespace horovod
@@ -16,17 +16,96 @@
 // =============================================================================
 
 #include "operation_manager.h"
+#include <cstdlib>
+#include <sstream>
 #include <thread>
 #include <unistd.h>
 
 namespace horovod {
 namespace common {
 
+bool AllreduceDispatchTable::Parse(const std::string& spec) {
+  entries_.clear();
+  std::stringstream stream(spec);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    Entry entry;
+    entry.dtype = -1;
+    auto colon = item.find(':');
+    if (colon != std::string::npos) {
+      auto name = item.substr(0, colon);
+      for (int dtype = HOROVOD_UINT8; dtype <= HOROVOD_BFLOAT16; ++dtype) {
+        if (DataType_Name((DataType)dtype) == name) {
+          entry.dtype = dtype;
+        }
+      }
+      if (entry.dtype < 0) {
+        entries_.clear();
+        return false;
+      }
+      item = item.substr(colon + 1);
+    }
+    auto eq = item.find('=');
+    if (eq == std::string::npos) {
+      entries_.clear();
+      return false;
+    }
+    auto bytes = item.substr(0, eq);
+    auto algorithm = item.substr(eq + 1);
+    char* end;
+    entry.min_bytes = std::strtoll(bytes.c_str(), &end, 10);
+    std::string suffix(end);
+    if (suffix == "K") {
+      entry.min_bytes <<= 10;
+    } else if (suffix == "M") {
+      entry.min_bytes <<= 20;
+    } else if (suffix == "G") {
+      entry.min_bytes <<= 30;
+    } else if (!suffix.empty() || end == bytes.c_str()) {
+      entries_.clear();
+      return false;
+    }
+    if (algorithm == "auto") {
+      entry.algorithm = AllreduceAlgorithm::AUTO;
+    } else if (algorithm == "flat") {
+      entry.algorithm = AllreduceAlgorithm::FLAT;
+    } else if (algorithm == "hierarchical") {
+      entry.algorithm = AllreduceAlgorithm::HIERARCHICAL;
+    } else if (algorithm == "torus") {
+      entry.algorithm = AllreduceAlgorithm::TORUS;
+    } else {
+      entries_.clear();
+      return false;
+    }
+    entries_.push_back(entry);
+  }
+  return true;
+}
+
+AllreduceAlgorithm AllreduceDispatchTable::Lookup(int64_t bytes,
+                                                  DataType dtype) const {
+  const Entry* found = nullptr;
+  for (auto& entry : entries_) {
+    if (entry.min_bytes > bytes ||
+        (entry.dtype >= 0 && entry.dtype != (int)dtype)) {
+      continue;
+    }
+    bool more_specific = found != nullptr && entry.dtype >= 0 && found->dtype < 0;
+    bool less_specific = found != nullptr && entry.dtype < 0 && found->dtype >= 0;
+    if (found == nullptr || more_specific ||
+        (!less_specific && entry.min_bytes >= found->min_bytes)) {
+      found = &entry;
+    }
+  }
+  return found != nullptr ? found->algorithm : AllreduceAlgorithm::AUTO;
+}
+
 OperationManager::OperationManager(ParameterManager* param_manager,
                                    std::vector<std::shared_ptr<AllreduceOp>> allreduce_ops,
                                    std::vector<std::shared_ptr<AllgatherOp>> allgather_ops,
                                    std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops,
                                    std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops,
+                                   std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops,
                                    std::shared_ptr<JoinOp> join_op,
                                    std::vector<std::shared_ptr<AllreduceOp>> adasum_ops,
                                    std::shared_ptr<ErrorOp> error_op)
@@ -35,36 +114,66 @@ OperationManager::OperationManager(ParameterManager* param_manager,
       allgather_ops_(std::move(allgather_ops)),
       broadcast_ops_(std::move(broadcast_ops)),
       alltoall_ops_(std::move(alltoall_ops)),
+      reducescatter_ops_(std::move(reducescatter_ops)),
       join_op_(std::move(join_op)),
       adasum_ops_(std::move(adasum_ops)),
       error_op_(std::move(error_op)) {}
 
-void func(const std::shared_ptr<horovod::common::AllreduceOp>& op,std::vector<TensorTableEntry>& entries,
-                                          const Response& response){
-    op->Execute(entries, response);
+template <typename Op, typename Query>
+static bool QueryFirstEnabledOp(const std::vector<std::shared_ptr<Op>>& ops,
+                                const ParameterManager& param_manager,
+                                const std::vector<TensorTableEntry>& entries,
+                                const Response& response, Query query) {
+  for (auto& op : ops) {
+    if (op->Enabled(param_manager, entries, response)) {
+      return query(*op);
+    }
+  }
+  return false;
 }
 
-void func_(const std::shared_ptr<horovod::common::AllreduceOp>& op,std::vector<TensorTableEntry>& entries,
-                                          const Response& response,Status &ans){
-  ans = op->Execute(entries, response);                                 
-} 
-
-Status OperationManager::ExecuteAllreduce(std::vector<TensorTableEntry>& entries,
-                                          const Response& response) const {
-  // fzh-alloc
-  static int first = 0;
+AllreduceOp* OperationManager::SelectAllreduceOp(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  if (response.process_set_id() != 0) {
+    for (auto& op : allreduce_ops_) {
+      if (op->SupportsProcessSets() &&
+          op->Enabled(*param_manager_, entries, response)) {
+        return op.get();
+      }
+    }
+    return nullptr;
+  }
+  if (!allreduce_dispatch_.Empty()) {
+    int64_t bytes = 0;
+    for (auto& e : entries) {
+      bytes += e.tensor->size();
+    }
+    auto algorithm =
+        allreduce_dispatch_.Lookup(bytes, entries[0].tensor->dtype());
+    if (algorithm != AllreduceAlgorithm::AUTO) {
+      for (auto& op : allreduce_ops_) {
+        if (op->Algorithm() == algorithm && op->Supports(entries, response)) {
+          return op.get();
+        }
+      }
+    }
+  }
   for (auto& op : allreduce_ops_) {
     if (op->Enabled(*param_manager_, entries, response)) {
-      // if(first == 0){
-      //   first++;
-      //   printf("more allreduce!!!!!\n");
-      //   // fzh_thread = std::thread(func,std::ref(op),std::ref(entries),std::ref(response));
-      //   op->Execute(entries, response);
-      // }
-      return op->Execute(entries, response);
+      return op.get();
     }
   }
-  throw std::logic_error("No Allreduce operation enabled");
+  return nullptr;
+}
+
+Status OperationManager::ExecuteAllreduce(std::vector<TensorTableEntry>& entries,
+                                          const Response& response) const {
+  auto op = SelectAllreduceOp(entries, response);
+  if (op == nullptr) {
+    throw std::logic_error("No Allreduce operation enabled");
+  }
+  return op->Execute(entries, response);
 }
 
 Status OperationManager::ExecuteAllgather(std::vector<TensorTableEntry>& entries,
@@ -97,6 +206,16 @@ Status OperationManager::ExecuteAlltoall(std::vector<TensorTableEntry>& entries,
   throw std::logic_error("No Alltoall operation enabled");
 }
 
+Status OperationManager::ExecuteReducescatter(std::vector<TensorTableEntry>& entries,
+                                              const Response& response) const {
+  for (auto& op : reducescatter_ops_) {
+    if (op->Enabled(*param_manager_, entries, response)) {
+      return op->Execute(entries, response);
+    }
+  }
+  throw std::logic_error("No Reducescatter operation enabled");
+}
+
 Status OperationManager::ExecuteJoin(std::vector<TensorTableEntry>& entries,
                                           const Response& response) const {
   return join_op_->Execute(entries, response);
@@ -127,6 +246,8 @@ Status OperationManager::ExecuteOperation(std::vector<TensorTableEntry>& entries
     return ExecuteBroadcast(entries, response);
   } else if (response.response_type() == Response::ALLTOALL) {
     return ExecuteAlltoall(entries, response);
+  } else if (response.response_type() == Response::REDUCESCATTER) {
+    return ExecuteReducescatter(entries, response);
   } else if (response.response_type() == Response::JOIN) {
     return ExecuteJoin(entries, response);
   } else if (response.response_type() == Response::ADASUM) {
@@ -138,5 +259,58 @@ Status OperationManager::ExecuteOperation(std::vector<TensorTableEntry>& entries
   }
 }
 
+template <typename Query>
+bool OperationManager::QueryEnabledOp(
+    const std::vector<TensorTableEntry>& entries, const Response& response,
+    Query query) const {
+  switch (response.response_type()) {
+  case Response::ALLREDUCE: {
+    auto op = SelectAllreduceOp(entries, response);
+    return op != nullptr && query(*op);
+  }
+  case Response::ALLGATHER:
+    return QueryFirstEnabledOp(allgather_ops_, *param_manager_, entries,
+                               response, query);
+  case Response::BROADCAST:
+    return QueryFirstEnabledOp(broadcast_ops_, *param_manager_, entries,
+                               response, query);
+  case Response::ALLTOALL:
+    return QueryFirstEnabledOp(alltoall_ops_, *param_manager_, entries,
+                               response, query);
+  case Response::REDUCESCATTER:
+    return QueryFirstEnabledOp(reducescatter_ops_, *param_manager_, entries,
+                               response, query);
+  case Response::ADASUM:
+    return QueryFirstEnabledOp(adasum_ops_, *param_manager_, entries,
+                               response, query);
+  default:
+    return false;
+  }
+}
+
+bool OperationManager::WaitsForReadyEventsOnDevice(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return QueryEnabledOp(entries, response, [](const HorovodOp& op) {
+    return op.WaitsForReadyEventsOnDevice();
+  });
+}
+
+bool OperationManager::ExecutesWithoutController(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return QueryEnabledOp(entries, response, [&](const HorovodOp& op) {
+    return op.ExecutesWithoutController(entries, response);
+  });
+}
+
+bool OperationManager::JoinsLaunchBatch(
+    const std::vector<TensorTableEntry>& entries,
+    const Response& response) const {
+  return QueryEnabledOp(entries, response, [&](const HorovodOp& op) {
+    return op.JoinsLaunchBatch(entries, response);
+  });
+}
+
 } // namespace common
 } // namespace horovod
@@ -24,6 +24,30 @@
 namespace horovod {
 namespace common {
 
+// Allreduce algorithm by message size and dtype, with
+// HOROVOD_ALLREDUCE_DISPATCH. The specification is a comma separated list of
+// [dtype:]min_bytes=algorithm entries, e.g. "0=flat,4M=hierarchical". An
+// allreduce uses the entry with the largest minimum not above its bytes,
+// entries of its dtype taking precedence over those without one.
+class AllreduceDispatchTable {
+public:
+  // Returns false and leaves the table empty if the specification is invalid.
+  bool Parse(const std::string& spec);
+
+  bool Empty() const { return entries_.empty(); }
+
+  AllreduceAlgorithm Lookup(int64_t bytes, DataType dtype) const;
+
+private:
+  struct Entry {
+    int64_t min_bytes;
+    int dtype; // -1 for any
+    AllreduceAlgorithm algorithm;
+  };
+
+  std::vector<Entry> entries_;
+};
+
 class OperationManager {
 public:
   OperationManager(ParameterManager* param_manager,
@@ -31,6 +55,7 @@ public:
                    std::vector<std::shared_ptr<AllgatherOp>> allgather_ops,
                    std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops,
                    std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops,
+                   std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops,
                    std::shared_ptr<JoinOp> join_op,
                    std::vector<std::shared_ptr<AllreduceOp>> adasum_ops,
                    std::shared_ptr<ErrorOp> error_op);
@@ -45,6 +70,8 @@ public:
 
   Status ExecuteAlltoall(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
+  Status ExecuteReducescatter(std::vector<TensorTableEntry>& entries, const Response& response) const;
+
   Status ExecuteError(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
   Status ExecuteJoin(std::vector<TensorTableEntry>& entries, const Response& response) const;
@@ -53,17 +80,49 @@ public:
 
   Status ExecuteOperation(std::vector<TensorTableEntry>& entries, const Response& response) const;
 
+  // Returns true if the operation that will execute the response waits for
+  // the ready events of the entries on its GPU stream.
+  bool WaitsForReadyEventsOnDevice(const std::vector<TensorTableEntry>& entries,
+                                   const Response& response) const;
+
+  // Returns true if the operation that will execute the response does not
+  // communicate through the controller.
+  bool ExecutesWithoutController(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const;
+
+  // Returns true if the operation that will execute the response joins the
+  // NCCL launch batch of the cycle.
+  bool JoinsLaunchBatch(const std::vector<TensorTableEntry>& entries,
+                        const Response& response) const;
+
+  // The table must be the same on all ranks.
+  void SetAllreduceDispatch(AllreduceDispatchTable table) {
+    allreduce_dispatch_ = std::move(table);
+  }
 
 private:
+  // Returns query(op) for the first enabled operation of the response type,
+  // or false if there is none.
+  template <typename Query>
+  bool QueryEnabledOp(const std::vector<TensorTableEntry>& entries,
+                      const Response& response, Query query) const;
+
+  // The operation of the algorithm the dispatch table selects for the
+  // response, or the first enabled one. Null if there is none.
+  AllreduceOp* SelectAllreduceOp(const std::vector<TensorTableEntry>& entries,
+                                 const Response& response) const;
+
   ParameterManager* param_manager_;
 
   std::vector<std::shared_ptr<AllreduceOp>> allreduce_ops_;
   std::vector<std::shared_ptr<AllgatherOp>> allgather_ops_;
   std::vector<std::shared_ptr<BroadcastOp>> broadcast_ops_;
   std::vector<std::shared_ptr<AlltoallOp>> alltoall_ops_;
+  std::vector<std::shared_ptr<ReducescatterOp>> reducescatter_ops_;
   std::shared_ptr<JoinOp> join_op_;
   std::vector<std::shared_ptr<AllreduceOp>> adasum_ops_;
   std::shared_ptr<ErrorOp> error_op_;
+  AllreduceDispatchTable allreduce_dispatch_;
 };
 
 } // namespace common
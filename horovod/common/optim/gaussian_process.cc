@@ -56,15 +56,15 @@ void GaussianProcessRegressor::Fit(MatrixXd* x_train, MatrixXd* y_train) {
   // Computes the negative log-likelihood for training data x_train and y_train and given noise level.
   double a2 = alpha_ * alpha_;
   double d3 = 0.5 * x_train_->rows() * std::log(2 * M_PI);
-  auto f = [&, a2, d3](const VectorXd& x) {
-    int64_t m = x_train_->rows();
-    MatrixXd k = Kernel(*x_train_, *x_train_, x[0], x[1]) + (a2 * MatrixXd::Identity(m, m));
-    MatrixXd k_inv = k.inverse();
-
-    // Compute determinant via Cholesky decomposition
-    MatrixXd l = k.llt().matrixL().toDenseMatrix();
-    double d1 = l.diagonal().unaryExpr(ln).sum();
-    MatrixXd d2 = 0.5 * (y_train_->transpose() * (k_inv * (*y_train_)));
+  int64_t m = x_train_->rows();
+  MatrixXd sqdist = SquaredDistances(*x_train_, *x_train_);
+  auto f = [&, a2, d3, m](const VectorXd& x) {
+    MatrixXd k = KernelFromSquaredDistances(sqdist, x[0], x[1]) + (a2 * MatrixXd::Identity(m, m));
+
+    // A single Cholesky decomposition gives the determinant and solves for k^-1 * y_train.
+    Eigen::LLT<MatrixXd> llt(k);
+    double d1 = llt.matrixLLT().diagonal().unaryExpr(ln).sum();
+    MatrixXd d2 = 0.5 * (y_train_->transpose() * llt.solve(*y_train_));
     MatrixXd cov = d2.array() + (d1 + d3);
 
     return cov(0, 0);
@@ -109,19 +109,24 @@ void GaussianProcessRegressor::Fit(MatrixXd* x_train, MatrixXd* y_train) {
     length_ = x_min[0];
     sigma_f_ = x_min[1];
   }
+
+  k_llt_.compute(KernelFromSquaredDistances(sqdist, length_, sigma_f_) + (a2 * MatrixXd::Identity(m, m)));
+  k_inv_y_ = k_llt_.solve(*y_train_);
 }
 
 void GaussianProcessRegressor::Predict(const MatrixXd& x, VectorXd& mu, VectorXd* sigma) const {
-  MatrixXd cov;
-  PosteriorPrediction(x, *x_train_, *y_train_, mu, cov, length_, sigma_f_, alpha_);
+  // Same as PosteriorPrediction, with the factorization of the fit.
+  MatrixXd k_s = Kernel(*x_train_, x, length_, sigma_f_);
+  mu = k_s.transpose() * k_inv_y_;
 
   // Only compute standard deviation if it was requested
   if (sigma != nullptr) {
-    // Extract the standard deviation from the covariance matrix
-    auto sqrt = [](double x) {
-      return std::sqrt(x);
-    };
-    *sigma = cov.diagonal().unaryExpr(sqrt);
+    // Only the diagonal of the covariance is needed. The diagonal of k_ss is sigma_f^2 plus the jitter, and the one
+    // of k_s^T * k^-1 * k_s holds the squared norms of the columns of l^-1 * k_s.
+    MatrixXd v = k_llt_.matrixL().solve(k_s);
+    VectorXd var = (sigma_f_ * sigma_f_ + 1e-8) - v.colwise().squaredNorm().transpose().array();
+    // Rounding can make the variance slightly negative next to training points.
+    *sigma = var.array().cwiseMax(0).sqrt();
   }
 }
 
@@ -140,11 +145,11 @@ void GaussianProcessRegressor::PosteriorPrediction(
   MatrixXd k = Kernel(x_train, x_train, l, sigma_f) + (sy2 * MatrixXd::Identity(m, m));
   MatrixXd k_s = Kernel(x_train, x_s, l, sigma_f);
   MatrixXd k_ss = Kernel(x_s, x_s, l, sigma_f) + (1e-8 * MatrixXd::Identity(n, n));
-  MatrixXd k_inv = k.inverse();
+  MatrixXd k_inv_k_s = k.llt().solve(k_s);
 
   // Compute sufficient statistics of the posterior predictive distribution: mean and covariance.
-  mu_s = (k_s.transpose() * k_inv) * y_train;
-  cov_s = k_ss - (k_s.transpose() * k_inv) * k_s;
+  mu_s = k_inv_k_s.transpose() * y_train;
+  cov_s = k_ss - k_s.transpose() * k_inv_k_s;
 }
 
 void GaussianProcessRegressor::ApproxFPrime(const VectorXd& x, const std::function<double(const VectorXd&)>& f,
@@ -161,13 +166,19 @@ void GaussianProcessRegressor::ApproxFPrime(const VectorXd& x, const std::functi
 MatrixXd GaussianProcessRegressor::Kernel(const MatrixXd& x1, const MatrixXd& x2,
                                           double l, double sigma_f) const {
   // Squared Exponential Kernel, also known as the Gaussian or RBF Kernel.
+  return KernelFromSquaredDistances(SquaredDistances(x1, x2), l, sigma_f);
+}
+
+MatrixXd GaussianProcessRegressor::SquaredDistances(const MatrixXd& x1, const MatrixXd& x2) {
   auto x1_vec = x1.cwiseProduct(x1).rowwise().sum();
   auto x2_vec = x2.cwiseProduct(x2).rowwise().sum();
   auto x1_x2 = x1_vec.replicate(1, x2_vec.size()).rowwise() + x2_vec.transpose();
 
   auto& dot = x1 * x2.transpose();
-  auto sqdist = x1_x2 - (dot.array() * 2).matrix();
+  return x1_x2 - (dot.array() * 2).matrix();
+}
 
+MatrixXd GaussianProcessRegressor::KernelFromSquaredDistances(const MatrixXd& sqdist, double l, double sigma_f) {
   // The length parameter l controls the smoothness of the function and sigma_f the vertical variation. We use
   // the same l for all input dimensions (isotropic kernel).
   double sigma_f2 = sigma_f * sigma_f;
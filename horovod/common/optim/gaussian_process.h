@@ -94,6 +94,12 @@ public:
   Eigen::MatrixXd Kernel(const Eigen::MatrixXd& x1, const Eigen::MatrixXd& x2, double l=1.0, double sigma_f=1.0) const;
 
 private:
+  // Squared distances between the points in X1 and X2 (m x n), which do not depend on the kernel parameters.
+  static Eigen::MatrixXd SquaredDistances(const Eigen::MatrixXd& x1, const Eigen::MatrixXd& x2);
+
+  // Kernel from the squared distances between the points.
+  static Eigen::MatrixXd KernelFromSquaredDistances(const Eigen::MatrixXd& sqdist, double l, double sigma_f);
+
   // Kernel parameter for noise. Higher values make more coarse approximations which avoids overfitting to noisy data.
   double alpha_;
 
@@ -109,6 +115,11 @@ private:
   // These pointers are not owned.
   Eigen::MatrixXd* x_train_;
   Eigen::MatrixXd* y_train_;
+
+  // Cholesky factorization of the kernel matrix of the training data for the fitted parameters, and the solution
+  // of k * k_inv_y_ = y_train. Every prediction until the next fit reuses them.
+  Eigen::LLT<Eigen::MatrixXd> k_llt_;
+  Eigen::MatrixXd k_inv_y_;
 };
 
 } // namespace common
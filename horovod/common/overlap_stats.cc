@@ -0,0 +1,148 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "overlap_stats.h"
+
+#include <chrono>
+#include <sstream>
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+void OverlapStats::SetMaxSteps(int value) {
+  if (value < 0) {
+    LOG(WARNING) << "HOROVOD_OVERLAP_STATS_STEPS must not be negative, got "
+                 << value << ". Disabling overlap stats.";
+    value = 0;
+  }
+  max_steps_ = value;
+}
+
+void OverlapStats::RecordReady(const std::string& tensor_name) {
+  if (!IsEnabled()) {
+    return;
+  }
+  int64_t now = NowMicros();
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (steps_.empty() ||
+      steps_.back().index.find(tensor_name) != steps_.back().index.end()) {
+    steps_.emplace_back();
+    // Keep max_steps_ complete steps and the current one.
+    while ((int)steps_.size() > max_steps_ + 1) {
+      steps_.pop_front();
+    }
+  }
+  auto& step = steps_.back();
+  step.index[tensor_name] = step.records.size();
+  Record record;
+  record.tensor_name = tensor_name;
+  record.ready_us = now;
+  step.records.push_back(std::move(record));
+}
+
+void OverlapStats::RecordNegotiated(const std::string& tensor_name) {
+  if (!IsEnabled()) {
+    return;
+  }
+  int64_t now = NowMicros();
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto record = FindRecord(tensor_name);
+  if (record != nullptr) {
+    record->negotiated_us = now;
+  }
+}
+
+void OverlapStats::RecordCommStart(const std::string& tensor_name) {
+  if (!IsEnabled()) {
+    return;
+  }
+  int64_t now = NowMicros();
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto record = FindRecord(tensor_name);
+  if (record != nullptr) {
+    record->comm_start_us = now;
+  }
+}
+
+void OverlapStats::RecordCommEnd(const std::string& tensor_name) {
+  if (!IsEnabled()) {
+    return;
+  }
+  int64_t now = NowMicros();
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto record = FindRecord(tensor_name);
+  if (record != nullptr) {
+    record->comm_end_us = now;
+  }
+}
+
+std::vector<std::vector<OverlapStats::Record>> OverlapStats::Steps() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::vector<std::vector<Record>> steps;
+  steps.reserve(steps_.size());
+  for (auto& step : steps_) {
+    steps.push_back(step.records);
+  }
+  return steps;
+}
+
+std::string OverlapStats::StepsAsJson() const {
+  std::ostringstream json;
+  json << "[";
+  bool first_step = true;
+  for (auto& step : Steps()) {
+    json << (first_step ? "[" : ", [");
+    first_step = false;
+    bool first_record = true;
+    for (auto& record : step) {
+      json << (first_record ? "" : ", ") << "{\"tensor_name\": \"";
+      first_record = false;
+      for (char c : record.tensor_name) {
+        if (c == '"' || c == '\\') {
+          json << '\\';
+        }
+        json << c;
+      }
+      json << "\", \"ready\": " << record.ready_us
+           << ", \"negotiated\": " << record.negotiated_us
+           << ", \"comm_start\": " << record.comm_start_us
+           << ", \"comm_end\": " << record.comm_end_us << "}";
+    }
+    json << "]";
+  }
+  json << "]";
+  return json.str();
+}
+
+OverlapStats::Record* OverlapStats::FindRecord(const std::string& tensor_name) {
+  for (auto step = steps_.rbegin(); step != steps_.rend(); ++step) {
+    auto it = step->index.find(tensor_name);
+    if (it != step->index.end()) {
+      return &step->records[it->second];
+    }
+  }
+  return nullptr;
+}
+
+int64_t OverlapStats::NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace common
+} // namespace horovod
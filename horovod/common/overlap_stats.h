@@ -0,0 +1,92 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_OVERLAP_STATS_H
+#define HOROVOD_OVERLAP_STATS_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// Records, on every rank, when each tensor of the last steps became ready,
+// finished negotiation, and started and finished its collective, so that the
+// overlap of computation and communication can be inspected without parsing
+// a timeline.
+//
+// Steps are detected like in the fusion planner: a step ends when a tensor
+// that was already enqueued in the current step is enqueued again. Times are
+// in microseconds since the epoch of the system clock.
+class OverlapStats {
+public:
+  struct Record {
+    std::string tensor_name;
+    // Time the framework enqueued the tensor, after computing it.
+    int64_t ready_us = 0;
+    // Time the background thread got the negotiated response.
+    int64_t negotiated_us = 0;
+    // Time the collective was started.
+    int64_t comm_start_us = 0;
+    // Time the callback of the tensor was called.
+    int64_t comm_end_us = 0;
+  };
+
+  OverlapStats() = default;
+  OverlapStats(const OverlapStats&) = delete;
+
+  bool IsEnabled() const { return max_steps_ > 0; }
+
+  // Number of complete steps to keep in addition to the current one, 0
+  // disables the stats.
+  void SetMaxSteps(int value);
+
+  void RecordReady(const std::string& tensor_name);
+  void RecordNegotiated(const std::string& tensor_name);
+  void RecordCommStart(const std::string& tensor_name);
+  void RecordCommEnd(const std::string& tensor_name);
+
+  // Returns the records of the kept steps, oldest first, each in enqueue
+  // order.
+  std::vector<std::vector<Record>> Steps() const;
+
+  // Returns Steps() as a JSON list of lists of objects.
+  std::string StepsAsJson() const;
+
+private:
+  struct Step {
+    std::vector<Record> records;
+    std::unordered_map<std::string, size_t> index;
+  };
+
+  // Returns the record of the most recent enqueue of the tensor, or nullptr.
+  Record* FindRecord(const std::string& tensor_name);
+
+  static int64_t NowMicros();
+
+  int max_steps_ = 0;
+
+  mutable std::mutex mutex_;
+  std::deque<Step> steps_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_OVERLAP_STATS_H
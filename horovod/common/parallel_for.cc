@@ -0,0 +1,92 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace horovod {
+namespace common {
+
+namespace {
+
+// Helpers of the calling thread, one fewer than the reduction threads.
+ThreadPool& ReductionPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+} // namespace
+
+void SetCPUReductionThreads(int num_threads) {
+  auto& pool = ReductionPool();
+  int num_helpers = std::max(num_threads, 1) - 1;
+  if (pool.size() == num_helpers) {
+    return;
+  }
+  pool.reset();
+  if (num_helpers > 0) {
+    pool.create(num_helpers);
+  }
+}
+
+int NumParallelRanges(int64_t n, int64_t min_grain) {
+  int64_t num_threads = ReductionPool().size() + 1;
+  int64_t num_ranges = n / std::max(min_grain, (int64_t)1);
+  return (int)std::max(std::min(num_threads, num_ranges), (int64_t)1);
+}
+
+void ParallelFor(
+    int64_t n, int64_t min_grain,
+    const std::function<void(int range, int64_t begin, int64_t end)>& f) {
+  int num_ranges = NumParallelRanges(n, min_grain);
+  if (num_ranges == 1) {
+    f(0, 0, n);
+    return;
+  }
+
+  int64_t per_range = (n + num_ranges - 1) / num_ranges;
+  std::mutex mutex;
+  std::condition_variable cond;
+  int pending = num_ranges - 1;
+
+  std::vector<std::function<void(void)>> batch;
+  batch.reserve(num_ranges - 1);
+  for (int range = 1; range < num_ranges; ++range) {
+    int64_t begin = std::min(range * per_range, n);
+    int64_t end = std::min(begin + per_range, n);
+    batch.emplace_back([&, range, begin, end] {
+      f(range, begin, end);
+      std::lock_guard<std::mutex> guard(mutex);
+      if (--pending == 0) {
+        cond.notify_one();
+      }
+    });
+  }
+  ReductionPool().execute(std::move(batch));
+
+  f(0, 0, std::min(per_range, n));
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&pending] { return pending == 0; });
+}
+
+} // namespace common
+} // namespace horovod
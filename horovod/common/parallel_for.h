@@ -0,0 +1,48 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_PARALLEL_FOR_H
+#define HOROVOD_PARALLEL_FOR_H
+
+#include <functional>
+#include <stdint.h>
+
+namespace horovod {
+namespace common {
+
+// Buffers are only split between threads when every thread gets at least this
+// much to reduce, below that waking the threads costs more than it saves.
+#define CPU_REDUCTION_MIN_BYTES_PER_THREAD (512 * 1024)
+
+// Sets the number of threads, the calling one included, that CPU reductions
+// run on. 1 runs them on the calling thread only. Not thread safe, it's set
+// once by the background thread at initialization.
+void SetCPUReductionThreads(int num_threads);
+
+// Number of ranges ParallelFor splits n elements into, so that every range
+// has at least min_grain elements.
+int NumParallelRanges(int64_t n, int64_t min_grain);
+
+// Calls f(range, begin, end) for NumParallelRanges(n, min_grain) consecutive
+// ranges covering [0, n), and returns when all of them are done. The first
+// range runs on the calling thread. f must not throw.
+void ParallelFor(
+    int64_t n, int64_t min_grain,
+    const std::function<void(int range, int64_t begin, int64_t end)>& f);
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_PARALLEL_FOR_H
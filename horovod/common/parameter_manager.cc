@@ -17,7 +17,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <iomanip>
 #include <limits>
+#include <sstream>
 
 #include "logging.h"
 #include "utils/env_parser.h"
@@ -29,6 +32,8 @@ namespace common {
 #define DEFAULT_STEPS_PER_SAMPLE 10
 #define DEFAULT_BAYES_OPT_MAX_SAMPLES 20
 #define DEFAULT_GAUSSIAN_PROCESS_NOISE 0.8
+#define DEFAULT_DRIFT_SAMPLES 3
+#define DEFAULT_DRIFT_RETUNE_SAMPLES 10
 
 Eigen::VectorXd CreateVector(double x1, double x2) {
   Eigen::VectorXd v(2);
@@ -44,6 +49,13 @@ ParameterManager::ParameterManager() :
     hierarchical_allreduce_(CategoricalParameter<bool>(std::vector<bool>{false, true})),
     hierarchical_allgather_(CategoricalParameter<bool>(std::vector<bool>{false, true})),
     cache_enabled_(CategoricalParameter<bool>(std::vector<bool>{false, true})),
+    gloo_bcube_threshold_(CategoricalParameter<int64_t>(std::vector<int64_t>{
+      0, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024,
+      std::numeric_limits<int64_t>::max()})),
+    libra_group_scale_(CategoricalParameter<double>(std::vector<double>{1, 0.5, 2})),
+    libra_block_scale_(CategoricalParameter<double>(std::vector<double>{1, 0.5, 2})),
+    libra_thread_num_(CategoricalParameter<int>(std::vector<int>{0, 256, 512})),
+    libra_streams_(CategoricalParameter<int>(std::vector<int>{0, 1, 2})),
     joint_params_(BayesianParameter(
       std::vector<BayesianVariableConfig>{
         { BayesianVariable::fusion_buffer_threshold_mb, std::pair<double, double>(0, 64) },
@@ -58,13 +70,28 @@ ParameterManager::ParameterManager() :
       GetIntEnvOrDefault(HOROVOD_AUTOTUNE_BAYES_OPT_MAX_SAMPLES, DEFAULT_BAYES_OPT_MAX_SAMPLES),
       GetDoubleEnvOrDefault(HOROVOD_AUTOTUNE_GAUSSIAN_PROCESS_NOISE, DEFAULT_GAUSSIAN_PROCESS_NOISE))),
     parameter_chain_(std::vector<ITunableParameter*>{&joint_params_, &hierarchical_allreduce_, &hierarchical_allgather_,
-                                                     &cache_enabled_}),
+                                                     &cache_enabled_, &gloo_bcube_threshold_,
+                                                     &libra_group_scale_, &libra_block_scale_,
+                                                     &libra_thread_num_, &libra_streams_}),
     active_(false),
+    autotune_enabled_(false),
     warmup_remaining_(warmups_),
     sample_(0),
+    pending_score_(0),
+    drift_threshold_(GetDoubleEnvOrDefault(HOROVOD_AUTOTUNE_DRIFT_THRESHOLD, 0) / 100),
+    drift_samples_(GetIntEnvOrDefault(HOROVOD_AUTOTUNE_DRIFT_SAMPLES, DEFAULT_DRIFT_SAMPLES)),
+    drift_retune_samples_(GetIntEnvOrDefault(HOROVOD_AUTOTUNE_DRIFT_RETUNE_SAMPLES, DEFAULT_DRIFT_RETUNE_SAMPLES)),
+    reference_score_(0),
+    drift_count_(0),
+    step_time_score_(false),
+    steps_completed_(0),
+    sample_start_steps_(0),
     rank_(-1),
     root_rank_(0),
-    writing_(false) {
+    writing_(false),
+    max_threshold_mb_(std::numeric_limits<double>::max()),
+    model_observed_(false),
+    warm_start_pending_(false) {
   Reset();
 }
 
@@ -73,22 +100,61 @@ void ParameterManager::Initialize(int32_t rank, int32_t root_rank,
   rank_ = rank;
   root_rank_ = root_rank;
   if (rank_ == root_rank) {
-    LOG(INFO) << "Autotuner: Tunable params [hierarchical_allreduce,hierarchical_allgather,cache_enabled,cycle_time_ms,tensor_fusion_threshold] score";
+    LOG(INFO) << "Autotuner: Tunable params [hierarchical_allreduce,hierarchical_allgather,cache_enabled,gloo_bcube_threshold,libra_group_scale,libra_block_scale,libra_thread_num,libra_streams,cycle_time_ms,tensor_fusion_threshold] score";
   }
   if (rank_ == root_rank && !file_name.empty()) {
     file_.open(file_name, std::ios::out | std::ios::trunc);
     if (file_.good()) {
-      file_ << "hierarchical_allreduce,hierarchical_allgather,cache_enabled,cycle_time_ms,tensor_fusion_threshold,score" << std::endl;
+      file_ << "hierarchical_allreduce,hierarchical_allgather,cache_enabled,gloo_bcube_threshold,libra_group_scale,libra_block_scale,libra_thread_num,libra_streams,cycle_time_ms,tensor_fusion_threshold,score" << std::endl;
       writing_ = true;
     }
   }
 }
 
+void ParameterManager::SetWarmStartFile(const std::string& file_name,
+                                        const std::string& topology) {
+  warm_start_file_ = file_name;
+  topology_ = topology;
+}
+
+void ParameterManager::SetStepTimeScore(bool step_time_score) {
+  step_time_score_ = step_time_score;
+}
+
+void ParameterManager::StepCompleted() {
+  std::lock_guard<std::mutex> guard(step_mutex_);
+  ++steps_completed_;
+  last_step_end_ = std::chrono::steady_clock::now();
+}
+
+void ParameterManager::SetMemoryBudget(int64_t budget_bytes, int num_buffers,
+                                       int64_t reserved_bytes) {
+  double max_threshold_mb = std::max<double>(
+      0, double(budget_bytes - reserved_bytes) / std::max(num_buffers, 1) /
+             (1024 * 1024));
+  if (joint_params_.IsFixed(fusion_buffer_threshold_mb)) {
+    if (joint_params_.Value(fusion_buffer_threshold_mb) > max_threshold_mb &&
+        rank_ == root_rank_) {
+      LOG(WARNING) << "Autotuner: The fusion buffers of the fixed fusion "
+                   << "threshold exceed " << HOROVOD_AUTOTUNE_MEMORY_BUDGET;
+    }
+    return;
+  }
+  max_threshold_mb_ = max_threshold_mb;
+  joint_params_.LimitUpperBound(fusion_buffer_threshold_mb, max_threshold_mb);
+  if (rank_ == root_rank_) {
+    LOG(INFO) << "Autotuner: Fusion threshold limited to " << max_threshold_mb
+              << " mb by the memory budget of " << num_buffers
+              << " fusion buffers";
+  }
+}
+
 void ParameterManager::SetAutoTuning(bool active) {
   if (active != active_) {
     warmup_remaining_ = warmups_;
   }
   active_ = active;
+  autotune_enabled_ |= active;
 };
 
 bool ParameterManager::HierarchicalAllreduce() const {
@@ -115,6 +181,46 @@ void ParameterManager::SetCacheEnabled(bool enabled, bool fixed) {
   cache_enabled_.SetValue(enabled, fixed);
 }
 
+int64_t ParameterManager::GlooBcubeThresholdBytes() const {
+  return active_ ? gloo_bcube_threshold_.Value() : gloo_bcube_threshold_.BestValue();
+}
+
+void ParameterManager::SetGlooBcubeThresholdBytes(int64_t threshold, bool fixed) {
+  gloo_bcube_threshold_.SetValue(threshold, fixed);
+}
+
+double ParameterManager::LibraGroupScale() const {
+  return active_ ? libra_group_scale_.Value() : libra_group_scale_.BestValue();
+}
+
+void ParameterManager::SetLibraGroupScale(double scale, bool fixed) {
+  libra_group_scale_.SetValue(scale, fixed);
+}
+
+double ParameterManager::LibraBlockScale() const {
+  return active_ ? libra_block_scale_.Value() : libra_block_scale_.BestValue();
+}
+
+void ParameterManager::SetLibraBlockScale(double scale, bool fixed) {
+  libra_block_scale_.SetValue(scale, fixed);
+}
+
+int ParameterManager::LibraThreadNum() const {
+  return active_ ? libra_thread_num_.Value() : libra_thread_num_.BestValue();
+}
+
+void ParameterManager::SetLibraThreadNum(int thread_num, bool fixed) {
+  libra_thread_num_.SetValue(thread_num, fixed);
+}
+
+int ParameterManager::LibraStreams() const {
+  return active_ ? libra_streams_.Value() : libra_streams_.BestValue();
+}
+
+void ParameterManager::SetLibraStreams(int streams, bool fixed) {
+  libra_streams_.SetValue(streams, fixed);
+}
+
 int64_t ParameterManager::TensorFusionThresholdBytes() const {
   double b = active_ ?
       joint_params_.Value(fusion_buffer_threshold_mb) :
@@ -137,20 +243,51 @@ void ParameterManager::SetCycleTimeMs(double value, bool fixed) {
 /// Using the tensors information to update score and tune parameters.
 /// \param tensor_names A vector of names of the tensors being processed in the
 /// current timestamp.
+/// \param tensor_sizes Sizes of the tensors being processed.
 /// \param bytes Total size of the tensors.
 /// \return Whether the new parameters need to be broadcasted.
 bool ParameterManager::Update(const std::vector<std::string>& tensor_names,
+                              const std::vector<int64_t>& tensor_sizes,
                               int64_t bytes) {
-  if (!active_) {
+  if (!IsSampling()) {
     return false;
   }
 
+  // The model is known once a tensor is processed for the second time. All
+  // ranks see the same tensors, so they all broadcast the warm-started
+  // parameters in the same cycle.
+  if (!warm_start_file_.empty() && !model_observed_) {
+    for (size_t i = 0; i < tensor_names.size(); ++i) {
+      if (!model_tensors_.emplace(tensor_names[i], tensor_sizes[i]).second) {
+        model_observed_ = true;
+        break;
+      }
+    }
+    if (model_observed_) {
+      // 64-bit FNV-1a hash of the tensor names and sizes.
+      uint64_t hash = 14695981039346656037ULL;
+      for (auto& tensor : model_tensors_) {
+        std::string s = tensor.first + '\0' + std::to_string(tensor.second) + '\n';
+        for (unsigned char c : s) {
+          hash = (hash ^ c) * 1099511628211ULL;
+        }
+      }
+      std::ostringstream key;
+      key << std::hex << std::setw(16) << std::setfill('0') << hash;
+      warm_start_key_ = key.str();
+      model_tensors_.clear();
+
+      warm_start_pending_ = true;
+      return true;
+    }
+  }
+
   for (const std::string& tensor_name : tensor_names) {
     int32_t step = tensor_counts_[tensor_name]++;
     if (step >= (sample_ + 1) * steps_per_sample_) {
       auto now = std::chrono::steady_clock::now();
       double duration = std::chrono::duration_cast<std::chrono::microseconds>(now - last_sample_start_).count();
-      scores_[sample_] = total_bytes_ / duration;
+      scores_[sample_] = step_time_score_ ? StepTimeScore(duration) : total_bytes_ / duration;
 
       total_bytes_ = 0;
       last_sample_start_ = now;
@@ -164,56 +301,137 @@ bool ParameterManager::Update(const std::vector<std::string>& tensor_names,
   if (sample_ >= SAMPLES) {
     std::sort(scores_, scores_ + SAMPLES);
     double med_score = scores_[SAMPLES / 2];
-    return Tune(med_score);
+    if (active_ && warmup_remaining_ > 0) {
+      // Ignore this score as we're still warming up.
+      warmup_remaining_--;
+      if (rank_ == root_rank_) {
+        LOG(INFO) << "Autotuner: Warming up (" << warmup_remaining_ << " remaining)";
+      }
+      // Prepare for the next round of collecting statistics.
+      Reset();
+      return false;
+    }
+
+    if (active_) {
+      // The coordinator tunes with this score once the parameters are sent.
+      pending_score_ = med_score;
+      return true;
+    }
+
+    // Only the coordinator watches the score of the best parameters, it
+    // sends them alone once they drifted.
+    bool drifted = rank_ == root_rank_ && MonitorDrift(med_score);
+    Reset();
+    return drifted;
   }
 
   return false;
 }
 
+/// Apply the warm start or the score that made Update return true. Only
+/// called on the coordinator, right before the parameters are sent to the
+/// other ranks.
+void ParameterManager::CompleteUpdate() {
+  if (warm_start_pending_) {
+    warm_start_pending_ = false;
+    LoadWarmStart();
+  } else if (active_) {
+    Tune(pending_score_);
+  } else {
+    Retune();
+  }
+}
+
 /// Tune the parameters based on the score
 /// \param score The score for current timestamp
-/// \return Whether the parameter should be broadcast to other ranks.
-bool ParameterManager::Tune(double score) {
-  if (warmup_remaining_ > 0) {
-    // Ignore this score as we're still warming up.
-    warmup_remaining_--;
-    if (rank_ == root_rank_) {
-      LOG(INFO) << "Autotuner: Warming up (" << warmup_remaining_ << " remaining)";
+void ParameterManager::Tune(double score) {
+  // Log the last parameter values before updating.
+  LogParameters(score);
+
+  bool finished_tuning = true;
+  double best_score = score;
+  for (auto* param : parameter_chain_) {
+    double new_best_score;
+    bool finished = param->Tune(best_score, &new_best_score);
+    best_score = new_best_score;
+
+    if (!finished) {
+      finished_tuning = false;
+      break;
     }
-  } else {
-    // Log the last parameter values before updating.
-    LogParameters(score);
-
-    // Only do the tuning on the coordinator to ensure consistency.
-    if (rank_ == root_rank_) {
-      bool finished_tuning = true;
-      double best_score = score;
-      for (auto* param : parameter_chain_) {
-        double new_best_score;
-        bool finished = param->Tune(best_score, &new_best_score);
-        best_score = new_best_score;
-
-        if (!finished) {
-          finished_tuning = false;
-          break;
-        }
-      }
+  }
 
-      if (finished_tuning) {
-        SetAutoTuning(false);
-        LogBestParameters();
-      }
-    }
+  if (finished_tuning) {
+    SetAutoTuning(false);
+    LogBestParameters();
+    reference_score_ = 0;
+    drift_count_ = 0;
+  }
 
-    // Send the updated parameter values to other workers.
-    return true;
+  if (!warm_start_key_.empty()) {
+    SaveWarmStart(finished_tuning);
   }
+}
 
-  // Prepare for the next round of collecting statistics.
-  Reset();
+/// Watch the score of the best parameters once tuning finished.
+/// \param score The score for current timestamp
+/// \return Whether the score drifted and a re-tune should start.
+bool ParameterManager::MonitorDrift(double score) {
+  if (reference_score_ <= 0) {
+    reference_score_ = score;
+    LOG(INFO) << "Autotuner: Reference score of the best params " << score;
+  } else if (score < reference_score_ * (1 - drift_threshold_)) {
+    ++drift_count_;
+    LOG(DEBUG) << "Autotuner: Score " << score << " is below the reference "
+               << reference_score_ << " (" << drift_count_ << " of "
+               << drift_samples_ << ")";
+  } else {
+    drift_count_ = 0;
+  }
+
+  if (drift_count_ >= drift_samples_) {
+    LOG(INFO) << "Autotuner: Score dropped from " << reference_score_
+              << " to " << score << ", re-tuning";
+    return true;
+  }
   return false;
 }
 
+/// Re-tune the fusion threshold and cycle time from their best values, with
+/// the categorical parameters fixed at their best values so that the search
+/// stays short.
+void ParameterManager::Retune() {
+  if (hierarchical_allreduce_.IsTunable()) {
+    hierarchical_allreduce_.SetValue(hierarchical_allreduce_.BestValue(), true);
+  }
+  if (hierarchical_allgather_.IsTunable()) {
+    hierarchical_allgather_.SetValue(hierarchical_allgather_.BestValue(), true);
+  }
+  if (cache_enabled_.IsTunable()) {
+    cache_enabled_.SetValue(cache_enabled_.BestValue(), true);
+  }
+  if (gloo_bcube_threshold_.IsTunable()) {
+    gloo_bcube_threshold_.SetValue(gloo_bcube_threshold_.BestValue(), true);
+  }
+  if (libra_group_scale_.IsTunable()) {
+    libra_group_scale_.SetValue(libra_group_scale_.BestValue(), true);
+  }
+  if (libra_block_scale_.IsTunable()) {
+    libra_block_scale_.SetValue(libra_block_scale_.BestValue(), true);
+  }
+  if (libra_thread_num_.IsTunable()) {
+    libra_thread_num_.SetValue(libra_thread_num_.BestValue(), true);
+  }
+  if (libra_streams_.IsTunable()) {
+    libra_streams_.SetValue(libra_streams_.BestValue(), true);
+  }
+  joint_params_.Restart(drift_retune_samples_);
+
+  reference_score_ = 0;
+  drift_count_ = 0;
+  SetAutoTuning(true);
+}
+
 ParameterManager::Params ParameterManager::GetParams() {
   Params params;
   if (active_) {
@@ -221,6 +439,11 @@ ParameterManager::Params ParameterManager::GetParams() {
     params.hierarchical_allreduce = hierarchical_allreduce_.Value();
     params.hierarchical_allgather = hierarchical_allgather_.Value();
     params.cache_enabled = cache_enabled_.Value();
+    params.gloo_bcube_threshold = gloo_bcube_threshold_.Value();
+    params.libra_group_scale = libra_group_scale_.Value();
+    params.libra_block_scale = libra_block_scale_.Value();
+    params.libra_thread_num = libra_thread_num_.Value();
+    params.libra_streams = libra_streams_.Value();
     params.tensor_fusion_threshold = joint_params_.Value(fusion_buffer_threshold_mb);
     params.cycle_time = joint_params_.Value(cycle_time_ms);
   } else {
@@ -228,6 +451,11 @@ ParameterManager::Params ParameterManager::GetParams() {
     params.hierarchical_allreduce = hierarchical_allreduce_.BestValue();
     params.hierarchical_allgather = hierarchical_allgather_.BestValue();
     params.cache_enabled = cache_enabled_.BestValue();
+    params.gloo_bcube_threshold = gloo_bcube_threshold_.BestValue();
+    params.libra_group_scale = libra_group_scale_.BestValue();
+    params.libra_block_scale = libra_block_scale_.BestValue();
+    params.libra_thread_num = libra_thread_num_.BestValue();
+    params.libra_streams = libra_streams_.BestValue();
     params.tensor_fusion_threshold = joint_params_.BestValue(fusion_buffer_threshold_mb);
     params.cycle_time = joint_params_.BestValue(cycle_time_ms);
   }
@@ -241,9 +469,15 @@ void ParameterManager::SetParams(const Params& newParams) {
   hierarchical_allreduce_.SetValue(newParams.hierarchical_allreduce, true);
   hierarchical_allgather_.SetValue(newParams.hierarchical_allgather, true);
   cache_enabled_.SetValue(newParams.cache_enabled, true);
+  gloo_bcube_threshold_.SetValue(newParams.gloo_bcube_threshold, true);
+  libra_group_scale_.SetValue(newParams.libra_group_scale, true);
+  libra_block_scale_.SetValue(newParams.libra_block_scale, true);
+  libra_thread_num_.SetValue(newParams.libra_thread_num, true);
+  libra_streams_.SetValue(newParams.libra_streams, true);
   joint_params_.SetValue(fusion_buffer_threshold_mb, newParams.tensor_fusion_threshold, true);
   joint_params_.SetValue(cycle_time_ms, newParams.cycle_time, true);
-  active_ = newParams.active;
+  // Warm up again like the coordinator when a re-tune starts.
+  SetAutoTuning(newParams.active);
 }
 
 void ParameterManager::Reset() {
@@ -251,6 +485,36 @@ void ParameterManager::Reset() {
   last_sample_start_ = std::chrono::steady_clock::now();
   tensor_counts_.clear();
   sample_ = 0;
+  StartStepSample();
+}
+
+/// Score by the steps completed between the last step of the previous sample
+/// and the last step of this one, so that the time spent on computation that
+/// is not overlapped with communication counts too.
+/// \param duration Duration of the sample in microseconds.
+/// \return Steps completed per second.
+double ParameterManager::StepTimeScore(double duration) {
+  std::lock_guard<std::mutex> guard(step_mutex_);
+  double score;
+  auto steps = steps_completed_ - sample_start_steps_;
+  auto step_time = std::chrono::duration_cast<std::chrono::microseconds>(
+      last_step_end_ - sample_start_step_end_).count();
+  if (steps > 0 && sample_start_steps_ > 0 && step_time > 0) {
+    score = steps * 1e6 / step_time;
+  } else {
+    // No steps were reported, every tensor was processed steps_per_sample_
+    // times during the sample.
+    score = steps_per_sample_ * 1e6 / duration;
+  }
+  sample_start_steps_ = steps_completed_;
+  sample_start_step_end_ = last_step_end_;
+  return score;
+}
+
+void ParameterManager::StartStepSample() {
+  std::lock_guard<std::mutex> guard(step_mutex_);
+  sample_start_steps_ = steps_completed_;
+  sample_start_step_end_ = last_step_end_;
 }
 
 void ParameterManager::LogParameters(double score) {
@@ -259,6 +523,11 @@ void ParameterManager::LogParameters(double score) {
               << hierarchical_allreduce_.Value() << ", "
               << hierarchical_allgather_.Value() << ", "
               << cache_enabled_.Value() << ", "
+              << gloo_bcube_threshold_.Value() << " bytes, "
+              << libra_group_scale_.Value() << ", "
+              << libra_block_scale_.Value() << ", "
+              << libra_thread_num_.Value() << ", "
+              << libra_streams_.Value() << ", "
               << joint_params_.Value(cycle_time_ms) << " ms, "
               << joint_params_.Value(fusion_buffer_threshold_mb) << " mb] "
               << score;
@@ -266,6 +535,11 @@ void ParameterManager::LogParameters(double score) {
       file_ << hierarchical_allreduce_.Value() << ","
             << hierarchical_allgather_.Value() << ","
             << cache_enabled_.Value() << ","
+            << gloo_bcube_threshold_.Value() << ","
+            << libra_group_scale_.Value() << ","
+            << libra_block_scale_.Value() << ","
+            << libra_thread_num_.Value() << ","
+            << libra_streams_.Value() << ","
             << joint_params_.Value(cycle_time_ms) << ","
             << joint_params_.Value(fusion_buffer_threshold_mb) << ","
             << score
@@ -280,6 +554,11 @@ void ParameterManager::LogBestParameters() {
               << hierarchical_allreduce_.BestValue() << ", "
               << hierarchical_allgather_.BestValue() << ", "
               << cache_enabled_.BestValue() << ", "
+              << gloo_bcube_threshold_.BestValue() << " bytes, "
+              << libra_group_scale_.BestValue() << ", "
+              << libra_block_scale_.BestValue() << ", "
+              << libra_thread_num_.BestValue() << ", "
+              << libra_streams_.BestValue() << ", "
               << joint_params_.BestValue(cycle_time_ms) << " ms, "
               << joint_params_.BestValue(fusion_buffer_threshold_mb) << " mb] "
               << hierarchical_allreduce_.BestScore();
@@ -287,6 +566,11 @@ void ParameterManager::LogBestParameters() {
       file_ << hierarchical_allreduce_.BestValue() << ","
             << hierarchical_allgather_.BestValue() << ","
             << cache_enabled_.BestValue() << ","
+            << gloo_bcube_threshold_.BestValue() << ","
+            << libra_group_scale_.BestValue() << ","
+            << libra_block_scale_.BestValue() << ","
+            << libra_thread_num_.BestValue() << ","
+            << libra_streams_.BestValue() << ","
             << joint_params_.BestValue(cycle_time_ms) << ","
             << joint_params_.BestValue(fusion_buffer_threshold_mb) << ","
             << hierarchical_allreduce_.BestScore()
@@ -295,6 +579,162 @@ void ParameterManager::LogBestParameters() {
   }
 }
 
+void ParameterManager::LoadWarmStart() {
+  std::ifstream file(warm_start_file_);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream record(line);
+    std::string key;
+    std::string topology;
+    bool finished;
+    double best_score;
+    record >> key >> topology >> finished >> best_score;
+    if (!record || key != warm_start_key_ || topology != topology_) {
+      continue;
+    }
+
+    bool hierarchical_allreduce;
+    bool hierarchical_allgather;
+    bool cache_enabled;
+    int64_t gloo_bcube_threshold;
+    double libra_group_scale;
+    double libra_block_scale;
+    int libra_thread_num;
+    int libra_streams;
+    double cycle_time;
+    double tensor_fusion_threshold;
+    record >> hierarchical_allreduce >> hierarchical_allgather >> cache_enabled
+           >> gloo_bcube_threshold >> libra_group_scale >> libra_block_scale
+           >> libra_thread_num >> libra_streams >> cycle_time
+           >> tensor_fusion_threshold;
+
+    int dims = 0;
+    int num_observations = 0;
+    record >> dims >> num_observations;
+    std::vector<std::pair<Eigen::VectorXd, double>> observations;
+    for (int i = 0; record && i < num_observations; ++i) {
+      Eigen::VectorXd x(dims);
+      for (int j = 0; j < dims; ++j) {
+        record >> x(j);
+      }
+      double y;
+      record >> y;
+      observations.emplace_back(x, y);
+    }
+    if (!record) {
+      LOG(WARNING) << "Autotuner: Ignoring malformed warm start record in "
+                   << warm_start_file_ << ".";
+      return;
+    }
+
+    if (finished) {
+      // Values fixed by the user for this run take precedence.
+      if (hierarchical_allreduce_.IsTunable()) {
+        hierarchical_allreduce_.SetValue(hierarchical_allreduce, false);
+      }
+      if (hierarchical_allgather_.IsTunable()) {
+        hierarchical_allgather_.SetValue(hierarchical_allgather, false);
+      }
+      if (cache_enabled_.IsTunable()) {
+        cache_enabled_.SetValue(cache_enabled, false);
+      }
+      if (gloo_bcube_threshold_.IsTunable()) {
+        gloo_bcube_threshold_.SetValue(gloo_bcube_threshold, false);
+      }
+      if (libra_group_scale_.IsTunable()) {
+        libra_group_scale_.SetValue(libra_group_scale, false);
+      }
+      if (libra_block_scale_.IsTunable()) {
+        libra_block_scale_.SetValue(libra_block_scale, false);
+      }
+      if (libra_thread_num_.IsTunable()) {
+        libra_thread_num_.SetValue(libra_thread_num, false);
+      }
+      if (libra_streams_.IsTunable()) {
+        libra_streams_.SetValue(libra_streams, false);
+      }
+      if (!joint_params_.IsFixed(cycle_time_ms)) {
+        joint_params_.SetValue(cycle_time_ms, cycle_time, false);
+      }
+      if (!joint_params_.IsFixed(fusion_buffer_threshold_mb)) {
+        joint_params_.SetValue(
+            fusion_buffer_threshold_mb,
+            std::min(tensor_fusion_threshold, max_threshold_mb_), false);
+      }
+      SetAutoTuning(false);
+      LOG(INFO) << "Autotuner: Using the parameters tuned by an earlier run "
+                << "with score " << best_score << " from " << warm_start_file_;
+      LogBestParameters();
+    } else {
+      joint_params_.WarmStart(observations);
+      LOG(INFO) << "Autotuner: Continuing from " << observations.size()
+                << " samples of an earlier run from " << warm_start_file_;
+    }
+    return;
+  }
+}
+
+void ParameterManager::SaveWarmStart(bool finished) {
+  // Keep the records of other models and topologies.
+  std::vector<std::string> records;
+  {
+    std::ifstream file(warm_start_file_);
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream record(line);
+      std::string key;
+      std::string topology;
+      record >> key >> topology;
+      if (record && (key != warm_start_key_ || topology != topology_)) {
+        records.push_back(line);
+      }
+    }
+  }
+
+  double best_score = 0;
+  for (auto* param : parameter_chain_) {
+    best_score = std::max(best_score, param->BestScore());
+  }
+
+  std::ostringstream record;
+  record << std::setprecision(std::numeric_limits<double>::max_digits10)
+         << warm_start_key_ << " " << topology_ << " " << finished << " "
+         << best_score << " "
+         << hierarchical_allreduce_.BestValue() << " "
+         << hierarchical_allgather_.BestValue() << " "
+         << cache_enabled_.BestValue() << " "
+         << gloo_bcube_threshold_.BestValue() << " "
+         << libra_group_scale_.BestValue() << " "
+         << libra_block_scale_.BestValue() << " "
+         << libra_thread_num_.BestValue() << " "
+         << libra_streams_.BestValue() << " "
+         << joint_params_.BestValue(cycle_time_ms) << " "
+         << joint_params_.BestValue(fusion_buffer_threshold_mb);
+  auto& observations = joint_params_.Observations();
+  record << " " << (observations.empty() ? 0 : observations[0].first.size())
+         << " " << observations.size();
+  for (auto& observation : observations) {
+    for (int j = 0; j < observation.first.size(); ++j) {
+      record << " " << observation.first(j);
+    }
+    record << " " << observation.second;
+  }
+  records.push_back(record.str());
+
+  // Replace the file at once so that a killed run does not truncate it.
+  std::string tmp_file_name = warm_start_file_ + ".tmp";
+  std::ofstream file(tmp_file_name, std::ios::out | std::ios::trunc);
+  for (auto& r : records) {
+    file << r << std::endl;
+  }
+  file.close();
+  if (!file.good() ||
+      std::rename(tmp_file_name.c_str(), warm_start_file_.c_str()) != 0) {
+    LOG(WARNING) << "Autotuner: Failed to write warm start file "
+                 << warm_start_file_ << ".";
+  }
+}
+
 // TunableParameter
 template <class T>
 ParameterManager::TunableParameter<T>::TunableParameter(T initial_value) :
@@ -405,7 +845,8 @@ ParameterManager::BayesianParameter::BayesianParameter(
     test_points_(test_points),
     max_samples_(max_samples),
     gaussian_process_noise_(gaussian_process_noise),
-    iteration_(0) {
+    iteration_(0),
+    first_search_done_(false) {
   ResetBayes();
   Reinitialize(FilterTestPoint(0));
   ResetState();
@@ -451,8 +892,81 @@ double ParameterManager::BayesianParameter::BestValue(BayesianVariable variable)
   return TunableParameter::BestValue()(index_.at(variable));
 }
 
+bool ParameterManager::BayesianParameter::IsFixed(BayesianVariable variable) const {
+  return fixed_values_.find(variable) != fixed_values_.end();
+}
+
+void ParameterManager::BayesianParameter::WarmStart(
+    const std::vector<std::pair<Eigen::VectorXd, double>>& observations) {
+  if (index_.empty()) {
+    return;
+  }
+
+  uint32_t added = 0;
+  for (auto& observation : observations) {
+    // Samples of a run that fixed other variables are not comparable.
+    if (observation.first.size() != (int64_t)index_.size()) {
+      continue;
+    }
+    bayes_->AddSample(observation.first, observation.second);
+    observations_.push_back(observation);
+    ++added;
+  }
+
+  if (added > 0) {
+    iteration_ = added;
+    if (iteration_ < test_points_.size()) {
+      TunableParameter::SetCurrentValue(FilterTestPoint(iteration_));
+    } else {
+      TunableParameter::SetCurrentValue(bayes_->NextSample());
+    }
+  }
+}
+
+void ParameterManager::BayesianParameter::Restart(int max_samples) {
+  Eigen::VectorXd best(variables_.size());
+  for (size_t j = 0; j < variables_.size(); ++j) {
+    best(j) = BestValue(variables_[j].variable);
+  }
+  test_points_ = std::vector<Eigen::VectorXd>{best};
+  max_samples_ = max_samples;
+  Reinitialize(FilterTestPoint(0));
+  ResetState();
+}
+
+void ParameterManager::BayesianParameter::LimitUpperBound(
+    BayesianVariable variable, double max_value) {
+  for (size_t j = 0; j < variables_.size(); ++j) {
+    auto& bounds = variables_[j].bounds;
+    if (variables_[j].variable != variable || bounds.second <= max_value) {
+      continue;
+    }
+    bounds.second = std::max(bounds.first, max_value);
+    for (auto& test_point : test_points_) {
+      test_point(j) = std::min(test_point(j), bounds.second);
+    }
+  }
+
+  // Clamp the current, best and initial values, which come from the test
+  // points or from the defaults.
+  auto i = index_.at(variable);
+  Eigen::VectorXd v = TunableParameter::Value();
+  v(i) = std::min(v(i), max_value);
+  TunableParameter::SetCurrentValue(v);
+  v = TunableParameter::BestValue();
+  v(i) = std::min(v(i), max_value);
+  TunableParameter::SetBestValue(v);
+  v = TunableParameter::InitialValue();
+  v(i) = std::min(v(i), max_value);
+  TunableParameter::SetInitialValue(v);
+  ResetBayes();
+}
+
 void ParameterManager::BayesianParameter::OnTune(double score, Eigen::VectorXd& value) {
   bayes_->AddSample(value, score);
+  if (!first_search_done_) {
+    observations_.emplace_back(value, score);
+  }
 
   ++iteration_;
   if (iteration_ < test_points_.size()) {
@@ -467,6 +981,9 @@ bool ParameterManager::BayesianParameter::IsDoneTuning() const {
 }
 
 void ParameterManager::BayesianParameter::ResetState() {
+  if (iteration_ > 0) {
+    first_search_done_ = true;
+  }
   iteration_ = 0;
   bayes_->Clear();
 }
@@ -19,7 +19,9 @@
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -47,6 +49,25 @@ public:
   // Initializes this manager if auto tuning was requested.
   void Initialize(int32_t rank, int32_t root_rank, const std::string& file_name);
 
+  // Warm-starts the tuning from the results of earlier runs stored in
+  // file_name, and stores the results of this run there. Runs are matched by
+  // the names and sizes of their allreduced tensors and by topology.
+  void SetWarmStartFile(const std::string& file_name,
+                        const std::string& topology);
+
+  // Scores samples by the training steps completed per second, as reported
+  // by StepCompleted, instead of the bytes processed per second.
+  void SetStepTimeScore(bool step_time_score);
+
+  // Records that the framework completed a training step. Can be called from
+  // any thread.
+  void StepCompleted();
+
+  // Limits the fusion thresholds tried so that num_buffers fusion buffers
+  // per device and reserved_bytes of other buffers fit into budget_bytes.
+  void SetMemoryBudget(int64_t budget_bytes, int num_buffers,
+                       int64_t reserved_bytes);
+
   // Starts or stop the auto tuning procedure.
   void SetAutoTuning(bool active);
 
@@ -55,6 +76,12 @@ public:
     return active_;
   }
 
+  // Returns true if samples are scored, either to tune the parameters or to
+  // detect that the best parameters got worse once tuning finished.
+  inline bool IsSampling() const {
+    return active_ || (autotune_enabled_ && drift_threshold_ > 0);
+  }
+
   // Do hierarchical allreduce.
   bool HierarchicalAllreduce() const;
   void SetHierarchicalAllreduce(bool value, bool fixed=false);
@@ -77,20 +104,51 @@ public:
   bool CacheEnabled() const;
   void SetCacheEnabled (bool enabled, bool fixed=false);
 
+  // Gloo allreduces of up to this many bytes use the bcube algorithm, larger
+  // ones the ring algorithm.
+  int64_t GlooBcubeThresholdBytes() const;
+  void SetGlooBcubeThresholdBytes(int64_t threshold, bool fixed=false);
+
+  // Factor applied to the tensor count and byte budget of every Libra fusion
+  // group.
+  double LibraGroupScale() const;
+  void SetLibraGroupScale(double scale, bool fixed=false);
+
+  // Factor applied to the blocks of every Libra fusion group.
+  double LibraBlockScale() const;
+  void SetLibraBlockScale(double scale, bool fixed=false);
+
+  // Threads per block of every Libra fusion group, 0 keeps those of the
+  // group specification or the channel allocator.
+  int LibraThreadNum() const;
+  void SetLibraThreadNum(int thread_num, bool fixed=false);
+
+  // Number of streams the allreduces rotate over, 0 follows
+  // HOROVOD_STREAM_ASSIGNMENT.
+  int LibraStreams() const;
+  void SetLibraStreams(int streams, bool fixed=false);
+
   // Observes that the given tensors have been processed (e.g., allreduced) over the given number of microseconds.
   //
   // Args:
   //  tensor_names: The names of the tensors that have been processed.
+  //  tensor_sizes: The size in bytes of each of the tensors.
   //  bytes: The number of bytes that were processed per worker.
   //
   // Return:
   //  Whether the parameters need to be broadcasted to all ranks.
-  bool Update(const std::vector<std::string>& tensor_names, int64_t bytes);
+  bool Update(const std::vector<std::string>& tensor_names,
+              const std::vector<int64_t>& tensor_sizes, int64_t bytes);
 
   struct Params {
     bool hierarchical_allreduce;
     bool hierarchical_allgather;
     bool cache_enabled;
+    int64_t gloo_bcube_threshold;
+    double libra_group_scale;
+    double libra_block_scale;
+    int libra_thread_num;
+    int libra_streams;
     double tensor_fusion_threshold;
     double cycle_time;
     bool active;
@@ -101,17 +159,37 @@ public:
   // Using given params to update its own params.
   void SetParams(const Params& newParams);
 
+  // Tunes the parameters once Update returned true. Only called on the
+  // coordinator, right before GetParams is sent to the other ranks.
+  void CompleteUpdate();
+
   // Resets the tuning state in preparation for evaluating a new set of parameter values.
   void Reset();
 
 private:
   // Adjusts the parameter values based on the last observed score.
-  bool Tune(double score);
+  void Tune(double score);
+
+  // Compares the score of the best parameters to the one measured right after
+  // tuning, and returns true after drift_samples_ worse samples in a row.
+  // Retune then starts the re-tune.
+  bool MonitorDrift(double score);
+  void Retune();
+
+  // Returns the steps completed per second since the previous sample, and
+  // starts the next one.
+  double StepTimeScore(double duration);
+  void StartStepSample();
 
   // Outputs parameter values and writes results to a log file (if provided).
   void LogParameters(double score);
   void LogBestParameters();
 
+  // Applies the results stored for warm_start_key_, and stores those of this
+  // run. Only called on the coordinator.
+  void LoadWarmStart();
+  void SaveWarmStart(bool finished);
+
   // Interface used to represent a parameter (or group of parameters) being tuned.
   class ITunableParameter {
   public:
@@ -191,6 +269,20 @@ private:
     void SetValue(BayesianVariable variable, double value, bool fixed);
     double Value(BayesianVariable variable) const;
     double BestValue(BayesianVariable variable) const;
+    bool IsFixed(BayesianVariable variable) const;
+
+    // The samples scored by the first search, which runs with the categorical
+    // parameters at their initial values, including those of earlier runs.
+    inline const std::vector<std::pair<Eigen::VectorXd, double>>& Observations() const {
+      return observations_;
+    };
+    // Adds the samples of an earlier run to the optimizer, so that it
+    // continues from them instead of the test points.
+    void WarmStart(const std::vector<std::pair<Eigen::VectorXd, double>>& observations);
+    // Starts a new search of max_samples samples from the best value.
+    void Restart(int max_samples);
+    // Lowers the upper bound of the variable, and the values tried so far.
+    void LimitUpperBound(BayesianVariable variable, double max_value);
 
   private:
     void OnTune(double score, Eigen::VectorXd& value);
@@ -206,6 +298,8 @@ private:
     double gaussian_process_noise_;
 
     uint32_t iteration_;
+    std::vector<std::pair<Eigen::VectorXd, double>> observations_;
+    bool first_search_done_;
 
     struct EnumClassHash {
       template <typename T>
@@ -225,24 +319,55 @@ private:
   CategoricalParameter<bool> hierarchical_allreduce_;
   CategoricalParameter<bool> hierarchical_allgather_;
   CategoricalParameter<bool> cache_enabled_;
+  CategoricalParameter<int64_t> gloo_bcube_threshold_;
+  CategoricalParameter<double> libra_group_scale_;
+  CategoricalParameter<double> libra_block_scale_;
+  CategoricalParameter<int> libra_thread_num_;
+  CategoricalParameter<int> libra_streams_;
   BayesianParameter joint_params_;
 
   std::vector<ITunableParameter*> parameter_chain_;
   bool active_;
+  bool autotune_enabled_;
   int32_t warmup_remaining_;
 
   static constexpr int SAMPLES = 5;
   double scores_[SAMPLES];
   int32_t sample_;
+  double pending_score_;
 
   int64_t total_bytes_;
   std::chrono::steady_clock::time_point last_sample_start_;
   std::unordered_map<std::string, int32_t> tensor_counts_;
 
+  double drift_threshold_;
+  int drift_samples_;
+  int drift_retune_samples_;
+  double reference_score_;
+  int drift_count_;
+
+  bool step_time_score_;
+  std::mutex step_mutex_;
+  int64_t steps_completed_;
+  std::chrono::steady_clock::time_point last_step_end_;
+  int64_t sample_start_steps_;
+  std::chrono::steady_clock::time_point sample_start_step_end_;
+
   int32_t rank_;
   int32_t root_rank_;
   std::ofstream file_;
   bool writing_;
+
+  // Largest fusion threshold within the memory budget.
+  double max_threshold_mb_;
+
+  std::string warm_start_file_;
+  std::string topology_;
+  // Tensors of the first step, until one of them is processed again.
+  std::map<std::string, int64_t> model_tensors_;
+  bool model_observed_;
+  bool warm_start_pending_;
+  std::string warm_start_key_;
 };
 
 } // namespace common
@@ -0,0 +1,66 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "process_set.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace horovod {
+namespace common {
+
+bool ProcessSetTable::Parse(const std::string& spec, int size) {
+  sets_.clear();
+  std::stringstream sets(spec);
+  std::string set;
+  while (std::getline(sets, set, ';')) {
+    std::vector<int> ranks;
+    std::stringstream entries(set);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+      char* end;
+      long rank = std::strtol(entry.c_str(), &end, 10);
+      if (end == entry.c_str() || *end != '\0' || rank < 0 || rank >= size) {
+        sets_.clear();
+        return false;
+      }
+      ranks.push_back((int)rank);
+    }
+    std::sort(ranks.begin(), ranks.end());
+    if (ranks.empty() ||
+        std::adjacent_find(ranks.begin(), ranks.end()) != ranks.end()) {
+      sets_.clear();
+      return false;
+    }
+    sets_.push_back(std::move(ranks));
+  }
+  return true;
+}
+
+int ProcessSetTable::RankInSet(int32_t id, int rank) const {
+  if (id == 0) {
+    return rank;
+  }
+  auto& ranks = sets_[id - 1];
+  auto it = std::lower_bound(ranks.begin(), ranks.end(), rank);
+  if (it == ranks.end() || *it != rank) {
+    return -1;
+  }
+  return (int)(it - ranks.begin());
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,59 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_PROCESS_SET_H
+#define HOROVOD_PROCESS_SET_H
+
+#include <string>
+#include <vector>
+
+namespace horovod {
+namespace common {
+
+// Subsets of the ranks that run collectives among themselves, next to the
+// collectives of all ranks. The sets are numbered from 1 in the order of
+// their specification, 0 stands for all ranks.
+//
+// The sets are static, each rank parses the same specification, e.g.
+// "0,1;2,3" for two sets of two ranks.
+class ProcessSetTable {
+public:
+  // Replaces the sets with the ones of spec, returns false and keeps no sets
+  // if spec names a rank outside [0, size) or a rank twice in a set.
+  bool Parse(const std::string& spec, int size);
+
+  void Clear() { sets_.clear(); }
+
+  int NumSets() const { return (int)sets_.size(); }
+
+  // Whether id is 0 or the ID of a set.
+  bool IsValid(int32_t id) const { return id >= 0 && id <= NumSets(); }
+
+  // Ranks of the set in ascending order, only for IDs of sets.
+  const std::vector<int>& Ranks(int32_t id) const { return sets_[id - 1]; }
+
+  int Size(int32_t id) const { return (int)sets_[id - 1].size(); }
+
+  // Position of rank in the set, -1 if it is no member.
+  int RankInSet(int32_t id, int rank) const;
+
+private:
+  std::vector<std::vector<int>> sets_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_PROCESS_SET_H
@@ -15,8 +15,11 @@
 
 #include "response_cache.h"
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
+#include <fstream>
+#include <functional>
 
 #include "controller.h"
 #include "logging.h"
@@ -25,39 +28,67 @@
 namespace horovod {
 namespace common {
 
+// Marks the files written by ResponseCache::save.
+#define RESPONSE_CACHE_FILE_MAGIC 0x48564443
+
 void ResponseCache::clear() {
+  ++generation_;
   bits_outdated_ = false;
   cache_.clear();
   cache_iters_.clear();
   tensor_name_to_bit_.clear();
+  capacity_ = configured_capacity_;
 }
 
 void ResponseCache::set_capacity(uint32_t capacity) {
   // Clear cache in case set_capacity is called multiple times if autotuning.
   // Only clear if capacity is modified.
-  if (capacity != capacity_) {
+  if (capacity != configured_capacity_) {
     this->clear();
+    configured_capacity_ = capacity;
+    capacity_ = capacity;
+    cache_iters_.reserve(capacity);
   }
+}
 
-  capacity_ = capacity;
-  cache_iters_.reserve(capacity);
+void ResponseCache::set_max_capacity(uint32_t max_capacity) {
+  max_capacity_ = max_capacity;
 }
 
 uint32_t ResponseCache::capacity() const { return capacity_; }
 
+void ResponseCache::set_dynamic_shapes(bool dynamic_shapes) {
+  dynamic_shapes_ = dynamic_shapes;
+}
+
+bool ResponseCache::dynamic_shapes() const { return dynamic_shapes_; }
+
+bool ResponseCache::shape_agnostic(const Response& response) const {
+  return dynamic_shapes_ &&
+         (response.response_type() == Response::ALLREDUCE ||
+          response.response_type() == Response::ADASUM);
+}
+
 size_t ResponseCache::num_active_bits() const { return cache_iters_.size(); }
 
 ResponseCache::CacheState ResponseCache::cached(const Request& message) const {
+  uint32_t cache_bit;
+  return cached(message, cache_bit);
+}
+
+ResponseCache::CacheState ResponseCache::cached(const Request& message,
+                                                uint32_t& cache_bit) const {
   auto it = tensor_name_to_bit_.find(message.tensor_name());
   if (it != tensor_name_to_bit_.end()) {
     // If entry associated with this request already exists in cache, check
     // if tensor parameters match. If not, return that entry is invalid.
-    uint32_t cache_bit = it->second;
+    cache_bit = it->second;
     auto& cache_response = std::get<0>(*cache_iters_[cache_bit]);
     auto& cache_params = std::get<1>(*cache_iters_[cache_bit]);
     return (cache_params.device == message.device() &&
             cache_params.dtype == message.tensor_type() &&
-            cache_params.shape == message.tensor_shape() &&
+            (cache_params.shape == message.tensor_shape() ||
+             shape_agnostic(cache_response)) &&
             cache_response.prescale_factor() == message.prescale_factor() &&
             cache_response.postscale_factor() == message.postscale_factor())
                ? CacheState::HIT
@@ -80,7 +111,9 @@ ResponseCache::cached(const Response& response,
     auto& cache_params = std::get<1>(*cache_iters_[cache_bit]);
 
     bool same_shape;
-    if (joined) {
+    if (shape_agnostic(cache_response)) {
+      same_shape = true;
+    } else if (joined) {
       // For Joined rank only number of elements in the tensor is known.
       auto product = [](const std::vector<int64_t>& shape) {
         return std::accumulate(shape.begin(), shape.end(), 1,
@@ -121,16 +154,28 @@ void ResponseCache::put_(const Response& response, TensorParams& params, bool jo
     // (most recently used) and update iterator in cache_iters_
     // at the existing cache bit position.
     cache_bit = tensor_name_to_bit_[response.tensor_names()[0]];
-    auto it = cache_iters_[cache_bit];
-    cache_.push_front(std::move(*it));
-    cache_.erase(it);
+    cache_.splice(cache_.begin(), cache_, cache_iters_[cache_bit]);
+    if (shape_agnostic(response)) {
+      // Keep the sizes of the last negotiation.
+      cache_.front() = std::make_pair(response, std::move(params));
+    }
+  } else if (cache_.size() == capacity_ && capacity_ < max_capacity_) {
+    // Every rank caches the same responses in the same order, so all of them
+    // grow at the same time and keep the same cache bits.
+    capacity_ = std::min(max_capacity_, capacity_ * 2);
+    cache_iters_.reserve(capacity_);
+    tensor_name_to_bit_.reserve(capacity_);
+    LOG(DEBUG) << "Response cache capacity grown to " << capacity_ << ".";
+    cache_bit = cache_iters_.size();
+    cache_iters_.resize(cache_bit + 1);
+    cache_.push_front(std::make_pair(response, std::move(params)));
   } else if (cache_.size() == capacity_) {
     if (print_warning_) {
       std::stringstream message;
       message << "A response has been evicted from cache which may indicate "
                  "reduced performance. Better performance may be obtained by "
                  "disabling caching (HOROVOD_CACHE_CAPACITY=0) or increasing "
-                 "the cache capacity (HOROVOD_CACHE_CAPACITY>"
+                 "the maximum cache capacity (HOROVOD_CACHE_CAPACITY_MAX>"
               << std::to_string(capacity_) << ").";
       LOG(WARNING) << message.str();
       print_warning_ = false;
@@ -154,7 +199,7 @@ void ResponseCache::put_(const Response& response, TensorParams& params, bool jo
 
   cache_iters_[cache_bit] = cache_.begin();
   tensor_name_to_bit_[response.tensor_names()[0]] = cache_bit;
-
+  ++generation_;
 }
 
 void ResponseCache::put(const Response& response, TensorQueue& tensor_queue, bool joined) {
@@ -167,8 +212,11 @@ void ResponseCache::put(const Response& response, TensorQueue& tensor_queue, boo
 
   std::vector<TensorTableEntry> entries_for_join;
   if (joined) {
-    tensor_queue.GetTensorEntriesFromResponse(response, entries_for_join,
-                                              joined);
+    auto status = tensor_queue.GetTensorEntriesFromResponse(
+        response, entries_for_join, joined);
+    if (!status.ok()) {
+      return;
+    }
   }
 
   // If response is fused, split back into individual responses
@@ -183,6 +231,7 @@ void ResponseCache::put(const Response& response, TensorQueue& tensor_queue, boo
       new_response.set_tensor_type(response.tensor_type());
       new_response.set_prescale_factor(response.prescale_factor());
       new_response.set_postscale_factor(response.postscale_factor());
+      new_response.set_priority(response.priority());
 
       // Populate tensor parameters from tensor_queue entry
       TensorParams params;
@@ -211,13 +260,10 @@ void ResponseCache::put(const Response& response, TensorQueue& tensor_queue, boo
 const Response& ResponseCache::get_response(uint32_t cache_bit) {
   assert(cache_bit < cache_iters_.size());
 
-  // Access entry from iterator at cache_bit position. Entry
-  // is moved to front of cache and iterator at the cache_bit
-  // position is updated.
-  auto it = cache_iters_[cache_bit];
-  cache_.push_front(std::move(*it));
-  cache_.erase(it);
-  cache_iters_[cache_bit] = cache_.begin();
+  // Access entry from iterator at cache_bit position. Entry is moved to
+  // front of cache, splicing keeps the iterator at the cache_bit position
+  // valid without reallocating the entry.
+  cache_.splice(cache_.begin(), cache_, cache_iters_[cache_bit]);
 
   return cache_.front().first;
 }
@@ -262,6 +308,14 @@ void ResponseCache::erase_response(uint32_t cache_bit) {
   // Set flag to trigger update_cache_bits to remove empty
   // positions in cache_iters_ vector
   bits_outdated_ = true;
+  ++generation_;
+}
+
+void ResponseCache::set_tensor_size(uint32_t cache_bit, int64_t tensor_size) {
+  assert(cache_bit < cache_iters_.size());
+  auto& response = cache_iters_[cache_bit]->first;
+  assert(shape_agnostic(response));
+  response.set_tensor_sizes(std::vector<int64_t>{tensor_size});
 }
 
 void ResponseCache::update_cache_bits() {
@@ -289,6 +343,108 @@ void ResponseCache::update_cache_bits() {
   bits_outdated_ = false;
 }
 
+template <class T>
+static void WriteValue(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+static bool ReadValue(std::ifstream& file, T& value) {
+  return (bool)file.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+void ResponseCache::save(const std::string& file_name, int size) const {
+  // Erased entries leave positions without a response until
+  // update_cache_bits runs.
+  assert(!bits_outdated_);
+
+  // Replace the file at once so that a killed run does not truncate it.
+  std::string tmp_file_name = file_name + ".tmp";
+  std::ofstream file(tmp_file_name,
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+  WriteValue(file, (uint32_t)RESPONSE_CACHE_FILE_MAGIC);
+  WriteValue(file, (int32_t)size);
+  WriteValue(file, (uint32_t)cache_iters_.size());
+  std::string bytes;
+  for (auto& it : cache_iters_) {
+    Response::SerializeToString(it->first, bytes);
+    WriteValue(file, (uint32_t)bytes.size());
+    file.write(bytes.data(), bytes.size());
+    auto& params = it->second;
+    WriteValue(file, (int32_t)params.dtype);
+    WriteValue(file, params.device);
+    WriteValue(file, (uint32_t)params.shape.size());
+    for (auto dim : params.shape) {
+      WriteValue(file, dim);
+    }
+  }
+  file.close();
+  if (!file.good() ||
+      std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) {
+    LOG(WARNING) << "Failed to write response cache file " << file_name
+                 << ".";
+  }
+}
+
+bool ResponseCache::load(const std::string& file_name, int size) {
+  std::ifstream file(file_name, std::ios::in | std::ios::binary);
+  uint32_t magic;
+  int32_t file_size;
+  uint32_t count;
+  if (capacity_ == 0 || !ReadValue(file, magic) ||
+      magic != RESPONSE_CACHE_FILE_MAGIC || !ReadValue(file, file_size) ||
+      file_size != size || !ReadValue(file, count)) {
+    return false;
+  }
+
+  std::vector<std::pair<Response, TensorParams>> entries(count);
+  std::string bytes;
+  for (auto& entry : entries) {
+    uint32_t length;
+    int32_t dtype;
+    uint32_t ndims;
+    if (!ReadValue(file, length)) {
+      return false;
+    }
+    bytes.resize(length);
+    if (!file.read(&bytes[0], length) || !ReadValue(file, dtype) ||
+        !ReadValue(file, entry.second.device) || !ReadValue(file, ndims)) {
+      return false;
+    }
+    Response::ParseFromBytes(entry.first, (const uint8_t*)bytes.data());
+    entry.second.dtype = (DataType)dtype;
+    entry.second.shape.resize(ndims);
+    for (auto& dim : entry.second.shape) {
+      if (!ReadValue(file, dim)) {
+        return false;
+      }
+    }
+    if (entry.first.tensor_names().size() != 1) {
+      return false;
+    }
+  }
+
+  // Entries are put in the order of their bits, which keeps them.
+  this->clear();
+  for (auto& entry : entries) {
+    this->put_(entry.first, entry.second);
+  }
+  return true;
+}
+
+uint64_t ResponseCache::fingerprint() const {
+  std::hash<std::string> hash;
+  uint64_t result = cache_iters_.size();
+  std::string bytes;
+  for (auto& it : cache_iters_) {
+    Response::SerializeToString(it->first, bytes);
+    result = result * 31 + hash(bytes);
+  }
+  return result;
+}
+
+uint64_t ResponseCache::generation() const { return generation_; }
+
 CacheCoordinator::CacheCoordinator(size_t num_active_bits) {
   num_active_bits_ = num_active_bits;
 }
@@ -298,6 +454,17 @@ void CacheCoordinator::record_hit(uint32_t bit) {
   cache_hits_.insert(bit);
 }
 
+void CacheCoordinator::erase_hit(uint32_t bit) {
+  assert(synced_);
+  cache_hits_.erase(bit);
+}
+
+void CacheCoordinator::renegotiate_hit(uint32_t bit) {
+  assert(synced_);
+  cache_hits_.erase(bit);
+  uncached_in_queue_ = true;
+}
+
 void CacheCoordinator::record_invalid_bit(uint32_t bit) {
   assert(!synced_);
   invalid_bits_.insert(bit);
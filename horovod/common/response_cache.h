@@ -19,6 +19,7 @@
 #include <cassert>
 #include <list>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -53,12 +54,27 @@ public:
 
   void set_capacity(uint32_t capacity);
 
+  // The capacity doubles, up to max_capacity, instead of evicting entries.
+  void set_max_capacity(uint32_t max_capacity);
+
   uint32_t capacity() const;
 
+  // Allreduce and Adasum entries match requests of any shape. The actual
+  // sizes are agreed on in each cycle, see Controller::SyncCachedTensorSizes.
+  void set_dynamic_shapes(bool dynamic_shapes);
+
+  bool dynamic_shapes() const;
+
+  // Whether the shape of a tensor is left out of the entry of a response.
+  bool shape_agnostic(const Response& response) const;
+
   size_t num_active_bits() const;
 
   CacheState cached(const Request& message) const;
 
+  // Also returns the cache bit of a HIT or INVALID entry.
+  CacheState cached(const Request& message, uint32_t& cache_bit) const;
+
   CacheState cached(const Response& response, const TensorParams& params,
                     bool joined = false) const;
 
@@ -77,13 +93,33 @@ public:
 
   void erase_response(uint32_t cache_bit);
 
+  // Sets the number of elements of a shape agnostic entry.
+  void set_tensor_size(uint32_t cache_bit, int64_t tensor_size);
+
   void update_cache_bits();
 
+  // Writes the cached responses and their tensor parameters in the order of
+  // their cache bits, for a job of the given size.
+  void save(const std::string& file_name, int size) const;
+
+  // Replaces the entries with the ones saved to file_name by a job of the same
+  // size, with the same cache bits. Returns false if there are none.
+  bool load(const std::string& file_name, int size);
+
+  // Hash of the cached responses in the order of their bits, which is the
+  // same on all ranks whose caches agree.
+  uint64_t fingerprint() const;
+
+  // Changes whenever entries are added or removed.
+  uint64_t generation() const;
+
 private:
   void put_(const Response& response, TensorParams& params,
             bool joined = false);
 
   uint32_t capacity_ = 0;
+  uint32_t configured_capacity_ = 0;
+  uint32_t max_capacity_ = 0;
 
   // List containing cached entries. Each entry in the cache is a pair
   // of a Response and a TensorParams struct.
@@ -99,6 +135,10 @@ private:
   bool bits_outdated_ = false;
 
   bool print_warning_ = true;
+
+  bool dynamic_shapes_ = false;
+
+  uint64_t generation_ = 0;
 };
 
 // Helper class to coordinate cache and state information
@@ -110,6 +150,13 @@ public:
 
   void record_hit(uint32_t bit);
 
+  // Removes a common hit, after sync(), that is handled on its own.
+  void erase_hit(uint32_t bit);
+
+  // Removes a common hit, after sync(), whose request all ranks send to the
+  // coordinator instead.
+  void renegotiate_hit(uint32_t bit);
+
   void record_invalid_bit(uint32_t bit);
 
   void set_should_shut_down(bool should_shut_down);
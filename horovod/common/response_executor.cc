@@ -0,0 +1,82 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "response_executor.h"
+
+namespace horovod {
+namespace common {
+
+void ResponseExecutor::Start(std::function<void(const Response&)> perform,
+                             std::function<void()> thread_init) {
+  perform_ = std::move(perform);
+  shut_down_ = false;
+  thread_ = std::thread([this, thread_init] {
+    if (thread_init) {
+      thread_init();
+    }
+    Loop();
+  });
+}
+
+void ResponseExecutor::Enqueue(const ResponseList& response_list) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& response : response_list.responses()) {
+      queue_.push_back(response);
+    }
+  }
+  cond_.notify_all();
+}
+
+void ResponseExecutor::Drain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return queue_.empty() && !busy_; });
+}
+
+void ResponseExecutor::Stop() {
+  if (!IsRunning()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    shut_down_ = true;
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+void ResponseExecutor::Loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this] { return !queue_.empty() || shut_down_; });
+    if (queue_.empty()) {
+      // Shut down only once every enqueued response has been performed.
+      break;
+    }
+    Response response = std::move(queue_.front());
+    queue_.pop_front();
+    busy_ = true;
+    lock.unlock();
+    perform_(response);
+    lock.lock();
+    busy_ = false;
+    if (queue_.empty()) {
+      cond_.notify_all();
+    }
+  }
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,70 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_RESPONSE_EXECUTOR_H
+#define HOROVOD_RESPONSE_EXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Performs negotiated responses on an execution thread, one at a time and in
+// the order they were enqueued, so that the background thread can negotiate
+// the next cycle while the responses of the previous ones are performed.
+class ResponseExecutor {
+public:
+  ResponseExecutor() = default;
+  ResponseExecutor(const ResponseExecutor&) = delete;
+
+  bool IsRunning() const { return thread_.joinable(); }
+
+  // Starts the execution thread, which calls perform for every response.
+  // thread_init, if set, runs first on the thread.
+  void Start(std::function<void(const Response&)> perform,
+             std::function<void()> thread_init = nullptr);
+
+  void Enqueue(const ResponseList& response_list);
+
+  // Waits until every enqueued response has been performed.
+  void Drain();
+
+  // Performs the enqueued responses and stops the execution thread.
+  void Stop();
+
+private:
+  void Loop();
+
+  std::function<void(const Response&)> perform_;
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Response> queue_;
+  // True while a response taken from the queue is being performed.
+  bool busy_ = false;
+  bool shut_down_ = false;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_RESPONSE_EXECUTOR_H
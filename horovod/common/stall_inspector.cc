@@ -23,6 +23,13 @@
 namespace horovod {
 namespace common {
 
+// Weight of the latest tensor in the rolling straggler scores, so that they
+// average over roughly the last hundred tensors of each rank.
+#define STRAGGLER_SCORE_WEIGHT 0.01
+
+// Straggler scores are written to the timeline at most this often.
+#define STRAGGLER_REPORT_INTERVAL std::chrono::seconds(1)
+
 bool StallInspector::CheckForStalledTensors(int global_size) {
   bool should_shut_down = false;
   auto now = std::chrono::steady_clock::now();
@@ -38,26 +45,26 @@ bool StallInspector::CheckForStalledTensors(int global_size) {
     stall_shutdown_time = std::chrono::seconds(0);
   }
 
-  for (auto& m : uncached_tensor_table) {
-    auto tensor_name = m.first;
-    std::vector<int>& ranks = std::get<0>(m.second);
-    std::chrono::steady_clock::time_point start_at = std::get<1>(m.second);
-    auto lag = now - start_at;
+  for (auto& tensor_name : uncached_tensor_order) {
+    auto& entry = uncached_tensor_table.at(tensor_name);
+    auto lag = now - entry.start_at;
+    if (lag <= stall_warning_time) {
+      // All the following tensors were seen later.
+      break;
+    }
 
-    if (lag > stall_warning_time) {
-      std::unordered_set<int32_t> ready_ranks;
-      for (auto rank : ranks) {
-        ready_ranks.insert(rank);
-      }
+    std::unordered_set<int32_t> ready_ranks;
+    for (auto rank : entry.ranks) {
+      ready_ranks.insert(rank);
+    }
 
-      for (int32_t rank = 0; rank < global_size; ++rank) {
-        if (ready_ranks.find(rank) == ready_ranks.end()) {
-          missing_ranks[rank].insert(tensor_name);
-          if (stall_shutdown_time > std::chrono::seconds(0) &&
-              lag > stall_shutdown_time) {
-            shutdown_ranks.insert(rank);
-            should_shut_down = true;
-          }
+    for (int32_t rank = 0; rank < global_size; ++rank) {
+      if (ready_ranks.find(rank) == ready_ranks.end()) {
+        missing_ranks[rank].insert(tensor_name);
+        if (stall_shutdown_time > std::chrono::seconds(0) &&
+            lag > stall_shutdown_time) {
+          shutdown_ranks.insert(rank);
+          should_shut_down = true;
         }
       }
     }
@@ -114,47 +121,91 @@ void StallInspector::InvalidateStalledCachedTensors(
   auto now = std::chrono::steady_clock::now();
   std::chrono::seconds stall_warning_time(stall_warning_time_seconds);
 
-  for (auto& entry : cached_tensor_table) {
+  for (auto& tensor_name : cached_tensor_order) {
     // If pending time for cached tensor exceeds stall_warning_time, mark entry
     // for global removal from cache to trigger stall messaging.
-    if (now - entry.second > stall_warning_time) {
-      uint32_t cache_bit = response_cache_.peek_cache_bit(entry.first);
-      cache_coordinator.record_invalid_bit(cache_bit);
-      cache_coordinator.set_uncached_in_queue(true);
+    if (now - cached_tensor_table.at(tensor_name).start_at <=
+        stall_warning_time) {
+      // All the following tensors were seen later.
+      break;
     }
+    uint32_t cache_bit = response_cache_.peek_cache_bit(tensor_name);
+    cache_coordinator.record_invalid_bit(cache_bit);
+    cache_coordinator.set_uncached_in_queue(true);
   }
 }
 
 void StallInspector::RecordUncachedTensorStart(const std::string& tensor_name,
                                                int rank, int global_size) {
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> lag(0);
   auto table_iter = uncached_tensor_table.find(tensor_name);
   if (table_iter == uncached_tensor_table.end()) {
-    std::vector<int> ranks = {rank};
-    ranks.reserve(static_cast<unsigned long>(global_size));
-    auto now = std::chrono::steady_clock::now();
-    uncached_tensor_table.emplace(tensor_name,
-                                  std::make_tuple(std::move(ranks), now));
+    UncachedTensorEntry entry;
+    entry.ranks.reserve(static_cast<unsigned long>(global_size));
+    entry.ranks.push_back(rank);
+    entry.start_at = now;
+    entry.order_iter =
+        uncached_tensor_order.insert(uncached_tensor_order.end(), tensor_name);
+    uncached_tensor_table.emplace(tensor_name, std::move(entry));
   } else {
-    std::vector<int>& ranks = std::get<0>(table_iter->second);
-    ranks.push_back(rank);
+    table_iter->second.ranks.push_back(rank);
+    lag = now - table_iter->second.start_at;
+  }
+
+  std::lock_guard<std::mutex> guard(straggler_mutex);
+  if (straggler_scores.size() != static_cast<size_t>(global_size)) {
+    straggler_scores.assign(global_size, 0);
   }
+  auto& score = straggler_scores[rank];
+  score += STRAGGLER_SCORE_WEIGHT * (lag.count() - score);
+  straggler_scores_updated = true;
+}
+
+std::vector<double> StallInspector::GetStragglerScores() {
+  std::lock_guard<std::mutex> guard(straggler_mutex);
+  return straggler_scores;
+}
+
+bool StallInspector::ShouldReportStragglerScores() {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> guard(straggler_mutex);
+  if (!straggler_scores_updated ||
+      now - last_straggler_report < STRAGGLER_REPORT_INTERVAL) {
+    return false;
+  }
+  straggler_scores_updated = false;
+  last_straggler_report = now;
+  return true;
 }
 
 void StallInspector::RecordCachedTensorStart(const std::string& tensor_name) {
   if (perform_stall_check &&
       cached_tensor_table.find(tensor_name) == cached_tensor_table.end()) {
-    cached_tensor_table[tensor_name] = std::chrono::steady_clock::now();
+    CachedTensorEntry entry;
+    entry.start_at = std::chrono::steady_clock::now();
+    entry.order_iter =
+        cached_tensor_order.insert(cached_tensor_order.end(), tensor_name);
+    cached_tensor_table.emplace(tensor_name, entry);
   }
 }
 
 void StallInspector::RemoveCachedTensor(const std::string& tensor_name) {
   if (perform_stall_check) {
-    cached_tensor_table.erase(tensor_name);
+    auto table_iter = cached_tensor_table.find(tensor_name);
+    if (table_iter != cached_tensor_table.end()) {
+      cached_tensor_order.erase(table_iter->second.order_iter);
+      cached_tensor_table.erase(table_iter);
+    }
   }
 }
 
 void StallInspector::RemoveUncachedTensor(const std::string& tensor_name) {
-  uncached_tensor_table.erase(tensor_name);
+  auto table_iter = uncached_tensor_table.find(tensor_name);
+  if (table_iter != uncached_tensor_table.end()) {
+    uncached_tensor_order.erase(table_iter->second.order_iter);
+    uncached_tensor_table.erase(table_iter);
+  }
 }
 
 bool StallInspector::ShouldPerformCheck() {
@@ -18,7 +18,10 @@
 
 #include <chrono>
 #include <iostream>
+#include <list>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "response_cache.h"
 
@@ -51,6 +54,16 @@ public:
   // Remove timing entry if cached or marked invalid.
   void RemoveCachedTensor(const std::string& tensor_name);
 
+  // Returns the straggler score of every rank: a rolling average, in seconds,
+  // of how long after the first ready rank its requests for a tensor reach
+  // the coordinator. Only the coordinator sees the requests of all ranks,
+  // other ranks return no scores.
+  std::vector<double> GetStragglerScores();
+
+  // Returns whether the straggler scores changed since they were last
+  // reported and were not reported during the last second.
+  bool ShouldReportStragglerScores();
+
   // Remove timing entry if uncached or marked invalid.
   void RemoveUncachedTensor(const std::string& tensor_name);
 
@@ -79,17 +92,37 @@ protected:
   // itself down if any rank is stalled for longer than this time.
   int stall_shutdown_time_seconds = 0;
 
+  // Every table keeps its tensors in a list ordered by the time they were
+  // first seen. All tensors stall after the same time, so the checks only
+  // walk the front of the list up to the first tensor that is not stalled
+  // yet, instead of every pending tensor.
+  struct CachedTensorEntry {
+    std::chrono::steady_clock::time_point start_at;
+    std::list<std::string>::iterator order_iter;
+  };
+
+  struct UncachedTensorEntry {
+    std::vector<int> ranks;
+    std::chrono::steady_clock::time_point start_at;
+    std::list<std::string>::iterator order_iter;
+  };
+
   // Initial time cached tensors are seen in queue. Used for stall message
   // handling.
-  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
-      cached_tensor_table;
-
-  // Initial time that tensors are seen in the normal message queue. The value
-  // consists of a list of ready ranks and the starting point.
-  std::unordered_map<
-      std::string,
-      std::tuple<std::vector<int>, std::chrono::steady_clock::time_point>>
-      uncached_tensor_table;
+  std::unordered_map<std::string, CachedTensorEntry> cached_tensor_table;
+  std::list<std::string> cached_tensor_order;
+
+  // Initial time that tensors are seen in the normal message queue, along
+  // with the list of ready ranks.
+  std::unordered_map<std::string, UncachedTensorEntry> uncached_tensor_table;
+  std::list<std::string> uncached_tensor_order;
+
+  // Straggler score of every rank, updated from RecordUncachedTensorStart.
+  std::vector<double> straggler_scores;
+  bool straggler_scores_updated = false;
+  std::chrono::steady_clock::time_point last_straggler_report;
+  // Guards straggler_scores, which are read from framework threads.
+  std::mutex straggler_mutex;
 
   // Outside dependencies
   ResponseCache& response_cache_;
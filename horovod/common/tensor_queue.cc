@@ -23,43 +23,146 @@
 namespace horovod {
 namespace common {
 
+TensorQueue::~TensorQueue() {
+  auto node = message_head_.exchange(nullptr);
+  while (node != nullptr) {
+    auto next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+size_t TensorQueue::GetShardIndex(const std::string& tensor_name) const {
+  return std::hash<std::string>()(tensor_name) % NUM_SHARDS;
+}
+
+void TensorQueue::PushMessageNodes(MessageNode* first, MessageNode* last) {
+  // The list is most recent first, so the last node is linked in front of
+  // the current head.
+  last->next = message_head_.load(std::memory_order_relaxed);
+  while (!message_head_.compare_exchange_weak(last->next, first,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+  }
+}
+
+void TensorQueue::NotifyTensorAdded() {
+  tensor_added_ = true;
+  // Either the waiting thread sees the flag before blocking, or it holds
+  // wait_mutex_ until it blocks and is notified here.
+  if (waiting_) {
+    std::lock_guard<std::mutex> guard(wait_mutex_);
+    tensor_added_cond_.notify_one();
+  }
+}
+
 // Add a TensorTableEntry as well as its message to the queue.
 Status TensorQueue::AddToTensorQueue(TensorTableEntry& e, Request& message) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (tensor_table_.find(e.tensor_name) != tensor_table_.end()) {
-    return DUPLICATE_NAME_ERROR;
+  {
+    auto& shard = GetShard(e.tensor_name);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (shard.tensor_table.find(e.tensor_name) != shard.tensor_table.end()) {
+      return DUPLICATE_NAME_ERROR;
+    }
+    if (trace_.IsEnabled()) {
+      trace_.Record(e.tensor_name, message.request_type(),
+                    e.tensor != nullptr ? e.tensor->size() : 0);
+    }
+    shard.tensor_table.emplace(e.tensor_name, std::move(e));
+    ++num_tensors_;
+  }
+  // The entry is in the table before the background thread can see its
+  // message.
+  auto node = new MessageNode{std::move(message), nullptr};
+  PushMessageNodes(node, node);
+  NotifyTensorAdded();
+  return Status::OK();
+}
+
+Status TensorQueue::AddToTensorQueueMulti(std::vector<TensorTableEntry>& entries,
+                                          std::vector<Request>& messages) {
+  if (entries.empty()) {
+    return Status::OK();
+  }
+
+  // Shards are locked in index order, so that concurrent calls cannot
+  // deadlock.
+  std::array<bool, NUM_SHARDS> used{};
+  for (auto& e : entries) {
+    used[GetShardIndex(e.tensor_name)] = true;
+  }
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    if (used[i]) {
+      locks.emplace_back(shards_[i].mutex);
+    }
+  }
+  for (auto& e : entries) {
+    auto& table = GetShard(e.tensor_name).tensor_table;
+    if (table.find(e.tensor_name) != table.end()) {
+      return DUPLICATE_NAME_ERROR;
+    }
+  }
+  if (trace_.IsEnabled()) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+      trace_.Record(entries[i].tensor_name, messages[i].request_type(),
+                    entries[i].tensor != nullptr ? entries[i].tensor->size()
+                                                 : 0);
+    }
   }
-  tensor_table_.emplace(e.tensor_name, std::move(e));
-  message_queue_.push(std::move(message));
+
+  MessageNode* first = nullptr;
+  MessageNode* last = nullptr;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    GetShard(entries[i].tensor_name)
+        .tensor_table.emplace(entries[i].tensor_name, std::move(entries[i]));
+    // Linked most recent first, like the list.
+    first = new MessageNode{std::move(messages[i]), first};
+    if (last == nullptr) {
+      last = first;
+    }
+  }
+  num_tensors_ += (int64_t)entries.size();
+  locks.clear();
+
+  PushMessageNodes(first, last);
+  NotifyTensorAdded();
   return Status::OK();
 }
 
 // Put callbacks for each tensor in the callback buffer and clear tensor queue
 void TensorQueue::FinalizeTensorQueue(
     std::vector<StatusCallback>& callbacks_buffer) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  for (auto& e : tensor_table_) {
-    callbacks_buffer.emplace_back(e.second.callback);
-  }
-  tensor_table_.clear();
-  while (!message_queue_.empty()) {
-    message_queue_.pop();
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    for (auto& e : shard.tensor_table) {
+      callbacks_buffer.emplace_back(e.second.callback);
+    }
+    num_tensors_ -= (int64_t)shard.tensor_table.size();
+    shard.tensor_table.clear();
   }
+  std::deque<Request> messages;
+  PopMessagesFromQueue(messages);
 }
 
-// Helper function to get list of allreduced tensor names and total size for
-// use with the autotuner.
+// Helper function to get list of allreduced tensor names, their sizes and
+// total size for use with the autotuner.
 int64_t
 TensorQueue::GetTensorDataForAutotuner(const ResponseList& response_list,
-                                       std::vector<std::string>& tensor_names) {
+                                       std::vector<std::string>& tensor_names,
+                                       std::vector<int64_t>& tensor_sizes) {
   int64_t total_tensor_size = 0;
   for (auto& response : response_list.responses()) {
     if (response.response_type() == Response::ResponseType::ALLREDUCE) {
       for (auto& tensor_name : response.tensor_names()) {
         tensor_names.push_back(tensor_name);
         LOG(TRACE) << "Looking for tensor with name " << tensor_name;
-        auto& entry = tensor_table_.at(tensor_name);
+        // Responses of earlier cycles may still be performed asynchronously.
+        auto& shard = GetShard(tensor_name);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto& entry = shard.tensor_table.at(tensor_name);
         LOG(TRACE) << "Found tensor with name " << tensor_name;
+        tensor_sizes.push_back(entry.tensor->size());
         total_tensor_size += entry.tensor->size();
       }
     }
@@ -69,60 +172,92 @@ TensorQueue::GetTensorDataForAutotuner(const ResponseList& response_list,
 
 // Parse tensor names from response and generate a vector of corresponding
 // tensor entries.
-void TensorQueue::GetTensorEntriesFromResponse(
+Status TensorQueue::GetTensorEntriesFromResponse(
     const Response& response, std::vector<TensorTableEntry>& entries,
     bool joined) {
   // Reserve to save re-allocation costs, as we know the size before.
   entries.reserve(response.tensor_names().size());
-  {
-    // Lock on the tensor table.
-    std::lock_guard<std::mutex> guard(mutex_);
-    int64_t i = 0;
-    for (auto& name : response.tensor_names()) {
-      assert(response.response_type() == Response::ALLREDUCE ||
-             response.response_type() == Response::ALLGATHER ||
-             response.response_type() == Response::BROADCAST ||
-             response.response_type() == Response::ALLTOALL ||
-             response.response_type() == Response::ADASUM ||
-             response.response_type() == Response::ERROR);
-
-      if (!joined) {
-        // We should never fail at finding this key in the tensor table.
-        auto iter = tensor_table_.find(name);
-        assert(iter != tensor_table_.end());
-
-        entries.push_back(std::move(iter->second));
-
-        // Clear the tensor table of this tensor.
-        tensor_table_.erase(iter);
-      } else if (response.response_type() != Response::ERROR) {
-
-        // Find Join tensor to use its context.
-        auto join_iter = tensor_table_.find(JOIN_TENSOR_NAME);
-        assert(join_iter != tensor_table_.end());
-
-        TensorTableEntry entry;
-        join_iter->second.context->AllocateZeros(response.tensor_sizes()[i],
-                                                 response.tensor_type(),
-                                                 &(entry.tensor));
-
-        entry.output = entry.tensor;
-        entry.device = join_iter->second.device;
-        entry.context = join_iter->second.context;
-        entry.tensor_name = name;
-        entries.push_back(std::move(entry));
+  int64_t i = 0;
+  for (auto& name : response.tensor_names()) {
+    assert(response.response_type() == Response::ALLREDUCE ||
+           response.response_type() == Response::ALLGATHER ||
+           response.response_type() == Response::BROADCAST ||
+           response.response_type() == Response::ALLTOALL ||
+           response.response_type() == Response::ADASUM ||
+           response.response_type() == Response::REDUCESCATTER ||
+           response.response_type() == Response::ERROR);
+
+    if (!joined) {
+      // Lock on the shard of the tensor.
+      auto& shard = GetShard(name);
+      std::lock_guard<std::mutex> guard(shard.mutex);
+
+      // We should never fail at finding this key in the tensor table.
+      auto iter = shard.tensor_table.find(name);
+      assert(iter != shard.tensor_table.end());
+
+      entries.push_back(std::move(iter->second));
+
+      // Clear the tensor table of this tensor.
+      shard.tensor_table.erase(iter);
+      --num_tensors_;
+    } else if (response.response_type() != Response::ERROR) {
+      // Find Join tensor to use its context.
+      auto& shard = GetShard(JOIN_TENSOR_NAME);
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      auto join_iter = shard.tensor_table.find(JOIN_TENSOR_NAME);
+      assert(join_iter != shard.tensor_table.end());
+
+      TensorTableEntry entry;
+      auto status = JoinedTensors(join_iter->second, response.tensor_type(),
+                                  response.tensor_sizes()[i], entry);
+      if (!status.ok()) {
+        return status;
       }
-      i++;
+
+      entry.device = join_iter->second.device;
+      entry.context = join_iter->second.context;
+      entry.tensor_name = name;
+      entries.push_back(std::move(entry));
     }
+    i++;
   }
+  return Status::OK();
+}
+
+Status TensorQueue::JoinedTensors(const TensorTableEntry& join_entry,
+                                  DataType dtype, int64_t num_elements,
+                                  TensorTableEntry& entry) {
+  auto key = std::make_pair(join_entry.device, dtype);
+  auto& zeros = join_zeros_[key];
+  if (zeros == nullptr || zeros->shape().num_elements() < num_elements) {
+    // The zeros are only read, so all tensors share them.
+    auto status =
+        join_entry.context->AllocateZeros(num_elements, dtype, &zeros);
+    if (!status.ok()) {
+      join_zeros_.erase(key);
+      return status;
+    }
+  }
+  // Responses on other streams or process sets may run at the same time, so
+  // the rank discards the results in outputs of their own.
+  std::shared_ptr<Tensor> output;
+  auto status = join_entry.context->AllocateZeros(num_elements, dtype, &output);
+  if (!status.ok()) {
+    return status;
+  }
+  entry.tensor = std::make_shared<TensorSlice>(zeros, 0, num_elements);
+  entry.output = output;
+  return Status::OK();
 }
 
 // Get tensor entry given a tensor name
 const TensorTableEntry&
 TensorQueue::GetTensorEntry(const std::string& tensor_name) const{
-  // Lock on the tensor table.
-  std::lock_guard<std::mutex> guard(mutex_);
-  auto& iter = tensor_table_.at(tensor_name);
+  // Lock on the shard of the tensor.
+  auto& shard = GetShard(tensor_name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto& iter = shard.tensor_table.at(tensor_name);
 
   return iter;
 }
@@ -130,41 +265,69 @@ TensorQueue::GetTensorEntry(const std::string& tensor_name) const{
 // Pop out all the messages from the queue
 void TensorQueue::PopMessagesFromQueue(
     std::deque<Request>& message_queue_buffer) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  while (!message_queue_.empty()) {
-    Request& message = message_queue_.front();
-    message_queue_buffer.push_back(std::move(message));
-    message_queue_.pop();
+  auto node = message_head_.exchange(nullptr, std::memory_order_acquire);
+  // Most recent first, so the messages are inserted back to front.
+  auto insert_at = message_queue_buffer.size();
+  while (node != nullptr) {
+    message_queue_buffer.insert(message_queue_buffer.begin() + insert_at,
+                                std::move(node->message));
+    auto next = node->next;
+    delete node;
+    node = next;
   }
 }
 
 // Push a message to message queue
 void TensorQueue::PushMessageToQueue(Request& message) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  message_queue_.push(std::move(message));
+  auto node = new MessageNode{std::move(message), nullptr};
+  PushMessageNodes(node, node);
 }
 
 // Push messages to message queue
 void TensorQueue::PushMessagesToQueue(
     std::deque<Request>& messages) {
-  std::lock_guard<std::mutex> guard(mutex_);
+  MessageNode* first = nullptr;
+  MessageNode* last = nullptr;
   while (!messages.empty()) {
-    Request& message = messages.front();
-    message_queue_.push(std::move(message));
+    first = new MessageNode{std::move(messages.front()), first};
+    if (last == nullptr) {
+      last = first;
+    }
     messages.pop_front();
   }
+  if (first != nullptr) {
+    PushMessageNodes(first, last);
+  }
+}
+
+bool TensorQueue::WaitForTensors(
+    std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  waiting_ = true;
+  tensor_added_cond_.wait_until(lock, deadline,
+                                [this] { return tensor_added_.load(); });
+  waiting_ = false;
+  return tensor_added_.exchange(false);
+}
+
+bool TensorQueue::IsIdle() const {
+  return num_tensors_ == 0 && message_head_.load() == nullptr;
 }
 
 // Remove JoinOp tensor from the table and execute the callback
 void TensorQueue::RemoveJoinTensor() {
-  // Lock on the tensor table.
-  std::lock_guard<std::mutex> guard(mutex_);
-  auto iter = tensor_table_.find(JOIN_TENSOR_NAME);
-  assert(iter != tensor_table_.end());
+  // Lock on the shard of the Join tensor.
+  auto& shard = GetShard(JOIN_TENSOR_NAME);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto iter = shard.tensor_table.find(JOIN_TENSOR_NAME);
+  assert(iter != shard.tensor_table.end());
   auto& e = iter->second;
   Status status;
   e.callback(status);
-  tensor_table_.erase(iter);
+  shard.tensor_table.erase(iter);
+  --num_tensors_;
+  // Allreduces still in flight hold on to their slices of the zeros.
+  join_zeros_.clear();
 }
 
 } // namespace common
@@ -16,50 +16,126 @@
 #ifndef HOROVOD_TENSOR_QUEUE_H
 #define HOROVOD_TENSOR_QUEUE_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 
 #include "common.h"
+#include "tensor_trace.h"
 
 namespace horovod {
 namespace common {
 
+// Framework threads enqueue tensors concurrently with the background thread
+// negotiating and performing them. The tensor table is split into shards
+// with their own lock, and messages are pushed onto a lock-free list that
+// the background thread takes at once, so that producers only contend with
+// each other when their tensors hash to the same shard.
 class TensorQueue {
 public:
   TensorQueue() = default;
   TensorQueue(const TensorQueue&) = delete;
+  ~TensorQueue();
   Status AddToTensorQueue(TensorTableEntry& e, Request& message);
 
+  // Adds all the entries at once, so that they are negotiated in the same
+  // cycle, or none of them if one of the names is already queued.
+  Status AddToTensorQueueMulti(std::vector<TensorTableEntry>& entries,
+                               std::vector<Request>& messages);
+
   void FinalizeTensorQueue(std::vector<StatusCallback>& callbacks_buffer);
 
   int64_t GetTensorDataForAutotuner(const ResponseList& response_list,
-                                    std::vector<std::string>& tensor_names);
+                                    std::vector<std::string>& tensor_names,
+                                    std::vector<int64_t>& tensor_sizes);
 
-  void GetTensorEntriesFromResponse(const Response& response,
-                                    std::vector<TensorTableEntry>& entries,
-                                    bool joined = false);
+  // Returns an error if the tensors of a joined rank cannot be allocated.
+  Status GetTensorEntriesFromResponse(const Response& response,
+                                      std::vector<TensorTableEntry>& entries,
+                                      bool joined = false);
 
   const TensorTableEntry& GetTensorEntry(const std::string& tensor_name) const;
 
+  TensorTrace& trace() { return trace_; }
+
   void PopMessagesFromQueue(std::deque<Request>& message_queue_buffer);
 
   void PushMessageToQueue(Request& message);
 
   void PushMessagesToQueue(std::deque<Request>& messages);
 
+  // Completes the Join tensor and releases the buffers of the allreduces
+  // performed while this rank was joined.
   void RemoveJoinTensor();
 
+  // Waits until a tensor is added to the queue or the deadline passes.
+  // Returns true if a tensor was added since the last call.
+  bool WaitForTensors(std::chrono::steady_clock::time_point deadline);
+
+  // Returns true if no tensor is waiting to be processed.
+  bool IsIdle() const;
+
 protected:
-  // Tensors waiting to be allreduced or allgathered.
-  std::unordered_map<std::string, TensorTableEntry> tensor_table_;
+  static constexpr size_t NUM_SHARDS = 16;
+
+  struct TensorTableShard {
+    // Tensors waiting to be allreduced or allgathered.
+    std::unordered_map<std::string, TensorTableEntry> tensor_table;
+    mutable std::mutex mutex;
+  };
+
+  struct MessageNode {
+    Request message;
+    MessageNode* next;
+  };
+
+  size_t GetShardIndex(const std::string& tensor_name) const;
+
+  TensorTableShard& GetShard(const std::string& tensor_name) {
+    return shards_[GetShardIndex(tensor_name)];
+  }
+
+  const TensorTableShard& GetShard(const std::string& tensor_name) const {
+    return shards_[GetShardIndex(tensor_name)];
+  }
+
+  // Pushes the nodes from first to last, linked through next, in order.
+  void PushMessageNodes(MessageNode* first, MessageNode* last);
+
+  // Signals the background thread if it waits for tensors.
+  void NotifyTensorAdded();
+
+  // Sets the input and output of an allreduce this rank contributes zeros
+  // to. The zeros are kept for the duration of the join, every entry gets an
+  // output of its own.
+  Status JoinedTensors(const TensorTableEntry& join_entry, DataType dtype,
+                       int64_t num_elements, TensorTableEntry& entry);
+
+  std::array<TensorTableShard, NUM_SHARDS> shards_;
+  std::atomic<int64_t> num_tensors_{0};
+
+  // MPI requests waiting to be sent to the coordinator node, most recent
+  // first.
+  std::atomic<MessageNode*> message_head_{nullptr};
+
+  // Guards waiting on tensor_added_cond_.
+  std::mutex wait_mutex_;
+  std::condition_variable tensor_added_cond_;
+  std::atomic_bool tensor_added_{false};
+  std::atomic_bool waiting_{false};
 
-  // Queue of MPI requests waiting to be sent to the coordinator node.
-  std::queue<Request> message_queue_;
+  // The zeros a joined rank reduces, and a buffer receiving the results it
+  // discards, per device and data type. Each is sized to the largest tensor
+  // so far and is only accessed by the background thread.
+  std::map<std::pair<int, DataType>, std::shared_ptr<Tensor>> join_zeros_;
 
-  // A mutex that needs to be used whenever operations on message queue are
-  // done.
-  mutable std::mutex mutex_;
+  TensorTrace trace_;
 };
 
 } // namespace common
@@ -0,0 +1,106 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "tensor_trace.h"
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+void TensorTrace::Initialize(const std::string& file_name, int rank,
+                             long long clock_offset_micros) {
+  if (enabled_ || file_name.empty()) {
+    return;
+  }
+  std::string path = file_name;
+  auto pos = path.find("%r");
+  if (pos != std::string::npos) {
+    path.replace(pos, 2, std::to_string(rank));
+  }
+  // Elastic jobs initialize Horovod again after a reset, the trace of the
+  // new workers is appended.
+  file_.open(path, std::ios::out | (continued_ ? std::ios::app : std::ios::trunc));
+  if (!file_.good()) {
+    LOG(ERROR) << "Error opening the Horovod tensor trace file " << path
+               << ", will not write a tensor trace.";
+    return;
+  }
+  if (!continued_) {
+    file_ << "step,rank,name,type,bytes,ready_us\n";
+  }
+
+  rank_ = rank;
+  start_time_ = std::chrono::steady_clock::now();
+  start_micros_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count() -
+                  clock_offset_micros;
+  step_tensors_.clear();
+  continued_ = true;
+  enabled_ = true;
+  LOG(INFO) << "Writing the tensor trace to " << path << ".";
+}
+
+void TensorTrace::Record(const std::string& tensor_name,
+                         Request::RequestType type, int64_t bytes) {
+  if (!enabled_) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> guard(mutex_);
+  pending_.push_back(TraceRecord{tensor_name, type, bytes, now});
+}
+
+void TensorTrace::Flush() {
+  if (!enabled_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    flushing_.swap(pending_);
+  }
+  if (flushing_.empty()) {
+    return;
+  }
+  for (auto& record : flushing_) {
+    if (!step_tensors_.insert(record.tensor_name).second) {
+      ++step_;
+      step_tensors_.clear();
+      step_tensors_.insert(record.tensor_name);
+    }
+    auto ready_us = start_micros_ +
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        record.ready_at - start_time_)
+                        .count();
+    file_ << step_ << ',' << rank_ << ',' << record.tensor_name << ','
+          << Request::RequestType_Name(record.type) << ',' << record.bytes
+          << ',' << ready_us << '\n';
+  }
+  flushing_.clear();
+  file_.flush();
+}
+
+void TensorTrace::Shutdown() {
+  if (!enabled_) {
+    return;
+  }
+  Flush();
+  enabled_ = false;
+  file_.close();
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,92 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_TENSOR_TRACE_H
+#define HOROVOD_TENSOR_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Records when every tensor is enqueued, to replay the arrival of the
+// tensors of a step offline against candidate fusion group plans. Set
+// HOROVOD_TENSOR_TRACE to the file to write, where %r is replaced by the rank.
+//
+// The trace is a CSV file with a line per tensor:
+//
+//   step,rank,name,type,bytes,ready_us
+//
+// ready_us are microseconds since the epoch, corrected by the clock offset of
+// the rank to the coordinator, so that the traces of all ranks line up. Steps
+// end when a tensor that was already enqueued in the current step is
+// enqueued again.
+class TensorTrace {
+public:
+  TensorTrace() = default;
+  TensorTrace(const TensorTrace&) = delete;
+  ~TensorTrace() { Shutdown(); }
+
+  void Initialize(const std::string& file_name, int rank,
+                  long long clock_offset_micros);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // Called by the framework threads as tensors are enqueued.
+  void Record(const std::string& tensor_name, Request::RequestType type,
+              int64_t bytes);
+
+  // Called by the background thread once per cycle, writes the tensors
+  // recorded since the last call.
+  void Flush();
+
+  void Shutdown();
+
+private:
+  struct TraceRecord {
+    std::string tensor_name;
+    Request::RequestType type;
+    int64_t bytes;
+    std::chrono::steady_clock::time_point ready_at;
+  };
+
+  std::atomic_bool enabled_{false};
+  int rank_ = 0;
+  std::chrono::steady_clock::time_point start_time_;
+  long long start_micros_ = 0;
+
+  std::mutex mutex_;
+  std::vector<TraceRecord> pending_;
+
+  // Only used by the background thread.
+  std::ofstream file_;
+  std::vector<TraceRecord> flushing_;
+  int64_t step_ = 0;
+  std::unordered_set<std::string> step_tensors_;
+  bool continued_ = false;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_TENSOR_TRACE_H
@@ -14,14 +14,25 @@
 
 #include "thread_pool.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace horovod {
 namespace common {
 
-void ThreadPool::create(int num_threads) {
-  running_ = true;
-  threads_.resize(num_threads);
+void ThreadPool::create(int num_threads,
+                        std::function<void(int)> thread_init) {
+  workers_.resize(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_[i].reset(new Worker());
+  }
   for (int i = 0; i < num_threads; ++i) {
-    threads_[i] = std::thread(&ThreadPool::loop, this);
+    workers_[i]->thread = std::thread([this, i, thread_init] {
+      if (thread_init) {
+        thread_init(i);
+      }
+      loop(i);
+    });
   }
 }
 
@@ -30,36 +41,128 @@ ThreadPool::~ThreadPool() {
 }
 
 void ThreadPool::execute(std::function<void(void)> f) {
+  std::vector<std::function<void(void)>> batch;
+  batch.push_back(std::move(f));
+  execute(std::move(batch));
+}
+
+void ThreadPool::execute(std::vector<std::function<void(void)>> batch) {
+  if (batch.empty()) {
+    return;
+  }
+  int num_workers = (int)workers_.size();
+  int first = (int)(next_worker_.fetch_add(1) % num_workers);
+  int num_targets = std::min(num_workers, (int)batch.size());
+  for (int t = 0; t < num_targets; ++t) {
+    auto& worker = *workers_[(first + t) % num_workers];
+    {
+      std::lock_guard<std::mutex> guard(worker.mutex);
+      for (size_t i = t; i < batch.size(); i += num_targets) {
+        worker.tasks.push_back(Task{std::move(batch[i]), true});
+      }
+    }
+    worker.cond.notify_one();
+  }
+  WakeIdle(-1);
+}
+
+void ThreadPool::execute(int thread_index, std::function<void(void)> f) {
+  auto& worker = *workers_[thread_index % workers_.size()];
   {
-    std::lock_guard<std::mutex> guard(mutex_);
-    work_queue_.push(f);
+    std::lock_guard<std::mutex> guard(worker.mutex);
+    worker.tasks.push_back(Task{std::move(f), false});
   }
-  cond_.notify_one();
+  worker.cond.notify_one();
 }
 
 void ThreadPool::reset() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  running_ = false;
-  cond_.notify_all();
-  lock.unlock();
+  for (auto& worker : workers_) {
+    std::lock_guard<std::mutex> guard(worker->mutex);
+    worker->running = false;
+    worker->cond.notify_all();
+  }
+
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+  workers_.clear();
+}
 
-  for (auto& thread: threads_) {
-    thread.join();
+bool ThreadPool::Steal(int worker_index, Task& task) {
+  int num_workers = (int)workers_.size();
+  for (int i = 1; i < num_workers; ++i) {
+    auto& victim = *workers_[(worker_index + i) % num_workers];
+    std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      continue;
+    }
+    // Work given to a particular thread stays there, the rest is taken from
+    // the back, away from the owner.
+    for (auto it = victim.tasks.rbegin(); it != victim.tasks.rend(); ++it) {
+      if (it->stealable) {
+        task = std::move(*it);
+        victim.tasks.erase(std::next(it).base());
+        return true;
+      }
+    }
   }
-  threads_.clear();
+  return false;
 }
 
-void ThreadPool::loop() {
-  while (running_) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    cond_.wait(lock, [this] {return !(running_ && work_queue_.empty());});
-    if (!running_) break;
+void ThreadPool::WakeIdle(int except) {
+  if (num_idle_.load() == 0) {
+    return;
+  }
+  for (int i = 0; i < (int)workers_.size(); ++i) {
+    if (i == except) {
+      continue;
+    }
+    auto& worker = *workers_[i];
+    std::lock_guard<std::mutex> guard(worker.mutex);
+    if (worker.idle) {
+      worker.steal = true;
+      worker.cond.notify_one();
+      return;
+    }
+  }
+}
 
-    auto f = work_queue_.front();
-    work_queue_.pop();
-    lock.unlock();
+void ThreadPool::loop(int worker_index) {
+  auto& worker = *workers_[worker_index];
+  while (true) {
+    Task task;
+    bool found = false;
+    {
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      if (!worker.running) break;
+      if (!worker.tasks.empty()) {
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        found = true;
+        // Others can take what is left while this thread is busy.
+        if (!worker.tasks.empty() && worker.tasks.back().stealable) {
+          lock.unlock();
+          WakeIdle(worker_index);
+        }
+      }
+    }
+    if (!found) {
+      found = Steal(worker_index, task);
+    }
+    if (found) {
+      task.f();
+      continue;
+    }
 
-    f();
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    worker.idle = true;
+    ++num_idle_;
+    worker.cond.wait(lock, [&worker] {
+      return !worker.running || !worker.tasks.empty() || worker.steal;
+    });
+    worker.steal = false;
+    worker.idle = false;
+    --num_idle_;
   }
 }
 
@@ -15,28 +15,61 @@
 #ifndef HOROVOD_THREAD_POOL_H
 #define HOROVOD_THREAD_POOL_H
 
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
-#include <queue>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 namespace horovod {
 namespace common {
+// Every thread runs the work given to it from its own deque. Work given to a
+// particular thread runs there in order. Other work is spread over the
+// threads, and idle threads steal it from the back of the busy ones, so a
+// burst of work does not line up behind one mutex.
 class ThreadPool {
   public:
     ~ThreadPool();
-    void create(int num_threads);
+    // thread_init, if set, runs first on every thread with its index.
+    void create(int num_threads,
+                std::function<void(int)> thread_init = nullptr);
     void reset();
+    int size() const { return (int)workers_.size(); }
+    // Runs f on any thread.
     void execute(std::function<void(void)> f);
+    // Runs every function of batch on any thread, taking the lock of every
+    // thread once.
+    void execute(std::vector<std::function<void(void)>> batch);
+    // Runs f on thread thread_index (modulo the number of threads), after the
+    // work given to that thread before.
+    void execute(int thread_index, std::function<void(void)> f);
 
   private:
-    void loop();
-    bool running_;
-    std::queue<std::function<void(void)>> work_queue_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
-    std::vector<std::thread> threads_;
+    struct Task {
+      std::function<void(void)> f;
+      bool stealable;
+    };
+
+    struct Worker {
+      std::deque<Task> tasks;
+      std::mutex mutex;
+      std::condition_variable cond;
+      bool running = true;
+      // Set to wake up an idle thread to steal.
+      bool steal = false;
+      bool idle = false;
+      std::thread thread;
+    };
+
+    void loop(int worker_index);
+    bool Steal(int worker_index, Task& task);
+    void WakeIdle(int except);
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<unsigned int> next_worker_{0};
+    std::atomic<int> num_idle_{0};
 };
 
 } // namespace common
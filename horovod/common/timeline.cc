@@ -83,6 +83,7 @@ void TimelineWriter::SetTimelineFile(std::string filename) {
       LOG(INFO) << "Closed timeline file:" << cur_filename_;
     }
     tensor_table_.clear();
+    string_table_.clear();
   }
   // if new filename is empty, we need to stop accepting activities. This would
   // stopping timeline
@@ -126,7 +127,11 @@ void TimelineWriter::SetTimelineFile(std::string filename) {
   }
 
   // all other cases, need to create a new file
-  file_.open(filename, std::ios::out | std::ios::trunc);
+  auto mode = std::ios::out | std::ios::trunc;
+  if (format_ == TimelineFormat::BINARY) {
+    mode |= std::ios::binary;
+  }
+  file_.open(filename, mode);
   if (file_.good()) {
     LOG(INFO) << "Opened new timeline file" << filename
               << " Set active and healthy to true";
@@ -145,7 +150,8 @@ void TimelineWriter::SetTimelineFile(std::string filename) {
 }
 
 void TimelineWriter::Initialize(
-    std::string file_name, std::chrono::steady_clock::time_point start_time_) {
+    std::string file_name, std::chrono::steady_clock::time_point start_time_,
+    long long clock_offset_micros) {
   std::lock_guard<std::recursive_mutex> guard(writer_mutex_);
   if (healthy_)
     return;
@@ -159,7 +165,7 @@ void TimelineWriter::Initialize(
       std::chrono::duration_cast<std::chrono::microseconds>(
           p1.time_since_epoch())
           .count() +
-      tt;
+      tt - clock_offset_micros;
   // Spawn writer thread.
   writer_thread_ = std::thread(&TimelineWriter::WriterLoop, this);
 }
@@ -180,6 +186,7 @@ void TimelineWriter::Shutdown() {
     file_.close();
   }
   tensor_table_.clear();
+  string_table_.clear();
 }
 
 void TimelineWriter::EnqueueWriteEvent(const std::string& tensor_name,
@@ -217,7 +224,19 @@ void TimelineWriter::EnqueueWriteMarker(const std::string& name,
     ;
 }
 
+void TimelineWriter::SetFormat(TimelineFormat format) {
+  std::lock_guard<std::recursive_mutex> guard(writer_mutex_);
+  format_ = format;
+}
+
 void TimelineWriter::WriteAtFileStart() {
+  if (format_ == TimelineFormat::BINARY) {
+    file_.write(BINARY_TIMELINE_MAGIC, sizeof(BINARY_TIMELINE_MAGIC) - 1);
+    int64_t start_time = start_time_since_epoch_utc_micros_;
+    file_.write(reinterpret_cast<const char*>(&start_time), sizeof(start_time));
+    return;
+  }
+
   file_ << "[\n";
 
   file_ << "{";
@@ -235,8 +254,54 @@ void TimelineWriter::WriteAtFileStart() {
   file_ << ", \"args\": {\"sort_index\": " << 0 << "}";
   file_ << "}," << std::endl;
 }
+int32_t TimelineWriter::InternString(const std::string& value) {
+  if (value.empty()) {
+    return -1;
+  }
+  auto it = string_table_.find(value);
+  if (it != string_table_.end()) {
+    return it->second;
+  }
+  int32_t id = (int32_t)string_table_.size();
+  string_table_.emplace(value, id);
+
+  BinaryTimelineRecord record{};
+  record.type = BinaryTimelineRecord::STRING;
+  record.tensor = id;
+  record.name = (int32_t)value.size();
+  file_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+  file_.write(value.data(), value.size());
+  return id;
+}
+
+void TimelineWriter::DoWriteBinaryRecord(BinaryTimelineRecord::Type type,
+                                         const TimelineRecord& r) {
+  if (is_new_file_) {
+    WriteAtFileStart();
+    is_new_file_ = false;
+  }
+  BinaryTimelineRecord record{};
+  record.ts_micros = r.ts_micros;
+  record.type = type;
+  if (type == BinaryTimelineRecord::EVENT) {
+    record.tensor = InternString(r.tensor_name);
+    record.name = InternString(r.op_name);
+    record.args = InternString(r.args);
+    record.phase = r.phase;
+  } else {
+    record.tensor = -1;
+    record.name = InternString(r.marker_name);
+    record.args = -1;
+  }
+  file_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
 void TimelineWriter::DoWriteEvent(const TimelineRecord& r) {
   assert(r.type == TimelineRecordType::EVENT);
+  if (format_ == TimelineFormat::BINARY) {
+    DoWriteBinaryRecord(BinaryTimelineRecord::EVENT, r);
+    return;
+  }
   if (is_new_file_) {
     WriteAtFileStart();
     is_new_file_ = false;
@@ -286,6 +351,10 @@ void TimelineWriter::DoWriteEvent(const TimelineRecord& r) {
 
 void TimelineWriter::DoWriteMarker(const TimelineRecord& r) {
   assert(r.type == TimelineRecordType::MARKER);
+  if (format_ == TimelineFormat::BINARY) {
+    DoWriteBinaryRecord(BinaryTimelineRecord::MARKER, r);
+    return;
+  }
   if (is_new_file_) {
     WriteAtFileStart();
     is_new_file_ = false;
@@ -339,17 +408,18 @@ void TimelineWriter::WriterLoop() {
   }
 }
 
-void Timeline::Initialize(std::string file_name, unsigned int horovod_size) {
-  if (initialized_) {
+void Timeline::Initialize(std::string file_name, unsigned int horovod_size,
+                          long long clock_offset_micros) {
+  if (writer_.IsHealthy()) {
     return;
   }
   start_time_ = std::chrono::steady_clock::now();
 
   // Start the writer.
-  writer_.Initialize(file_name, start_time_);
+  writer_.Initialize(file_name, start_time_, clock_offset_micros);
 
   // Initialize if we were able to open the file successfully.
-  initialized_ = writer_.IsHealthy();
+  initialized_ = writer_.IsHealthy() || nvtx_.IsEnabled();
 
   // Pre-initialize the string representation for each rank.
   rank_strings_ = std::vector<std::string>(horovod_size);
@@ -358,11 +428,26 @@ void Timeline::Initialize(std::string file_name, unsigned int horovod_size) {
   }
 }
 
+void Timeline::InitializeNvtx(unsigned int horovod_size) {
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  nvtx_.Initialize();
+  if (rank_strings_.size() != horovod_size) {
+    rank_strings_ = std::vector<std::string>(horovod_size);
+    for (unsigned int i = 0; i < horovod_size; i++) {
+      rank_strings_[i] = std::to_string(i);
+    }
+  }
+  initialized_ = writer_.IsHealthy() || nvtx_.IsEnabled();
+}
+
 void Timeline::Shutdown() {
   std::lock_guard<std::recursive_mutex> guard(mutex_);
   initialized_ = false;
   writer_.Shutdown();
+  nvtx_.Shutdown();
   tensor_states_.clear();
+  group_annotations_.clear();
+  open_tracks_.clear();
 }
 
 long Timeline::TimeSinceStartMicros() const {
@@ -374,15 +459,45 @@ long Timeline::TimeSinceStartMicros() const {
 // Write event to the Horovod Timeline file.
 void Timeline::WriteEvent(const std::string& tensor_name, const char phase,
                           const std::string& op_name, const std::string& args) {
+  // The NVTX ranges are balanced regardless of the sampling of the file,
+  // Nsight Systems chooses what it captures.
+  if (phase == 'B') {
+    nvtx_.TensorRangeStart(tensor_name, op_name);
+  } else if (phase == 'E') {
+    nvtx_.TensorRangeEnd(tensor_name);
+  }
+  if (!recording_) {
+    return;
+  }
   auto ts_micros = TimeSinceStartMicros();
   writer_.EnqueueWriteEvent(tensor_name, phase, op_name, args, ts_micros);
 }
 
 void Timeline::WriteMarker(const std::string& name) {
+  nvtx_.Mark(name);
+  if (!recording_) {
+    return;
+  }
   auto ts_micros = TimeSinceStartMicros();
   writer_.EnqueueWriteMarker(name, ts_micros);
 }
 
+void Timeline::StragglerScores(const std::vector<double>& scores) {
+  if (!initialized_) {
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  std::stringstream args;
+  for (size_t rank = 0; rank < scores.size(); ++rank) {
+    if (rank > 0) {
+      args << ", ";
+    }
+    args << "\"" << rank << "\": " << scores[rank];
+  }
+  WriteEvent("STRAGGLER_SCORES", 'C', "STRAGGLER_SCORE_SECONDS", args.str());
+}
+
 void Timeline::NegotiateStart(const std::string& tensor_name,
                               const Request::RequestType request_type) {
   if (!initialized_) {
@@ -441,29 +556,92 @@ void Timeline::Start(const std::string& tensor_name,
   tensor_states_[tensor_name] = TimelineState::TOP_LEVEL;
 }
 
+void Timeline::AnnotateGroup(const std::vector<TensorTableEntry>& entries,
+                             const std::string& activity,
+                             const TimelineGroup& group) {
+  if (!initialized_ || entries.empty()) {
+    return;
+  }
+
+  std::stringstream args;
+  args << "\"group\": " << group.group
+       << ", \"group_size\": " << group.num_tensors
+       << ", \"group_bytes\": " << group.bytes
+       << ", \"block_num\": " << group.block_num
+       << ", \"thread_num\": " << group.thread_num
+       << ", \"stream\": " << group.stream;
+
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  auto& annotation = group_annotations_[entries[0].tensor_name];
+  annotation.activity = activity;
+  annotation.args = args.str();
+  annotation.track = "LIBRA_STREAM_" + std::to_string(group.stream);
+}
+
 void Timeline::ActivityStartAll(const std::vector<TensorTableEntry>& entries,
                                 const std::string& activity) {
+  if (!initialized_ || entries.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  auto it = group_annotations_.find(entries[0].tensor_name);
+  if (it == group_annotations_.end() || it->second.activity != activity) {
+    for (auto& e : entries) {
+      ActivityStart(e.tensor_name, activity);
+    }
+    return;
+  }
+
+  auto& annotation = it->second;
   for (auto& e : entries) {
-    ActivityStart(e.tensor_name, activity);
+    ActivityStart(e.tensor_name, activity, annotation.args);
+  }
+  auto& open = open_tracks_[annotation.track];
+  if (!open.empty()) {
+    WriteEvent(annotation.track, 'E');
   }
+  WriteEvent(annotation.track, 'B', activity, annotation.args);
+  open = entries[0].tensor_name;
+  annotation.started = true;
 }
 
 void Timeline::ActivityStart(const std::string& tensor_name,
-                             const std::string& activity) {
+                             const std::string& activity,
+                             const std::string& args) {
   if (!initialized_) {
     return;
   }
 
   std::lock_guard<std::recursive_mutex> guard(mutex_);
   assert(tensor_states_[tensor_name] == TimelineState::TOP_LEVEL);
-  WriteEvent(tensor_name, 'B', activity);
+  WriteEvent(tensor_name, 'B', activity, args);
   tensor_states_[tensor_name] = TimelineState::ACTIVITY;
 }
 
 void Timeline::ActivityEndAll(const std::vector<TensorTableEntry>& entries) {
+  if (!initialized_ || entries.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
   for (auto& e : entries) {
     ActivityEnd(e.tensor_name);
   }
+  EndGroupTrack(entries[0].tensor_name);
+}
+
+void Timeline::EndGroupTrack(const std::string& tensor_name) {
+  auto it = group_annotations_.find(tensor_name);
+  if (it == group_annotations_.end() || !it->second.started) {
+    return;
+  }
+  auto open = open_tracks_.find(it->second.track);
+  if (open != open_tracks_.end() && open->second == tensor_name) {
+    WriteEvent(it->second.track, 'E');
+    open_tracks_.erase(open);
+  }
+  group_annotations_.erase(it);
 }
 
 void Timeline::ActivityEnd(const std::string& tensor_name) {
@@ -489,6 +667,14 @@ void Timeline::End(const std::string& tensor_name,
   if (tensor_states_[tensor_name] == TimelineState::ACTIVITY) {
     ActivityEnd(tensor_name);
   }
+  // A group that did not finish its annotated activity gives it up.
+  if (!group_annotations_.empty()) {
+    auto it = group_annotations_.find(tensor_name);
+    if (it != group_annotations_.end()) {
+      it->second.started = true;
+      EndGroupTrack(tensor_name);
+    }
+  }
 
   std::stringstream args;
   if (tensor != nullptr) {
@@ -507,6 +693,14 @@ void Timeline::MarkCycleStart() {
   WriteMarker("CYCLE_START");
 }
 
+void Timeline::LaunchStart(const std::string& activity, int group,
+                           int block_num, int thread_num, int stream,
+                           int64_t bytes) {
+  nvtx_.LaunchRangePush(activity, group, block_num, thread_num, stream, bytes);
+}
+
+void Timeline::LaunchEnd() { nvtx_.LaunchRangePop(); }
+
 void Timeline::SetPendingTimelineFile(std::string filename) {
   writer_.SetPendingTimelineFile(filename);
   LOG(INFO) << "Set pending timeline file to " << filename;
@@ -29,6 +29,8 @@
 
 #include "common.h"
 #include "message.h"
+#include "nvtx_ranges.h"
+#include "utils/env_parser.h"
 
 namespace horovod {
 namespace common {
@@ -45,10 +47,31 @@ struct TimelineRecord {
   long ts_micros;
 };
 
+// Record of a binary timeline file. The file starts with
+// BINARY_TIMELINE_MAGIC and the start time since epoch in microseconds as an
+// int64, followed by records. Strings are interned: a STRING record defines
+// string id `tensor` of `name` bytes that follow the record, and EVENT and
+// MARKER records refer to strings by id, -1 meaning none.
+#define BINARY_TIMELINE_MAGIC "HVDTL001"
+
+struct BinaryTimelineRecord {
+  enum Type : char { STRING = 'S', EVENT = 'E', MARKER = 'M' };
+  int64_t ts_micros;
+  int32_t tensor;
+  int32_t name;
+  int32_t args;
+  char type;
+  char phase;
+  char padding[2];
+};
+static_assert(sizeof(BinaryTimelineRecord) == 24,
+              "BinaryTimelineRecord is read by horovod.common.timeline_converter");
+
 class TimelineWriter {
 public:
   void Initialize(std::string file_name,
-                  std::chrono::steady_clock::time_point start_time_);
+                  std::chrono::steady_clock::time_point start_time_,
+                  long long clock_offset_micros = 0);
   void Shutdown();
   inline bool IsHealthy() const { return healthy_; }
   inline bool Active() const { return active_; }
@@ -57,11 +80,17 @@ public:
                          long ts_micros);
   void EnqueueWriteMarker(const std::string& name, long ts_micros);
   void SetPendingTimelineFile(std::string filename);
+  // Format of the files opened from now on.
+  void SetFormat(TimelineFormat format);
   TimelineWriter();
 
 private:
   void DoWriteEvent(const TimelineRecord& r);
   void DoWriteMarker(const TimelineRecord& r);
+  void DoWriteBinaryRecord(BinaryTimelineRecord::Type type,
+                           const TimelineRecord& r);
+  // Returns the id of the string in the binary file, -1 for an empty string.
+  int32_t InternString(const std::string& value);
   void WriterLoop();
   void WriteAtFileStart();
   std::string PendingTimelineFile();
@@ -89,6 +118,11 @@ private:
   // timeline file.
   std::unordered_map<std::string, int> tensor_table_;
 
+  TimelineFormat format_ = TimelineFormat::JSON;
+
+  // Mapping of strings to their ids in a binary file.
+  std::unordered_map<std::string, int32_t> string_table_;
+
   std::thread writer_thread_;
   std::string cur_filename_;
   std::string new_pending_filename_;
@@ -101,11 +135,27 @@ private:
 
 enum TimelineState { UNKNOWN, NEGOTIATING, TOP_LEVEL, ACTIVITY };
 
+// Libra fusion group that runs an activity of its tensors.
+struct TimelineGroup {
+  int group;
+  int num_tensors;
+  int64_t bytes;
+  int block_num;
+  int thread_num;
+  int stream;
+};
+
 // Writes timeline in Chrome Tracing format. Timeline spec is from:
 // https://github.com/catapult-project/catapult/tree/master/tracing
 class Timeline {
 public:
-  void Initialize(std::string file_name, unsigned int horovod_size);
+  // clock_offset_micros is subtracted from the start time written to the
+  // file, so that the timelines of all ranks share the coordinator's clock.
+  void Initialize(std::string file_name, unsigned int horovod_size,
+                  long long clock_offset_micros = 0);
+  // Emits the events as NVTX ranges as well, see NvtxRanges. The timeline
+  // is initialized from then on, with or without a file.
+  void InitializeNvtx(unsigned int horovod_size);
   void Shutdown();
   inline bool Initialized() const { return initialized_; }
   void NegotiateStart(const std::string& tensor_name,
@@ -117,12 +167,28 @@ public:
   void ActivityStartAll(const std::vector<TensorTableEntry>& entries,
                         const std::string& activity);
   void ActivityStart(const std::string& tensor_name,
-                     const std::string& activity);
+                     const std::string& activity,
+                     const std::string& args = "");
+  // The next `activity` of the tensors of entries carries the metadata of
+  // their fusion group as args, and is written on the track of its stream.
+  void AnnotateGroup(const std::vector<TensorTableEntry>& entries,
+                     const std::string& activity, const TimelineGroup& group);
   void ActivityEndAll(const std::vector<TensorTableEntry>& entries);
   void ActivityEnd(const std::string& tensor_name);
   void End(const std::string& tensor_name, std::shared_ptr<Tensor> tensor);
   void MarkCycleStart();
+  // Brackets the launch of the kernels of a fusion group on the calling
+  // thread, only written as an NVTX range.
+  void LaunchStart(const std::string& activity, int group, int block_num,
+                   int thread_num, int stream, int64_t bytes);
+  void LaunchEnd();
+  // Writes the straggler score of every rank as a counter.
+  void StragglerScores(const std::vector<double>& scores);
   void SetPendingTimelineFile(std::string filename);
+  void SetFormat(TimelineFormat format) { writer_.SetFormat(format); }
+  // Events are only written while recording, which the timeline sampler
+  // turns off between samples. Tensor states are tracked regardless.
+  void SetRecording(bool value) { recording_ = value; }
 
 private:
   long TimeSinceStartMicros() const;
@@ -135,9 +201,13 @@ private:
   // be recorded).
   bool initialized_ = false;
 
+  std::atomic_bool recording_{true};
+
   // Timeline writer.
   TimelineWriter writer_;
 
+  NvtxRanges nvtx_;
+
   // Time point when Horovod was started.
   std::chrono::steady_clock::time_point start_time_;
 
@@ -147,6 +217,24 @@ private:
   // Current state of each tensor in the timeline.
   std::unordered_map<std::string, TimelineState> tensor_states_;
 
+  struct GroupAnnotation {
+    std::string activity;
+    std::string args;
+    std::string track;
+    bool started = false;
+  };
+
+  // Ends the annotated activity of the group on its stream track.
+  void EndGroupTrack(const std::string& tensor_name);
+
+  // Annotations of the groups whose activity has not ended yet, by the name
+  // of their first tensor.
+  std::unordered_map<std::string, GroupAnnotation> group_annotations_;
+
+  // Group open on each stream track, by the name of its first tensor. The
+  // groups of a stream run in order, so the next group ends the previous.
+  std::unordered_map<std::string, std::string> open_tracks_;
+
   // Map of ranks to their string representations.
   // std::to_string() is very slow.
   std::vector<std::string> rank_strings_;
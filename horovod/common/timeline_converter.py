@@ -0,0 +1,105 @@
+# Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Converts a timeline written with HOROVOD_TIMELINE_FORMAT=binary into the
+Chrome Tracing JSON format written by default.
+
+Usage: python -m horovod.common.timeline_converter timeline.bin timeline.json
+"""
+
+import argparse
+import json
+import struct
+
+BINARY_TIMELINE_MAGIC = b'HVDTL001'
+
+# Layout of BinaryTimelineRecord in horovod/common/timeline.h.
+_RECORD = struct.Struct('<qiiicc2x')
+_START_TIME = struct.Struct('<q')
+
+_STRING = b'S'
+_EVENT = b'E'
+_MARKER = b'M'
+
+
+def read_binary_timeline(file):
+    """Returns the start time since epoch in microseconds and the events of a
+    binary timeline as Chrome Tracing events."""
+    if file.read(len(BINARY_TIMELINE_MAGIC)) != BINARY_TIMELINE_MAGIC:
+        raise ValueError('Not a binary Horovod timeline.')
+    start_time, = _START_TIME.unpack(file.read(_START_TIME.size))
+
+    strings = {}
+    tensor_pids = {}
+    events = []
+    while True:
+        data = file.read(_RECORD.size)
+        if len(data) < _RECORD.size:
+            # The last record may be incomplete if the process was killed.
+            break
+        ts, tensor, name, args, record_type, phase = _RECORD.unpack(data)
+        if record_type == _STRING:
+            strings[tensor] = file.read(name).decode('utf-8')
+        elif record_type == _EVENT:
+            tensor_name = strings.get(tensor, '')
+            pid = tensor_pids.get(tensor_name)
+            if pid is None:
+                # Tensors are modeled as processes, like in JSON timelines.
+                pid = len(tensor_pids) + 1
+                tensor_pids[tensor_name] = pid
+                events.append({'name': 'process_name', 'ph': 'M', 'pid': pid,
+                               'args': {'name': tensor_name}})
+                events.append({'name': 'process_sort_index', 'ph': 'M',
+                               'pid': pid, 'args': {'sort_index': pid}})
+            phase = phase.decode('utf-8')
+            event = {'ph': phase, 'ts': ts, 'pid': pid}
+            if phase != 'E':
+                event['name'] = strings.get(name, '')
+            if phase == 'X':
+                event['dur'] = 0
+            if args >= 0:
+                event['args'] = json.loads('{' + strings[args] + '}')
+            events.append(event)
+        elif record_type == _MARKER:
+            events.append({'ph': 'i', 'name': strings.get(name, ''), 'ts': ts,
+                           's': 'g'})
+        else:
+            raise ValueError('Unknown record type %r in binary timeline.' %
+                             record_type)
+    return start_time, events
+
+
+def convert(binary_path, json_path):
+    with open(binary_path, 'rb') as binary_file:
+        start_time, events = read_binary_timeline(binary_file)
+
+    header = [{'name': 'process_name', 'ph': 'M', 'pid': 0,
+               'args': {'start_time_since_epoch_in_micros': start_time}},
+              {'name': 'process_sort_index', 'ph': 'M', 'pid': 0,
+               'args': {'sort_index': 0}}]
+    with open(json_path, 'w') as json_file:
+        json.dump(header + events, json_file)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert a binary Horovod timeline to Chrome Tracing JSON.')
+    parser.add_argument('binary_timeline', help='binary timeline file to read')
+    parser.add_argument('json_timeline', help='JSON timeline file to write')
+    args = parser.parse_args()
+    convert(args.binary_timeline, args.json_timeline)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,91 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "timeline_sampler.h"
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+// The trigger file is checked at most this often.
+#define TIMELINE_TRIGGER_POLL_INTERVAL std::chrono::seconds(1)
+
+void TimelineSampler::SetStepSampling(int every_steps, int sample_steps) {
+  if (every_steps < 0) {
+    LOG(WARNING) << "HOROVOD_TIMELINE_SAMPLE_EVERY_STEPS must not be negative, "
+                 << "got " << every_steps << ". Disabling step sampling.";
+    every_steps = 0;
+  }
+  if (every_steps > 0 && (sample_steps < 1 || sample_steps > every_steps)) {
+    LOG(WARNING) << "HOROVOD_TIMELINE_SAMPLE_STEPS must be in [1, "
+                 << every_steps << "], got " << sample_steps << ". Using 1.";
+    sample_steps = 1;
+  }
+  every_steps_ = every_steps;
+  sample_steps_ = sample_steps;
+}
+
+void TimelineSampler::SetTrigger(const std::string& trigger_file,
+                                 double window_seconds) {
+  trigger_file_ = trigger_file;
+  window_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(window_seconds));
+
+  // Only creating or touching the file after start-up triggers a window.
+  struct stat trigger_stat;
+  if (!trigger_file_.empty() &&
+      stat(trigger_file_.c_str(), &trigger_stat) == 0) {
+    trigger_mtime_ = trigger_stat.st_mtime;
+  }
+}
+
+bool TimelineSampler::Update(const ResponseList& response_list) {
+  bool record = false;
+  if (every_steps_ > 0) {
+    for (auto& response : response_list.responses()) {
+      for (auto& name : response.tensor_names()) {
+        if (!step_tensors_.insert(name).second) {
+          ++step_;
+          step_tensors_.clear();
+          step_tensors_.insert(name);
+        }
+      }
+    }
+    record = step_ % every_steps_ < sample_steps_;
+  }
+  if (!trigger_file_.empty()) {
+    record |= Triggered();
+  }
+  return record;
+}
+
+bool TimelineSampler::Triggered() {
+  auto now = std::chrono::steady_clock::now();
+  if (now >= next_poll_) {
+    next_poll_ = now + TIMELINE_TRIGGER_POLL_INTERVAL;
+    struct stat trigger_stat;
+    if (stat(trigger_file_.c_str(), &trigger_stat) == 0 &&
+        trigger_stat.st_mtime != trigger_mtime_) {
+      trigger_mtime_ = trigger_stat.st_mtime;
+      window_end_ = now + window_;
+      LOG(INFO) << "Timeline triggered by " << trigger_file_ << ".";
+    }
+  }
+  return now < window_end_;
+}
+
+} // namespace common
+} // namespace horovod
@@ -0,0 +1,74 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_TIMELINE_SAMPLER_H
+#define HOROVOD_TIMELINE_SAMPLER_H
+
+#include <chrono>
+#include <string>
+#include <unordered_set>
+
+#include <sys/stat.h>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Decides which parts of a long run are written to the timeline: a few steps
+// out of every HOROVOD_TIMELINE_SAMPLE_EVERY_STEPS steps, and a time window
+// whenever HOROVOD_TIMELINE_TRIGGER_FILE is created or touched.
+//
+// Steps are detected from the responses performed in each cycle: a step ends
+// when a tensor that was already performed in the current step is performed
+// again.
+class TimelineSampler {
+public:
+  TimelineSampler() = default;
+  TimelineSampler(const TimelineSampler&) = delete;
+
+  bool IsEnabled() const { return every_steps_ > 0 || !trigger_file_.empty(); }
+
+  // Record sample_steps out of every every_steps steps, 0 disables step
+  // sampling.
+  void SetStepSampling(int every_steps, int sample_steps);
+
+  // Record for window_seconds after trigger_file is created or touched, an
+  // empty path disables the trigger.
+  void SetTrigger(const std::string& trigger_file, double window_seconds);
+
+  // Called once per cycle with the responses about to be performed. Returns
+  // true if the timeline should be written during the cycle.
+  bool Update(const ResponseList& response_list);
+
+private:
+  bool Triggered();
+
+  int every_steps_ = 0;
+  int sample_steps_ = 1;
+  int64_t step_ = 0;
+  std::unordered_set<std::string> step_tensors_;
+
+  std::string trigger_file_;
+  std::chrono::steady_clock::duration window_{};
+  std::chrono::steady_clock::time_point window_end_;
+  std::chrono::steady_clock::time_point next_poll_;
+  time_t trigger_mtime_ = 0;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_TIMELINE_SAMPLER_H
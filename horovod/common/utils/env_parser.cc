@@ -109,6 +109,92 @@ LibType ParseControllerOpsFromEnv() {
   return controller;
 }
 
+FusionMode ParseFusionModeFromEnv() {
+  FusionMode fusion_mode = FusionMode::AUTO;
+  const char* user_fusion_mode = std::getenv(HOROVOD_FUSION_MODE);
+  if (user_fusion_mode != nullptr) {
+    if (strcasecmp(user_fusion_mode, "threshold") == 0) {
+      fusion_mode = FusionMode::THRESHOLD;
+    } else if (strcasecmp(user_fusion_mode, "groups") == 0) {
+      fusion_mode = FusionMode::GROUPS;
+    } else if (strcasecmp(user_fusion_mode, "auto") == 0) {
+      fusion_mode = FusionMode::AUTO;
+    } else {
+      throw std::runtime_error("Unsupported fusion mode, only threshold, "
+                               "groups and auto are supported");
+    }
+  }
+  return fusion_mode;
+}
+
+StreamPriorityPolicy ParseStreamPriorityPolicyFromEnv() {
+  StreamPriorityPolicy policy = StreamPriorityPolicy::HIGH;
+  const char* user_policy = std::getenv(HOROVOD_GPU_STREAM_PRIORITY);
+  if (user_policy != nullptr) {
+    if (strcasecmp(user_policy, "high") == 0) {
+      policy = StreamPriorityPolicy::HIGH;
+    } else if (strcasecmp(user_policy, "low") == 0) {
+      policy = StreamPriorityPolicy::LOW;
+    } else if (strcasecmp(user_policy, "layer") == 0) {
+      policy = StreamPriorityPolicy::LAYER;
+    } else {
+      throw std::runtime_error("Unsupported GPU stream priority, only high, "
+                               "low and layer are supported");
+    }
+  }
+  return policy;
+}
+
+TimelineFormat ParseTimelineFormatFromEnv() {
+  TimelineFormat format = TimelineFormat::JSON;
+  const char* user_format = std::getenv(HOROVOD_TIMELINE_FORMAT);
+  if (user_format != nullptr) {
+    if (strcasecmp(user_format, "json") == 0) {
+      format = TimelineFormat::JSON;
+    } else if (strcasecmp(user_format, "binary") == 0) {
+      format = TimelineFormat::BINARY;
+    } else {
+      throw std::runtime_error("Unsupported timeline format, only json and "
+                               "binary are supported");
+    }
+  }
+  return format;
+}
+
+AutotuneScore ParseAutotuneScoreFromEnv() {
+  AutotuneScore score = AutotuneScore::BYTES;
+  const char* user_score = std::getenv(HOROVOD_AUTOTUNE_SCORE);
+  if (user_score != nullptr) {
+    if (strcasecmp(user_score, "bytes") == 0) {
+      score = AutotuneScore::BYTES;
+    } else if (strcasecmp(user_score, "step_time") == 0) {
+      score = AutotuneScore::STEP_TIME;
+    } else {
+      throw std::runtime_error("Unsupported autotune score, only bytes and "
+                               "step_time are supported");
+    }
+  }
+  return score;
+}
+
+FusionCompression ParseFusionCompressionFromEnv() {
+  FusionCompression compression = FusionCompression::NONE;
+  const char* user_compression = std::getenv(HOROVOD_FUSION_COMPRESSION);
+  if (user_compression != nullptr) {
+    if (strcasecmp(user_compression, "none") == 0) {
+      compression = FusionCompression::NONE;
+    } else if (strcasecmp(user_compression, "fp16") == 0) {
+      compression = FusionCompression::FP16;
+    } else if (strcasecmp(user_compression, "bf16") == 0) {
+      compression = FusionCompression::BF16;
+    } else {
+      throw std::runtime_error("Unsupported fusion compression, only none, "
+                               "fp16 and bf16 are supported");
+    }
+  }
+  return compression;
+}
+
 const char* ParseGlooIface() {
   const char* gloo_iface = std::getenv(HOROVOD_GLOO_IFACE);
   if (gloo_iface == nullptr) {
@@ -25,6 +25,26 @@ namespace common {
 
 enum class LibType { MPI = 0, CCL = 1, GLOO = 2 };
 
+// How allreduce responses are fused: by HOROVOD_FUSION_THRESHOLD bytes, into
+// the Libra fusion groups, or into groups only if FUSION_SIZE is specified.
+enum class FusionMode { THRESHOLD = 0, GROUPS = 1, AUTO = 2 };
+
+// CUDA priority of the communication streams: all high, all low, or high only
+// for the allreduces of the first layers.
+enum class StreamPriorityPolicy { HIGH = 0, LOW = 1, LAYER = 2 };
+
+// File format of the timeline: chrome tracing JSON, or compact binary records
+// converted to JSON offline.
+enum class TimelineFormat { JSON = 0, BINARY = 1 };
+
+// What the autotuner maximizes: bytes allreduced per unit of time, or
+// training steps completed per unit of time.
+enum class AutotuneScore { BYTES = 0, STEP_TIME = 1 };
+
+// Type float32 tensors are cast to in the fusion buffers of GPU allreduces:
+// none keeps float32, fp16 and bf16 halve the bytes sent.
+enum class FusionCompression { NONE = 0, FP16 = 1, BF16 = 2 };
+
 std::string TypeName(LibType type);
 
 LibType ParseCPUOpsFromEnv();
@@ -33,6 +53,16 @@ LibType ParseControllerOpsFromEnv();
 
 const char* ParseGlooIface();
 
+FusionMode ParseFusionModeFromEnv();
+
+StreamPriorityPolicy ParseStreamPriorityPolicyFromEnv();
+
+TimelineFormat ParseTimelineFormatFromEnv();
+
+AutotuneScore ParseAutotuneScoreFromEnv();
+
+FusionCompression ParseFusionCompressionFromEnv();
+
 void ParseStallInspectorFromEnv(StallInspector& stall_inspector);
 
 void SetBoolFromEnv(const char* env, bool& val, bool value_if_set);
@@ -45,11 +45,12 @@ enum DataType {
   DataType_HOROVOD_FLOAT32 = 7,
   DataType_HOROVOD_FLOAT64 = 8,
   DataType_HOROVOD_BOOL = 9,
+  DataType_HOROVOD_BFLOAT16 = 10,
   DataType_MIN = DataType_HOROVOD_UINT8,
-  DataType_MAX = DataType_HOROVOD_BOOL
+  DataType_MAX = DataType_HOROVOD_BFLOAT16
 };
 
-inline const DataType (&EnumValuesDataType())[10] {
+inline const DataType (&EnumValuesDataType())[11] {
   static const DataType values[] = {
     DataType_HOROVOD_UINT8,
     DataType_HOROVOD_INT8,
@@ -60,13 +61,14 @@ inline const DataType (&EnumValuesDataType())[10] {
     DataType_HOROVOD_FLOAT16,
     DataType_HOROVOD_FLOAT32,
     DataType_HOROVOD_FLOAT64,
-    DataType_HOROVOD_BOOL
+    DataType_HOROVOD_BOOL,
+    DataType_HOROVOD_BFLOAT16
   };
   return values;
 }
 
 inline const char * const *EnumNamesDataType() {
-  static const char * const names[11] = {
+  static const char * const names[12] = {
     "HOROVOD_UINT8",
     "HOROVOD_INT8",
     "HOROVOD_UINT16",
@@ -77,13 +79,14 @@ inline const char * const *EnumNamesDataType() {
     "HOROVOD_FLOAT32",
     "HOROVOD_FLOAT64",
     "HOROVOD_BOOL",
+    "HOROVOD_BFLOAT16",
     nullptr
   };
   return names;
 }
 
 inline const char *EnumNameDataType(DataType e) {
-  if (e < DataType_HOROVOD_UINT8 || e > DataType_HOROVOD_BOOL) return "";
+  if (e < DataType_HOROVOD_UINT8 || e > DataType_HOROVOD_BFLOAT16) return "";
   const size_t index = static_cast<size_t>(e);
   return EnumNamesDataType()[index];
 }
@@ -177,6 +180,9 @@ struct Request FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_TENSOR_SHAPE = 16,
     VT_PRESCALE_FACTOR = 18,
     VT_POSTSCALE_FACTOR = 20,
+    VT_PRIORITY = 22,
+    VT_TENSOR_ID = 24,
+    VT_PROCESS_SET_ID = 26
   };
   int32_t request_rank() const {
     return GetField<int32_t>(VT_REQUEST_RANK, 0);
@@ -205,6 +211,15 @@ struct Request FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   double postscale_factor() const {
     return GetField<double>(VT_POSTSCALE_FACTOR, 0.0);
   }
+  int32_t priority() const {
+    return GetField<int32_t>(VT_PRIORITY, 0);
+  }
+  int32_t tensor_id() const {
+    return GetField<int32_t>(VT_TENSOR_ID, -1);
+  }
+  int32_t process_set_id() const {
+    return GetField<int32_t>(VT_PROCESS_SET_ID, 0);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int32_t>(verifier, VT_REQUEST_RANK) &&
@@ -218,6 +233,9 @@ struct Request FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.VerifyVector(tensor_shape()) &&
            VerifyField<double>(verifier, VT_PRESCALE_FACTOR) &&
            VerifyField<double>(verifier, VT_POSTSCALE_FACTOR) &&
+           VerifyField<int32_t>(verifier, VT_PRIORITY) &&
+           VerifyField<int32_t>(verifier, VT_TENSOR_ID) &&
+           VerifyField<int32_t>(verifier, VT_PROCESS_SET_ID) &&
            verifier.EndTable();
   }
 };
@@ -252,6 +270,15 @@ struct RequestBuilder {
   void add_postscale_factor(double postscale_factor) {
     fbb_.AddElement<double>(Request::VT_POSTSCALE_FACTOR, postscale_factor, 0.0);
   }
+  void add_priority(int32_t priority) {
+    fbb_.AddElement<int32_t>(Request::VT_PRIORITY, priority, 0);
+  }
+  void add_tensor_id(int32_t tensor_id) {
+    fbb_.AddElement<int32_t>(Request::VT_TENSOR_ID, tensor_id, -1);
+  }
+  void add_process_set_id(int32_t process_set_id) {
+    fbb_.AddElement<int32_t>(Request::VT_PROCESS_SET_ID, process_set_id, 0);
+  }
   explicit RequestBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -274,9 +301,15 @@ inline flatbuffers::Offset<Request> CreateRequest(
     int32_t device = 0,
     flatbuffers::Offset<flatbuffers::Vector<int64_t>> tensor_shape = 0,
     double prescale_factor = 0.0,
-    double postscale_factor = 0.0) {
+    double postscale_factor = 0.0,
+    int32_t priority = 0,
+    int32_t tensor_id = -1,
+    int32_t process_set_id = 0) {
   RequestBuilder builder_(_fbb);
   builder_.add_postscale_factor(postscale_factor);
+  builder_.add_process_set_id(process_set_id);
+  builder_.add_tensor_id(tensor_id);
+  builder_.add_priority(priority);
   builder_.add_prescale_factor(prescale_factor);
   builder_.add_tensor_shape(tensor_shape);
   builder_.add_device(device);
@@ -298,7 +331,10 @@ inline flatbuffers::Offset<Request> CreateRequestDirect(
     int32_t device = 0,
     const std::vector<int64_t> *tensor_shape = nullptr,
     double prescale_factor = 0.0,
-    double postscale_factor = 0.0) {
+    double postscale_factor = 0.0,
+    int32_t priority = 0,
+    int32_t tensor_id = -1,
+    int32_t process_set_id = 0) {
   auto tensor_name__ = tensor_name ? _fbb.CreateString(tensor_name) : 0;
   auto tensor_shape__ = tensor_shape ? _fbb.CreateVector<int64_t>(*tensor_shape) : 0;
   return horovod::common::wire::CreateRequest(
@@ -311,7 +347,10 @@ inline flatbuffers::Offset<Request> CreateRequestDirect(
       device,
       tensor_shape__,
       prescale_factor,
-      postscale_factor);
+      postscale_factor,
+      priority,
+      tensor_id,
+      process_set_id);
 }
 
 struct RequestList FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -388,8 +427,11 @@ struct Response FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_PRESCALE_FACTOR = 16,
     VT_POSTSCALE_FACTOR = 18,
     // lyz - alloc
-    VT_BLOCK_NUM = 22,
-    VT_THREAD_NUM = 24
+    // 24, 30 and 32 held the blocks and threads before the Libra plan.
+    VT_LIBRA_ALLOCATION = 22,
+    VT_PRIORITY = 26,
+    VT_TENSOR_IDS = 28,
+    VT_PROCESS_SET_ID = 34
   };
   horovod::common::wire::ResponseType response_type() const {
     return static_cast<horovod::common::wire::ResponseType>(GetField<int8_t>(VT_RESPONSE_TYPE, 0));
@@ -417,13 +459,18 @@ struct Response FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   }
 
   // lyz - alloc
-  int32_t block_num() const {
-    return GetField<int32_t>(VT_BLOCK_NUM, 0); 
+  int32_t libra_allocation() const {
+    return GetField<int32_t>(VT_LIBRA_ALLOCATION, 0);
   }
-  int32_t thread_num() const {
-    return GetField<int32_t>(VT_THREAD_NUM, 0); 
+  int32_t priority() const {
+    return GetField<int32_t>(VT_PRIORITY, 0);
+  }
+  const flatbuffers::Vector<int32_t> *tensor_ids() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_TENSOR_IDS);
+  }
+  int32_t process_set_id() const {
+    return GetField<int32_t>(VT_PROCESS_SET_ID, 0);
   }
-
 
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
@@ -440,6 +487,11 @@ struct Response FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyField<int8_t>(verifier, VT_TENSOR_TYPE) &&
            VerifyField<double>(verifier, VT_PRESCALE_FACTOR) &&
            VerifyField<double>(verifier, VT_POSTSCALE_FACTOR) &&
+           VerifyField<int32_t>(verifier, VT_PRIORITY) &&
+           VerifyOffset(verifier, VT_TENSOR_IDS) &&
+           verifier.VerifyVector(tensor_ids()) &&
+           VerifyField<int32_t>(verifier, VT_LIBRA_ALLOCATION) &&
+           VerifyField<int32_t>(verifier, VT_PROCESS_SET_ID) &&
            verifier.EndTable();
   }
 };
@@ -472,11 +524,17 @@ struct ResponseBuilder {
     fbb_.AddElement<double>(Response::VT_POSTSCALE_FACTOR, postscale_factor, 0.0);
   }
   // lyz - alloc
-  void add_block_num(int32_t block_num) {
-    fbb_.AddElement<int32_t>(Response::VT_BLOCK_NUM, block_num, 3); //a deafault value that causes ncclInternalError
+  void add_libra_allocation(int32_t libra_allocation) {
+    fbb_.AddElement<int32_t>(Response::VT_LIBRA_ALLOCATION, libra_allocation, 0);
+  }
+  void add_priority(int32_t priority) {
+    fbb_.AddElement<int32_t>(Response::VT_PRIORITY, priority, 0);
   }
-  void add_thread_num(int32_t thread_num) {
-    fbb_.AddElement<int32_t>(Response::VT_THREAD_NUM, thread_num, 3);
+  void add_tensor_ids(flatbuffers::Offset<flatbuffers::Vector<int32_t>> tensor_ids) {
+    fbb_.AddOffset(Response::VT_TENSOR_IDS, tensor_ids);
+  }
+  void add_process_set_id(int32_t process_set_id) {
+    fbb_.AddElement<int32_t>(Response::VT_PROCESS_SET_ID, process_set_id, 0);
   }
 
   explicit ResponseBuilder(flatbuffers::FlatBufferBuilder &_fbb)
@@ -542,7 +600,11 @@ inline flatbuffers::Offset<Response> CreateResponseDirect(
 struct ResponseList FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
     VT_RESPONSES = 4,
-    VT_SHUTDOWN = 6
+    VT_SHUTDOWN = 6,
+    VT_FUSION_GROUP_ID = 8,
+    VT_PARAMETERS = 10,
+    VT_LIBRA_PLAN = 12,
+    VT_CPU_FUSION_GROUP_ID = 14
   };
   const flatbuffers::Vector<flatbuffers::Offset<horovod::common::wire::Response>> *responses() const {
     return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<horovod::common::wire::Response>> *>(VT_RESPONSES);
@@ -550,12 +612,30 @@ struct ResponseList FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   bool shutdown() const {
     return GetField<uint8_t>(VT_SHUTDOWN, 0) != 0;
   }
+  int32_t fusion_group_id() const {
+    return GetField<int32_t>(VT_FUSION_GROUP_ID, 0);
+  }
+  const flatbuffers::Vector<uint8_t> *parameters() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_PARAMETERS);
+  }
+  const flatbuffers::Vector<uint8_t> *libra_plan() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_LIBRA_PLAN);
+  }
+  int32_t cpu_fusion_group_id() const {
+    return GetField<int32_t>(VT_CPU_FUSION_GROUP_ID, 0);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_RESPONSES) &&
            verifier.VerifyVector(responses()) &&
            verifier.VerifyVectorOfTables(responses()) &&
            VerifyField<uint8_t>(verifier, VT_SHUTDOWN) &&
+           VerifyField<int32_t>(verifier, VT_FUSION_GROUP_ID) &&
+           VerifyOffset(verifier, VT_PARAMETERS) &&
+           verifier.VerifyVector(parameters()) &&
+           VerifyOffset(verifier, VT_LIBRA_PLAN) &&
+           verifier.VerifyVector(libra_plan()) &&
+           VerifyField<int32_t>(verifier, VT_CPU_FUSION_GROUP_ID) &&
            verifier.EndTable();
   }
 };
@@ -569,6 +649,18 @@ struct ResponseListBuilder {
   void add_shutdown(bool shutdown) {
     fbb_.AddElement<uint8_t>(ResponseList::VT_SHUTDOWN, static_cast<uint8_t>(shutdown), 0);
   }
+  void add_fusion_group_id(int32_t fusion_group_id) {
+    fbb_.AddElement<int32_t>(ResponseList::VT_FUSION_GROUP_ID, fusion_group_id, 0);
+  }
+  void add_parameters(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> parameters) {
+    fbb_.AddOffset(ResponseList::VT_PARAMETERS, parameters);
+  }
+  void add_libra_plan(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> libra_plan) {
+    fbb_.AddOffset(ResponseList::VT_LIBRA_PLAN, libra_plan);
+  }
+  void add_cpu_fusion_group_id(int32_t cpu_fusion_group_id) {
+    fbb_.AddElement<int32_t>(ResponseList::VT_CPU_FUSION_GROUP_ID, cpu_fusion_group_id, 0);
+  }
   explicit ResponseListBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -584,8 +676,16 @@ struct ResponseListBuilder {
 inline flatbuffers::Offset<ResponseList> CreateResponseList(
     flatbuffers::FlatBufferBuilder &_fbb,
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<horovod::common::wire::Response>>> responses = 0,
-    bool shutdown = false) {
+    bool shutdown = false,
+    int32_t fusion_group_id = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> parameters = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> libra_plan = 0,
+    int32_t cpu_fusion_group_id = 0) {
   ResponseListBuilder builder_(_fbb);
+  builder_.add_cpu_fusion_group_id(cpu_fusion_group_id);
+  builder_.add_libra_plan(libra_plan);
+  builder_.add_parameters(parameters);
+  builder_.add_fusion_group_id(fusion_group_id);
   builder_.add_responses(responses);
   builder_.add_shutdown(shutdown);
   return builder_.Finish();
@@ -594,12 +694,22 @@ inline flatbuffers::Offset<ResponseList> CreateResponseList(
 inline flatbuffers::Offset<ResponseList> CreateResponseListDirect(
     flatbuffers::FlatBufferBuilder &_fbb,
     const std::vector<flatbuffers::Offset<horovod::common::wire::Response>> *responses = nullptr,
-    bool shutdown = false) {
+    bool shutdown = false,
+    int32_t fusion_group_id = 0,
+    const std::vector<uint8_t> *parameters = nullptr,
+    const std::vector<uint8_t> *libra_plan = nullptr,
+    int32_t cpu_fusion_group_id = 0) {
   auto responses__ = responses ? _fbb.CreateVector<flatbuffers::Offset<horovod::common::wire::Response>>(*responses) : 0;
+  auto parameters__ = parameters ? _fbb.CreateVector<uint8_t>(*parameters) : 0;
+  auto libra_plan__ = libra_plan ? _fbb.CreateVector<uint8_t>(*libra_plan) : 0;
   return horovod::common::wire::CreateResponseList(
       _fbb,
       responses__,
-      shutdown);
+      shutdown,
+      fusion_group_id,
+      parameters__,
+      libra_plan__,
+      cpu_fusion_group_id);
 }
 
 }  // namespace wire
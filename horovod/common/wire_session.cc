@@ -0,0 +1,156 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "wire_session.h"
+
+#include <stdexcept>
+
+#include "logging.h"
+
+namespace horovod {
+namespace common {
+
+void WireSession::SetCapacity(int capacity) {
+  if (capacity < 0) {
+    LOG(WARNING) << "HOROVOD_WIRE_SESSION_CAPACITY must not be negative, got "
+                 << capacity << ". Disabling the wire session.";
+    capacity = 0;
+  }
+  capacity_ = capacity;
+}
+
+void WireSession::Reset(int size) {
+  request_ids_.clear();
+  next_request_id_ = 0;
+  response_names_.clear();
+  rank_requests_.assign(size, std::vector<NamedTensor>());
+  response_ids_.clear();
+}
+
+void WireSession::EncodeRequests(RequestList& request_list) {
+  for (auto& request : request_list.mutable_requests()) {
+    if (request.tensor_name().empty()) {
+      continue;
+    }
+    auto it = request_ids_.find(request.tensor_name());
+    if (it != request_ids_.end() &&
+        it->second.shape == request.tensor_shape()) {
+      request.set_tensor_id(it->second.id);
+      request.set_tensor_name("");
+      request.set_tensor_shape(std::vector<int64_t>());
+      continue;
+    }
+    if (next_request_id_ >= capacity_) {
+      // Sent in full, without an ID.
+      continue;
+    }
+    // A new tensor, or a new shape of a known one, declares a new ID.
+    request.set_tensor_id(next_request_id_);
+    request_ids_[request.tensor_name()] =
+        Tensor{next_request_id_, request.tensor_shape()};
+    ++next_request_id_;
+  }
+}
+
+void WireSession::DecodeRequest(int rank, Request& request) {
+  auto& tensors = rank_requests_[rank];
+  int32_t id = request.tensor_id();
+  if (id < 0) {
+    return;
+  }
+  if (!request.tensor_name().empty()) {
+    if (id != (int32_t)tensors.size()) {
+      throw std::logic_error("Rank " + std::to_string(rank) +
+                             " declared wire session ID " +
+                             std::to_string(id) + " out of order.");
+    }
+    tensors.push_back(
+        NamedTensor{request.tensor_name(), request.tensor_shape()});
+  } else {
+    if (id >= (int32_t)tensors.size()) {
+      throw std::logic_error("Rank " + std::to_string(rank) +
+                             " sent unknown wire session ID " +
+                             std::to_string(id) + ".");
+    }
+    request.set_tensor_name(tensors[id].name);
+    request.set_tensor_shape(tensors[id].shape);
+  }
+  request.set_tensor_id(-1);
+}
+
+ResponseList WireSession::EncodeResponses(const ResponseList& response_list) {
+  ResponseList encoded = response_list;
+  for (auto& response : encoded.mutable_responses()) {
+    auto& names = response.tensor_names();
+    // Skip responses that would not fit in the dictionary.
+    int new_names = 0;
+    for (auto& name : names) {
+      if (response_ids_.find(name) == response_ids_.end()) {
+        ++new_names;
+      }
+    }
+    if ((int)response_ids_.size() + new_names > capacity_) {
+      continue;
+    }
+
+    std::vector<int32_t> ids;
+    std::vector<std::string> declared_names;
+    ids.reserve(names.size());
+    for (auto& name : names) {
+      auto it = response_ids_.find(name);
+      if (it != response_ids_.end()) {
+        ids.push_back(it->second);
+      } else {
+        int32_t id = (int32_t)response_ids_.size();
+        response_ids_[name] = id;
+        ids.push_back(id);
+        declared_names.push_back(name);
+      }
+    }
+    response.set_tensor_ids(ids);
+    response.set_tensor_names(std::move(declared_names));
+  }
+  return encoded;
+}
+
+void WireSession::DecodeResponses(ResponseList& response_list) {
+  for (auto& response : response_list.mutable_responses()) {
+    if (response.tensor_ids().empty()) {
+      continue;
+    }
+    auto& declared_names = response.tensor_names();
+    size_t next_declared = 0;
+    std::vector<std::string> names;
+    names.reserve(response.tensor_ids().size());
+    for (auto id : response.tensor_ids()) {
+      if (id == (int32_t)response_names_.size()) {
+        if (next_declared >= declared_names.size()) {
+          throw std::logic_error("Wire session ID " + std::to_string(id) +
+                                 " was declared without a name.");
+        }
+        response_names_.push_back(declared_names[next_declared++]);
+      } else if (id < 0 || id > (int32_t)response_names_.size()) {
+        throw std::logic_error("Received unknown wire session ID " +
+                               std::to_string(id) + ".");
+      }
+      names.push_back(response_names_[id]);
+    }
+    response.set_tensor_names(std::move(names));
+    response.set_tensor_ids(std::vector<int32_t>());
+  }
+}
+
+} // namespace common
+} // namespace horovod
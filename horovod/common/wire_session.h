@@ -0,0 +1,89 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HOROVOD_WIRE_SESSION_H
+#define HOROVOD_WIRE_SESSION_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "message.h"
+
+namespace horovod {
+namespace common {
+
+// Shortens the request and response lists exchanged with the coordinator
+// every cycle by sending each tensor name and shape once and referring to it
+// by an integer ID afterwards.
+//
+// IDs are assigned in order by the sender, so the receiver recognizes a new
+// ID by it being the next one, and both sides keep their dictionaries in sync
+// without extra messages. Each worker has its own request dictionary on the
+// coordinator, while the response dictionary is shared by all workers, since
+// the same responses are broadcast to all of them. Once capacity IDs are
+// assigned, lists with new tensors are sent in full.
+class WireSession {
+public:
+  WireSession() = default;
+  WireSession(const WireSession&) = delete;
+
+  bool IsEnabled() const { return capacity_ > 0; }
+
+  // Maximum number of IDs in each dictionary, 0 disables the session.
+  void SetCapacity(int capacity);
+
+  // Forgets all IDs, must be called on all ranks at the same time.
+  void Reset(int size);
+
+  // Called on workers before sending their requests to the coordinator.
+  void EncodeRequests(RequestList& request_list);
+
+  // Called on the coordinator with each request received from rank.
+  void DecodeRequest(int rank, Request& request);
+
+  // Called on the coordinator, returns the responses to send to workers.
+  ResponseList EncodeResponses(const ResponseList& response_list);
+
+  // Called on workers with the responses received from the coordinator.
+  void DecodeResponses(ResponseList& response_list);
+
+private:
+  struct Tensor {
+    int32_t id;
+    std::vector<int64_t> shape;
+  };
+
+  struct NamedTensor {
+    std::string name;
+    std::vector<int64_t> shape;
+  };
+
+  int capacity_ = 0;
+
+  // Worker side.
+  std::unordered_map<std::string, Tensor> request_ids_;
+  int32_t next_request_id_ = 0;
+  std::vector<std::string> response_names_;
+
+  // Coordinator side.
+  std::vector<std::vector<NamedTensor>> rank_requests_;
+  std::unordered_map<std::string, int32_t> response_ids_;
+};
+
+} // namespace common
+} // namespace horovod
+
+#endif // HOROVOD_WIRE_SESSION_H
@@ -21,10 +21,17 @@ check_extension('horovod.mxnet', 'HOROVOD_WITH_MXNET',
 from horovod.mxnet.functions import allgather_object, broadcast_object
 from horovod.mxnet.mpi_ops import allgather
 from horovod.mxnet.mpi_ops import allreduce, allreduce_
+from horovod.mxnet.mpi_ops import grouped_allreduce, grouped_allreduce_
 from horovod.mxnet.mpi_ops import alltoall
 from horovod.mxnet.mpi_ops import broadcast, broadcast_
 from horovod.mxnet.mpi_ops import init, shutdown
 from horovod.mxnet.mpi_ops import is_initialized, start_timeline, stop_timeline
+from horovod.mxnet.mpi_ops import flush_fusion_groups
+from horovod.mxnet.mpi_ops import release_fusion_buffers, fusion_buffer_bytes
+from horovod.mxnet.mpi_ops import step_completed
+from horovod.mxnet.mpi_ops import get_overlap_stats
+from horovod.mxnet.mpi_ops import get_metrics
+from horovod.mxnet.mpi_ops import get_straggler_scores
 from horovod.mxnet.mpi_ops import size, local_size, rank, local_rank
 from horovod.mxnet.mpi_ops import mpi_threads_supported, mpi_enabled, mpi_built
 from horovod.mxnet.mpi_ops import gloo_enabled, gloo_built
@@ -24,6 +24,21 @@
 namespace horovod {
 namespace mxnet {
 
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+MXReadyEvent::MXReadyEvent(cudaStream_t stream) {
+  CUDA_CALL(cudaEventCreateWithFlags(&event_, cudaEventDisableTiming));
+  CUDA_CALL(cudaEventRecord(event_, stream));
+}
+
+MXReadyEvent::~MXReadyEvent() { cudaEventDestroy(event_); }
+
+bool MXReadyEvent::Ready() const {
+  return cudaEventQuery(event_) != cudaErrorNotReady;
+}
+
+gpuEvent_t MXReadyEvent::event() const { return event_; }
+#endif
+
 // This class intentionally does not have destructor at the moment.
 //
 // Unfortunately, by the time this destructor would be called in normal
@@ -26,6 +26,21 @@ using namespace horovod::common;
 
 typedef ::mxnet::NDArray NDArray;
 
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+// Recorded on the stream of the engine operation, once the engine made it
+// wait for the operations writing the inputs.
+class MXReadyEvent : public ReadyEvent {
+public:
+  MXReadyEvent(cudaStream_t stream);
+  ~MXReadyEvent() override;
+  bool Ready() const override;
+  gpuEvent_t event() const override;
+
+private:
+  cudaEvent_t event_;
+};
+#endif
+
 class MXPersistentBuffer : public PersistentBuffer {
 public:
   MXPersistentBuffer(int device, int64_t size);
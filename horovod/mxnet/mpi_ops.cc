@@ -15,6 +15,7 @@
 // =============================================================================
 
 #include <atomic>
+#include <mutex>
 
 #include "../common/operations.h"
 #include "cuda_util.h"
@@ -39,6 +40,9 @@ std::string GetOpName(const char* prefix, const char* name) {
 
 static const auto MX_EXEC_CTX = Context();
 static const auto MX_FUNC_PROP = FnProperty::kCPUPrioritized;
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+static const auto MX_GPU_FUNC_PROP = FnProperty::kNormal;
+#endif
 static const char* ALLREDUCE_OP_TYPE_NAME = "horovod_allreduce";
 static const char* ALLGATHER_OP_TYPE_NAME = "horovod_allgather";
 static const char* BROADCAST_OP_TYPE_NAME = "horovod_broadcast";
@@ -72,7 +76,16 @@ bool IsTensorOnCPU(NDArray* tensor) {
   return tensor->ctx().dev_mask() == cpu::kDevMask;
 }
 
+#if MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+void DoHorovodOperation(void* run_ctx_ptr, void* on_start_ptr,
+                        void* on_complete_ptr, void* param) {
+  // On GPU, makes the stream of the operation wait for the operations
+  // writing the inputs.
+  auto on_start = *static_cast<CallbackOnStart*>(on_start_ptr);
+  on_start();
+#else
 void DoHorovodOperation(void*, void* on_complete_ptr, void* param) {
+#endif
   ThrowIfError(common::CheckInitialized());
 
   auto on_complete = *static_cast<CallbackOnComplete*>(on_complete_ptr);
@@ -90,19 +103,31 @@ void DoHorovodOperation(void*, void* on_complete_ptr, void* param) {
   auto hvd_context = std::make_shared<MXOpContext>(device, output);  
   std::shared_ptr<Tensor> hvd_output = nullptr;  
 
+  // The inputs are ready on the device once the stream of the operation
+  // reaches the event, Horovod waits for it on its own stream.
+  std::shared_ptr<common::ReadyEvent> ready_event = nullptr;
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+  if (device != CPU_DEVICE_ID) {
+    auto run_ctx = static_cast<::mxnet::RunContext*>(run_ctx_ptr);
+    ready_event = std::make_shared<MXReadyEvent>(
+        mshadow::Stream<mshadow::gpu>::GetStream(
+            run_ctx->get_stream<mshadow::gpu>()));
+  }
+#endif
+
   Status enqueue_result;
   switch (ops_param->op_type) {
     case OperationType::ALLREDUCE:
       hvd_output = std::make_shared<MXTensor>(output_tensor);
       enqueue_result = EnqueueTensorAllreduce(
-          hvd_context, hvd_tensor, hvd_output, nullptr, name, device,
+          hvd_context, hvd_tensor, hvd_output, ready_event, name, device,
           [on_complete](const Status& status) {
             InvokeCompleteCallback(on_complete, status);
       }, (average) ? ReduceOp::AVERAGE : ReduceOp::SUM, prescale_factor, postscale_factor);
       break;
     case OperationType::ALLGATHER:
       enqueue_result = EnqueueTensorAllgather(
-          hvd_context, hvd_tensor, nullptr, name, device,
+          hvd_context, hvd_tensor, ready_event, name, device,
           [on_complete](const Status& status) {
             InvokeCompleteCallback(on_complete, status);
       });
@@ -114,7 +139,7 @@ void DoHorovodOperation(void*, void* on_complete_ptr, void* param) {
 
       enqueue_result = EnqueueTensorBroadcast(
           hvd_context, hvd_tensor, hvd_output, ops_param->root_rank,
-          nullptr, name, device,
+          ready_event, name, device,
           [on_complete](const Status& status) {
             InvokeCompleteCallback(on_complete, status);
       });
@@ -123,7 +148,7 @@ void DoHorovodOperation(void*, void* on_complete_ptr, void* param) {
     {
       auto hvd_splits = std::make_shared<MXTensor>(ops_param->splits_tensor.get());
       enqueue_result = EnqueueTensorAlltoall(
-          hvd_context, hvd_tensor, hvd_splits, nullptr, name, device,
+          hvd_context, hvd_tensor, hvd_splits, ready_event, name, device,
           [on_complete](const Status& status) {
             InvokeCompleteCallback(on_complete, status);
       });
@@ -136,6 +161,77 @@ void DoHorovodOperation(void*, void* on_complete_ptr, void* param) {
   ThrowIfError(enqueue_result);
 }
 
+// Enqueues the allreduces of a grouped operation together, and completes the
+// operation once all of them are done, with the first error if any failed.
+#if MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+void DoGroupedAllreduce(void* run_ctx_ptr, void* on_start_ptr,
+                        void* on_complete_ptr, void* param) {
+  auto on_start = *static_cast<CallbackOnStart*>(on_start_ptr);
+  on_start();
+#else
+void DoGroupedAllreduce(void*, void* on_complete_ptr, void* param) {
+#endif
+  ThrowIfError(common::CheckInitialized());
+
+  auto on_complete = *static_cast<CallbackOnComplete*>(on_complete_ptr);
+  auto ops_param = static_cast<GroupedMpiOpsParam*>(param);
+  auto num_tensors = ops_param->input_tensors.size();
+  auto device = TensorUtil::GetDevice(ops_param->input_tensors[0].get());
+
+  std::shared_ptr<common::ReadyEvent> ready_event = nullptr;
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+  if (device != CPU_DEVICE_ID) {
+    auto run_ctx = static_cast<::mxnet::RunContext*>(run_ctx_ptr);
+    ready_event = std::make_shared<MXReadyEvent>(
+        mshadow::Stream<mshadow::gpu>::GetStream(
+            run_ctx->get_stream<mshadow::gpu>()));
+  }
+#endif
+
+  struct GroupCompletion {
+    std::mutex mutex;
+    size_t remaining;
+    Status status;
+  };
+  auto completion = std::make_shared<GroupCompletion>();
+  completion->remaining = num_tensors;
+
+  std::vector<std::shared_ptr<OpContext>> hvd_contexts;
+  std::vector<std::shared_ptr<Tensor>> hvd_tensors;
+  std::vector<std::shared_ptr<Tensor>> hvd_outputs;
+  std::vector<std::string> names;
+  std::vector<StatusCallback> callbacks;
+  for (size_t i = 0; i < num_tensors; ++i) {
+    hvd_contexts.push_back(
+        std::make_shared<MXOpContext>(device, ops_param->outputs[i]));
+    hvd_tensors.push_back(
+        std::make_shared<MXTensor>(ops_param->input_tensors[i].get()));
+    hvd_outputs.push_back(
+        std::make_shared<MXTensor>(ops_param->output_tensors[i].get()));
+    names.push_back(ops_param->op_name + "." + std::to_string(i));
+    callbacks.push_back([on_complete, completion](const Status& status) {
+      Status result;
+      {
+        std::lock_guard<std::mutex> guard(completion->mutex);
+        if (!status.ok() && completion->status.ok()) {
+          completion->status = status;
+        }
+        if (--completion->remaining > 0) {
+          return;
+        }
+        result = completion->status;
+      }
+      InvokeCompleteCallback(on_complete, result);
+    });
+  }
+
+  auto enqueue_result = EnqueueTensorAllreduces(
+      hvd_contexts, hvd_tensors, hvd_outputs, ready_event, names, device,
+      callbacks, ops_param->average ? ReduceOp::AVERAGE : ReduceOp::SUM,
+      ops_param->prescale_factor, ops_param->postscale_factor);
+  ThrowIfError(enqueue_result);
+}
+
 inline void PushHorovodOperation(OperationType op_type, NDArray* input,
                                  NDArray* output, const char* name,
                                  int priority, int root_rank = -1,
@@ -170,6 +266,17 @@ inline void PushHorovodOperation(OperationType op_type, NDArray* input,
     nullptr /* cpu_input_tensor */, nullptr /* cpu_output_tensor */,
     op_type, op_name, root_rank, average, splits_tensor, prescale_factor, postscale_factor);
 
+  // GPU tensors are reduced from an operation on their device, which waits for
+  // its inputs on the device instead of the host.
+  auto exec_ctx = MX_EXEC_CTX;
+  auto func_prop = MX_FUNC_PROP;
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+  if (!IsTensorOnCPU(input)) {
+    exec_ctx = input->ctx();
+    func_prop = MX_GPU_FUNC_PROP;
+  }
+#endif
+
   // Not in-place
   auto input_var = input->var();
   auto output_var = output->var();
@@ -180,8 +287,8 @@ inline void PushHorovodOperation(OperationType op_type, NDArray* input,
       input_vars.push_back(splits_tensor->var());
     }
     MXEnginePushAsync(DoHorovodOperation, ops_param, DeleteMpiOpsParam,
-                      &MX_EXEC_CTX, input_vars.data(), input_vars.size(), &output_var, 1,
-                      &MX_FUNC_PROP, priority, op_type_name);
+                      &exec_ctx, input_vars.data(), input_vars.size(), &output_var, 1,
+                      &func_prop, priority, op_type_name);
   // In-place
   } else {
     std::vector<void*> input_vars;
@@ -189,13 +296,20 @@ inline void PushHorovodOperation(OperationType op_type, NDArray* input,
       input_vars.push_back(splits_tensor->var());
     }
     MXEnginePushAsync(DoHorovodOperation, ops_param, DeleteMpiOpsParam,
-                      &MX_EXEC_CTX, input_vars.data(), input_vars.size(), &output_var, 1,
-                      &MX_FUNC_PROP, priority, op_type_name);
+                      &exec_ctx, input_vars.data(), input_vars.size(), &output_var, 1,
+                      &func_prop, priority, op_type_name);
   }
 }
 
 #if HAVE_CUDA
+#if MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+void DoHorovodOperationCudaOnCPU(void*, void* on_start_ptr,
+                                 void* on_complete_ptr, void* param) {
+  auto on_start = *static_cast<CallbackOnStart*>(on_start_ptr);
+  on_start();
+#else
 void DoHorovodOperationCudaOnCPU(void*, void* on_complete_ptr, void* param) {
+#endif
   ThrowIfError(common::CheckInitialized());
 
   auto on_complete = *static_cast<CallbackOnComplete*>(on_complete_ptr);
@@ -354,6 +468,82 @@ extern "C" int horovod_mxnet_allreduce_async(NDArray* input, NDArray* output,
   MX_API_END();
 }
 
+extern "C" int horovod_mxnet_grouped_allreduce_async(NDArray** inputs,
+                                                     NDArray** outputs,
+                                                     int num_tensors,
+                                                     const char* name,
+                                                     bool average,
+                                                     int priority,
+                                                     double prescale_factor,
+                                                     double postscale_factor) {
+  MX_API_BEGIN();
+
+#if HAVE_ROCM
+  // Averaging left at framework level for ROCm until ScaleBuffer implementation
+  // added.
+  bool average_in_framework = average;
+  average = false;
+#endif
+
+  auto op_name = GetOpName(ALLREDUCE_OP_TYPE_NAME, name);
+#if HAVE_CUDA && !HOROVOD_GPU_ALLREDUCE
+  if (!IsTensorOnCPU(inputs[0])) {
+    // GPU tensors are reduced in CPU copies, one operation each.
+    for (int i = 0; i < num_tensors; ++i) {
+      auto tensor_name = op_name + "." + std::to_string(i);
+      PushHorovodOperationCudaOnCPU(OperationType::ALLREDUCE, inputs[i],
+                                    outputs[i], tensor_name.c_str(), priority,
+                                    -1, average, nullptr, prescale_factor,
+                                    postscale_factor);
+    }
+  } else {
+#endif
+  // The operation reads all inputs and writes all outputs, the in-place ones
+  // are only listed as outputs.
+  auto ops_param = new GroupedMpiOpsParam();
+  ops_param->op_name = op_name;
+  ops_param->average = average;
+  ops_param->prescale_factor = prescale_factor;
+  ops_param->postscale_factor = postscale_factor;
+  std::vector<void*> input_vars;
+  std::vector<void*> output_vars;
+  for (int i = 0; i < num_tensors; ++i) {
+    ops_param->input_tensors.push_back(std::make_shared<NDArray>(*inputs[i]));
+    ops_param->output_tensors.push_back(std::make_shared<NDArray>(*outputs[i]));
+    ops_param->outputs.push_back(outputs[i]);
+    if (inputs[i]->var() != outputs[i]->var()) {
+      input_vars.push_back(inputs[i]->var());
+    }
+    output_vars.push_back(outputs[i]->var());
+  }
+
+  auto exec_ctx = MX_EXEC_CTX;
+  auto func_prop = MX_FUNC_PROP;
+#if HAVE_CUDA && MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+  if (!IsTensorOnCPU(inputs[0])) {
+    exec_ctx = inputs[0]->ctx();
+    func_prop = MX_GPU_FUNC_PROP;
+  }
+#endif
+  MXEnginePushAsync(DoGroupedAllreduce, ops_param, DeleteGroupedMpiOpsParam,
+                    &exec_ctx, input_vars.data(), input_vars.size(),
+                    output_vars.data(), output_vars.size(), &func_prop,
+                    priority, ALLREDUCE_OP_TYPE_NAME);
+#if HAVE_CUDA && !HOROVOD_GPU_ALLREDUCE
+  }
+#endif
+
+#if HAVE_ROCM
+  if (average_in_framework) {
+    for (int i = 0; i < num_tensors; ++i) {
+      *outputs[i] /= horovod_size();
+    }
+  }
+#endif
+
+  MX_API_END();
+}
+
 extern "C" int horovod_mxnet_allgather_async(NDArray* input,
                                              NDArray* output,
                                              const char* name, int priority) {
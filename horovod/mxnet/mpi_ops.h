@@ -33,6 +33,9 @@ using namespace horovod::common;
 
 typedef ::mxnet::NDArray NDArray;
 typedef ::mxnet::Engine::CallbackOnComplete CallbackOnComplete;
+#if MXNET_ASYNC_GPU_ENGINE_SUPPORTED
+typedef ::mxnet::Engine::CallbackOnStart CallbackOnStart;
+#endif
 typedef Request::RequestType OperationType;
 typedef std::shared_ptr<MXTensor> MXTensorSharedPtr;
 typedef std::shared_ptr<NDArray> NDArraySharedPtr;
@@ -97,12 +100,36 @@ void DeleteMpiOpsParam(void* param) {
   delete ops_param;
 }
 
+// The tensors of a grouped allreduce, reduced as one engine operation.
+struct GroupedMpiOpsParam {
+  std::vector<NDArraySharedPtr> input_tensors;
+  std::vector<NDArraySharedPtr> output_tensors;
+  std::vector<NDArray*> outputs;
+  std::string op_name;
+  bool average;
+  double prescale_factor;
+  double postscale_factor;
+};
+
+void DeleteGroupedMpiOpsParam(void* param) {
+  auto ops_param = static_cast<GroupedMpiOpsParam*>(param);
+  delete ops_param;
+}
+
 extern "C" int horovod_mxnet_allreduce_async(NDArray* input,
                                              NDArray* output,
                                              const char* name, bool average,
                                              int priority,
                                              double prescale_factor,
                                              double postscale_factor);
+extern "C" int horovod_mxnet_grouped_allreduce_async(NDArray** inputs,
+                                                     NDArray** outputs,
+                                                     int num_tensors,
+                                                     const char* name,
+                                                     bool average,
+                                                     int priority,
+                                                     double prescale_factor,
+                                                     double postscale_factor);
 extern "C" int horovod_mxnet_allgather_async(NDArray* input,
                                              NDArray* output,
                                              const char* name, int priority);
@@ -31,6 +31,13 @@ shutdown = _basics.shutdown
 is_initialized = _basics.is_initialized
 start_timeline = _basics.start_timeline
 stop_timeline = _basics.stop_timeline
+flush_fusion_groups = _basics.flush_fusion_groups
+release_fusion_buffers = _basics.release_fusion_buffers
+fusion_buffer_bytes = _basics.fusion_buffer_bytes
+step_completed = _basics.step_completed
+get_overlap_stats = _basics.get_overlap_stats
+get_metrics = _basics.get_metrics
+get_straggler_scores = _basics.get_straggler_scores
 size = _basics.size
 local_size = _basics.local_size
 rank = _basics.rank
@@ -142,6 +149,85 @@ def allreduce_(tensor, average=True, name=None, priority=0, prescale_factor=1.0,
     return tensor
 
 
+def _grouped_allreduce(tensors, outputs, average, name, priority, prescale_factor,
+                       postscale_factor):
+    if not tensors:
+        raise ValueError('grouped_allreduce requires at least one tensor.')
+    if any(tensor.context != tensors[0].context for tensor in tensors):
+        raise ValueError('The tensors of a grouped allreduce must be on the same device.')
+    c_in = (ctypes.c_void_p * len(tensors))(*[tensor.handle for tensor in tensors])
+    c_out = (ctypes.c_void_p * len(outputs))(*[output.handle for output in outputs])
+    check_call(MPI_MXNET_LIB_CTYPES.horovod_mxnet_grouped_allreduce_async(
+        c_in, c_out, ctypes.c_int(len(tensors)),
+        c_str(name) if isinstance(name, string_types) else name,
+        ctypes.c_bool(average), ctypes.c_int(priority),
+        ctypes.c_double(prescale_factor),
+        ctypes.c_double(postscale_factor)))
+    return outputs
+
+
+def grouped_allreduce(tensors, average=True, name=None, priority=0,
+                      prescale_factor=1.0, postscale_factor=1.0):
+    """
+    A function that performs averaging or summation of a list of input tensors
+    over all the Horovod processes, as one operation. The input tensors are not
+    modified.
+
+    The tensors are negotiated together and fused as far as the fusion buffer
+    allows. The reduction operation is keyed by the name. If name is not
+    provided, an incremented auto-generated name is used. The list of tensors,
+    with their types and shapes, must be the same on all Horovod processes for
+    a given name.
+
+    Arguments:
+        tensors: A list of tensors to average and sum, all on the same device.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the reduction operation.
+        priority: The priority of this operation. Higher priority operations
+                  are likely to be executed before other operations.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce
+        postscale_factor: Multiplicative factor to scale tensors after allreduce
+
+    Returns:
+        A list of tensors of the same shapes and types as `tensors`, averaged
+        or summed across all processes.
+    """
+    outputs = [mx.nd.zeros(shape=tensor.shape, ctx=tensor.context,
+                           dtype=tensor.dtype) for tensor in tensors]
+    return _grouped_allreduce(tensors, outputs, average, name, priority,
+                              prescale_factor, postscale_factor)
+
+
+def grouped_allreduce_(tensors, average=True, name=None, priority=0,
+                       prescale_factor=1.0, postscale_factor=1.0):
+    """
+    A function that performs in-place averaging or summation of a list of input
+    tensors over all the Horovod processes, as one operation.
+
+    The tensors are negotiated together and fused as far as the fusion buffer
+    allows. The reduction operation is keyed by the name. If name is not
+    provided, an incremented auto-generated name is used. The list of tensors,
+    with their types and shapes, must be the same on all Horovod processes for
+    a given name.
+
+    Arguments:
+        tensors: A list of tensors to average and sum, all on the same device.
+        average: A flag indicating whether to compute average or summation,
+                 defaults to average.
+        name: A name of the reduction operation.
+        priority: The priority of this operation. Higher priority operations
+                  are likely to be executed before other operations.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce
+        postscale_factor: Multiplicative factor to scale tensors after allreduce
+
+    Returns:
+        The list of tensors, averaged or summed in place across all processes.
+    """
+    return _grouped_allreduce(tensors, tensors, average, name, priority,
+                              prescale_factor, postscale_factor)
+
+
 def allgather(tensor, name=None, priority=0):
     """
     A function that concatenates the input tensor with the same input tensor on
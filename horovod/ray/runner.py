@@ -1,5 +1,10 @@
 import ray
 from ray import services
+try:
+    from ray.util.placement_group import placement_group, \
+        remove_placement_group
+except ImportError:
+    placement_group = None
 
 from collections import defaultdict
 from dataclasses import dataclass
@@ -94,9 +99,11 @@ class NodeColocator:
     to be effectively allocated to their children. The child
     workers are currently allocated 0 resources in this implementation.
 
-    This is a mechanism for gang-scheduling and could be replaced
-    later on with placement groups. Gang-scheduling must occur because
-    otherwise another concurrent group could be placed on this node.
+    This is a mechanism for gang-scheduling. Gang-scheduling must occur
+    because otherwise another concurrent group could be placed on this
+    node. When Ray supports placement groups, the colocators themselves
+    are placed through a STRICT_SPREAD placement group, so that every
+    colocator gets a node of its own and all of them are scheduled at once.
 
     Right now, the only resources that are explicitly propogated to
     underlying colocated workers are cuda visible devices.
@@ -140,8 +147,13 @@ class NodeColocator:
         # colocation and balanced training.
         node_id = f"node:{services.get_node_ip_address()}"
         remote_cls = ray.remote(BaseHorovodWorker)
-        remote_cls = remote_cls.options(
+        worker_options = dict(
             num_cpus=0, num_gpus=0, resources={node_id: 0.01})
+        if placement_group is not None:
+            # The workers are pinned to the node through its resource
+            # label, the bundle of this colocator has none of it.
+            worker_options["placement_group"] = None
+        remote_cls = remote_cls.options(**worker_options)
 
         rank_start = self.num_slots * self.node_rank
 
@@ -306,17 +318,45 @@ class RayExecutor:
         self.cpus_per_slot = cpus_per_slot
         self.use_gpu = use_gpu
         self.gpus_per_slot = gpus_per_slot or 1
+        self.placement_group = None
 
     @property
     def num_workers(self):
         return self.num_hosts * self.num_slots
 
+    def _create_placement_group(self, host_resources):
+        """Reserves the resources of every host on a node of its own."""
+        bundle = {"CPU": host_resources["num_cpus"]}
+        if host_resources["num_gpus"] > 0:
+            bundle["GPU"] = host_resources["num_gpus"]
+        pg = placement_group([bundle] * self.num_hosts,
+                             strategy="STRICT_SPREAD")
+        ready, _ = ray.wait([pg.ready()],
+                            timeout=self.settings.start_timeout.remaining())
+        if not ready:
+            remove_placement_group(pg)
+            raise TimeoutError(
+                f"Timed out waiting for {self.num_hosts} nodes with "
+                f"{bundle} available resources each.")
+        return pg
+
     def _create_workers(self, host_resources, executable_cls, executable_args,
                         executable_kwargs):
-        colocator_cls = NodeColocator.options(**host_resources)
+        if placement_group is not None:
+            self.placement_group = self._create_placement_group(
+                host_resources)
+
+        def colocator_cls(node_rank):
+            options = dict(host_resources)
+            if self.placement_group is not None:
+                options.update(
+                    placement_group=self.placement_group,
+                    placement_group_bundle_index=node_rank)
+            return NodeColocator.options(**options)
+
         # Create a number of coordinators.
         colocators = [
-            colocator_cls.remote(
+            colocator_cls(node_rank).remote(
                 node_rank=node_rank,
                 num_slots=self.num_slots,
                 world_size=self.num_workers,
@@ -480,3 +520,7 @@ class RayExecutor:
 
         self.colocators = []
         self.workers = []
+
+        if self.placement_group is not None:
+            remove_placement_group(self.placement_group)
+            self.placement_group = None
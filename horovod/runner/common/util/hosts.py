@@ -55,17 +55,26 @@ def parse_host_files(filename):
     """
     Transform the hostfile into a format of
     <IP address> or <host name>:<Number of GPUs>
-    :param filename: Should be in <IP address> or <host name> slots=<number of GPUs>
+
+    Hosts tagged with the same switch=<name> are listed next to each other, in the order their
+    switch first appears, so that ranks, and with them ring neighbors, stay behind the same switch.
+
+    :param filename: Should be in <IP address> or <host name> slots=<number of GPUs> [switch=<switch name>]
     :return: Comma separated string of <IP address> or <host name>:<Number of GPUs>
     """
-    hosts = []
+    switch_hosts = collections.OrderedDict()
     with open(filename, 'r') as f:
         for line in f.readlines():
-            line = line.rstrip()
-            hostname = line.split()[0]
-            slots = line.split('=')[1]
-            hosts.append('{name}:{slots}'.format(name=hostname, slots=slots))
-    return ','.join(hosts)
+            fields = line.split()
+            if not fields:
+                continue
+            hostname = fields[0]
+            options = dict(field.split('=', 1) for field in fields[1:])
+            host = '{name}:{slots}'.format(name=hostname, slots=options['slots'])
+            # Untagged hosts keep their position, each in a group of its own.
+            switch = options.get('switch', (hostname,))
+            switch_hosts.setdefault(switch, []).append(host)
+    return ','.join(host for hosts in switch_hosts.values() for host in hosts)
 
 
 def parse_hosts_and_slots(hosts):
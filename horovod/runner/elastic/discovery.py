@@ -82,11 +82,19 @@ class HostManager(object):
         self._hosts_state = defaultdict(HostState)
         self._discovery = discovery
 
-    def update_available_hosts(self):
+    def find_available_hosts_and_slots(self):
+        return self._discovery.find_available_hosts_and_slots()
+
+    def update_available_hosts(self, host_slots=None):
+        """Updates the current hosts to host_slots, or to the result of a new discovery if it is None.
+
+        Returns True if the hosts changed.
+        """
         # TODO(travis): also check for hosts removed from the blacklist in the future
         prev_host_slots = self._current_hosts.host_slots
         prev_host_assignment_order = self._current_hosts.host_assignment_order
-        host_slots = self._discovery.find_available_hosts_and_slots()
+        if host_slots is None:
+            host_slots = self.find_available_hosts_and_slots()
         if prev_host_slots != host_slots:
             available_hosts = set([host for host in host_slots.keys() if not self._hosts_state[host].is_blacklisted()])
             host_assignment_order = HostManager.order_available_hosts(available_hosts, prev_host_assignment_order)
@@ -86,6 +86,7 @@ class ElasticDriver(object):
         self._worker_registry = WorkerStateRegistry(self, self._host_manager, reset_limit=reset_limit)
         self._results = ResultsRecorder()
         self._shutdown = threading.Event()
+        self._discovery_requested = threading.Event()
 
         self._discovery_thread = threading.Thread(target=self._discover_hosts)
         self._discovery_thread.daemon = True
@@ -96,11 +97,14 @@ class ElasticDriver(object):
         self._activate_workers(np)
 
     def resume(self):
+        # Workers failed, look for replacement hosts right away instead of at the next poll
+        self._discovery_requested.set()
         self._activate_workers(self._min_np)
 
     def stop(self, error_message=None):
         self._results.set_error_message(error_message)
         self._shutdown.set()
+        self._discovery_requested.set()
         self._rendezvous.stop()
         self._discovery_thread.join()
 
@@ -177,23 +181,26 @@ class ElasticDriver(object):
     def _discover_hosts(self):
         first_update = True
         while not self._shutdown.is_set():
-            self._wait_hosts_cond.acquire()
             try:
-                if self._host_manager.update_available_hosts():
-                    self._notify_workers_host_changes(self._host_manager.current_hosts)
-                    self._wait_hosts_cond.notify_all()
+                # The discovery script may take a while, so it runs without holding the lock that
+                # callers waiting for slots depend on
+                host_slots = self._host_manager.find_available_hosts_and_slots()
+                with self._wait_hosts_cond:
+                    if self._host_manager.update_available_hosts(host_slots):
+                        self._notify_workers_host_changes(self._host_manager.current_hosts)
+                        self._wait_hosts_cond.notify_all()
             except RuntimeError as e:
                 if first_update:
                     # Misconfiguration, fail the job immediately
-                    self._shutdown.set()
-                    self._wait_hosts_cond.notify_all()
+                    with self._wait_hosts_cond:
+                        self._shutdown.set()
+                        self._wait_hosts_cond.notify_all()
                     raise
                 # Transient error, retry until timeout
                 logging.warning(str(e))
-            finally:
-                self._wait_hosts_cond.release()
             first_update = False
-            self._shutdown.wait(DISCOVER_HOSTS_FREQUENCY_SECS)
+            self._discovery_requested.wait(DISCOVER_HOSTS_FREQUENCY_SECS)
+            self._discovery_requested.clear()
 
     def _notify_workers_host_changes(self, current_hosts):
         next_host_assignments = {}
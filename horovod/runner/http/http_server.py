@@ -17,7 +17,9 @@ import collections
 import logging
 import socket
 import socketserver
+import struct
 import threading
+import time
 
 from http.server import HTTPServer, SimpleHTTPRequestHandler
 
@@ -31,6 +33,9 @@ BAD_REQUEST = 400
 TIMEOUT = 408
 OK = 200
 
+# Lengths of keys and values in multi-get requests and responses.
+_LENGTH = struct.Struct('<I')
+
 
 class KVStoreHandler(SimpleHTTPRequestHandler):
     # Set timeout
@@ -87,6 +92,54 @@ class KVStoreHandler(SimpleHTTPRequestHandler):
         self._put_value(scope, key, value)
         self.send_status_code(OK)
 
+    # Override POST handler: multi-get of the keys listed in the body. The
+    # body and the response are sequences of length-prefixed strings, the
+    # response holds a key and its value for every key found. With the
+    # X-Wait-Keys and X-Wait-Timeout headers, servers that support it hold the
+    # response until the first X-Wait-Keys keys are all set, for at most
+    # X-Wait-Timeout milliseconds.
+    def do_POST(self):
+        paths = self.path.split('/')
+        if len(paths) < 3:
+            logging.error(
+                'KVStore ERROR: Invalid request path: {path}.'.format(
+                    path=self.path))
+            self.send_status_code(BAD_REQUEST)
+            return
+
+        scope = paths[1]
+        content_length = int(self.headers['Content-Length'])
+        try:
+            body = self.rfile.read(content_length)
+        except socket.timeout:
+            self.send_status_code(TIMEOUT)
+            return
+
+        keys = []
+        offset = 0
+        while offset + _LENGTH.size <= len(body):
+            length, = _LENGTH.unpack_from(body, offset)
+            offset += _LENGTH.size
+            keys.append(body[offset:offset + length].decode('utf-8'))
+            offset += length
+
+        values = self._get_values(scope, keys,
+                                  int(self.headers.get('X-Wait-Keys', 0)),
+                                  int(self.headers.get('X-Wait-Timeout', 0)) / 1000.0)
+
+        chunks = []
+        for key, value in zip(keys, values):
+            if value is not None:
+                encoded_key = key.encode('utf-8')
+                chunks += [_LENGTH.pack(len(encoded_key)), encoded_key,
+                           _LENGTH.pack(len(value)), value]
+        response = b''.join(chunks)
+
+        self.send_response(OK)
+        self.send_header("Content-Length", str(len(response)))
+        self.end_headers()
+        self.wfile.write(response)
+
     def send_status_code(self, status_code):
         self.send_response(status_code)
         self.send_header("Content-Length", 0)
@@ -101,10 +154,29 @@ class KVStoreHandler(SimpleHTTPRequestHandler):
         with self.server.cache_lock:
             return self.server.cache.get(scope, {}).get(key)
 
+    def _get_values(self, scope, keys, num_wait_keys, wait_secs):
+        cache_cond = getattr(self.server, 'cache_cond', None)
+        deadline = time.monotonic() + wait_secs
+        while True:
+            if cache_cond is not None:
+                with cache_cond:
+                    version = self.server.cache_version
+            values = [self._get_value(scope, key) for key in keys]
+            remaining = deadline - time.monotonic()
+            if cache_cond is None or remaining <= 0 or \
+                    all(value is not None for value in values[:num_wait_keys]):
+                return values
+            # Waits for the next put, which may set one of the keys.
+            with cache_cond:
+                cache_cond.wait_for(lambda: self.server.cache_version != version, remaining)
+
     def _put_value(self, scope, key, value):
         with self.server.cache_lock:
             scope_dict = self.server.cache.setdefault(scope, {})
             scope_dict[key] = value
+            if getattr(self.server, 'cache_cond', None) is not None:
+                self.server.cache_version += 1
+                self.server.cache_cond.notify_all()
             if self.server.verbose:
                 logging.info('scope %s has keys %s', scope, list(self.server.cache[scope].keys()))
 
@@ -124,7 +196,7 @@ class RendezvousHandler(KVStoreHandler):
 
         with self.server.finished_list_lock:
             self.server.finished_list[scope].append(key)
-            if self.server.scope_size[scope] == len(self.server.finished_list[scope]):
+            if self.server.get_scope_size(scope) == len(self.server.finished_list[scope]):
                 with self.server.cache_lock:
                     self.server.cache.get(scope, {}).clear()
 
@@ -141,6 +213,11 @@ class RendezvousHTTPServer(socketserver.ThreadingMixIn, HTTPServer, object):
         self.cache_lock = threading.Lock()
         self.cache = {}
 
+        # Notified on every put, for multi-gets waiting for keys. Every
+        # request has its own thread, so waiting requests do not hold up others.
+        self.cache_cond = threading.Condition(self.cache_lock)
+        self.cache_version = 0
+
         self.verbose = verbose
 
         # Lists for finished rendezvous workers
@@ -167,6 +244,13 @@ class RendezvousHTTPServer(socketserver.ThreadingMixIn, HTTPServer, object):
             local_rank = slot_info.local_rank
             self.scope_size['cross_' + str(local_rank)] = slot_info.cross_size
 
+    def get_scope_size(self, scope):
+        # Additional Gloo lanes rendezvous in scopes named global_lane_<i>,
+        # with all the ranks of the global scope.
+        if scope.startswith('global_lane_'):
+            scope = 'global'
+        return self.scope_size[scope]
+
     def should_continue(self):
         return True
 
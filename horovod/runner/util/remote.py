@@ -13,15 +13,30 @@
 # limitations under the License.
 # ==============================================================================
 
+import os
+
 from horovod.runner.common.util import env as env_util
 
 SSH_COMMAND_PREFIX = 'ssh -o PasswordAuthentication=no -o StrictHostKeyChecking=no'
 
+# Seconds an SSH master connection to a host stays open after its last session,
+# so that the SSH check, the task servers and the workers share one connection.
+HOROVOD_SSH_CONTROL_PERSIST = 'HOROVOD_SSH_CONTROL_PERSIST'
+SSH_CONTROL_PATH = '/tmp/horovod-ssh-%C'
+
+
+def _get_ssh_multiplexing_args():
+    persist = int(os.environ.get(HOROVOD_SSH_CONTROL_PERSIST, 0))
+    if persist <= 0:
+        return ''
+    return f'-o ControlMaster=auto -o ControlPath={SSH_CONTROL_PATH} -o ControlPersist={persist}'
+
 
 def get_ssh_command(local_command, host, port=None, identity_file=None):
     port_arg = f'-p {port}' if port is not None else ''
     identity_file_arg = f'-i {identity_file}' if identity_file is not None else ''
-    return f'{SSH_COMMAND_PREFIX} {host} {port_arg} {identity_file_arg} {local_command}'
+    multiplexing_args = _get_ssh_multiplexing_args()
+    return f'{SSH_COMMAND_PREFIX} {host} {port_arg} {identity_file_arg} {multiplexing_args} {local_command}'
 
 
 def get_remote_command(local_command, host, port=None, identity_file=None):
@@ -13,19 +13,25 @@
 # limitations under the License.
 # ==============================================================================
 
+import collections
 import contextlib
 import errno
 import os
 import re
 import shutil
 import tempfile
+import threading
 import warnings
 
+from concurrent.futures import ThreadPoolExecutor
 from distutils.version import LooseVersion
 
 import pyarrow as pa
 import pyarrow.parquet as pq
 
+# The size of the parts a file is read in when the store reads in parallel.
+_READ_PART_BYTES = 64 * 1024 * 1024
+
 
 class Store(object):
     """
@@ -111,6 +117,16 @@ class Store(object):
         """Returns a function that synchronises given path recursively into run path for `run_id`."""
         raise NotImplementedError()
 
+    def wait_for_sync_fn(self, run_id):
+        """Returns a function that waits until the paths synchronised for `run_id` are in the store."""
+        def fn():
+            pass
+        return fn
+
+    def get_read_parallelism(self):
+        """Returns how many parts of a file, or files of a dataset, are read concurrently."""
+        return 1
+
     def to_remote(self, run_id, dataset_idx):
         """Returns a view of the store that can execute in a remote environment without Horoovd deps."""
         attrs = self._remote_attrs(run_id, dataset_idx)
@@ -135,7 +151,8 @@ class Store(object):
             'checkpoint_filename': self.get_checkpoint_filename(),
             'logs_subdir': self.get_logs_subdir(),
             'get_local_output_dir': self.get_local_output_dir_fn(run_id),
-            'sync': self.sync_fn(run_id)
+            'sync': self.sync_fn(run_id),
+            'wait_for_sync': self.wait_for_sync_fn(run_id)
         }
 
     @staticmethod
@@ -147,23 +164,48 @@ class Store(object):
 
 
 class FilesystemStore(Store):
-    """Abstract class for stores that use a filesystem for underlying storage."""
+    """Abstract class for stores that use a filesystem for underlying storage.
+
+    With `read_parallelism` greater than 1, files larger than 64 MB are read in parts of 64 MB, that many at
+    a time, and so are the footers of the files of Parquet datasets.
+    """
 
-    def __init__(self, prefix_path, train_path=None, val_path=None, test_path=None, runs_path=None, save_runs=True):
+    def __init__(self, prefix_path, train_path=None, val_path=None, test_path=None, runs_path=None, save_runs=True,
+                 read_parallelism=1):
         self.prefix_path = self.get_full_path(prefix_path)
         self._train_path = self._get_full_path_or_default(train_path, 'intermediate_train_data')
         self._val_path = self._get_full_path_or_default(val_path, 'intermediate_val_data')
         self._test_path = self._get_full_path_or_default(test_path, 'intermediate_test_data')
         self._runs_path = self._get_full_path_or_default(runs_path, 'runs')
         self._save_runs = save_runs
+        self._read_parallelism = max(read_parallelism, 1)
         super(FilesystemStore, self).__init__()
 
     def exists(self, path):
         return self.get_filesystem().exists(self.get_localized_path(path))
 
     def read(self, path):
-        with self.get_filesystem().open(self.get_localized_path(path), 'rb') as f:
-            return f.read()
+        fs = self.get_filesystem()
+        localized_path = self.get_localized_path(path)
+        with fs.open(localized_path, 'rb') as f:
+            if self._read_parallelism == 1:
+                return f.read()
+            f.seek(0, os.SEEK_END)
+            size = f.tell()
+            f.seek(0)
+            if size <= _READ_PART_BYTES:
+                return f.read()
+
+        def read_part(offset):
+            with fs.open(localized_path, 'rb') as f:
+                f.seek(offset)
+                return f.read(min(_READ_PART_BYTES, size - offset))
+
+        with ThreadPoolExecutor(max_workers=self._read_parallelism) as executor:
+            return b''.join(executor.map(read_part, range(0, size, _READ_PART_BYTES)))
+
+    def get_read_parallelism(self):
+        return self._read_parallelism
 
     def read_serialized_keras_model(self, ckpt_path, model, custom_objects):
         """Reads the checkpoint file of the keras model into model bytes and returns the base 64
@@ -330,6 +372,11 @@ class HDFSStore(FilesystemStore):
     information will be used to initialize PyArrow `HadoopFilesystem` if they are not provided through the `host` and
     `port` arguments to this initializer. These parameters will default to `default` and `0` if neither the path URL
     nor the arguments provide this information.
+
+    With `async_upload`, the files synchronised into a run path are copied into a local staging directory under
+    `temp_dir`, and uploaded from there on a background thread, so that the training process does not wait for
+    HDFS. A file synchronised again before its previous copy is uploaded only uploads the newest copy. The upload
+    errors are raised by the next synchronisation, or when waiting for the uploads at the end of training.
     """
 
     FS_PREFIX = 'hdfs://'
@@ -337,8 +384,9 @@ class HDFSStore(FilesystemStore):
 
     def __init__(self, prefix_path,
                  host=None, port=None, user=None, kerb_ticket=None,
-                 driver='libhdfs', extra_conf=None, temp_dir=None, *args, **kwargs):
+                 driver='libhdfs', extra_conf=None, temp_dir=None, *args, async_upload=False, **kwargs):
         self._temp_dir = temp_dir
+        self._async_upload = async_upload
 
         prefix, url_host, url_port, path, path_offset = self.parse_url(prefix_path)
         self._check_url(prefix_path, prefix, path)
@@ -398,9 +446,13 @@ class HDFSStore(FilesystemStore):
         state = SyncState()
         get_filesystem = self._get_filesystem_fn()
         hdfs_root_path = self.get_run_path(run_id)
+        async_upload = self._async_upload
+        temp_dir = self._temp_dir
 
         def fn(local_run_path):
-            if state.fs is None:
+            if async_upload:
+                state.fs = _AsyncUploader.get(hdfs_root_path, get_filesystem, temp_dir)
+            elif state.fs is None:
                 state.fs = get_filesystem()
 
             hdfs = state.fs
@@ -422,12 +474,24 @@ class HDFSStore(FilesystemStore):
                             continue
 
                     hdfs_path = os.path.join(hdfs_dir, file)
-                    with open(local_path, 'rb') as f:
-                        hdfs.upload(hdfs_path, f)
+                    if async_upload:
+                        hdfs.stage(local_path, hdfs_path)
+                    else:
+                        with open(local_path, 'rb') as f:
+                            hdfs.upload(hdfs_path, f)
                     uploaded[local_path] = modified_ts
 
         return fn
 
+    def wait_for_sync_fn(self, run_id):
+        hdfs_root_path = self.get_run_path(run_id)
+
+        def fn():
+            uploader = _AsyncUploader.find(hdfs_root_path)
+            if uploader is not None:
+                uploader.wait()
+        return fn
+
     def _get_filesystem_fn(self):
         hdfs_kwargs = self._hdfs_kwargs
 
@@ -449,6 +513,86 @@ class HDFSStore(FilesystemStore):
         return cls.FS_PREFIX
 
 
+class _AsyncUploader(object):
+    """Uploads staged copies of local files to a filesystem on a background thread.
+
+    There is one uploader per run path in a process, created by the first synchronisation.
+    """
+
+    _lock = threading.Lock()
+    _uploaders = {}
+
+    @classmethod
+    def get(cls, root_path, get_filesystem, temp_dir):
+        with cls._lock:
+            if root_path not in cls._uploaders:
+                cls._uploaders[root_path] = _AsyncUploader(get_filesystem, temp_dir)
+            return cls._uploaders[root_path]
+
+    @classmethod
+    def find(cls, root_path):
+        with cls._lock:
+            return cls._uploaders.get(root_path)
+
+    def __init__(self, get_filesystem, temp_dir):
+        self._get_filesystem = get_filesystem
+        self._staging_dir = tempfile.mkdtemp(dir=temp_dir)
+        self._staged = 0
+        # The staged copy of each remote path waiting to be uploaded, in the order they were staged.
+        self._pending = collections.OrderedDict()
+        self._uploading = False
+        self._error = None
+        self._cond = threading.Condition()
+        self._thread = threading.Thread(target=self._run, name='hdfs-store-upload', daemon=True)
+        self._thread.start()
+
+    def stage(self, local_path, remote_path):
+        self._raise_error()
+        self._staged += 1
+        staged_path = os.path.join(self._staging_dir, str(self._staged))
+        shutil.copyfile(local_path, staged_path)
+        with self._cond:
+            superseded = self._pending.pop(remote_path, None)
+            self._pending[remote_path] = staged_path
+            self._cond.notify_all()
+        if superseded is not None:
+            os.remove(superseded)
+
+    def wait(self):
+        with self._cond:
+            while self._pending or self._uploading:
+                self._cond.wait()
+        self._raise_error()
+
+    def _raise_error(self):
+        with self._cond:
+            error, self._error = self._error, None
+        if error is not None:
+            raise error
+
+    def _run(self):
+        fs = None
+        while True:
+            with self._cond:
+                while not self._pending:
+                    self._cond.wait()
+                remote_path, staged_path = self._pending.popitem(last=False)
+                self._uploading = True
+            try:
+                if fs is None:
+                    fs = self._get_filesystem()
+                with open(staged_path, 'rb') as f:
+                    fs.upload(remote_path, f)
+            except Exception as e:
+                with self._cond:
+                    self._error = e
+            finally:
+                os.remove(staged_path)
+                with self._cond:
+                    self._uploading = False
+                    self._cond.notify_all()
+
+
 class DBFSLocalStore(LocalStore):
     """Uses Databricks File System (DBFS) local file APIs as a store of intermediate data and
     training artifacts.
@@ -18,6 +18,8 @@ import horovod.spark.common._namedtuple_fix
 import contextlib
 import os
 
+from concurrent.futures import ThreadPoolExecutor
+
 import pyarrow as pa
 import numpy as np
 import pyspark.sql.functions as f
@@ -29,6 +31,11 @@ try:
     from pyspark.sql.pandas.types import from_arrow_type
 except ImportError:
     from pyspark.sql.types import from_arrow_type
+try:
+    # Spark 3.0 converts vectors to arrays in the JVM
+    from pyspark.ml.functions import vector_to_array
+except ImportError:
+    vector_to_array = None
 
 from horovod.runner.common.util import codec, host_hash as hh
 from horovod.spark.common import cache, constants
@@ -388,6 +395,18 @@ def to_petastorm_fn(schema_cols, metadata):
     return to_petastorm
 
 
+def _vectors_to_arrays(df):
+    """
+    Converts all vector columns into arrays of doubles with Spark SQL, so that the values never go
+    through Python row by row. Returns None if this version of Spark cannot do that.
+    """
+    if vector_to_array is None:
+        return None
+    return df.select([vector_to_array(df[field.name]).alias(field.name)
+                      if isinstance(field.dataType, VectorUDT) else df[field.name]
+                      for field in df.schema.fields])
+
+
 def _has_vector_column(df):
     for field in df.schema.fields:
         if isinstance(field.dataType, VectorUDT):
@@ -395,11 +414,12 @@ def _has_vector_column(df):
     return False
 
 
-def _get_dataset_info(dataset, dataset_id, path):
+def _get_dataset_info(dataset, dataset_id, path, read_parallelism=1):
     total_rows = 0
     total_byte_size = 0
-    for piece in dataset.pieces:
-        metadata = piece.get_metadata()
+    with ThreadPoolExecutor(max_workers=read_parallelism) as executor:
+        pieces_metadata = list(executor.map(lambda piece: piece.get_metadata(), dataset.pieces))
+    for metadata in pieces_metadata:
         total_rows += metadata.num_rows
         for row_group_index in range(metadata.num_row_groups):
             row_group = metadata.row_group(row_group_index)
@@ -489,7 +509,8 @@ def get_simple_meta_from_parquet(store, label_columns, feature_columns, sample_w
     train_data = store.get_parquet_dataset(train_data_path)
     train_data_schema = train_data.schema.to_arrow_schema()
     train_rows, train_data_total_byte_size = _get_dataset_info(train_data, 'training',
-                                                               train_data_path)
+                                                               train_data_path,
+                                                               store.get_read_parallelism())
 
     # Write train metadata to filesystem
     _save_meta_to_fs(fs, train_data_meta_path, train_data_schema, train_rows,
@@ -500,7 +521,8 @@ def get_simple_meta_from_parquet(store, label_columns, feature_columns, sample_w
         val_data = store.get_parquet_dataset(validation_data_path)
         val_data_schema = val_data.schema.to_arrow_schema()
         val_rows, val_data_total_byte_size = _get_dataset_info(val_data, 'validation',
-                                                               validation_data_path)
+                                                               validation_data_path,
+                                                               store.get_read_parallelism())
 
         # Write validation metadata to filesystem
         _save_meta_to_fs(fs, val_data_meta_path, val_data_schema, val_rows,
@@ -571,10 +593,17 @@ def _get_or_create_dataset(key, store, df, feature_columns, label_columns,
 
             metadata = None
             if _has_vector_column(df):
+                array_df = None
                 if compress_sparse:
                     metadata = _get_metadata(df)
-                to_petastorm = to_petastorm_fn(schema_cols, metadata)
-                df = df.rdd.map(to_petastorm).toDF()
+                else:
+                    array_df = _vectors_to_arrays(df)
+
+                if array_df is not None:
+                    df = array_df
+                else:
+                    to_petastorm = to_petastorm_fn(schema_cols, metadata)
+                    df = df.rdd.map(to_petastorm).toDF()
 
             train_df, val_df, validation_ratio = _train_val_split(df, validation)
 
@@ -76,6 +76,8 @@ class TFKerasUtil(object):
                 dataset = dataset.batch(1).map(reshape)
 
             dataset = dataset.batch(batch_size).map(prep_data_tf_keras)
+            # Prepare the next batches while the current step is training.
+            dataset = dataset.prefetch(tf.data.experimental.AUTOTUNE)
             return dataset
         return tf.autograph.experimental.do_not_convert(fn)
 
@@ -21,7 +21,7 @@ import numbers
 import time
 
 from pyspark import keyword_only
-from pyspark.ml.param.shared import Param, Params
+from pyspark.ml.param.shared import Param, Params, TypeConverters
 from pyspark.ml.util import MLWritable, MLReadable
 
 from horovod.runner.common.util import codec
@@ -134,6 +134,13 @@ class TorchEstimator(HorovodEstimator, TorchEstimatorParamsWritable,
                                high enough, or users need to apply transformation such as
                                decompression or data augmentation on raw data.
         val_reader_num_workers: Similar to the train_reader_num_workers.
+        reader_pool_type: Type of worker pool used by the Petastorm readers, either 'process' (default) or
+                          'thread'. Threads avoid serializing every row group between processes, and are
+                          faster when decoding the data releases the GIL.
+        prefetch_batches: Number of batches prepared ahead of training by a background thread (default: 2).
+                          On GPUs, the batches are copied through pinned memory on a separate CUDA stream
+                          so that the copies overlap with the training step. Set to 0 to prepare every batch
+                          on demand.
     """
 
     input_shapes = Param(Params._dummy(), 'input_shapes', 'input layer shapes')
@@ -141,6 +148,9 @@ class TorchEstimator(HorovodEstimator, TorchEstimatorParamsWritable,
                               'functions that construct the loss')
     train_minibatch_fn = Param(Params._dummy(), 'train_minibatch_fn',
                                'functions that construct the minibatch train function for torch')
+    prefetch_batches = Param(Params._dummy(), 'prefetch_batches',
+                             'number of batches prepared ahead of the training step',
+                             typeConverter=TypeConverters.toInt)
 
     @keyword_only
     def __init__(self,
@@ -172,13 +182,16 @@ class TorchEstimator(HorovodEstimator, TorchEstimatorParamsWritable,
                  transformation_fn=None,
                  train_reader_num_workers=None,
                  val_reader_num_workers=None,
+                 reader_pool_type=None,
+                 prefetch_batches=None,
                  label_shapes=None):
 
         super(TorchEstimator, self).__init__()
         self._setDefault(loss_constructors=None,
                          input_shapes=None,
                          train_minibatch_fn=None,
-                         transformation_fn=None)
+                         transformation_fn=None,
+                         prefetch_batches=2)
 
         kwargs = self._input_kwargs
 
@@ -193,6 +206,12 @@ class TorchEstimator(HorovodEstimator, TorchEstimatorParamsWritable,
     def getTrainMinibatchFn(self):
         return self.getOrDefault(self.train_minibatch_fn)
 
+    def setPrefetchBatches(self, value):
+        return self._set(prefetch_batches=value)
+
+    def getPrefetchBatches(self):
+        return self.getOrDefault(self.prefetch_batches)
+
     def setInputShapes(self, value):
         return self._set(input_shapes=value)
 
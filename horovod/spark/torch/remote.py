@@ -70,6 +70,8 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
     # Data reader parameters
     train_reader_worker_count = estimator.getTrainReaderNumWorker()
     val_reader_worker_count = estimator.getValReaderNumWorker()
+    reader_pool_type = estimator.getReaderPoolType()
+    prefetch_batches = estimator.getPrefetchBatches()
 
     # Utility functions
     deserialize = deserialize_fn()
@@ -82,6 +84,7 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
     update_metrics = _update_metrics_fn(metric_fn_groups)
     write_metrics_summary = _write_metrics_summary_fn()
     calculate_loss = _calculate_loss_fn()
+    prefetch = _prefetch_fn()
 
     # Storage
     store = estimator.getStore()
@@ -219,7 +222,7 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
             with reader_factory(remote_store.train_data_path,
                                 num_epochs=None,
                                 cur_shard=hvd.rank(),
-                                reader_pool_type='process',
+                                reader_pool_type=reader_pool_type,
                                 workers_count=train_reader_worker_count,
                                 shard_count=hvd.size(),
                                 hdfs_driver=PETASTORM_HDFS_DRIVER,
@@ -229,7 +232,7 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
                 with reader_factory(remote_store.val_data_path,
                                     num_epochs=None,
                                     cur_shard=hvd.rank(),
-                                    reader_pool_type='process',
+                                    reader_pool_type=reader_pool_type,
                                     workers_count=val_reader_worker_count,
                                     shard_count=hvd.size(),
                                     hdfs_driver=PETASTORM_HDFS_DRIVER,
@@ -241,7 +244,6 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
                     train_loader = BatchedDataLoader(train_reader,
                                                      batch_size=batch_size,
                                                      shuffling_queue_capacity=shuffle_buffer_size)
-                    train_loader_iter = iter(train_loader)
 
                     def prepare_batch(row):
                         inputs = [
@@ -257,12 +259,21 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
                         if sample_weights is not None:
                             sample_weights = sample_weights.float()
                         if cuda_available:
-                            inputs = [input.cuda() for input in inputs]
-                            labels = [label.cuda() for label in labels]
-                            if sample_weights:
-                                sample_weights = sample_weights.cuda()
+                            # Copies from pinned memory are asynchronous, they overlap with
+                            # the training step when the batch is prefetched.
+                            def to_gpu(tensor):
+                                if prefetch_batches > 0:
+                                    return tensor.pin_memory().cuda(non_blocking=True)
+                                return tensor.cuda()
+                            inputs = [to_gpu(input) for input in inputs]
+                            labels = [to_gpu(label) for label in labels]
+                            if sample_weights is not None:
+                                sample_weights = to_gpu(sample_weights)
                         return inputs, labels, sample_weights
 
+                    train_batches = prefetch(iter(train_loader), prepare_batch,
+                                             prefetch_batches, cuda_available)
+
                     def transform_outputs(outputs, labels):
                         if type(outputs) != tuple and type(outputs) != list:
                             outputs = [outputs]
@@ -312,8 +323,7 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
 
                         # iterate on one epoch
                         for batch_idx in range(steps_per_epoch):
-                            row = next(train_loader_iter)
-                            inputs, labels, sample_weights = prepare_batch(row)
+                            inputs, labels, sample_weights = next(train_batches)
                             outputs, loss = train_minibatch(model, optimizer, transform_outputs,
                                                             loss_fn, inputs, labels, sample_weights)
                             update_metrics(metric_value_groups, outputs, labels)
@@ -324,7 +334,8 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
 
                     if should_validate:
                         val_loader = BatchedDataLoader(val_reader, batch_size=batch_size)
-                        val_loader_iter = iter(val_loader)
+                        val_batches = prefetch(iter(val_loader), prepare_batch,
+                                               prefetch_batches, cuda_available)
                         if validation_steps_per_epoch is None:
                             validation_steps = int(math.ceil(float(val_rows) / batch_size / hvd.size()))
                         else:
@@ -339,8 +350,7 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
 
                             # iterate on one epoch
                             for batch_idx in range(validation_steps):
-                                row = next(val_loader_iter)
-                                inputs, labels, sample_weights = prepare_batch(row)
+                                inputs, labels, sample_weights = next(val_batches)
 
                                 outputs = model(*inputs)
                                 outputs, labels = transform_outputs(outputs, labels)
@@ -373,6 +383,8 @@ def RemoteTrainer(estimator, metadata, last_checkpoint_state, run_id, dataset_id
                                 remote_store.sync(run_output_dir)
 
             if hvd.rank() == 0:
+                if remote_store.saving_runs:
+                    remote_store.wait_for_sync()
                 best_checkpoint = torch.load(ckpt_file)
                 serialized_checkpoint = io.BytesIO()
                 torch.save(best_checkpoint, serialized_checkpoint)
@@ -394,6 +406,81 @@ def _train_minibatch_fn():
     return train_minibatch
 
 
+def _prefetch_fn():
+    def prefetch(rows, prepare_batch, num_batches, cuda_available):
+        """
+        Yields prepare_batch(row) for every row, with up to num_batches batches prepared ahead
+        by a background thread. On GPUs, the batches are prepared on a separate CUDA stream, and
+        the current stream waits for the copies of a batch only when it gets that batch.
+        """
+        import queue
+        import threading
+
+        if num_batches <= 0:
+            for row in rows:
+                yield prepare_batch(row)
+            return
+
+        batches = queue.Queue(maxsize=num_batches)
+        stopped = threading.Event()
+        device = torch.cuda.current_device() if cuda_available else None
+
+        def put(item):
+            while not stopped.is_set():
+                try:
+                    batches.put(item, timeout=1)
+                    return True
+                except queue.Full:
+                    pass
+            return False
+
+        def produce():
+            try:
+                stream = None
+                if cuda_available:
+                    # The current device is per thread.
+                    torch.cuda.set_device(device)
+                    stream = torch.cuda.Stream()
+                for row in rows:
+                    if stream is not None:
+                        with torch.cuda.stream(stream):
+                            batch = prepare_batch(row)
+                        ready = torch.cuda.Event()
+                        ready.record(stream)
+                    else:
+                        batch = prepare_batch(row)
+                        ready = None
+                    if not put((batch, ready, None)):
+                        return
+                put((None, None, StopIteration()))
+            except Exception as e:
+                put((None, None, e))
+
+        thread = threading.Thread(target=produce, daemon=True)
+        thread.start()
+        try:
+            while True:
+                batch, ready, error = batches.get()
+                if isinstance(error, StopIteration):
+                    return
+                if error is not None:
+                    raise error
+                if ready is not None:
+                    current_stream = torch.cuda.current_stream()
+                    current_stream.wait_event(ready)
+                    inputs, labels, sample_weights = batch
+                    # The batch was allocated on the prefetch stream, keep its memory from
+                    # being reused before the current stream is done with it.
+                    for tensor in inputs + labels + [sample_weights]:
+                        if tensor is not None:
+                            tensor.record_stream(current_stream)
+                yield batch
+        finally:
+            stopped.set()
+
+    return prefetch
+
+
 def _get_optimizer_with_unscaled_lr_fn():
     def get_optimizer_with_unscaled_lr(hvd, current_optimizer, optimizer_cls, model):
         optimizer_state = current_optimizer.state_dict()
@@ -26,9 +26,15 @@ check_extension('horovod.tensorflow', 'HOROVOD_WITH_TENSORFLOW', __file__, 'mpi_
 from horovod.tensorflow import elastic
 from horovod.tensorflow.compression import Compression
 from horovod.tensorflow.functions import allgather_object, broadcast_object, broadcast_object_fn, broadcast_variables
-from horovod.tensorflow.mpi_ops import allgather, broadcast, _allreduce, alltoall
+from horovod.tensorflow.mpi_ops import allgather, broadcast, _allreduce, _grouped_allreduce, alltoall
 from horovod.tensorflow.mpi_ops import init, shutdown
 from horovod.tensorflow.mpi_ops import is_initialized, start_timeline, stop_timeline
+from horovod.tensorflow.mpi_ops import flush_fusion_groups
+from horovod.tensorflow.mpi_ops import release_fusion_buffers, fusion_buffer_bytes
+from horovod.tensorflow.mpi_ops import step_completed
+from horovod.tensorflow.mpi_ops import get_overlap_stats
+from horovod.tensorflow.mpi_ops import get_metrics
+from horovod.tensorflow.mpi_ops import get_straggler_scores
 from horovod.tensorflow.mpi_ops import size, local_size, rank, local_rank, is_homogeneous
 from horovod.tensorflow.mpi_ops import rank_op, local_rank_op, size_op, local_size_op
 from horovod.tensorflow.mpi_ops import mpi_threads_supported, mpi_enabled, mpi_built
@@ -53,13 +59,14 @@ if tf.__version__.startswith('2.2.'):
 def allreduce(tensor, average=None, device_dense='', device_sparse='',
               compression=Compression.none, op=None,
               prescale_factor=1.0, postscale_factor=1.0,
-              name=None):
+              name=None, priority=0):
     """Perform an allreduce on a tf.Tensor or tf.IndexedSlices.
 
     This function performs a bandwidth-optimal ring allreduce on the input
-    tensor. If the input is an tf.IndexedSlices, the function instead does an
-    allgather on the values and the indices, effectively doing an allreduce on
-    the represented tensor.
+    tensor. If the input is an tf.IndexedSlices, the function instead adds up
+    the values of duplicate indices locally and does an allgather on the
+    values and the indices, effectively doing an allreduce on the represented
+    tensor.
 
     Arguments:
         tensor: tf.Tensor, tf.Variable, or tf.IndexedSlices to reduce.
@@ -81,6 +88,9 @@ def allreduce(tensor, average=None, device_dense='', device_sparse='',
         prescale_factor: Multiplicative factor to scale tensor before allreduce.
         postscale_factor: Multiplicative factor to scale tensor after allreduce.
         name: A name of the allreduce operation
+        priority: Scheduling priority of the allreduce of a dense tensor when
+                  HOROVOD_FUSION_PRIORITY is set. Tensors with lower values are
+                  reduced first.
 
     Returns:
         A tensor of the same shape and type as `tensor`, summed across all
@@ -97,8 +107,13 @@ def allreduce(tensor, average=None, device_dense='', device_sparse='',
             # For IndexedSlices, do two allgathers instead of an allreduce.
             horovod_size = tf.cast(size_op() if int(os.environ.get("HOROVOD_ELASTIC", 0)) else size(),
                                    dtype=tensor.values.dtype)
-            values = allgather(tensor.values)
-            indices = allgather(tensor.indices)
+            # Embedding lookups often gather the same row many times, its
+            # slices are added up so that each row is sent once per rank.
+            unique_indices, positions = tf.unique(tensor.indices)
+            local_values = tf.math.unsorted_segment_sum(
+                tensor.values, positions, tf.size(unique_indices))
+            values = allgather(local_values)
+            indices = allgather(unique_indices)
 
             # To make this operation into an average, divide allgathered values by
             # the Horovod size.
@@ -119,7 +134,7 @@ def allreduce(tensor, average=None, device_dense='', device_sparse='',
             summed_tensor_compressed = _allreduce(tensor_compressed, op=op,
                                                   prescale_factor=prescale_factor,
                                                   postscale_factor=postscale_factor,
-                                                  name=name)
+                                                  name=name, priority=priority)
             summed_tensor = compression.decompress(summed_tensor_compressed, ctx)
             if op == Adasum:
                 if 'CPU' not in tensor.device and gpu_available('tensorflow'):
@@ -153,6 +168,76 @@ def allreduce(tensor, average=None, device_dense='', device_sparse='',
         return new_tensor
 
 
+def grouped_allreduce(tensors, average=None, device_dense='', compression=Compression.none,
+                      op=None, prescale_factor=1.0, postscale_factor=1.0, name=None,
+                      priority=0):
+    """Perform an allreduce on a list of tf.Tensor, enqueued together once all of
+    them are ready.
+
+    Tensors of the same type are reduced by one op, which is scheduled once and
+    negotiated and fused by Horovod as a whole, instead of one op per tensor.
+
+    Arguments:
+        tensors: List of tf.Tensor or tf.Variable to reduce. The shapes of the
+                 inputs must be identical across all ranks.
+        average:
+            .. warning:: .. deprecated:: 0.19.0
+
+                Use `op` instead. Will be removed in v0.21.0.
+
+        device_dense: Device to be used for the tensors. Uses GPU by default
+                      if Horovod was built with HOROVOD_GPU_OPERATIONS.
+        compression: Compression algorithm used to reduce the amount of data
+                     sent and received by each worker node.  Defaults to not
+                     using compression.
+        op: The reduction operation to combine tensors across different ranks.
+            Defaults to Average if None is given. Adasum is not supported.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce.
+        postscale_factor: Multiplicative factor to scale tensors after allreduce.
+        name: A name of the allreduce operation
+        priority: Scheduling priority of the allreduces when HOROVOD_FUSION_PRIORITY
+                  is set. Tensors with lower values are reduced first.
+
+    Returns:
+        A list of tensors of the same shapes and types as `tensors`, summed
+        across all processes.
+    """
+    op = handle_average_backwards_compatibility(op, average)
+    if op == Adasum:
+        raise NotImplementedError('The Adasum reduction does not support grouped allreduce yet.')
+    if any(isinstance(tensor, tf.IndexedSlices) for tensor in tensors):
+        raise ValueError('Grouped allreduce does not support sparse tensors. Use allreduce instead, '
+                         'or convert them to dense tensors.')
+
+    average_in_framework = False
+    if rocm_built():
+        # For ROCm, perform averaging at framework level
+        average_in_framework = op == Average
+        op = Sum if op == Average else op
+
+    with tf.device(device_dense):
+        compressed = [compression.compress(tensor) for tensor in tensors]
+        # One op reduces tensors of one type.
+        groups = {}
+        for i, (tensor_compressed, _) in enumerate(compressed):
+            groups.setdefault(tensor_compressed.dtype, []).append(i)
+        results = [None] * len(tensors)
+        for group, indices in enumerate(groups.values()):
+            group_name = name if name is None or len(groups) == 1 else '%s_%d' % (name, group)
+            summed = _grouped_allreduce([compressed[i][0] for i in indices], op=op,
+                                        prescale_factor=prescale_factor,
+                                        postscale_factor=postscale_factor,
+                                        name=group_name, priority=priority)
+            for i, summed_tensor_compressed in zip(indices, summed):
+                summed_tensor = compression.decompress(summed_tensor_compressed, compressed[i][1])
+                if average_in_framework:
+                    horovod_size = tf.cast(size_op() if int(os.environ.get("HOROVOD_ELASTIC", 0)) else size(),
+                                           dtype=summed_tensor.dtype)
+                    summed_tensor = summed_tensor / horovod_size
+                results[i] = summed_tensor
+    return results
+
+
 def _allreduce_cond(tensor, *args, **kwargs):
     def allreduce_fn():
         return allreduce(tensor, *args, **kwargs)
@@ -164,6 +249,17 @@ def _allreduce_cond(tensor, *args, **kwargs):
                    allreduce_fn, id_fn)
 
 
+def _grouped_allreduce_cond(tensors, *args, **kwargs):
+    def allreduce_fn():
+        return grouped_allreduce(tensors, *args, **kwargs)
+
+    def id_fn():
+        return tensors
+
+    return tf.cond((size_op() > 1) if int(os.environ.get("HOROVOD_ELASTIC", 0)) else tf.convert_to_tensor(size() > 1),
+                   allreduce_fn, id_fn)
+
+
 try:
     _global_variables = tf.compat.v1.global_variables
 except AttributeError:
@@ -245,7 +341,8 @@ if _SessionRunHook is not None and _get_default_graph is not None:
 
 @_cache
 def _make_allreduce_grads_fn(name, device_dense, device_sparse,
-                             compression, sparse_as_dense, op, gradient_predivide_factor):
+                             compression, sparse_as_dense, op, gradient_predivide_factor,
+                             num_groups=0):
     if op == Average:
         # Split average operation across pre/postscale factors
         # C++ backend will apply additional 1 / size() factor to postscale_factor for op == Average.
@@ -262,15 +359,50 @@ def _make_allreduce_grads_fn(name, device_dense, device_sparse,
                          if grad is not None and isinstance(grad, tf.IndexedSlices)
                          else grad for grad in grads]
 
+            if num_groups > 0:
+                return _grouped_allreduce_grads(grads)
+
+            # Variables are usually listed in the order of the forward pass,
+            # so the first layers get the most urgent allreduce priority.
             return [_allreduce_cond(grad,
                                     device_dense=device_dense,
                                     device_sparse=device_sparse,
                                     compression=compression,
                                     op=op,
                                     prescale_factor=prescale_factor,
-                                    postscale_factor=postscale_factor)
+                                    postscale_factor=postscale_factor,
+                                    priority=i)
                     if grad is not None else grad
-                    for grad in grads]
+                    for i, grad in enumerate(grads)]
+
+    def _grouped_allreduce_grads(grads):
+        # Dense gradients are split into num_groups groups of consecutive
+        # gradients, each reduced by one op once all its gradients are ready.
+        grads = list(grads)
+        dense = [i for i, grad in enumerate(grads)
+                 if grad is not None and not isinstance(grad, tf.IndexedSlices)]
+        group_size = (len(dense) + num_groups - 1) // num_groups
+        for start in range(0, len(dense), group_size):
+            indices = dense[start:start + group_size]
+            reduced = _grouped_allreduce_cond([grads[i] for i in indices],
+                                              device_dense=device_dense,
+                                              compression=compression,
+                                              op=op,
+                                              prescale_factor=prescale_factor,
+                                              postscale_factor=postscale_factor,
+                                              priority=indices[0])
+            for i, grad in zip(indices, reduced):
+                grads[i] = grad
+        return [_allreduce_cond(grad,
+                                device_dense=device_dense,
+                                device_sparse=device_sparse,
+                                compression=compression,
+                                op=op,
+                                prescale_factor=prescale_factor,
+                                postscale_factor=postscale_factor,
+                                priority=i)
+                if isinstance(grad, tf.IndexedSlices) else grad
+                for i, grad in enumerate(grads)]
 
     if _executing_eagerly():
         return _make_subgraph(allreduce_grads)
@@ -296,7 +428,8 @@ if _LegacyOptimizer is not None:
 
         def __init__(self, optimizer, name=None, use_locking=False, device_dense='',
                     device_sparse='', compression=Compression.none,
-                    sparse_as_dense=False, op=Average, gradient_predivide_factor=1.0):
+                    sparse_as_dense=False, op=Average, gradient_predivide_factor=1.0,
+                    num_groups=0):
             if name is None:
                 name = "Distributed{}".format(type(optimizer).__name__)
             super(_DistributedOptimizer, self).__init__(name=name, use_locking=use_locking)
@@ -304,7 +437,7 @@ if _LegacyOptimizer is not None:
             self._optimizer = optimizer
             self._allreduce_grads = _make_allreduce_grads_fn(
                 name, device_dense, device_sparse, compression, sparse_as_dense, op,
-                gradient_predivide_factor)
+                gradient_predivide_factor, num_groups)
 
         def compute_gradients(self, *args, **kwargs):
             """Compute gradients of all trainable variables.
@@ -435,7 +568,7 @@ if _LegacyOptimizer is not None:
 def DistributedOptimizer(optimizer, name=None, use_locking=False, device_dense='',
                          device_sparse='', compression=Compression.none,
                          sparse_as_dense=False, backward_passes_per_step=1,
-                         op=Average, gradient_predivide_factor=1.0):
+                         op=Average, gradient_predivide_factor=1.0, num_groups=0):
     """Construct a new DistributedOptimizer, which uses another optimizer
     under the hood for computing single-process gradient values and
     applying gradient updates after the gradient values have been combined
@@ -477,6 +610,11 @@ def DistributedOptimizer(optimizer, name=None, use_locking=False, device_dense='
         before and after the sum. Gradients are scaled by
         1.0 / gradient_predivide_factor before the sum and
         gradient_predivide_factor / size after the sum.
+      num_groups:
+        If positive, the dense gradients are split into this many groups of
+        consecutive gradients, each reduced by one grouped allreduce op once
+        all its gradients are ready, instead of one op per gradient.
+        Defaults to 0. Not supported with op == Adasum or Keras optimizers.
     """
     if gradient_predivide_factor != 1.0:
         if rocm_built():
@@ -484,6 +622,9 @@ def DistributedOptimizer(optimizer, name=None, use_locking=False, device_dense='
         if op != Average:
             raise ValueError('gradient_predivide_factor not supported with op != Average')
 
+    if num_groups > 0 and op == Adasum:
+        raise ValueError('num_groups not supported with op == Adasum')
+
     if isinstance(optimizer, _LegacyOptimizer):
         if op == Adasum:
             return _DistributedAdasumOptimizer(optimizer, name, use_locking, device_dense,
@@ -494,12 +635,14 @@ def DistributedOptimizer(optimizer, name=None, use_locking=False, device_dense='
                                  'op != Adasum')
             return _DistributedOptimizer(optimizer, name, use_locking, device_dense,
                                         device_sparse, compression, sparse_as_dense, op,
-                                        gradient_predivide_factor)
+                                        gradient_predivide_factor, num_groups)
     elif isinstance(optimizer, tf.keras.optimizers.Optimizer):
         if op == Adasum:
             raise ValueError('op == Adasum is not supported yet with Keras')
         if backward_passes_per_step > 1:
             raise ValueError('backward_passes_per_step > 1 is not supported yet with Keras')
+        if num_groups > 0:
+            raise ValueError('num_groups > 0 is not supported yet with Keras')
         import horovod.tensorflow.keras as hvd_k
         return hvd_k.DistributedOptimizer(optimizer, name, device_dense, device_sparse,
                                           compression, sparse_as_dense, gradient_predivide_factor)
@@ -511,7 +654,8 @@ def DistributedOptimizer(optimizer, name=None, use_locking=False, device_dense='
 if hasattr(tf, 'GradientTape'):
     class _DistributedGradientTape(tf.GradientTape):
         def __init__(self, tape, device_dense, device_sparse, compression, sparse_as_dense, op,
-                     gradient_predivide_factor, persistent=False, watch_accessed_variables=True):
+                     gradient_predivide_factor, num_groups, persistent=False,
+                     watch_accessed_variables=True):
             if hasattr(tape, '_watch_accessed_variables'):
                 super(self.__class__, self).__init__(persistent, watch_accessed_variables)
             else:
@@ -520,7 +664,7 @@ if hasattr(tf, 'GradientTape'):
             self._tape = tape
             self._allreduce_grads = _make_allreduce_grads_fn(
                 'DistributedGradientTape', device_dense, device_sparse, compression,
-                sparse_as_dense, op, gradient_predivide_factor)
+                sparse_as_dense, op, gradient_predivide_factor, num_groups)
 
         def gradient(self, target, sources, output_gradients=None):
             gradients = super(self.__class__, self).gradient(target, sources, output_gradients)
@@ -529,7 +673,7 @@ if hasattr(tf, 'GradientTape'):
 
     def DistributedGradientTape(gradtape, device_dense='', device_sparse='',
                                 compression=Compression.none, sparse_as_dense=False,
-                                op=Average, gradient_predivide_factor=1.0):
+                                op=Average, gradient_predivide_factor=1.0, num_groups=0):
         """A tape that wraps another tf.GradientTape, using an allreduce to
         combine gradient values before applying gradients to model weights.
 
@@ -558,6 +702,11 @@ if hasattr(tf, 'GradientTape'):
             before and after the sum. Gradients are scaled by
             1.0 / gradient_predivide_factor before the sum and
             gradient_predivide_factor / size after the sum.
+          num_groups:
+            If positive, the dense gradients are split into this many groups of
+            consecutive gradients, each reduced by one grouped allreduce op once
+            all its gradients are ready, instead of one op per gradient.
+            Defaults to 0. Not supported with op == Adasum.
         """
         if gradient_predivide_factor != 1.0:
             if rocm_built():
@@ -565,12 +714,16 @@ if hasattr(tf, 'GradientTape'):
             if op != Average:
                 raise ValueError('gradient_predivide_factor not supported with op != Average')
 
+        if num_groups > 0 and op == Adasum:
+            raise ValueError('num_groups not supported with op == Adasum')
+
         cls = type(gradtape.__class__.__name__, (gradtape.__class__,),
                    dict(_DistributedGradientTape.__dict__))
         if hasattr(gradtape, '_watch_accessed_variables'):
             return cls(gradtape._tape, device_dense, device_sparse, compression,
-                       sparse_as_dense, op, gradient_predivide_factor, gradtape._persistent,
-                       gradtape._watch_accessed_variables)
+                       sparse_as_dense, op, gradient_predivide_factor, num_groups,
+                       gradtape._persistent, gradtape._watch_accessed_variables)
         else:
             return cls(gradtape._tape, device_dense, device_sparse, compression,
-                       sparse_as_dense, op, gradient_predivide_factor, gradtape._persistent)
+                       sparse_as_dense, op, gradient_predivide_factor, num_groups,
+                       gradtape._persistent)
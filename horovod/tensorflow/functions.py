@@ -26,20 +26,57 @@ from horovod.tensorflow.mpi_ops import rank, size
 from horovod.tensorflow.util import _cache, _executing_eagerly, _make_subgraph
 
 
+# Variables of the same type are broadcast together as one flat tensor of at
+# most this many bytes.
+_BROADCAST_BUCKET_BYTES = 64 * 1024 * 1024
+
+
+def _broadcast_buckets(variables):
+    """Splits variables into buckets of the same type, in order. Variables of
+    unknown shape are broadcast on their own."""
+    buckets = []
+    open_buckets = {}
+    for var in variables:
+        if not var.shape.is_fully_defined():
+            buckets.append([var])
+            continue
+        dtype = var.dtype.base_dtype
+        nbytes = var.shape.num_elements() * dtype.size
+        bucket, bucket_bytes = open_buckets.get(dtype, (None, 0))
+        if bucket is None or bucket_bytes + nbytes > _BROADCAST_BUCKET_BYTES:
+            bucket = []
+            bucket_bytes = 0
+            buckets.append(bucket)
+        bucket.append(var)
+        open_buckets[dtype] = (bucket, bucket_bytes + nbytes)
+    return buckets
+
+
+def _broadcast_bucket(bucket, root_rank):
+    if len(bucket) == 1:
+        return [bucket[0].assign(broadcast(bucket[0], root_rank))]
+    flat = tf.concat([tf.reshape(var, [-1]) for var in bucket], axis=0)
+    flat = broadcast(flat, root_rank)
+    values = tf.split(flat, [var.shape.num_elements() for var in bucket])
+    return [var.assign(tf.reshape(value, var.shape))
+            for var, value in zip(bucket, values)]
+
+
 @_cache
 def _make_broadcast_group_fn():
     if _executing_eagerly():
         # Eager mode will parallelize independent control flow
         def broadcast_group(variables, root_rank):
-            for var in variables:
-                var.assign(broadcast(var, root_rank))
+            for bucket in _broadcast_buckets(variables):
+                _broadcast_bucket(bucket, root_rank)
 
         return _make_subgraph(broadcast_group)
     else:
         # Graph mode requires an Op
         def broadcast_group(variables, root_rank):
-            return tf.group(*[var.assign(broadcast(var, root_rank))
-                              for var in variables])
+            return tf.group(*[assign
+                              for bucket in _broadcast_buckets(variables)
+                              for assign in _broadcast_bucket(bucket, root_rank)])
 
         return broadcast_group
 
@@ -47,6 +84,9 @@ def _make_broadcast_group_fn():
 def broadcast_variables(variables, root_rank):
     """Broadcasts variables from root rank to all other processes.
 
+    Variables of the same type are concatenated and broadcast together, in
+    buckets of up to 64 MB, instead of one broadcast per variable.
+
     Arguments:
         variables: variables for broadcast
         root_rank: rank of the process from which global variables will be broadcasted
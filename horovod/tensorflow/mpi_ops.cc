@@ -17,6 +17,7 @@
 // =============================================================================
 
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <thread>
 #include <unordered_map>
@@ -81,6 +82,8 @@ namespace {
     return DT_DOUBLE;
   case common::HOROVOD_BOOL:
     return DT_BOOL;
+  case common::HOROVOD_BFLOAT16:
+    return DT_BFLOAT16;
   default:
     throw std::logic_error("Invalid data type.");
   }
@@ -243,6 +246,8 @@ const common::DataType TFTensor::dtype() const {
     return common::HOROVOD_FLOAT64;
   case DT_BOOL:
     return common::HOROVOD_BOOL;
+  case DT_BFLOAT16:
+    return common::HOROVOD_BFLOAT16;
   default:
     throw std::logic_error("Invalid tensor type.");
   }
@@ -377,6 +382,7 @@ public:
     OP_REQUIRES_OK(context, context->GetAttr("prescale_factor", &prescale_factor_));
     OP_REQUIRES_OK(context, context->GetAttr("postscale_factor", &postscale_factor_));
     OP_REQUIRES_OK(context, context->GetAttr("ignore_name_scope", &ignore_name_scope_));
+    OP_REQUIRES_OK(context, context->GetAttr("priority", &priority_));
   }
 
   void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
@@ -393,9 +399,13 @@ public:
     auto device = GetDeviceID(context);
     auto tensor = context->input(0);
     horovod::common::ReduceOp reduce_op = static_cast<horovod::common::ReduceOp>(reduce_op_);
+    // The input is reduced in place if no other op uses it.
     Tensor* output;
     OP_REQUIRES_OK_ASYNC(
-        context, context->allocate_output(0, tensor.shape(), &output), done);
+        context,
+        context->forward_input_or_allocate_output({0}, 0, tensor.shape(),
+                                                  &output),
+        done);
     // ReadyEvent makes sure input tensor is ready, and output is allocated.
     auto ready_event = std::shared_ptr<common::ReadyEvent>(RecordReadyEvent(context));
     auto hvd_context = std::make_shared<TFOpContext>(context);
@@ -406,7 +416,8 @@ public:
         [context, done](const common::Status& status) {
           context->SetStatus(ConvertStatus(status));
           done();
-        }, reduce_op, (double) prescale_factor_, (double) postscale_factor_);
+        }, reduce_op, (double) prescale_factor_, (double) postscale_factor_,
+        priority_);
     OP_REQUIRES_OK_ASYNC(context, ConvertStatus(enqueue_result), done);
   }
 
@@ -416,6 +427,7 @@ private:
   float prescale_factor_;
   float postscale_factor_;
   bool ignore_name_scope_;
+  int priority_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("HorovodAllreduce").Device(DEVICE_CPU),
@@ -426,11 +438,12 @@ REGISTER_KERNEL_BUILDER(Name("HorovodAllreduce").Device(DEVICE_GPU),
 #endif
 
 REGISTER_OP("HorovodAllreduce")
-    .Attr("T: {int32, int64, float16, float32, float64}")
+    .Attr("T: {int32, int64, float16, bfloat16, float32, float64}")
     .Attr("reduce_op: int")
     .Attr("prescale_factor: float")
     .Attr("postscale_factor: float")
     .Attr("ignore_name_scope: bool = False")
+    .Attr("priority: int = 0")
     .Input("tensor: T")
     .Output("sum: T")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -445,11 +458,138 @@ allreduce.
 
 Arguments
     tensor:     A tensor to reduce.
+    priority:   Scheduling priority of the allreduce when HOROVOD_FUSION_PRIORITY
+                is set. Tensors with lower values are reduced first.
 
 Output
     sum:    A tensor with the same shape as `tensor`, summed across all MPI processes.
 )doc");
 
+class HorovodGroupedAllreduceOp : public AsyncOpKernel {
+public:
+  explicit HorovodGroupedAllreduceOp(OpKernelConstruction* context)
+      : AsyncOpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("reduce_op", &reduce_op_));
+    OP_REQUIRES_OK(context, context->GetAttr("prescale_factor", &prescale_factor_));
+    OP_REQUIRES_OK(context, context->GetAttr("postscale_factor", &postscale_factor_));
+    OP_REQUIRES_OK(context, context->GetAttr("ignore_name_scope", &ignore_name_scope_));
+    OP_REQUIRES_OK(context, context->GetAttr("num_tensors", &num_tensors_));
+    OP_REQUIRES_OK(context, context->GetAttr("priority", &priority_));
+  }
+
+  void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
+    OP_REQUIRES_OK_ASYNC(context, ConvertStatus(common::CheckInitialized()),
+                         done);
+
+    auto node_name = name();
+    if (ignore_name_scope_) {
+      auto pos = node_name.find_last_of('/');
+      if (pos != std::string::npos) {
+        node_name = node_name.substr(pos + 1);
+      }
+    }
+    auto device = GetDeviceID(context);
+    horovod::common::ReduceOp reduce_op = static_cast<horovod::common::ReduceOp>(reduce_op_);
+
+    std::vector<std::shared_ptr<common::Tensor>> hvd_tensors;
+    std::vector<std::shared_ptr<common::Tensor>> hvd_outputs;
+    for (int i = 0; i < num_tensors_; ++i) {
+      auto tensor = context->input(i);
+      Tensor* output;
+      OP_REQUIRES_OK_ASYNC(
+          context,
+          context->forward_input_or_allocate_output({i}, i, tensor.shape(),
+                                                    &output),
+          done);
+      hvd_tensors.push_back(std::make_shared<TFTensor>(tensor));
+      hvd_outputs.push_back(std::make_shared<TFTensor>(*output));
+    }
+    // One ReadyEvent makes sure all inputs are ready, and outputs are
+    // allocated.
+    auto ready_event = std::shared_ptr<common::ReadyEvent>(RecordReadyEvent(context));
+    auto hvd_context = std::make_shared<TFOpContext>(context);
+    std::vector<std::shared_ptr<common::OpContext>> hvd_contexts(num_tensors_,
+                                                                 hvd_context);
+
+    // The kernel is done once all the tensors are, with the first error.
+    struct GroupState {
+      std::mutex mutex;
+      int remaining;
+      common::Status status = common::Status::OK();
+    };
+    auto group = std::make_shared<GroupState>();
+    group->remaining = num_tensors_;
+    std::vector<std::string> names;
+    std::vector<common::StatusCallback> callbacks;
+    for (int i = 0; i < num_tensors_; ++i) {
+      names.push_back(node_name + "_" + std::to_string(i + 1) + "of" +
+                      std::to_string(num_tensors_));
+      callbacks.push_back([context, done, group](const common::Status& status) {
+        std::unique_lock<std::mutex> lock(group->mutex);
+        if (!status.ok() && group->status.ok()) {
+          group->status = status;
+        }
+        if (--group->remaining > 0) {
+          return;
+        }
+        lock.unlock();
+        context->SetStatus(ConvertStatus(group->status));
+        done();
+      });
+    }
+    auto enqueue_result = EnqueueTensorAllreduces(
+        hvd_contexts, hvd_tensors, hvd_outputs, ready_event, names, device,
+        callbacks, reduce_op, (double) prescale_factor_,
+        (double) postscale_factor_, priority_);
+    OP_REQUIRES_OK_ASYNC(context, ConvertStatus(enqueue_result), done);
+  }
+
+private:
+  int reduce_op_;
+  // Using float since TF does not support double OP attributes
+  float prescale_factor_;
+  float postscale_factor_;
+  bool ignore_name_scope_;
+  int num_tensors_;
+  int priority_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("HorovodGroupedAllreduce").Device(DEVICE_CPU),
+                        HorovodGroupedAllreduceOp);
+#if HOROVOD_GPU_ALLREDUCE
+REGISTER_KERNEL_BUILDER(Name("HorovodGroupedAllreduce").Device(DEVICE_GPU),
+                        HorovodGroupedAllreduceOp);
+#endif
+
+REGISTER_OP("HorovodGroupedAllreduce")
+    .Attr("T: {int32, int64, float16, bfloat16, float32, float64}")
+    .Attr("reduce_op: int")
+    .Attr("prescale_factor: float")
+    .Attr("postscale_factor: float")
+    .Attr("ignore_name_scope: bool = False")
+    .Attr("num_tensors: int >= 1")
+    .Attr("priority: int = 0")
+    .Input("tensors: num_tensors*T")
+    .Output("sum: num_tensors*T")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      for (int i = 0; i < c->num_inputs(); ++i) {
+        c->set_output(i, c->input(i));
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Perform an MPI Allreduce on a list of tensors, enqueued together once all of
+them are ready. All other processes that do a reduction on the list with the
+same name must have the same number of tensors, and the same dimensions for
+each of them.
+
+Arguments
+    tensors:    The tensors to reduce.
+
+Output
+    sum:    Tensors with the same shapes as `tensors`, summed across all MPI processes.
+)doc");
+
 class HorovodAllgatherOp : public AsyncOpKernel {
 public:
   explicit HorovodAllgatherOp(OpKernelConstruction* context)
@@ -498,7 +638,7 @@ REGISTER_KERNEL_BUILDER(Name("HorovodAllgather").Device(DEVICE_GPU),
 
 REGISTER_OP("HorovodAllgather")
     .Attr(
-        "T: {uint8, int8, uint16, int16, int32, int64, float16, float32, float64, bool}")
+        "T: {uint8, int8, uint16, int16, int32, int64, float16, bfloat16, float32, float64, bool}")
     .Attr("ignore_name_scope: bool = False")
     .Input("tensor: T")
     .Output("output: T")
@@ -580,7 +720,7 @@ REGISTER_KERNEL_BUILDER(Name("HorovodBroadcast").Device(DEVICE_GPU),
 
 REGISTER_OP("HorovodBroadcast")
     .Attr(
-        "T: {uint8, int8, uint16, int16, int32, int64, float16, float32, float64, bool}")
+        "T: {uint8, int8, uint16, int16, int32, int64, float16, bfloat16, float32, float64, bool}")
     .Attr("root_rank: int")
     .Attr("ignore_name_scope: bool = False")
     .Input("tensor: T")
@@ -798,7 +938,7 @@ REGISTER_KERNEL_BUILDER(Name("HorovodAlltoall").Device(DEVICE_GPU).HostMemory("s
 
 REGISTER_OP("HorovodAlltoall")
     .Attr(
-        "T: {uint8, int8, uint16, int16, int32, int64, float16, float32, float64, bool}")
+        "T: {uint8, int8, uint16, int16, int32, int64, float16, bfloat16, float32, float64, bool}")
     .Attr("ignore_name_scope: bool = False")
     .Input("tensor: T")
     .Input("splits: int32")
@@ -53,6 +53,13 @@ shutdown = _basics.shutdown
 is_initialized = _basics.is_initialized
 start_timeline = _basics.start_timeline
 stop_timeline = _basics.stop_timeline
+flush_fusion_groups = _basics.flush_fusion_groups
+release_fusion_buffers = _basics.release_fusion_buffers
+fusion_buffer_bytes = _basics.fusion_buffer_bytes
+step_completed = _basics.step_completed
+get_overlap_stats = _basics.get_overlap_stats
+get_metrics = _basics.get_metrics
+get_straggler_scores = _basics.get_straggler_scores
 size = _basics.size
 local_size = _basics.local_size
 rank = _basics.rank
@@ -93,7 +100,7 @@ def _normalize_name(name):
 
 
 def _allreduce(tensor, name=None, op=Sum, prescale_factor=1.0, postscale_factor=1.0,
-               ignore_name_scope=False):
+               ignore_name_scope=False, priority=0):
     """An op which reduces an input tensor over all the Horovod processes. The
     default reduction is a sum.
 
@@ -110,7 +117,8 @@ def _allreduce(tensor, name=None, op=Sum, prescale_factor=1.0, postscale_factor=
     return MPI_LIB.horovod_allreduce(tensor, name=name, reduce_op=op,
                                      prescale_factor=prescale_factor,
                                      postscale_factor=postscale_factor,
-                                     ignore_name_scope=ignore_name_scope)
+                                     ignore_name_scope=ignore_name_scope,
+                                     priority=priority)
 
 
 @ops.RegisterGradient('HorovodAllreduce')
@@ -128,9 +136,55 @@ def _allreduce_grad(op, grad):
     prescale_factor = op.get_attr('prescale_factor')
     postscale_factor = op.get_attr('postscale_factor')
     ignore_name_scope = op.get_attr('ignore_name_scope')
+    priority = op.get_attr('priority')
     return _allreduce(grad, op=reduce_op, prescale_factor=prescale_factor,
                       postscale_factor=postscale_factor,
-                      ignore_name_scope=ignore_name_scope)
+                      ignore_name_scope=ignore_name_scope, priority=priority)
+
+
+def _grouped_allreduce(tensors, name=None, op=Sum, prescale_factor=1.0, postscale_factor=1.0,
+                       ignore_name_scope=False, priority=0):
+    """An op which reduces a list of input tensors of the same type over all the
+    Horovod processes, enqueued together once all of them are ready. The default
+    reduction is a sum.
+
+    The reduction operation is keyed by the name of the op. The number, types and
+    shapes of the tensors must be the same on all Horovod processes for a given
+    name. The reduction will not start until all processes are ready to send and
+    receive the tensors.
+
+    Returns:
+      A list of tensors of the same shapes and type as `tensors`, summed across
+      all processes.
+    """
+    if name is None and not _executing_eagerly():
+        name = 'HorovodGroupedAllreduce_%s' % _normalize_name(tensors[0].name)
+    return MPI_LIB.horovod_grouped_allreduce(tensors, name=name, reduce_op=op,
+                                             prescale_factor=prescale_factor,
+                                             postscale_factor=postscale_factor,
+                                             ignore_name_scope=ignore_name_scope,
+                                             priority=priority)
+
+
+@ops.RegisterGradient('HorovodGroupedAllreduce')
+def _grouped_allreduce_grad(op, *grads):
+    """Gradient for grouped allreduce op.
+
+    Args:
+      op: An operation.
+      grads: `Tensor` gradients with respect to the outputs of the op.
+
+    Returns:
+      The gradients with respect to the inputs of the op.
+    """
+    reduce_op = op.get_attr('reduce_op')
+    prescale_factor = op.get_attr('prescale_factor')
+    postscale_factor = op.get_attr('postscale_factor')
+    ignore_name_scope = op.get_attr('ignore_name_scope')
+    priority = op.get_attr('priority')
+    return _grouped_allreduce(list(grads), op=reduce_op, prescale_factor=prescale_factor,
+                              postscale_factor=postscale_factor,
+                              ignore_name_scope=ignore_name_scope, priority=priority)
 
 
 def allgather(tensor, name=None, ignore_name_scope=False):
@@ -0,0 +1,416 @@
+// Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// XLA implementation of the Horovod allreduce, so that allreduces do not split
+// clusters compiled with jit_compile.
+//
+// An allreduce is compiled into two custom calls. CallbackHVDAllreduce
+// enqueues the allreduce of its input into its output once the input is ready
+// on the XLA stream, and CallbackHVDAllreduceDone, which takes the output of
+// the first call, returns once the allreduce has completed. XLA schedules the
+// computations that do not depend on the result between the two calls.
+
+#if HOROVOD_ENABLE_XLA_OPS
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include <cuda_runtime.h>
+
+#include "tensorflow/compiler/tf2xla/shape_util.h"
+#include "tensorflow/compiler/tf2xla/type_util.h"
+#include "tensorflow/compiler/tf2xla/xla_op_kernel.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/service/custom_call_status.h"
+#include "tensorflow/compiler/xla/service/custom_call_target_registry.h"
+
+#define OMPI_SKIP_MPICXX
+#include "../common/operations.h"
+
+using namespace tensorflow;
+
+namespace horovod {
+namespace tensorflow {
+
+namespace {
+
+Status GetHVDDataType(::tensorflow::DataType dtype,
+                      common::DataType* hvd_dtype) {
+  switch (dtype) {
+  case DT_INT32:
+    *hvd_dtype = common::HOROVOD_INT32;
+    return Status::OK();
+  case DT_INT64:
+    *hvd_dtype = common::HOROVOD_INT64;
+    return Status::OK();
+  case DT_HALF:
+    *hvd_dtype = common::HOROVOD_FLOAT16;
+    return Status::OK();
+  case DT_BFLOAT16:
+    *hvd_dtype = common::HOROVOD_BFLOAT16;
+    return Status::OK();
+  case DT_FLOAT:
+    *hvd_dtype = common::HOROVOD_FLOAT32;
+    return Status::OK();
+  case DT_DOUBLE:
+    *hvd_dtype = common::HOROVOD_FLOAT64;
+    return Status::OK();
+  default:
+    return errors::InvalidArgument("Invalid tensor type ",
+                                   DataTypeString(dtype),
+                                   " for an XLA allreduce.");
+  }
+}
+
+// The custom calls run on XLA's threads, CUDA errors are thrown and reported
+// through the status of the call.
+void CUDACheck(const std::string& op_name, cudaError_t error) {
+  if (error != cudaSuccess) {
+    throw std::runtime_error(op_name + " failed: " +
+                             cudaGetErrorString(error));
+  }
+}
+
+// The attributes of an allreduce, passed to the custom calls as their opaque
+// string.
+struct XLAAllreduceParams {
+  std::string tensor_name;
+  int reduce_op = 0;
+  double prescale_factor = 1.0;
+  double postscale_factor = 1.0;
+  int priority = 0;
+  int dtype = 0;
+  std::vector<int64_t> dims;
+
+  std::string Serialize() const {
+    std::ostringstream out;
+    out.precision(17);
+    out << reduce_op << ' ' << prescale_factor << ' ' << postscale_factor << ' '
+        << priority << ' ' << dtype << ' ' << dims.size();
+    for (auto dim : dims) {
+      out << ' ' << dim;
+    }
+    // The name comes last, it may contain spaces.
+    out << ' ' << tensor_name;
+    return out.str();
+  }
+
+  static XLAAllreduceParams Parse(const char* opaque, size_t opaque_len) {
+    XLAAllreduceParams params;
+    std::istringstream in(std::string(opaque, opaque_len));
+    size_t num_dims;
+    in >> params.reduce_op >> params.prescale_factor >>
+        params.postscale_factor >> params.priority >> params.dtype >> num_dims;
+    params.dims.resize(num_dims);
+    for (auto& dim : params.dims) {
+      in >> dim;
+    }
+    in.get();
+    std::getline(in, params.tensor_name, '\0');
+    return params;
+  }
+};
+
+class XLAReadyEvent : public common::ReadyEvent {
+public:
+  XLAReadyEvent(cudaStream_t stream) {
+    CUDACheck("cudaEventCreateWithFlags",
+              cudaEventCreateWithFlags(&event_, cudaEventDisableTiming));
+    auto error = cudaEventRecord(event_, stream);
+    if (error != cudaSuccess) {
+      cudaEventDestroy(event_);
+      CUDACheck("cudaEventRecord", error);
+    }
+  }
+  ~XLAReadyEvent() override { cudaEventDestroy(event_); }
+  bool Ready() const override { return cudaEventQuery(event_) != cudaErrorNotReady; }
+  gpuEvent_t event() const override { return event_; }
+
+private:
+  cudaEvent_t event_;
+};
+
+class XLAPersistentBuffer : public common::PersistentBuffer {
+public:
+  XLAPersistentBuffer(int device, int64_t size) {
+    int restore_device;
+    CUDACheck("cudaGetDevice", cudaGetDevice(&restore_device));
+    CUDACheck("cudaSetDevice", cudaSetDevice(device));
+    auto error = cudaMalloc(&buffer_, size);
+    cudaSetDevice(restore_device);
+    CUDACheck("cudaMalloc", error);
+  }
+  ~XLAPersistentBuffer() override { cudaFree(buffer_); }
+  const void*
+  AccessData(std::shared_ptr<common::OpContext> context) const override {
+    return buffer_;
+  }
+
+private:
+  void* buffer_ = nullptr;
+};
+
+// A buffer of an XLA computation, owned by XLA.
+class XLATensor : public common::Tensor {
+public:
+  XLATensor(common::DataType dtype, common::TensorShape shape, void* data)
+      : dtype_(dtype), shape_(std::move(shape)), data_(data) {}
+  const common::DataType dtype() const override { return dtype_; }
+  const common::TensorShape shape() const override { return shape_; }
+  const void* data() const override { return data_; }
+  int64_t size() const override {
+    return shape_.num_elements() * common::DataType_Size(dtype_);
+  }
+
+private:
+  common::DataType dtype_;
+  common::TensorShape shape_;
+  void* data_;
+};
+
+// Outputs of XLA computations are allocated by XLA before they run, only the
+// fusion buffer is allocated by Horovod.
+class XLAOpContext : public common::OpContext {
+public:
+  XLAOpContext(int device) : device_(device) {}
+  common::Status AllocatePersistent(
+      int64_t size, std::shared_ptr<common::PersistentBuffer>* tensor) override {
+    try {
+      *tensor = std::make_shared<XLAPersistentBuffer>(device_, size);
+      return common::Status::OK();
+    } catch (std::runtime_error& e) {
+      return common::Status::UnknownError(e.what());
+    }
+  }
+  common::Status
+  AllocateOutput(common::TensorShape shape,
+                 std::shared_ptr<common::Tensor>* tensor) override {
+    return common::Status::PreconditionError(
+        "XLA outputs are allocated before the computation runs.");
+  }
+  common::Status
+  AllocateZeros(int64_t num_elements, common::DataType dtype,
+                std::shared_ptr<common::Tensor>* tensor) override {
+    return common::Status::PreconditionError(
+        "Join is not supported in XLA computations.");
+  }
+  common::Framework framework() const override {
+    return common::Framework::XLA;
+  }
+
+private:
+  int device_;
+};
+
+// Hands the status of every allreduce enqueued by CallbackHVDAllreduce over to
+// CallbackHVDAllreduceDone, keyed by tensor name.
+class XLARendezvous {
+public:
+  static XLARendezvous& Get() {
+    static XLARendezvous rendezvous;
+    return rendezvous;
+  }
+
+  void Enqueued(const std::string& tensor_name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_[tensor_name] = std::make_shared<Payload>();
+  }
+
+  void Done(const std::string& tensor_name, const common::Status& status) {
+    std::shared_ptr<Payload> payload;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      payload = pending_[tensor_name];
+    }
+    std::lock_guard<std::mutex> guard(payload->mutex);
+    payload->done = true;
+    payload->status = status;
+    payload->cond.notify_all();
+  }
+
+  common::Status Wait(const std::string& tensor_name) {
+    std::shared_ptr<Payload> payload;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      auto it = pending_.find(tensor_name);
+      if (it == pending_.end()) {
+        return common::Status::PreconditionError(
+            "Allreduce " + tensor_name + " was not enqueued.");
+      }
+      payload = it->second;
+    }
+    std::unique_lock<std::mutex> lock(payload->mutex);
+    payload->cond.wait(lock, [&payload] { return payload->done; });
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_.erase(tensor_name);
+    return payload->status;
+  }
+
+private:
+  struct Payload {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    common::Status status;
+  };
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<Payload>> pending_;
+};
+
+void SetCustomCallStatus(XlaCustomCallStatus* status,
+                         const common::Status& hvd_status) {
+  if (!hvd_status.ok()) {
+    XlaCustomCallStatusSetFailure(status, hvd_status.reason().c_str(),
+                                  hvd_status.reason().size());
+  }
+}
+
+// buffers[0] is the input of the allreduce, buffers[1] its output.
+void CallbackHVDAllreduce(cudaStream_t stream, void** buffers,
+                          const char* opaque, size_t opaque_len,
+                          XlaCustomCallStatus* status) {
+  auto params = XLAAllreduceParams::Parse(opaque, opaque_len);
+  common::TensorShape shape;
+  for (auto dim : params.dims) {
+    shape.AddDim(dim);
+  }
+  auto dtype = static_cast<common::DataType>(params.dtype);
+  int device;
+  std::shared_ptr<XLAReadyEvent> ready_event;
+  try {
+    CUDACheck("cudaGetDevice", cudaGetDevice(&device));
+    ready_event = std::make_shared<XLAReadyEvent>(stream);
+  } catch (std::runtime_error& e) {
+    SetCustomCallStatus(status, common::Status::UnknownError(e.what()));
+    return;
+  }
+
+  auto hvd_context = std::make_shared<XLAOpContext>(device);
+  auto hvd_tensor = std::make_shared<XLATensor>(dtype, shape, buffers[0]);
+  auto hvd_output = std::make_shared<XLATensor>(dtype, shape, buffers[1]);
+  auto tensor_name = params.tensor_name;
+  XLARendezvous::Get().Enqueued(tensor_name);
+  auto enqueue_result = common::EnqueueTensorAllreduce(
+      hvd_context, hvd_tensor, hvd_output, ready_event, tensor_name, device,
+      [tensor_name](const common::Status& status) {
+        XLARendezvous::Get().Done(tensor_name, status);
+      },
+      static_cast<common::ReduceOp>(params.reduce_op), params.prescale_factor,
+      params.postscale_factor, params.priority);
+  if (!enqueue_result.ok()) {
+    XLARendezvous::Get().Done(tensor_name, enqueue_result);
+  }
+  SetCustomCallStatus(status, enqueue_result);
+}
+
+// buffers[0] is the output of the allreduce, aliased by buffers[1].
+void CallbackHVDAllreduceDone(cudaStream_t stream, void** buffers,
+                              const char* opaque, size_t opaque_len,
+                              XlaCustomCallStatus* status) {
+  auto params = XLAAllreduceParams::Parse(opaque, opaque_len);
+  // The completion callback runs once the output has been written, the
+  // computations enqueued on the XLA stream afterwards see the result.
+  SetCustomCallStatus(status, XLARendezvous::Get().Wait(params.tensor_name));
+}
+
+XLA_REGISTER_CUSTOM_CALL_TARGET(CallbackHVDAllreduce, "CUDA");
+XLA_REGISTER_CUSTOM_CALL_TARGET(CallbackHVDAllreduceDone, "CUDA");
+
+} // namespace
+
+class HVDAllreduceOp : public XlaOpKernel {
+public:
+  explicit HVDAllreduceOp(OpKernelConstruction* context)
+      : XlaOpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("reduce_op", &reduce_op_));
+    OP_REQUIRES_OK(context, context->GetAttr("prescale_factor", &prescale_factor_));
+    OP_REQUIRES_OK(context, context->GetAttr("postscale_factor", &postscale_factor_));
+    OP_REQUIRES_OK(context, context->GetAttr("ignore_name_scope", &ignore_name_scope_));
+    OP_REQUIRES_OK(context, context->GetAttr("priority", &priority_));
+  }
+
+  void Compile(XlaOpKernelContext* ctx) override {
+    OP_REQUIRES_OK(ctx, ConvertStatus(common::CheckInitialized()));
+
+    auto node_name = name();
+    if (ignore_name_scope_) {
+      auto pos = node_name.find_last_of('/');
+      if (pos != std::string::npos) {
+        node_name = node_name.substr(pos + 1);
+      }
+    }
+
+    XLAAllreduceParams params;
+    params.tensor_name = node_name;
+    params.reduce_op = reduce_op_;
+    params.prescale_factor = prescale_factor_;
+    params.postscale_factor = postscale_factor_;
+    params.priority = priority_;
+    common::DataType dtype;
+    OP_REQUIRES_OK(ctx, GetHVDDataType(ctx->input_type(0), &dtype));
+    params.dtype = dtype;
+    auto input_shape = ctx->InputShape(0);
+    for (auto dim : input_shape) {
+      params.dims.push_back(dim.size);
+    }
+    auto opaque = params.Serialize();
+
+    xla::Shape output_shape;
+    OP_REQUIRES_OK(ctx, TensorShapeToXLAShape(ctx->input_xla_type(0),
+                                              input_shape, &output_shape));
+    auto output = xla::CustomCall(
+        ctx->builder(), "CallbackHVDAllreduce", {ctx->Input(0)}, output_shape,
+        opaque, /*has_side_effect=*/true, /*output_operand_aliasing=*/{},
+        /*literal=*/nullptr, /*window=*/absl::nullopt, /*dnums=*/absl::nullopt,
+        xla::CustomCallSchedule::SCHEDULE_EARLIEST,
+        xla::CustomCallApiVersion::API_VERSION_STATUS_RETURNING);
+    auto done = xla::CustomCall(
+        ctx->builder(), "CallbackHVDAllreduceDone", {output}, output_shape,
+        opaque, /*has_side_effect=*/true,
+        /*output_operand_aliasing=*/{{xla::ShapeIndex{}, {0, xla::ShapeIndex{}}}},
+        /*literal=*/nullptr, /*window=*/absl::nullopt, /*dnums=*/absl::nullopt,
+        xla::CustomCallSchedule::SCHEDULE_LATEST,
+        xla::CustomCallApiVersion::API_VERSION_STATUS_RETURNING);
+    ctx->SetOutput(0, done);
+  }
+
+private:
+  static Status ConvertStatus(const common::Status& status) {
+    if (status.ok()) {
+      return Status::OK();
+    }
+    return errors::FailedPrecondition(status.reason());
+  }
+
+  int reduce_op_;
+  // Using float since TF does not support double OP attributes
+  float prescale_factor_;
+  float postscale_factor_;
+  bool ignore_name_scope_;
+  int priority_;
+};
+
+REGISTER_XLA_OP(Name("HorovodAllreduce").Device(DEVICE_GPU_XLA_JIT),
+                HVDAllreduceOp);
+
+} // namespace tensorflow
+} // namespace horovod
+
+#endif // HOROVOD_ENABLE_XLA_OPS
@@ -0,0 +1,350 @@
+# Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Offline fusion plan simulator.
+
+Replays the tensor traces written with ``HOROVOD_TENSOR_TRACE`` against
+candidate ``FUSION_SIZE`` / ``FUSION_BLOCK_NUM`` / ``FUSION_THREAD_NUM`` plans
+and predicts the step time of each plan, so that plans can be compared without
+running the job. Usage::
+
+    python -m horovod.tools.fusion_simulator trace.*.csv \\
+        --cost-table libra_costs.txt --num-streams 2 \\
+        --plan '40,40,40,40;8,8,4,4;512,512,256,256' --plan '32M;0;0' \\
+        --search-groups 1,2,4,8
+
+The cost of every allreduce comes from a table written by
+``horovod_libra_calibrate --cost-output``, or from a latency / bandwidth model
+if there is no table.
+"""
+
+import argparse
+import bisect
+import collections
+import csv
+import math
+import sys
+
+FUSED_TYPES = ('ALLREDUCE', 'ADASUM')
+
+Tensor = collections.namedtuple('Tensor', ['name', 'bytes', 'ready'])
+Group = collections.namedtuple('Group', ['count', 'max_bytes', 'block_num', 'thread_num'])
+Plan = collections.namedtuple('Plan', ['fusion_size', 'block_num', 'thread_num', 'groups'])
+
+_SUFFIXES = {'K': 1 << 10, 'M': 1 << 20, 'G': 1 << 30}
+
+
+def parse_bytes(value):
+    value = value.strip()
+    scale = _SUFFIXES.get(value[-1:].upper(), 1)
+    if scale != 1:
+        value = value[:-1]
+    number = int(value)
+    if number < 0:
+        raise ValueError('negative byte count')
+    return number * scale
+
+
+def parse_group_entry(entry):
+    """Parses a FUSION_SIZE entry into (count, max_bytes), like the controller:
+    ``40``, ``16M`` or ``40:8M``."""
+    entry = entry.strip()
+    if ':' in entry:
+        count, max_bytes = entry.split(':', 1)
+        return int(count), parse_bytes(max_bytes)
+    if entry[-1:].upper() in _SUFFIXES:
+        return 0, parse_bytes(entry)
+    return int(entry), 0
+
+
+def parse_plan(fusion_size, block_num='', thread_num=''):
+    entries = [parse_group_entry(e) for e in fusion_size.split(',')]
+    blocks = [int(b) for b in block_num.split(',')] if block_num else []
+    threads = [int(t) for t in thread_num.split(',')] if thread_num else []
+    if blocks == [0] and threads == [0]:
+        blocks = threads = []
+    if not blocks and not threads:
+        blocks = threads = [0] * len(entries)
+    if len(blocks) != len(entries) or len(threads) != len(entries):
+        raise ValueError('fusion group/block/thread specification not equal in size')
+    groups = [Group(count, max_bytes, b, t)
+              for (count, max_bytes), b, t in zip(entries, blocks, threads)]
+    return Plan(fusion_size, block_num, thread_num, groups)
+
+
+def parse_plan_spec(spec):
+    """Parses ``FUSION_SIZE;FUSION_BLOCK_NUM;FUSION_THREAD_NUM``, the block and
+    thread lists are optional."""
+    parts = spec.split(';')
+    if len(parts) > 3:
+        raise ValueError('expected FUSION_SIZE[;FUSION_BLOCK_NUM;FUSION_THREAD_NUM]')
+    parts += [''] * (3 - len(parts))
+    return parse_plan(*parts)
+
+
+def load_traces(paths, skip_steps=1):
+    """Returns the fused tensors of every step in arrival order. A tensor is
+    ready once it is ready on all ranks."""
+    ready = collections.defaultdict(dict)
+    sizes = {}
+    for path in paths:
+        with open(path) as f:
+            for row in csv.DictReader(f):
+                if row['type'] not in FUSED_TYPES:
+                    continue
+                step = int(row['step'])
+                if step < skip_steps:
+                    continue
+                name = row['name']
+                ready_s = int(row['ready_us']) / 1e6
+                ready[step][name] = max(ready[step].get(name, ready_s), ready_s)
+                sizes[name] = int(row['bytes'])
+
+    steps = []
+    for step in sorted(ready):
+        tensors = [Tensor(name, sizes[name], t) for name, t in ready[step].items()]
+        tensors.sort(key=lambda tensor: tensor.ready)
+        steps.append(tensors)
+    return steps
+
+
+class CostModel(object):
+    """Time of an allreduce of a fusion group, in seconds.
+
+    With a table, the measured points of the closest concurrency and block /
+    thread counts are interpolated linearly in the number of bytes. Groups
+    that leave the blocks and threads to the channel allocator take the
+    fastest measured allocation. Without a table, concurrent groups share
+    the bandwidth and fewer blocks than ``saturation_blocks`` reduce it."""
+
+    def __init__(self, table=None, latency=20e-6, bandwidth=10e9,
+                 saturation_blocks=16):
+        self._latency = latency
+        self._bandwidth = bandwidth
+        self._saturation_blocks = saturation_blocks
+        # (concurrency, block_num, thread_num) -> sorted [(bytes, seconds)]
+        self._points = collections.defaultdict(list)
+        for bytes_, concurrency, block_num, thread_num, seconds in table or []:
+            self._points[(concurrency, block_num, thread_num)].append((bytes_, seconds))
+        for points in self._points.values():
+            points.sort()
+
+    @staticmethod
+    def load(path):
+        table = []
+        with open(path) as f:
+            for line in f:
+                line = line.split('#', 1)[0].split()
+                if not line:
+                    continue
+                bytes_, concurrency, block_num, thread_num = (int(v) for v in line[:4])
+                table.append((bytes_, concurrency, block_num, thread_num, float(line[4]) / 1e3))
+        return CostModel(table)
+
+    def cost(self, bytes_, concurrency, block_num, thread_num):
+        if not self._points:
+            return self._model_cost(bytes_, concurrency, block_num)
+
+        concurrencies = sorted(set(key[0] for key in self._points))
+        below = [c for c in concurrencies if c <= concurrency]
+        concurrency = below[-1] if below else concurrencies[0]
+        keys = [key for key in self._points if key[0] == concurrency]
+        if block_num == 0 and thread_num == 0:
+            return min(self._interpolate(self._points[key], bytes_) for key in keys)
+
+        def distance(key):
+            return (abs(math.log(max(key[1], 1)) - math.log(max(block_num, 1))) +
+                    abs(math.log(max(key[2], 1)) - math.log(max(thread_num, 1))))
+        return self._interpolate(self._points[min(keys, key=distance)], bytes_)
+
+    def _model_cost(self, bytes_, concurrency, block_num):
+        bandwidth = self._bandwidth / max(concurrency, 1)
+        if block_num > 0:
+            bandwidth *= min(1.0, block_num / float(self._saturation_blocks))
+        return self._latency + bytes_ / bandwidth
+
+    @staticmethod
+    def _interpolate(points, bytes_):
+        sizes = [p[0] for p in points]
+        i = bisect.bisect_left(sizes, bytes_)
+        if i < len(points) and sizes[i] == bytes_:
+            return points[i][1]
+        if i == 0:
+            return points[0][1]
+        if i == len(points):
+            # Beyond the largest message, at the bandwidth of the largest one.
+            return points[-1][1] * bytes_ / float(max(sizes[-1], 1))
+        (b0, t0), (b1, t1) = points[i - 1], points[i]
+        return t0 + (t1 - t0) * (bytes_ - b0) / float(b1 - b0)
+
+
+def build_groups(tensors, plan, fusion_threshold=0):
+    """Splits the tensors of a step into the fusion groups of the plan, the
+    way the controller does: groups are filled in arrival order and taken in
+    turn, and the tensors left at the end of the step are sent as a short
+    group. Returns (group index, tensors) pairs."""
+    def limits(index):
+        group = plan.groups[index % len(plan.groups)]
+        max_bytes = group.max_bytes
+        if fusion_threshold > 0 and (max_bytes == 0 or fusion_threshold < max_bytes):
+            max_bytes = fusion_threshold
+        return group.count, max_bytes
+
+    result = []
+    index = 0
+    current = []
+    current_bytes = 0
+    for tensor in tensors:
+        max_count, max_bytes = limits(index)
+        if current and max_bytes > 0 and current_bytes + tensor.bytes > max_bytes:
+            result.append((index % len(plan.groups), current))
+            index += 1
+            current, current_bytes = [], 0
+            max_count, max_bytes = limits(index)
+        current.append(tensor)
+        current_bytes += tensor.bytes
+        if ((max_count > 0 and len(current) == max_count) or
+                (max_bytes > 0 and current_bytes >= max_bytes)):
+            result.append((index % len(plan.groups), current))
+            index += 1
+            current, current_bytes = [], 0
+    if current:
+        result.append((index % len(plan.groups), current))
+    return result
+
+
+def simulate_step(tensors, plan, cost_model, num_streams=1, stream_assignment=None,
+                  cycle_time=1e-3, fusion_threshold=0):
+    """Predicts the time from the first tensor of the step being ready until
+    the last group is reduced, in seconds."""
+    if not tensors:
+        return 0.0
+    start = tensors[0].ready
+    stream_free = collections.defaultdict(lambda: start)
+    finish = start
+    for k, (group_index, group_tensors) in enumerate(build_groups(tensors, plan, fusion_threshold)):
+        group = plan.groups[group_index]
+        # A group is negotiated in the cycle after its last tensor is ready.
+        launch = group_tensors[-1].ready + cycle_time
+        if stream_assignment:
+            stream = stream_assignment[k % len(stream_assignment)]
+        else:
+            stream = k % max(num_streams, 1)
+        begin = max(launch, stream_free[stream])
+        concurrency = 1 + sum(1 for s, free in stream_free.items() if s != stream and free > begin)
+        bytes_ = sum(t.bytes for t in group_tensors)
+        end = begin + cost_model.cost(bytes_, concurrency, group.block_num, group.thread_num)
+        stream_free[stream] = end
+        finish = max(finish, end)
+    return finish - start
+
+
+def simulate(steps, plan, cost_model, **kwargs):
+    """Returns the step times predicted for the plan."""
+    return [simulate_step(tensors, plan, cost_model, **kwargs) for tensors in steps]
+
+
+def candidate_plans(steps, num_groups_list):
+    """Plans of num_groups groups of roughly equal bytes, in arrival order
+    of the first step, leaving blocks and threads to the channel allocator."""
+    if not steps:
+        return []
+    tensors = steps[0]
+    total = sum(t.bytes for t in tensors)
+    plans = []
+    for num_groups in num_groups_list:
+        num_groups = max(1, min(num_groups, len(tensors)))
+        counts = []
+        target = total / float(num_groups)
+        count, bytes_ = 0, 0
+        for tensor in tensors:
+            count += 1
+            bytes_ += tensor.bytes
+            if bytes_ >= target * (len(counts) + 1) and len(counts) < num_groups - 1:
+                counts.append(count)
+                count = 0
+        counts.append(count)
+        counts = [c for c in counts if c > 0]
+        plans.append(parse_plan(','.join(str(c) for c in counts)))
+    return plans
+
+
+def _parse_int_list(value):
+    return [int(v) for v in value.split(',')] if value else []
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        description='Predict the step time of fusion group plans from tensor traces.')
+    parser.add_argument('traces', nargs='+',
+                        help='HOROVOD_TENSOR_TRACE files, one per rank.')
+    parser.add_argument('--plan', action='append', default=[],
+                        help='FUSION_SIZE[;FUSION_BLOCK_NUM;FUSION_THREAD_NUM] to simulate, '
+                             'may be given several times.')
+    parser.add_argument('--search-groups', default='',
+                        help='Also simulate plans of these numbers of equally sized groups, '
+                             'e.g. 1,2,4,8.')
+    parser.add_argument('--cost-table',
+                        help='Costs written by horovod_libra_calibrate --cost-output.')
+    parser.add_argument('--latency-us', type=float, default=20.0,
+                        help='Latency of an allreduce without a cost table (default 20).')
+    parser.add_argument('--bandwidth-gbps', type=float, default=10.0,
+                        help='Allreduce bandwidth in GB/s without a cost table (default 10).')
+    parser.add_argument('--num-streams', type=int, default=1,
+                        help='HOROVOD_NUM_NCCL_STREAMS (default 1).')
+    parser.add_argument('--stream-assignment', default='',
+                        help='HOROVOD_STREAM_ASSIGNMENT.')
+    parser.add_argument('--cycle-time-ms', type=float, default=1.0,
+                        help='HOROVOD_CYCLE_TIME (default 1).')
+    parser.add_argument('--fusion-threshold-mb', type=float, default=128.0,
+                        help='HOROVOD_FUSION_THRESHOLD in MB (default 128).')
+    parser.add_argument('--skip-steps', type=int, default=1,
+                        help='Warmup steps of the trace to ignore (default 1).')
+    args = parser.parse_args(argv)
+
+    steps = load_traces(args.traces, args.skip_steps)
+    if not steps:
+        sys.stderr.write('No allreduce steps found in the traces.\n')
+        return 1
+
+    if args.cost_table:
+        cost_model = CostModel.load(args.cost_table)
+    else:
+        cost_model = CostModel(latency=args.latency_us / 1e6,
+                               bandwidth=args.bandwidth_gbps * 1e9)
+    plans = [parse_plan_spec(spec) for spec in args.plan]
+    plans += candidate_plans(steps, _parse_int_list(args.search_groups))
+    if not plans:
+        sys.stderr.write('Pass --plan or --search-groups.\n')
+        return 1
+
+    results = []
+    for plan in plans:
+        times = simulate(steps, plan, cost_model,
+                         num_streams=args.num_streams,
+                         stream_assignment=_parse_int_list(args.stream_assignment),
+                         cycle_time=args.cycle_time_ms / 1e3,
+                         fusion_threshold=int(args.fusion_threshold_mb * 1024 * 1024))
+        results.append((sum(times) / len(times), max(times), plan))
+
+    print('{} steps, {} tensors per step'.format(len(steps), len(steps[0])))
+    print('{:>12} {:>12}  {}'.format('mean ms', 'max ms', 'FUSION_SIZE;FUSION_BLOCK_NUM;FUSION_THREAD_NUM'))
+    for mean, worst, plan in sorted(results, key=lambda r: r[0]):
+        print('{:12.3f} {:12.3f}  {};{};{}'.format(mean * 1e3, worst * 1e3, plan.fusion_size,
+                                                   plan.block_num, plan.thread_num))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
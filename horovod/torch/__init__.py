@@ -25,16 +25,29 @@ except:
 
 from horovod.torch import elastic
 from horovod.torch.compression import Compression
+from horovod.torch.embedding import sharded_embedding_lookup
 from horovod.torch.functions import allgather_object, broadcast_object, broadcast_optimizer_state, broadcast_parameters
+from horovod.torch.functions import broadcast_optimizer_state_async, broadcast_parameters_async
 from horovod.torch.mpi_ops import allreduce, allreduce_async, allreduce_, allreduce_async_
+from horovod.torch.mpi_ops import grouped_allreduce, grouped_allreduce_async, grouped_allreduce_, \
+    grouped_allreduce_async_
 from horovod.torch.mpi_ops import allgather, allgather_async
 from horovod.torch.mpi_ops import broadcast, broadcast_async, broadcast_, broadcast_async_
 from horovod.torch.mpi_ops import alltoall, alltoall_async
+from horovod.torch.mpi_ops import reducescatter, reducescatter_async
+from horovod.torch.mpi_ops import sparse_allreduce, sparse_allreduce_async
 from horovod.torch.mpi_ops import join
 from horovod.torch.mpi_ops import poll, synchronize
 from horovod.torch.mpi_ops import init, shutdown
 from horovod.torch.mpi_ops import is_initialized, start_timeline, stop_timeline
+from horovod.torch.mpi_ops import flush_fusion_groups
+from horovod.torch.mpi_ops import release_fusion_buffers, fusion_buffer_bytes
+from horovod.torch.mpi_ops import step_completed
+from horovod.torch.mpi_ops import get_overlap_stats
+from horovod.torch.mpi_ops import get_metrics
+from horovod.torch.mpi_ops import get_straggler_scores
 from horovod.torch.mpi_ops import size, local_size, rank, local_rank
+from horovod.torch.mpi_ops import process_set_size, process_set_rank
 from horovod.torch.mpi_ops import mpi_threads_supported, mpi_enabled, mpi_built
 from horovod.torch.mpi_ops import gloo_enabled, gloo_built
 from horovod.torch.mpi_ops import nccl_built, ddl_built, ccl_built, cuda_built, rocm_built
@@ -13,12 +13,131 @@
 // limitations under the License.
 // =============================================================================
 
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
 #include "adapter_v2.h"
 #include "cuda_util.h"
 
 namespace horovod {
 namespace torch {
 
+namespace {
+
+// Storage of the outputs of named allgathers, kept between steps so that
+// outputs of slightly different sizes don't go through the allocator every
+// step. The storage of a name only grows, and is only handed out again once
+// the previous output has been released. The least recently used storages
+// are released to stay within HOROVOD_ALLGATHER_ARENA_BYTES.
+class OutputArena {
+public:
+  static OutputArena& Get() {
+    static OutputArena arena;
+    return arena;
+  }
+
+  bool enabled() const { return max_bytes_ > 0; }
+
+  // Points output at the storage of key, returns false if it can't be kept
+  // within the budget.
+  bool Allocate(const std::string& key, ::torch::Tensor& output,
+                const std::vector<int64_t>& shape) {
+    int64_t num_elements = 1;
+    for (auto dim : shape) {
+      num_elements *= dim;
+    }
+    if (num_elements == 0) {
+      return false;
+    }
+    int64_t element_size = output.element_size();
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    int64_t capacity = num_elements;
+    auto it = entries_.find(key);
+    if (it != entries_.end() &&
+        (it->second.dtype != output.scalar_type() ||
+         it->second.device != output.device())) {
+      bytes_ -= it->second.capacity * it->second.element_size;
+      entries_.erase(it);
+      it = entries_.end();
+    }
+    if (it != entries_.end() && (it->second.storage.use_count() > 1 ||
+                                 it->second.capacity < num_elements)) {
+      // Still in use or too small. The previous output keeps its storage, a
+      // grown one leaves room for further size changes.
+      capacity = it->second.capacity < num_elements
+                     ? std::max(num_elements,
+                                it->second.capacity + it->second.capacity / 2)
+                     : it->second.capacity;
+      bytes_ -= it->second.capacity * it->second.element_size;
+      entries_.erase(it);
+      it = entries_.end();
+    }
+
+    if (it == entries_.end()) {
+      int64_t bytes = capacity * element_size;
+      while (bytes_ + bytes > max_bytes_ && !entries_.empty()) {
+        auto lru = entries_.begin();
+        for (auto entry = entries_.begin(); entry != entries_.end(); ++entry) {
+          if (entry->second.last_use < lru->second.last_use) {
+            lru = entry;
+          }
+        }
+        bytes_ -= lru->second.capacity * lru->second.element_size;
+        entries_.erase(lru);
+      }
+      if (bytes_ + bytes > max_bytes_) {
+        return false;
+      }
+      auto buffer = ::torch::empty({capacity}, output.options());
+      Entry entry;
+      entry.storage = buffer.storage();
+      entry.capacity = capacity;
+      entry.element_size = element_size;
+      entry.dtype = output.scalar_type();
+      entry.device = output.device();
+      bytes_ += bytes;
+      it = entries_.emplace(key, std::move(entry)).first;
+    }
+    it->second.last_use = ++clock_;
+
+    std::vector<int64_t> strides(shape.size(), 1);
+    for (int i = (int)shape.size() - 2; i >= 0; --i) {
+      strides[i] = strides[i + 1] * shape[i + 1];
+    }
+    output.set_(it->second.storage, 0, shape, strides);
+    return true;
+  }
+
+private:
+  OutputArena() {
+    auto max_bytes = std::getenv(HOROVOD_ALLGATHER_ARENA_BYTES);
+    if (max_bytes != nullptr) {
+      max_bytes_ = std::strtoll(max_bytes, nullptr, 10);
+    }
+  }
+
+  struct Entry {
+    c10::Storage storage;
+    // In elements.
+    int64_t capacity = 0;
+    int64_t element_size = 0;
+    ::torch::ScalarType dtype;
+    ::torch::Device device = ::torch::kCPU;
+    uint64_t last_use = 0;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  int64_t bytes_ = 0;
+  int64_t max_bytes_ = 0;
+  uint64_t clock_ = 0;
+};
+
+} // namespace
+
 ::torch::ScalarType GetTorchDataType(DataType dtype) {
   switch (dtype) {
   case common::HOROVOD_UINT8:
@@ -37,6 +156,8 @@ namespace torch {
     return ::torch::kFloat;
   case common::HOROVOD_FLOAT64:
     return ::torch::kDouble;
+  case common::HOROVOD_BFLOAT16:
+    return ::torch::kBFloat16;
   default:
     throw std::logic_error("Invalid data type.");
   }
@@ -77,6 +198,8 @@ const DataType TorchTensor::dtype() const {
     return common::HOROVOD_FLOAT32;
   case ::torch::kDouble:
     return common::HOROVOD_FLOAT64;
+  case ::torch::kBFloat16:
+    return common::HOROVOD_BFLOAT16;
   default:
     throw std::logic_error("Invalid tensor type.");
   }
@@ -99,6 +222,10 @@ int64_t TorchTensor::size() const {
 TorchOpContext::TorchOpContext(int device, ::torch::Tensor output)
     : device_(device), output_(output) {}
 
+TorchOpContext::TorchOpContext(int device, ::torch::Tensor output,
+                               const std::string& arena_key)
+    : device_(device), output_(output), arena_key_(arena_key) {}
+
 Status
 TorchOpContext::AllocatePersistent(int64_t size,
                                    std::shared_ptr<PersistentBuffer>* tensor) {
@@ -115,7 +242,11 @@ Status TorchOpContext::AllocateOutput(TensorShape shape,
     shape_vector.push_back(shape.dim_size(idx));
   }
   with_device device_context(device_);
-  output_.resize_(shape_vector);
+  auto& arena = OutputArena::Get();
+  if (arena_key_.empty() || !arena.enabled() ||
+      !arena.Allocate(arena_key_, output_, shape_vector)) {
+    output_.resize_(shape_vector);
+  }
   *tensor = std::make_shared<TorchTensor>(output_);
   return Status::OK();
 }
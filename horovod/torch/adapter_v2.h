@@ -54,6 +54,10 @@ protected:
 class TorchOpContext : public OpContext {
 public:
   TorchOpContext(int device, ::torch::Tensor output);
+  // The output is allocated from the storage kept for arena_key between
+  // steps, if HOROVOD_ALLGATHER_ARENA_BYTES is set.
+  TorchOpContext(int device, ::torch::Tensor output,
+                 const std::string& arena_key);
   virtual Status
   AllocatePersistent(int64_t size,
                      std::shared_ptr<PersistentBuffer>* tensor) override;
@@ -66,6 +70,7 @@ public:
 private:
   int device_ = CPU_DEVICE_ID;
   ::torch::Tensor output_;
+  std::string arena_key_;
 };
 
 void ThrowIfError(Status status);
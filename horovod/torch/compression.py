@@ -64,6 +64,299 @@ class FP16Compressor(Compressor):
         return tensor_decompressed
 
 
+class SparseCompressor(Compressor):
+    """Sends a part of the entries of every gradient, chosen by select().
+
+    The entries that are not sent are kept in a residual per gradient and added
+    to its next value, so that they are sent eventually. The values and the
+    indices of the entries sent by all ranks are allgathered instead of
+    allreducing the gradient, and added up into a dense tensor.
+    """
+    gathered = True
+
+    def __init__(self, ratio=0.01):
+        if not 0 < ratio <= 1:
+            raise ValueError('ratio must be in (0, 1], got %s' % ratio)
+        self.ratio = ratio
+        self._residuals = {}
+
+    def select(self, tensor, k):
+        """Returns the indices of the k entries of the flat tensor to send."""
+        raise NotImplementedError()
+
+    def compress(self, tensor, name=None):
+        """Returns the values and the indices of the entries to send, and the
+        context needed to decompress them."""
+        flat = tensor.reshape(-1)
+        residual = self._residuals.get(name)
+        if residual is None or residual.shape != flat.shape or \
+                residual.dtype != flat.dtype or residual.device != flat.device:
+            residual = torch.zeros_like(flat)
+            self._residuals[name] = residual
+        residual.add_(flat)
+        k = max(1, int(flat.numel() * self.ratio))
+        indices = self.select(residual, k)
+        values = residual[indices]
+        residual.index_fill_(0, indices, 0)
+        return (values, indices), tensor.shape
+
+    def decompress(self, tensor, ctx):
+        """Adds up the gathered values into a dense tensor of the shape of the
+        gradient."""
+        values, indices = tensor
+        dense = torch.zeros(ctx.numel(), dtype=values.dtype, device=values.device)
+        dense.index_add_(0, indices, values)
+        return dense.view(ctx)
+
+
+class TopKCompressor(SparseCompressor):
+    """Sends the entries of largest magnitude, a ratio of every gradient."""
+    def select(self, tensor, k):
+        return torch.topk(tensor.abs(), k, sorted=False)[1]
+
+
+class RandomKCompressor(SparseCompressor):
+    """Sends random entries, a ratio of every gradient."""
+    def select(self, tensor, k):
+        return torch.randperm(tensor.numel(), device=tensor.device)[:k]
+
+
+class PowerSGDCompressor(Compressor):
+    """Allreduces two factors of rank `rank` of every matrix gradient, found by
+    one step of power iteration per step (PowerSGD).
+
+    A gradient of shape (n, ...) is reshaped to a matrix M of n rows. Its first
+    factor P = M Q is allreduced and orthogonalized, then its second factor
+    Q = M^T P is allreduced, and the gradient is approximated by P Q^T. Q is
+    kept as the start of the next power iteration, and M - P Q^T is added to
+    the next gradient. Gradients of one dimension, or too small to be
+    compressed, are allreduced as they are.
+    """
+    low_rank = True
+
+    def __init__(self, rank=1):
+        if rank < 1:
+            raise ValueError('rank must be at least 1, got %s' % rank)
+        self.rank = rank
+        self._qs = {}
+        self._residuals = {}
+
+    def compress(self, tensor, name=None):
+        """Returns the first factor of the gradient, and the context needed to
+        compute the second one."""
+        if tensor.dim() < 2:
+            return tensor, None
+        matrix = tensor.reshape(tensor.shape[0], -1)
+        n, m = matrix.shape
+        if self.rank * (n + m) >= n * m:
+            return tensor, None
+
+        residual = self._residuals.get(name)
+        if residual is not None and residual.shape == matrix.shape and \
+                residual.dtype == matrix.dtype and residual.device == matrix.device:
+            matrix = matrix + residual
+        q = self._qs.get(name)
+        if q is None or q.shape != (m, self.rank) or \
+                q.dtype != matrix.dtype or q.device != matrix.device:
+            # The same start on all ranks, the later ones are allreduced.
+            generator = torch.Generator().manual_seed(0)
+            q = torch.randn(m, self.rank, generator=generator).to(
+                device=matrix.device, dtype=matrix.dtype)
+        return torch.matmul(matrix, q), (name, tensor.shape, matrix)
+
+    def compress_second(self, tensor, ctx):
+        """Returns the second factor computed from the reduced first one, or
+        None if the gradient was allreduced as it is."""
+        if ctx is None:
+            return None, (tensor, None)
+        p = _orthogonalize(tensor)
+        name, shape, matrix = ctx
+        return torch.matmul(matrix.t(), p), (p, ctx)
+
+    def decompress(self, tensor, ctx):
+        """Returns the approximation of the reduced gradient by its factors."""
+        p, ctx = ctx
+        if ctx is None:
+            return p
+        name, shape, matrix = ctx
+        self._qs[name] = tensor
+        approximation = torch.matmul(p, tensor.t())
+        self._residuals[name] = matrix - approximation
+        return approximation.view(shape)
+
+
+class ShardedCompressor(Compressor):
+    """Reduces every gradient in shards of whole chunks of chunk_size entries,
+    encoded by encode() with one scale per chunk.
+
+    compress() splits a gradient into num_shards shards, whose encodings are
+    sent to their ranks with an alltoall. compress_second() decodes the copies
+    of the shard of this rank received from all ranks, adds them up one rank at
+    a time in float32 and encodes the sum, which is allgathered and decoded by
+    decompress(). Every rank sends and receives about twice the encoded size of
+    a gradient, whatever the number of ranks.
+    """
+    gathered = True
+    scattered = True
+
+    def __init__(self, chunk_size):
+        self.chunk_size = chunk_size
+
+    def encode(self, chunks, counts):
+        """Returns the payload and the scales of float32 chunks, of which the
+        first counts entries are part of the gradient."""
+        raise NotImplementedError()
+
+    def decode(self, payload, scales):
+        """Returns the float32 chunks of the payload and the scales."""
+        raise NotImplementedError()
+
+    def prepare(self, flat, key):
+        """Returns the values of the flat tensor to send, key is the name of
+        the gradient, or a tuple of it and 'shard' for the sum of a shard."""
+        return flat
+
+    def sent(self, values, decoded, key):
+        """Called with the values sent and their decoding."""
+        pass
+
+    def _encode_values(self, flat, key, num_chunks):
+        values = self.prepare(flat, key)
+        padded = torch.zeros(num_chunks * self.chunk_size, dtype=torch.float32,
+                             device=flat.device)
+        padded[:flat.numel()] = values
+        starts = torch.arange(num_chunks, device=flat.device) * self.chunk_size
+        counts = (flat.numel() - starts).clamp(0, self.chunk_size)
+        payload, scales = self.encode(padded.view(num_chunks, self.chunk_size), counts)
+        self.sent(values, self.decode(payload, scales).view(-1)[:flat.numel()], key)
+        return payload, scales
+
+    def compress(self, tensor, name=None, num_shards=1, shard=0):
+        """Returns the payload and the scales of the chunks of all shards, in
+        shard order, and the context needed to reduce the shard of this rank."""
+        flat = tensor.reshape(-1)
+        num_chunks = (flat.numel() + self.chunk_size - 1) // self.chunk_size
+        shard_chunks = (num_chunks + num_shards - 1) // num_shards
+        return self._encode_values(flat, name, num_shards * shard_chunks), \
+            (name, tensor.shape, tensor.dtype, shard_chunks, shard)
+
+    def compress_second(self, tensor, ctx):
+        """Returns the payload and the scales of the sum of the copies of the
+        shard of this rank, received from all ranks."""
+        payload, scales = tensor
+        name, shape, dtype, shard_chunks, shard = ctx
+        total = torch.zeros(shard_chunks, self.chunk_size, dtype=torch.float32,
+                            device=scales.device)
+        for start in range(0, scales.shape[0], shard_chunks):
+            end = start + shard_chunks
+            total.add_(self.decode(payload[start:end], scales[start:end]))
+        shard_size = shard_chunks * self.chunk_size
+        num_elements = min(max(shape.numel() - shard * shard_size, 0), shard_size)
+        return self._encode_values(total.view(-1)[:num_elements], (name, 'shard'),
+                                   shard_chunks), ctx
+
+    def decompress(self, tensor, ctx):
+        """Returns the gathered sums of all shards as a dense tensor of the
+        shape and type of the gradient."""
+        payload, scales = tensor
+        name, shape, dtype, shard_chunks, shard = ctx
+        values = self.decode(payload, scales)
+        return values.view(-1)[:shape.numel()].view(shape).to(dtype)
+
+
+class OneBitCompressor(ShardedCompressor):
+    """Sends the sign of every entry of a gradient, with one scale per chunk of
+    chunk_size entries, the mean of their magnitudes (1-bit SGD).
+
+    The signs are packed eight per byte. What the signs and scales do not
+    represent is kept in a residual per gradient and added to its next value,
+    and likewise for the sum of the shard of this rank.
+    """
+    def __init__(self, chunk_size=1024):
+        if chunk_size < 8 or chunk_size % 8 != 0:
+            raise ValueError('chunk_size must be a positive multiple of 8, got %s' %
+                             chunk_size)
+        super(OneBitCompressor, self).__init__(chunk_size)
+        self._residuals = {}
+
+    def encode(self, chunks, counts):
+        scales = chunks.abs().sum(dim=1) / counts.clamp(min=1)
+        signs = chunks >= 0
+        return _pack_bits(signs.view(-1)).view(chunks.shape[0], -1), scales
+
+    def decode(self, payload, scales):
+        signs = _unpack_bits(payload.reshape(-1)).view(-1, self.chunk_size)
+        return (signs.float() * 2 - 1) * scales.unsqueeze(1)
+
+    def prepare(self, flat, key):
+        residual = self._residuals.get(key)
+        if residual is None or residual.shape != flat.shape or \
+                residual.dtype != flat.dtype or residual.device != flat.device:
+            residual = torch.zeros_like(flat)
+            self._residuals[key] = residual
+        return residual.add_(flat)
+
+    def sent(self, values, decoded, key):
+        values.sub_(decoded.to(values.dtype))
+
+
+class FP8Compressor(ShardedCompressor):
+    """Sends gradients as 8-bit floats of format e4m3 or e5m2, with one scale
+    per chunk of chunk_size entries mapping the largest magnitude of the chunk
+    to the largest 8-bit value.
+
+    The 8-bit values are sent as bytes, and dequantized and added up in
+    float32. Requires PyTorch 2.1 or later.
+    """
+    _DTYPES = {'e4m3': 'float8_e4m3fn', 'e5m2': 'float8_e5m2'}
+
+    def __init__(self, format='e4m3', chunk_size=1024):
+        if format not in self._DTYPES:
+            raise ValueError('format must be e4m3 or e5m2, got %s' % format)
+        if not hasattr(torch, self._DTYPES[format]):
+            raise ValueError('FP8 compression requires PyTorch 2.1 or later')
+        if chunk_size < 1:
+            raise ValueError('chunk_size must be positive, got %s' % chunk_size)
+        super(FP8Compressor, self).__init__(chunk_size)
+        self.dtype = getattr(torch, self._DTYPES[format])
+
+    def encode(self, chunks, counts):
+        scales = chunks.abs().amax(dim=1) / torch.finfo(self.dtype).max
+        scales = torch.where(scales > 0, scales, torch.ones_like(scales))
+        quantized = (chunks / scales.unsqueeze(1)).to(self.dtype)
+        return quantized.view(torch.uint8), scales
+
+    def decode(self, payload, scales):
+        return payload.view(self.dtype).float() * scales.unsqueeze(1)
+
+
+def _bit_weights(device):
+    return torch.tensor([1 << i for i in range(8)], dtype=torch.uint8, device=device)
+
+
+def _pack_bits(bits):
+    """Packs a boolean tensor of a multiple of 8 entries into bytes."""
+    weights = _bit_weights(bits.device)
+    return (bits.view(-1, 8).to(torch.uint8) * weights).sum(dim=1, dtype=torch.uint8)
+
+
+def _unpack_bits(packed):
+    """Unpacks bytes packed by _pack_bits into a boolean tensor."""
+    weights = _bit_weights(packed.device)
+    return (packed.unsqueeze(1) & weights) != 0
+
+
+def _orthogonalize(matrix, eps=1e-8):
+    """Orthonormalizes the columns of the matrix in place with Gram-Schmidt."""
+    for i in range(matrix.shape[1]):
+        column = matrix[:, i:i + 1]
+        column.div_(column.norm() + eps)
+        if i + 1 < matrix.shape[1]:
+            rest = matrix[:, i + 1:]
+            rest.sub_(torch.matmul(column, torch.matmul(column.t(), rest)))
+    return matrix
+
+
 class Compression(object):
     """Optional gradient compression algorithm used during allreduce."""
 
@@ -72,3 +365,23 @@ class Compression(object):
 
     """Compress all floating point gradients to 16-bit."""
     fp16 = FP16Compressor
+
+    """Send the largest entries of every gradient, for example
+    Compression.topk(0.01) for 1% of them."""
+    topk = TopKCompressor
+
+    """Send random entries of every gradient, for example
+    Compression.randomk(0.01) for 1% of them."""
+    randomk = RandomKCompressor
+
+    """Send two low-rank factors of every matrix gradient, for example
+    Compression.powersgd(4) for factors of rank 4."""
+    powersgd = PowerSGDCompressor
+
+    """Send the signs of every gradient and a scale per chunk of entries, for
+    example Compression.onebit(1024) for a scale per 1024 entries."""
+    onebit = OneBitCompressor
+
+    """Send every gradient as 8-bit floats with a scale per chunk of entries,
+    for example Compression.fp8('e4m3') or Compression.fp8('e5m2')."""
+    fp8 = FP8Compressor
@@ -19,9 +19,9 @@ import torch
 
 from horovod.common.elastic import ObjectState
 from horovod.torch.elastic.sampler import ElasticSampler
-from horovod.torch.functions import allgather_object, \
-    broadcast_object, broadcast_optimizer_state, broadcast_parameters
-from horovod.torch.mpi_ops import rank
+from horovod.torch.functions import allgather_object, broadcast_object, \
+    _broadcast_optimizer_state, _broadcast_parameters
+from horovod.torch.mpi_ops import allgather, rank
 
 
 class TorchState(ObjectState):
@@ -34,15 +34,24 @@ class TorchState(ObjectState):
     Args:
         model: Optional PyTorch model.
         optimizer: Optional PyTorch optimizer.
+        async_commit: If True, `commit()` copies the tensors of the model and
+                      optimizer into reused pinned host buffers on a side CUDA
+                      stream instead of deep copying them, and only waits
+                      for the copies of a commit at the next commit or
+                      restore. GPU work queued after the commit still runs
+                      after the copies, so that they see the committed values.
         kwargs: Attributes sync, will be exposed as attributes of the object. If a handler exists
                 for the attribute type, it will be used to sync the object, otherwise it will be
                 handled an ordinary Python object.
     """
-    def __init__(self, model=None, optimizer=None, **kwargs):
+    def __init__(self, model=None, optimizer=None, async_commit=False, **kwargs):
         kwargs.update(dict(model=model, optimizer=optimizer))
         self._handlers, kwargs = _get_handlers(kwargs)
         for name, handler in self._handlers.items():
+            if async_commit:
+                handler.enable_async_save()
             setattr(self, name, handler.value)
+        self._synced = False
         super(TorchState, self).__init__(bcast_object=broadcast_object,
                                          get_rank=rank,
                                          **kwargs)
@@ -58,9 +67,21 @@ class TorchState(ObjectState):
         super(TorchState, self).restore()
 
     def sync(self):
+        root_ranks = self._sync_root_ranks()
         for handler in self._handlers.values():
+            handler.root_ranks = root_ranks
             handler.sync()
         super(TorchState, self).sync()
+        self._synced = True
+
+    def _sync_root_ranks(self):
+        # The ranks that took part in the last sync hold the same state after
+        # a reset, so each of them broadcasts a share of the tensors. Ranks
+        # joining the job have not synced yet.
+        synced = allgather(torch.IntTensor([int(self._synced)]),
+                           name='elastic.synced')
+        root_ranks = [r for r, s in enumerate(synced.tolist()) if s]
+        return root_ranks or [0]
 
     def __setattr__(self, name, value):
         if hasattr(self, name) and name in self._handlers:
@@ -71,6 +92,8 @@ class TorchState(ObjectState):
 class StateHandler(object):
     def __init__(self, value):
         self.value = value
+        # The ranks holding the state to sync, set by TorchState before sync().
+        self.root_ranks = [0]
 
     def save(self):
         raise NotImplementedError()
@@ -81,39 +104,140 @@ class StateHandler(object):
     def sync(self):
         raise NotImplementedError()
 
+    def enable_async_save(self):
+        """Saves the state with asynchronous copies from now on, if supported."""
+        pass
+
     def set_value(self, value):
         self.value = value
         self.save()
 
 
+class _AsyncSnapshot(object):
+    """Copies of a state dict in host memory, made asynchronously.
+
+    The tensors are copied into pinned buffers that are reused as long as
+    their shapes do not change, on a side stream of each CUDA device. Two
+    sets of buffers alternate, so that the previous snapshot stays intact
+    while the copies of the next one are in flight. Other values are deep
+    copied.
+    """
+    def __init__(self):
+        self._buffers = [{}, {}]
+        self._index = 0
+        self._state = None
+        self._streams = {}
+        self._events = []
+
+    def save(self, state_dict):
+        # Completion fence of the previous snapshot.
+        self.wait()
+        self._index = 1 - self._index
+        used_streams = {}
+        self._state = self._copy(state_dict, self._buffers[self._index], (), used_streams)
+        for device, stream in used_streams.items():
+            event = torch.cuda.Event()
+            event.record(stream)
+            # Kernels queued after the commit may update the tensors in place.
+            torch.cuda.current_stream(device).wait_event(event)
+            self._events.append(event)
+
+    def wait(self):
+        for event in self._events:
+            event.synchronize()
+        self._events = []
+
+    def state(self):
+        self.wait()
+        return self._state
+
+    def _copy(self, value, buffers, key, used_streams):
+        if torch.is_tensor(value):
+            buffer = buffers.get(key)
+            if buffer is None or buffer.shape != value.shape or buffer.dtype != value.dtype:
+                buffer = torch.empty(value.shape, dtype=value.dtype, pin_memory=value.is_cuda)
+                buffers[key] = buffer
+            if not value.is_cuda:
+                buffer.copy_(value.detach())
+                return buffer
+            stream = used_streams.get(value.device)
+            if stream is None:
+                stream = self._streams.get(value.device)
+                if stream is None:
+                    stream = torch.cuda.Stream(device=value.device)
+                    self._streams[value.device] = stream
+                stream.wait_stream(torch.cuda.current_stream(value.device))
+                used_streams[value.device] = stream
+            with torch.cuda.stream(stream):
+                buffer.copy_(value.detach(), non_blocking=True)
+            return buffer
+        if isinstance(value, dict):
+            result = type(value)((k, self._copy(v, buffers, key + (k,), used_streams))
+                                 for k, v in value.items())
+            # Module state dicts carry the versions of the modules.
+            if hasattr(value, '_metadata'):
+                result._metadata = copy.deepcopy(value._metadata)
+            return result
+        if isinstance(value, (list, tuple)) and not hasattr(value, '_fields'):
+            return type(value)(self._copy(v, buffers, key + (i,), used_streams)
+                               for i, v in enumerate(value))
+        return copy.deepcopy(value)
+
+
 class ModelStateHandler(StateHandler):
     def __init__(self, model):
         super().__init__(model)
         self._saved_model_state = copy.deepcopy(self.value.state_dict())
+        self._snapshot = None
+
+    def enable_async_save(self):
+        self._snapshot = _AsyncSnapshot()
+        self._saved_model_state = None
+        self.save()
 
     def save(self):
-        self._saved_model_state = copy.deepcopy(self.value.state_dict())
+        if self._snapshot is not None:
+            self._snapshot.save(self.value.state_dict())
+        else:
+            self._saved_model_state = copy.deepcopy(self.value.state_dict())
 
     def restore(self):
-        self.value.load_state_dict(self._saved_model_state)
+        if self._snapshot is not None:
+            self.value.load_state_dict(self._snapshot.state())
+        else:
+            self.value.load_state_dict(self._saved_model_state)
 
     def sync(self):
-        broadcast_parameters(self.value.state_dict(), root_rank=0)
+        _broadcast_parameters(self.value.state_dict(), self.root_ranks)
 
 
 class OptimizerStateHandler(StateHandler):
     def __init__(self, optimizer):
         super().__init__(optimizer)
         self._saved_optimizer_state = copy.deepcopy(self.value.state_dict())
+        self._snapshot = None
+
+    def enable_async_save(self):
+        self._snapshot = _AsyncSnapshot()
+        self._saved_optimizer_state = None
+        self.save()
 
     def save(self):
-        self._saved_optimizer_state = copy.deepcopy(self.value.state_dict())
+        if self._snapshot is not None:
+            self._snapshot.save(self.value.state_dict())
+        else:
+            self._saved_optimizer_state = copy.deepcopy(self.value.state_dict())
 
     def restore(self):
-        self.value.load_state_dict(self._saved_optimizer_state)
+        if self._snapshot is not None:
+            # The optimizer may keep the given tensors as its state, which
+            # must not alias the buffers of the snapshot.
+            self.value.load_state_dict(copy.deepcopy(self._snapshot.state()))
+        else:
+            self.value.load_state_dict(self._saved_optimizer_state)
 
     def sync(self):
-        broadcast_optimizer_state(self.value, root_rank=0)
+        _broadcast_optimizer_state(self.value, self.root_ranks)
 
 
 class SamplerStateHandler(StateHandler):
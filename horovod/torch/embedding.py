@@ -0,0 +1,98 @@
+# Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+import torch
+
+from horovod.torch.mpi_ops import alltoall_async, synchronize
+from horovod.torch.mpi_ops import size
+
+
+def _exchange_name(name, part):
+    return '%s.%s' % (name, part) if name is not None else None
+
+
+class ShardedEmbeddingLookup(torch.autograd.Function):
+    """An autograd function that looks up rows of an embedding table sharded over
+    the Horovod processes."""
+
+    @staticmethod
+    def forward(ctx, shard, ids, name):
+        num_shards = size()
+        # Every id is sent once, to its owner, in the order of the owners.
+        unique_ids, inverse = torch.unique(ids.reshape(-1), return_inverse=True)
+        owners = unique_ids % num_shards
+        order = torch.argsort(owners)
+        splits = torch.bincount(owners, minlength=num_shards).int()
+        ids_handle = alltoall_async(unique_ids[order], splits=splits,
+                                    name=_exchange_name(name, 'ids'))
+        splits_handle = alltoall_async(splits,
+                                       splits=torch.ones(num_shards, dtype=torch.int32),
+                                       name=_exchange_name(name, 'splits'))
+        recv_ids = synchronize(ids_handle)
+        recv_splits = synchronize(splits_handle)
+
+        rows = (recv_ids // num_shards).long()
+        vectors = synchronize(alltoall_async(shard.index_select(0, rows),
+                                             splits=recv_splits,
+                                             name=_exchange_name(name, 'vectors')))
+        unique_vectors = torch.empty_like(vectors)
+        unique_vectors[order] = vectors
+
+        ctx.save_for_backward(rows, order, inverse, splits)
+        ctx.shard_shape = shard.shape
+        ctx.name = name
+        return unique_vectors[inverse].reshape(ids.shape + shard.shape[1:])
+
+    @staticmethod
+    def backward(ctx, grad_output):
+        rows, order, inverse, splits = ctx.saved_tensors
+        grad_output = grad_output.reshape((-1,) + ctx.shard_shape[1:])
+        # The gradients of the lookups of an id are added up before they are
+        # sent back to its owner, the way its vector came.
+        unique_grads = grad_output.new_zeros((len(order),) + ctx.shard_shape[1:])
+        unique_grads.index_add_(0, inverse, grad_output)
+        recv_grads = synchronize(alltoall_async(unique_grads[order], splits=splits,
+                                                name=_exchange_name(ctx.name, 'grads')))
+        grad_shard = grad_output.new_zeros(ctx.shard_shape)
+        grad_shard.index_add_(0, rows, recv_grads)
+        return grad_shard, None, None
+
+
+def sharded_embedding_lookup(shard, ids, name=None):
+    """
+    A function that looks up the rows `ids` of an embedding table whose rows are
+    sharded over the Horovod processes: row `i` of the table is row `i // size()` of
+    the `shard` of the process of rank `i % size()`.
+
+    The distinct ids are bucketed by owner and sent to it with an alltoall, which
+    returns their vectors with a second alltoall. The gradients go the same way
+    back in backward, where the owner adds them up into the gradient of its shard.
+    All processes must call this function together, with the same embedding
+    dimensions. Splits stay on the device of the ids when
+    `HOROVOD_ALLTOALL_DEVICE_SPLITS` is set.
+
+    The gradient of the shard only holds the lookups of this step, from all
+    processes, so the shard must not be passed to `hvd.DistributedOptimizer` or its
+    gradient would be averaged with the ones of the other shards.
+
+    Arguments:
+        shard: The rows of the table owned by this process.
+        ids: An integer tensor of the rows to look up, of any shape.
+        name: A name of the exchange operations.
+
+    Returns:
+        A tensor of shape `ids.shape + shard.shape[1:]` holding the looked up rows.
+    """
+    return ShardedEmbeddingLookup.apply(shard, ids, name)
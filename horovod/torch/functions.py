@@ -15,14 +15,17 @@
 
 import collections
 import io
+import pickle
+import warnings
 
 from collections.abc import Iterable
 
 import cloudpickle
+import numpy as np
 import torch
 
 from horovod.torch.mpi_ops import allgather, broadcast_, broadcast_async_
-from horovod.torch.mpi_ops import synchronize
+from horovod.torch.mpi_ops import poll, synchronize, _HandleGroup
 from horovod.torch.mpi_ops import rank, size
 from horovod.torch.optimizer import DistributedOptimizer
 
@@ -40,6 +43,59 @@ def broadcast_parameters(params, root_rank):
         root_rank: The rank of the process from which parameters will be
                    broadcasted to all other processes.
     """
+    _broadcast_parameters(params, [root_rank])
+
+
+def broadcast_parameters_async(params, root_rank):
+    """
+    Starts broadcasting the parameters from root rank to all other processes,
+    like `broadcast_parameters()`, and returns without waiting for it. The data
+    loader can be built, kernels warmed up and the first batches prefetched
+    while the broadcasts run, and the parameters must not be read or modified
+    before `synchronize()` returns on the handle.
+
+    Arguments:
+        params: One of the following:
+            - list of parameters to broadcast
+            - dict of parameters to broadcast
+        root_rank: The rank of the process from which parameters will be
+                   broadcasted to all other processes.
+
+    Returns:
+        A handle to pass to `poll()` and `synchronize()`.
+    """
+    return _broadcast_parameters_async(params, [root_rank])
+
+
+class _BroadcastHandle(_HandleGroup):
+    """The broadcasts of a set of parameters, and the callbacks to run once
+    they are done."""
+
+    def __init__(self, handles, callbacks=()):
+        self.handles = handles
+        self.callbacks = callbacks
+
+    def poll(self):
+        return all(poll(h) for h in self.handles)
+
+    def synchronize(self):
+        for handle in self.handles:
+            synchronize(handle)
+        self.handles = []
+        callbacks, self.callbacks = self.callbacks, ()
+        for callback in callbacks:
+            callback()
+
+
+def _broadcast_parameters(params, root_ranks):
+    """
+    Broadcasts the parameters from the given root ranks, which all hold the
+    same values, each root broadcasting an equal share of the bytes.
+    """
+    synchronize(_broadcast_parameters_async(params, root_ranks))
+
+
+def _broadcast_parameters_async(params, root_ranks, callbacks=()):
     if isinstance(params, dict):
         params = sorted(params.items())
     elif isinstance(params, list):
@@ -48,15 +104,26 @@ def broadcast_parameters(params, root_rank):
     else:
         raise ValueError('invalid params of type: %s' % type(params))
 
+    # Every rank assigns the same roots, since the parameters have the same
+    # order and sizes everywhere. The largest go first to the least loaded
+    # root.
+    roots = [root_ranks[0]] * len(params)
+    if len(root_ranks) > 1:
+        loads = [0] * len(root_ranks)
+        order = sorted(range(len(params)),
+                       key=lambda i: -params[i][1].numel() * params[i][1].element_size())
+        for i in order:
+            j = loads.index(min(loads))
+            roots[i] = root_ranks[j]
+            loads[j] += params[i][1].numel() * params[i][1].element_size()
+
     # Run asynchronous broadcasts.
     handles = []
-    for name, p in params:
-        handle = broadcast_async_(p, root_rank, name)
+    for (name, p), root in zip(params, roots):
+        handle = broadcast_async_(p, root, name)
         handles.append(handle)
 
-    # Wait for completion.
-    for handle in handles:
-        synchronize(handle)
+    return _BroadcastHandle(handles, callbacks)
 
 
 def broadcast_optimizer_state(optimizer, root_rank):
@@ -68,6 +135,33 @@ def broadcast_optimizer_state(optimizer, root_rank):
         root_rank: The rank of the process from which the optimizer will be
                    broadcasted to all other processes.
     """
+    _broadcast_optimizer_state(optimizer, [root_rank])
+
+
+def broadcast_optimizer_state_async(optimizer, root_rank):
+    """
+    Starts broadcasting an optimizer state from root rank to all other
+    processes, like `broadcast_optimizer_state()`, and returns without waiting
+    for it. The state of a new optimizer is initialized before this returns.
+    The optimizer must not be stepped before `synchronize()` returns on the
+    handle, which also sets its scalar options and state.
+
+    Arguments:
+        optimizer: An optimizer.
+        root_rank: The rank of the process from which the optimizer will be
+                   broadcasted to all other processes.
+
+    Returns:
+        A handle to pass to `poll()` and `synchronize()`.
+    """
+    return _broadcast_optimizer_state_async(optimizer, [root_rank])
+
+
+def _broadcast_optimizer_state(optimizer, root_ranks):
+    synchronize(_broadcast_optimizer_state_async(optimizer, root_ranks))
+
+
+def _broadcast_optimizer_state_async(optimizer, root_ranks):
     if isinstance(optimizer, torch.optim.LBFGS):
         # TODO(travis): L-BFGS cannot be easily supported without serializing
         #  the entire state_dict, as its structure is deeply nested and contains
@@ -99,7 +193,7 @@ def broadcast_optimizer_state(optimizer, root_rank):
     # Furthermore, attempting to access the state dict would result in
     # an error.
     if len(state_dict['state']) == 0:
-        return
+        return _BroadcastHandle([])
 
     params = []
     callbacks = {}
@@ -174,16 +268,19 @@ def broadcast_optimizer_state(optimizer, root_rank):
 
                 params.append((key, p))
 
-    # Synchronized broadcast of all parameters
-    broadcast_parameters(params, root_rank)
+    # Broadcast of all parameters, followed by the post-broadcast cleanup
+    # for non-tensor parameters
+    return _broadcast_parameters_async(
+        params, root_ranks,
+        [callbacks[key] for key, _ in params if key in callbacks])
 
-    # Post-broadcast cleanup for non-tensor parameters
-    for key, p in params:
-        if key in callbacks:
-            callbacks[key]()
 
+# The largest broadcast a buffer of an object is sent in by
+# `broadcast_object(out_of_band=True)`.
+_OBJECT_CHUNK_BYTES = 64 * 1024 * 1024
 
-def broadcast_object(obj, root_rank=0, name=None):
+
+def broadcast_object(obj, root_rank=0, name=None, out_of_band=False):
     """
     Serializes and broadcasts an object from root rank to all other processes.
     Typical usage is to broadcast the `optimizer.state_dict()`, for example:
@@ -200,12 +297,22 @@ def broadcast_object(obj, root_rank=0, name=None):
                    broadcasted to all other processes.
         name: Optional name to use during broadcast, will default to the class
               type.
+        out_of_band: If True, the tensors and the buffers pickled out of band
+                     with protocol 5, such as the data of numpy arrays, are
+                     broadcast in place in chunks, as fused broadcasts, instead
+                     of being copied into the pickled bytes. The other ranks
+                     receive them without copies. Tensors that share storage
+                     on the root rank do not share it on the other ranks.
+                     All ranks must pass the same value.
     Returns:
         The object that was broadcast from the `root_rank`.
     """
     if name is None:
         name = type(obj).__name__
 
+    if out_of_band:
+        return _broadcast_object_out_of_band(obj, root_rank, name)
+
     if rank() == root_rank:
         b = io.BytesIO()
         cloudpickle.dump(obj, b)
@@ -226,6 +333,93 @@ def broadcast_object(obj, root_rank=0, name=None):
     return obj
 
 
+class _OutOfBandPickler(cloudpickle.CloudPickler):
+    """Pickles dense tensors as references to the tensors to broadcast, and
+    collects the out of band buffers."""
+
+    def __init__(self, file, tensors, buffers):
+        if pickle.HIGHEST_PROTOCOL >= 5:
+            super().__init__(file, protocol=5, buffer_callback=buffers.append)
+        else:
+            super().__init__(file)
+        self._tensors = tensors
+        self._ids = {}
+
+    def persistent_id(self, obj):
+        if type(obj) not in (torch.Tensor, torch.nn.Parameter) or obj.layout != torch.strided:
+            return None
+        if id(obj) not in self._ids:
+            self._ids[id(obj)] = len(self._tensors)
+            self._tensors.append(obj)
+        return self._ids[id(obj)]
+
+
+class _OutOfBandUnpickler(pickle.Unpickler):
+    def __init__(self, file, tensors, buffers):
+        if pickle.HIGHEST_PROTOCOL >= 5:
+            super().__init__(file, buffers=buffers)
+        else:
+            super().__init__(file)
+        self._tensors = tensors
+
+    def persistent_load(self, pid):
+        return self._tensors[pid]
+
+
+def _broadcast_object_out_of_band(obj, root_rank, name):
+    tensors = []
+    if rank() == root_rank:
+        b = io.BytesIO()
+        buffers = []
+        _OutOfBandPickler(b, tensors, buffers).dump(obj)
+        with warnings.catch_warnings():
+            # The buffers are only read on the root rank.
+            warnings.simplefilter('ignore')
+            buffers = [torch.from_numpy(np.frombuffer(buf.raw(), dtype=np.uint8))
+                       for buf in buffers]
+        payload = torch.ByteTensor(bytearray(b.getvalue()))
+        layout = ([payload.numel()] + [buf.numel() for buf in buffers],
+                  [(t.dtype, t.shape, t.device.type, isinstance(t, torch.nn.Parameter),
+                    t.requires_grad) for t in tensors])
+        tensors = [t.detach().contiguous() for t in tensors]
+    else:
+        layout = None
+
+    # The sizes of the payload and buffers and the types of the tensors come
+    # first, so that the other ranks can allocate them.
+    sizes, specs = broadcast_object(layout, root_rank, name + '.layout')
+    if rank() != root_rank:
+        payload = torch.ByteTensor(sizes[0])
+        buffers = [torch.ByteTensor(n) for n in sizes[1:]]
+        for dtype, shape, device_type, _, _ in specs:
+            device = torch.device('cuda', torch.cuda.current_device()) \
+                if device_type == 'cuda' else torch.device('cpu')
+            tensors.append(torch.empty(shape, dtype=dtype, device=device))
+
+    handles = []
+    for part, t in enumerate([payload] + buffers + tensors):
+        # Broadcast as bytes, so that every dtype is supported and the chunks
+        # are the same bytes on all ranks.
+        flat = t.view(-1).view(torch.uint8)
+        chunk = _OBJECT_CHUNK_BYTES
+        for begin in range(0, flat.numel(), chunk):
+            handles.append(broadcast_async_(flat[begin:begin + chunk], root_rank,
+                                            '%s.part.%d.%d' % (name, part, begin)))
+    for handle in handles:
+        synchronize(handle)
+
+    if rank() == root_rank:
+        return obj
+
+    for i, (_, _, _, parameter, requires_grad) in enumerate(specs):
+        if parameter:
+            tensors[i] = torch.nn.Parameter(tensors[i], requires_grad=requires_grad)
+        elif requires_grad:
+            tensors[i].requires_grad_()
+    return _OutOfBandUnpickler(io.BytesIO(payload.numpy().tobytes()), tensors,
+                               [buf.numpy() for buf in buffers]).load()
+
+
 def allgather_object(obj, name=None):
     """
     Serializes and allgathers an object from all other processes.
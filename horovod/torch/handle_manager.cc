@@ -18,41 +18,121 @@
 namespace horovod {
 namespace torch {
 
+namespace {
+
+void ThrowInvalidHandle(int handle) {
+  throw std::invalid_argument("Handle " + std::to_string(handle) +
+                              " was not created or has been cleared.");
+}
+
+} // namespace
+
 int HandleManager::AllocateHandle() {
   int handle = last_handle_.fetch_add(1) + 1;
-  std::lock_guard<std::mutex> guard(mutex_);
-  results_[handle] = nullptr;
+  auto& slot = slots_[handle % HANDLE_MANAGER_SLOTS];
+  int free = 0;
+  if (slot.handle.compare_exchange_strong(free, handle)) {
+    return handle;
+  }
+  std::lock_guard<std::mutex> guard(overflow_mutex_);
+  overflow_[handle] = nullptr;
   return handle;
 }
 
+HandleManager::Slot* HandleManager::FindSlot(int handle) {
+  auto& slot = slots_[handle % HANDLE_MANAGER_SLOTS];
+  return slot.handle.load() == handle ? &slot : nullptr;
+}
+
+void HandleManager::SetResult(int handle,
+                              const std::shared_ptr<Status>& result) {
+  auto slot = FindSlot(handle);
+  if (slot != nullptr) {
+    slot->status = result;
+    slot->done.store(true);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(overflow_mutex_);
+  overflow_[handle] = result;
+}
+
+void HandleManager::NotifyWaiters() {
+  // A thread about to block registered as a waiter before checking its handle
+  // under mutex_, so it either sees the result or gets the notification.
+  if (waiters_.load() > 0) {
+    { std::lock_guard<std::mutex> guard(mutex_); }
+    done_.notify_all();
+  }
+}
+
 void HandleManager::MarkDone(int handle, const Status& status) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  results_[handle] = std::make_shared<Status>(status);
+  SetResult(handle, std::make_shared<Status>(status));
+  NotifyWaiters();
+}
+
+void HandleManager::MarkDone(const std::vector<int>& handles,
+                             const Status& status) {
+  auto result = std::make_shared<Status>(status);
+  for (auto handle : handles) {
+    SetResult(handle, result);
+  }
+  NotifyWaiters();
+}
+
+bool HandleManager::IsDone(int handle) {
+  auto slot = FindSlot(handle);
+  if (slot != nullptr) {
+    return slot->done.load();
+  }
+  std::lock_guard<std::mutex> guard(overflow_mutex_);
+  auto it = overflow_.find(handle);
+  if (it == overflow_.end()) {
+    ThrowInvalidHandle(handle);
+  }
+  return it->second != nullptr;
 }
 
 bool HandleManager::PollHandle(int handle) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (results_.find(handle) == results_.end()) {
-    throw std::invalid_argument("Handle " + std::to_string(handle) +
-                                " was not created or has been cleared.");
+  return IsDone(handle);
+}
+
+void HandleManager::WaitHandle(int handle) {
+  if (IsDone(handle)) {
+    return;
   }
-  return results_[handle] != nullptr;
+  std::unique_lock<std::mutex> lock(mutex_);
+  waiters_.fetch_add(1);
+  done_.wait(lock, [this, handle] { return IsDone(handle); });
+  waiters_.fetch_sub(1);
 }
 
 std::shared_ptr<Status> HandleManager::ReleaseHandle(int handle) {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (results_.find(handle) == results_.end()) {
-    throw std::invalid_argument("Handle " + std::to_string(handle) +
-        " was not created or has been cleared.");
+  auto slot = FindSlot(handle);
+  if (slot != nullptr) {
+    auto status = std::move(slot->status);
+    slot->status = nullptr;
+    slot->done.store(false);
+    slot->handle.store(0);
+    return status;
+  }
+  std::lock_guard<std::mutex> guard(overflow_mutex_);
+  auto it = overflow_.find(handle);
+  if (it == overflow_.end()) {
+    ThrowInvalidHandle(handle);
   }
-  auto status = results_[handle];
-  results_.erase(handle);
+  auto status = it->second;
+  overflow_.erase(it);
   return status;
 }
 
 void HandleManager::Reset() {
-  std::lock_guard<std::mutex> guard(mutex_);
-  results_.clear();
+  for (auto& slot : slots_) {
+    slot.status = nullptr;
+    slot.done.store(false);
+    slot.handle.store(0);
+  }
+  std::lock_guard<std::mutex> guard(overflow_mutex_);
+  overflow_.clear();
   last_handle_ = 0;
 }
 
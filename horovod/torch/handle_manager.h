@@ -17,6 +17,7 @@
 #define HOROVOD_TORCH_HANDLE_MANAGER_H
 
 #include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -28,18 +29,56 @@ namespace torch {
 
 using namespace horovod::common;
 
-class HandleManager {
+// Number of handles kept in the slots of the handle manager. Handles whose
+// slot is still taken by an older handle go to a map under a lock.
+#define HANDLE_MANAGER_SLOTS 4096
+
+// Operations handed to the handle manager as their batcher are marked done
+// together with the rest of their fusion group, with one notification of the
+// waiting threads.
+//
+// Handles live in an array of slots indexed by handle, so that allocating,
+// completing, polling and releasing a handle takes no lock. The waiting
+// threads are only notified, under the lock of the condition variable, when
+// one of them blocks.
+class HandleManager : public CompletionBatcher {
 public:
   int AllocateHandle();
   void MarkDone(int handle, const Status& status);
+  void MarkDone(const std::vector<int>& handles, const Status& status);
+  void Complete(const std::vector<int>& handles, const Status& status) override {
+    MarkDone(handles, status);
+  }
   bool PollHandle(int handle);
+  // Blocks until the handle is done.
+  void WaitHandle(int handle);
   std::shared_ptr<Status> ReleaseHandle(int handle);
   void Reset();
 
 private:
-  std::atomic_int last_handle_;
-  std::unordered_map<int, std::shared_ptr<Status>> results_;
+  struct Slot {
+    // The handle of the slot, 0 if the slot is free.
+    std::atomic_int handle{0};
+    // Set once status is written.
+    std::atomic_bool done{false};
+    std::shared_ptr<Status> status;
+  };
+
+  // The slot of the handle, nullptr if it is in the overflow map.
+  Slot* FindSlot(int handle);
+  void SetResult(int handle, const std::shared_ptr<Status>& result);
+  bool IsDone(int handle);
+  void NotifyWaiters();
+
+  std::atomic_int last_handle_{0};
+  Slot slots_[HANDLE_MANAGER_SLOTS];
+
+  std::unordered_map<int, std::shared_ptr<Status>> overflow_;
+  std::mutex overflow_mutex_;
+
+  std::atomic_int waiters_{0};
   std::mutex mutex_;
+  std::condition_variable done_;
 };
 
 } // namespace torch
@@ -35,8 +35,17 @@ init = _basics.init
 is_initialized = _basics.is_initialized
 start_timeline = _basics.start_timeline
 stop_timeline = _basics.stop_timeline
+flush_fusion_groups = _basics.flush_fusion_groups
+release_fusion_buffers = _basics.release_fusion_buffers
+fusion_buffer_bytes = _basics.fusion_buffer_bytes
+step_completed = _basics.step_completed
+get_overlap_stats = _basics.get_overlap_stats
+get_metrics = _basics.get_metrics
+get_straggler_scores = _basics.get_straggler_scores
 size = _basics.size
 local_size = _basics.local_size
+process_set_size = _basics.process_set_size
+process_set_rank = _basics.process_set_rank
 rank = _basics.rank
 local_rank = _basics.local_rank
 mpi_threads_supported = _basics.mpi_threads_supported
@@ -82,7 +91,22 @@ def _allreduce_function_factory(tensor):
     return 'horovod_torch_allreduce_async_' + tensor.type().replace('.', '_')
 
 
-def _allreduce_async(tensor, output, name, op, prescale_factor, postscale_factor):
+def _fused_statistics_supported(tensor):
+    """Whether the squared norm of the allreduce of the tensor can be added up,
+    and its overflows looked for, while it is copied out of the fusion buffer,
+    on the GPU."""
+    return (tensor.is_cuda and not rocm_built() and
+            tensor.dtype in (torch.float16, torch.bfloat16, torch.float32, torch.float64) and
+            hasattr(mpi_lib, 'horovod_torch_allreduce_statistics_async'))
+
+
+def _allreduce_async(tensor, output, name, op, prescale_factor, postscale_factor, priority=0,
+                     norm_sqrd=None, found_inf=None, process_set=0):
+    if process_set != 0:
+        return _process_set_allreduce_async(tensor, output, name, op, prescale_factor,
+                                            postscale_factor, priority, norm_sqrd, found_inf,
+                                            process_set)
+
     # Set the divisor for reduced gradients to average when necessary
     if op == Average:
         if rocm_built():
@@ -117,18 +141,84 @@ def _allreduce_async(tensor, output, name, op, prescale_factor, postscale_factor
         divisor = 1
 
     function = _check_function(_allreduce_function_factory, tensor)
+    if norm_sqrd is not None or found_inf is not None:
+        if not _fused_statistics_supported(tensor) or op == Adasum:
+            raise ValueError('norm_sqrd and found_inf require a floating point CUDA tensor reduced '
+                             'on the GPU, without Adasum.')
+        if norm_sqrd is not None and (norm_sqrd.dtype != torch.float64 or
+                                      norm_sqrd.numel() != 1 or
+                                      norm_sqrd.device != tensor.device):
+            raise ValueError('norm_sqrd must be a float64 scalar on the device of the tensor.')
+        if found_inf is not None and (found_inf.dtype != torch.float32 or
+                                      found_inf.numel() != 1 or
+                                      found_inf.device != tensor.device):
+            raise ValueError('found_inf must be a float32 scalar on the device of the tensor.')
     try:
-        handle = getattr(mpi_lib, function)(tensor, output, divisor,
-                                            name.encode() if name is not None else _NULL, op,
-                                            prescale_factor, postscale_factor)
+        if norm_sqrd is not None or found_inf is not None:
+            handle = mpi_lib.horovod_torch_allreduce_statistics_async(
+                tensor, output, name.encode() if name is not None else _NULL, op,
+                prescale_factor, postscale_factor, priority, norm_sqrd, found_inf)
+        else:
+            handle = getattr(mpi_lib, function)(tensor, output, divisor,
+                                                name.encode() if name is not None else _NULL, op,
+                                                prescale_factor, postscale_factor, priority)
     except RuntimeError as e:
         raise HorovodInternalError(e)
     _handle_map[handle] = (tensor, output)
     return handle
 
 
+def _process_set_allreduce_async(tensor, output, name, op, prescale_factor, postscale_factor,
+                                 priority, norm_sqrd, found_inf, process_set):
+    if op == Adasum:
+        raise NotImplementedError('Adasum is not supported in process sets.')
+    if norm_sqrd is not None or found_inf is not None:
+        raise ValueError('norm_sqrd and found_inf are not supported in process sets.')
+    divisor = 1
+    if op == Average and rocm_built():
+        # For ROCm, perform averaging at framework level
+        divisor = process_set_size(process_set)
+        op = Sum
+    try:
+        handle = mpi_lib.horovod_torch_process_set_allreduce_async(
+            tensor, output, divisor, name.encode() if name is not None else _NULL, op,
+            prescale_factor, postscale_factor, priority, process_set)
+    except RuntimeError as e:
+        raise HorovodInternalError(e)
+    _handle_map[handle] = (tensor, output)
+    return handle
+
+
+_OPTIMIZER_STEP_SGD = 0
+_OPTIMIZER_STEP_ADAM = 1
+
+
+def _optimizer_step_supported(tensor):
+    """Whether the parameter of the gradient tensor can be updated on the GPU stream
+    of its allreduce, right after it."""
+    return (tensor.is_cuda and not rocm_built() and
+            tensor.dtype in (torch.float16, torch.bfloat16, torch.float32, torch.float64) and
+            hasattr(mpi_lib, 'horovod_torch_allreduce_step_async'))
+
+
+def _allreduce_step_async(tensor, name, op, prescale_factor, postscale_factor, priority,
+                          parameter, states, kind, hyperparameters):
+    """Reduces the gradient tensor in place, and updates parameter and its states
+    from it with the optimizer step of the given kind on the GPU. See
+    DoAllreduceWithStep for the hyperparameters."""
+    try:
+        handle = mpi_lib.horovod_torch_allreduce_step_async(
+            tensor, tensor, name.encode() if name is not None else _NULL, op,
+            prescale_factor, postscale_factor, priority, parameter, states, kind,
+            [float(h) for h in hyperparameters])
+    except RuntimeError as e:
+        raise HorovodInternalError(e)
+    _handle_map[handle] = (tensor, tensor)
+    return handle
+
+
 def allreduce_async(tensor, average=None, name=None, op=None,
-                    prescale_factor=1.0, postscale_factor=1.0):
+                    prescale_factor=1.0, postscale_factor=1.0, priority=0, process_set=0):
     """
     A function that performs asynchronous averaging or summation of the input tensor
     over all the Horovod processes. The input tensor is not modified.
@@ -150,6 +240,10 @@ def allreduce_async(tensor, average=None, name=None, op=None,
                    ranks. Defaults to Average if None is given.
         prescale_factor: Multiplicative factor to scale tensor before allreduce.
         postscale_factor: Multiplicative factor to scale tensor after allreduce.
+        priority: Scheduling priority of the allreduce when HOROVOD_FUSION_PRIORITY
+                  is set. Tensors with lower values are reduced first.
+        process_set: ID of the process set of HOROVOD_PROCESS_SETS to reduce the tensor
+                     among, 0 for all processes. Only the processes of the set call it.
 
     Returns:
         A handle to the allreduce operation that can be used with `poll()` or
@@ -157,30 +251,35 @@ def allreduce_async(tensor, average=None, name=None, op=None,
     """
     op = handle_average_backwards_compatibility(op, average)
     output = tensor.new(tensor.shape)
-    return _allreduce_async(tensor, output, name, op, prescale_factor, postscale_factor)
+    return _allreduce_async(tensor, output, name, op, prescale_factor, postscale_factor,
+                            priority, process_set=process_set)
 
 
 class HorovodAllreduce(torch.autograd.Function):
     """An autograd function that performs allreduce on a tensor."""
 
     @staticmethod
-    def forward(ctx, tensor, average, name, op, prescale_factor, postscale_factor):
+    def forward(ctx, tensor, average, name, op, prescale_factor, postscale_factor,
+                process_set=0):
         ctx.average = average
         ctx.op = op
         ctx.prescale_factor = prescale_factor
         ctx.postscale_factor = postscale_factor
-        handle = allreduce_async(tensor, average, name, op, prescale_factor, postscale_factor)
+        ctx.process_set = process_set
+        handle = allreduce_async(tensor, average, name, op, prescale_factor, postscale_factor,
+                                 process_set=process_set)
         return synchronize(handle)
 
     @staticmethod
     def backward(ctx, grad_output):
         return allreduce(grad_output, average=ctx.average, op=ctx.op,
                          prescale_factor=ctx.prescale_factor,
-                         postscale_factor=ctx.postscale_factor), None, None, None, None, None
+                         postscale_factor=ctx.postscale_factor,
+                         process_set=ctx.process_set), None, None, None, None, None, None
 
 
 def allreduce(tensor, average=None, name=None, compression=Compression.none, op=None,
-              prescale_factor=1.0, postscale_factor=1.0):
+              prescale_factor=1.0, postscale_factor=1.0, process_set=0):
     """
     A function that performs averaging or summation of the input tensor over all the
     Horovod processes. The input tensor is not modified.
@@ -209,6 +308,8 @@ def allreduce(tensor, average=None, name=None, compression=Compression.none, op=
             to Average if None is given.
         prescale_factor: Multiplicative factor to scale tensor before allreduce.
         postscale_factor: Multiplicative factor to scale tensor after allreduce.
+        process_set: ID of the process set of HOROVOD_PROCESS_SETS to reduce the tensor
+                     among, 0 for all processes. Only the processes of the set call it.
 
     Returns:
         A tensor of the same shape and type as `tensor`, averaged or summed across all
@@ -216,12 +317,14 @@ def allreduce(tensor, average=None, name=None, compression=Compression.none, op=
     """
     tensor_compressed, ctx = compression.compress(tensor)
     summed_tensor_compressed = HorovodAllreduce.apply(tensor_compressed, average, name, op,
-                                                      prescale_factor, postscale_factor)
+                                                      prescale_factor, postscale_factor,
+                                                      process_set)
     return compression.decompress(summed_tensor_compressed, ctx)
 
 
 def allreduce_async_(tensor, average=None, name=None, op=None,
-                     prescale_factor=1.0, postscale_factor=1.0):
+                     prescale_factor=1.0, postscale_factor=1.0, priority=0, norm_sqrd=None,
+                     found_inf=None, process_set=0):
     """
     A function that performs asynchronous in-place averaging or summation of the input
     tensor over all the Horovod processes.
@@ -243,17 +346,28 @@ def allreduce_async_(tensor, average=None, name=None, op=None,
             Average if None is given.
         prescale_factor: Multiplicative factor to scale tensor before allreduce.
         postscale_factor: Multiplicative factor to scale tensor after allreduce.
+        priority: Scheduling priority of the allreduce when HOROVOD_FUSION_PRIORITY
+                  is set. Tensors with lower values are reduced first.
+        norm_sqrd: A float64 scalar on the device of a CUDA tensor. The squared L2 norm
+                   of the reduced tensor is added to it on the GPU, while the result is
+                   copied out of the fusion buffer.
+        found_inf: A float32 scalar on the device of a CUDA tensor, set to 1 on the GPU
+                   if the reduced tensor has an inf or a NaN, like the ``found_inf`` of
+                   ``torch.cuda.amp.GradScaler``. It is left as is otherwise.
+        process_set: ID of the process set of HOROVOD_PROCESS_SETS to reduce the tensor
+                     among, 0 for all processes. Only the processes of the set call it.
 
     Returns:
         A handle to the allreduce operation that can be used with `poll()` or
         `synchronize()`.
     """
     op = handle_average_backwards_compatibility(op, average)
-    return _allreduce_async(tensor, tensor, name, op, prescale_factor, postscale_factor)
+    return _allreduce_async(tensor, tensor, name, op, prescale_factor, postscale_factor,
+                            priority, norm_sqrd, found_inf, process_set)
 
 
 def allreduce_(tensor, average=None, name=None, op=None,
-               prescale_factor=1.0, postscale_factor=1.0):
+               prescale_factor=1.0, postscale_factor=1.0, process_set=0):
     """
     A function that performs in-place averaging or summation of the input tensor over
     all the Horovod processes.
@@ -275,12 +389,212 @@ def allreduce_(tensor, average=None, name=None, op=None,
             Average if None is given.
         prescale_factor: Multiplicative factor to scale tensor before allreduce.
         postscale_factor: Multiplicative factor to scale tensor after allreduce.
+        process_set: ID of the process set of HOROVOD_PROCESS_SETS to reduce the tensor
+                     among, 0 for all processes. Only the processes of the set call it.
 
     Returns:
         A tensor of the same shape and type as `tensor`, averaged or summed across all
         processes.
     """
-    handle = allreduce_async_(tensor, average, name, op, prescale_factor, postscale_factor)
+    handle = allreduce_async_(tensor, average, name, op, prescale_factor, postscale_factor,
+                              process_set=process_set)
+    return synchronize(handle)
+
+
+def _grouped_allreduce_async(tensors, outputs, name, op, prescale_factor, postscale_factor,
+                             priority=0):
+    if not tensors:
+        raise ValueError('grouped_allreduce requires at least one tensor.')
+    if any(tensor.device != tensors[0].device for tensor in tensors):
+        raise ValueError('The tensors of a grouped allreduce must be on the same device.')
+    if op == Adasum:
+        raise NotImplementedError('Grouped allreduce does not support Adasum yet.')
+
+    # Set the divisor for reduced gradients to average when necessary
+    divisor = 1
+    if op == Average and rocm_built():
+        # For ROCm, perform averaging at framework level
+        divisor = size()
+        op = Sum
+
+    for tensor in tensors:
+        _check_function(_allreduce_function_factory, tensor)
+    try:
+        handle = mpi_lib.horovod_torch_grouped_allreduce_async(
+            tensors, outputs, divisor, name.encode() if name is not None else _NULL, op,
+            prescale_factor, postscale_factor, priority)
+    except RuntimeError as e:
+        raise HorovodInternalError(e)
+    _handle_map[handle] = (tensors, outputs)
+    return handle
+
+
+def grouped_allreduce_async(tensors, average=None, name=None, op=None,
+                            prescale_factor=1.0, postscale_factor=1.0, priority=0):
+    """
+    A function that performs asynchronous averaging or summation of a list of input
+    tensors over all the Horovod processes, as one operation. The input tensors are
+    not modified.
+
+    The tensors are negotiated together and fused as far as the fusion buffer allows,
+    and the operation completes once all of them are reduced. The reduction operation
+    is keyed by the name. If name is not provided, an incremented auto-generated name
+    is used. The list of tensors, with their types and shapes, must be the same on all
+    Horovod processes for a given name.
+
+    Arguments:
+        tensors: A list of tensors to reduce, all on the same device.
+        average:
+            .. warning:: .. deprecated:: 0.19.0
+
+                Use `op` instead. Will be removed in v0.21.0.
+
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks. Defaults
+            to Average if None is given.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce.
+        postscale_factor: Multiplicative factor to scale tensors after allreduce.
+        priority: Scheduling priority of the allreduces when HOROVOD_FUSION_PRIORITY
+                  is set. Tensors with lower values are reduced first.
+
+    Returns:
+        A handle to the grouped allreduce operation that can be used with `poll()` or
+        `synchronize()`, which returns the list of reduced tensors.
+    """
+    op = handle_average_backwards_compatibility(op, average)
+    outputs = [tensor.new(tensor.shape) for tensor in tensors]
+    return _grouped_allreduce_async(tensors, outputs, name, op, prescale_factor,
+                                    postscale_factor, priority)
+
+
+class HorovodGroupedAllreduce(torch.autograd.Function):
+    """An autograd function that performs allreduce on a list of tensors."""
+
+    @staticmethod
+    def forward(ctx, average, name, op, prescale_factor, postscale_factor, *tensors):
+        ctx.average = average
+        ctx.op = op
+        ctx.prescale_factor = prescale_factor
+        ctx.postscale_factor = postscale_factor
+        handle = grouped_allreduce_async(list(tensors), average, name, op,
+                                         prescale_factor, postscale_factor)
+        return tuple(synchronize(handle))
+
+    @staticmethod
+    def backward(ctx, *grad_outputs):
+        grad_reduced = grouped_allreduce(list(grad_outputs), average=ctx.average, op=ctx.op,
+                                         prescale_factor=ctx.prescale_factor,
+                                         postscale_factor=ctx.postscale_factor)
+        return (None, None, None, None, None) + tuple(grad_reduced)
+
+
+def grouped_allreduce(tensors, average=None, name=None, compression=Compression.none,
+                      op=None, prescale_factor=1.0, postscale_factor=1.0):
+    """
+    A function that performs averaging or summation of a list of input tensors over
+    all the Horovod processes, as one operation. The input tensors are not modified.
+
+    The tensors are negotiated together and fused as far as the fusion buffer allows.
+    The reduction operation is keyed by the name. If name is not provided, an
+    incremented auto-generated name is used. The list of tensors, with their types and
+    shapes, must be the same on all Horovod processes for a given name.
+
+    This acts as a thin wrapper around an autograd function.  If your input
+    tensors require gradients, then callings this function will allow gradients
+    to be computed and backpropagated.
+
+    Arguments:
+        tensors: A list of tensors to reduce, all on the same device.
+        average:
+            .. warning:: .. deprecated:: 0.19.0
+
+                Use `op` instead. Will be removed in v0.21.0.
+
+        name: A name of the reduction operation.
+        compression: Compression algorithm used during allreduce to reduce the amount
+                     of data sent during the each parameter update step.  Defaults to
+                     not using compression.
+        op: The reduction operation to combine tensors across different ranks. Defaults
+            to Average if None is given.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce.
+        postscale_factor: Multiplicative factor to scale tensors after allreduce.
+
+    Returns:
+        A list of tensors of the same shapes and types as `tensors`, averaged or summed
+        across all processes.
+    """
+    tensors_compressed, ctxs = zip(*[compression.compress(tensor) for tensor in tensors])
+    summed_tensors_compressed = HorovodGroupedAllreduce.apply(
+        average, name, op, prescale_factor, postscale_factor, *tensors_compressed)
+    return [compression.decompress(tensor, ctx)
+            for tensor, ctx in zip(summed_tensors_compressed, ctxs)]
+
+
+def grouped_allreduce_async_(tensors, average=None, name=None, op=None,
+                             prescale_factor=1.0, postscale_factor=1.0, priority=0):
+    """
+    A function that performs asynchronous in-place averaging or summation of a list of
+    input tensors over all the Horovod processes, as one operation.
+
+    The tensors are negotiated together and fused as far as the fusion buffer allows,
+    and the operation completes once all of them are reduced. The reduction operation
+    is keyed by the name. If name is not provided, an incremented auto-generated name
+    is used. The list of tensors, with their types and shapes, must be the same on all
+    Horovod processes for a given name.
+
+    Arguments:
+        tensors: A list of tensors to reduce, all on the same device.
+        average:
+            .. warning:: .. deprecated:: 0.19.0
+
+                Use `op` instead. Will be removed in v0.21.0.
+
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks. Defaults
+            to Average if None is given.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce.
+        postscale_factor: Multiplicative factor to scale tensors after allreduce.
+        priority: Scheduling priority of the allreduces when HOROVOD_FUSION_PRIORITY
+                  is set. Tensors with lower values are reduced first.
+
+    Returns:
+        A handle to the grouped allreduce operation that can be used with `poll()` or
+        `synchronize()`, which returns the list of reduced tensors.
+    """
+    op = handle_average_backwards_compatibility(op, average)
+    return _grouped_allreduce_async(tensors, tensors, name, op, prescale_factor,
+                                    postscale_factor, priority)
+
+
+def grouped_allreduce_(tensors, average=None, name=None, op=None,
+                       prescale_factor=1.0, postscale_factor=1.0):
+    """
+    A function that performs in-place averaging or summation of a list of input
+    tensors over all the Horovod processes, as one operation.
+
+    The tensors are negotiated together and fused as far as the fusion buffer allows.
+    The reduction operation is keyed by the name. If name is not provided, an
+    incremented auto-generated name is used. The list of tensors, with their types and
+    shapes, must be the same on all Horovod processes for a given name.
+
+    Arguments:
+        tensors: A list of tensors to reduce, all on the same device.
+        average:
+            .. warning:: .. deprecated:: 0.19.0
+
+                Use `op` instead. Will be removed in v0.21.0.
+
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks. Defaults
+            to Average if None is given.
+        prescale_factor: Multiplicative factor to scale tensors before allreduce.
+        postscale_factor: Multiplicative factor to scale tensors after allreduce.
+
+    Returns:
+        The list of tensors, averaged or summed in place across all processes.
+    """
+    handle = grouped_allreduce_async_(tensors, average, name, op, prescale_factor,
+                                      postscale_factor)
     return synchronize(handle)
 
 
@@ -589,6 +903,184 @@ def alltoall(tensor, splits=None, name=None):
     return HorovodAlltoall.apply(tensor, splits, name)
 
 
+def _reducescatter_function_factory(tensor):
+    return 'horovod_torch_reducescatter_async_' + tensor.type().replace('.', '_')
+
+
+def _reducescatter_async(tensor, output, name, op):
+    if op == Average:
+        divisor = size()
+    elif op == Sum:
+        divisor = 1
+    else:
+        raise NotImplementedError('Reducescatter only supports the Average and Sum ops.')
+
+    function = _check_function(_reducescatter_function_factory, tensor)
+    try:
+        handle = getattr(mpi_lib, function)(
+            tensor, output, divisor, name.encode() if name is not None else _NULL)
+    except RuntimeError as e:
+        raise HorovodInternalError(e)
+    _handle_map[handle] = (tensor, output)
+    return handle
+
+
+def reducescatter_async(tensor, name=None, op=Average):
+    """
+    A function that performs asynchronous reduction of the input tensor over all the
+    Horovod processes, then scatters the results along the first dimension. The input
+    tensor is not modified.
+
+    The input tensors on the different processes must have the same rank and shape.
+    The first dimension is split across the processes, the first
+    `tensor.size(0) % size()` processes receiving one more slice than the others.
+
+    Arguments:
+        tensor: A tensor to reduce and scatter.
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks.
+            Defaults to Average.
+
+    Returns:
+        A handle to the reducescatter operation that can be used with `poll()` or
+        `synchronize()`.
+    """
+    output = tensor.new()
+    return _reducescatter_async(tensor, output, name, op)
+
+
+class HorovodReducescatter(torch.autograd.Function):
+    """An autograd function that performs reducescatter on a tensor."""
+
+    @staticmethod
+    def forward(ctx, tensor, name, op):
+        ctx.op = op
+        handle = reducescatter_async(tensor, name, op)
+        return synchronize(handle)
+
+    @staticmethod
+    def backward(ctx, grad_output):
+        grad = allgather(grad_output)
+        if ctx.op == Average:
+            grad = grad / size()
+        return grad, None, None
+
+
+def reducescatter(tensor, name=None, op=Average):
+    """
+    A function that performs reduction of the input tensor over all the Horovod
+    processes, then scatters the results along the first dimension. The input tensor
+    is not modified.
+
+    The input tensors on the different processes must have the same rank and shape.
+    The first dimension is split across the processes, the first
+    `tensor.size(0) % size()` processes receiving one more slice than the others.
+
+    This acts as a thin wrapper around an autograd function.  If your input
+    tensor requires gradients, then callings this function will allow gradients
+    to be computed and backpropagated.
+
+    Arguments:
+        tensor: A tensor to reduce and scatter.
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks.
+            Defaults to Average.
+
+    Returns:
+        A tensor of the same rank and type as `tensor`, holding the part of the
+        reduced tensor of this process.
+    """
+    return HorovodReducescatter.apply(tensor, name, op)
+
+
+class _HandleGroup(object):
+    """A handle of several asynchronous operations, which `poll()` and
+    `synchronize()` accept like the handle of a single operation."""
+
+    def poll(self):
+        raise NotImplementedError()
+
+    def synchronize(self):
+        raise NotImplementedError()
+
+
+class _SparseAllreduceHandle(_HandleGroup):
+    """The allgathers of the indices and values of a sparse allreduce."""
+
+    def __init__(self, indices_handle, values_handle, shape, op, dense):
+        self.handles = (indices_handle, values_handle)
+        self.shape = shape
+        self.op = op
+        self.dense = dense
+
+    def poll(self):
+        return all(poll(h) for h in self.handles)
+
+    def synchronize(self):
+        indices, values = (synchronize(h) for h in self.handles)
+        # Rows sent by several ranks are added up once more here.
+        output = torch.sparse_coo_tensor(indices.t(), values, self.shape).coalesce()
+        if self.op == Average:
+            output = output / size()
+        return output.to_dense() if self.dense else output
+
+
+def sparse_allreduce_async(tensor, name=None, op=Average, dense=False):
+    """
+    A function that asynchronously reduces a sparse COO tensor, such as the gradient
+    of a `torch.nn.Embedding(sparse=True)`, over all the Horovod processes. The input
+    tensor is not modified.
+
+    The duplicate indices of the tensor are first added up locally, so that every
+    row is sent once per process, then the indices and values of all processes are
+    allgathered and added up. This sends far less data than a dense allreduce when
+    the processes only touch a few rows of a large tensor.
+
+    Arguments:
+        tensor: A sparse COO tensor to reduce, of the same shape on all processes.
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks.
+            Average or Sum, defaults to Average.
+        dense: Whether the result is scattered into a dense tensor instead of
+               staying sparse.
+
+    Returns:
+        A handle to the sparse allreduce operation that can be used with `poll()` or
+        `synchronize()`.
+    """
+    if op != Average and op != Sum:
+        raise NotImplementedError('Sparse allreduce only supports the Average and Sum ops.')
+    tensor = tensor.coalesce()
+    indices = tensor.indices().t().contiguous()
+    values = tensor.values().contiguous()
+    indices_handle = allgather_async(
+        indices, name='%s.indices' % name if name is not None else None)
+    values_handle = allgather_async(
+        values, name='%s.values' % name if name is not None else None)
+    return _SparseAllreduceHandle(indices_handle, values_handle, tensor.shape, op, dense)
+
+
+def sparse_allreduce(tensor, name=None, op=Average, dense=False):
+    """
+    A function that reduces a sparse COO tensor over all the Horovod processes like
+    `sparse_allreduce_async()`, and waits for the result. The input tensor is not
+    modified.
+
+    Arguments:
+        tensor: A sparse COO tensor to reduce, of the same shape on all processes.
+        name: A name of the reduction operation.
+        op: The reduction operation to combine tensors across different ranks.
+            Average or Sum, defaults to Average.
+        dense: Whether the result is scattered into a dense tensor instead of
+               staying sparse.
+
+    Returns:
+        A coalesced sparse tensor, or a dense tensor if `dense` is set, of the same
+        shape as `tensor`, averaged or summed across all processes.
+    """
+    return synchronize(sparse_allreduce_async(tensor, name, op, dense))
+
+
 def poll(handle):
     """
     Polls an allreduce, allgather or broadcast handle to determine whether underlying
@@ -602,6 +1094,8 @@ def poll(handle):
     Returns:
         A flag indicating whether the operation has completed.
     """
+    if isinstance(handle, _HandleGroup):
+        return handle.poll()
     return mpi_lib.horovod_torch_poll(handle) != 0
 
 
@@ -617,6 +1111,8 @@ def synchronize(handle):
     Returns:
         An output tensor of the operation.
     """
+    if isinstance(handle, _HandleGroup):
+        return handle.synchronize()
     if handle not in _handle_map:
         return
 
@@ -628,6 +1124,47 @@ def synchronize(handle):
         raise HorovodInternalError(e)
 
 
+def _register_grad_hook(parameter, name, op, prescale_factor, postscale_factor,
+                        priority, backward_passes_per_step):
+    """Registers an autograd hook that allreduces the gradient of the parameter in
+    place every backward_passes_per_step backward passes. The hook runs in C++ on
+    the autograd thread, without acquiring the GIL.
+
+    Returns an id to take the handles of the allreduce with _take_grad_hook_handle().
+    """
+    divisor = 1
+    if op == Average and rocm_built():
+        # For ROCm, perform averaging at framework level
+        divisor = size()
+        op = Sum
+    _check_function(_allreduce_function_factory, parameter)
+    return mpi_lib.horovod_torch_register_grad_hook(
+        parameter, name.encode(), divisor, op, prescale_factor, postscale_factor,
+        priority, backward_passes_per_step)
+
+
+def _take_grad_hook_handle(hook, grad, backward_passes_per_step):
+    """Returns the handle of the allreduce of grad enqueued by the hook since the
+    last call, or None if the hook has not enqueued it, and restarts counting the
+    backward passes of the hook."""
+    handle = mpi_lib.horovod_torch_take_grad_hook_handle(hook, backward_passes_per_step)
+    if handle == 0:
+        return None
+    _handle_map[handle] = (grad, grad)
+    return handle
+
+
+def _set_grad_hook_statistics(hook, norm_sqrd, found_inf):
+    """Adds the squared norms of the gradients reduced by the hook to the float64
+    scalar norm_sqrd, and sets the float32 scalar found_inf to 1 if they overflow,
+    from now on. Either can be None."""
+    mpi_lib.horovod_torch_set_grad_hook_statistics(hook, norm_sqrd, found_inf)
+
+
+def _remove_grad_hook(hook):
+    mpi_lib.horovod_torch_remove_grad_hook(hook)
+
+
 def join(device=-1):
     """A function that indicates that the rank finished processing data.
 
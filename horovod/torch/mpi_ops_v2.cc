@@ -17,7 +17,11 @@
 
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <torch/csrc/autograd/function_hook.h>
+#include <torch/csrc/autograd/variable.h>
 #include <torch/extension.h>
 #include <torch/torch.h>
 
@@ -61,9 +65,12 @@ void DivideInPlace(::torch::Tensor& tensor, int divisor) {
   tensor.div_(divisor);
 }
 
-int DoAllreduce(::torch::Tensor tensor, ::torch::Tensor output, int divisor,
-                const std::string& name, int reduce_op_int,
-                double prescale_factor, double postscale_factor) {
+int EnqueueAllreduce(::torch::Tensor tensor, ::torch::Tensor output,
+                     int divisor, const std::string& name, int reduce_op_int,
+                     double prescale_factor, double postscale_factor,
+                     int priority, std::shared_ptr<common::Tensor> norm_sqrd,
+                     std::shared_ptr<common::Tensor> found_inf,
+                     std::shared_ptr<OptimizerStep> optimizer_step = nullptr) {
   ThrowIfError(common::CheckInitialized());
 
   auto handle = handle_manager.AllocateHandle();
@@ -75,6 +82,8 @@ int DoAllreduce(::torch::Tensor tensor, ::torch::Tensor output, int divisor,
 
   ReduceOp reduce_op = static_cast<ReduceOp>(reduce_op_int);
   
+  // Without a division the handle is all there is to complete, so it is
+  // marked done together with the rest of its fusion group.
   auto enqueue_result = EnqueueTensorAllreduce(
       hvd_context, hvd_tensor, hvd_output, ready_event,
       GetOpName("allreduce", name, handle), device,
@@ -84,15 +93,220 @@ int DoAllreduce(::torch::Tensor tensor, ::torch::Tensor output, int divisor,
           DivideInPlace(output, divisor);
         }
         handle_manager.MarkDone(handle, status);
-      }, reduce_op, prescale_factor, postscale_factor);
+      }, reduce_op, prescale_factor, postscale_factor, priority,
+      divisor > 1 ? nullptr : &handle_manager, handle, norm_sqrd, found_inf,
+      optimizer_step);
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+int DoAllreduce(::torch::Tensor tensor, ::torch::Tensor output, int divisor,
+                const std::string& name, int reduce_op_int,
+                double prescale_factor, double postscale_factor,
+                int priority) {
+  return EnqueueAllreduce(tensor, output, divisor, name, reduce_op_int,
+                          prescale_factor, postscale_factor, priority, nullptr,
+                          nullptr);
+}
+
+// Allreduces the tensors, all on the same device, as one operation behind a
+// single handle. They are negotiated in the same cycle, and the handle is
+// done once all of them are, with the first error if any failed. Without GPU
+// allreduce support, GPU tensors are reduced in CPU copies.
+int DoGroupedAllreduce(const std::vector<::torch::Tensor>& tensors,
+                       const std::vector<::torch::Tensor>& outputs,
+                       int divisor, const std::string& name, int reduce_op_int,
+                       double prescale_factor, double postscale_factor,
+                       int priority) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto handle = handle_manager.AllocateHandle();
+  auto device = GetDeviceID(tensors[0]);
+  auto hvd_device = device;
+  std::vector<::torch::Tensor> buffers(tensors);
+#if !HOROVOD_GPU_ALLREDUCE
+  if (device != CPU_DEVICE_ID) {
+    hvd_device = CPU_DEVICE_ID;
+    for (auto& buffer : buffers) {
+      buffer = buffer.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+    }
+  }
+#endif
+  auto ready_event = RecordReadyEvent(device);
+  auto op_name = GetOpName("grouped_allreduce", name, handle);
+
+  struct GroupCompletion {
+    std::mutex mutex;
+    size_t remaining;
+    Status status;
+  };
+  auto completion = std::make_shared<GroupCompletion>();
+  completion->remaining = tensors.size();
+
+  std::vector<std::shared_ptr<common::OpContext>> hvd_contexts;
+  std::vector<std::shared_ptr<common::Tensor>> hvd_tensors;
+  std::vector<std::shared_ptr<common::Tensor>> hvd_outputs;
+  std::vector<std::string> names;
+  std::vector<common::StatusCallback> callbacks;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    auto output = outputs[i];
+    auto buffer = hvd_device == device ? output : buffers[i];
+    hvd_contexts.push_back(std::make_shared<TorchOpContext>(hvd_device, buffer));
+    hvd_tensors.push_back(std::make_shared<TorchTensor>(buffers[i]));
+    hvd_outputs.push_back(std::make_shared<TorchTensor>(buffer));
+    names.push_back(op_name + "." + std::to_string(i));
+    callbacks.push_back([handle, divisor, output, buffer, device, hvd_device,
+                         completion](const Status& status) mutable {
+      // Will execute in the `device` context.
+      if (hvd_device != device) {
+        with_device device_guard(device);
+        output.copy_(buffer);
+      }
+      if (divisor > 1) {
+        DivideInPlace(output, divisor);
+      }
+      Status result;
+      {
+        std::lock_guard<std::mutex> guard(completion->mutex);
+        if (!status.ok() && completion->status.ok()) {
+          completion->status = status;
+        }
+        if (--completion->remaining > 0) {
+          return;
+        }
+        result = completion->status;
+      }
+      handle_manager.MarkDone(handle, result);
+    });
+  }
+
+  ReduceOp reduce_op = static_cast<ReduceOp>(reduce_op_int);
+  auto enqueue_result = EnqueueTensorAllreduces(
+      hvd_contexts, hvd_tensors, hvd_outputs, ready_event, names, hvd_device,
+      callbacks, reduce_op, prescale_factor, postscale_factor, priority);
   ThrowIfError(enqueue_result);
 
   return handle;
 }
 
+// Allreduces the tensor among the ranks of the process set. Without GPU
+// allreduce support, GPU tensors are reduced in a CPU copy.
+int DoProcessSetAllreduce(::torch::Tensor tensor, ::torch::Tensor output,
+                          int divisor, const std::string& name,
+                          int reduce_op_int, double prescale_factor,
+                          double postscale_factor, int priority,
+                          int process_set_id) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto handle = handle_manager.AllocateHandle();
+  auto device = GetDeviceID(tensor);
+  auto hvd_device = device;
+  auto buffer = output;
+  auto input = tensor;
+#if !HOROVOD_GPU_ALLREDUCE
+  if (device != CPU_DEVICE_ID) {
+    hvd_device = CPU_DEVICE_ID;
+    input = tensor.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+    buffer = input;
+  }
+#endif
+  auto ready_event = RecordReadyEvent(device);
+  auto hvd_context = std::make_shared<TorchOpContext>(hvd_device, buffer);
+
+  ReduceOp reduce_op = static_cast<ReduceOp>(reduce_op_int);
+  auto enqueue_result = EnqueueProcessSetAllreduce(
+      process_set_id, hvd_context, std::make_shared<TorchTensor>(input),
+      std::make_shared<TorchTensor>(buffer), ready_event,
+      GetOpName("allreduce", name, handle), hvd_device,
+      [handle, divisor, output, buffer, device,
+       hvd_device](const Status& status) mutable {
+        // Will execute in the `device` context.
+        if (hvd_device != device) {
+          with_device device_guard(device);
+          output.copy_(buffer);
+        }
+        if (divisor > 1) {
+          DivideInPlace(output, divisor);
+        }
+        handle_manager.MarkDone(handle, status);
+      }, reduce_op, prescale_factor, postscale_factor, priority);
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+std::shared_ptr<common::Tensor>
+OptionalTorchTensor(const c10::optional<::torch::Tensor>& tensor) {
+  return tensor.has_value() && tensor->defined()
+             ? std::make_shared<TorchTensor>(*tensor)
+             : nullptr;
+}
+
+// Like DoAllreduce, and while the output is copied out of the fusion buffer,
+// adds its squared L2 norm to the float64 scalar norm_sqrd and sets the
+// float32 scalar found_inf to one if it has an inf or a NaN.
+int DoAllreduceWithStatistics(::torch::Tensor tensor, ::torch::Tensor output,
+                              const std::string& name, int reduce_op_int,
+                              double prescale_factor, double postscale_factor,
+                              int priority,
+                              c10::optional<::torch::Tensor> norm_sqrd,
+                              c10::optional<::torch::Tensor> found_inf) {
+  return EnqueueAllreduce(tensor, output, 1, name, reduce_op_int,
+                          prescale_factor, postscale_factor, priority,
+                          OptionalTorchTensor(norm_sqrd),
+                          OptionalTorchTensor(found_inf));
+}
+
+// Like DoAllreduce, and updates parameter from the reduced gradient on the
+// GPU stream of the allreduce. The hyperparameters of OptimizerStep::SGD are
+// lr, weight_decay, momentum, dampening, nesterov and first_step, with the
+// momentum buffer as the state if momentum is used. Those of
+// OptimizerStep::ADAM are lr, weight_decay, beta1, beta2, eps, step and
+// decoupled_weight_decay, with the first and second moments as the states.
+int DoAllreduceWithStep(::torch::Tensor tensor, ::torch::Tensor output,
+                        const std::string& name, int reduce_op_int,
+                        double prescale_factor, double postscale_factor,
+                        int priority, ::torch::Tensor parameter,
+                        std::vector<::torch::Tensor> states, int kind,
+                        std::vector<double> hyperparameters) {
+  auto step = std::make_shared<OptimizerStep>();
+  step->kind = static_cast<OptimizerStep::Kind>(kind);
+  step->parameter = std::make_shared<TorchTensor>(parameter);
+  if (states.size() > 0) {
+    step->state0 = std::make_shared<TorchTensor>(states[0]);
+  }
+  if (states.size() > 1) {
+    step->state1 = std::make_shared<TorchTensor>(states[1]);
+  }
+  if (step->kind == OptimizerStep::SGD && hyperparameters.size() == 6) {
+    step->lr = hyperparameters[0];
+    step->weight_decay = hyperparameters[1];
+    step->momentum = hyperparameters[2];
+    step->dampening = hyperparameters[3];
+    step->nesterov = hyperparameters[4] != 0.0;
+    step->first_step = hyperparameters[5] != 0.0;
+  } else if (step->kind == OptimizerStep::ADAM && hyperparameters.size() == 7) {
+    step->lr = hyperparameters[0];
+    step->weight_decay = hyperparameters[1];
+    step->beta1 = hyperparameters[2];
+    step->beta2 = hyperparameters[3];
+    step->eps = hyperparameters[4];
+    step->step = (int64_t)hyperparameters[5];
+    step->decoupled_weight_decay = hyperparameters[6] != 0.0;
+  } else {
+    throw std::invalid_argument("Unknown optimizer step " +
+                                std::to_string(kind) + " or hyperparameters.");
+  }
+  return EnqueueAllreduce(tensor, output, 1, name, reduce_op_int,
+                          prescale_factor, postscale_factor, priority, nullptr,
+                          nullptr, step);
+}
+
 int DoAllreduceCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output, int divisor,
                          const std::string& name, int reduce_op_int,
-                         double prescale_factor, double postscale_factor) {
+                         double prescale_factor, double postscale_factor,
+                         int priority) {
   ThrowIfError(common::CheckInitialized());
 
   // Make async copy of input tensor to CPU tensor and record completion event.
@@ -120,19 +334,206 @@ int DoAllreduceCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output, int div
           DivideInPlace(output, divisor);
         }
         handle_manager.MarkDone(handle, status);
-      }, reduce_op, prescale_factor, postscale_factor);
+      }, reduce_op, prescale_factor, postscale_factor, priority);
   ThrowIfError(enqueue_result);
 
   return handle;
 }
 
+// A parameter whose gradient is allreduced in place by an autograd hook,
+// without returning to Python.
+struct GradHook {
+  ::torch::Tensor parameter;
+  std::string name;
+  int divisor;
+  int reduce_op;
+  double prescale_factor;
+  double postscale_factor;
+  int priority;
+  // If defined, the squared norm of the reduced gradient is added to it.
+  ::torch::Tensor norm_sqrd;
+  // If defined, set to one if the reduced gradient has an inf or a NaN.
+  ::torch::Tensor found_inf;
+  // The gradient accumulator is only weakly referenced by the parameter.
+  std::shared_ptr<::torch::autograd::Node> grad_accumulator;
+
+  std::mutex mutex;
+  int delay;
+  int handle = 0;
+  // Registered on the first backward pass, for the device of the gradient.
+  int32_t registered_allreduce = -1;
+  int registered_device = CPU_DEVICE_ID;
+
+  ~GradHook() {
+    if (registered_allreduce >= 0) {
+      common::UnregisterTensorAllreduce(registered_allreduce);
+    }
+  }
+};
+
+static std::mutex grad_hooks_mutex;
+static std::unordered_map<int, std::shared_ptr<GradHook>> grad_hooks;
+static int last_grad_hook = 0;
+
+std::shared_ptr<GradHook> GetGradHook(int hook_id) {
+  std::lock_guard<std::mutex> guard(grad_hooks_mutex);
+  auto it = grad_hooks.find(hook_id);
+  if (it == grad_hooks.end()) {
+    throw std::invalid_argument("Unknown gradient hook " +
+                                std::to_string(hook_id) + ".");
+  }
+  return it->second;
+}
+
+// Enqueues the gradient through the registered allreduce of the hook, which
+// skips building the request on every step.
+int DoGradHookAllreduce(GradHook& hook, ::torch::Tensor grad) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto handle = handle_manager.AllocateHandle();
+  auto device = GetDeviceID(grad);
+  auto ready_event = RecordReadyEvent(device);
+  auto hvd_tensor = std::make_shared<TorchTensor>(grad);
+  auto hvd_context = std::make_shared<TorchOpContext>(device, grad);
+
+  if (hook.registered_allreduce < 0 || hook.registered_device != device) {
+    if (hook.registered_allreduce >= 0) {
+      common::UnregisterTensorAllreduce(hook.registered_allreduce);
+      hook.registered_allreduce = -1;
+    }
+    ThrowIfError(common::RegisterTensorAllreduce(
+        GetOpName("allreduce", hook.name, handle), hvd_tensor->dtype(),
+        hvd_tensor->shape(), device, static_cast<ReduceOp>(hook.reduce_op),
+        hook.prescale_factor, hook.postscale_factor, hook.priority,
+        &hook.registered_allreduce));
+    hook.registered_device = device;
+  }
+
+  auto divisor = hook.divisor;
+  auto enqueue_result = EnqueueRegisteredAllreduce(
+      hook.registered_allreduce, hvd_context, hvd_tensor, hvd_tensor,
+      ready_event,
+      [handle, divisor, grad](const Status& status) mutable {
+        // Will execute in the `device` context.
+        if (divisor > 1) {
+          DivideInPlace(grad, divisor);
+        }
+        handle_manager.MarkDone(handle, status);
+      }, divisor > 1 ? nullptr : &handle_manager, handle,
+      hook.norm_sqrd.defined() ? std::make_shared<TorchTensor>(hook.norm_sqrd)
+                               : nullptr,
+      hook.found_inf.defined() ? std::make_shared<TorchTensor>(hook.found_inf)
+                               : nullptr);
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+class AllreduceGradPostHook : public ::torch::autograd::FunctionPostHook {
+public:
+  explicit AllreduceGradPostHook(std::weak_ptr<GradHook> hook)
+      : hook_(std::move(hook)) {}
+
+  // Runs on the autograd thread once the gradient has been accumulated.
+  ::torch::autograd::variable_list
+  operator()(const ::torch::autograd::variable_list& outputs,
+             const ::torch::autograd::variable_list& /* inputs */) override {
+    auto hook = hook_.lock();
+    if (!hook) {
+      return outputs;
+    }
+    std::lock_guard<std::mutex> guard(hook->mutex);
+    if (hook->handle != 0) {
+      throw std::logic_error(
+          "Gradients were computed more than backward_passes_per_step times "
+          "before call to step(). Increase backward_passes_per_step to "
+          "accumulate gradients locally.");
+    }
+    if (--hook->delay > 0) {
+      return outputs;
+    }
+    auto grad = hook->parameter.grad();
+#if !HOROVOD_GPU_ALLREDUCE
+    if (grad.is_cuda()) {
+      hook->handle = DoAllreduceCudaOnCPU(
+          grad, grad, hook->divisor, hook->name, hook->reduce_op,
+          hook->prescale_factor, hook->postscale_factor, hook->priority);
+      return outputs;
+    }
+#endif
+    hook->handle = DoGradHookAllreduce(*hook, grad);
+    return outputs;
+  }
+
+private:
+  std::weak_ptr<GradHook> hook_;
+};
+
+int RegisterGradHook(::torch::Tensor parameter, const std::string& name,
+                     int divisor, int reduce_op_int, double prescale_factor,
+                     double postscale_factor, int priority,
+                     int backward_passes_per_step) {
+  auto hook = std::make_shared<GradHook>();
+  hook->parameter = parameter;
+  hook->name = name;
+  hook->divisor = divisor;
+  hook->reduce_op = reduce_op_int;
+  hook->prescale_factor = prescale_factor;
+  hook->postscale_factor = postscale_factor;
+  hook->priority = priority;
+  hook->delay = backward_passes_per_step;
+  hook->grad_accumulator =
+      ::torch::autograd::impl::grad_accumulator(parameter);
+  if (!hook->grad_accumulator) {
+    throw std::invalid_argument("Parameter " + name +
+                                " does not require gradients.");
+  }
+  hook->grad_accumulator->add_post_hook(
+      std::unique_ptr<::torch::autograd::FunctionPostHook>(
+          new AllreduceGradPostHook(hook)));
+
+  std::lock_guard<std::mutex> guard(grad_hooks_mutex);
+  grad_hooks[++last_grad_hook] = hook;
+  return last_grad_hook;
+}
+
+// Returns the handle of the allreduce enqueued by the hook since the last
+// call, 0 if there is none, and restarts counting backward passes.
+int TakeGradHookHandle(int hook_id, int backward_passes_per_step) {
+  auto hook = GetGradHook(hook_id);
+  std::lock_guard<std::mutex> guard(hook->mutex);
+  auto handle = hook->handle;
+  hook->handle = 0;
+  hook->delay = backward_passes_per_step;
+  return handle;
+}
+
+// Adds the squared norms of the gradients reduced by the hook to norm_sqrd,
+// and flags their overflows in found_inf, from now on.
+void SetGradHookStatistics(int hook_id, c10::optional<::torch::Tensor> norm_sqrd,
+                           c10::optional<::torch::Tensor> found_inf) {
+  auto hook = GetGradHook(hook_id);
+  std::lock_guard<std::mutex> guard(hook->mutex);
+  hook->norm_sqrd = norm_sqrd.has_value() ? *norm_sqrd : ::torch::Tensor();
+  hook->found_inf = found_inf.has_value() ? *found_inf : ::torch::Tensor();
+}
+
+// The accumulator keeps its post hook, which does nothing once the state is
+// gone.
+void RemoveGradHook(int hook_id) {
+  std::lock_guard<std::mutex> guard(grad_hooks_mutex);
+  grad_hooks.erase(hook_id);
+}
+
 int DoAllgather(::torch::Tensor tensor, ::torch::Tensor output, const std::string& name) {
   ThrowIfError(common::CheckInitialized());
 
   auto device = GetDeviceID(tensor);
   auto ready_event = RecordReadyEvent(device);
   auto hvd_tensor = std::make_shared<TorchTensor>(tensor);
-  auto hvd_context = std::make_shared<TorchOpContext>(device, output);
+  // Only named allgathers run again under the same name in the next step.
+  auto hvd_context = std::make_shared<TorchOpContext>(
+      device, output, name.empty() ? "" : GetOpName("allgather", name, 0));
 
   auto handle = handle_manager.AllocateHandle();
   auto enqueue_result =
@@ -159,8 +560,9 @@ int DoAllgatherCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output,
 
   auto cpu_output = ::torch::empty_like(cpu_tensor);
   auto hvd_cpu_output = std::make_shared<TorchTensor>(cpu_output);
-  auto hvd_context =
-      std::make_shared<TorchOpContext>(CPU_DEVICE_ID, cpu_output);
+  auto hvd_context = std::make_shared<TorchOpContext>(
+      CPU_DEVICE_ID, cpu_output,
+      name.empty() ? "" : GetOpName("allgather", name, 0));
 
   auto handle = handle_manager.AllocateHandle();
   auto enqueue_result = EnqueueTensorAllgather(
@@ -248,8 +650,13 @@ int DoAlltoall(::torch::Tensor tensor, ::torch::Tensor splits, ::torch::Tensor o
   auto hvd_tensor = std::make_shared<TorchTensor>(tensor);
   auto hvd_context = std::make_shared<TorchOpContext>(device, output);
 
-  // Make sync copy of splits tensor to CPU if needed
-  auto splits_cpu = (GetDeviceID(splits) != CPU_DEVICE_ID) ?
+  // Splits on the device of the tensor can be exchanged by the alltoall
+  // itself. Otherwise make sync copy of splits tensor to CPU if needed
+  bool splits_on_device = device != CPU_DEVICE_ID &&
+                          GetDeviceID(splits) == device &&
+                          splits.numel() > 0 &&
+                          common::AlltoallDeviceSplits();
+  auto splits_cpu = (GetDeviceID(splits) != CPU_DEVICE_ID && !splits_on_device) ?
       splits.to(::torch::Device(::torch::kCPU), /*non_blocking=*/false) :
       splits;
   auto splits_tensor = std::make_shared<TorchTensor>(splits_cpu);
@@ -260,7 +667,8 @@ int DoAlltoall(::torch::Tensor tensor, ::torch::Tensor splits, ::torch::Tensor o
                              GetOpName("alltoall", name, handle), device,
                              [handle](const Status& status) {
                                handle_manager.MarkDone(handle, status);
-                             });
+                             },
+                             splits_on_device);
   ThrowIfError(enqueue_result);
 
   return handle;
@@ -306,13 +714,72 @@ int DoAlltoallCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor splits, ::torch:
   return handle;
 }
 
+int DoReducescatter(::torch::Tensor tensor, ::torch::Tensor output, int divisor,
+                    const std::string& name) {
+  ThrowIfError(common::CheckInitialized());
+
+  auto device = GetDeviceID(tensor);
+  auto ready_event = RecordReadyEvent(device);
+  auto hvd_tensor = std::make_shared<TorchTensor>(tensor);
+  auto hvd_context = std::make_shared<TorchOpContext>(device, output);
+
+  auto handle = handle_manager.AllocateHandle();
+  auto enqueue_result = EnqueueTensorReducescatter(
+      hvd_context, hvd_tensor, ready_event,
+      GetOpName("reducescatter", name, handle), device,
+      [handle, divisor, output](const Status& status) mutable {
+        // Will execute in the `device` context.
+        if (divisor > 1) {
+          DivideInPlace(output, divisor);
+        }
+        handle_manager.MarkDone(handle, status);
+      });
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
+int DoReducescatterCudaOnCPU(::torch::Tensor tensor, ::torch::Tensor output,
+                             int divisor, const std::string& name) {
+  ThrowIfError(common::CheckInitialized());
+
+  // Make async copy of input tensor to CPU tensor and record completion event.
+  auto device = GetDeviceID(tensor);
+  auto cpu_tensor =
+      tensor.to(::torch::Device(::torch::kCPU), /*non_blocking=*/true);
+  auto hvd_cpu_tensor = std::make_shared<TorchTensor>(cpu_tensor);
+  auto ready_event = RecordReadyEvent(device);
+
+  auto cpu_output = ::torch::empty_like(cpu_tensor);
+  auto hvd_context =
+      std::make_shared<TorchOpContext>(CPU_DEVICE_ID, cpu_output);
+
+  auto handle = handle_manager.AllocateHandle();
+  auto enqueue_result = EnqueueTensorReducescatter(
+      hvd_context, hvd_cpu_tensor, ready_event,
+      GetOpName("reducescatter", name, handle), CPU_DEVICE_ID,
+      [handle, divisor, cpu_output, output,
+       device](const Status& status) mutable {
+        // Since the operation was on CPU, need to perform copy with the GPU
+        // device guard.
+        with_device device_guard(device);
+        // output needs to be resized before copying in the CPU tensor.
+        output.resize_(cpu_output.sizes());
+        output.copy_(cpu_output);
+        if (divisor > 1) {
+          DivideInPlace(output, divisor);
+        }
+        handle_manager.MarkDone(handle, status);
+      });
+  ThrowIfError(enqueue_result);
+
+  return handle;
+}
+
 int PollHandle(int handle) { return handle_manager.PollHandle(handle) ? 1 : 0; }
 
 void WaitAndClear(int handle) {
-  while (true) {
-    if (handle_manager.PollHandle(handle)) break;
-    std::this_thread::yield();
-  }
+  handle_manager.WaitHandle(handle);
   auto status = handle_manager.ReleaseHandle(handle);
   ThrowIfError(*status);
 }
@@ -348,17 +815,27 @@ void Reset() {
 
 PYBIND11_MODULE(mpi_lib_v2, m) {
   // allreduce
+  m.def("horovod_torch_grouped_allreduce_async", &DoGroupedAllreduce);
+  m.def("horovod_torch_process_set_allreduce_async", &DoProcessSetAllreduce);
   m.def("horovod_torch_allreduce_async_torch_IntTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_LongTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_HalfTensor", &DoAllreduce);
+  m.def("horovod_torch_allreduce_async_torch_BFloat16Tensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_FloatTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_DoubleTensor", &DoAllreduce);
 #if HOROVOD_GPU_ALLREDUCE
   m.def("horovod_torch_allreduce_async_torch_cuda_IntTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_LongTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_HalfTensor", &DoAllreduce);
+  m.def("horovod_torch_allreduce_async_torch_cuda_BFloat16Tensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_FloatTensor", &DoAllreduce);
   m.def("horovod_torch_allreduce_async_torch_cuda_DoubleTensor", &DoAllreduce);
+  // Only the GPU allreduces add up the norms of their outputs and look for
+  // overflows.
+  m.def("horovod_torch_allreduce_statistics_async", &DoAllreduceWithStatistics);
+  m.def("horovod_torch_set_grad_hook_statistics", &SetGradHookStatistics);
+  // Only the GPU allreduces run optimizer steps.
+  m.def("horovod_torch_allreduce_step_async", &DoAllreduceWithStep);
 #else
   m.def("horovod_torch_allreduce_async_torch_cuda_IntTensor",
         &DoAllreduceCudaOnCPU);
@@ -366,6 +843,8 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoAllreduceCudaOnCPU);
   m.def("horovod_torch_allreduce_async_torch_cuda_HalfTensor",
         &DoAllreduceCudaOnCPU);
+  m.def("horovod_torch_allreduce_async_torch_cuda_BFloat16Tensor",
+        &DoAllreduceCudaOnCPU);
   m.def("horovod_torch_allreduce_async_torch_cuda_FloatTensor",
         &DoAllreduceCudaOnCPU);
   m.def("horovod_torch_allreduce_async_torch_cuda_DoubleTensor",
@@ -379,6 +858,7 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_allgather_async_torch_IntTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_LongTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_HalfTensor", &DoAllgather);
+  m.def("horovod_torch_allgather_async_torch_BFloat16Tensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_FloatTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_DoubleTensor", &DoAllgather);
 #if HOROVOD_GPU_ALLGATHER
@@ -388,6 +868,7 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_allgather_async_torch_cuda_IntTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_LongTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_HalfTensor", &DoAllgather);
+  m.def("horovod_torch_allgather_async_torch_cuda_BFloat16Tensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_FloatTensor", &DoAllgather);
   m.def("horovod_torch_allgather_async_torch_cuda_DoubleTensor", &DoAllgather);
 #else
@@ -403,6 +884,8 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoAllgatherCudaOnCPU);
   m.def("horovod_torch_allgather_async_torch_cuda_HalfTensor",
         &DoAllgatherCudaOnCPU);
+  m.def("horovod_torch_allgather_async_torch_cuda_BFloat16Tensor",
+        &DoAllgatherCudaOnCPU);
   m.def("horovod_torch_allgather_async_torch_cuda_FloatTensor",
         &DoAllgatherCudaOnCPU);
   m.def("horovod_torch_allgather_async_torch_cuda_DoubleTensor",
@@ -416,6 +899,7 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_broadcast_async_torch_IntTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_LongTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_HalfTensor", &DoBroadcast);
+  m.def("horovod_torch_broadcast_async_torch_BFloat16Tensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_FloatTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_DoubleTensor", &DoBroadcast);
 #if HOROVOD_GPU_BROADCAST
@@ -425,6 +909,7 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_broadcast_async_torch_cuda_IntTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_LongTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_HalfTensor", &DoBroadcast);
+  m.def("horovod_torch_broadcast_async_torch_cuda_BFloat16Tensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_FloatTensor", &DoBroadcast);
   m.def("horovod_torch_broadcast_async_torch_cuda_DoubleTensor", &DoBroadcast);
 #else
@@ -440,6 +925,8 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoBroadcastCudaOnCPU);
   m.def("horovod_torch_broadcast_async_torch_cuda_HalfTensor",
         &DoBroadcastCudaOnCPU);
+  m.def("horovod_torch_broadcast_async_torch_cuda_BFloat16Tensor",
+        &DoBroadcastCudaOnCPU);
   m.def("horovod_torch_broadcast_async_torch_cuda_FloatTensor",
         &DoBroadcastCudaOnCPU);
   m.def("horovod_torch_broadcast_async_torch_cuda_DoubleTensor",
@@ -453,6 +940,7 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_alltoall_async_torch_IntTensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_LongTensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_HalfTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_BFloat16Tensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_FloatTensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_DoubleTensor", &DoAlltoall);
 #if HOROVOD_GPU_ALLTOALL
@@ -462,6 +950,7 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
   m.def("horovod_torch_alltoall_async_torch_cuda_IntTensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_cuda_LongTensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_cuda_HalfTensor", &DoAlltoall);
+  m.def("horovod_torch_alltoall_async_torch_cuda_BFloat16Tensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_cuda_FloatTensor", &DoAlltoall);
   m.def("horovod_torch_alltoall_async_torch_cuda_DoubleTensor", &DoAlltoall);
 #else
@@ -477,18 +966,62 @@ PYBIND11_MODULE(mpi_lib_v2, m) {
         &DoAlltoallCudaOnCPU);
   m.def("horovod_torch_alltoall_async_torch_cuda_HalfTensor",
         &DoAlltoallCudaOnCPU);
+  m.def("horovod_torch_alltoall_async_torch_cuda_BFloat16Tensor",
+        &DoAlltoallCudaOnCPU);
   m.def("horovod_torch_alltoall_async_torch_cuda_FloatTensor",
         &DoAlltoallCudaOnCPU);
   m.def("horovod_torch_alltoall_async_torch_cuda_DoubleTensor",
         &DoAlltoallCudaOnCPU);
 #endif
 
+  // reducescatter
+  m.def("horovod_torch_reducescatter_async_torch_IntTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_LongTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_HalfTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_BFloat16Tensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_FloatTensor", &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_DoubleTensor", &DoReducescatter);
+#if HOROVOD_GPU_ALLREDUCE
+  m.def("horovod_torch_reducescatter_async_torch_cuda_IntTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_LongTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_HalfTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_BFloat16Tensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_FloatTensor",
+        &DoReducescatter);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_DoubleTensor",
+        &DoReducescatter);
+#else
+  m.def("horovod_torch_reducescatter_async_torch_cuda_IntTensor",
+        &DoReducescatterCudaOnCPU);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_LongTensor",
+        &DoReducescatterCudaOnCPU);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_HalfTensor",
+        &DoReducescatterCudaOnCPU);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_BFloat16Tensor",
+        &DoReducescatterCudaOnCPU);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_FloatTensor",
+        &DoReducescatterCudaOnCPU);
+  m.def("horovod_torch_reducescatter_async_torch_cuda_DoubleTensor",
+        &DoReducescatterCudaOnCPU);
+#endif
+
   // join
   m.def("horovod_torch_join", &DoJoin);
 
+  // gradient hooks
+  m.def("horovod_torch_register_grad_hook", &RegisterGradHook);
+  m.def("horovod_torch_take_grad_hook_handle", &TakeGradHookHandle);
+  m.def("horovod_torch_remove_grad_hook", &RemoveGradHook);
+
   // basics
   m.def("horovod_torch_poll", &PollHandle);
-  m.def("horovod_torch_wait_and_clear", &WaitAndClear);
+  // Other Python threads run while waiting for the handle.
+  m.def("horovod_torch_wait_and_clear", &WaitAndClear,
+        pybind11::call_guard<pybind11::gil_scoped_release>());
   m.def("horovod_torch_reset", &Reset);
 }
 
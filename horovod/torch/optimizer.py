@@ -18,21 +18,38 @@ import os
 import warnings
 
 from contextlib import contextmanager
+from distutils.version import LooseVersion
 
 import torch
 
 from horovod.torch.compression import Compression
+from horovod.torch.mpi_ops import _register_grad_hook, _remove_grad_hook, _take_grad_hook_handle
+from horovod.torch.mpi_ops import _fused_statistics_supported, _set_grad_hook_statistics
+from horovod.torch.mpi_ops import _allreduce_step_async, _optimizer_step_supported
+from horovod.torch.mpi_ops import _OPTIMIZER_STEP_ADAM, _OPTIMIZER_STEP_SGD
+from horovod.torch.mpi_ops import allgather_async
+from horovod.torch.mpi_ops import alltoall_async
 from horovod.torch.mpi_ops import allreduce_async_
+from horovod.torch.mpi_ops import sparse_allreduce_async
+from horovod.torch.mpi_ops import flush_fusion_groups
+from horovod.torch.mpi_ops import step_completed
 from horovod.torch.mpi_ops import synchronize
 from horovod.torch.mpi_ops import size
+from horovod.torch.mpi_ops import rank
 from horovod.torch.mpi_ops import Average, Adasum, Sum
 from horovod.torch.mpi_ops import rocm_built
 
+# Adam keeps its step count in a tensor from PyTorch 1.12.
+_TENSOR_ADAM_STEP = LooseVersion(torch.__version__) >= LooseVersion('1.12.0')
+
 
 class _DistributedOptimizer(torch.optim.Optimizer):
     def __init__(self, params, named_parameters, compression,
                  backward_passes_per_step=1, op=Average,
-                 gradient_predivide_factor=1.0):
+                 gradient_predivide_factor=1.0, register_parameters=False,
+                 contiguous_gradients=False, gradient_bucket_bytes=0,
+                 native_gradient_hooks=False, fused_grad_norm=False, fused_found_inf=False,
+                 fused_step=False):
         super(self.__class__, self).__init__(params)
         self._compression = compression
 
@@ -64,6 +81,11 @@ class _DistributedOptimizer(torch.optim.Optimizer):
                              '%s' % ', '.join(str(id) for id in unnamed_param_ids))
 
         self._parameter_names = {v: k for k, v in sorted(named_parameters)}
+        # Parameters are usually registered in the order of the forward pass,
+        # so the first layers get the most urgent allreduce priority.
+        self._parameter_priorities = {v: i for i, v in
+                                      enumerate(v for param_group in self.param_groups
+                                                for v in param_group['params'])}
         self.backward_passes_per_step = backward_passes_per_step
         self._allreduce_delay = {v: self.backward_passes_per_step
                                  for _, v in sorted(named_parameters)}
@@ -74,15 +96,61 @@ class _DistributedOptimizer(torch.optim.Optimizer):
         self._requires_update = set()
         self._synchronized = False
         self._should_synchronize = True
+        # Parameters of every gradient bucket, the bucket of every parameter,
+        # the parameters of every bucket whose gradient is ready, and the
+        # handles of the buckets enqueued.
+        self._buckets = []
+        self._parameter_buckets = {}
+        self._bucket_ready = []
+        self._bucket_handles = {}
+        # The flat buffers of the contiguous gradients, and the view of every
+        # parameter's gradient into them.
+        self._contiguous_buffers = []
+        self._contiguous_grads = {}
+        # Ids of the C++ hooks that allreduce the gradients of the parameters.
+        self._native_gradient_hooks = native_gradient_hooks
+        self._native_hooks = {}
+        # Float64 scalars the squared norms of the gradients reduced on every
+        # device are added to, and the norm of the last synchronize().
+        self._fused_grad_norm = fused_grad_norm
+        self._norm_sqrds = {}
+        self._grad_norm = None
+        # Float32 flags set when a gradient reduced on a device overflows, and
+        # the flag of the last synchronize().
+        self._fused_found_inf = fused_found_inf
+        self._found_infs = {}
+        self._found_inf = None
+        # Parameters updated on the GPU right after the allreduce of their
+        # gradient, which step() skips.
+        self._fused_step = fused_step
+        self._fused_step_params = set()
+        self._parameter_groups = {}
         if size() > 1 or os.environ.get('HOROVOD_ELASTIC') == '1':
             self._register_hooks()
+            if contiguous_gradients or gradient_bucket_bytes > 0:
+                self._allocate_contiguous_gradients(gradient_bucket_bytes)
+            if register_parameters:
+                self._register_parameters()
+
+    def __del__(self):
+        for hook in getattr(self, '_native_hooks', {}).values():
+            _remove_grad_hook(hook)
 
     def load_state_dict(self, *args, **kwargs):
         self._handles = {}
+        self._bucket_handles = {}
+        self._reset_native_hooks()
+        for ready in self._bucket_ready:
+            ready.clear()
         self._synchronized = False
         self._should_synchronize = True
         for p in self._allreduce_delay:
             self._allreduce_delay[p] = self.backward_passes_per_step
+        for norm_sqrd in self._norm_sqrds.values():
+            norm_sqrd.zero_()
+        for found_inf in self._found_infs.values():
+            found_inf.zero_()
+        self._fused_step_params.clear()
         super(self.__class__, self).load_state_dict(*args, **kwargs)
 
     @staticmethod
@@ -99,6 +167,13 @@ class _DistributedOptimizer(torch.optim.Optimizer):
         self.backward_passes_per_step = passes
         for p in self._allreduce_delay:
             self._allreduce_delay[p] = self.backward_passes_per_step
+        self._reset_native_hooks()
+
+    def _reset_native_hooks(self):
+        for p, hook in self._native_hooks.items():
+            handle = _take_grad_hook_handle(hook, p.grad, self.backward_passes_per_step)
+            if handle is not None:
+                synchronize(handle)
 
     def _register_hooks(self):
         for param_group in self.param_groups:
@@ -106,30 +181,300 @@ class _DistributedOptimizer(torch.optim.Optimizer):
                 if p.requires_grad:
                     p.grad = p.data.new(p.size()).zero_()
                     self._requires_update.add(p)
+                    if self._native_gradient_hooks:
+                        prescale_factor, postscale_factor = self._scale_factors()
+                        self._native_hooks[p] = _register_grad_hook(
+                            p, self._parameter_names.get(p), self.op,
+                            prescale_factor, postscale_factor,
+                            self._parameter_priorities.get(p, 0),
+                            self.backward_passes_per_step)
+                        norm_sqrd, found_inf = self._norm_sqrd(p), self._found_inf_flag(p)
+                        if norm_sqrd is not None or found_inf is not None:
+                            _set_grad_hook_statistics(self._native_hooks[p], norm_sqrd,
+                                                      found_inf)
+                        continue
                     p_tmp = p.expand_as(p)
                     grad_acc = p_tmp.grad_fn.next_functions[0][0]
                     grad_acc.register_hook(self._make_hook(p))
                     self._grad_accs.append(grad_acc)
 
+    def _allocate_contiguous_gradients(self, bucket_bytes=0):
+        # Gradients usually become ready, and are fused, in the reverse order of
+        # the forward pass. Laying them out back to back in that order lets the
+        # backend reduce a fusion group in place instead of copying it into the
+        # fusion buffer and back.
+        buckets = {}
+        for param_group in reversed(self.param_groups):
+            for p in reversed(param_group['params']):
+                if p in self._requires_update:
+                    buckets.setdefault((p.device, p.dtype), []).append(p)
+        for params in buckets.values():
+            flat = params[0].data.new_zeros(sum(p.numel() for p in params))
+            self._contiguous_buffers.append(flat)
+            offset = 0
+            for p in params:
+                p.grad = flat[offset:offset + p.numel()].view_as(p)
+                self._contiguous_grads[p] = p.grad
+                offset += p.numel()
+            if bucket_bytes > 0:
+                self._split_gradient_buckets(flat, params, bucket_bytes)
+
+    def _split_gradient_buckets(self, flat, params, bucket_bytes):
+        # Consecutive gradients of the flat buffer are grouped into buckets of
+        # at most bucket_bytes, a larger gradient making a bucket of its own.
+        element_size = flat.element_size()
+        start = 0
+        offset = 0
+        bucket_params = []
+        for p in params:
+            if bucket_params and (offset + p.numel() - start) * element_size > bucket_bytes:
+                self._add_gradient_bucket(flat[start:offset], bucket_params)
+                start = offset
+                bucket_params = []
+            bucket_params.append(p)
+            offset += p.numel()
+        if bucket_params:
+            self._add_gradient_bucket(flat[start:offset], bucket_params)
+
+    def _add_gradient_bucket(self, bucket, params):
+        index = len(self._buckets)
+        self._buckets.append((bucket, params))
+        self._bucket_ready.append(set())
+        for p in params:
+            self._parameter_buckets[p] = index
+
+    def _register_parameters(self):
+        # Allreduce the zero gradients once, so that every gradient is in the
+        # response cache of all ranks before the first step and its readiness
+        # is decided by the cache bit allreduce alone.
+        handles = [self._allreduce_grad_async(p)[0]
+                   for p in sorted(self._requires_update - set(self._parameter_buckets),
+                                   key=lambda p: self._parameter_names[p])]
+        handles += [self._allreduce_bucket_async(index)[0]
+                    for index in range(len(self._buckets))]
+        flush_fusion_groups()
+        for handle in handles:
+            self._synchronize_handle(handle)
+
     def _allreduce_grad_async(self, p):
         name = self._parameter_names.get(p)
         tensor = p.grad
-        tensor_compressed, ctx = self._compression.compress(tensor)
+        if tensor.is_sparse:
+            # Sparse gradients, e.g. of embeddings, are exchanged as their rows.
+            return sparse_allreduce_async(tensor, name=name, op=self.op), None
+        if getattr(self._compression, 'scattered', False):
+            return self._alltoall_grad_async(name, tensor)
+        if getattr(self._compression, 'gathered', False):
+            return self._allgather_grad_async(name, tensor)
+        if getattr(self._compression, 'low_rank', False):
+            tensor_compressed, ctx = self._compression.compress(tensor, name)
+        else:
+            tensor_compressed, ctx = self._compression.compress(tensor)
+        return self._allreduce_async(p, tensor_compressed, name), ctx
 
+    def _scale_factors(self):
         if self.op == Average:
            # Split average operation across pre/postscale factors
            # C++ backend will apply additional 1 / size() factor to postscale_factor for op == Average.
-            prescale_factor = 1.0 / self.gradient_predivide_factor
-            postscale_factor = self.gradient_predivide_factor
-        else:
-            prescale_factor = 1.0
-            postscale_factor = 1.0
+            return 1.0 / self.gradient_predivide_factor, self.gradient_predivide_factor
+        return 1.0, 1.0
+
+    def _allreduce_async(self, p, tensor, name):
+        prescale_factor, postscale_factor = self._scale_factors()
+        step = self._fused_step_arguments(p, tensor)
+        if step is not None:
+            self._fused_step_params.add(p)
+            return _allreduce_step_async(tensor, name, self.op, prescale_factor, postscale_factor,
+                                         self._parameter_priorities.get(p, 0), p.detach(), *step)
+        return allreduce_async_(tensor, name=name, op=self.op,
+                                prescale_factor=prescale_factor,
+                                postscale_factor=postscale_factor,
+                                priority=self._parameter_priorities.get(p, 0),
+                                norm_sqrd=self._norm_sqrd(tensor),
+                                found_inf=self._found_inf_flag(tensor))
+
+    def _param_group(self, p):
+        if p not in self._parameter_groups:
+            self._parameter_groups = {v: group for group in self.param_groups
+                                      for v in group['params']}
+        return self._parameter_groups[p]
+
+    def _fused_step_arguments(self, p, tensor):
+        # The states, kind and hyperparameters of the step of p that runs after
+        # the allreduce of its gradient tensor, None if step() updates p. The
+        # states are created and the step counted like the PyTorch optimizers.
+        if (not self._fused_step or tensor.dtype != p.dtype or
+                not _optimizer_step_supported(tensor)):
+            return None
+        group = self._param_group(p)
+        if (group.get('maximize', False) or group.get('amsgrad', False) or
+                group.get('capturable', False)):
+            return None
+        state = self.state[p]
+        lr, weight_decay = float(group['lr']), group['weight_decay']
+        if isinstance(self, (torch.optim.Adam, torch.optim.AdamW)):
+            if 'step' not in state:
+                state['step'] = torch.zeros(()) if _TENSOR_ADAM_STEP else 0
+                state['exp_avg'] = torch.zeros_like(p, memory_format=torch.preserve_format)
+                state['exp_avg_sq'] = torch.zeros_like(p, memory_format=torch.preserve_format)
+            if torch.is_tensor(state['step']):
+                state['step'] += 1
+            else:
+                state['step'] = state['step'] + 1
+            beta1, beta2 = group['betas']
+            decoupled = (isinstance(self, torch.optim.AdamW) or
+                         group.get('decoupled_weight_decay', False))
+            return ([state['exp_avg'], state['exp_avg_sq']], _OPTIMIZER_STEP_ADAM,
+                    [lr, weight_decay, beta1, beta2, group['eps'], int(state['step']),
+                     decoupled])
+        momentum = group['momentum']
+        states = []
+        first_step = False
+        if momentum != 0:
+            if state.get('momentum_buffer') is None:
+                state['momentum_buffer'] = torch.zeros_like(
+                    p, memory_format=torch.preserve_format)
+                first_step = True
+            states.append(state['momentum_buffer'])
+        return (states, _OPTIMIZER_STEP_SGD,
+                [lr, weight_decay, momentum, group['dampening'], group['nesterov'], first_step])
+
+    def _norm_sqrd(self, tensor):
+        # The squared norm the allreduce of the tensor adds its own to, None if
+        # it is not added up on the GPU.
+        if not self._fused_grad_norm or not _fused_statistics_supported(tensor):
+            return None
+        if tensor.device not in self._norm_sqrds:
+            self._norm_sqrds[tensor.device] = torch.zeros(
+                (), dtype=torch.float64, device=tensor.device)
+        return self._norm_sqrds[tensor.device]
+
+    def _found_inf_flag(self, tensor):
+        # The flag the allreduce of the tensor sets if it overflows, None if it
+        # is not looked for on the GPU.
+        if not self._fused_found_inf or not _fused_statistics_supported(tensor):
+            return None
+        if tensor.device not in self._found_infs:
+            self._found_infs[tensor.device] = torch.zeros(
+                (), dtype=torch.float32, device=tensor.device)
+        return self._found_infs[tensor.device]
+
+    def _reduced_grad_norm(self):
+        # The norms of the gradients reduced on the GPU were added up while they
+        # were copied out of the fusion buffer, the others are computed here.
+        norm_sqrds = list(self._norm_sqrds.values())
+        for param_group in self.param_groups:
+            for p in param_group['params']:
+                if p.grad is not None and (p not in self._requires_update or
+                                           not _fused_statistics_supported(p.grad)):
+                    norm_sqrds.append(p.grad.detach().double().pow(2).sum())
+        if not norm_sqrds:
+            return None
+        device = norm_sqrds[0].device
+        grad_norm = torch.stack([n.to(device) for n in norm_sqrds]).sum().sqrt()
+        for norm_sqrd in self._norm_sqrds.values():
+            norm_sqrd.zero_()
+        return grad_norm
+
+    def grad_norm(self):
+        """
+        Returns the L2 norm of all gradients after the last ``synchronize()``, as a
+        float64 tensor. Requires ``fused_grad_norm=True``.
+        """
+        if not self._fused_grad_norm:
+            raise ValueError('grad_norm() requires DistributedOptimizer(fused_grad_norm=True)')
+        return self._grad_norm
 
-        handle = allreduce_async_(tensor_compressed, name=name, op=self.op,
-                                  prescale_factor=prescale_factor,
-                                  postscale_factor=postscale_factor)
+    def _reduced_found_inf(self):
+        # Like _reduced_grad_norm, for the overflow flags.
+        found_infs = list(self._found_infs.values())
+        for param_group in self.param_groups:
+            for p in param_group['params']:
+                if p.grad is not None and (p not in self._requires_update or
+                                           not _fused_statistics_supported(p.grad)):
+                    found_infs.append((~torch.isfinite(p.grad.detach())).any().float())
+        if not found_infs:
+            return None
+        device = found_infs[0].device
+        found_inf = torch.stack([f.to(device) for f in found_infs]).max()
+        for flag in self._found_infs.values():
+            flag.zero_()
+        return found_inf
+
+    def found_inf(self):
+        """
+        Returns a float32 tensor that is 1 if a gradient had an inf or a NaN after the
+        last ``synchronize()``, and 0 otherwise. Requires ``fused_found_inf=True``.
+        """
+        if not self._fused_found_inf:
+            raise ValueError('found_inf() requires DistributedOptimizer(fused_found_inf=True)')
+        return self._found_inf
+
+    def _allreduce_second_factors(self, outputs):
+        # The first factors of all low-rank gradients have been reduced
+        # together, the second ones computed from them are reduced together
+        # as well.
+        handles = {}
+        for p, (_, ctx) in list(self._handles.items()):
+            tensor, ctx = self._compression.compress_second(outputs[p], ctx)
+            self._handles[p] = (None, ctx)
+            if tensor is not None:
+                handles[p] = self._allreduce_async(
+                    p, tensor, self._parameter_names.get(p) + '.second')
+        flush_fusion_groups()
+        for p, handle in handles.items():
+            outputs[p] = synchronize(handle)
+
+    def _allreduce_bucket_async(self, index):
+        bucket, params = self._buckets[index]
+        tensor_compressed, ctx = self._compression.compress(bucket)
+        # The bucket takes the priority of its gradient of the first layer.
+        return self._allreduce_async(params[-1], tensor_compressed,
+                                     'allreduce.bucket.%d' % index), ctx
+
+    def _bucket_gradient_ready(self, p):
+        index = self._parameter_buckets[p]
+        ready = self._bucket_ready[index]
+        ready.add(p)
+        if len(ready) == len(self._buckets[index][1]):
+            self._bucket_handles[index] = self._allreduce_bucket_async(index)
+
+    def _allgather_grad_async(self, name, tensor):
+        # The compressed tensors of every rank are gathered, and added up by
+        # decompress().
+        tensors, ctx = self._compression.compress(tensor, name)
+        handle = tuple(allgather_async(t, name='%s.%d' % (name, i))
+                       for i, t in enumerate(tensors))
+        return handle, ctx
+
+    def _alltoall_grad_async(self, name, tensor):
+        # Every rank receives the compressed copies of its shard from all
+        # ranks, their sum is allgathered by _allgather_shards().
+        tensors, ctx = self._compression.compress(tensor, name, size(), rank())
+        handle = tuple(alltoall_async(t, name='%s.%d' % (name, i))
+                       for i, t in enumerate(tensors))
         return handle, ctx
 
+    def _allgather_shards(self, outputs):
+        # The shards of all scattered gradients have been exchanged together,
+        # their sums are allgathered together as well.
+        for p, (_, ctx) in list(self._handles.items()):
+            if torch.is_tensor(outputs[p]) and outputs[p].is_sparse:
+                continue
+            tensors, ctx = self._compression.compress_second(outputs[p], ctx)
+            name = self._parameter_names.get(p)
+            self._handles[p] = (tuple(allgather_async(t, name='%s.shard.%d' % (name, i))
+                                      for i, t in enumerate(tensors)), ctx)
+        flush_fusion_groups()
+        for p, (handle, _) in self._handles.items():
+            if isinstance(handle, tuple):
+                outputs[p] = self._synchronize_handle(handle)
+
+    def _synchronize_handle(self, handle):
+        if isinstance(handle, tuple):
+            return tuple(synchronize(h) for h in handle)
+        return synchronize(handle)
+
     def _make_hook(self, p):
         def hook(*ignore):
             if p in self._handles and self._handles[p][0] is not None:
@@ -143,27 +488,76 @@ class _DistributedOptimizer(torch.optim.Optimizer):
             assert self._allreduce_delay[p] > 0
             handle, ctx = None, None
             self._allreduce_delay[p] -= 1
+            if p in self._parameter_buckets:
+                # The whole bucket is enqueued once all its gradients are ready.
+                if self._allreduce_delay[p] == 0:
+                    self._bucket_gradient_ready(p)
+                return
             if self._allreduce_delay[p] == 0:
                 handle, ctx = self._allreduce_grad_async(p)
             self._handles[p] = (handle, ctx)
         return hook
 
     def synchronize(self):
-        missing_p = self._requires_update - set(self._handles.keys())
+        # Gradients whose hook did not enqueue them are allreduced below, like
+        # the ones missing from the Python hooks.
+        for p, hook in self._native_hooks.items():
+            handle = _take_grad_hook_handle(hook, p.grad, self.backward_passes_per_step)
+            if handle is not None:
+                self._handles[p] = (handle, None)
+
+        missing_p = self._requires_update - set(self._handles.keys()) - \
+            set(self._parameter_buckets)
         for p in missing_p:
             handle, ctx = self._allreduce_grad_async(p)
             self._handles[p] = (handle, ctx)
+        for index in range(len(self._buckets)):
+            if index not in self._bucket_handles:
+                self._bucket_handles[index] = self._allreduce_bucket_async(index)
 
         for p, (handle, ctx) in self._handles.items():
             if handle is None:
                 handle, ctx = self._allreduce_grad_async(p)
                 self._handles[p] = (handle, ctx)
+        # All gradients of this step have been submitted.
+        flush_fusion_groups()
+        outputs = {p: self._synchronize_handle(handle)
+                   for p, (handle, _) in self._handles.items()}
+        if getattr(self._compression, 'low_rank', False):
+            self._allreduce_second_factors(outputs)
+        if getattr(self._compression, 'scattered', False):
+            self._allgather_shards(outputs)
         for p, (handle, ctx) in self._handles.items():
-            output = synchronize(handle)
             self._allreduce_delay[p] = self.backward_passes_per_step
-            p.grad.set_(self._compression.decompress(output, ctx))
+            if torch.is_tensor(outputs[p]) and outputs[p].is_sparse:
+                p.grad = outputs[p]
+                continue
+            grad = self._compression.decompress(outputs[p], ctx)
+            if isinstance(handle, tuple) and self.op == Average:
+                # The gradients of all ranks were added up.
+                grad.div_(size())
+            if p in self._contiguous_grads and grad.data_ptr() != p.grad.data_ptr():
+                # Keep the gradient in its buffer, where the next passes
+                # accumulate and the next allreduce finds it in place.
+                p.grad.copy_(grad)
+            else:
+                p.grad.set_(grad)
         self._handles.clear()
 
+        for index, (handle, ctx) in self._bucket_handles.items():
+            bucket, params = self._buckets[index]
+            output = self._compression.decompress(synchronize(handle), ctx)
+            if output.data_ptr() != bucket.data_ptr():
+                bucket.copy_(output)
+            for p in params:
+                self._allreduce_delay[p] = self.backward_passes_per_step
+            self._bucket_ready[index].clear()
+        self._bucket_handles.clear()
+
+        if self._fused_grad_norm:
+            self._grad_norm = self._reduced_grad_norm()
+        if self._fused_found_inf:
+            self._found_inf = self._reduced_found_inf()
         self._synchronized = True
 
     @contextmanager
@@ -197,14 +591,38 @@ class _DistributedOptimizer(torch.optim.Optimizer):
                               "optimizer.synchronize() in your code.")
             self.synchronize()
         self._synchronized = False
-        return super(self.__class__, self).step(closure)
+        if self._fused_step_params:
+            # The parameters updated after their allreduce are left out.
+            all_params = [group['params'] for group in self.param_groups]
+            for group in self.param_groups:
+                group['params'] = [p for p in group['params']
+                                   if p not in self._fused_step_params]
+            try:
+                loss = super(self.__class__, self).step(closure)
+            finally:
+                for group, params in zip(self.param_groups, all_params):
+                    group['params'] = params
+                self._fused_step_params.clear()
+        else:
+            loss = super(self.__class__, self).step(closure)
+        step_completed()
+        return loss
 
-    def zero_grad(self):
-        if self._handles:
+    def zero_grad(self, *args, **kwargs):
+        if self._handles or any(self._bucket_ready):
             raise AssertionError("optimizer.zero_grad() was called after loss.backward() "
                                  "but before optimizer.step() or optimizer.synchronize(). "
                                  "This is prohibited as it can cause a race condition.")
-        return super(self.__class__, self).zero_grad()
+        if self._contiguous_buffers:
+            # One fill per buffer, and the gradients stay views into it
+            # instead of being set to None.
+            for flat in self._contiguous_buffers:
+                flat.zero_()
+            for p, grad in self._contiguous_grads.items():
+                if p.grad is None or p.grad.data_ptr() != grad.data_ptr():
+                    p.grad = grad
+            return
+        return super(self.__class__, self).zero_grad(*args, **kwargs)
 
 
 class _DistributedAdasumOptimizer(torch.optim.Optimizer):
@@ -368,6 +786,7 @@ class _DistributedAdasumOptimizer(torch.optim.Optimizer):
             p.data.copy_(start)
             self._allreduce_delay[p] = self.backward_passes_per_step
         self._handles.clear()
+        step_completed()
         return loss
 
     def zero_grad(self):
@@ -382,7 +801,14 @@ def DistributedOptimizer(optimizer, named_parameters=None,
                          compression=Compression.none,
                          backward_passes_per_step=1,
                          op=Average,
-                         gradient_predivide_factor=1.0):
+                         gradient_predivide_factor=1.0,
+                         register_parameters=False,
+                         contiguous_gradients=False,
+                         gradient_bucket_bytes=0,
+                         native_gradient_hooks=False,
+                         fused_grad_norm=False,
+                         fused_found_inf=False,
+                         fused_step=False):
     """
     An optimizer that wraps another torch.optim.Optimizer, using an allreduce to
     combine gradient values before applying gradients to model weights.
@@ -409,13 +835,50 @@ def DistributedOptimizer(optimizer, named_parameters=None,
         with optimizer.skip_synchronize():
             optimizer.step()
 
+    With ``fused_grad_norm=True``, the norm of the gradients comes from the allreduces
+    instead of another pass over them:
+
+    .. code-block:: python
+
+        optimizer.synchronize()
+        clip_coef = args.clip / (optimizer.grad_norm() + 1e-6)
+        if clip_coef < 1:
+            for p in model.parameters():
+                p.grad.mul_(clip_coef)
+        with optimizer.skip_synchronize():
+            optimizer.step()
+
+    With ``fused_found_inf=True``, a loss scaler can skip the steps whose gradients
+    overflowed without looking for infs and NaNs itself:
+
+    .. code-block:: python
+
+        (loss * loss_scale).backward()
+        optimizer.synchronize()
+        if optimizer.found_inf().item():
+            loss_scale /= 2
+            optimizer.zero_grad()
+        else:
+            for p in model.parameters():
+                p.grad.div_(loss_scale)
+            with optimizer.skip_synchronize():
+                optimizer.step()
+
     Arguments:
         optimizer: Optimizer to use for computing gradients and applying updates.
         named_parameters: A mapping between parameter names and values. Used for naming of
                           allreduce operations. Typically just ``model.named_parameters()``.
         compression: Compression algorithm used during allreduce to reduce the amount
                      of data sent during the each parameter update step.  Defaults to
-                     not using compression.
+                     not using compression. ``Compression.topk(ratio)`` and
+                     ``Compression.randomk(ratio)`` allgather a ratio of the entries of
+                     every gradient instead of allreducing it, and keep the others for
+                     the next steps. ``Compression.powersgd(rank)`` allreduces two
+                     low-rank factors of every matrix gradient, and
+                     ``Compression.onebit(chunk_size)`` sends the signs of every
+                     gradient with a scale per chunk, ``Compression.fp8(format)`` its
+                     8-bit float values, reducing them in shards exchanged with an
+                     alltoall and an allgather. Not supported with op == Adasum.
         backward_passes_per_step: Number of expected backward passes to perform
                                   before calling step()/synchronize(). This
                                   allows accumulating gradients over multiple
@@ -425,6 +888,48 @@ def DistributedOptimizer(optimizer, named_parameters=None,
                                    before and after the sum. Gradients are scaled by
                                    1.0 / gradient_predivide_factor before the sum and
                                    gradient_predivide_factor / size after the sum.
+        register_parameters: If True, negotiates the allreduce of every gradient once at
+                             construction, so that the first steps do not go through the
+                             coordinator. Requires a maximum response cache capacity of at
+                             least the number of parameters. Not supported with op == Adasum.
+        contiguous_gradients: If True, allocates the gradients of the parameters with the same
+                              device and type from one contiguous buffer, in the reverse order
+                              of the parameters. Fusion groups of gradients that lie back to
+                              back are reduced in place, without copies into the fusion buffer.
+                              ``zero_grad()`` zeroes the buffers in place instead of setting the
+                              gradients to None, so with backward_passes_per_step > 1 every pass
+                              accumulates into them and the last one reduces them where they
+                              are. Not supported with op == Adasum.
+        gradient_bucket_bytes: If positive, lays out the gradients like contiguous_gradients
+                               and splits them into buckets of at most this many bytes. A
+                               bucket is enqueued as one tensor once all its gradients are
+                               ready, so it is negotiated and reduced without copies into the
+                               fusion buffer. Buckets of the fusion threshold fill a fusion
+                               group each. Not supported with op == Adasum, or with
+                               compression that is not an allreduce of the cast gradients.
+        native_gradient_hooks: If True, the allreduce of every gradient is enqueued by a C++
+                               autograd hook on the autograd thread, without acquiring the
+                               GIL, instead of a Python hook. Only supported without
+                               compression, with gradient_bucket_bytes == 0 and with
+                               op != Adasum.
+        fused_grad_norm: If True, ``grad_norm()`` returns the L2 norm of the gradients after
+                         ``synchronize()``. The squared norms of the gradients reduced on the
+                         GPU are added up by the kernels that copy them out of the fusion
+                         buffer, the others are computed in ``synchronize()``. Not supported
+                         with op == Adasum, or with gathered or low-rank compression.
+        fused_found_inf: If True, ``found_inf()`` returns 1 after ``synchronize()`` if a
+                         gradient has an inf or a NaN, like ``fused_grad_norm`` the kernels
+                         that copy the gradients out of the fusion buffer look for them.
+                         Not supported with op == Adasum, or with gathered or low-rank
+                         compression.
+        fused_step: If True, the parameters of CUDA gradients are updated on the GPU stream
+                    of their allreduce right after it, so that the update of a fusion group
+                    overlaps the allreduces of the next groups, and ``step()`` only updates
+                    the others. Only supported with ``torch.optim.SGD``, ``torch.optim.Adam``
+                    and ``torch.optim.AdamW`` without ``amsgrad`` or ``maximize``, without
+                    compression, gradient_bucket_bytes, register_parameters,
+                    native_gradient_hooks, fused_grad_norm, fused_found_inf and with
+                    op != Adasum. The gradients cannot be modified before ``step()``.
     """
     # We dynamically create a new class that inherits from the optimizer that was passed in.
     # The goal is to override the `step()` method with an allreduce implementation.
@@ -434,11 +939,43 @@ def DistributedOptimizer(optimizer, named_parameters=None,
         if op != Average:
             raise ValueError('gradient_predivide_factor not supported with op != Average')
 
+    if op == Adasum and (getattr(compression, 'gathered', False) or
+                         getattr(compression, 'low_rank', False)):
+        raise ValueError('Gathered and low-rank compression not supported with op == Adasum')
+
+    if gradient_bucket_bytes > 0 and (getattr(compression, 'gathered', False) or
+                                      getattr(compression, 'low_rank', False)):
+        raise ValueError('Gathered and low-rank compression not supported with '
+                         'gradient_bucket_bytes')
+
+    if (fused_grad_norm or fused_found_inf) and (op == Adasum or
+                                                 getattr(compression, 'gathered', False) or
+                                                 getattr(compression, 'low_rank', False)):
+        raise ValueError('fused_grad_norm and fused_found_inf not supported with op == Adasum, '
+                         'or with gathered and low-rank compression')
+
+    if fused_step and (not isinstance(optimizer, (torch.optim.SGD, torch.optim.Adam,
+                                                  torch.optim.AdamW)) or
+                       compression is not Compression.none or gradient_bucket_bytes > 0 or
+                       register_parameters or native_gradient_hooks or fused_grad_norm or
+                       fused_found_inf or op == Adasum):
+        raise ValueError('fused_step only supported with torch.optim.SGD, Adam and AdamW, '
+                         'without compression, gradient_bucket_bytes, register_parameters, '
+                         'native_gradient_hooks, fused_grad_norm, fused_found_inf or '
+                         'op == Adasum')
+
+    if native_gradient_hooks and (compression is not Compression.none or
+                                  gradient_bucket_bytes > 0 or op == Adasum):
+        raise ValueError('native_gradient_hooks only supported without compression, '
+                         'gradient_bucket_bytes or op == Adasum')
+
     if op != Adasum or size() == 1:
         cls = type(optimizer.__class__.__name__, (optimizer.__class__,),
                    dict(_DistributedOptimizer.__dict__))
         return cls(optimizer.param_groups, named_parameters, compression, backward_passes_per_step, op,
-                   gradient_predivide_factor)
+                   gradient_predivide_factor, register_parameters, contiguous_gradients,
+                   gradient_bucket_bytes, native_gradient_hooks, fused_grad_norm,
+                   fused_found_inf, fused_step)
     else:
         cls = type(optimizer.__class__.__name__, (optimizer.__class__,),
                    dict(_DistributedAdasumOptimizer.__dict__))
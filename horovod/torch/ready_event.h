@@ -35,6 +35,7 @@ public:
   TorchReadyEvent(int device);
   ~TorchReadyEvent();
   virtual bool Ready() const override;
+  virtual gpuEvent_t event() const override;
 
 private:
   int device_ = CPU_DEVICE_ID;
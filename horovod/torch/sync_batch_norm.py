@@ -14,7 +14,7 @@
 # limitations under the License.
 # ==============================================================================
 
-from horovod.torch.mpi_ops import allgather_async, allreduce_async, Sum, size, synchronize
+from horovod.torch.mpi_ops import allreduce_async, Sum, size, synchronize
 
 from distutils.version import LooseVersion
 
@@ -101,25 +101,33 @@ class _SyncBatchNorm(Function):
         input = input.contiguous()
 
         size = input.numel() // input.size(1)
-        count = torch.tensor([size])
 
         # calculate mean/invstd for input.
         mean, invstd = torch.batch_norm_stats(input, eps)
 
-        count_handle = allgather_async(count.unsqueeze(0), name='sync_batch_norm.count')
-        mean_handle = allgather_async(mean.unsqueeze(0), name='sync_batch_norm.mean')
-        invstd_handle = allgather_async(invstd.unsqueeze(0), name='sync_batch_norm.invstd')
-
-        # wait on the async communication to finish
-        count_all = synchronize(count_handle)
-        mean_all = synchronize(mean_handle)
-        invstd_all = synchronize(invstd_handle)
+        # The count, sums and sums of squares of every worker are added up in
+        # float64 by one allreduce, whose size does not grow with the number of
+        # workers, and merged into the mean and variance of the whole batch like
+        # the parallel variant of Welford's algorithm.
+        mean64 = mean.double()
+        sqr_mean64 = invstd.double().pow(-2) - eps + mean64 * mean64
+        stats = torch.cat([mean64.new_full((1,), size), mean64 * size, sqr_mean64 * size])
+        stats = synchronize(allreduce_async(stats, op=Sum, name='sync_batch_norm.stats'))
+        count_all, sums, sqr_sums = stats[:1], stats[1:1 + mean.numel()], stats[1 + mean.numel():]
+        mean64 = sums / count_all
+        var64 = (sqr_sums / count_all - mean64 * mean64).clamp_(min=0)
+
+        # The batch of all workers is passed on as the statistics of a single
+        # one.
+        mean_all = mean64.to(mean.dtype).unsqueeze(0)
+        invstd_all = (var64 + eps).rsqrt().to(invstd.dtype).unsqueeze(0)
+        count_all = count_all.unsqueeze(0)
 
         if _SYNC_BN_V3:
             counts_for_bngswc = count_all.view(-1).float().to(input.device)
         else:
             # backwards compatibility
-            counts_for_bngswc = count_all.view(-1).tolist()
+            counts_for_bngswc = [int(c) for c in count_all.view(-1).tolist()]
 
         # calculate global mean & invstd
         mean, invstd = torch.batch_norm_gather_stats_with_counts(
@@ -157,13 +165,11 @@ class _SyncBatchNorm(Function):
         )
 
         if need_input_grad:
-            # synchronizing stats used to calculate input gradient.
-            sum_dy_handle = allreduce_async(sum_dy, op=Sum, name='sync_batch_norm.sum_dy')
-            sum_dy_xmu_handle = allreduce_async(sum_dy_xmu, op=Sum, name='sync_batch_norm.sum_dy_xmu')
-
-            # wait on the async communication to finish
-            sum_dy = synchronize(sum_dy_handle)
-            sum_dy_xmu = synchronize(sum_dy_xmu_handle)
+            # synchronizing stats used to calculate input gradient, in one
+            # allreduce.
+            sum_dys = torch.cat([sum_dy, sum_dy_xmu])
+            sum_dys = synchronize(allreduce_async(sum_dys, op=Sum, name='sync_batch_norm.sum_dys'))
+            sum_dy, sum_dy_xmu = torch.split(sum_dys, sum_dy.numel())
 
             if _SYNC_BN_V2 or _SYNC_BN_V3:
                 count_all_sum = count_all.sum()
@@ -1288,10 +1288,12 @@ class SparkTests(unittest.TestCase):
     def test_prepare_data_no_compression(self):
         util.clear_training_cache()
 
+        # Converting vectors row by row in Python infers float columns as doubles,
+        # vector_to_array keeps their type.
         expected_metadata = \
             {
                 'float': {
-                    'spark_data_type': DoubleType,
+                    'spark_data_type': FloatType if util.vector_to_array else DoubleType,
                     'is_sparse_vector_only': False,
                     'intermediate_format': constants.NOCHANGE,
                     'max_size': None,
@@ -1321,7 +1323,9 @@ class SparkTests(unittest.TestCase):
             }
 
         with mock.patch('horovod.spark.common.util._get_metadata',
-                        side_effect=util._get_metadata) as mock_get_metadata:
+                        side_effect=util._get_metadata) as mock_get_metadata, \
+                mock.patch('horovod.spark.common.util.to_petastorm_fn',
+                           side_effect=util.to_petastorm_fn) as mock_to_petastorm_fn:
             with spark_session('test_prepare_data') as spark:
                 data = [[
                     0.0,
@@ -1351,6 +1355,8 @@ class SparkTests(unittest.TestCase):
                                            feature_columns=['dense', 'sparse', 'mixed'],
                                            label_columns=['float']) as dataset_idx:
                         mock_get_metadata.assert_not_called()
+                        if util.vector_to_array:
+                            mock_to_petastorm_fn.assert_not_called()
                         assert dataset_idx == 0
 
                         train_rows, val_rows, metadata, avg_row_size = util.get_dataset_properties(dataset_idx)
@@ -1525,6 +1531,56 @@ class SparkTests(unittest.TestCase):
             sync_to_store(local_dir)
             assert mock_fs.upload.call_count == 5
 
+    @mock.patch('horovod.spark.common.store.HDFSStore._get_filesystem_fn')
+    def test_sync_hdfs_store_async_upload(self, mock_get_fs_fn):
+        uploaded = {}
+        mock_fs = mock.Mock()
+        mock_fs.upload.side_effect = lambda path, f: uploaded.update({path: f.read()})
+        mock_get_fs_fn.return_value = lambda: mock_fs
+
+        hdfs_root = '/user/test/output_async'
+        store = HDFSStore(hdfs_root, async_upload=True)
+
+        run_id = 'run_001'
+        get_local_output_dir = store.get_local_output_dir_fn(run_id)
+        sync_to_store = store.sync_fn(run_id)
+        wait_for_sync = store.wait_for_sync_fn(run_id)
+        run_root = store.get_run_path(run_id)
+
+        with get_local_output_dir() as local_dir:
+            ckpt_path = os.path.join(local_dir, 'checkpoint.pt')
+            with open(ckpt_path, 'wb') as f:
+                f.write(b'epoch 0')
+            os.utime(ckpt_path, (1330712280, 1330712280))
+            sync_to_store(local_dir)
+
+            # The staged copy is uploaded, not the file written after the sync.
+            with open(ckpt_path, 'wb') as f:
+                f.write(b'epoch 1')
+            wait_for_sync()
+            assert uploaded == {os.path.join(run_root, 'checkpoint.pt'): b'epoch 0'}
+
+            os.utime(ckpt_path, (1330712292, 1330712292))
+            sync_to_store(local_dir)
+            wait_for_sync()
+            assert uploaded == {os.path.join(run_root, 'checkpoint.pt'): b'epoch 1'}
+
+            mock_fs.upload.side_effect = IOError('upload failed')
+            os.utime(ckpt_path, (1330712300, 1330712300))
+            sync_to_store(local_dir)
+            with pytest.raises(IOError):
+                wait_for_sync()
+
+    @mock.patch('horovod.spark.common.store._READ_PART_BYTES', 10)
+    def test_local_store_parallel_read(self):
+        with tempdir() as d:
+            store = LocalStore(d, read_parallelism=3)
+            path = os.path.join(d, 'data.bin')
+            data = bytes(range(256)) * 3
+            with open(path, 'wb') as f:
+                f.write(data)
+            assert store.read(path) == data
+
     @mock.patch('horovod.spark.common.store.HDFSStore._get_filesystem_fn')
     def test_hdfs_store_parse_url(self, mock_get_filesystem_fn):
         # Case 1: full path
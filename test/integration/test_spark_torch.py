@@ -211,6 +211,28 @@ class SparkTorchTests(unittest.TestCase):
         assert int(shuffle_size) == \
                int(constants.TOTAL_BUFFER_MEMORY_CAP_GIB * constants.BYTES_PER_GIB / avg_row_size / 5)
 
+    def test_prefetch(self):
+        prefetch = remote._prefetch_fn()
+        prepare_batch = lambda row: ([row * 2], [row], None)
+        rows = [torch.tensor([i]) for i in range(10)]
+
+        for num_batches in [0, 1, 3]:
+            batches = list(prefetch(iter(rows), prepare_batch, num_batches, False))
+            assert len(batches) == len(rows)
+            for i, (inputs, labels, sample_weights) in enumerate(batches):
+                assert inputs[0].item() == 2 * i
+                assert labels[0].item() == i
+                assert sample_weights is None
+
+        def failing_rows():
+            yield torch.tensor([0])
+            raise ValueError('read failed')
+
+        batches = prefetch(failing_rows(), prepare_batch, 2, False)
+        assert next(batches)[1][0].item() == 0
+        with self.assertRaises(ValueError):
+            next(batches)
+
     def test_metric_class(self):
         hvd_mock = mock.MagicMock()
         hvd_mock.allreduce = lambda tensor, name: 2 * tensor
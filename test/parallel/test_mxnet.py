@@ -154,6 +154,43 @@ class MXTests(unittest.TestCase):
             assert almost_equal(tensor.asnumpy(), multiplied.asnumpy(), atol=threshold), \
                 f'hvd.allreduce produces incorrect results for self: {hvd.rank()} {count} {dtype} {dim}'
 
+    def test_horovod_grouped_allreduce(self):
+        """Test that the grouped allreduce correctly sums lists of 1D, 2D, 3D tensors."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types(['int32',   'int64',
+                                              'float32', 'float64'])
+        dims = [1, 2, 3]
+        ctx = self._current_context()
+        count = 0
+        shapes = [(), (17), (17, 17), (17, 17, 17)]
+        for dtype, dim in itertools.product(dtypes, dims):
+            mx.random.seed(1234, ctx=ctx)
+            tensors = [mx.nd.random.uniform(-100, 100, shape=shapes[dim],
+                                            ctx=ctx).astype(dtype) for _ in range(5)]
+            multiplied = [tensor * size for tensor in tensors]
+            summed = hvd.grouped_allreduce(tensors, average=False, name=str(count))
+            inplace = [tensor.copy() for tensor in tensors]
+            hvd.grouped_allreduce_(inplace, average=False, name=str(count) + '.inplace')
+            count += 1
+
+            # Threshold for floating point equality depends on number of
+            # ranks, since we're comparing against precise multiplication.
+            if size <= 3 or dtype in ['int32', 'int64']:
+                threshold = 0
+            elif size < 10:
+                threshold = 1e-4
+            elif size < 15:
+                threshold = 5e-4
+            else:
+                break
+
+            for s, i, m in zip(summed, inplace, multiplied):
+                assert almost_equal(s.asnumpy(), m.asnumpy(), atol=threshold), \
+                    f'hvd.grouped_allreduce produces incorrect results for self: {hvd.rank()} {count} {dtype} {dim}'
+                assert almost_equal(i.asnumpy(), m.asnumpy(), atol=threshold), \
+                    f'hvd.grouped_allreduce_ produces incorrect results for self: {hvd.rank()} {count} {dtype} {dim}'
+
     def test_horovod_allreduce_prescale(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors with prescaling."""
         hvd.init()
@@ -188,6 +188,55 @@ class TensorFlowTests(tf.test.TestCase):
             diff = self.evaluate(max_difference)
             self.assertTrue(diff <= threshold, "hvd.allreduce produces incorrect results")
 
+    def test_horovod_grouped_allreduce_cpu(self):
+        """Test on CPU that the grouped allreduce correctly sums 1D, 2D, 3D tensors."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([tf.int32, tf.int64, tf.float16, tf.float32, tf.float64])
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            with tf.device("/cpu:0"):
+                tensors = [self.random_uniform(
+                    [17] * dim, -100, 100, dtype=dtype) for _ in range(5)]
+                summed = hvd.grouped_allreduce(tensors, average=False)
+            multiplied = [tensor * size for tensor in tensors]
+            max_difference = tf.reduce_max([tf.reduce_max(tf.abs(t1 - t2))
+                                            for t1, t2 in zip(summed, multiplied)])
+
+            # Threshold for floating point equality depends on number of
+            # ranks, since we're comparing against precise multiplication.
+            if size <= 3 or dtype in [tf.int32, tf.int64]:
+                threshold = 0
+            elif size < 10:
+                threshold = 1e-4
+            elif size < 15:
+                threshold = 5e-4
+            else:
+                self.skipTest("Horovod cluster too large for precise multiplication comparison")
+
+            diff = self.evaluate(max_difference)
+            self.assertTrue(diff <= threshold, "hvd.grouped_allreduce produces incorrect results")
+
+    def test_horovod_allreduce_indexed_slices_cpu(self):
+        """Test on CPU that the allreduce of tf.IndexedSlices sends the rows of
+        duplicate indices once and represents the summed tensor."""
+        hvd.init()
+        size = hvd.size()
+        with tf.device("/cpu:0"):
+            # Every rank looks up row 1 three times and row 3 once.
+            slices = tf.IndexedSlices(tf.ones([4, 2]), tf.constant([1, 3, 1, 1]),
+                                      dense_shape=tf.constant([5, 2]))
+            reduced = hvd.allreduce(slices, op=hvd.Sum)
+        indices, values = self.evaluate([reduced.indices, reduced.values])
+        self.assertEqual(len(indices), 2 * size)
+        dense = np.zeros([5, 2], dtype=np.float32)
+        np.add.at(dense, indices, values)
+        expected = np.zeros([5, 2], dtype=np.float32)
+        expected[1] = 3 * size
+        expected[3] = size
+        self.assertTrue(np.array_equal(dense, expected),
+                        "hvd.allreduce produces incorrect results for tf.IndexedSlices")
+
     def test_horovod_allreduce_average_cpu(self):
         """Test on CPU that the allreduce correctly sums 1D, 2D, 3D tensors."""
         hvd.init()
@@ -369,6 +418,52 @@ class TensorFlowTests(tf.test.TestCase):
             diff = self.evaluate(max_difference)
             self.assertTrue(diff <= threshold, "hvd.allreduce on GPU produces incorrect results")
 
+    def test_horovod_allreduce_gpu_xla(self):
+        """Test that the allreduce works on GPUs in XLA clusters."""
+        # Only do this test if there are GPUs available.
+        if not tf.test.is_gpu_available(cuda_only=True):
+            self.skipTest(("No GPUs available"))
+
+        if not int(os.environ.get('HOROVOD_ENABLE_XLA_OPS', 0)):
+            self.skipTest("Not compiled with HOROVOD_ENABLE_XLA_OPS")
+
+        if LooseVersion(tf.__version__) < LooseVersion('2.6.0'):
+            self.skipTest("XLA allreduces require TensorFlow 2.6 or newer")
+
+        hvd.init()
+        local_rank = hvd.local_rank()
+        size = hvd.size()
+
+        @tf.function(jit_compile=True)
+        def scaled_allreduce(tensor):
+            # Work on both sides of the allreduce is compiled into its cluster.
+            return hvd.allreduce(tensor * 2, op=hvd.Sum) + 1
+
+        dtypes = [tf.int32, tf.int64, tf.float16, tf.float32, tf.float64]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            with tf.device("/gpu:%d" % local_rank):
+                tensor = self.random_uniform(
+                    [17] * dim, -100, 100, dtype=dtype)
+                summed = scaled_allreduce(tensor)
+            expected = tensor * 2 * size + 1
+            max_difference = tf.reduce_max(tf.abs(tf.cast(summed, tf.float64) -
+                                                  tf.cast(expected, tf.float64)))
+
+            # Threshold for floating point equality depends on number of
+            # ranks, since we're comparing against precise multiplication.
+            if size <= 3 or dtype in [tf.int32, tf.int64]:
+                threshold = 0
+            elif size < 10:
+                threshold = 1e-4
+            elif size < 15:
+                threshold = 5e-4
+            else:
+                self.skipTest("Horovod cluster too large for precise multiplication comparison")
+
+            diff = self.evaluate(max_difference)
+            self.assertTrue(diff <= threshold, "hvd.allreduce in XLA produces incorrect results")
+
     def test_horovod_allreduce_average_gpu(self):
         """Test that the allreduce with average works on GPUs."""
         # Only do this test if there are GPUs available.
@@ -2396,6 +2491,26 @@ class TensorFlowTests(tf.test.TestCase):
             err = np.linalg.norm(expected - actual)
             self.assertLess(err, 0.00000001)
 
+    def test_broadcast_variables(self):
+        hvd.init()
+
+        with tf.device("/cpu:0"):
+            v = float(hvd.rank() + 1)
+            variables = [tf.Variable(np.full((2, 3), v, dtype=np.float32)),
+                         tf.Variable(np.full((4,), v, dtype=np.float64)),
+                         tf.Variable(np.full((3, 1), v, dtype=np.float32)),
+                         tf.Variable(np.full((), v, dtype=np.float32))]
+            if not hvd._executing_eagerly():
+                self.evaluate(tf.compat.v1.global_variables_initializer())
+
+            bcast = hvd.broadcast_variables(variables, root_rank=0)
+            if not hvd._executing_eagerly():
+                self.evaluate(bcast)
+
+            for var, value in zip(variables, self.evaluate(variables)):
+                self.assertEqual(value.shape, tuple(var.shape.as_list()))
+                self.assertAllClose(value, np.ones_like(value))
+
     def test_broadcast_object(self):
         hvd.init()
 
@@ -17,6 +17,7 @@
 
 from distutils.version import LooseVersion
 
+import contextlib
 import inspect
 import itertools
 import os
@@ -24,6 +25,7 @@ import platform
 import unittest
 import warnings
 import time
+import threading
 import json
 
 from collections.abc import Iterable
@@ -75,6 +77,30 @@ class TorchTests(unittest.TestCase):
            types = [t for t in types if t in ccl_supported_types]
         return types
 
+    @contextlib.contextmanager
+    def horovod_env(self, env):
+        """Re-initializes Horovod with the variables of env set, and with the
+        previous environment afterwards."""
+        gloo_rank = int(os.getenv('HOROVOD_RANK', -1))
+        if gloo_rank == -1:
+            # Horovod cannot be re-initialized after shutdown when using MPI.
+            self.skipTest("Gloo is not available")
+
+        old = {key: os.environ.get(key) for key in env}
+        hvd.shutdown()
+        os.environ.update(env)
+        hvd.init()
+        try:
+            yield
+        finally:
+            hvd.shutdown()
+            for key, value in old.items():
+                if value is None:
+                    del os.environ[key]
+                else:
+                    os.environ[key] = value
+            hvd.init()
+
     def test_horovod_reinit(self):
         """Test that Horovod can init -> shutdown -> init successfully."""
         mpi_rank, _ = mpi_env_rank_and_size()
@@ -205,6 +231,28 @@ class TorchTests(unittest.TestCase):
 
             assert torch.allclose(averaged, tensor, threshold), 'hvd.allreduce produces incorrect results'
 
+    def test_horovod_allreduce_bfloat16(self):
+        """Test that the allreduce correctly sums and averages bfloat16 tensors."""
+        if 'CCL_ROOT' in os.environ:
+            self.skipTest("bfloat16 is not supported with oneCCL")
+        hvd.init()
+        size = hvd.size()
+        if size > 25:
+            self.skipTest("Sums are not exact in bfloat16 beyond 25 ranks")
+        dims = [1, 2, 3]
+        for dim in dims:
+            torch.manual_seed(1234)
+            # Small integers, so that the sums are exact in bfloat16.
+            tensor = torch.FloatTensor(*([17] * dim)).random_(-10, 10)
+            tensor = tensor.type(torch.BFloat16Tensor)
+            summed = hvd.allreduce(tensor, average=False, name='bf16_sum_%d' % dim)
+            averaged = hvd.allreduce(tensor, average=True, name='bf16_avg_%d' % dim)
+            assert summed.dtype == torch.bfloat16
+            assert torch.equal(summed.float(), tensor.float() * size), \
+                'hvd.allreduce produces incorrect results for bfloat16'
+            assert torch.equal(averaged.float(), tensor.float()), \
+                'hvd.allreduce produces incorrect averages for bfloat16'
+
     def test_horovod_allreduce_inplace(self):
         """Test that the allreduce correctly sums 1D, 2D, 3D tensors."""
         hvd.init()
@@ -284,6 +332,385 @@ class TorchTests(unittest.TestCase):
 
             assert torch.allclose(summed, multiplied, threshold), 'hvd.allreduce produces incorrect results'
 
+    def test_horovod_allreduce_threads(self):
+        """Test that allreduces submitted concurrently from several threads,
+        and in a different order on every rank, are all correct."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+        num_threads = 4
+        num_tensors = 32
+        errors = []
+
+        def submit(thread):
+            try:
+                tests = []
+                # Every rank submits in a different order, so that the
+                # messages of a name reach the tensor table at different times.
+                order = list(range(num_tensors))
+                order = order[rank % num_tensors:] + order[:rank % num_tensors]
+                for i in order:
+                    tensor = torch.FloatTensor(16 + i).fill_(rank + thread * num_tensors + i)
+                    handle = hvd.allreduce_async(
+                        tensor, op=hvd.Sum, name='test_allreduce_threads.%d.%d' % (thread, i))
+                    expected = size * (size - 1) / 2 + size * (thread * num_tensors + i)
+                    tests.append((expected, handle))
+                for expected, handle in tests:
+                    summed = hvd.synchronize(handle)
+                    if summed.min() != expected or summed.max() != expected:
+                        errors.append('%s != %s' % (summed[0].item(), expected))
+            except Exception as e:
+                errors.append(str(e))
+
+        threads = [threading.Thread(target=submit, args=(thread,)) for thread in range(num_threads)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        assert not errors, 'hvd.allreduce from several threads failed: %s' % errors[:5]
+
+    def test_horovod_allreduce_inline(self):
+        """Test that small cached CPU allreduces reduced inline with the cache
+        coordination are correct, next to the ones that do not fit."""
+        with self.horovod_env({'HOROVOD_INLINE_ALLREDUCE_BYTES': '128'}):
+            rank = hvd.rank()
+            size = hvd.size()
+            cases = [(torch.IntTensor, hvd.Sum), (torch.FloatTensor, hvd.Sum),
+                     (torch.FloatTensor, hvd.Average), (torch.DoubleTensor, hvd.Sum),
+                     (torch.DoubleTensor, hvd.Average)]
+            # From the second step on the tensors are in the response cache, the
+            # first ones fit into the inline bytes and the last ones do not.
+            for step in range(4):
+                tests = []
+                for i, (dtype, op) in enumerate(cases):
+                    tensor = torch.FloatTensor(4).fill_(rank + i + step).type(dtype)
+                    if op == hvd.Sum:
+                        expected = torch.FloatTensor(4).fill_(size * (size - 1) / 2 + size * (i + step))
+                    else:
+                        expected = torch.FloatTensor(4).fill_((size - 1) / 2 + i + step)
+                    handle = hvd.allreduce_async(tensor, op=op, name='test_allreduce_inline.%d' % i)
+                    tests.append((dtype, expected, handle))
+                large = torch.ones(1024)
+                tests.append((torch.FloatTensor, large * size,
+                              hvd.allreduce_async(large, op=hvd.Sum, name='test_allreduce_inline.large')))
+
+                for dtype, expected, handle in tests:
+                    result = hvd.synchronize(handle)
+                    assert result.type() == dtype().type()
+                    if dtype == torch.IntTensor:
+                        expected = expected.type(dtype)
+                        assert torch.equal(result, expected), \
+                            'hvd.allreduce produces incorrect results in step %d' % step
+                    else:
+                        assert torch.allclose(result.float(), expected, 1e-6), \
+                            'hvd.allreduce produces incorrect results in step %d' % step
+
+    def test_horovod_allreduce_hierarchical_cpu(self):
+        """Test that the shared memory hierarchical allreduce sums CPU tensors
+        of sizes that do not split evenly over the local ranks, alone and
+        fused."""
+        if os.environ.get('HOROVOD_HIERARCHICAL_ALLREDUCE') != '1':
+            # The shared memory window is only used with MPI, which cannot be
+            # re-initialized with the variable set.
+            self.skipTest("HOROVOD_HIERARCHICAL_ALLREDUCE is not set")
+
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.IntTensor, torch.LongTensor,
+                  torch.FloatTensor, torch.DoubleTensor, torch.HalfTensor])
+        sizes = [1, 7, 1000, 65537]
+
+        def make(dtype, n):
+            # Small integers, so that the sums are exact in float16.
+            tensor = (torch.arange(n) % 8 + rank).float()
+            expected = (torch.arange(n) % 8).float() * size + size * (size - 1) / 2
+            return tensor.type(dtype), expected
+
+        for dtype, n in itertools.product(dtypes, sizes):
+            tensor, expected = make(dtype, n)
+            summed = hvd.allreduce(tensor, op=hvd.Sum,
+                                   name='test_allreduce_hierarchical_cpu.%s.%d' % (dtype.__name__, n))
+            assert torch.equal(summed.float(), expected), \
+                'hierarchical hvd.allreduce produces incorrect results'
+
+        tests = []
+        for dtype, n in itertools.product(dtypes, sizes):
+            tensor, expected = make(dtype, n)
+            handle = hvd.allreduce_async(
+                tensor, op=hvd.Sum, name='test_allreduce_hierarchical_cpu.fused.%s.%d' % (dtype.__name__, n))
+            tests.append((expected, handle))
+        for expected, handle in tests:
+            summed = hvd.synchronize(handle)
+            assert torch.equal(summed.float(), expected), \
+                'fused hierarchical hvd.allreduce produces incorrect results'
+
+    def test_horovod_flush_fusion_groups(self):
+        """Test that flushing fusion groups completes a partially filled group,
+        and does not affect the pending allreduces."""
+        # Five tensors in a group of eight, without the flush timeout only the
+        # flush completes them.
+        with self.horovod_env({'FUSION_SIZE': '8', 'CPU_FUSION_SIZE': '8',
+                               'HOROVOD_FUSION_GROUP_FLUSH_TIMEOUT': '0'}):
+            size = hvd.size()
+            device = 'cuda:%d' % hvd.local_rank() if torch.cuda.is_available() else 'cpu'
+            for step in range(2):
+                tests = []
+                for i in range(5):
+                    tensor = torch.FloatTensor(*([17] * 2)).random_(-100, 100).to(device)
+                    handle = hvd.allreduce_async(tensor, average=False,
+                                                 name='test_flush_fusion_groups.%d' % i)
+                    tests.append((tensor * size, handle))
+                hvd.flush_fusion_groups()
+
+                for multiplied, handle in tests:
+                    summed = hvd.synchronize(handle)
+                    threshold = 0 if size <= 3 else 1e-4
+                    assert torch.allclose(summed, multiplied, threshold), \
+                        'hvd.allreduce produces incorrect results in step %d' % step
+
+            # Flushing without pending allreduces is a no-op.
+            hvd.flush_fusion_groups()
+
+    def test_horovod_cpu_fusion_groups(self):
+        """Test that CPU allreduces are fused into groups of their own, next to
+        the GPU groups, and that a timed out CPU group restarts at the first."""
+        with self.horovod_env({'FUSION_SIZE': '2,2', 'CPU_FUSION_SIZE': '3,1',
+                               'HOROVOD_FUSION_GROUP_FLUSH_TIMEOUT': '50'}):
+            size = hvd.size()
+            devices = ['cpu']
+            if torch.cuda.is_available():
+                devices.append('cuda:%d' % hvd.local_rank())
+            for step in range(3):
+                tests = []
+                # Two tensors for the first CPU group, left for the timeout.
+                for i, device in itertools.product(range(2), devices):
+                    tensor = torch.FloatTensor(17, 17).random_(-100, 100).to(device)
+                    handle = hvd.allreduce_async(
+                        tensor, average=False,
+                        name='test_cpu_fusion_groups.%s.%d' % (device, i))
+                    tests.append((tensor * size, handle))
+                for multiplied, handle in tests:
+                    summed = hvd.synchronize(handle)
+                    threshold = 0 if size <= 3 else 1e-4
+                    assert torch.allclose(summed, multiplied, threshold), \
+                        'hvd.allreduce produces incorrect results in step %d' % step
+
+    def test_horovod_libra_split_groups(self):
+        """Test that fusion groups split into two allreduces on two streams
+        sum correctly, next to a group that is not split."""
+        # Only do this test if there are GPUs available.
+        if not torch.cuda.is_available():
+            self.skipTest("No GPUs available")
+
+        with self.horovod_env({'FUSION_SIZE': '4,4', 'FUSION_BLOCK_NUM': '8,4',
+                               'FUSION_THREAD_NUM': '256,256',
+                               'HOROVOD_LIBRA_SPLIT_BLOCK_NUM': '4,0'}):
+            rank = hvd.rank()
+            size = hvd.size()
+            device = 'cuda:%d' % hvd.local_rank()
+            # Odd sizes, so that the elements do not divide evenly between the
+            # parts of the split group.
+            sizes = [1, 1023, 4097, 17, 255, 3, 65537, 9]
+            for step in range(4):
+                tests = []
+                for i, n in enumerate(sizes):
+                    tensor = torch.arange(n, dtype=torch.float32, device=device) % 16 + rank + step
+                    expected = (torch.arange(n, dtype=torch.float32, device=device) % 16 + step) * size + \
+                        size * (size - 1) / 2
+                    handle = hvd.allreduce_async(tensor, op=hvd.Sum, name='test_libra_split_groups.%d' % i)
+                    tests.append((expected, handle))
+                for expected, handle in tests:
+                    summed = hvd.synchronize(handle)
+                    assert torch.equal(summed, expected), \
+                        'split hvd.allreduce produces incorrect results in step %d' % step
+
+    def test_horovod_libra_plan_cached(self):
+        """Test that the fusion groups of cached steps, which every rank fuses
+        with the broadcast plan, sum correctly, also when a new tensor joins
+        the step."""
+        # Only do this test if there are GPUs available.
+        if not torch.cuda.is_available():
+            self.skipTest("No GPUs available")
+
+        with self.horovod_env({'FUSION_SIZE': '3,5', 'FUSION_BLOCK_NUM': '4,8',
+                               'FUSION_THREAD_NUM': '256,512'}):
+            rank = hvd.rank()
+            size = hvd.size()
+            device = 'cuda:%d' % hvd.local_rank()
+            for step in range(8):
+                # From the second step on the responses come from the cache,
+                # the step with the extra tensor goes through communication.
+                num_tensors = 9 if step == 4 else 8
+                tests = []
+                for i in range(num_tensors):
+                    tensor = torch.FloatTensor(100 + i).fill_(rank + i + step).to(device)
+                    expected = size * (size - 1) / 2 + size * (i + step)
+                    handle = hvd.allreduce_async(tensor, op=hvd.Sum, name='test_libra_plan_cached.%d' % i)
+                    tests.append((expected, handle))
+                for expected, handle in tests:
+                    summed = hvd.synchronize(handle)
+                    assert summed.min() == expected and summed.max() == expected, \
+                        'hvd.allreduce produces incorrect results in step %d' % step
+
+    def test_horovod_release_fusion_buffers(self):
+        """Test that fusion buffers are freed on request and allocated again."""
+        hvd.init()
+        size = hvd.size()
+
+        def allreduce_fused(prefix):
+            handles = [hvd.allreduce_async(torch.ones(17, 17), average=False,
+                                           name='%s.%d' % (prefix, i))
+                       for i in range(5)]
+            for handle in handles:
+                summed = hvd.synchronize(handle)
+                assert torch.equal(summed, torch.ones(17, 17) * size)
+
+        allreduce_fused('test_release_fusion_buffers.before')
+        assert hvd.fusion_buffer_bytes() >= 0
+
+        hvd.release_fusion_buffers()
+        for _ in range(100):
+            if hvd.fusion_buffer_bytes() == 0:
+                break
+            time.sleep(0.1)
+        assert hvd.fusion_buffer_bytes() == 0
+
+        allreduce_fused('test_release_fusion_buffers.after')
+
+    def test_horovod_release_fusion_buffers_pending(self):
+        """Test that releasing the fusion buffers while fused allreduces are
+        pending leaves them correct, and that the next fused allreduces
+        allocate the buffers again."""
+        hvd.init()
+        size = hvd.size()
+        devices = ['cpu']
+        if torch.cuda.is_available():
+            devices.append('cuda:%d' % hvd.local_rank())
+
+        for step in range(3):
+            tests = []
+            for device, i in itertools.product(devices, range(5)):
+                tensor = torch.FloatTensor(17, 17).random_(-100, 100).to(device)
+                handle = hvd.allreduce_async(
+                    tensor, average=False,
+                    name='test_release_fusion_buffers_pending.%s.%d' % (device, i))
+                tests.append((tensor * size, handle))
+            hvd.release_fusion_buffers()
+
+            for multiplied, handle in tests:
+                summed = hvd.synchronize(handle)
+                threshold = 0 if size <= 3 else 1e-4
+                assert torch.allclose(summed, multiplied, threshold), \
+                    'hvd.allreduce produces incorrect results after releasing the fusion buffers'
+
+        # The tensors of a round may be negotiated in different cycles and not
+        # be fused, so give them a few rounds, the same on all ranks.
+        for _ in range(10):
+            handles = [hvd.allreduce_async(torch.ones(17, 17), average=False,
+                                           name='test_release_fusion_buffers_pending.after.%d' % i)
+                       for i in range(5)]
+            for handle in handles:
+                hvd.synchronize(handle)
+        assert hvd.fusion_buffer_bytes() > 0, 'fused allreduces do not allocate the fusion buffers again'
+
+    def test_horovod_cache_file(self):
+        """Test that the response cache saved to HOROVOD_CACHE_FILE is loaded
+        when Horovod is initialized again, and that the allreduces after the
+        restart are correct."""
+        with temppath() as path:
+            env = {'HOROVOD_CACHE_FILE': path}
+
+            def allreduce_steps(prefix, steps):
+                size = hvd.size()
+                for _ in range(steps):
+                    for i in range(5):
+                        tensor = torch.FloatTensor(17, 17).random_(-100, 100)
+                        summed = hvd.allreduce(tensor, average=False, name='%s.%d' % (prefix, i))
+                        threshold = 0 if size <= 3 else 1e-4
+                        assert torch.allclose(summed, tensor * size, threshold), \
+                            'hvd.allreduce produces incorrect results'
+
+            rank_path = None
+            try:
+                with self.horovod_env(env):
+                    rank_path = '%s.%d' % (path, hvd.rank())
+                    allreduce_steps('test_cache_file', 3)
+                    # The cache is saved once it did not change for a cycle.
+                    for _ in range(100):
+                        if os.path.exists(rank_path):
+                            break
+                        time.sleep(0.1)
+                    assert os.path.exists(rank_path), 'the response cache was not saved'
+
+                with self.horovod_env(env):
+                    allreduce_steps('test_cache_file', 2)
+                    # Tensors that are not in the loaded cache are negotiated.
+                    allreduce_steps('test_cache_file.new', 2)
+            finally:
+                if rank_path is not None and os.path.exists(rank_path):
+                    os.remove(rank_path)
+
+    def test_horovod_step_completed(self):
+        """Test that recording completed steps does not affect allreduces."""
+        hvd.init()
+        size = hvd.size()
+        for i in range(3):
+            tensor = torch.FloatTensor(*([17] * 2)).random_(-100, 100)
+            summed = hvd.allreduce(tensor, average=False, name='test_step_completed')
+            hvd.step_completed()
+            threshold = 0 if size <= 3 else 1e-4
+            assert torch.allclose(summed, tensor * size, threshold), 'hvd.allreduce produces incorrect results'
+
+    def test_horovod_get_overlap_stats(self):
+        """Test that the overlap stats record the allreduces of this rank."""
+        hvd.init()
+        tensor = torch.FloatTensor(*([17] * 2)).random_(-100, 100)
+        hvd.allreduce(tensor, name='test_get_overlap_stats')
+
+        steps = hvd.get_overlap_stats()
+        assert isinstance(steps, list)
+        if not os.environ.get('HOROVOD_OVERLAP_STATS_STEPS'):
+            assert steps == [], 'overlap stats are recorded when disabled'
+            return
+
+        records = [record for step in steps for record in step
+                   if record['tensor_name'] == 'allreduce.test_get_overlap_stats']
+        assert len(records) > 0, 'allreduce is missing from overlap stats'
+        record = records[-1]
+        assert 0 < record['ready'] <= record['negotiated'] <= \
+            record['comm_start'] <= record['comm_end']
+
+    def test_horovod_get_metrics(self):
+        """Test that the metrics count the cycles of the background thread."""
+        hvd.init()
+        tensor = torch.FloatTensor(*([17] * 2)).random_(-100, 100)
+        hvd.allreduce(tensor, name='test_get_metrics')
+
+        metrics = {}
+        for line in hvd.get_metrics().splitlines():
+            if line and not line.startswith('#'):
+                name, value = line.rsplit(' ', 1)
+                metrics[name] = float(value)
+        assert metrics['horovod_cycle_time_seconds_count'] > 0
+        assert metrics['horovod_fused_response_bytes_count'] > 0
+        assert metrics['horovod_fused_response_bytes_sum'] >= 17 * 17 * 4
+        assert metrics['horovod_fused_response_bytes_bucket{le="+Inf"}'] == \
+            metrics['horovod_fused_response_bytes_count']
+
+    def test_horovod_get_straggler_scores(self):
+        """Test that the coordinator keeps a straggler score for every rank."""
+        hvd.init()
+        tensor = torch.FloatTensor(*([17] * 2)).random_(-100, 100)
+        hvd.allreduce(tensor, name='test_get_straggler_scores')
+
+        scores = hvd.get_straggler_scores()
+        if hvd.rank() != 0:
+            assert scores == [], 'straggler scores are returned on a worker rank'
+            return
+        assert len(scores) == hvd.size()
+        assert all(score >= 0 for score in scores)
+
     def test_horovod_allreduce_multi_gpu(self):
         """Test that the allreduce works on multiple GPUs."""
         # Only do this test if there are GPUs available.
@@ -545,6 +972,212 @@ class TorchTests(unittest.TestCase):
         except (torch.FatalError, ValueError):
             pass
 
+    def test_horovod_grouped_allreduce(self):
+        """Test that the grouped allreduce correctly sums lists of 1D, 2D, 3D tensors."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.IntTensor, torch.LongTensor,
+                     torch.FloatTensor, torch.DoubleTensor, torch.HalfTensor])
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.LongTensor,
+                       torch.cuda.FloatTensor, torch.cuda.DoubleTensor,
+                       torch.cuda.HalfTensor]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            torch.manual_seed(1234)
+            tensors = [torch.FloatTensor(*([17] * dim)).random_(-100, 100) for _ in range(5)]
+            tensors = [self.cast_and_place(tensor, dtype) for tensor in tensors]
+            summed = hvd.grouped_allreduce(tensors, average=False)
+            tensors, summed = zip(*[self.convert_cpu_fp16_to_fp32(t, s)
+                                    for t, s in zip(tensors, summed)])
+            multiplied = [tensor * size for tensor in tensors]
+
+            # Threshold for floating point equality depends on number of
+            # ranks, since we're comparing against precise multiplication.
+            if size <= 3 or dtype in [torch.IntTensor, torch.LongTensor,
+                                      torch.cuda.IntTensor, torch.cuda.LongTensor]:
+                threshold = 0
+            elif size < 10:
+                threshold = 1e-4
+            elif size < 15:
+                threshold = 5e-4
+            else:
+                break
+
+            assert all([torch.allclose(t1, t2, threshold) for t1, t2 in zip(summed, multiplied)]), \
+                'hvd.grouped_allreduce produces incorrect results'
+
+    def test_horovod_grouped_allreduce_inplace(self):
+        """Test that the in-place grouped allreduce correctly sums lists of 1D, 2D, 3D
+        tensors behind a single handle."""
+        hvd.init()
+        size = hvd.size()
+        dtypes = self.filter_supported_types([torch.IntTensor, torch.LongTensor,
+                     torch.FloatTensor, torch.DoubleTensor, torch.HalfTensor])
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.LongTensor,
+                       torch.cuda.FloatTensor, torch.cuda.DoubleTensor,
+                       torch.cuda.HalfTensor]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            torch.manual_seed(1234)
+            tensors = [torch.FloatTensor(*([17] * dim)).random_(-100, 100) for _ in range(5)]
+            multiplied = [self.cast_and_place(tensor * size, dtype) for tensor in tensors]
+            tensors = [self.cast_and_place(tensor, dtype) for tensor in tensors]
+            handle = hvd.grouped_allreduce_async_(tensors, average=False)
+            summed = hvd.synchronize(handle)
+            assert all([s is t for s, t in zip(summed, tensors)])
+            tensors, multiplied = zip(*[self.convert_cpu_fp16_to_fp32(t, m)
+                                        for t, m in zip(tensors, multiplied)])
+
+            # Threshold for floating point equality depends on number of
+            # ranks, since we're comparing against precise multiplication.
+            if size <= 3 or dtype in [torch.IntTensor, torch.LongTensor,
+                                      torch.cuda.IntTensor, torch.cuda.LongTensor]:
+                threshold = 0
+            elif size < 10:
+                threshold = 1e-4
+            elif size < 15:
+                threshold = 5e-4
+            else:
+                break
+
+            assert all([torch.allclose(t1, t2, threshold) for t1, t2 in zip(tensors, multiplied)]), \
+                'hvd.grouped_allreduce_ produces incorrect results'
+
+    def test_horovod_grouped_allreduce_grad(self):
+        """Test the correctness of the grouped allreduce gradient."""
+        hvd.init()
+        size = hvd.size()
+        # Only Tensors of floating point dtype can require gradients
+        dtypes = [torch.FloatTensor, torch.DoubleTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.FloatTensor, torch.cuda.DoubleTensor, torch.cuda.HalfTensor]
+        dims = [1, 2, 3]
+        for dtype, dim in itertools.product(dtypes, dims):
+            torch.manual_seed(1234)
+            tensors = [torch.FloatTensor(*([17] * dim)).random_(-100, 100) for _ in range(5)]
+            tensors = [self.cast_and_place(tensor, dtype) for tensor in tensors]
+            for tensor in tensors:
+                tensor.requires_grad_()
+            summed = hvd.grouped_allreduce(tensors, average=False)
+
+            torch.autograd.backward(summed, [self.cast_and_place(torch.ones([17] * dim), dtype)
+                                             for _ in summed])
+
+            expected = np.ones([17] * dim) * size
+            for tensor in tensors:
+                grad_out = tensor.grad.data.cpu().numpy()
+                err = np.linalg.norm(expected - grad_out)
+                self.assertLess(err, 0.00000001,
+                                "gradient %s differs from expected %s, "
+                                "error: %s" % (grad_out, expected, str(err)))
+
+    def test_horovod_process_set_allreduce(self):
+        """Test that the allreduce of a process set sums and averages over the ranks of
+        the set only. Runs with HOROVOD_PROCESS_SETS set, e.g. to "0,1;2,3", where
+        every rank is in a set."""
+        hvd.init()
+        if hvd.process_set_size(1) <= 0:
+            self.skipTest("HOROVOD_PROCESS_SETS is not set")
+        process_set = next((process_set for process_set in range(1, hvd.size() + 1)
+                            if hvd.process_set_rank(process_set) >= 0), None)
+        if process_set is None:
+            self.skipTest("This rank is in no process set")
+        set_size = hvd.process_set_size(process_set)
+        set_rank = hvd.process_set_rank(process_set)
+        dtypes = [torch.IntTensor, torch.FloatTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.FloatTensor]
+        for dtype in dtypes:
+            tensor = self.cast_and_place(torch.ones(17, 17) * (1 + set_rank), dtype)
+            summed = hvd.allreduce(tensor, op=hvd.Sum, name='process_set_sum',
+                                   process_set=process_set)
+            expected = torch.ones(17, 17) * (set_size * (set_size + 1) // 2)
+            assert torch.equal(summed.float().cpu(), expected), \
+                'hvd.allreduce of a process set produces incorrect results'
+
+            tensor = self.cast_and_place(torch.ones(5) * set_size, dtype)
+            averaged = hvd.allreduce(tensor, op=hvd.Average, name='process_set_average',
+                                     process_set=process_set)
+            assert torch.allclose(averaged.float().cpu(), torch.ones(5) * set_size), \
+                'hvd.allreduce of a process set averages over the wrong number of ranks'
+
+    def test_horovod_sparse_allreduce(self):
+        """Test that the sparse allreduce sums and averages the rows of sparse tensors,
+        and of the sparse gradients of an embedding in the optimizer."""
+        hvd.init()
+        size = hvd.size()
+        rank = hvd.rank()
+        devices = ['cpu']
+        if torch.cuda.is_available():
+            devices += ['cuda']
+        for device in devices:
+            # Every rank touches row 1 twice and a row of its own.
+            indices = torch.LongTensor([[1, rank + 2, 1]])
+            values = torch.ones(3, 4)
+            tensor = torch.sparse_coo_tensor(indices, values, (size + 2, 4)).to(device)
+            expected = torch.zeros(size + 2, 4)
+            expected[1] = 2 * size
+            expected[2:] = 1
+
+            summed = hvd.sparse_allreduce(tensor, name='sparse_sum', op=hvd.Sum)
+            assert summed.is_sparse
+            assert summed._nnz() == size + 1
+            assert torch.equal(summed.to_dense().cpu(), expected), \
+                'hvd.sparse_allreduce produces incorrect results'
+
+            averaged = hvd.sparse_allreduce(tensor, name='sparse_average', dense=True)
+            assert not averaged.is_sparse
+            assert torch.allclose(averaged.cpu(), expected / size), \
+                'hvd.sparse_allreduce produces incorrect results'
+
+        embedding = torch.nn.Embedding(size + 2, 4, sparse=True)
+        torch.nn.init.zeros_(embedding.weight)
+        opt = hvd.DistributedOptimizer(torch.optim.SGD(embedding.parameters(), lr=1),
+                                       named_parameters=embedding.named_parameters())
+        opt.zero_grad()
+        embedding.weight.grad = None
+        (-embedding(torch.LongTensor([1, rank + 2, 1])).sum()).backward()
+        assert embedding.weight.grad.is_sparse
+        opt.step()
+        assert torch.allclose(embedding.weight.data, expected / size), \
+            'the optimizer averages sparse gradients incorrectly'
+
+    def test_horovod_sharded_embedding_lookup(self):
+        """Test that the sharded embedding lookup returns the rows of their owners, and
+        sends the gradients of every lookup back to them."""
+        hvd.init()
+        size = hvd.size()
+        rank = hvd.rank()
+        devices = ['cpu']
+        if torch.cuda.is_available():
+            devices += ['cuda']
+        num_rows = 4 * size
+        dim = 3
+        for device in devices:
+            # Row i of the table holds i in every column, the shard of a rank the rows
+            # it owns.
+            shard = torch.arange(rank, num_rows, size, dtype=torch.float32)
+            shard = shard.unsqueeze(1).repeat(1, dim).to(device).requires_grad_()
+            # Every rank looks up row 0 twice and the rows of its right neighbour.
+            ids = torch.LongTensor([[0, (rank + 1) % size], [size + (rank + 1) % size, 0]])
+            ids = ids.to(device)
+            vectors = hvd.sharded_embedding_lookup(shard, ids, name='embedding.%s' % device)
+            assert vectors.shape == (2, 2, dim)
+            assert torch.equal(vectors.cpu(), ids.cpu().float().unsqueeze(2).repeat(1, 1, dim)), \
+                'hvd.sharded_embedding_lookup returns incorrect rows'
+
+            vectors.sum().backward()
+            expected = torch.zeros(num_rows // size, dim)
+            if rank == 0:
+                expected[0] = 2 * size
+            # The left neighbour looked up rows rank and size + rank once each.
+            expected[0] += 1
+            expected[1] += 1
+            assert torch.equal(shard.grad.cpu(), expected), \
+                'hvd.sharded_embedding_lookup produces incorrect gradients'
+
     def test_horovod_allreduce_grad(self):
         """Test the correctness of the allreduce gradient."""
         hvd.init()
@@ -706,6 +1339,77 @@ class TorchTests(unittest.TestCase):
                 assert rank_tensor.data.min() == i, 'hvd.allgather produces incorrect gathered tensor'
                 assert rank_tensor.data.max() == i, 'hvd.allgather produces incorrect gathered tensor'
 
+    def test_horovod_allgather_arena(self):
+        """Test that named allgathers with a different number of rows every
+        step are correct with HOROVOD_ALLGATHER_ARENA_BYTES set, and that the
+        outputs kept from earlier steps are not overwritten."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        # The arena reads its budget on first use, so this only covers the
+        # arena if no named allgather ran before in this process.
+        old = os.environ.get('HOROVOD_ALLGATHER_ARENA_BYTES')
+        os.environ['HOROVOD_ALLGATHER_ARENA_BYTES'] = str(1 << 20)
+        try:
+            dtypes = [torch.FloatTensor, torch.IntTensor]
+            if torch.cuda.is_available():
+                dtypes += [torch.cuda.FloatTensor, torch.cuda.IntTensor]
+            step_rows = [3, 5, 4, 9, 2, 9, 1]
+            for dtype in dtypes:
+                kept = []
+                for step, rows in enumerate(step_rows):
+                    tensor = torch.FloatTensor(rows + rank, 5).fill_(rank * 100 + step)
+                    tensor = self.cast_and_place(tensor, dtype)
+                    gathered = hvd.allgather(tensor, name='test_allgather_arena.%s' % dtype.__name__)
+                    # Only every other output is kept, the others can be reused.
+                    if step % 2 == 0:
+                        kept.append((step, rows, gathered))
+
+                for step, rows, gathered in kept:
+                    gathered = gathered.float()
+                    assert list(gathered.shape) == [rows * size + sum(range(size)), 5]
+                    offset = 0
+                    for i in range(size):
+                        rank_tensor = gathered[offset:offset + rows + i]
+                        offset += rows + i
+                        assert rank_tensor.min() == i * 100 + step and \
+                            rank_tensor.max() == i * 100 + step, \
+                            'hvd.allgather overwrote an output kept from an earlier step'
+        finally:
+            if old is None:
+                del os.environ['HOROVOD_ALLGATHER_ARENA_BYTES']
+            else:
+                os.environ['HOROVOD_ALLGATHER_ARENA_BYTES'] = old
+
+    def test_horovod_allgather_hierarchical_gpu(self):
+        """Test that the two stage NCCL allgather gathers GPU tensors in rank
+        order, alone and fused."""
+        # Only do this test if there are GPUs available.
+        if not torch.cuda.is_available():
+            self.skipTest("No GPUs available")
+
+        with self.horovod_env({'HOROVOD_HIERARCHICAL_ALLGATHER': '1'}):
+            rank = hvd.rank()
+            size = hvd.size()
+            dtypes = [torch.cuda.IntTensor, torch.cuda.FloatTensor, torch.cuda.HalfTensor]
+            dims = [1, 2, 3]
+            tests = []
+            for dtype, dim in itertools.product(dtypes, dims):
+                tensor = torch.FloatTensor(*([17] * dim)).fill_(1).mul_(rank)
+                tensor = self.cast_and_place(tensor, dtype)
+                handle = hvd.allgather_async(
+                    tensor, name='test_allgather_hierarchical.%s.%d' % (dtype.__name__, dim))
+                tests.append((dim, handle))
+
+            for dim, handle in tests:
+                gathered = hvd.synchronize(handle).float()
+                assert list(gathered.shape) == [17 * size] + [17] * (dim - 1)
+                for i in range(size):
+                    rank_tensor = gathered[i * 17:(i + 1) * 17]
+                    assert rank_tensor.min() == i and rank_tensor.max() == i, \
+                        'hierarchical hvd.allgather produces incorrect gathered tensor'
+
     def test_horovod_allgather_error(self):
         """Test that the allgather returns an error if any dimension besides
         the first is different among the tensors being gathered."""
@@ -880,6 +1584,37 @@ class TorchTests(unittest.TestCase):
             assert (broadcasted_tensor == root_tensor).min() == 1, \
                 'hvd.broadcast produces incorrect broadcasted tensor'
 
+    def test_horovod_broadcast_fused(self):
+        """Test that broadcasts issued together, which are fused, broadcast
+        every tensor."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        # This test does not apply if there is only one worker.
+        if size == 1:
+            self.skipTest("Only one worker available")
+
+        dtypes = [torch.IntTensor, torch.FloatTensor, torch.DoubleTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.FloatTensor,
+                       torch.cuda.DoubleTensor]
+        root_ranks = list(range(size))
+        for dtype, root_rank in itertools.product(dtypes, root_ranks):
+            tensors = []
+            handles = []
+            for k in range(8):
+                tensor = torch.FloatTensor(*([k + 1] * 2)).fill_(k).add_(rank)
+                tensor = self.cast_and_place(tensor, dtype)
+                tensors.append(tensor)
+                handles.append(hvd.broadcast_async_(tensor, root_rank))
+            for k, (tensor, handle) in enumerate(zip(tensors, handles)):
+                hvd.synchronize(handle)
+                assert tensor.shape == (k + 1, k + 1), \
+                    'hvd.broadcast produces incorrect broadcasted shape'
+                assert (tensor == k + root_rank).min() == 1, \
+                    'hvd.broadcast produces incorrect broadcasted tensor'
+
     def test_horovod_broadcast_error(self):
         """Test that the broadcast returns an error if any dimension besides
         the first is different among the tensors being broadcasted."""
@@ -1071,6 +1806,43 @@ class TorchTests(unittest.TestCase):
             assert collected.data.max() == rank, 'hvd.alltoall produces incorrect collected tensor'
             assert collected.numel() == size * (size + 1) // 2 * 2**(dim - 1), 'hvd.alltoall collected wrong number of values'
 
+    def test_horovod_alltoall_fused(self):
+        """Test that alltoalls issued together, which are fused, distribute
+           every tensor with its own splits."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+
+        # This test does not apply if NCCL version < 2.7.0
+        if hvd.nccl_built() and hvd.nccl_built() < 2700:
+            self.skipTest("NCCL-based Alltoall requires NCCL version >= 2.7.0.")
+
+        dtypes = [torch.IntTensor, torch.FloatTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.FloatTensor]
+        for dtype in dtypes:
+            handles = []
+            for k in range(4):
+                # Tensor k sends k + rank + 1 rows with value of the peer to
+                # every peer.
+                vals = []
+                for i in range(size):
+                    vals += [i] * (k + rank + 1)
+                tensor = torch.Tensor(vals).unsqueeze(1)
+                tensor = torch.cat((tensor, tensor * 0 + k), dim=1)
+                tensor = self.cast_and_place(tensor, dtype)
+                splits = torch.tensor([k + rank + 1] * size, dtype=torch.int32)
+                handles.append(hvd.alltoall_async(
+                    tensor, splits, name='test_alltoall_fused_%d' % k))
+
+            for k, handle in enumerate(handles):
+                collected = hvd.synchronize(handle)
+                assert collected[:, 0].min() == rank, 'hvd.alltoall produces incorrect collected tensor'
+                assert collected[:, 0].max() == rank, 'hvd.alltoall produces incorrect collected tensor'
+                assert (collected[:, 1] == k).all(), 'hvd.alltoall mixes up fused tensors'
+                assert collected.shape[0] == sum(k + r + 1 for r in range(size)), \
+                    'hvd.alltoall collected wrong number of values'
+
     def test_horovod_alltoall_type_error(self):
         """Test that the alltoall returns an error if the tensor types differ
            across the processes."""
@@ -1261,6 +2033,68 @@ class TorchTests(unittest.TestCase):
                             "gradient %s differs from expected %s, "
                             "error: %s" % (grad_out, expected, str(err)))
 
+    def test_horovod_reducescatter(self):
+        """Test that reducescatters issued together, which are fused, sum and
+           split every tensor along its first dimension."""
+        hvd.init()
+        rank = hvd.rank()
+        size = hvd.size()
+        dtypes = [torch.IntTensor, torch.LongTensor, torch.FloatTensor, torch.DoubleTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.IntTensor, torch.cuda.LongTensor,
+                       torch.cuda.FloatTensor, torch.cuda.DoubleTensor]
+        for dtype, op in itertools.product(dtypes, [hvd.Sum, hvd.Average]):
+            handles = []
+            for k in range(4):
+                # Tensor k has k rows more than two per rank, so that some
+                # ranks receive one more row than the others.
+                dim_size = 2 * size + k
+                tensor = torch.ones(dim_size, 2) * (rank + 1)
+                tensor[:, 1] = torch.arange(dim_size)
+                tensor = self.cast_and_place(tensor, dtype)
+                handles.append(hvd.reducescatter_async(
+                    tensor, name='test_reducescatter_%d' % k, op=op))
+
+            for k, handle in enumerate(handles):
+                reduced = hvd.synchronize(handle).cpu()
+                dim_size = 2 * size + k
+                num_rows = dim_size // size + (1 if rank < dim_size % size else 0)
+                first_row = rank * (dim_size // size) + min(rank, dim_size % size)
+                total = size * (size + 1) // 2
+                expected = torch.ones(num_rows, 2) * total
+                expected[:, 1] = torch.arange(first_row, first_row + num_rows) * size
+                if op == hvd.Average:
+                    expected = expected / size
+                    if reduced.dtype in [torch.int32, torch.int64]:
+                        expected = expected.floor()
+                assert list(reduced.shape) == [num_rows, 2], \
+                    'hvd.reducescatter produces incorrect shape'
+                assert torch.allclose(reduced.double(), expected.double()), \
+                    'hvd.reducescatter produces incorrect reduced tensor'
+
+    def test_horovod_reducescatter_grad(self):
+        """Test the correctness of the reducescatter gradient."""
+        hvd.init()
+        size = hvd.size()
+
+        # Only Tensors of floating point dtype can require gradients
+        dtypes = [torch.FloatTensor, torch.DoubleTensor]
+        if torch.cuda.is_available():
+            dtypes += [torch.cuda.FloatTensor, torch.cuda.DoubleTensor]
+        for dtype in dtypes:
+            tensor = self.cast_and_place(torch.ones(2 * size + 1, 3), dtype)
+            tensor.requires_grad_()
+            reduced = hvd.reducescatter(tensor, op=hvd.Sum)
+
+            reduced.backward(self.cast_and_place(torch.ones(reduced.shape), dtype))
+            grad_out = tensor.grad.data.cpu().numpy()
+
+            expected = np.ones(tensor.shape)
+            err = np.linalg.norm(expected - grad_out)
+            self.assertLess(err, 0.00000001,
+                            "gradient %s differs from expected %s, "
+                            "error: %s" % (grad_out, expected, str(err)))
+
     def test_broadcast_state(self):
         hvd.init()
 
@@ -1506,6 +2340,48 @@ class TorchTests(unittest.TestCase):
         assert optimizer.param_groups[0]['params'][0].grad is None
         assert torch.all(torch.eq(grad, bgrad)).item()
 
+    def test_broadcast_parameters_sharded(self):
+        """Test that parameters are broadcast from several roots holding the same values."""
+        from horovod.torch.functions import _broadcast_parameters
+        hvd.init()
+        size = hvd.size()
+
+        # The last rank does not hold the values, unless it is the only one.
+        root_ranks = list(range(max(size - 1, 1)))
+        params = {}
+        for i in range(10):
+            value = i if hvd.rank() in root_ranks else -1
+            params['param.%d' % i] = torch.full([i + 1, 17], value, dtype=torch.float32)
+
+        _broadcast_parameters(params, root_ranks)
+        for i in range(10):
+            assert torch.all(torch.eq(params['param.%d' % i], i)).item(), \
+                'hvd._broadcast_parameters produces incorrect values'
+
+    def test_broadcast_state_async(self):
+        """Test that the parameters and optimizer state broadcast asynchronously
+        are only set once the handles are synchronized."""
+        hvd.init()
+
+        model = torch.nn.Linear(17, 5)
+        optimizer = torch.optim.SGD(model.parameters(), lr=0.1 * (hvd.rank() + 1),
+                                    momentum=0.9)
+        with torch.no_grad():
+            for p in model.parameters():
+                p.fill_(hvd.rank())
+
+        params_handle = hvd.broadcast_parameters_async(model.state_dict(), root_rank=0)
+        optimizer_handle = hvd.broadcast_optimizer_state_async(optimizer, root_rank=0)
+        hvd.synchronize(params_handle)
+        hvd.synchronize(optimizer_handle)
+        assert hvd.poll(params_handle)
+
+        for p in model.parameters():
+            assert torch.all(torch.eq(p, 0)).item(), \
+                'hvd.broadcast_parameters_async produces incorrect values'
+        assert optimizer.param_groups[0]['lr'] == 0.1, \
+            'hvd.broadcast_optimizer_state_async produces incorrect options'
+
     def test_broadcast_object(self):
         hvd.init()
 
@@ -1518,6 +2394,39 @@ class TorchTests(unittest.TestCase):
         obj = hvd.broadcast_object(obj, root_rank=0)
         self.assertDictEqual(obj, expected_obj)
 
+    def test_broadcast_object_out_of_band(self):
+        """Test that the tensors and arrays of an object are broadcast out of band,
+        in chunks."""
+        import horovod.torch.functions as functions
+        hvd.init()
+
+        chunk_bytes = functions._OBJECT_CHUNK_BYTES
+        functions._OBJECT_CHUNK_BYTES = 64
+        try:
+            expected_obj = {
+                'step': 7,
+                'array': np.arange(100, dtype=np.float32),
+                'tensor': torch.arange(50, dtype=torch.int64).reshape(5, 10),
+                'mask': torch.tensor([True, False, True]),
+                'complex': torch.full((7,), 1 - 2j, dtype=torch.complex64),
+                'short': torch.arange(30, dtype=torch.int16),
+                'param': nn.Parameter(torch.ones(3, 3)),
+            }
+            obj = expected_obj if hvd.rank() == 0 else None
+            obj = hvd.broadcast_object(obj, root_rank=0, name='oob', out_of_band=True)
+        finally:
+            functions._OBJECT_CHUNK_BYTES = chunk_bytes
+
+        assert obj['step'] == 7
+        assert np.array_equal(obj['array'], expected_obj['array'])
+        assert torch.equal(obj['tensor'], expected_obj['tensor'])
+        assert torch.equal(obj['mask'], expected_obj['mask'])
+        # Types Horovod cannot broadcast are sent as bytes.
+        assert torch.equal(obj['complex'], expected_obj['complex'])
+        assert torch.equal(obj['short'], expected_obj['short'])
+        assert isinstance(obj['param'], nn.Parameter) and obj['param'].requires_grad
+        assert torch.equal(obj['param'].data, expected_obj['param'].data)
+
     def test_allgather_object(self):
         hvd.init()
 
@@ -1569,6 +2478,134 @@ class TorchTests(unittest.TestCase):
                 err = np.linalg.norm(expected - tensor_decompressed.data.numpy())
                 self.assertLess(err, 0.00000001)
 
+    def test_compression_topk(self):
+        """Test that top-k compression sends the largest entries and keeps the
+        others for the next step."""
+        compression = hvd.Compression.topk(0.25)
+        tensor = torch.FloatTensor([[1, -8, 2, 0], [4, 0, -3, 1]])
+
+        (values, indices), ctx = compression.compress(tensor, 'grad')
+        self.assertEqual(sorted(indices.tolist()), [1, 4])
+        self.assertEqual(sorted(values.tolist()), [-8, 4])
+
+        tensor_decompressed = compression.decompress((values, indices), ctx)
+        expected = torch.FloatTensor([[0, -8, 0, 0], [4, 0, 0, 0]])
+        self.assertTrue(torch.equal(tensor_decompressed, expected))
+
+        # The residual of the entries not sent is added to the next gradient.
+        (values, indices), ctx = compression.compress(torch.zeros(2, 4), 'grad')
+        self.assertEqual(sorted(indices.tolist()), [2, 6])
+        self.assertEqual(sorted(values.tolist()), [-3, 2])
+
+    def test_compression_onebit(self):
+        """Test that 1-bit compression sends the signs scaled by the mean
+        magnitude of their chunk and keeps the error for the next step."""
+        compression = hvd.Compression.onebit(8)
+        tensor = torch.FloatTensor([1, -3, 2, -2])
+
+        (bits, scales), ctx = compression.compress(tensor, 'grad')
+        self.assertEqual(bits.dtype, torch.uint8)
+        self.assertEqual(bits.numel(), 1)
+        tensor_decompressed = compression.decompress(
+            *compression.compress_second((bits, scales), ctx))
+        self.assertTrue(torch.equal(tensor_decompressed,
+                                    torch.FloatTensor([2, -2, 2, -2])))
+
+        # The residual [-1, -1, 0, 0] is sent with the next gradient.
+        tensor_decompressed = compression.decompress(
+            *compression.compress_second(*compression.compress(torch.zeros(4), 'grad')))
+        self.assertTrue(torch.equal(tensor_decompressed,
+                                    torch.FloatTensor([-0.5, -0.5, 0.5, 0.5])))
+
+    def test_compression_fp8(self):
+        """Test that FP8 compression scales every chunk to the range of the
+        8-bit format."""
+        if not hasattr(torch, 'float8_e4m3fn'):
+            self.skipTest("FP8 requires PyTorch 2.1 or later")
+
+        for format in ['e4m3', 'e5m2']:
+            compression = hvd.Compression.fp8(format, chunk_size=4)
+            tensor = torch.FloatTensor([1, -2, 0.5, 4, 0, 0, 0, 0, 8])
+
+            (quantized, scales), ctx = compression.compress(tensor)
+            self.assertEqual(quantized.dtype, torch.uint8)
+            self.assertEqual(quantized.numel(), 12)
+            self.assertEqual(scales.numel(), 3)
+
+            tensor_decompressed = compression.decompress(
+                *compression.compress_second((quantized, scales), ctx))
+            self.assertEqual(tensor_decompressed.dtype, torch.float32)
+            self.assertTrue(torch.allclose(tensor_decompressed, tensor, rtol=1e-5))
+
+    def test_sparse_compression_optimizer(self):
+        """Test that the optimizer averages sparsified gradients over all
+        ranks."""
+        hvd.init()
+
+        model = torch.nn.Linear(4, 1, bias=False)
+        torch.nn.init.zeros_(model.weight)
+        opt = torch.optim.SGD(model.parameters(), lr=1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       compression=hvd.Compression.topk(0.5))
+
+        # Every rank computes the gradient [-1, -2, -3, -4], of which the last
+        # two entries are sent.
+        loss = model(torch.FloatTensor([[1, 2, 3, 4]])).sum()
+        opt.zero_grad()
+        (-loss).backward()
+        opt.step()
+        self.assertTrue(torch.allclose(model.weight.data,
+                                       torch.FloatTensor([[0, 0, 3, 4]])))
+
+        with self.assertRaises(ValueError):
+            hvd.DistributedOptimizer(torch.optim.SGD(model.parameters(), lr=1),
+                                     compression=hvd.Compression.topk(0.5),
+                                     op=hvd.Adasum)
+
+    def test_onebit_compression_optimizer(self):
+        """Test that the optimizer averages 1-bit gradients over all ranks,
+        reduced in shards of whole chunks."""
+        hvd.init()
+        size = hvd.size()
+
+        model = torch.nn.Linear(8 * size, 1, bias=False)
+        torch.nn.init.zeros_(model.weight)
+        opt = torch.optim.SGD(model.parameters(), lr=1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       compression=hvd.Compression.onebit(8))
+
+        # Every entry of a chunk of the gradient has the same magnitude, so
+        # that its signs and scale represent it exactly and every rank reduces
+        # one chunk.
+        x = torch.FloatTensor([[(i // 8 + 1) * (1 if i % 2 else -1)
+                                for i in range(8 * size)]])
+        loss = model(x).sum()
+        opt.zero_grad()
+        loss.backward()
+        opt.step()
+        self.assertTrue(torch.allclose(model.weight.data, -x))
+
+    def test_powersgd_compression_optimizer(self):
+        """Test that the optimizer reduces low-rank gradients exactly with
+        PowerSGD compression."""
+        hvd.init()
+
+        model = torch.nn.Linear(4, 3, bias=False)
+        torch.nn.init.zeros_(model.weight)
+        opt = torch.optim.SGD(model.parameters(), lr=1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       compression=hvd.Compression.powersgd(1))
+
+        # The gradient of every rank is the matrix of rank 1 whose rows are
+        # -[1, 2, 3, 4].
+        x = torch.FloatTensor([[1, 2, 3, 4]])
+        for step in range(2):
+            opt.zero_grad()
+            (-model(x).sum()).backward()
+            opt.step()
+            expected = (step + 1) * x.repeat(3, 1)
+            self.assertTrue(torch.allclose(model.weight.data, expected, atol=1e-4))
+
     def test_force_allreduce(self):
         """Test that allreduce is forced on all gradients during opt.step()."""
         hvd.init()
@@ -1684,6 +2721,305 @@ class TorchTests(unittest.TestCase):
         loss.backward()
         opt.step()
 
+    def test_distributed_optimizer_register_parameters(self):
+        """Test that registered parameters are not negotiated again by the first step."""
+        hvd.init()
+
+        # This test does not apply if there is only one worker.
+        if hvd.size() == 1:
+            self.skipTest("Only one worker available")
+
+        def cache_misses():
+            for line in hvd.get_metrics().splitlines():
+                if line.startswith('horovod_response_cache_misses_total '):
+                    return float(line.rsplit(' ', 1)[1])
+
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       register_parameters=True)
+        misses = cache_misses()
+
+        loss = model(torch.rand(4, 10)).sum()
+        opt.zero_grad()
+        loss.backward()
+        opt.step()
+        assert cache_misses() == misses
+
+    def test_distributed_optimizer_contiguous_gradients(self):
+        """Test that contiguous gradients are reduced in place and averaged correctly."""
+        hvd.init()
+
+        # This test does not apply if there is only one worker.
+        if hvd.size() == 1:
+            self.skipTest("Only one worker available")
+
+        torch.manual_seed(1234)
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference.load_state_dict(model.state_dict())
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       contiguous_gradients=True)
+        storage = next(model.parameters()).grad.storage().data_ptr()
+        assert all(p.grad.storage().data_ptr() == storage for p in model.parameters())
+
+        # Every rank computes the same gradients, so their average is unchanged.
+        data = torch.rand(4, 10)
+        reference(data).sum().backward()
+        opt.zero_grad()
+        model(data).sum().backward()
+        opt.synchronize()
+        for p, ref in zip(model.parameters(), reference.parameters()):
+            assert p.grad.storage().data_ptr() == storage
+            assert torch.allclose(p.grad, ref.grad, atol=1e-6)
+
+    def test_distributed_optimizer_contiguous_gradient_accumulation(self):
+        """Test that accumulated contiguous gradients keep their layout across steps."""
+        hvd.init()
+
+        # This test does not apply if there is only one worker.
+        if hvd.size() == 1:
+            self.skipTest("Only one worker available")
+
+        torch.manual_seed(1234)
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference.load_state_dict(model.state_dict())
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       contiguous_gradients=True, backward_passes_per_step=2,
+                                       compression=hvd.Compression.fp16)
+        storage = next(model.parameters()).grad.storage().data_ptr()
+
+        data = [torch.rand(4, 10), torch.rand(4, 10)]
+        for _ in range(2):
+            # zero_grad() must not set the gradients to None.
+            reference.zero_grad()
+            for batch in data:
+                reference(batch).sum().backward()
+            opt.zero_grad()
+            for batch in data:
+                model(batch).sum().backward()
+            opt.synchronize()
+            for p, ref in zip(model.parameters(), reference.parameters()):
+                assert p.grad.storage().data_ptr() == storage
+                assert torch.allclose(p.grad, ref.grad, atol=1e-2)
+
+    def test_distributed_optimizer_gradient_buckets(self):
+        """Test that gradient buckets are enqueued as a whole and averaged correctly."""
+        hvd.init()
+
+        # This test does not apply if there is only one worker.
+        if hvd.size() == 1:
+            self.skipTest("Only one worker available")
+
+        torch.manual_seed(1234)
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference.load_state_dict(model.state_dict())
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       gradient_bucket_bytes=200)
+
+        # The last layer and the bias of the first one fit into 200 bytes, the
+        # weight of the first layer makes a bucket of its own.
+        assert [len(params) for _, params in opt._buckets] == [3, 1]
+
+        data = torch.rand(4, 10)
+        for _ in range(2):
+            reference.zero_grad()
+            reference(data).sum().backward()
+            opt.zero_grad()
+            model(data).sum().backward()
+            assert len(opt._bucket_handles) == 2
+            opt.synchronize()
+            for p, ref in zip(model.parameters(), reference.parameters()):
+                assert torch.allclose(p.grad, ref.grad, atol=1e-6)
+
+    def test_distributed_optimizer_native_gradient_hooks(self):
+        """Test that gradients allreduced by the C++ hooks are accumulated and averaged correctly."""
+        hvd.init()
+
+        # This test does not apply if there is only one worker.
+        if hvd.size() == 1:
+            self.skipTest("Only one worker available")
+
+        torch.manual_seed(1234)
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3))
+        reference.load_state_dict(model.state_dict())
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       backward_passes_per_step=2,
+                                       native_gradient_hooks=True)
+        assert len(opt._native_hooks) == 4
+
+        data = torch.rand(4, 10)
+        for _ in range(2):
+            reference.zero_grad()
+            opt.zero_grad()
+            for _ in range(2):
+                reference(data).sum().backward()
+                model(data).sum().backward()
+            opt.synchronize()
+            assert not opt._handles
+            for p, ref in zip(model.parameters(), reference.parameters()):
+                assert torch.allclose(p.grad, ref.grad, atol=1e-6)
+
+        with self.assertRaises(ValueError):
+            hvd.DistributedOptimizer(torch.optim.SGD(model.parameters(), lr=0.1),
+                                     named_parameters=model.named_parameters(),
+                                     compression=hvd.Compression.fp16,
+                                     native_gradient_hooks=True)
+
+    def test_horovod_allreduce_norm_sqrd(self):
+        """Test that the allreduce adds the squared norm of its output to norm_sqrd."""
+        hvd.init()
+        # Only do this test if there are GPUs available.
+        if not torch.cuda.is_available() or not hvd.nccl_built() or hvd.rocm_built():
+            self.skipTest("No GPUs available")
+
+        size = hvd.size()
+        device = torch.device('cuda', hvd.local_rank())
+        norm_sqrd = torch.zeros((), dtype=torch.float64, device=device)
+        torch.manual_seed(1234)
+        tensors = [torch.rand(n, device=device) for n in (17, 1000, 3)]
+        expected = sum(float((t.double() * size).pow(2).sum()) for t in tensors)
+        handles = [hvd.allreduce_async_(t, name='norm_sqrd.%d' % i, op=hvd.Sum,
+                                        norm_sqrd=norm_sqrd)
+                   for i, t in enumerate(tensors)]
+        for handle in handles:
+            hvd.synchronize(handle)
+        assert abs(float(norm_sqrd) - expected) <= 1e-4 * expected
+
+        with self.assertRaises(ValueError):
+            hvd.allreduce_async_(torch.rand(3, device=device), norm_sqrd=torch.zeros(()))
+
+    def test_distributed_optimizer_fused_grad_norm(self):
+        """Test that the fused gradient norm is the norm of the averaged gradients."""
+        hvd.init()
+        device = torch.device('cuda', hvd.local_rank()) if torch.cuda.is_available() else None
+
+        torch.manual_seed(1234)
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3)).to(device)
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       fused_grad_norm=True)
+
+        data = torch.rand(4, 10, device=device)
+        for _ in range(2):
+            opt.zero_grad()
+            model(data).sum().backward()
+            opt.synchronize()
+            expected = torch.norm(torch.stack([p.grad.double().norm() for p in model.parameters()]))
+            assert torch.allclose(opt.grad_norm().cpu(), expected.cpu(), rtol=1e-5)
+            with opt.skip_synchronize():
+                opt.step()
+
+        with self.assertRaises(ValueError):
+            hvd.DistributedOptimizer(torch.optim.SGD(model.parameters(), lr=0.1),
+                                     named_parameters=model.named_parameters(),
+                                     compression=hvd.Compression.topk(0.1),
+                                     fused_grad_norm=True)
+
+    def test_horovod_allreduce_found_inf(self):
+        """Test that the allreduce flags outputs with an inf or a NaN in found_inf."""
+        hvd.init()
+        # Only do this test if there are GPUs available.
+        if not torch.cuda.is_available() or not hvd.nccl_built() or hvd.rocm_built():
+            self.skipTest("No GPUs available")
+
+        rank = hvd.rank()
+        device = torch.device('cuda', hvd.local_rank())
+        for dtype in [torch.float16, torch.float32]:
+            found_inf = torch.zeros((), dtype=torch.float32, device=device)
+            finite = torch.ones(100, dtype=dtype, device=device)
+            hvd.synchronize(hvd.allreduce_async_(finite, name='found_inf.finite.%s' % dtype,
+                                                 op=hvd.Sum, found_inf=found_inf))
+            assert float(found_inf) == 0
+
+            # Only the last rank sends a NaN, and it overflows every rank's output.
+            tensor = torch.ones(100, dtype=dtype, device=device)
+            if rank == hvd.size() - 1:
+                tensor[42] = float('nan')
+            hvd.synchronize(hvd.allreduce_async_(tensor, name='found_inf.nan.%s' % dtype,
+                                                 op=hvd.Sum, found_inf=found_inf))
+            assert float(found_inf) == 1
+
+        with self.assertRaises(ValueError):
+            hvd.allreduce_async_(torch.rand(3, device=device),
+                                 found_inf=torch.zeros((), dtype=torch.float64, device=device))
+
+    def test_distributed_optimizer_fused_found_inf(self):
+        """Test that the fused overflow flag is set when a reduced gradient overflows."""
+        hvd.init()
+        device = torch.device('cuda', hvd.local_rank()) if torch.cuda.is_available() else None
+
+        torch.manual_seed(1234)
+        model = torch.nn.Sequential(torch.nn.Linear(10, 10), torch.nn.Linear(10, 3)).to(device)
+        opt = torch.optim.SGD(model.parameters(), lr=0.1)
+        opt = hvd.DistributedOptimizer(opt, named_parameters=model.named_parameters(),
+                                       fused_found_inf=True)
+
+        data = torch.rand(4, 10, device=device)
+        for scale in [1.0, float('inf')]:
+            opt.zero_grad()
+            (model(data).sum() * scale).backward()
+            opt.synchronize()
+            assert float(opt.found_inf()) == (0 if scale == 1.0 else 1)
+            with opt.skip_synchronize():
+                opt.step()
+
+        with self.assertRaises(ValueError):
+            hvd.DistributedOptimizer(torch.optim.SGD(model.parameters(), lr=0.1),
+                                     named_parameters=model.named_parameters(),
+                                     op=hvd.Adasum, fused_found_inf=True)
+
+    def test_distributed_optimizer_fused_step(self):
+        """Test that the optimizer steps run after the allreduces match step()."""
+        hvd.init()
+        device = torch.device('cuda', hvd.local_rank()) if torch.cuda.is_available() else None
+
+        def make_optimizers():
+            return [lambda params: torch.optim.SGD(params, lr=0.1),
+                    lambda params: torch.optim.SGD(params, lr=0.1, momentum=0.9,
+                                                   weight_decay=0.01, nesterov=True),
+                    lambda params: torch.optim.SGD(params, lr=0.1, momentum=0.9, dampening=0.1),
+                    lambda params: torch.optim.Adam(params, lr=0.01, weight_decay=0.01),
+                    lambda params: torch.optim.AdamW(params, lr=0.01, weight_decay=0.01)]
+
+        data = torch.rand(4, 10, device=device)
+        for make_optimizer in make_optimizers():
+            models, opts = [], []
+            for fused_step in [False, True]:
+                torch.manual_seed(1234)
+                model = torch.nn.Sequential(torch.nn.Linear(10, 10),
+                                            torch.nn.Linear(10, 3)).to(device)
+                opt = hvd.DistributedOptimizer(make_optimizer(model.parameters()),
+                                               named_parameters=model.named_parameters(),
+                                               fused_step=fused_step)
+                models.append(model)
+                opts.append(opt)
+
+            for _ in range(3):
+                for model, opt in zip(models, opts):
+                    opt.zero_grad()
+                    model(data).pow(2).sum().backward()
+                    opt.step()
+            for expected, actual in zip(models[0].parameters(), models[1].parameters()):
+                assert torch.allclose(expected, actual, rtol=1e-4, atol=1e-6), (expected, actual)
+
+        model = torch.nn.Linear(10, 3)
+        with self.assertRaises(ValueError):
+            hvd.DistributedOptimizer(torch.optim.SGD(model.parameters(), lr=0.1),
+                                     named_parameters=model.named_parameters(),
+                                     compression=hvd.Compression.fp16, fused_step=True)
+        with self.assertRaises(ValueError):
+            hvd.DistributedOptimizer(torch.optim.RMSprop(model.parameters(), lr=0.1),
+                                     named_parameters=model.named_parameters(),
+                                     fused_step=True)
+
     def test_delta_optimizer(self):
         """Test that delta optimizer."""
         hvd.init()
@@ -2079,6 +3415,32 @@ class TorchTests(unittest.TestCase):
             assert torch.allclose(hvd.allreduce(sync_bn.bias.grad, name='sync_bn.bias.grad'), bn.bias.grad, 1e-6)
             assert torch.allclose(hvd.allreduce(ts1.grad, name='ts1.grad'), ts2.grad, 1e-6)
 
+    def test_horovod_sync_batch_norm_uneven_batches(self):
+        """Tests that SyncBatchNorm weights the statistics of every rank with its batch size."""
+        if not torch.cuda.is_available():
+            self.skipTest("No GPUs available")
+
+        hvd.init()
+        device = torch.device('cuda', hvd.local_rank())
+        torch.manual_seed(1234)
+        # Rank r holds r + 1 samples of the whole batch.
+        ts = torch.rand(sum(range(1, hvd.size() + 1)), 3, 5, device=device) * 10 + 5
+        begin = sum(range(1, hvd.rank() + 1))
+        local = ts[begin:begin + hvd.rank() + 1].clone().requires_grad_()
+        whole = ts.clone().requires_grad_()
+
+        sync_bn = hvd.SyncBatchNorm(num_features=3).to(device)
+        bn = torch.nn.BatchNorm1d(num_features=3).to(device)
+        sync_bn_out = sync_bn(local)
+        bn_out = bn(whole)
+        assert torch.allclose(sync_bn_out, bn_out[begin:begin + hvd.rank() + 1], atol=1e-4)
+        assert torch.allclose(sync_bn.running_mean, bn.running_mean, atol=1e-4)
+        assert torch.allclose(sync_bn.running_var, bn.running_var, atol=1e-4)
+
+        sync_bn_out.pow(2).sum().backward()
+        bn_out.pow(2).sum().backward()
+        assert torch.allclose(local.grad, whole.grad[begin:begin + hvd.rank() + 1], atol=1e-4)
+
     @pytest.mark.skip(reason='https://github.com/horovod/horovod/issues/2330')
     def test_timeline_api(self):
         hvd.init()
@@ -13,6 +13,7 @@
 # limitations under the License.
 # ==============================================================================
 
+import threading
 import time
 import unittest
 import warnings
@@ -199,6 +200,33 @@ class ElasticDriverTests(unittest.TestCase):
         assert driver._host_manager.current_hosts.count_available_slots() >= 12
         driver.stop()
 
+    @mock.patch('horovod.runner.elastic.driver.DISCOVER_HOSTS_FREQUENCY_SECS', 0.01)
+    def test_slow_discovery_does_not_block(self):
+        """Tests that waiting for slots does not wait for a discovery in progress."""
+        discovery_started = threading.Event()
+        discovery_released = threading.Event()
+
+        def find_available_hosts_and_slots():
+            if discovery_started.is_set():
+                discovery_released.wait()
+            discovery_started.set()
+            return {'host-1': 2}
+
+        mock_discovery = mock.Mock()
+        mock_discovery.find_available_hosts_and_slots.side_effect = find_available_hosts_and_slots
+
+        driver = ElasticDriver(mock.Mock(), mock_discovery, min_np=2, max_np=2)
+        discovery_started.wait()
+
+        # The second discovery is blocked, but the hosts of the first one are available
+        waiter = threading.Thread(target=driver.wait_for_available_slots, args=(2,))
+        waiter.start()
+        waiter.join(5)
+        assert not waiter.is_alive()
+
+        discovery_released.set()
+        driver.stop()
+
     def test_all_workers_fail(self):
         """Tests that training fails when all workers fail."""
         slots = {'host-1': 2, 'host-2': 2}
@@ -0,0 +1,111 @@
+# Copyright 2020 Uber Technologies, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+import os
+import tempfile
+import unittest
+
+from horovod.tools import fusion_simulator
+from horovod.tools.fusion_simulator import CostModel, Tensor
+
+
+class FusionSimulatorTests(unittest.TestCase):
+    """
+    Tests for horovod.tools.fusion_simulator.
+    """
+
+    def _write_trace(self, directory, rank, rows):
+        path = os.path.join(directory, 'trace.{}.csv'.format(rank))
+        with open(path, 'w') as f:
+            f.write('step,rank,name,type,bytes,ready_us\n')
+            for step, name, type_, bytes_, ready_us in rows:
+                f.write('{},{},{},{},{},{}\n'.format(step, rank, name, type_, bytes_, ready_us))
+        return path
+
+    def test_parse_plan(self):
+        plan = fusion_simulator.parse_plan_spec('40,16M,40:8M;8,8,4;512,512,256')
+        self.assertEqual([(g.count, g.max_bytes, g.block_num, g.thread_num) for g in plan.groups],
+                         [(40, 0, 8, 512), (0, 16 << 20, 8, 512), (40, 8 << 20, 4, 256)])
+
+        plan = fusion_simulator.parse_plan_spec('2,2')
+        self.assertEqual([(g.block_num, g.thread_num) for g in plan.groups], [(0, 0), (0, 0)])
+
+        with self.assertRaises(ValueError):
+            fusion_simulator.parse_plan_spec('2,2;8;512')
+
+    def test_load_traces(self):
+        with tempfile.TemporaryDirectory() as d:
+            paths = [
+                self._write_trace(d, 0, [(0, 'a', 'ALLREDUCE', 4, 0),
+                                         (1, 'a', 'ALLREDUCE', 4, 100),
+                                         (1, 'b', 'ALLREDUCE', 8, 300),
+                                         (1, 'c', 'BROADCAST', 8, 400)]),
+                self._write_trace(d, 1, [(0, 'a', 'ALLREDUCE', 4, 0),
+                                         (1, 'b', 'ALLREDUCE', 8, 200),
+                                         (1, 'a', 'ALLREDUCE', 4, 500)]),
+            ]
+            steps = fusion_simulator.load_traces(paths)
+
+        # The warmup step and broadcasts are skipped, a tensor is ready once
+        # it is ready on all ranks.
+        self.assertEqual(len(steps), 1)
+        self.assertEqual([(t.name, t.bytes, t.ready) for t in steps[0]],
+                         [('b', 8, 300e-6), ('a', 4, 500e-6)])
+
+    def test_build_groups(self):
+        tensors = [Tensor(str(i), 4, i) for i in range(7)]
+        plan = fusion_simulator.parse_plan('2,3')
+        groups = fusion_simulator.build_groups(tensors, plan)
+        self.assertEqual([(i, [t.name for t in g]) for i, g in groups],
+                         [(0, ['0', '1']), (1, ['2', '3', '4']), (0, ['5', '6'])])
+
+        # Byte budgets end a group before the tensor that does not fit.
+        plan = fusion_simulator.parse_plan('10:10')
+        groups = fusion_simulator.build_groups(tensors, plan)
+        self.assertEqual([len(g) for _, g in groups], [2, 2, 2, 1])
+
+    def test_simulate_step(self):
+        cost_model = CostModel(latency=0, bandwidth=1.0)
+        tensors = [Tensor('a', 1, 0.0), Tensor('b', 1, 1.0), Tensor('c', 2, 1.0)]
+
+        # One group, launched a cycle after the last tensor is ready.
+        plan = fusion_simulator.parse_plan('3')
+        self.assertAlmostEqual(
+            fusion_simulator.simulate_step(tensors, plan, cost_model, cycle_time=0.5), 5.5)
+
+        # The first group overlaps the arrival of the others.
+        plan = fusion_simulator.parse_plan('1,2')
+        self.assertAlmostEqual(
+            fusion_simulator.simulate_step(tensors, plan, cost_model, cycle_time=0.5), 4.5)
+
+    def test_cost_table(self):
+        cost_model = CostModel([(1000, 1, 4, 256, 1.0), (3000, 1, 4, 256, 2.0),
+                                (1000, 1, 8, 256, 0.5), (3000, 1, 8, 256, 1.5),
+                                (1000, 2, 8, 256, 4.0)])
+        self.assertAlmostEqual(cost_model.cost(2000, 1, 4, 256), 1.5)
+        self.assertAlmostEqual(cost_model.cost(6000, 1, 4, 256), 4.0)
+        self.assertAlmostEqual(cost_model.cost(1000, 1, 5, 256), 1.0)
+        # Groups without blocks and threads take the fastest allocation.
+        self.assertAlmostEqual(cost_model.cost(1000, 1, 0, 0), 0.5)
+        self.assertAlmostEqual(cost_model.cost(1000, 3, 8, 256), 4.0)
+
+    def test_candidate_plans(self):
+        steps = [[Tensor(str(i), 1, i) for i in range(8)]]
+        plans = fusion_simulator.candidate_plans(steps, [1, 2, 4])
+        self.assertEqual([p.fusion_size for p in plans], ['8', '4,4', '2,2,2,2'])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -13,7 +13,7 @@ import torch
 
 from horovod.common.util import gloo_built
 from horovod.ray.runner import (BaseHorovodWorker, NodeColocator, Coordinator,
-                                MiniSettings, RayExecutor)
+                                MiniSettings, RayExecutor, placement_group)
 
 sys.path.append(os.path.dirname(__file__))
 
@@ -145,6 +145,19 @@ def test_local(ray_start_4_cpus):
     assert check_resources(original_resources)
 
 
+@pytest.mark.skipif(
+    placement_group is None, reason='Ray placement groups are not available')
+def test_hosts_on_separate_nodes(ray_start_4_cpus):
+    original_resources = ray.available_resources()
+    setting = RayExecutor.create_settings(timeout_s=5)
+    # Both hosts would fit on the only node, but each needs a node of its own.
+    hjob = RayExecutor(setting, num_hosts=2, num_slots=1)
+    with pytest.raises(TimeoutError):
+        hjob.start()
+    assert hjob.placement_group is None
+    assert check_resources(original_resources)
+
+
 @pytest.mark.skipif(
     not gloo_built(), reason='Gloo is required for Ray integration')
 def test_ray_init(ray_start_4_cpus):
@@ -818,6 +818,19 @@ class RunTests(unittest.TestCase):
             hostnames = hosts.parse_host_files(host_filename)
             self.assertEqual(hostnames, '172.31.32.7:8,172.31.33.9:8')
 
+    def test_horovodrun_hostfile_switches(self):
+        with temppath() as host_filename:
+            with open(host_filename, 'w+') as fp:
+                fp.write('host-1 slots=4 switch=sw-a\n')
+                fp.write('host-2 slots=4 switch=sw-b\n')
+                fp.write('host-3 slots=4\n')
+                fp.write('host-4 slots=4 switch=sw-a\n')
+                fp.write('\n')
+                fp.write('host-5 slots=2 switch=sw-b\n')
+
+            hostnames = hosts.parse_host_files(host_filename)
+            self.assertEqual(hostnames, 'host-1:4,host-4:4,host-2:4,host-5:2,host-3:4')
+
     """
     Tests js_run.
     """
@@ -88,6 +88,51 @@ class TorchElasticTests(unittest.TestCase):
         assert state.batch == 21
         assert state.epoch == 11
 
+    def test_elastic_state_async_commit(self):
+        hvd.init()
+
+        device = torch.device('cuda') if torch.cuda.is_available() else torch.device('cpu')
+        model = torch.nn.Sequential(torch.nn.Linear(2, 2), torch.nn.BatchNorm1d(2)).to(device)
+        optimizer = torch.optim.Adam(model.parameters(), lr=0.1)
+
+        def train():
+            optimizer.zero_grad()
+            model(torch.ones(4, 2, device=device)).sum().backward()
+            optimizer.step()
+
+        train()
+        state = hvd.elastic.TorchState(model, optimizer, async_commit=True, batch=0)
+        state.sync()
+
+        # Modifications made right after a commit must not reach the snapshot
+        state.commit()
+        committed_model = copy.deepcopy(model.state_dict())
+        committed_optimizer = copy.deepcopy(optimizer.state_dict())
+        train()
+        state.restore()
+        for k, v in model.state_dict().items():
+            np.testing.assert_allclose(v.cpu(), committed_model[k].cpu())
+        for k, v in optimizer.state_dict()['state'].items():
+            for name, value in v.items():
+                np.testing.assert_allclose(torch.as_tensor(value).cpu(),
+                                           torch.as_tensor(committed_optimizer['state'][k][name]).cpu())
+
+        # Training after a restore does not modify the snapshot either
+        train()
+        state.restore()
+        for k, v in model.state_dict().items():
+            np.testing.assert_allclose(v.cpu(), committed_model[k].cpu())
+
+        # The buffers alternate between commits
+        for _ in range(3):
+            train()
+            state.commit()
+        committed_model = copy.deepcopy(model.state_dict())
+        train()
+        state.restore()
+        for k, v in model.state_dict().items():
+            np.testing.assert_allclose(v.cpu(), committed_model[k].cpu())
+
     def test_elastic_sampler(self):
         hvd.init()
 